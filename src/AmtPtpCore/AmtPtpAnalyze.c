@@ -0,0 +1,190 @@
+// AmtPtpAnalyze.c: Report rate, jitter, drop and contact lifetime statistics
+
+#include "AmtPtpAnalyze.h"
+#include "AmtPtpReplay.h"
+
+static uint32_t
+AmtPtpAnalyzeLog2(
+	uint64_t v
+)
+{
+	uint32_t n = 0;
+
+	while (v >>= 1) n++;
+	return n < AMTPTP_ANALYZE_LIFETIME_BUCKETS ? n : AMTPTP_ANALYZE_LIFETIME_BUCKETS - 1;
+}
+
+void
+AmtPtpAnalyzeInit(
+	PAMTPTP_ANALYSIS Analysis
+)
+{
+	AMTPTP_ANALYSIS Empty = { 0 };
+
+	*Analysis = Empty;
+	Analysis->IntervalMin = UINT64_MAX;
+}
+
+// End is the number of the first frame without the contact
+static void
+AmtPtpAnalyzeEndContact(
+	PAMTPTP_ANALYSIS a,
+	uint32_t Id,
+	uint64_t End
+)
+{
+	a->Lifetimes[AmtPtpAnalyzeLog2(End - (a->ActiveSince[Id] - 1))]++;
+	a->Contacts++;
+	a->ActiveSince[Id] = 0;
+}
+
+static int
+AmtPtpAnalyzeSink(
+	void *Context,
+	const AMTPTP_REPLAY_FRAME *Replay
+)
+{
+	PAMTPTP_ANALYSIS a = (PAMTPTP_ANALYSIS) Context;
+	uint8_t Seen[AMTPTP_ANALYZE_MAX_CONTACT_ID] = { 0 };
+	uint64_t Interval, Bucket;
+	uint32_t i, Id;
+
+	if (Replay->Index > 0 && a->TimestampFrequency) {
+		Interval = Replay->Timestamp - a->LastTimestamp;
+		if (Interval < a->IntervalMin) a->IntervalMin = Interval;
+		if (Interval > a->IntervalMax) a->IntervalMax = Interval;
+
+		Bucket = Interval * 1000000 / a->TimestampFrequency / AMTPTP_ANALYZE_INTERVAL_BUCKET_US;
+		a->Intervals[Bucket < AMTPTP_ANALYZE_INTERVAL_BUCKETS - 1 ? Bucket : AMTPTP_ANALYZE_INTERVAL_BUCKETS - 1]++;
+	}
+	a->LastTimestamp = Replay->Timestamp;
+
+	if (Replay->Status != AmtPtpDecodeOk) {
+		a->Malformed++;
+		return 0;
+	}
+
+	a->ScanTime[Replay->ScanTime]++;
+	a->ContactCount[Replay->Frame.ContactCount]++;
+
+	// Contacts count from the frame they first appear in until the frame before they vanish
+	for (i = 0; i < Replay->Frame.ContactCount; i++) {
+		Id = Replay->Frame.Contacts[i].ContactID % AMTPTP_ANALYZE_MAX_CONTACT_ID;
+		Seen[Id] = 1;
+		if (a->ActiveSince[Id] == 0) {
+			a->ActiveSince[Id] = a->Frames + 1;
+		}
+	}
+
+	for (Id = 0; Id < AMTPTP_ANALYZE_MAX_CONTACT_ID; Id++) {
+		if (a->ActiveSince[Id] && !Seen[Id]) {
+			AmtPtpAnalyzeEndContact(a, Id, a->Frames);
+		}
+	}
+
+	a->Frames++;
+	return 0;
+}
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpAnalyzeCapture(
+	PAMTPTP_ANALYSIS Analysis,
+	PAMTPTP_CAPTURE_READER Reader
+)
+{
+	AMTPTP_REPLAY_STATS Stats;
+	AMTPTP_CAPTURE_STATUS Status;
+	AMTPTP_BENCH_FAMILY Family;
+	uint32_t Id;
+
+	Analysis->TimestampFrequency = Reader->Device.TimestampFrequency;
+
+	AmtPtpReplayHeaderFamily(Reader, &Family);
+	Status = AmtPtpReplayCapture(Reader, &Family, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, AmtPtpAnalyzeSink,
+		Analysis, &Stats);
+
+	for (Id = 0; Id < AMTPTP_ANALYZE_MAX_CONTACT_ID; Id++) {
+		if (Analysis->ActiveSince[Id]) {
+			AmtPtpAnalyzeEndContact(Analysis, Id, Analysis->Frames);
+		}
+	}
+
+	Analysis->Duration += Stats.Duration;
+	return Status;
+}
+
+uint64_t
+AmtPtpAnalyzeReports(
+	PAMTPTP_ANALYSIS Analysis,
+	const uint8_t *Reports,
+	size_t Length,
+	size_t ReportSize
+)
+{
+	AMTPTP_FRAME Frame;
+	uint64_t Count = 0;
+	uint16_t ScanTime;
+
+	if (ReportSize != AMTPTP_REPORT_SIZE && ReportSize != AMTPTP_COMPACT_REPORT_SIZE) {
+		return 0;
+	}
+
+	for (; Length >= ReportSize; Length -= ReportSize, Reports += ReportSize) {
+		if (AmtPtpUnpackReport(Reports, ReportSize, &Frame, &ScanTime) != AmtPtpDecodeOk) {
+			continue;
+		}
+		Analysis->ReportScanTime[ScanTime < AMTPTP_SCAN_TIME_MAX ? ScanTime : AMTPTP_SCAN_TIME_MAX]++;
+		Count++;
+	}
+
+	Analysis->Reports += Count;
+	return Count;
+}
+
+void
+AmtPtpAnalyzeMerge(
+	PAMTPTP_ANALYSIS Target,
+	const AMTPTP_ANALYSIS *Source
+)
+{
+	size_t i;
+
+	if (Target->TimestampFrequency == 0) {
+		Target->TimestampFrequency = Source->TimestampFrequency;
+	}
+
+	Target->Frames += Source->Frames;
+	Target->Malformed += Source->Malformed;
+	Target->Duration += Source->Duration;
+	Target->Contacts += Source->Contacts;
+	Target->Reports += Source->Reports;
+	if (Source->IntervalMin < Target->IntervalMin) Target->IntervalMin = Source->IntervalMin;
+	if (Source->IntervalMax > Target->IntervalMax) Target->IntervalMax = Source->IntervalMax;
+
+	for (i = 0; i < AMTPTP_ANALYZE_INTERVAL_BUCKETS; i++) Target->Intervals[i] += Source->Intervals[i];
+	for (i = 0; i <= AMTPTP_SCAN_TIME_MAX; i++) Target->ScanTime[i] += Source->ScanTime[i];
+	for (i = 0; i <= AMTPTP_SCAN_TIME_MAX; i++) Target->ReportScanTime[i] += Source->ReportScanTime[i];
+	for (i = 0; i <= AMTPTP_MAX_CONTACTS; i++) Target->ContactCount[i] += Source->ContactCount[i];
+	for (i = 0; i < AMTPTP_ANALYZE_LIFETIME_BUCKETS; i++) Target->Lifetimes[i] += Source->Lifetimes[i];
+}
+
+double
+AmtPtpAnalyzeReportRate(
+	const AMTPTP_ANALYSIS *Analysis
+)
+{
+	if (Analysis->Duration == 0 || Analysis->TimestampFrequency == 0) {
+		return 0.0;
+	}
+
+	return (double) (Analysis->Frames + Analysis->Malformed) * (double) Analysis->TimestampFrequency /
+		(double) Analysis->Duration;
+}
+
+uint64_t
+AmtPtpAnalyzeDropped(
+	const AMTPTP_ANALYSIS *Analysis
+)
+{
+	return Analysis->Frames > Analysis->Reports ? Analysis->Frames - Analysis->Reports : 0;
+}
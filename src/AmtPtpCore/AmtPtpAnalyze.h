@@ -0,0 +1,100 @@
+// AmtPtpAnalyze.h: Report rate, jitter, drop and contact lifetime statistics
+//
+// An AMTPTP_ANALYSIS accumulates statistics over one capture, and optionally
+// over the PTP_REPORT stream a driver emitted for it. Analyses are plain
+// counters, so a large corpus can be split across threads, one capture per
+// analysis, and combined afterwards with AmtPtpAnalyzeMerge.
+//
+// Frames dropped because no IOCTL_HID_READ_REPORT was pending show up as
+// decoded frames without a matching emitted report.
+
+#pragma once
+
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Inter-frame interval histogram: 250us buckets up to 32ms, last bucket is overflow
+#define AMTPTP_ANALYZE_INTERVAL_BUCKET_US	250
+#define AMTPTP_ANALYZE_INTERVAL_BUCKETS		129
+
+// Contact lifetime histogram in frames: bucket n counts lifetimes of 2^n to 2^(n+1)-1
+#define AMTPTP_ANALYZE_LIFETIME_BUCKETS		32
+
+// Contact IDs tracked for lifetimes (TYPE5 identifiers are 4 bits)
+#define AMTPTP_ANALYZE_MAX_CONTACT_ID		16
+
+typedef struct _AMTPTP_ANALYSIS {
+	uint64_t TimestampFrequency;
+
+	// Raw frames
+	uint64_t Frames;
+	uint64_t Malformed;
+	uint64_t Duration;						// Ticks from first to last frame
+	uint64_t Intervals[AMTPTP_ANALYZE_INTERVAL_BUCKETS];
+	uint64_t IntervalMin;					// Ticks
+	uint64_t IntervalMax;
+	uint64_t ScanTime[AMTPTP_SCAN_TIME_MAX + 1];
+	uint64_t ContactCount[AMTPTP_MAX_CONTACTS + 1];
+	uint64_t Lifetimes[AMTPTP_ANALYZE_LIFETIME_BUCKETS];
+	uint64_t Contacts;						// Completed contact lifetimes
+
+	// Emitted PTP_REPORT stream
+	uint64_t Reports;
+	uint64_t ReportScanTime[AMTPTP_SCAN_TIME_MAX + 1];
+
+	// Lifetime tracking state
+	uint64_t LastTimestamp;
+	uint64_t ActiveSince[AMTPTP_ANALYZE_MAX_CONTACT_ID];	// Frame number + 1, 0 when inactive
+} AMTPTP_ANALYSIS, *PAMTPTP_ANALYSIS;
+
+void
+AmtPtpAnalyzeInit(
+	PAMTPTP_ANALYSIS Analysis
+);
+
+// Accumulates every remaining record of Reader. Contacts still down at the
+// end of the capture are counted as ending with it.
+AMTPTP_CAPTURE_STATUS
+AmtPtpAnalyzeCapture(
+	PAMTPTP_ANALYSIS Analysis,
+	PAMTPTP_CAPTURE_READER Reader
+);
+
+// Accumulates an emitted report stream of ReportSize-byte reports, in the
+// layout AmtPtpUnpackReport reads for that size (AMTPTP_REPORT_SIZE, or
+// AMTPTP_COMPACT_REPORT_SIZE for the compact builds). Returns the number of
+// multitouch reports counted: reports with another report ID and a trailing
+// partial report are skipped, and any other ReportSize counts nothing.
+uint64_t
+AmtPtpAnalyzeReports(
+	PAMTPTP_ANALYSIS Analysis,
+	const uint8_t *Reports,
+	size_t Length,
+	size_t ReportSize
+);
+
+// Adds Source into Target. Both must use the same timestamp frequency.
+void
+AmtPtpAnalyzeMerge(
+	PAMTPTP_ANALYSIS Target,
+	const AMTPTP_ANALYSIS *Source
+);
+
+// Effective report rate in frames per second
+double
+AmtPtpAnalyzeReportRate(
+	const AMTPTP_ANALYSIS *Analysis
+);
+
+// Decoded frames that never made it into the emitted report stream
+uint64_t
+AmtPtpAnalyzeDropped(
+	const AMTPTP_ANALYSIS *Analysis
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,486 @@
+// AmtPtpBaseline.c: Benchmark result store and regression check
+
+#include "AmtPtpBaseline.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest store line accepted
+#define AMTPTP_BASELINE_LINE_MAX	256
+
+size_t
+AmtPtpBaselineFormat(
+	const char *Commit,
+	const char *Family,
+	const char *Metric,
+	double Value,
+	char *Out,
+	size_t OutSize
+)
+{
+	int w = snprintf(Out, OutSize, "%.40s\t%.31s\t%.31s\t%.9g\n", Commit, Family, Metric, Value);
+
+	return w < 0 || (size_t) w >= OutSize ? 0 : (size_t) w;
+}
+
+static int
+AmtPtpBaselineField(
+	char **Cursor,
+	char *Field,
+	size_t FieldSize
+)
+{
+	char *Tab = strchr(*Cursor, '\t');
+	size_t n;
+
+	if (Tab == NULL) {
+		return 0;
+	}
+
+	n = (size_t) (Tab - *Cursor);
+	if (n == 0 || n >= FieldSize) {
+		return 0;
+	}
+
+	memcpy(Field, *Cursor, n);
+	Field[n] = 0;
+	*Cursor = Tab + 1;
+	return 1;
+}
+
+AMTPTP_BASELINE_STATUS
+AmtPtpBaselineNext(
+	const char *Store,
+	size_t Length,
+	size_t *Offset,
+	PAMTPTP_BASELINE_RECORD Record
+)
+{
+	char Line[AMTPTP_BASELINE_LINE_MAX];
+	char *Cursor, *End;
+	size_t Start, n;
+
+	for (;;) {
+		if (*Offset >= Length) {
+			return AmtPtpBaselineEnd;
+		}
+
+		Start = *Offset;
+		while (*Offset < Length && Store[*Offset] != '\n') {
+			(*Offset)++;
+		}
+		n = *Offset - Start;
+		if (*Offset < Length) {
+			(*Offset)++;
+		}
+
+		// Stores edited on Windows may carry CRLF
+		if (n && Store[Start + n - 1] == '\r') {
+			n--;
+		}
+		if (n) {
+			break;
+		}
+	}
+
+	if (n >= sizeof(Line)) {
+		return AmtPtpBaselineBadRecord;
+	}
+
+	memcpy(Line, Store + Start, n);
+	Line[n] = 0;
+	Cursor = Line;
+
+	if (!AmtPtpBaselineField(&Cursor, Record->Commit, sizeof(Record->Commit)) ||
+		!AmtPtpBaselineField(&Cursor, Record->Family, sizeof(Record->Family)) ||
+		!AmtPtpBaselineField(&Cursor, Record->Metric, sizeof(Record->Metric)) ||
+		*Cursor == 0) {
+		return AmtPtpBaselineBadRecord;
+	}
+
+	Record->Value = strtod(Cursor, &End);
+	return *End == 0 ? AmtPtpBaselineOk : AmtPtpBaselineBadRecord;
+}
+
+static int
+AmtPtpBaselineMatch(
+	const AMTPTP_BASELINE_RECORD *Record,
+	const char *Commit,
+	const char *Family,
+	const char *Metric
+)
+{
+	return strcmp(Record->Commit, Commit) == 0 &&
+		strcmp(Record->Family, Family) == 0 &&
+		strcmp(Record->Metric, Metric) == 0;
+}
+
+AMTPTP_BASELINE_STATUS
+AmtPtpBaselineCollect(
+	const char *Store,
+	size_t Length,
+	const char *Commit,
+	const char *Family,
+	const char *Metric,
+	double *Values,
+	uint32_t Capacity,
+	uint32_t *Count
+)
+{
+	AMTPTP_BASELINE_RECORD Record;
+	AMTPTP_BASELINE_STATUS Status;
+	size_t Offset = 0;
+	int Truncated = 0;
+
+	*Count = 0;
+
+	while ((Status = AmtPtpBaselineNext(Store, Length, &Offset, &Record)) != AmtPtpBaselineEnd) {
+		if (Status != AmtPtpBaselineOk || !AmtPtpBaselineMatch(&Record, Commit, Family, Metric)) {
+			continue;
+		}
+
+		if (*Count < Capacity) {
+			Values[(*Count)++] = Record.Value;
+		}
+		else {
+			Truncated = 1;
+		}
+	}
+
+	return Truncated ? AmtPtpBaselineBufferTooSmall : AmtPtpBaselineOk;
+}
+
+// FNV-1a over the three names, each with its terminator
+static uint32_t
+AmtPtpBaselineHash(
+	const char *Commit,
+	const char *Family,
+	const char *Metric
+)
+{
+	const char *Names[3] = { Commit, Family, Metric };
+	uint32_t Hash = 2166136261u;
+	const char *c;
+	int n;
+
+	for (n = 0; n < 3; n++) {
+		c = Names[n];
+		do {
+			Hash = (Hash ^ (uint8_t) *c) * 16777619u;
+		} while (*c++);
+	}
+
+	return Hash;
+}
+
+// Slot of the series of Commit, Family and Metric, or of the free slot it would take
+static uint32_t *
+AmtPtpBaselineSlot(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *Commit,
+	const char *Family,
+	const char *Metric
+)
+{
+	uint32_t SlotCount = AMTPTP_BASELINE_SLOTS(Index->Capacity);
+	uint32_t i = AmtPtpBaselineHash(Commit, Family, Metric) % SlotCount;
+	const AMTPTP_BASELINE_SERIES *Series;
+
+	// Never more than half full, so the probe ends on a free slot
+	for (;; i = (i + 1) % SlotCount) {
+		if (Index->Slots[i] == 0) {
+			return &Index->Slots[i];
+		}
+
+		Series = &Index->Series[Index->Slots[i] - 1];
+		if (strcmp(Series->Commit, Commit) == 0 && strcmp(Series->Family, Family) == 0 &&
+			strcmp(Series->Metric, Metric) == 0) {
+			return &Index->Slots[i];
+		}
+	}
+}
+
+AMTPTP_BASELINE_STATUS
+AmtPtpBaselineIndex(
+	const char *Store,
+	size_t Length,
+	PAMTPTP_BASELINE_SERIES Series,
+	uint32_t Capacity,
+	uint32_t *Slots,
+	PAMTPTP_BASELINE_INDEX Index
+)
+{
+	AMTPTP_BASELINE_RECORD Record;
+	AMTPTP_BASELINE_STATUS Status;
+	PAMTPTP_BASELINE_SERIES Entry;
+	size_t Offset = 0;
+	uint32_t *Slot;
+	int Truncated = 0;
+
+	Index->Series = Series;
+	Index->Count = 0;
+	Index->Capacity = Capacity;
+	Index->Slots = Slots;
+	if (Capacity == 0) {
+		return Length ? AmtPtpBaselineBufferTooSmall : AmtPtpBaselineOk;
+	}
+	memset(Slots, 0, AMTPTP_BASELINE_SLOTS(Capacity) * sizeof(*Slots));
+
+	while ((Status = AmtPtpBaselineNext(Store, Length, &Offset, &Record)) != AmtPtpBaselineEnd) {
+		if (Status != AmtPtpBaselineOk) {
+			continue;
+		}
+
+		Slot = AmtPtpBaselineSlot(Index, Record.Commit, Record.Family, Record.Metric);
+		if (*Slot == 0) {
+			if (Index->Count == Capacity) {
+				Truncated = 1;
+				continue;
+			}
+
+			Entry = &Series[Index->Count++];
+			memcpy(Entry->Commit, Record.Commit, sizeof(Entry->Commit));
+			memcpy(Entry->Family, Record.Family, sizeof(Entry->Family));
+			memcpy(Entry->Metric, Record.Metric, sizeof(Entry->Metric));
+			Entry->Runs = 0;
+			*Slot = Index->Count;
+		}
+
+		// Beyond AMTPTP_BASELINE_MAX_RUNS the first runs are representative enough
+		Entry = &Series[*Slot - 1];
+		if (Entry->Runs < AMTPTP_BASELINE_MAX_RUNS) {
+			Entry->Values[Entry->Runs] = Record.Value;
+		}
+		Entry->Runs++;
+	}
+
+	return Truncated ? AmtPtpBaselineBufferTooSmall : AmtPtpBaselineOk;
+}
+
+const AMTPTP_BASELINE_SERIES *
+AmtPtpBaselineFind(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *Commit,
+	const char *Family,
+	const char *Metric
+)
+{
+	uint32_t *Slot;
+
+	if (Index->Capacity == 0) {
+		return NULL;
+	}
+
+	Slot = AmtPtpBaselineSlot(Index, Commit, Family, Metric);
+	return *Slot ? &Index->Series[*Slot - 1] : NULL;
+}
+
+static int
+AmtPtpBaselineCompare(
+	const void *pa,
+	const void *pb
+)
+{
+	double a = *(const double *) pa;
+	double b = *(const double *) pb;
+
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// Sorts Values in place
+static double
+AmtPtpBaselineMedian(
+	double *Values,
+	uint32_t Count
+)
+{
+	qsort(Values, Count, sizeof(*Values), AmtPtpBaselineCompare);
+	return Count % 2 ? Values[Count / 2] : (Values[Count / 2 - 1] + Values[Count / 2]) / 2.0;
+}
+
+void
+AmtPtpBaselineSummarize(
+	const double *Values,
+	uint32_t Count,
+	uint32_t Seed,
+	PAMTPTP_BASELINE_SUMMARY Summary
+)
+{
+	double Sample[AMTPTP_BASELINE_MAX_RUNS];
+	double Medians[AMTPTP_BASELINE_RESAMPLES];
+	uint32_t i, r;
+
+	if (Count > AMTPTP_BASELINE_MAX_RUNS) {
+		Count = AMTPTP_BASELINE_MAX_RUNS;
+	}
+
+	Summary->Runs = Count;
+	Summary->Median = Summary->Low = Summary->High = 0.0;
+	if (Count == 0) {
+		return;
+	}
+
+	memcpy(Sample, Values, Count * sizeof(*Values));
+	Summary->Median = AmtPtpBaselineMedian(Sample, Count);
+
+	// xorshift32 needs a non-zero state
+	if (Seed == 0) {
+		Seed = 2463534242u;
+	}
+
+	for (r = 0; r < AMTPTP_BASELINE_RESAMPLES; r++) {
+		for (i = 0; i < Count; i++) {
+			Seed ^= Seed << 13; Seed ^= Seed >> 17; Seed ^= Seed << 5;
+			Sample[i] = Values[Seed % Count];
+		}
+		Medians[r] = AmtPtpBaselineMedian(Sample, Count);
+	}
+
+	qsort(Medians, AMTPTP_BASELINE_RESAMPLES, sizeof(*Medians), AmtPtpBaselineCompare);
+	Summary->Low = Medians[AMTPTP_BASELINE_RESAMPLES * 25 / 1000];
+	Summary->High = Medians[AMTPTP_BASELINE_RESAMPLES * 975 / 1000 - 1];
+}
+
+int
+AmtPtpBaselineRegressed(
+	const AMTPTP_BASELINE_SUMMARY *Baseline,
+	const AMTPTP_BASELINE_SUMMARY *Current,
+	double Threshold
+)
+{
+	if (Baseline->Runs == 0 || Current->Runs == 0) {
+		return 0;
+	}
+
+	return Current->Median > Baseline->Median * (1.0 + Threshold) &&
+		Current->Low > Baseline->High;
+}
+
+static void
+AmtPtpBaselinePrint(
+	char *Out,
+	size_t OutSize,
+	size_t *Length,
+	const char *Format,
+	...
+)
+{
+	va_list Args;
+	int w;
+
+	if (*Length + 1 >= OutSize) {
+		return;
+	}
+
+	va_start(Args, Format);
+	w = vsnprintf(Out + *Length, OutSize - *Length, Format, Args);
+	va_end(Args);
+
+	if (w > 0) {
+		*Length += (size_t) w;
+		if (*Length >= OutSize) {
+			*Length = OutSize - 1;
+		}
+	}
+}
+
+static void
+AmtPtpBaselineLoad(
+	const AMTPTP_BASELINE_SERIES *Series,
+	PAMTPTP_BASELINE_SUMMARY Summary
+)
+{
+	AmtPtpBaselineSummarize(Series->Values, Series->Runs, 1, Summary);
+}
+
+uint32_t
+AmtPtpBaselineCheck(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *BaseCommit,
+	const char *Commit,
+	double Threshold,
+	char *Out,
+	size_t OutSize
+)
+{
+	const AMTPTP_BASELINE_SERIES *Series, *BaseSeries;
+	AMTPTP_BASELINE_SUMMARY Base, Current;
+	size_t Written = 0;
+	uint32_t Regressions = 0, i;
+	int Regressed;
+
+	if (OutSize) {
+		Out[0] = 0;
+	}
+
+	for (i = 0; i < Index->Count; i++) {
+		Series = &Index->Series[i];
+		if (strcmp(Series->Commit, Commit) != 0) {
+			continue;
+		}
+
+		AmtPtpBaselineLoad(Series, &Current);
+		BaseSeries = AmtPtpBaselineFind(Index, BaseCommit, Series->Family, Series->Metric);
+		if (BaseSeries == NULL) {
+			AmtPtpBaselinePrint(Out, OutSize, &Written, "%s %s: new %.3f [%.3f, %.3f] n=%u\n",
+				Series->Family, Series->Metric, Current.Median, Current.Low, Current.High, (unsigned) Current.Runs);
+			continue;
+		}
+
+		AmtPtpBaselineLoad(BaseSeries, &Base);
+		Regressed = AmtPtpBaselineRegressed(&Base, &Current, Threshold);
+		Regressions += Regressed ? 1 : 0;
+
+		AmtPtpBaselinePrint(Out, OutSize, &Written, "%s %s: %.3f [%.3f, %.3f] n=%u -> %.3f [%.3f, %.3f] n=%u (%+.1f%%)%s\n",
+			Series->Family, Series->Metric,
+			Base.Median, Base.Low, Base.High, (unsigned) Base.Runs,
+			Current.Median, Current.Low, Current.High, (unsigned) Current.Runs,
+			Base.Median != 0.0 ? (Current.Median / Base.Median - 1.0) * 100.0 : 0.0,
+			Regressed ? " REGRESSION" : "");
+	}
+
+	return Regressions;
+}
+
+size_t
+AmtPtpBaselineHistory(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *Family,
+	const char *Metric,
+	char *Out,
+	size_t OutSize
+)
+{
+	const AMTPTP_BASELINE_SERIES *Series;
+	AMTPTP_BASELINE_SUMMARY Summary;
+	size_t Written = 0;
+	double Previous = 0.0;
+	uint32_t i;
+
+	if (OutSize == 0) {
+		return 0;
+	}
+	Out[0] = 0;
+
+	AmtPtpBaselinePrint(Out, OutSize, &Written, "%s %s\n", Family, Metric);
+
+	for (i = 0; i < Index->Count; i++) {
+		Series = &Index->Series[i];
+		if (strcmp(Series->Family, Family) != 0 || strcmp(Series->Metric, Metric) != 0) {
+			continue;
+		}
+
+		AmtPtpBaselineLoad(Series, &Summary);
+		AmtPtpBaselinePrint(Out, OutSize, &Written, "  %-40s %12.3f [%.3f, %.3f] n=%u",
+			Series->Commit, Summary.Median, Summary.Low, Summary.High, (unsigned) Summary.Runs);
+		if (Previous != 0.0) {
+			AmtPtpBaselinePrint(Out, OutSize, &Written, " %+.1f%%", (Summary.Median / Previous - 1.0) * 100.0);
+		}
+		AmtPtpBaselinePrint(Out, OutSize, &Written, "\n");
+		Previous = Summary.Median;
+	}
+
+	return Written;
+}
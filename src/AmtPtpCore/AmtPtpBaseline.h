@@ -0,0 +1,186 @@
+// AmtPtpBaseline.h: Benchmark result store and regression check
+//
+// Results are kept as text, one record per line:
+//
+//   <commit> TAB <family> TAB <metric> TAB <value> LF
+//
+// so the store is a plain file the runner appends to and that merges and
+// diffs cleanly. Repeated runs of one commit are separate records. Every
+// metric is a cost: ns_per_frame from AmtPtpBench, p99_us from AmtPtpResume
+// and so on, where larger is worse.
+//
+// Comparisons use the median of the runs with a bootstrap confidence interval,
+// which neither a single outlier nor a skewed distribution moves much. A
+// metric regresses when its median grew by more than the threshold and the
+// two confidence intervals do not overlap.
+//
+// A store is read once into an index of its series, one per commit, family
+// and metric, which the check and the history then walk. Like the other
+// modules this works on caller buffers only; reading and appending the file,
+// and the exit code, are up to the runner, AmtPtpBaseline.
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_BASELINE_COMMIT_SIZE		41		// SHA-1 in hex plus terminator
+#define AMTPTP_BASELINE_NAME_SIZE		32
+
+// Runs of one commit, family and metric taken into account
+#define AMTPTP_BASELINE_MAX_RUNS		64
+
+// Bootstrap resamples per summary
+#define AMTPTP_BASELINE_RESAMPLES		1000
+
+typedef enum _AMTPTP_BASELINE_STATUS {
+	AmtPtpBaselineOk,
+	AmtPtpBaselineEnd,				// No more records
+	AmtPtpBaselineBadRecord,		// Line is not four fields with a number last
+	AmtPtpBaselineBufferTooSmall
+} AMTPTP_BASELINE_STATUS;
+
+typedef struct _AMTPTP_BASELINE_RECORD {
+	char Commit[AMTPTP_BASELINE_COMMIT_SIZE];
+	char Family[AMTPTP_BASELINE_NAME_SIZE];
+	char Metric[AMTPTP_BASELINE_NAME_SIZE];
+	double Value;
+} AMTPTP_BASELINE_RECORD, *PAMTPTP_BASELINE_RECORD;
+
+// Runs of one commit, family and metric
+typedef struct _AMTPTP_BASELINE_SERIES {
+	char Commit[AMTPTP_BASELINE_COMMIT_SIZE];
+	char Family[AMTPTP_BASELINE_NAME_SIZE];
+	char Metric[AMTPTP_BASELINE_NAME_SIZE];
+	uint32_t Runs;					// Records in the store; Values holds the first ones
+	double Values[AMTPTP_BASELINE_MAX_RUNS];
+} AMTPTP_BASELINE_SERIES, *PAMTPTP_BASELINE_SERIES;
+
+// Hash table slots an index of Capacity series needs
+#define AMTPTP_BASELINE_SLOTS(Capacity)	(2 * (Capacity))
+
+typedef struct _AMTPTP_BASELINE_INDEX {
+	PAMTPTP_BASELINE_SERIES Series;	// In the order each first appears in the store
+	uint32_t Count;
+	uint32_t Capacity;
+	uint32_t *Slots;				// Series number plus one, 0 when free
+} AMTPTP_BASELINE_INDEX, *PAMTPTP_BASELINE_INDEX;
+
+typedef struct _AMTPTP_BASELINE_SUMMARY {
+	uint32_t Runs;
+	double Median;
+	double Low;						// 95% bootstrap interval of the median
+	double High;
+} AMTPTP_BASELINE_SUMMARY, *PAMTPTP_BASELINE_SUMMARY;
+
+// Formats one record as a store line, including the line feed. Names longer
+// than the record fields are cut. Returns the number of characters written,
+// excluding the terminator, or 0 if Out is too small.
+size_t
+AmtPtpBaselineFormat(
+	const char *Commit,
+	const char *Family,
+	const char *Metric,
+	double Value,
+	char *Out,
+	size_t OutSize
+);
+
+// Parses the record at *Offset and moves *Offset past its line. Empty lines
+// are skipped; a bad record is skipped too, so the caller may continue.
+AMTPTP_BASELINE_STATUS
+AmtPtpBaselineNext(
+	const char *Store,
+	size_t Length,
+	size_t *Offset,
+	PAMTPTP_BASELINE_RECORD Record
+);
+
+// Collects the values of every record matching Commit, Family and Metric.
+// Returns AmtPtpBaselineBufferTooSmall when more than Capacity match; the
+// first Capacity values are still returned.
+AMTPTP_BASELINE_STATUS
+AmtPtpBaselineCollect(
+	const char *Store,
+	size_t Length,
+	const char *Commit,
+	const char *Family,
+	const char *Metric,
+	double *Values,
+	uint32_t Capacity,
+	uint32_t *Count
+);
+
+// Reads every record of Store into Index, a pass over the store. Series holds
+// Capacity entries and Slots AMTPTP_BASELINE_SLOTS(Capacity). Returns
+// AmtPtpBaselineBufferTooSmall when the store has more series than that; the
+// records of the first Capacity are still indexed.
+AMTPTP_BASELINE_STATUS
+AmtPtpBaselineIndex(
+	const char *Store,
+	size_t Length,
+	PAMTPTP_BASELINE_SERIES Series,
+	uint32_t Capacity,
+	uint32_t *Slots,
+	PAMTPTP_BASELINE_INDEX Index
+);
+
+// Returns the series of Commit, Family and Metric, or NULL if none
+const AMTPTP_BASELINE_SERIES *
+AmtPtpBaselineFind(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *Commit,
+	const char *Family,
+	const char *Metric
+);
+
+// Median and bootstrap interval of Values. Seed makes the resampling
+// reproducible; the same seed and values give the same summary.
+void
+AmtPtpBaselineSummarize(
+	const double *Values,
+	uint32_t Count,
+	uint32_t Seed,
+	PAMTPTP_BASELINE_SUMMARY Summary
+);
+
+// Returns non-zero when Current is a regression from Baseline by more than
+// Threshold, e.g. 0.05 for 5%.
+int
+AmtPtpBaselineRegressed(
+	const AMTPTP_BASELINE_SUMMARY *Baseline,
+	const AMTPTP_BASELINE_SUMMARY *Current,
+	double Threshold
+);
+
+// Compares every family and metric recorded for Commit with BaseCommit and
+// writes one line per comparison to Out. Pairs missing from BaseCommit are
+// listed as new. Returns the number of regressions, which the runner turns
+// into its exit code.
+uint32_t
+AmtPtpBaselineCheck(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *BaseCommit,
+	const char *Commit,
+	double Threshold,
+	char *Out,
+	size_t OutSize
+);
+
+// Renders the history of one family and metric, one line per commit in the
+// order the commits first appear in the store.
+size_t
+AmtPtpBaselineHistory(
+	const AMTPTP_BASELINE_INDEX *Index,
+	const char *Family,
+	const char *Metric,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,473 @@
+// AmtPtpBatch.c: Structure-of-arrays decode of every finger record in a frame
+
+#include "AmtPtpBatch.h"
+#include "AmtPtpLayout.h"
+#include "AmtPtpSynth.h"
+
+#include <stdio.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AMTPTP_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+// Largest frame of any family: TYPE4 header plus 16 fingers
+#define AMTPTP_BATCH_FRAME_MAX		(46 + AMTPTP_SYNTH_MAX_FINGERS * 30)
+
+// Beyond this XMin, YMin or YMax, the translation may overflow 32 bits
+#define AMTPTP_BATCH_RANGE_MAX		(1 << 30)
+
+static const char *AmtPtpBatchKernelNames[AmtPtpBatchKernelCount] = { "scalar", "sse2" };
+
+static inline int32_t
+AmtPtpBatchReadS16(
+	const uint8_t *p
+)
+{
+	return (int16_t) (uint16_t) (p[0] | (p[1] << 8));
+}
+
+int
+AmtPtpBatchKernelAvailable(
+	AMTPTP_BATCH_KERNEL Kernel
+)
+{
+	switch (Kernel) {
+		case AmtPtpBatchKernelScalar:
+			return 1;
+#ifdef AMTPTP_BATCH_SSE2
+		case AmtPtpBatchKernelSse2:
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+const char *
+AmtPtpBatchKernelName(
+	AMTPTP_BATCH_KERNEL Kernel
+)
+{
+	return (unsigned) Kernel < AmtPtpBatchKernelCount ? AmtPtpBatchKernelNames[Kernel] : "unknown";
+}
+
+void
+AmtPtpBatchInit(
+	PAMTPTP_BATCH_DECODER Batch,
+	const AMTPTP_DECODER *Decoder
+)
+{
+	Batch->Decoder = *Decoder;
+	Batch->Kernel = AmtPtpBatchKernelScalar;
+
+	if (Decoder->XMin < -AMTPTP_BATCH_RANGE_MAX || Decoder->XMin > AMTPTP_BATCH_RANGE_MAX ||
+		Decoder->YMin < -AMTPTP_BATCH_RANGE_MAX || Decoder->YMin > AMTPTP_BATCH_RANGE_MAX ||
+		Decoder->YMax < -AMTPTP_BATCH_RANGE_MAX || Decoder->YMax > AMTPTP_BATCH_RANGE_MAX) {
+		return;
+	}
+
+#ifdef AMTPTP_BATCH_SSE2
+	Batch->Kernel = AmtPtpBatchKernelSse2;
+#endif
+}
+
+// Y lanes hold the value subtracted from this. TYPE5 Y is flipped by the
+// unpacker already, so its lanes hold -y and y - YMin is -YMin - (-y).
+static inline int64_t
+AmtPtpBatchYBase(
+	const AMTPTP_DECODER *Decoder
+)
+{
+	return Decoder->Format == AmtPtpFrameFormatType5 ? -(int64_t) Decoder->YMin : Decoder->YMax;
+}
+
+// TYPE5 record bytes 0 - 3 (X and Y bit fields), 4 - 7 (TouchMajor, TouchMinor,
+// Size, Pressure) and 8 (Id in the low nibble, Orientation in the high one)
+typedef struct _AMTPTP_BATCH_TYPE5 {
+	uint32_t Position[AMTPTP_BATCH_MAX_CONTACTS];
+	uint32_t Size[AMTPTP_BATCH_MAX_CONTACTS];
+	uint32_t Identifier[AMTPTP_BATCH_MAX_CONTACTS];
+} AMTPTP_BATCH_TYPE5, *PAMTPTP_BATCH_TYPE5;
+
+// Reference unpacker, the same expressions as AmtPtpDecodeType5Finger
+static void
+AmtPtpBatchUnpackType5Scalar(
+	const AMTPTP_BATCH_TYPE5 *r,
+	PAMTPTP_CONTACT_BATCH c
+)
+{
+	uint32_t Raw, i;
+	int32_t x, y;
+
+	for (i = 0; i < c->Count; i++) {
+		Raw = r->Position[i];
+		x = (int32_t) (Raw & 0x1fff) - ((Raw & 0x1000) ? 0x2000 : 0);
+		y = (int32_t) (-(int64_t) (int32_t) (Raw << 6) >> 19);
+
+		c->X[i] = x;
+		c->Y[i] = -y;
+		c->Major[i] = (int32_t) (r->Size[i] & 0xFF) * 2;
+		c->Minor[i] = (int32_t) ((r->Size[i] >> 8) & 0xFF) * 2;
+		c->Pressure[i] = (int32_t) (r->Size[i] >> 24);
+		c->ContactID[i] = (int32_t) (r->Identifier[i] & 0xF);
+	}
+}
+
+// Same semantics as AmtPtpDecodeFrame, one lane at a time
+static void
+AmtPtpBatchKernelScalarRun(
+	const AMTPTP_DECODER *Decoder,
+	PAMTPTP_CONTACT_BATCH c
+)
+{
+	const int64_t YBase = AmtPtpBatchYBase(Decoder);
+	AMTPTP_CONTACT_SIZE Size;
+	uint8_t TipSwitch, Confidence;
+	int64_t x, y;
+	uint32_t i;
+
+	for (i = 0; i < c->Count; i++) {
+		x = (int64_t) c->X[i] - Decoder->XMin;
+		y = YBase - c->Y[i];
+		c->X[i] = x <= 0 ? 0 : (x > 0xFFFF ? 0xFFFF : (int32_t) x);
+		c->Y[i] = y <= 0 ? 0 : (y > 0xFFFF ? 0xFFFF : (int32_t) y);
+
+		Size.Major = c->Major[i];
+		Size.Minor = c->Minor[i];
+		Size.Pressure = c->Pressure[i];
+		AmtPtpQualifyContact(&Decoder->Thresholds, &Size, &TipSwitch, &Confidence);
+		c->TipSwitch[i] = TipSwitch;
+		c->Confidence[i] = Confidence;
+	}
+}
+
+#ifdef AMTPTP_BATCH_SSE2
+static inline __m128i
+AmtPtpBatchClampSse2(
+	__m128i v
+)
+{
+	const __m128i Max = _mm_set1_epi32(0xFFFF);
+	__m128i Over;
+
+	v = _mm_and_si128(v, _mm_cmpgt_epi32(v, _mm_setzero_si128()));
+	Over = _mm_cmpgt_epi32(v, Max);
+	return _mm_or_si128(_mm_and_si128(Over, Max), _mm_andnot_si128(Over, v));
+}
+
+// v >= t where t is enabled, all ones or zero per lane
+static inline __m128i
+AmtPtpBatchAtLeastSse2(
+	__m128i v,
+	int32_t t
+)
+{
+	return t ? _mm_andnot_si128(_mm_cmpgt_epi32(_mm_set1_epi32(t), v), _mm_set1_epi32(-1)) : _mm_setzero_si128();
+}
+
+// The vector Y expression avoids negating in 64 bits: -v >> 19 is
+// (~v >> 19) + 1 exactly when the low 19 bits of v are zero.
+static void
+AmtPtpBatchUnpackType5Sse2(
+	const AMTPTP_BATCH_TYPE5 *r,
+	PAMTPTP_CONTACT_BATCH c
+)
+{
+	const __m128i Low19 = _mm_set1_epi32(0x7FFFF);
+	__m128i Raw, v, y, Size;
+	uint32_t i;
+
+	for (i = 0; i < AMTPTP_BATCH_MAX_CONTACTS; i += 4) {
+		Raw = _mm_loadu_si128((const __m128i *) &r->Position[i]);
+		_mm_storeu_si128((__m128i *) &c->X[i], _mm_srai_epi32(_mm_slli_epi32(Raw, 19), 19));
+
+		v = _mm_slli_epi32(Raw, 6);
+		y = _mm_srai_epi32(_mm_xor_si128(v, _mm_set1_epi32(-1)), 19);
+		y = _mm_sub_epi32(y, _mm_cmpeq_epi32(_mm_and_si128(v, Low19), _mm_setzero_si128()));
+		_mm_storeu_si128((__m128i *) &c->Y[i], _mm_sub_epi32(_mm_setzero_si128(), y));
+
+		Size = _mm_loadu_si128((const __m128i *) &r->Size[i]);
+		_mm_storeu_si128((__m128i *) &c->Major[i], _mm_slli_epi32(_mm_and_si128(Size, _mm_set1_epi32(0xFF)), 1));
+		_mm_storeu_si128((__m128i *) &c->Minor[i], _mm_and_si128(_mm_srli_epi32(Size, 7), _mm_set1_epi32(0x1FE)));
+		_mm_storeu_si128((__m128i *) &c->Pressure[i], _mm_srli_epi32(Size, 24));
+		_mm_storeu_si128((__m128i *) &c->ContactID[i],
+			_mm_and_si128(_mm_loadu_si128((const __m128i *) &r->Identifier[i]), _mm_set1_epi32(0xF)));
+	}
+}
+
+static void
+AmtPtpBatchKernelSse2Run(
+	const AMTPTP_DECODER *Decoder,
+	PAMTPTP_CONTACT_BATCH c
+)
+{
+	const AMTPTP_THRESHOLDS *t = &Decoder->Thresholds;
+	const __m128i XMin = _mm_set1_epi32(Decoder->XMin);
+	const __m128i YBase = _mm_set1_epi32((int32_t) AmtPtpBatchYBase(Decoder));
+	const __m128i Count = _mm_set1_epi32((int32_t) c->Count);
+	__m128i Lane = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i Valid, Major, Minor, Pressure, Tip, Reject, v;
+	uint32_t i;
+
+	for (i = 0; i < AMTPTP_BATCH_MAX_CONTACTS; i += 4, Lane = _mm_add_epi32(Lane, _mm_set1_epi32(4))) {
+		Valid = _mm_cmpgt_epi32(Count, Lane);
+
+		v = _mm_loadu_si128((const __m128i *) &c->X[i]);
+		v = AmtPtpBatchClampSse2(_mm_sub_epi32(v, XMin));
+		_mm_storeu_si128((__m128i *) &c->X[i], _mm_and_si128(v, Valid));
+
+		v = _mm_loadu_si128((const __m128i *) &c->Y[i]);
+		v = AmtPtpBatchClampSse2(_mm_sub_epi32(YBase, v));
+		_mm_storeu_si128((__m128i *) &c->Y[i], _mm_and_si128(v, Valid));
+
+		Major = _mm_loadu_si128((const __m128i *) &c->Major[i]);
+		Minor = _mm_loadu_si128((const __m128i *) &c->Minor[i]);
+		Pressure = _mm_loadu_si128((const __m128i *) &c->Pressure[i]);
+
+		Tip = _mm_or_si128(_mm_or_si128(
+			AmtPtpBatchAtLeastSse2(Major, t->TipSwitchMajor),
+			AmtPtpBatchAtLeastSse2(Minor, t->TipSwitchMinor)),
+			AmtPtpBatchAtLeastSse2(Pressure, t->TipSwitchPressure));
+
+		// Minor below ConfidenceMinorMin is the complement of Minor at least that
+		Reject = _mm_or_si128(_mm_or_si128(
+			t->ConfidenceMinorMin ? _mm_cmpgt_epi32(_mm_set1_epi32(t->ConfidenceMinorMin), Minor) : _mm_setzero_si128(),
+			AmtPtpBatchAtLeastSse2(Minor, t->ConfidenceMinorMax)),
+			AmtPtpBatchAtLeastSse2(Major, t->ConfidenceMajorMax));
+
+		_mm_storeu_si128((__m128i *) &c->TipSwitch[i], _mm_srli_epi32(_mm_and_si128(Tip, Valid), 31));
+		_mm_storeu_si128((__m128i *) &c->Confidence[i], _mm_srli_epi32(_mm_andnot_si128(Reject, Valid), 31));
+	}
+}
+#endif
+
+AMTPTP_DECODE_STATUS
+AmtPtpBatchDecode(
+	const AMTPTP_BATCH_DECODER *Batch,
+	const uint8_t *Buffer,
+	size_t Length,
+	PAMTPTP_CONTACT_BATCH Contacts
+)
+{
+	const AMTPTP_DECODER *d = &Batch->Decoder;
+	AMTPTP_CONTACT_BATCH Empty = { 0 };
+	AMTPTP_BATCH_TYPE5 Type5 = { 0 };
+	PAMTPTP_CONTACT_BATCH c = Contacts;
+	size_t Count, ReadSize, i;
+	const uint8_t *f;
+
+	*c = Empty;
+
+	switch (d->Format) {
+		case AmtPtpFrameFormatWellspring:
+			ReadSize = WELLSPRING_FINGER_READ;
+			break;
+		case AmtPtpFrameFormatType5:
+			ReadSize = TYPE5_FINGER_READ;
+			break;
+		case AmtPtpFrameFormatSpi:
+			ReadSize = SPI_FINGER_READ;
+			break;
+		default:
+			return AmtPtpDecodeUnsupported;
+	}
+
+	// The same checks as AmtPtpDecodeFrame, only the contact limit differs
+	if (d->FingerSize < d->FingerDelta + ReadSize) {
+		return AmtPtpDecodeUnsupported;
+	}
+
+	if (Buffer == NULL || Length < d->HeaderSize) {
+		return AmtPtpDecodeMalformed;
+	}
+
+	if (d->Format == AmtPtpFrameFormatSpi) {
+		Count = Buffer[SPI_NUM_OF_FINGERS];
+		if (Count > (Length - d->HeaderSize) / d->FingerSize) {
+			Count = (Length - d->HeaderSize) / d->FingerSize;
+		}
+	}
+	else {
+		if ((Length - d->HeaderSize) % d->FingerSize != 0) {
+			return AmtPtpDecodeMalformed;
+		}
+		Count = (Length - d->HeaderSize) / d->FingerSize;
+	}
+
+	if (Count > AMTPTP_BATCH_MAX_CONTACTS) {
+		Count = AMTPTP_BATCH_MAX_CONTACTS;
+	}
+
+	c->Count = (uint32_t) Count;
+	if (d->ButtonOffset < Length) {
+		c->IsButtonClicked = Buffer[d->ButtonOffset] ? 1 : 0;
+	}
+
+	// Gather raw coordinates and sizes in threshold units into the lanes
+	f = Buffer + d->HeaderSize + d->FingerDelta;
+	switch (d->Format) {
+		case AmtPtpFrameFormatWellspring:
+			// Pressure is outside the record on TYPE2 and TYPE3
+			for (i = 0; i < Count; i++, f += d->FingerSize) {
+				c->X[i] = AmtPtpBatchReadS16(f + WELLSPRING_ABS_X);
+				c->Y[i] = AmtPtpBatchReadS16(f + WELLSPRING_ABS_Y);
+				c->ContactID[i] = (int32_t) i;
+				c->Major[i] = AmtPtpBatchReadS16(f + WELLSPRING_TOUCH_MAJOR) * 2;
+				c->Minor[i] = AmtPtpBatchReadS16(f + WELLSPRING_TOUCH_MINOR) * 2;
+			}
+			break;
+		case AmtPtpFrameFormatType5:
+			// Records are 9 bytes apart, so no wider read would be aligned
+			for (i = 0; i < Count; i++, f += d->FingerSize) {
+				Type5.Position[i] = (uint32_t) f[0] | ((uint32_t) f[1] << 8) |
+					((uint32_t) f[2] << 16) | ((uint32_t) f[3] << 24);
+				Type5.Size[i] = (uint32_t) f[TYPE5_TOUCH_MAJOR] | ((uint32_t) f[TYPE5_TOUCH_MINOR] << 8) |
+					((uint32_t) f[TYPE5_SIZE] << 16) | ((uint32_t) f[TYPE5_PRESSURE] << 24);
+				Type5.Identifier[i] = f[TYPE5_IDENTIFIER];
+			}
+
+			switch (Batch->Kernel) {
+#ifdef AMTPTP_BATCH_SSE2
+				case AmtPtpBatchKernelSse2:
+					AmtPtpBatchUnpackType5Sse2(&Type5, c);
+					break;
+#endif
+				default:
+					AmtPtpBatchUnpackType5Scalar(&Type5, c);
+					break;
+			}
+			break;
+		default:
+			for (i = 0; i < Count; i++, f += d->FingerSize) {
+				c->X[i] = AmtPtpBatchReadS16(f + SPI_X);
+				c->Y[i] = AmtPtpBatchReadS16(f + SPI_Y);
+				c->ContactID[i] = (int32_t) i;
+				c->Major[i] = AmtPtpBatchReadS16(f + SPI_TOUCH_MAJOR);
+				c->Minor[i] = AmtPtpBatchReadS16(f + SPI_TOUCH_MINOR);
+				c->Pressure[i] = AmtPtpBatchReadS16(f + SPI_PRESSURE);
+			}
+			break;
+	}
+
+	switch (Batch->Kernel) {
+#ifdef AMTPTP_BATCH_SSE2
+		case AmtPtpBatchKernelSse2:
+			AmtPtpBatchKernelSse2Run(d, c);
+			break;
+#endif
+		default:
+			AmtPtpBatchKernelScalarRun(d, c);
+			break;
+	}
+
+	return AmtPtpDecodeOk;
+}
+
+int
+AmtPtpBatchBenchRun(
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint32_t Fingers,
+	uint64_t Frames,
+	AMTPTP_BATCH_KERNEL Kernel,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	PAMTPTP_BATCH_BENCH_RESULT Result
+)
+{
+	static uint8_t FrameSet[AMTPTP_BENCH_FRAME_SET][AMTPTP_BATCH_FRAME_MAX];
+	size_t FrameLength[AMTPTP_BENCH_FRAME_SET];
+	AMTPTP_BATCH_DECODER Batch;
+	AMTPTP_DECODER Decoder;
+	AMTPTP_GESTURE_SCRIPT Script;
+	AMTPTP_SYNTH_FRAME Synth;
+	AMTPTP_CONTACT_BATCH Contacts;
+	uint64_t Start[AMTPTP_BENCH_MAX_COUNTERS];
+	volatile uint32_t Sink = 0;
+	uint32_t Checksum = 0;
+	uint64_t n;
+	uint32_t i, k;
+
+	if (Fingers > AMTPTP_SYNTH_MAX_FINGERS ||
+		(Family->Decoder.Format == AmtPtpFrameFormatSpi && Fingers > AMTPTP_SYNTH_SPI_MAX_FINGERS)) {
+		return 1;
+	}
+
+	AmtPtpBenchInitDecoder(Family, &Decoder);
+	AmtPtpBatchInit(&Batch, &Decoder);
+	Batch.Kernel = AmtPtpBatchKernelAvailable(Kernel) ? Kernel : AmtPtpBatchKernelScalar;
+
+	Script.Gesture = AmtPtpGestureRotate;
+	Script.Fingers = Fingers;
+	Script.Width = Family->XMax - Family->Decoder.XMin;
+	Script.Height = Family->Decoder.YMax - Family->Decoder.YMin;
+	Script.Frames = AMTPTP_BENCH_FRAME_SET;
+
+	for (i = 0; i < AMTPTP_BENCH_FRAME_SET; i++) {
+		AmtPtpSynthGestureFrame(&Script, i, &Synth);
+		Synth.Button = (uint8_t) (i & 1);
+		FrameLength[i] = AmtPtpSynthEncodeFrame(&Decoder, &Synth, FrameSet[i], sizeof(FrameSet[i]));
+		if (FrameLength[i] == 0) {
+			return 1;
+		}
+	}
+
+	Result->Family = Family->Name;
+	Result->Fingers = Fingers;
+	Result->Kernel = Batch.Kernel;
+	Result->Frames = Frames;
+
+	for (k = 0; k < Counters->Count; k++) {
+		Start[k] = Counters->Read[k](Counters->Context);
+	}
+
+	for (n = 0; n < Frames; n++) {
+		i = (uint32_t) (n % AMTPTP_BENCH_FRAME_SET);
+		AmtPtpBatchDecode(&Batch, FrameSet[i], FrameLength[i], &Contacts);
+		Checksum += Contacts.Count + (uint32_t) Contacts.X[0] + (uint32_t) Contacts.TipSwitch[Fingers ? Fingers - 1 : 0];
+	}
+
+	// Read the counters in reverse so each brackets the others symmetrically
+	for (k = Counters->Count; k-- > 0;) {
+		Result->Counts[k] = Counters->Read[k](Counters->Context) - Start[k];
+	}
+
+	// Keeps the compiler from discarding the loop
+	Sink = Checksum;
+	(void) Sink;
+	return 0;
+}
+
+size_t
+AmtPtpBatchBenchFormat(
+	const AMTPTP_BATCH_BENCH_RESULT *Result,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	char *Out,
+	size_t OutSize
+)
+{
+	size_t Length;
+	uint32_t k;
+	int w;
+
+	if (OutSize == 0) {
+		return 0;
+	}
+
+	w = snprintf(Out, OutSize, "{\"family\":\"%s\",\"fingers\":%u,\"kernel\":\"%s\",\"frames\":%llu",
+		Result->Family, (unsigned) Result->Fingers, AmtPtpBatchKernelName(Result->Kernel),
+		(unsigned long long) Result->Frames);
+	Length = w < 0 ? 0 : (size_t) w;
+
+	for (k = 0; k < Counters->Count && Length < OutSize; k++) {
+		w = snprintf(Out + Length, OutSize - Length, ",\"%s_per_frame\":%.3f", Counters->Names[k],
+			Result->Frames ? (double) Result->Counts[k] / (double) Result->Frames : 0.0);
+		Length += w < 0 ? 0 : (size_t) w;
+	}
+
+	if (Length < OutSize) {
+		w = snprintf(Out + Length, OutSize - Length, "}");
+		Length += w < 0 ? 0 : (size_t) w;
+	}
+
+	return Length < OutSize ? Length : OutSize - 1;
+}
@@ -0,0 +1,117 @@
+// AmtPtpBatch.h: Structure-of-arrays decode of every finger record in a frame
+//
+// AmtPtpDecodeFrame stops at AMTPTP_MAX_CONTACTS because that is all a PTP
+// report carries. Host-side tooling often wants every record a frame holds,
+// up to MAX_FINGERS, and decodes millions of frames. This decodes all of them
+// into one array per field, so that translation, clamping and qualification
+// run as a few vector operations over 16 lanes:
+//
+//   1. gather   the fields of each record into 32-bit lanes (scalar). TYPE5
+//               records are 9 bytes apart, so they are read byte-wise and
+//               their bit fields are unpacked in the lanes.
+//   2. kernel   X, Y, TipSwitch and Confidence for all lanes
+//
+// Kernels are SSE2 on x86 and x64 and a scalar loop elsewhere; both are
+// bit-exact with AmtPtpDecodeFrame.
+
+#pragma once
+
+#include "AmtPtpBench.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Finger records decoded per frame (MAX_FINGERS)
+#define AMTPTP_BATCH_MAX_CONTACTS	16
+
+typedef enum _AMTPTP_BATCH_KERNEL {
+	AmtPtpBatchKernelScalar,
+	AmtPtpBatchKernelSse2,
+	AmtPtpBatchKernelCount
+} AMTPTP_BATCH_KERNEL;
+
+// Lanes past Count are zero
+typedef struct _AMTPTP_CONTACT_BATCH {
+	uint32_t Count;
+	uint8_t IsButtonClicked;
+	int32_t X[AMTPTP_BATCH_MAX_CONTACTS];
+	int32_t Y[AMTPTP_BATCH_MAX_CONTACTS];
+	int32_t ContactID[AMTPTP_BATCH_MAX_CONTACTS];
+	int32_t Major[AMTPTP_BATCH_MAX_CONTACTS];		// AMTPTP_CONTACT_SIZE units
+	int32_t Minor[AMTPTP_BATCH_MAX_CONTACTS];
+	int32_t Pressure[AMTPTP_BATCH_MAX_CONTACTS];
+	int32_t TipSwitch[AMTPTP_BATCH_MAX_CONTACTS];	// 0 or 1
+	int32_t Confidence[AMTPTP_BATCH_MAX_CONTACTS];	// 0 or 1
+} AMTPTP_CONTACT_BATCH, *PAMTPTP_CONTACT_BATCH;
+
+typedef struct _AMTPTP_BATCH_DECODER {
+	AMTPTP_DECODER Decoder;
+	AMTPTP_BATCH_KERNEL Kernel;
+} AMTPTP_BATCH_DECODER, *PAMTPTP_BATCH_DECODER;
+
+// Copies Decoder and selects the fastest kernel this build and decoder
+// allow. The vector kernels compute in 32 bits, so decoders whose XMin, YMin
+// or YMax lie outside +/- 2^30 get the scalar kernel. Kernel may be
+// overridden afterwards for decoders within that range; kernels missing from
+// the build fall back to scalar.
+void
+AmtPtpBatchInit(
+	PAMTPTP_BATCH_DECODER Batch,
+	const AMTPTP_DECODER *Decoder
+);
+
+// Whether Kernel is compiled into this build
+int
+AmtPtpBatchKernelAvailable(
+	AMTPTP_BATCH_KERNEL Kernel
+);
+
+const char *
+AmtPtpBatchKernelName(
+	AMTPTP_BATCH_KERNEL Kernel
+);
+
+// Validates the frame like AmtPtpDecodeFrame and decodes up to
+// AMTPTP_BATCH_MAX_CONTACTS records. Contacts is always fully written.
+AMTPTP_DECODE_STATUS
+AmtPtpBatchDecode(
+	const AMTPTP_BATCH_DECODER *Batch,
+	const uint8_t *Buffer,
+	size_t Length,
+	PAMTPTP_CONTACT_BATCH Contacts
+);
+
+typedef struct _AMTPTP_BATCH_BENCH_RESULT {
+	const char *Family;
+	uint32_t Fingers;
+	AMTPTP_BATCH_KERNEL Kernel;
+	uint64_t Frames;
+	uint64_t Counts[AMTPTP_BENCH_MAX_COUNTERS];		// Totals over all frames
+} AMTPTP_BATCH_BENCH_RESULT, *PAMTPTP_BATCH_BENCH_RESULT;
+
+// Times AmtPtpBatchDecode with Kernel on the AmtPtpBench frame set.
+// Returns 0 on success, non-zero if the family cannot encode frames with that
+// many fingers.
+int
+AmtPtpBatchBenchRun(
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint32_t Fingers,
+	uint64_t Frames,
+	AMTPTP_BATCH_KERNEL Kernel,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	PAMTPTP_BATCH_BENCH_RESULT Result
+);
+
+// Formats one result as a single-line JSON object, like AmtPtpBenchFormat.
+size_t
+AmtPtpBatchBenchFormat(
+	const AMTPTP_BATCH_BENCH_RESULT *Result,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
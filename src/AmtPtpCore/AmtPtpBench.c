@@ -0,0 +1,157 @@
+// AmtPtpBench.c: Per-family cost of the frame hot path
+
+#include "AmtPtpBench.h"
+#include "AmtPtpSynth.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Largest frame of any family: TYPE4 header plus 16 fingers
+#define AMTPTP_BENCH_FRAME_MAX		(46 + AMTPTP_SYNTH_MAX_FINGERS * 30)
+
+void
+AmtPtpBenchInitDecoder(
+	const AMTPTP_BENCH_FAMILY *Family,
+	PAMTPTP_DECODER Decoder
+)
+{
+	*Decoder = Family->Decoder;
+}
+
+static const char *AmtPtpBenchStageNames[AmtPtpBenchStageCount] = { "validate", "decode", "pack", "copy" };
+
+int
+AmtPtpBenchRun(
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint32_t Fingers,
+	uint64_t Frames,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	PAMTPTP_BENCH_RESULT Results
+)
+{
+	static const uint32_t StageFlags[AmtPtpBenchStageCount] = {
+		AMTPTP_DECODE_BUTTON,
+		AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON,
+		AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON,
+		AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON
+	};
+	static uint8_t FrameSet[AMTPTP_BENCH_FRAME_SET][AMTPTP_BENCH_FRAME_MAX];
+	size_t FrameLength[AMTPTP_BENCH_FRAME_SET];
+	AMTPTP_DECODER Decoder;
+	AMTPTP_GESTURE_SCRIPT Script;
+	AMTPTP_SYNTH_FRAME Synth;
+	AMTPTP_FRAME Frame;
+	AMTPTP_CONTACT_ID_MAP ContactIds;
+	uint8_t Report[AMTPTP_REPORT_SIZE];
+	uint8_t Stack[AMTPTP_REPORT_SIZE];
+	uint64_t Start[AMTPTP_BENCH_MAX_COUNTERS];
+	volatile uint32_t Sink = 0;
+	uint32_t Checksum = 0;
+	uint64_t n;
+	uint32_t i, k;
+	int s;
+
+	if (Fingers > AMTPTP_SYNTH_MAX_FINGERS ||
+		(Family->Decoder.Format == AmtPtpFrameFormatSpi && Fingers > AMTPTP_SYNTH_SPI_MAX_FINGERS) ||
+		Family->ReportSize > AMTPTP_REPORT_SIZE) {
+		return 1;
+	}
+
+	AmtPtpBenchInitDecoder(Family, &Decoder);
+	AmtPtpInitContactIdMap(&ContactIds);
+
+	Script.Gesture = AmtPtpGestureRotate;
+	Script.Fingers = Fingers;
+	Script.Width = Family->XMax - Decoder.XMin;
+	Script.Height = Decoder.YMax - Decoder.YMin;
+	Script.Frames = AMTPTP_BENCH_FRAME_SET;
+
+	for (i = 0; i < AMTPTP_BENCH_FRAME_SET; i++) {
+		AmtPtpSynthGestureFrame(&Script, i, &Synth);
+		Synth.Button = (uint8_t) (i & 1);
+		FrameLength[i] = AmtPtpSynthEncodeFrame(&Decoder, &Synth, FrameSet[i], sizeof(FrameSet[i]));
+		if (FrameLength[i] == 0) {
+			return 1;
+		}
+	}
+
+	for (s = 0; s < AmtPtpBenchStageCount; s++) {
+		PAMTPTP_BENCH_RESULT r = &Results[s];
+
+		r->Family = Family->Name;
+		r->Fingers = Fingers;
+		r->Stage = (AMTPTP_BENCH_STAGE) s;
+		r->Frames = Frames;
+
+		for (k = 0; k < Counters->Count; k++) {
+			Start[k] = Counters->Read[k](Counters->Context);
+		}
+
+		for (n = 0; n < Frames; n++) {
+			i = (uint32_t) (n % AMTPTP_BENCH_FRAME_SET);
+			Family->DecodeFrame(&Decoder, FrameSet[i], FrameLength[i], StageFlags[s], &Frame);
+			if (s == AmtPtpBenchPack) {
+				if (Family->MapContactIds) {
+					AmtPtpMapContactIds(&ContactIds, &Frame);
+				}
+				Family->PackReport(&Frame, (uint16_t) i, Report);
+				Checksum += Report[1];
+			}
+			else if (s == AmtPtpBenchCopy) {
+				if (Family->MapContactIds) {
+					AmtPtpMapContactIds(&ContactIds, &Frame);
+				}
+				memset(Stack, 0, Family->ReportSize);
+				Family->PackReport(&Frame, (uint16_t) i, Stack);
+				memcpy(Report, Stack, Family->ReportSize);
+				Checksum += Report[1];
+			}
+			Checksum += Frame.ContactCount + Frame.Contacts[0].X;
+		}
+
+		// Read the counters in reverse so each brackets the others symmetrically
+		for (k = Counters->Count; k-- > 0;) {
+			r->Counts[k] = Counters->Read[k](Counters->Context) - Start[k];
+		}
+	}
+
+	// Keeps the compiler from discarding the loops
+	Sink = Checksum;
+	(void) Sink;
+	return 0;
+}
+
+size_t
+AmtPtpBenchFormat(
+	const AMTPTP_BENCH_RESULT *Result,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	char *Out,
+	size_t OutSize
+)
+{
+	size_t Length;
+	uint32_t k;
+	int w;
+
+	if (OutSize == 0) {
+		return 0;
+	}
+
+	w = snprintf(Out, OutSize, "{\"family\":\"%s\",\"fingers\":%u,\"stage\":\"%s\",\"frames\":%llu",
+		Result->Family, (unsigned) Result->Fingers, AmtPtpBenchStageNames[Result->Stage],
+		(unsigned long long) Result->Frames);
+	Length = w < 0 ? 0 : (size_t) w;
+
+	for (k = 0; k < Counters->Count && Length < OutSize; k++) {
+		w = snprintf(Out + Length, OutSize - Length, ",\"%s_per_frame\":%.3f", Counters->Names[k],
+			Result->Frames ? (double) Result->Counts[k] / (double) Result->Frames : 0.0);
+		Length += w < 0 ? 0 : (size_t) w;
+	}
+
+	if (Length < OutSize) {
+		w = snprintf(Out + Length, OutSize - Length, "}");
+		Length += w < 0 ? 0 : (size_t) w;
+	}
+
+	return Length < OutSize ? Length : OutSize - 1;
+}
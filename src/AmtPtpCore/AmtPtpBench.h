@@ -0,0 +1,109 @@
+// AmtPtpBench.h: Per-family cost of the frame hot path
+//
+// Times the decode path on synthetic frames for every device family the
+// drivers support, split into stages:
+//   Validate  length checks and the button byte only
+//   Decode    Validate plus per-finger coordinate translation and qualification
+//   Pack      Decode plus contact renumbering where the build does it and
+//             packing into the family's PTP_REPORT layout
+//   Copy      Pack into a zeroed stack report plus a copy into the request
+//             buffer, as the drivers did before packing in place
+// Every stage calls the decoder function and packer the driver itself uses.
+// The cost of a stage alone is the difference to the stage before it, so Copy
+// minus Pack is what writing the report in place saves per frame.
+//
+// The library has no clock of its own. The caller supplies up to
+// AMTPTP_BENCH_MAX_COUNTERS monotonic counters, e.g. nanoseconds, TSC cycles
+// and retired instructions, and results are reported per frame. The
+// AmtPtpBench<Driver> executables (host/AmtPtpBenchTool.c) run every family
+// of a driver build on the host's clocks and print AmtPtpBenchFormat lines.
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_BENCH_MAX_COUNTERS	3
+
+// Distinct frames cycled through per run, so branches see realistic variation
+#define AMTPTP_BENCH_FRAME_SET		64
+
+typedef enum _AMTPTP_BENCH_STAGE {
+	AmtPtpBenchValidate,
+	AmtPtpBenchDecode,
+	AmtPtpBenchPack,
+	AmtPtpBenchCopy,
+	AmtPtpBenchStageCount
+} AMTPTP_BENCH_STAGE;
+
+// Frame path of one device family as a driver build runs it: the decoder with
+// the driver's geometry and thresholds, the decoder function the driver
+// selected for it and the driver's report packer. The library holds no copy of
+// the drivers' configuration tables; rows are produced by the drivers' own
+// configuration code on the host shim (host/AmtPtpFamilies.h).
+typedef struct _AMTPTP_BENCH_FAMILY {
+	char Name[32];
+	uint16_t ProductId;						// Device the row was configured for
+	AMTPTP_DECODER Decoder;
+	int32_t XMax;							// Synthetic gestures span XMin - XMax
+	PFN_AMTPTP_DECODE_FRAME DecodeFrame;	// AmtPtpSelectDecoder(&Decoder) as stored by the driver
+	PFN_AMTPTP_PACK_REPORT PackReport;		// AmtPtpPackReport or AmtPtpPackCompactReport
+	uint32_t ReportSize;					// AMTPTP_REPORT_SIZE or AMTPTP_COMPACT_REPORT_SIZE
+	uint8_t MapContactIds;					// AmtPtpMapContactIds runs on every decoded frame
+} AMTPTP_BENCH_FAMILY, *PAMTPTP_BENCH_FAMILY;
+
+typedef uint64_t
+(*PFN_AMTPTP_BENCH_COUNTER)(
+	void *Context
+);
+
+typedef struct _AMTPTP_BENCH_COUNTERS {
+	uint32_t Count;
+	const char *Names[AMTPTP_BENCH_MAX_COUNTERS];	// e.g. "ns", "cycles", "instructions"
+	PFN_AMTPTP_BENCH_COUNTER Read[AMTPTP_BENCH_MAX_COUNTERS];
+	void *Context;
+} AMTPTP_BENCH_COUNTERS, *PAMTPTP_BENCH_COUNTERS;
+
+typedef struct _AMTPTP_BENCH_RESULT {
+	const char *Family;
+	uint32_t Fingers;
+	AMTPTP_BENCH_STAGE Stage;
+	uint64_t Frames;
+	uint64_t Counts[AMTPTP_BENCH_MAX_COUNTERS];		// Totals over all frames
+} AMTPTP_BENCH_RESULT, *PAMTPTP_BENCH_RESULT;
+
+// Copies the decoder of Family into Decoder.
+void
+AmtPtpBenchInitDecoder(
+	const AMTPTP_BENCH_FAMILY *Family,
+	PAMTPTP_DECODER Decoder
+);
+
+// Runs every stage for Frames frames carrying Fingers contacts.
+// Results receives AmtPtpBenchStageCount entries. Returns 0 on success,
+// non-zero if the family cannot encode frames with that many fingers.
+int
+AmtPtpBenchRun(
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint32_t Fingers,
+	uint64_t Frames,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	PAMTPTP_BENCH_RESULT Results
+);
+
+// Formats one result as a single-line JSON object with per-frame values.
+// Returns the number of characters written, excluding the terminator.
+size_t
+AmtPtpBenchFormat(
+	const AMTPTP_BENCH_RESULT *Result,
+	const AMTPTP_BENCH_COUNTERS *Counters,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,269 @@
+// AmtPtpCapture.c: Binary capture format for raw trackpad frames
+
+#include "AmtPtpCapture.h"
+
+#include <string.h>
+
+static const uint8_t AmtPtpCaptureMagic[4] = { 'A', 'M', 'T', 'C' };
+
+static inline size_t
+AmtPtpCaptureAlign(
+	size_t Length
+)
+{
+	return (Length + (AMTPTP_CAPTURE_ALIGNMENT - 1)) & ~(size_t) (AMTPTP_CAPTURE_ALIGNMENT - 1);
+}
+
+static inline void
+AmtPtpPutU16(
+	uint8_t *p,
+	uint32_t v
+)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+}
+
+static inline void
+AmtPtpPutU32(
+	uint8_t *p,
+	uint32_t v
+)
+{
+	AmtPtpPutU16(p, v & 0xFFFF);
+	AmtPtpPutU16(p + 2, v >> 16);
+}
+
+static inline void
+AmtPtpPutU64(
+	uint8_t *p,
+	uint64_t v
+)
+{
+	AmtPtpPutU32(p, (uint32_t) v);
+	AmtPtpPutU32(p + 4, (uint32_t) (v >> 32));
+}
+
+static inline uint16_t
+AmtPtpGetU16(
+	const uint8_t *p
+)
+{
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t
+AmtPtpGetU32(
+	const uint8_t *p
+)
+{
+	return (uint32_t) AmtPtpGetU16(p) | ((uint32_t) AmtPtpGetU16(p + 2) << 16);
+}
+
+static inline uint64_t
+AmtPtpGetU64(
+	const uint8_t *p
+)
+{
+	return (uint64_t) AmtPtpGetU32(p) | ((uint64_t) AmtPtpGetU32(p + 4) << 32);
+}
+
+size_t
+AmtPtpCaptureHeaderLength(
+	uint32_t ConfigLength
+)
+{
+	return AmtPtpCaptureAlign(AMTPTP_CAPTURE_HEADER_SIZE + (size_t) ConfigLength);
+}
+
+size_t
+AmtPtpCaptureRecordLength(
+	uint32_t FrameLength
+)
+{
+	return AmtPtpCaptureAlign(AMTPTP_CAPTURE_RECORD_SIZE + (size_t) FrameLength);
+}
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureEncodeHeader(
+	const AMTPTP_CAPTURE_DEVICE *Device,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written
+)
+{
+	const AMTPTP_DECODER *d = &Device->Decoder;
+	const AMTPTP_THRESHOLDS *t = &Device->Decoder.Thresholds;
+	size_t Length = AmtPtpCaptureHeaderLength(Device->ConfigLength);
+
+	*Written = 0;
+
+	// Header length and decoder geometry are stored as 16-bit fields
+	if (Length > 0xFFFF || d->HeaderSize > 0xFFFF || d->FingerSize > 0xFFFF ||
+		d->FingerDelta > 0xFFFF || d->ButtonOffset > 0xFFFF) {
+		return AmtPtpCaptureBadHeader;
+	}
+
+	if (OutSize < Length) {
+		return AmtPtpCaptureBufferTooSmall;
+	}
+
+	memset(Out, 0, Length);
+	memcpy(Out, AmtPtpCaptureMagic, sizeof(AmtPtpCaptureMagic));
+	AmtPtpPutU16(Out + 4, AMTPTP_CAPTURE_VERSION);
+	AmtPtpPutU16(Out + 6, (uint32_t) Length);
+	AmtPtpPutU16(Out + 8, Device->IdVendor);
+	AmtPtpPutU16(Out + 10, Device->IdProduct);
+	Out[12] = (uint8_t) d->Format;
+	Out[13] = Device->TrackpadType;
+	AmtPtpPutU64(Out + 16, Device->TimestampFrequency);
+
+	AmtPtpPutU16(Out + 24, (uint32_t) d->HeaderSize);
+	AmtPtpPutU16(Out + 26, (uint32_t) d->FingerSize);
+	AmtPtpPutU16(Out + 28, (uint32_t) d->FingerDelta);
+	AmtPtpPutU16(Out + 30, (uint32_t) d->ButtonOffset);
+	AmtPtpPutU32(Out + 32, (uint32_t) d->XMin);
+	AmtPtpPutU32(Out + 36, (uint32_t) d->YMin);
+	AmtPtpPutU32(Out + 40, (uint32_t) d->YMax);
+	AmtPtpPutU32(Out + 44, (uint32_t) t->TipSwitchMajor);
+	AmtPtpPutU32(Out + 48, (uint32_t) t->TipSwitchMinor);
+	AmtPtpPutU32(Out + 52, (uint32_t) t->TipSwitchPressure);
+	AmtPtpPutU32(Out + 56, (uint32_t) t->ConfidenceMinorMin);
+	AmtPtpPutU32(Out + 60, (uint32_t) t->ConfidenceMinorMax);
+	AmtPtpPutU32(Out + 64, (uint32_t) t->ConfidenceMajorMax);
+
+	AmtPtpPutU32(Out + 68, Device->ConfigLength);
+	if (Device->ConfigLength) {
+		memcpy(Out + AMTPTP_CAPTURE_HEADER_SIZE, Device->Config, Device->ConfigLength);
+	}
+
+	*Written = Length;
+	return AmtPtpCaptureOk;
+}
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureEncodeRecord(
+	uint64_t Timestamp,
+	const uint8_t *Frame,
+	uint32_t Length,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written
+)
+{
+	size_t RecordLength = AmtPtpCaptureRecordLength(Length);
+
+	*Written = 0;
+
+	if (OutSize < RecordLength) {
+		return AmtPtpCaptureBufferTooSmall;
+	}
+
+	AmtPtpPutU64(Out, Timestamp);
+	AmtPtpPutU32(Out + 8, Length);
+	AmtPtpPutU32(Out + 12, 0);
+	if (Length) {
+		memcpy(Out + AMTPTP_CAPTURE_RECORD_SIZE, Frame, Length);
+	}
+	memset(Out + AMTPTP_CAPTURE_RECORD_SIZE + Length, 0, RecordLength - AMTPTP_CAPTURE_RECORD_SIZE - Length);
+
+	*Written = RecordLength;
+	return AmtPtpCaptureOk;
+}
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureOpen(
+	PAMTPTP_CAPTURE_READER Reader,
+	const uint8_t *Base,
+	size_t Size
+)
+{
+	AMTPTP_CAPTURE_READER Empty = { 0 };
+	AMTPTP_DECODER *d = &Reader->Device.Decoder;
+	AMTPTP_THRESHOLDS *t = &Reader->Device.Decoder.Thresholds;
+	size_t HeaderLength;
+
+	*Reader = Empty;
+
+	if (Base == NULL || Size < AMTPTP_CAPTURE_HEADER_SIZE ||
+		memcmp(Base, AmtPtpCaptureMagic, sizeof(AmtPtpCaptureMagic)) != 0) {
+		return AmtPtpCaptureBadHeader;
+	}
+
+	// HeaderLength covers the configuration row and its padding
+	Reader->Version = AmtPtpGetU16(Base + 4);
+	HeaderLength = AmtPtpGetU16(Base + 6);
+	Reader->Device.ConfigLength = AmtPtpGetU32(Base + 68);
+
+	if (Reader->Version != AMTPTP_CAPTURE_VERSION || HeaderLength > Size || Reader->Device.ConfigLength > Size ||
+		HeaderLength < AmtPtpCaptureHeaderLength(Reader->Device.ConfigLength)) {
+		return AmtPtpCaptureBadHeader;
+	}
+
+	Reader->Device.IdVendor = AmtPtpGetU16(Base + 8);
+	Reader->Device.IdProduct = AmtPtpGetU16(Base + 10);
+	Reader->Device.TrackpadType = Base[13];
+	Reader->Device.TimestampFrequency = AmtPtpGetU64(Base + 16);
+	Reader->Device.Config = Reader->Device.ConfigLength ? Base + AMTPTP_CAPTURE_HEADER_SIZE : NULL;
+
+	AmtPtpInitDecoder(d, (AMTPTP_FRAME_FORMAT) Base[12]);
+	d->HeaderSize = AmtPtpGetU16(Base + 24);
+	d->FingerSize = AmtPtpGetU16(Base + 26);
+	d->FingerDelta = AmtPtpGetU16(Base + 28);
+	d->ButtonOffset = AmtPtpGetU16(Base + 30);
+	d->XMin = (int32_t) AmtPtpGetU32(Base + 32);
+	d->YMin = (int32_t) AmtPtpGetU32(Base + 36);
+	d->YMax = (int32_t) AmtPtpGetU32(Base + 40);
+	t->TipSwitchMajor = (int32_t) AmtPtpGetU32(Base + 44);
+	t->TipSwitchMinor = (int32_t) AmtPtpGetU32(Base + 48);
+	t->TipSwitchPressure = (int32_t) AmtPtpGetU32(Base + 52);
+	t->ConfidenceMinorMin = (int32_t) AmtPtpGetU32(Base + 56);
+	t->ConfidenceMinorMax = (int32_t) AmtPtpGetU32(Base + 60);
+	t->ConfidenceMajorMax = (int32_t) AmtPtpGetU32(Base + 64);
+
+	Reader->Base = Base;
+	Reader->Size = Size;
+	Reader->Offset = HeaderLength;
+	return AmtPtpCaptureOk;
+}
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureNext(
+	PAMTPTP_CAPTURE_READER Reader,
+	uint64_t *Timestamp,
+	const uint8_t **Frame,
+	uint32_t *Length
+)
+{
+	const uint8_t *p;
+	size_t Remaining;
+	uint32_t FrameLength;
+
+	*Frame = NULL;
+	*Length = 0;
+
+	if (Reader->Offset >= Reader->Size) {
+		return AmtPtpCaptureEnd;
+	}
+
+	p = Reader->Base + Reader->Offset;
+	Remaining = Reader->Size - Reader->Offset;
+
+	if (Remaining < AMTPTP_CAPTURE_RECORD_SIZE) {
+		return AmtPtpCaptureTruncated;
+	}
+
+	// Padding of the last record may be missing; the payload itself may not
+	FrameLength = AmtPtpGetU32(p + 8);
+	if (Remaining - AMTPTP_CAPTURE_RECORD_SIZE < FrameLength) {
+		return AmtPtpCaptureTruncated;
+	}
+
+	*Timestamp = AmtPtpGetU64(p);
+	*Frame = p + AMTPTP_CAPTURE_RECORD_SIZE;
+	*Length = FrameLength;
+
+	Remaining = AmtPtpCaptureRecordLength(FrameLength);
+	Reader->Offset = (Reader->Size - Reader->Offset < Remaining) ? Reader->Size : Reader->Offset + Remaining;
+	return AmtPtpCaptureOk;
+}
@@ -0,0 +1,111 @@
+// AmtPtpCapture.h: Binary capture format for raw trackpad frames
+//
+// A capture is one header followed by an append-only stream of records.
+// All fields are little-endian and every record starts on an 8-byte boundary,
+// so a reader can walk a memory-mapped file without copying frame payloads.
+//
+// Header (version 1):
+//   0  Magic "AMTC"               4  Version              6  HeaderLength
+//   8  idVendor                  10  idProduct           12  Format
+//  13  TrackpadType              14  Reserved            16  TimestampFrequency
+//  24  Decoder geometry and thresholds (see AMTPTP_DECODER)
+//  68  ConfigLength              72  Config row, padded to 8 bytes
+//
+// Record:
+//   0  Timestamp (counter ticks)  8  Length               12  Reserved
+//  16  Raw frame bytes exactly as delivered by the device, padded to 8 bytes
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_CAPTURE_VERSION			1
+#define AMTPTP_CAPTURE_HEADER_SIZE		72
+#define AMTPTP_CAPTURE_RECORD_SIZE		16
+#define AMTPTP_CAPTURE_ALIGNMENT		8
+
+// TrackpadType value for devices that have no BCM5974 tp_type (SPI)
+#define AMTPTP_CAPTURE_NO_TRACKPAD_TYPE	0xFF
+
+typedef enum _AMTPTP_CAPTURE_STATUS {
+	AmtPtpCaptureOk,
+	AmtPtpCaptureEnd,				// No more records
+	AmtPtpCaptureTruncated,			// Last record was cut short, e.g. writer was interrupted
+	AmtPtpCaptureBadHeader,			// Not a capture, or an unsupported version
+	AmtPtpCaptureBufferTooSmall		// Writer output buffer cannot hold the data
+} AMTPTP_CAPTURE_STATUS;
+
+// Device identity stored once per capture
+typedef struct _AMTPTP_CAPTURE_DEVICE {
+	uint16_t IdVendor;
+	uint16_t IdProduct;
+	uint8_t  TrackpadType;
+	uint64_t TimestampFrequency;	// Counter ticks per second
+	AMTPTP_DECODER Decoder;			// Everything needed to decode the frames again
+	const void *Config;				// Driver configuration row (BCM5974_CONFIG, SPI_TRACKPAD_INFO)
+	uint32_t ConfigLength;
+} AMTPTP_CAPTURE_DEVICE, *PAMTPTP_CAPTURE_DEVICE;
+
+typedef struct _AMTPTP_CAPTURE_READER {
+	const uint8_t *Base;
+	size_t Size;
+	size_t Offset;
+	uint16_t Version;
+	AMTPTP_CAPTURE_DEVICE Device;	// Config points into the mapped capture
+} AMTPTP_CAPTURE_READER, *PAMTPTP_CAPTURE_READER;
+
+// Bytes taken by the header and by one record, including padding.
+size_t
+AmtPtpCaptureHeaderLength(
+	uint32_t ConfigLength
+);
+
+size_t
+AmtPtpCaptureRecordLength(
+	uint32_t FrameLength
+);
+
+// Serializes the header into Out. *Written receives the number of bytes to append.
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureEncodeHeader(
+	const AMTPTP_CAPTURE_DEVICE *Device,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written
+);
+
+// Serializes one frame into Out. *Written receives the number of bytes to append.
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureEncodeRecord(
+	uint64_t Timestamp,
+	const uint8_t *Frame,
+	uint32_t Length,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written
+);
+
+// Validates the header of a capture mapped at Base. Nothing is copied.
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureOpen(
+	PAMTPTP_CAPTURE_READER Reader,
+	const uint8_t *Base,
+	size_t Size
+);
+
+// Returns the next record. *Frame points into the mapped capture.
+AMTPTP_CAPTURE_STATUS
+AmtPtpCaptureNext(
+	PAMTPTP_CAPTURE_READER Reader,
+	uint64_t *Timestamp,
+	const uint8_t **Frame,
+	uint32_t *Length
+);
+
+#ifdef __cplusplus
+}
+#endif
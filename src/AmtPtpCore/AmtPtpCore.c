@@ -0,0 +1,606 @@
+// AmtPtpCore.c: Frame decoding shared by all AmtPtp drivers
+
+#include "AmtPtpCore.h"
+#include "AmtPtpLayout.h"
+
+// The specialized decoders rely on the geometry being inlined as constants
+#if defined(_MSC_VER)
+#define AMTPTP_FORCEINLINE __forceinline
+#elif defined(__GNUC__)
+#define AMTPTP_FORCEINLINE inline __attribute__((always_inline))
+#else
+#define AMTPTP_FORCEINLINE inline
+#endif
+
+// Reads are byte-wise so that finger records need no particular alignment
+static inline int32_t
+AmtPtpReadS16(
+	const uint8_t *p
+)
+{
+	return (int16_t) (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t
+AmtPtpReadU32(
+	const uint8_t *p
+)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// Coordinates are computed in 64 bits, so any decoder range is safe
+static inline uint16_t
+AmtPtpClampCoordinate(
+	int64_t v
+)
+{
+	if (v <= 0) return 0;
+	if (v > 0xFFFF) return 0xFFFF;
+	return (uint16_t) v;
+}
+
+void
+AmtPtpQualifyContact(
+	const AMTPTP_THRESHOLDS *Thresholds,
+	const AMTPTP_CONTACT_SIZE *Size,
+	uint8_t *TipSwitch,
+	uint8_t *Confidence
+)
+{
+	const AMTPTP_THRESHOLDS *t = Thresholds;
+
+	*TipSwitch = (t->TipSwitchMajor && Size->Major >= t->TipSwitchMajor) ||
+		(t->TipSwitchMinor && Size->Minor >= t->TipSwitchMinor) ||
+		(t->TipSwitchPressure && Size->Pressure >= t->TipSwitchPressure);
+
+	*Confidence = !((t->ConfidenceMinorMin && Size->Minor < t->ConfidenceMinorMin) ||
+		(t->ConfidenceMinorMax && Size->Minor >= t->ConfidenceMinorMax) ||
+		(t->ConfidenceMajorMax && Size->Major >= t->ConfidenceMajorMax));
+}
+
+void
+AmtPtpInitDecoder(
+	PAMTPTP_DECODER Decoder,
+	AMTPTP_FRAME_FORMAT Format
+)
+{
+	AMTPTP_DECODER Empty = { 0 };
+
+	*Decoder = Empty;
+	Decoder->Format = Format;
+
+	switch (Format) {
+		case AmtPtpFrameFormatWellspring:
+			Decoder->Thresholds.TipSwitchMajor = 200;
+			Decoder->Thresholds.ConfidenceMinorMin = 1;
+			break;
+		case AmtPtpFrameFormatType5:
+			// The Microsoft spec says reject any input larger than 25mm. This is not ideal
+			// for Magic Trackpad 2 - so we raised the threshold a bit higher.
+			Decoder->Thresholds.TipSwitchMajor = 1;
+			Decoder->Thresholds.ConfidenceMinorMax = 345;
+			break;
+		case AmtPtpFrameFormatSpi:
+			Decoder->HeaderSize = AMTPTP_SPI_HEADER_SIZE;
+			Decoder->FingerSize = AMTPTP_SPI_FINGER_SIZE;
+			Decoder->ButtonOffset = SPI_CLICK_OCCURRED;
+			Decoder->Thresholds.TipSwitchPressure = 1;
+			// $S = \pi * (Touch_{Major} * Touch_{Minor}) / 4$
+			// $S = \pi * r^2$
+			// $r^2 = (Touch_{Major} * Touch_{Minor}) / 4$
+			Decoder->Thresholds.ConfidenceMinorMax = 2500;
+			Decoder->Thresholds.ConfidenceMajorMax = 2500;
+			break;
+	}
+}
+
+uint16_t
+AmtPtpScanTime(
+	int64_t LastTimestamp,
+	int64_t Timestamp
+)
+{
+	uint64_t Delta;
+
+	if (Timestamp <= LastTimestamp) {
+		return 0;
+	}
+
+	// Scan time is in 100us. Only one byte worth of range is used.
+	// The difference of two ordered int64 values always fits in uint64.
+	Delta = ((uint64_t) Timestamp - (uint64_t) LastTimestamp) / 100;
+	return Delta > AMTPTP_SCAN_TIME_MAX ? AMTPTP_SCAN_TIME_MAX : (uint16_t) Delta;
+}
+
+static AMTPTP_FORCEINLINE void
+AmtPtpReadContactSize(
+	AMTPTP_FRAME_FORMAT Format,
+	const uint8_t *f,
+	PAMTPTP_CONTACT_SIZE Size
+)
+{
+	switch (Format) {
+		case AmtPtpFrameFormatWellspring:
+			// Pressure is outside the record on TYPE2 and TYPE3
+			Size->Major = AmtPtpReadS16(f + WELLSPRING_TOUCH_MAJOR) * 2;
+			Size->Minor = AmtPtpReadS16(f + WELLSPRING_TOUCH_MINOR) * 2;
+			Size->Pressure = 0;
+			break;
+		case AmtPtpFrameFormatType5:
+			Size->Major = f[TYPE5_TOUCH_MAJOR] * 2;
+			Size->Minor = f[TYPE5_TOUCH_MINOR] * 2;
+			Size->Pressure = f[TYPE5_PRESSURE];
+			break;
+		case AmtPtpFrameFormatSpi:
+			Size->Major = AmtPtpReadS16(f + SPI_TOUCH_MAJOR);
+			Size->Minor = AmtPtpReadS16(f + SPI_TOUCH_MINOR);
+			Size->Pressure = AmtPtpReadS16(f + SPI_PRESSURE);
+			break;
+	}
+}
+
+static AMTPTP_FORCEINLINE void
+AmtPtpDecodeWellspringFinger(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *f,
+	uint8_t Index,
+	PAMTPTP_CONTACT Contact
+)
+{
+	Contact->X = AmtPtpClampCoordinate((int64_t) AmtPtpReadS16(f + WELLSPRING_ABS_X) - Decoder->XMin);
+	Contact->Y = AmtPtpClampCoordinate((int64_t) Decoder->YMax - AmtPtpReadS16(f + WELLSPRING_ABS_Y));
+	Contact->ContactID = Index;
+}
+
+static AMTPTP_FORCEINLINE void
+AmtPtpDecodeType5Finger(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *f,
+	PAMTPTP_CONTACT Contact
+)
+{
+	uint32_t Raw = AmtPtpReadU32(f);
+	int32_t x, y;
+
+	// X is a signed 13-bit field in bits 0 - 12
+	x = (int32_t) (Raw & 0x1fff) - ((Raw & 0x1000) ? 0x2000 : 0);
+
+	// Y is a signed 13-bit field in bits 13 - 25. The firmware axis is flipped,
+	// and the original expression negates before shifting, so any X bits below
+	// round the result towards negative infinity. Kept as-is for compatibility.
+	y = (int32_t) (-(int64_t) (int32_t) (Raw << 6) >> 19);
+
+	Contact->X = AmtPtpClampCoordinate((int64_t) x - Decoder->XMin);
+	Contact->Y = AmtPtpClampCoordinate((int64_t) y - Decoder->YMin);
+	Contact->ContactID = f[TYPE5_IDENTIFIER] & 0xf;
+}
+
+static AMTPTP_FORCEINLINE void
+AmtPtpDecodeSpiFinger(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *f,
+	uint8_t Index,
+	PAMTPTP_CONTACT Contact
+)
+{
+	Contact->X = AmtPtpClampCoordinate((int64_t) AmtPtpReadS16(f + SPI_X) - Decoder->XMin);
+	Contact->Y = AmtPtpClampCoordinate((int64_t) Decoder->YMax - AmtPtpReadS16(f + SPI_Y));
+	Contact->ContactID = Index;
+}
+
+// Validates the frame layout and returns the number of finger records to decode.
+// The geometry is passed apart from the decoder so that it can be a constant.
+static AMTPTP_FORCEINLINE AMTPTP_DECODE_STATUS
+AmtPtpFrameContactCount(
+	AMTPTP_FRAME_FORMAT Format,
+	size_t HeaderSize,
+	size_t FingerSize,
+	size_t FingerDelta,
+	const uint8_t *Buffer,
+	size_t Length,
+	size_t *Count
+)
+{
+	size_t ReadSize;
+
+	*Count = 0;
+
+	switch (Format) {
+		case AmtPtpFrameFormatWellspring:
+			ReadSize = WELLSPRING_FINGER_READ;
+			break;
+		case AmtPtpFrameFormatType5:
+			ReadSize = TYPE5_FINGER_READ;
+			break;
+		case AmtPtpFrameFormatSpi:
+			ReadSize = SPI_FINGER_READ;
+			break;
+		default:
+			return AmtPtpDecodeUnsupported;
+	}
+
+	// Every field read from a record must lie inside that record
+	if (FingerSize < FingerDelta + ReadSize) {
+		return AmtPtpDecodeUnsupported;
+	}
+
+	if (Buffer == NULL || Length < HeaderSize) {
+		return AmtPtpDecodeMalformed;
+	}
+
+	if (Format == AmtPtpFrameFormatSpi) {
+		// SPI frames report the finger count, but never trust it beyond the transfer
+		*Count = Buffer[SPI_NUM_OF_FINGERS];
+		if (*Count > (Length - HeaderSize) / FingerSize) {
+			*Count = (Length - HeaderSize) / FingerSize;
+		}
+	}
+	else {
+		// USB frames always carry whole finger records
+		if ((Length - HeaderSize) % FingerSize != 0) {
+			return AmtPtpDecodeMalformed;
+		}
+		*Count = (Length - HeaderSize) / FingerSize;
+	}
+
+	if (*Count > AMTPTP_MAX_CONTACTS) {
+		*Count = AMTPTP_MAX_CONTACTS;
+	}
+
+	return AmtPtpDecodeOk;
+}
+
+// Body of every frame decoder. Called with constant geometry, the format
+// dispatch folds away and the finger loop has a constant stride and bound.
+static AMTPTP_FORCEINLINE AMTPTP_DECODE_STATUS
+AmtPtpDecodeFrameAs(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Buffer,
+	size_t Length,
+	uint32_t Flags,
+	PAMTPTP_FRAME Frame,
+	AMTPTP_FRAME_FORMAT Format,
+	size_t HeaderSize,
+	size_t FingerSize,
+	size_t FingerDelta,
+	size_t ButtonOffset
+)
+{
+	AMTPTP_FRAME Empty = { 0 };
+	AMTPTP_DECODE_STATUS Status;
+	AMTPTP_CONTACT_SIZE Size;
+	size_t Count, i;
+	const uint8_t *f;
+
+	*Frame = Empty;
+
+	Status = AmtPtpFrameContactCount(Format, HeaderSize, FingerSize, FingerDelta, Buffer, Length, &Count);
+	if (Status != AmtPtpDecodeOk) {
+		return Status;
+	}
+
+	if (Flags & AMTPTP_DECODE_SURFACE) {
+		Frame->ContactCount = (uint8_t) Count;
+		f = Buffer + HeaderSize + FingerDelta;
+
+		for (i = 0; i < AMTPTP_MAX_CONTACTS && i < Count; i++, f += FingerSize) {
+			PAMTPTP_CONTACT Contact = &Frame->Contacts[i];
+
+			switch (Format) {
+				case AmtPtpFrameFormatWellspring:
+					AmtPtpDecodeWellspringFinger(Decoder, f, (uint8_t) i, Contact);
+					break;
+				case AmtPtpFrameFormatType5:
+					AmtPtpDecodeType5Finger(Decoder, f, Contact);
+					break;
+				case AmtPtpFrameFormatSpi:
+					AmtPtpDecodeSpiFinger(Decoder, f, (uint8_t) i, Contact);
+					break;
+			}
+
+			AmtPtpReadContactSize(Format, f, &Size);
+			AmtPtpQualifyContact(&Decoder->Thresholds, &Size, &Contact->TipSwitch, &Contact->Confidence);
+		}
+	}
+
+	if ((Flags & AMTPTP_DECODE_BUTTON) && ButtonOffset < Length) {
+		Frame->IsButtonClicked = Buffer[ButtonOffset] ? 1 : 0;
+	}
+
+	return AmtPtpDecodeOk;
+}
+
+AMTPTP_DECODE_STATUS
+AmtPtpDecodeFrame(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Buffer,
+	size_t Length,
+	uint32_t Flags,
+	PAMTPTP_FRAME Frame
+)
+{
+	return AmtPtpDecodeFrameAs(Decoder, Buffer, Length, Flags, Frame, Decoder->Format,
+		Decoder->HeaderSize, Decoder->FingerSize, Decoder->FingerDelta, Decoder->ButtonOffset);
+}
+
+// One decoder per device type with its geometry compiled in
+#define AMTPTP_DECODER_INSTANCE(Name, Format, HeaderSize, FingerSize, FingerDelta, ButtonOffset) \
+	static AMTPTP_DECODE_STATUS \
+	Name( \
+		const AMTPTP_DECODER *Decoder, \
+		const uint8_t *Buffer, \
+		size_t Length, \
+		uint32_t Flags, \
+		PAMTPTP_FRAME Frame \
+	) \
+	{ \
+		return AmtPtpDecodeFrameAs(Decoder, Buffer, Length, Flags, Frame, \
+			Format, HeaderSize, FingerSize, FingerDelta, ButtonOffset); \
+	}
+
+AMTPTP_DECODER_INSTANCE(AmtPtpDecodeFrameType2, AmtPtpFrameFormatWellspring,
+	HEADER_SIZE_TYPE2, FINGER_SIZE_TYPE2, FINGER_DELTA_TYPE2, BUTTON_OFFSET_TYPE2)
+AMTPTP_DECODER_INSTANCE(AmtPtpDecodeFrameType3, AmtPtpFrameFormatWellspring,
+	HEADER_SIZE_TYPE3, FINGER_SIZE_TYPE3, FINGER_DELTA_TYPE3, BUTTON_OFFSET_TYPE3)
+AMTPTP_DECODER_INSTANCE(AmtPtpDecodeFrameType4, AmtPtpFrameFormatWellspring,
+	HEADER_SIZE_TYPE4, FINGER_SIZE_TYPE4, FINGER_DELTA_TYPE4, BUTTON_OFFSET_TYPE4)
+AMTPTP_DECODER_INSTANCE(AmtPtpDecodeFrameType5, AmtPtpFrameFormatType5,
+	HEADER_SIZE_TYPE5, FINGER_SIZE_TYPE5, FINGER_DELTA_TYPE5, BUTTON_OFFSET_TYPE5)
+AMTPTP_DECODER_INSTANCE(AmtPtpDecodeFrameSpi, AmtPtpFrameFormatSpi,
+	AMTPTP_SPI_HEADER_SIZE, AMTPTP_SPI_FINGER_SIZE, 0, SPI_CLICK_OCCURRED)
+
+typedef struct _AMTPTP_DECODER_INSTANCE {
+	AMTPTP_FRAME_FORMAT Format;
+	size_t HeaderSize;
+	size_t FingerSize;
+	size_t FingerDelta;
+	size_t ButtonOffset;
+	PFN_AMTPTP_DECODE_FRAME DecodeFrame;
+} AMTPTP_DECODER_INSTANCE;
+
+static const AMTPTP_DECODER_INSTANCE AmtPtpDecoderInstances[] = {
+	{ AmtPtpFrameFormatWellspring, HEADER_SIZE_TYPE2, FINGER_SIZE_TYPE2, FINGER_DELTA_TYPE2, BUTTON_OFFSET_TYPE2, AmtPtpDecodeFrameType2 },
+	{ AmtPtpFrameFormatWellspring, HEADER_SIZE_TYPE3, FINGER_SIZE_TYPE3, FINGER_DELTA_TYPE3, BUTTON_OFFSET_TYPE3, AmtPtpDecodeFrameType3 },
+	{ AmtPtpFrameFormatWellspring, HEADER_SIZE_TYPE4, FINGER_SIZE_TYPE4, FINGER_DELTA_TYPE4, BUTTON_OFFSET_TYPE4, AmtPtpDecodeFrameType4 },
+	{ AmtPtpFrameFormatType5, HEADER_SIZE_TYPE5, FINGER_SIZE_TYPE5, FINGER_DELTA_TYPE5, BUTTON_OFFSET_TYPE5, AmtPtpDecodeFrameType5 },
+	{ AmtPtpFrameFormatSpi, AMTPTP_SPI_HEADER_SIZE, AMTPTP_SPI_FINGER_SIZE, 0, SPI_CLICK_OCCURRED, AmtPtpDecodeFrameSpi },
+};
+
+PFN_AMTPTP_DECODE_FRAME
+AmtPtpSelectDecoder(
+	const AMTPTP_DECODER *Decoder
+)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(AmtPtpDecoderInstances) / sizeof(AmtPtpDecoderInstances[0]); i++) {
+		const AMTPTP_DECODER_INSTANCE *d = &AmtPtpDecoderInstances[i];
+
+		if (d->Format == Decoder->Format && d->HeaderSize == Decoder->HeaderSize &&
+			d->FingerSize == Decoder->FingerSize && d->FingerDelta == Decoder->FingerDelta &&
+			d->ButtonOffset == Decoder->ButtonOffset) {
+			return d->DecodeFrame;
+		}
+	}
+
+	return AmtPtpDecodeFrame;
+}
+
+AMTPTP_DECODE_STATUS
+AmtPtpDecodeContactSizes(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Buffer,
+	size_t Length,
+	PAMTPTP_CONTACT_SIZE Sizes,
+	uint8_t *Count
+)
+{
+	AMTPTP_DECODE_STATUS Status;
+	size_t n, i;
+	const uint8_t *f;
+
+	*Count = 0;
+
+	Status = AmtPtpFrameContactCount(Decoder->Format, Decoder->HeaderSize, Decoder->FingerSize,
+		Decoder->FingerDelta, Buffer, Length, &n);
+	if (Status != AmtPtpDecodeOk) {
+		return Status;
+	}
+
+	f = Buffer + Decoder->HeaderSize + Decoder->FingerDelta;
+	for (i = 0; i < n; i++, f += Decoder->FingerSize) {
+		AmtPtpReadContactSize(Decoder->Format, f, &Sizes[i]);
+	}
+
+	*Count = (uint8_t) n;
+	return AmtPtpDecodeOk;
+}
+
+void
+AmtPtpPackReport(
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime,
+	uint8_t *Report
+)
+{
+	uint8_t *c = Report + 1;
+	size_t Count = Frame->ContactCount < AMTPTP_MAX_CONTACTS ? Frame->ContactCount : AMTPTP_MAX_CONTACTS;
+	size_t i, k;
+
+	Report[0] = AMTPTP_REPORTID_MULTITOUCH;
+
+	// PTP_CONTACT: Confidence and TipSwitch bits, 32-bit ContactID, X, Y
+	for (i = 0; i < Count; i++, c += 9) {
+		const AMTPTP_CONTACT *Contact = &Frame->Contacts[i];
+
+		c[0] = (uint8_t) (Contact->Confidence | (Contact->TipSwitch << 1));
+		c[1] = Contact->ContactID;
+		c[2] = 0;
+		c[3] = 0;
+		c[4] = 0;
+		c[5] = (uint8_t) (Contact->X & 0xFF);
+		c[6] = (uint8_t) (Contact->X >> 8);
+		c[7] = (uint8_t) (Contact->Y & 0xFF);
+		c[8] = (uint8_t) (Contact->Y >> 8);
+	}
+
+	// Report may be a request buffer still holding an earlier report
+	for (k = i * 9; k < AMTPTP_MAX_CONTACTS * 9; k++, c++) {
+		*c = 0;
+	}
+
+	c[0] = (uint8_t) (ScanTime & 0xFF);
+	c[1] = (uint8_t) (ScanTime >> 8);
+	c[2] = Frame->ContactCount;
+	c[3] = Frame->IsButtonClicked;
+}
+
+void
+AmtPtpInitContactIdMap(
+	PAMTPTP_CONTACT_ID_MAP Map
+)
+{
+	AMTPTP_CONTACT_ID_MAP Empty = { 0 };
+
+	*Map = Empty;
+}
+
+void
+AmtPtpMapContactIds(
+	PAMTPTP_CONTACT_ID_MAP Map,
+	PAMTPTP_FRAME Frame
+)
+{
+	AMTPTP_CONTACT_ID_MAP Next = { 0 };
+	uint32_t Held = 0, Previous = 0, Free;
+	uint8_t Assigned[AMTPTP_MAX_CONTACTS] = { 0 };
+	size_t Count = Frame->ContactCount < AMTPTP_MAX_CONTACTS ? Frame->ContactCount : AMTPTP_MAX_CONTACTS;
+	size_t i, j;
+	uint8_t Id;
+
+	for (j = 0; j < Map->Count; j++) {
+		Previous |= 1u << Map->CompactId[j];
+	}
+
+	// Contacts that were already down keep their identifier
+	for (i = 0; i < Count; i++) {
+		for (j = 0; j < Map->Count; j++) {
+			if (Map->DeviceId[j] == Frame->Contacts[i].ContactID && !(Held & (1u << Map->CompactId[j]))) {
+				Next.DeviceId[i] = Frame->Contacts[i].ContactID;
+				Next.CompactId[i] = Map->CompactId[j];
+				Held |= 1u << Map->CompactId[j];
+				Assigned[i] = 1;
+				break;
+			}
+		}
+	}
+
+	// At most five are held and eight exist, so the fallback always finds one
+	for (i = 0; i < Count; i++) {
+		if (Assigned[i]) {
+			continue;
+		}
+
+		Free = ~(Held | Previous) & ((1u << (AMTPTP_COMPACT_CONTACT_ID_MAX + 1)) - 1);
+		if (Free == 0) {
+			Free = ~Held & ((1u << (AMTPTP_COMPACT_CONTACT_ID_MAX + 1)) - 1);
+		}
+
+		for (Id = 0; !(Free & (1u << Id)); Id++);
+
+		Next.DeviceId[i] = Frame->Contacts[i].ContactID;
+		Next.CompactId[i] = Id;
+		Held |= 1u << Id;
+	}
+
+	Next.Count = (uint8_t) Count;
+	for (i = 0; i < Count; i++) {
+		Frame->Contacts[i].ContactID = Next.CompactId[i];
+	}
+
+	*Map = Next;
+}
+
+void
+AmtPtpPackCompactReport(
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime,
+	uint8_t *Report
+)
+{
+	uint8_t *c = Report + 1;
+	size_t Count = Frame->ContactCount < AMTPTP_MAX_CONTACTS ? Frame->ContactCount : AMTPTP_MAX_CONTACTS;
+	size_t i, k;
+
+	Report[0] = AMTPTP_REPORTID_MULTITOUCH;
+
+	// PTP_CONTACT: Confidence and TipSwitch bits, 3-bit ContactID, X, Y
+	for (i = 0; i < Count; i++, c += 5) {
+		const AMTPTP_CONTACT *Contact = &Frame->Contacts[i];
+
+		c[0] = (uint8_t) (Contact->Confidence | (Contact->TipSwitch << 1) |
+			((Contact->ContactID & AMTPTP_COMPACT_CONTACT_ID_MAX) << 2));
+		c[1] = (uint8_t) (Contact->X & 0xFF);
+		c[2] = (uint8_t) (Contact->X >> 8);
+		c[3] = (uint8_t) (Contact->Y & 0xFF);
+		c[4] = (uint8_t) (Contact->Y >> 8);
+	}
+
+	for (k = i * 5; k < AMTPTP_MAX_CONTACTS * 5; k++, c++) {
+		*c = 0;
+	}
+
+	c[0] = (uint8_t) (ScanTime & 0xFF);
+	c[1] = (uint8_t) (ScanTime >> 8);
+	c[2] = Frame->ContactCount;
+	c[3] = Frame->IsButtonClicked;
+}
+
+AMTPTP_DECODE_STATUS
+AmtPtpUnpackReport(
+	const uint8_t *Report,
+	size_t ReportSize,
+	PAMTPTP_FRAME Frame,
+	uint16_t *ScanTime
+)
+{
+	AMTPTP_FRAME Empty = { 0 };
+	const uint8_t *c = Report + 1;
+	size_t ContactSize, Count, i;
+
+	*Frame = Empty;
+	*ScanTime = 0;
+
+	if (ReportSize == AMTPTP_REPORT_SIZE) {
+		ContactSize = 9;
+	}
+	else if (ReportSize == AMTPTP_COMPACT_REPORT_SIZE) {
+		ContactSize = 5;
+	}
+	else {
+		return AmtPtpDecodeUnsupported;
+	}
+
+	if (Report[0] != AMTPTP_REPORTID_MULTITOUCH) {
+		return AmtPtpDecodeMalformed;
+	}
+
+	Frame->ContactCount = Report[ReportSize - 2];
+	Frame->IsButtonClicked = Report[ReportSize - 1];
+	*ScanTime = (uint16_t) (Report[ReportSize - 4] | (Report[ReportSize - 3] << 8));
+
+	Count = Frame->ContactCount < AMTPTP_MAX_CONTACTS ? Frame->ContactCount : AMTPTP_MAX_CONTACTS;
+	for (i = 0; i < Count; i++, c += ContactSize) {
+		PAMTPTP_CONTACT Contact = &Frame->Contacts[i];
+		const uint8_t *Position = c + ContactSize - 4;	// X and Y end either PTP_CONTACT
+
+		Contact->Confidence = c[0] & 1;
+		Contact->TipSwitch = (c[0] >> 1) & 1;
+		Contact->ContactID = ContactSize == 9 ? c[1] : (uint8_t) ((c[0] >> 2) & AMTPTP_COMPACT_CONTACT_ID_MAX);
+		Contact->X = (uint16_t) (Position[0] | (Position[1] << 8));
+		Contact->Y = (uint16_t) (Position[2] | (Position[3] << 8));
+	}
+
+	return AmtPtpDecodeOk;
+}
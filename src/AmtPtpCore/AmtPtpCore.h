@@ -0,0 +1,231 @@
+// AmtPtpCore.h: Frame decoding shared by all AmtPtp drivers
+//
+// Everything in this library is plain C99. It must not include WDF, WDM or
+// Win32 headers so the same decoders can be compiled for UMDF, KMDF and for
+// host-side tooling.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Windows PTP reports carry at most five contacts
+#define AMTPTP_MAX_CONTACTS 5
+
+// ScanTime field saturates at this value (100us units)
+#define AMTPTP_SCAN_TIME_MAX 0xFF
+
+// SPI trackpad packet layout (see SPI_TRACKPAD_PACKET)
+#define AMTPTP_SPI_HEADER_SIZE 46
+#define AMTPTP_SPI_FINGER_SIZE 30
+
+// PTP_REPORT wire layout: ReportID, 5 x PTP_CONTACT, ScanTime, ContactCount, IsButtonClicked
+#define AMTPTP_REPORTID_MULTITOUCH 0x05
+#define AMTPTP_REPORT_SIZE 50
+
+// Compact layout (AmtPtpDeviceSpiKm, USB drivers built with AMTPTP_COMPACT_REPORT):
+// PTP_CONTACT holds a 3-bit ContactID next to the flag bits
+#define AMTPTP_COMPACT_REPORT_SIZE 30
+#define AMTPTP_COMPACT_CONTACT_ID_MAX 7
+
+// Decode flags
+#define AMTPTP_DECODE_SURFACE 0x1
+#define AMTPTP_DECODE_BUTTON  0x2
+
+typedef enum _AMTPTP_FRAME_FORMAT {
+	AmtPtpFrameFormatWellspring,	// USB TYPE2 - TYPE4, 16-bit finger records
+	AmtPtpFrameFormatType5,			// USB TYPE5 (Magic Trackpad 2), 9-byte finger records
+	AmtPtpFrameFormatSpi			// SPI trackpad packet
+} AMTPTP_FRAME_FORMAT;
+
+typedef enum _AMTPTP_DECODE_STATUS {
+	AmtPtpDecodeOk,
+	AmtPtpDecodeMalformed,			// Length does not match the frame layout
+	AmtPtpDecodeUnsupported			// Decoder is not configured for a known format
+} AMTPTP_DECODE_STATUS;
+
+// Per-format contact qualification.
+// USB sizes are compared after the firmware's implicit doubling (raw << 1),
+// SPI sizes are compared as reported. A zero threshold disables that check.
+typedef struct _AMTPTP_THRESHOLDS {
+	int32_t TipSwitchMajor;			// TipSwitch when TouchMajor >= value
+	int32_t TipSwitchMinor;			// ... or when TouchMinor >= value
+	int32_t TipSwitchPressure;		// ... or when Pressure >= value
+	int32_t ConfidenceMinorMin;		// Confidence requires TouchMinor >= value
+	int32_t ConfidenceMinorMax;		// ... and TouchMinor < value
+	int32_t ConfidenceMajorMax;		// ... and TouchMajor < value
+} AMTPTP_THRESHOLDS, *PAMTPTP_THRESHOLDS;
+
+typedef struct _AMTPTP_DECODER {
+	AMTPTP_FRAME_FORMAT Format;
+	size_t HeaderSize;				// Bytes before the first finger record
+	size_t FingerSize;				// Bytes per finger record
+	size_t FingerDelta;				// Offset from record start to finger struct
+	size_t ButtonOffset;			// Offset of the button byte (USB only)
+	int32_t XMin;
+	int32_t YMin;
+	int32_t YMax;
+	AMTPTP_THRESHOLDS Thresholds;
+} AMTPTP_DECODER, *PAMTPTP_DECODER;
+
+typedef struct _AMTPTP_CONTACT {
+	uint16_t X;
+	uint16_t Y;
+	uint8_t  ContactID;
+	uint8_t  TipSwitch;
+	uint8_t  Confidence;
+} AMTPTP_CONTACT, *PAMTPTP_CONTACT;
+
+// Unqualified contact size in the units of AMTPTP_THRESHOLDS
+typedef struct _AMTPTP_CONTACT_SIZE {
+	int32_t Major;
+	int32_t Minor;
+	int32_t Pressure;				// 0 where the record has no pressure field
+} AMTPTP_CONTACT_SIZE, *PAMTPTP_CONTACT_SIZE;
+
+typedef struct _AMTPTP_FRAME {
+	uint8_t ContactCount;
+	uint8_t IsButtonClicked;
+	AMTPTP_CONTACT Contacts[AMTPTP_MAX_CONTACTS];
+} AMTPTP_FRAME, *PAMTPTP_FRAME;
+
+// Contact identifiers of the previous frame, device and compact (see AmtPtpMapContactIds).
+// All zero is an empty map.
+typedef struct _AMTPTP_CONTACT_ID_MAP {
+	uint8_t Count;
+	uint8_t DeviceId[AMTPTP_MAX_CONTACTS];
+	uint8_t CompactId[AMTPTP_MAX_CONTACTS];
+} AMTPTP_CONTACT_ID_MAP, *PAMTPTP_CONTACT_ID_MAP;
+
+// Resets the decoder and loads the default thresholds for the format.
+// Geometry (sizes, offsets and ranges) must be filled in by the caller.
+void
+AmtPtpInitDecoder(
+	PAMTPTP_DECODER Decoder,
+	AMTPTP_FRAME_FORMAT Format
+);
+
+// Converts two performance counter readings into the PTP ScanTime field.
+// The caller owns the clock, so replays can supply recorded or virtual time.
+uint16_t
+AmtPtpScanTime(
+	int64_t LastTimestamp,
+	int64_t Timestamp
+);
+
+// Decodes one raw device frame into a neutral contact list.
+// Frame is always fully written, including on failure.
+AMTPTP_DECODE_STATUS
+AmtPtpDecodeFrame(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Buffer,
+	size_t Length,
+	uint32_t Flags,
+	PAMTPTP_FRAME Frame
+);
+
+// Signature of AmtPtpDecodeFrame and of the per-type decoders
+typedef AMTPTP_DECODE_STATUS
+(*PFN_AMTPTP_DECODE_FRAME)(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Buffer,
+	size_t Length,
+	uint32_t Flags,
+	PAMTPTP_FRAME Frame
+);
+
+// Returns a decoder with the frame geometry of Decoder compiled in, one per
+// TRACKPAD_TYPE and one for SPI, or AmtPtpDecodeFrame for any other geometry.
+// Results are identical to AmtPtpDecodeFrame. Select once after configuring
+// the geometry and call the result with the same Decoder.
+PFN_AMTPTP_DECODE_FRAME
+AmtPtpSelectDecoder(
+	const AMTPTP_DECODER *Decoder
+);
+
+// Applies Thresholds to one contact, exactly as AmtPtpDecodeFrame does.
+void
+AmtPtpQualifyContact(
+	const AMTPTP_THRESHOLDS *Thresholds,
+	const AMTPTP_CONTACT_SIZE *Size,
+	uint8_t *TipSwitch,
+	uint8_t *Confidence
+);
+
+// Validates a frame like AmtPtpDecodeFrame, but returns the unqualified size
+// of each contact instead, so thresholds can be evaluated without decoding again.
+// Sizes must hold AMTPTP_MAX_CONTACTS entries.
+AMTPTP_DECODE_STATUS
+AmtPtpDecodeContactSizes(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Buffer,
+	size_t Length,
+	PAMTPTP_CONTACT_SIZE Sizes,
+	uint8_t *Count
+);
+
+// Serializes Frame in the PTP_REPORT wire layout. Report must hold AMTPTP_REPORT_SIZE bytes.
+// Only the first ContactCount contacts are read; the other slots are cleared, so
+// every byte is written and Report can be the HID request's output buffer.
+void
+AmtPtpPackReport(
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime,
+	uint8_t *Report
+);
+
+// Forgets all contacts, e.g. when the device is reconfigured.
+void
+AmtPtpInitContactIdMap(
+	PAMTPTP_CONTACT_ID_MAP Map
+);
+
+// Replaces each ContactID in Frame by one in 0 - AMTPTP_COMPACT_CONTACT_ID_MAX.
+// A contact keeps its identifier while its device identifier is reported in
+// consecutive frames. New contacts get the lowest identifier held by no contact
+// of this or the previous frame, so a lifted finger's identifier is not reused
+// by the next frame.
+void
+AmtPtpMapContactIds(
+	PAMTPTP_CONTACT_ID_MAP Map,
+	PAMTPTP_FRAME Frame
+);
+
+// Same as AmtPtpPackReport for the compact layout. Report must hold
+// AMTPTP_COMPACT_REPORT_SIZE bytes; ContactID is truncated to three bits.
+void
+AmtPtpPackCompactReport(
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime,
+	uint8_t *Report
+);
+
+// Signature of AmtPtpPackReport and AmtPtpPackCompactReport
+typedef void
+(*PFN_AMTPTP_PACK_REPORT)(
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime,
+	uint8_t *Report
+);
+
+// Reads a report of either packer back, telling the layouts apart by
+// ReportSize (AMTPTP_REPORT_SIZE or AMTPTP_COMPACT_REPORT_SIZE). ContactCount
+// is kept as reported, only the first AMTPTP_MAX_CONTACTS slots are read and
+// the others are cleared. A 32-bit ContactID keeps its low byte, which is all
+// the packers write. Returns AmtPtpDecodeUnsupported for any other size and
+// AmtPtpDecodeMalformed for another report ID; Frame is always fully written.
+AMTPTP_DECODE_STATUS
+AmtPtpUnpackReport(
+	const uint8_t *Report,
+	size_t ReportSize,
+	PAMTPTP_FRAME Frame,
+	uint16_t *ScanTime
+);
+
+#ifdef __cplusplus
+}
+#endif
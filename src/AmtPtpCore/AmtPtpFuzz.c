@@ -0,0 +1,345 @@
+// AmtPtpFuzz.c: Fuzzing entry point for every raw frame decoder
+
+#include "AmtPtpFuzz.h"
+#include "AmtPtpBatch.h"
+#include "AmtPtpReplay.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define AMTPTP_FUZZ_FLAGS_ALL		(AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON)
+
+typedef struct _AMTPTP_FUZZ_GEOMETRY {
+	AMTPTP_FRAME_FORMAT Format;
+	size_t HeaderSize;
+	size_t FingerSize;
+	size_t FingerDelta;
+	size_t ButtonOffset;
+	int32_t XMin;
+	int32_t YMin;
+	int32_t YMax;
+} AMTPTP_FUZZ_GEOMETRY;
+
+// One representative device per target (HEADER_TYPEx, FSIZE_TYPEx, DELTA_TYPEx, BUTTON_TYPEx)
+static const AMTPTP_FUZZ_GEOMETRY AmtPtpFuzzGeometry[] = {
+	{ AmtPtpFrameFormatWellspring, 30, 28, 0, 15, -4460, -151, 5005 },
+	{ AmtPtpFrameFormatWellspring, 38, 28, 0, 23, -4620, -150, 6210 },
+	{ AmtPtpFrameFormatWellspring, 46, 30, 2, 31, -5087, -182, 6089 },
+	{ AmtPtpFrameFormatType5, 12, 9, 0, 1, -3678, -2479, 2586 },
+	{ AmtPtpFrameFormatSpi, AMTPTP_SPI_HEADER_SIZE, AMTPTP_SPI_FINGER_SIZE, 0, 1, -4750, -150, 6730 },
+};
+
+// Guarantees every caller of AmtPtpDecodeFrame relies on
+static int
+AmtPtpFuzzCheckFrame(
+	const AMTPTP_DECODER *Decoder,
+	size_t Length,
+	AMTPTP_DECODE_STATUS Status,
+	const AMTPTP_FRAME *Frame
+)
+{
+	size_t i;
+
+	if (Frame->ContactCount > AMTPTP_MAX_CONTACTS || Frame->IsButtonClicked > 1) {
+		return 1;
+	}
+
+	if (Status != AmtPtpDecodeOk) {
+		return Frame->ContactCount != 0 || Frame->IsButtonClicked != 0;
+	}
+
+	if (Decoder->Format != AmtPtpFrameFormatSpi &&
+		(Length < Decoder->HeaderSize || (Length - Decoder->HeaderSize) % Decoder->FingerSize != 0)) {
+		return 1;
+	}
+
+	for (i = 0; i < AMTPTP_MAX_CONTACTS; i++) {
+		const AMTPTP_CONTACT *c = &Frame->Contacts[i];
+
+		if (i >= Frame->ContactCount) {
+			if (c->X || c->Y || c->ContactID || c->TipSwitch || c->Confidence) {
+				return 1;
+			}
+			continue;
+		}
+
+		if (c->TipSwitch > 1 || c->Confidence > 1 || c->ContactID > 0xf) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+AmtPtpFuzzSameFrame(
+	AMTPTP_DECODE_STATUS StatusA,
+	const AMTPTP_FRAME *A,
+	AMTPTP_DECODE_STATUS StatusB,
+	const AMTPTP_FRAME *B
+)
+{
+	size_t i;
+
+	if (StatusA != StatusB || A->ContactCount != B->ContactCount || A->IsButtonClicked != B->IsButtonClicked) {
+		return 0;
+	}
+
+	for (i = 0; i < AMTPTP_MAX_CONTACTS; i++) {
+		const AMTPTP_CONTACT *a = &A->Contacts[i];
+		const AMTPTP_CONTACT *b = &B->Contacts[i];
+
+		if (a->X != b->X || a->Y != b->Y || a->ContactID != b->ContactID ||
+			a->TipSwitch != b->TipSwitch || a->Confidence != b->Confidence) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// Every batch kernel against the AMTPTP_FUZZ_FLAGS_ALL decode of the same frame
+static int
+AmtPtpFuzzCheckBatch(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Data,
+	size_t Size,
+	AMTPTP_DECODE_STATUS Status,
+	const AMTPTP_FRAME *Frame
+)
+{
+	AMTPTP_BATCH_DECODER Batch;
+	AMTPTP_CONTACT_BATCH Scalar, Contacts;
+	AMTPTP_BATCH_KERNEL Kernel;
+	size_t i;
+
+	AmtPtpBatchInit(&Batch, Decoder);
+	Batch.Kernel = AmtPtpBatchKernelScalar;
+	if (AmtPtpBatchDecode(&Batch, Data, Size, &Scalar) != Status) {
+		return 1;
+	}
+
+	if (Status == AmtPtpDecodeOk) {
+		if ((Scalar.Count < AMTPTP_MAX_CONTACTS ? Scalar.Count : AMTPTP_MAX_CONTACTS) != Frame->ContactCount ||
+			Scalar.IsButtonClicked != Frame->IsButtonClicked) {
+			return 1;
+		}
+
+		for (i = 0; i < Frame->ContactCount; i++) {
+			const AMTPTP_CONTACT *c = &Frame->Contacts[i];
+
+			if (Scalar.X[i] != c->X || Scalar.Y[i] != c->Y || Scalar.ContactID[i] != c->ContactID ||
+				Scalar.TipSwitch[i] != c->TipSwitch || Scalar.Confidence[i] != c->Confidence) {
+				return 1;
+			}
+		}
+	}
+
+	for (Kernel = AmtPtpBatchKernelScalar + 1; Kernel < AmtPtpBatchKernelCount; Kernel++) {
+		if (!AmtPtpBatchKernelAvailable(Kernel)) {
+			continue;
+		}
+
+		Batch.Kernel = Kernel;
+		if (AmtPtpBatchDecode(&Batch, Data, Size, &Contacts) != Status ||
+			Contacts.Count != Scalar.Count || Contacts.IsButtonClicked != Scalar.IsButtonClicked ||
+			memcmp(Contacts.X, Scalar.X, sizeof(Scalar) - offsetof(AMTPTP_CONTACT_BATCH, X)) != 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Renumbers a decoded frame like the compact USB builds and packs it into
+// both layouts. Map carries the identifiers of the previous frame.
+static int
+AmtPtpFuzzCheckReports(
+	PAMTPTP_CONTACT_ID_MAP Map,
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime
+)
+{
+	AMTPTP_FRAME Compact = *Frame, Again = *Frame;
+	AMTPTP_CONTACT_ID_MAP Repeat;
+	uint8_t Report[AMTPTP_REPORT_SIZE];
+	uint8_t CompactReport[AMTPTP_COMPACT_REPORT_SIZE];
+	uint32_t Held = 0;
+	size_t i;
+
+	AmtPtpMapContactIds(Map, &Compact);
+	for (i = 0; i < Compact.ContactCount; i++) {
+		if (Compact.Contacts[i].ContactID > AMTPTP_COMPACT_CONTACT_ID_MAX ||
+			(Held & (1u << Compact.Contacts[i].ContactID))) {
+			return 1;
+		}
+		Held |= 1u << Compact.Contacts[i].ContactID;
+	}
+
+	// Contacts reported again keep their identifiers
+	Repeat = *Map;
+	AmtPtpMapContactIds(&Repeat, &Again);
+	for (i = 0; i < Again.ContactCount; i++) {
+		if (Again.Contacts[i].ContactID != Compact.Contacts[i].ContactID) {
+			return 1;
+		}
+	}
+
+	AmtPtpPackReport(Frame, ScanTime, Report);
+	AmtPtpPackCompactReport(&Compact, ScanTime, CompactReport);
+
+	return Report[0] != AMTPTP_REPORTID_MULTITOUCH || CompactReport[0] != AMTPTP_REPORTID_MULTITOUCH ||
+		Report[AMTPTP_REPORT_SIZE - 2] != Frame->ContactCount ||
+		CompactReport[AMTPTP_COMPACT_REPORT_SIZE - 2] != Frame->ContactCount ||
+		Report[AMTPTP_REPORT_SIZE - 1] != Frame->IsButtonClicked ||
+		CompactReport[AMTPTP_COMPACT_REPORT_SIZE - 1] != Frame->IsButtonClicked;
+}
+
+// Selected decoder, batch kernels and packers against AmtPtpDecodeFrame
+static int
+AmtPtpFuzzCrossCheck(
+	const AMTPTP_DECODER *Decoder,
+	PFN_AMTPTP_DECODE_FRAME Selected,
+	PAMTPTP_CONTACT_ID_MAP Map,
+	const uint8_t *Data,
+	size_t Size,
+	uint32_t Flags,
+	AMTPTP_DECODE_STATUS Status,
+	const AMTPTP_FRAME *Frame,
+	uint16_t ScanTime
+)
+{
+	AMTPTP_DECODE_STATUS SelectedStatus;
+	AMTPTP_FRAME SelectedFrame;
+
+	SelectedStatus = Selected(Decoder, Data, Size, Flags, &SelectedFrame);
+	if (!AmtPtpFuzzSameFrame(Status, Frame, SelectedStatus, &SelectedFrame)) {
+		return 1;
+	}
+
+	if (Flags != AMTPTP_FUZZ_FLAGS_ALL) {
+		return 0;
+	}
+
+	if (AmtPtpFuzzCheckBatch(Decoder, Data, Size, Status, Frame)) {
+		return 1;
+	}
+
+	return Status == AmtPtpDecodeOk && AmtPtpFuzzCheckReports(Map, Frame, ScanTime);
+}
+
+static int
+AmtPtpFuzzFrame(
+	const AMTPTP_FUZZ_GEOMETRY *g,
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	static const uint32_t Flags[] = {
+		0, AMTPTP_DECODE_SURFACE, AMTPTP_DECODE_BUTTON, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON
+	};
+	AMTPTP_CONTACT_ID_MAP Map = { 0 };
+	PFN_AMTPTP_DECODE_FRAME Selected;
+	AMTPTP_DECODER Decoder;
+	AMTPTP_FRAME Frame;
+	AMTPTP_DECODE_STATUS Status;
+	size_t i;
+
+	AmtPtpInitDecoder(&Decoder, g->Format);
+	Decoder.HeaderSize = g->HeaderSize;
+	Decoder.FingerSize = g->FingerSize;
+	Decoder.FingerDelta = g->FingerDelta;
+	Decoder.ButtonOffset = g->ButtonOffset;
+	Decoder.XMin = g->XMin;
+	Decoder.YMin = g->YMin;
+	Decoder.YMax = g->YMax;
+
+	// Each geometry is one a driver configures, so this is never the generic decoder
+	Selected = AmtPtpSelectDecoder(&Decoder);
+	if (Selected == AmtPtpDecodeFrame) {
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(Flags) / sizeof(Flags[0]); i++) {
+		Status = AmtPtpDecodeFrame(&Decoder, Data, Size, Flags[i], &Frame);
+		if (AmtPtpFuzzCheckFrame(&Decoder, Size, Status, &Frame) ||
+			AmtPtpFuzzCrossCheck(&Decoder, Selected, &Map, Data, Size, Flags[i], Status, &Frame, 0)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+typedef struct _AMTPTP_FUZZ_REPLAY {
+	int Broken;
+	const AMTPTP_DECODER *Decoder;
+	PFN_AMTPTP_DECODE_FRAME Selected;
+	AMTPTP_CONTACT_ID_MAP Map;		// Carried from frame to frame, as in the drivers
+} AMTPTP_FUZZ_REPLAY;
+
+static int
+AmtPtpFuzzReplaySink(
+	void *Context,
+	const AMTPTP_REPLAY_FRAME *Frame
+)
+{
+	AMTPTP_FUZZ_REPLAY *r = (AMTPTP_FUZZ_REPLAY *) Context;
+
+	// Header geometry is untrusted too, so only check what holds for any decoder
+	if (Frame->Status == AmtPtpDecodeUnsupported) {
+		return 0;
+	}
+
+	r->Broken |= Frame->Frame.ContactCount > AMTPTP_MAX_CONTACTS || Frame->ScanTime > AMTPTP_SCAN_TIME_MAX;
+	r->Broken |= AmtPtpFuzzCrossCheck(r->Decoder, r->Selected, &r->Map, Frame->Raw, Frame->RawLength,
+		AMTPTP_FUZZ_FLAGS_ALL, Frame->Status, &Frame->Frame, Frame->ScanTime);
+	return r->Broken;
+}
+
+static int
+AmtPtpFuzzCapture(
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	AMTPTP_CAPTURE_READER Reader;
+	AMTPTP_REPLAY_STATS Stats;
+	AMTPTP_BENCH_FAMILY Family;
+	AMTPTP_FUZZ_REPLAY Replay = { 0 };
+
+	if (AmtPtpCaptureOpen(&Reader, Data, Size) != AmtPtpCaptureOk) {
+		return 0;
+	}
+
+	// Replay decodes with the reference decoder, the sink checks the selected one against it
+	AmtPtpReplayHeaderFamily(&Reader, &Family);
+	Replay.Decoder = &Family.Decoder;
+	Replay.Selected = Family.DecodeFrame;
+	Family.DecodeFrame = AmtPtpDecodeFrame;
+	AmtPtpReplayCapture(&Reader, &Family, AMTPTP_FUZZ_FLAGS_ALL, AmtPtpFuzzReplaySink, &Replay, &Stats);
+	return Replay.Broken || Stats.Malformed > Stats.Frames;
+}
+
+int
+AmtPtpFuzzOne(
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	uint8_t Target;
+
+	if (Size == 0) {
+		return 0;
+	}
+
+	Target = (uint8_t) (Data[0] % AMTPTP_FUZZ_TARGET_COUNT);
+	Data++;
+	Size--;
+
+	if (Target == AMTPTP_FUZZ_TARGET_CAPTURE) {
+		return AmtPtpFuzzCapture(Data, Size);
+	}
+
+	return AmtPtpFuzzFrame(&AmtPtpFuzzGeometry[Target], Data, Size);
+}
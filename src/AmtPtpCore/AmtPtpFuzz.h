@@ -0,0 +1,43 @@
+// AmtPtpFuzz.h: Fuzzing entry point for every raw frame decoder
+//
+// The first input byte selects a target, the rest is fed to it unchanged:
+//   0 - 2  Wellspring TYPE2 - TYPE4 frame
+//   3      TYPE5 (Magic Trackpad 2) frame
+//   4      SPI trackpad packet
+//   5      Capture file, replayed with the geometry recorded in its header
+//
+// Every frame runs through AmtPtpDecodeFrame, the decoder AmtPtpSelectDecoder
+// picks for the geometry as the drivers do, and every compiled batch kernel;
+// all of them must agree. Decoded frames are then renumbered with
+// AmtPtpMapContactIds, across the frames of a capture, and packed into both
+// report layouts. test/AmtPtpDecodeFuzz.c is the libFuzzer target, and
+// test/corpus/AmtPtpDecodeFuzz its seed corpus: frames prefixed by their
+// selector, and captures prefixed by 5.
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_FUZZ_TARGET_TYPE2	0
+#define AMTPTP_FUZZ_TARGET_TYPE3	1
+#define AMTPTP_FUZZ_TARGET_TYPE4	2
+#define AMTPTP_FUZZ_TARGET_TYPE5	3
+#define AMTPTP_FUZZ_TARGET_SPI		4
+#define AMTPTP_FUZZ_TARGET_CAPTURE	5
+#define AMTPTP_FUZZ_TARGET_COUNT	6
+
+// Runs one input. Returns non-zero if a decoder broke one of its guarantees;
+// memory errors are left to the sanitizers.
+int
+AmtPtpFuzzOne(
+	const uint8_t *Data,
+	size_t Size
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,192 @@
+// AmtPtpGolden.c: Bit-exact regression check of PTP_REPORT streams
+
+#include "AmtPtpGolden.h"
+#include "AmtPtpReplay.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define AMTPTP_GOLDEN_CONTACT_SIZE			9
+#define AMTPTP_GOLDEN_COMPACT_CONTACT_SIZE	5
+
+typedef struct _AMTPTP_GOLDEN_CONTEXT {
+	uint8_t *Out;					// Record: output stream
+	size_t OutSize;
+	const uint8_t *Expected;		// Compare: expected stream
+	size_t ExpectedLength;
+	size_t Offset;
+	uint64_t Reports;
+	AMTPTP_GOLDEN_STATUS Status;
+	PAMTPTP_GOLDEN_MISMATCH Mismatch;
+} AMTPTP_GOLDEN_CONTEXT;
+
+// Returns non-zero to stop at the frame
+static int
+AmtPtpGoldenSink(
+	void *Context,
+	const AMTPTP_REPLAY_FRAME *Replay
+)
+{
+	AMTPTP_GOLDEN_CONTEXT *g = Context;
+	uint32_t Size = Replay->ReportSize;
+	uint32_t i;
+
+	if (Size == 0) {
+		return 0;
+	}
+
+	if (g->Out != NULL) {
+		if (g->OutSize - g->Offset < Size) {
+			g->Status = AmtPtpGoldenBufferTooSmall;
+			return 1;
+		}
+		memcpy(g->Out + g->Offset, Replay->Report, Size);
+	}
+	else {
+		if (g->ExpectedLength - g->Offset < Size) {
+			g->Status = AmtPtpGoldenLengthMismatch;
+			return 1;
+		}
+
+		if (memcmp(g->Expected + g->Offset, Replay->Report, Size) != 0) {
+			for (i = 0; g->Expected[g->Offset + i] == Replay->Report[i]; i++);
+
+			g->Mismatch->Record = Replay->Index;
+			g->Mismatch->Report = g->Reports;
+			g->Mismatch->Offset = i;
+			memcpy(g->Mismatch->Expected, g->Expected + g->Offset, Size);
+			memcpy(g->Mismatch->Actual, Replay->Report, Size);
+			g->Status = AmtPtpGoldenMismatch;
+			return 1;
+		}
+	}
+
+	g->Offset += Size;
+	g->Reports++;
+	return 0;
+}
+
+static AMTPTP_GOLDEN_STATUS
+AmtPtpGoldenRun(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	AMTPTP_GOLDEN_CONTEXT *g
+)
+{
+	AMTPTP_REPLAY_STATS Stats;
+	AMTPTP_CAPTURE_STATUS Status;
+
+	if ((Family->ReportSize != AMTPTP_REPORT_SIZE && Family->ReportSize != AMTPTP_COMPACT_REPORT_SIZE) ||
+		Family->DecodeFrame == NULL || Family->PackReport == NULL) {
+		return AmtPtpGoldenBadFamily;
+	}
+
+	g->Status = AmtPtpGoldenMatch;
+	if (g->Mismatch != NULL) {
+		g->Mismatch->ReportSize = Family->ReportSize;
+	}
+
+	// Same flags the drivers use with surface and button reporting on
+	Status = AmtPtpReplayCapture(Reader, Family, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, AmtPtpGoldenSink,
+		g, &Stats);
+	if (g->Status != AmtPtpGoldenMatch) {
+		return g->Status;
+	}
+
+	if (Status != AmtPtpCaptureEnd) {
+		return AmtPtpGoldenBadCapture;
+	}
+
+	return AmtPtpGoldenMatch;
+}
+
+AMTPTP_GOLDEN_STATUS
+AmtPtpGoldenRecord(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written
+)
+{
+	AMTPTP_GOLDEN_CONTEXT g = { 0 };
+	AMTPTP_GOLDEN_STATUS Status;
+
+	g.Out = Out;
+	g.OutSize = OutSize;
+
+	Status = AmtPtpGoldenRun(Reader, Family, &g);
+	*Written = g.Offset;
+	return Status;
+}
+
+AMTPTP_GOLDEN_STATUS
+AmtPtpGoldenCompare(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	const uint8_t *Expected,
+	size_t ExpectedLength,
+	PAMTPTP_GOLDEN_MISMATCH Mismatch
+)
+{
+	AMTPTP_GOLDEN_CONTEXT g = { 0 };
+	AMTPTP_GOLDEN_MISMATCH Empty = { 0 };
+	AMTPTP_GOLDEN_STATUS Status;
+
+	*Mismatch = Empty;
+	g.Expected = Expected;
+	g.ExpectedLength = ExpectedLength;
+	g.Mismatch = Mismatch;
+
+	Status = AmtPtpGoldenRun(Reader, Family, &g);
+	if (Status == AmtPtpGoldenMatch && g.Offset != ExpectedLength) {
+		Mismatch->Report = g.Reports;
+		return AmtPtpGoldenLengthMismatch;
+	}
+
+	return Status;
+}
+
+void
+AmtPtpGoldenFieldName(
+	uint32_t Offset,
+	uint32_t ReportSize,
+	char *Out,
+	size_t OutSize
+)
+{
+	static const char *ContactFields[AMTPTP_GOLDEN_CONTACT_SIZE] = {
+		"Confidence/TipSwitch", "ContactID", "ContactID", "ContactID", "ContactID", "X", "X", "Y", "Y"
+	};
+	static const char *CompactContactFields[AMTPTP_GOLDEN_COMPACT_CONTACT_SIZE] = {
+		"Confidence/TipSwitch/ContactID", "X", "X", "Y", "Y"
+	};
+	static const char *TrailerFields[] = { "ScanTime", "ScanTime", "ContactCount", "IsButtonClicked" };
+	const char **Fields = ContactFields;
+	uint32_t ContactSize = AMTPTP_GOLDEN_CONTACT_SIZE;
+	uint32_t ContactEnd;
+
+	if (OutSize == 0) {
+		return;
+	}
+
+	if (ReportSize == AMTPTP_COMPACT_REPORT_SIZE) {
+		Fields = CompactContactFields;
+		ContactSize = AMTPTP_GOLDEN_COMPACT_CONTACT_SIZE;
+	}
+	ContactEnd = 1 + AMTPTP_MAX_CONTACTS * ContactSize;
+
+	if (Offset == 0) {
+		snprintf(Out, OutSize, "ReportID");
+	}
+	else if (Offset < ContactEnd) {
+		snprintf(Out, OutSize, "Contacts[%u].%s", (unsigned) ((Offset - 1) / ContactSize),
+			Fields[(Offset - 1) % ContactSize]);
+	}
+	else if (Offset < ContactEnd + sizeof(TrailerFields) / sizeof(TrailerFields[0])) {
+		snprintf(Out, OutSize, "%s", TrailerFields[Offset - ContactEnd]);
+	}
+	else {
+		snprintf(Out, OutSize, "(none)");
+	}
+}
@@ -0,0 +1,73 @@
+// AmtPtpGolden.h: Bit-exact regression check of PTP_REPORT streams
+//
+// A golden pair is a capture (AmtPtpCapture.h) plus the report stream one
+// driver build produced for it: one report per frame that decoded
+// successfully, in capture order, with ScanTime derived from the recorded
+// timestamps. Frames run through the frame path of a family row
+// (AMTPTP_BENCH_FAMILY, see AmtPtpReplay.h): the driver's decoder configuration, the decoder
+// function it selected, contact renumbering where the build does it and its
+// packer, so reports are Family->ReportSize bytes each. The decoder stored in
+// the capture header is not used; a change to the driver's configuration
+// shows up as a difference. Each driver build gets its own streams.
+
+#pragma once
+
+#include "AmtPtpBench.h"
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _AMTPTP_GOLDEN_STATUS {
+	AmtPtpGoldenMatch,
+	AmtPtpGoldenMismatch,			// A report differs, see AMTPTP_GOLDEN_MISMATCH
+	AmtPtpGoldenLengthMismatch,		// One stream has more reports than the other
+	AmtPtpGoldenBadCapture,			// Capture header or records are damaged
+	AmtPtpGoldenBufferTooSmall,		// Output buffer cannot hold the stream
+	AmtPtpGoldenBadFamily			// Family report layout is not one the drivers use
+} AMTPTP_GOLDEN_STATUS;
+
+typedef struct _AMTPTP_GOLDEN_MISMATCH {
+	uint64_t Record;				// Capture record of the first diverging frame
+	uint64_t Report;				// Index of that report in the stream
+	uint32_t Offset;				// First differing byte inside the report
+	uint32_t ReportSize;			// Bytes used in Expected and Actual
+	uint8_t Expected[AMTPTP_REPORT_SIZE];
+	uint8_t Actual[AMTPTP_REPORT_SIZE];
+} AMTPTP_GOLDEN_MISMATCH, *PAMTPTP_GOLDEN_MISMATCH;
+
+// Produces the report stream of Family for the remaining records of Reader.
+AMTPTP_GOLDEN_STATUS
+AmtPtpGoldenRecord(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written
+);
+
+// Runs the remaining records of Reader through Family and compares the
+// reports with Expected byte for byte. Stops at the first difference.
+AMTPTP_GOLDEN_STATUS
+AmtPtpGoldenCompare(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	const uint8_t *Expected,
+	size_t ExpectedLength,
+	PAMTPTP_GOLDEN_MISMATCH Mismatch
+);
+
+// Names the field at Offset of a ReportSize-byte PTP_REPORT, e.g.
+// "Contacts[2].X".
+void
+AmtPtpGoldenFieldName(
+	uint32_t Offset,
+	uint32_t ReportSize,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,510 @@
+// AmtPtpHeader.c: Statistics over the undocumented frame header bytes
+
+#include "AmtPtpHeader.h"
+#include "AmtPtpLayout.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AMTPTP_HEADER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Frames with more finger records than this, which only damaged captures
+// have, add their finger sums to the 64-bit totals directly
+#define AMTPTP_HEADER_BLOCK_FINGERS	255
+
+static const char *AmtPtpHeaderKernelNames[AmtPtpHeaderKernelCount] = { "scalar", "sse2" };
+
+// Byte statistics of up to AMTPTP_HEADER_SCAN_BLOCK frames. With at most 255
+// frames of byte values and finger counts up to 255, no lane overflows.
+typedef struct _AMTPTP_HEADER_BLOCK {
+	uint32_t Frames;
+	uint8_t Same[AMTPTP_HEADER_SCAN_BYTES];
+	uint8_t Forward[AMTPTP_HEADER_SCAN_BYTES];
+	uint8_t Backward[AMTPTP_HEADER_SCAN_BYTES];
+	uint8_t Wraps[AMTPTP_HEADER_SCAN_BYTES];
+	uint16_t Sum[AMTPTP_HEADER_SCAN_BYTES];
+	uint16_t SumButton[AMTPTP_HEADER_SCAN_BYTES];
+	uint32_t SumSquares[AMTPTP_HEADER_SCAN_BYTES];
+	uint32_t SumFingers[AMTPTP_HEADER_SCAN_BYTES];
+} AMTPTP_HEADER_BLOCK, *PAMTPTP_HEADER_BLOCK;
+
+static void
+AmtPtpHeaderStep(
+	PAMTPTP_HEADER_STEPS Steps,
+	uint32_t Delta,
+	uint32_t Half,
+	int Wrapped
+)
+{
+	Steps->Same += Delta == 0;
+	Steps->Forward += Delta != 0 && Delta < Half;
+	Steps->Backward += Delta >= Half;
+	Steps->Wraps += Delta != 0 && Delta < Half && Wrapped;
+}
+
+static double
+AmtPtpHeaderCorrelation(
+	double n,
+	double x,
+	double xx,
+	double y,
+	double yy,
+	double xy
+)
+{
+	double d = (n * xx - x * x) * (n * yy - y * y);
+
+	return d > 0 ? (n * xy - x * y) / sqrt(d) : 0.0;
+}
+
+static double
+AmtPtpHeaderEntropy(
+	const uint64_t *Histogram,
+	uint64_t Frames,
+	uint32_t *Distinct
+)
+{
+	double e = 0.0, p;
+	uint32_t v;
+
+	*Distinct = 0;
+	for (v = 0; v < 256; v++) {
+		if (Histogram[v]) {
+			p = (double) Histogram[v] / (double) Frames;
+			e -= p * log2(p);
+			(*Distinct)++;
+		}
+	}
+
+	return e;
+}
+
+int
+AmtPtpHeaderKernelAvailable(
+	AMTPTP_HEADER_KERNEL Kernel
+)
+{
+	switch (Kernel) {
+		case AmtPtpHeaderKernelScalar:
+			return 1;
+#ifdef AMTPTP_HEADER_SSE2
+		case AmtPtpHeaderKernelSse2:
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+const char *
+AmtPtpHeaderKernelName(
+	AMTPTP_HEADER_KERNEL Kernel
+)
+{
+	return (unsigned) Kernel < AmtPtpHeaderKernelCount ? AmtPtpHeaderKernelNames[Kernel] : "unknown";
+}
+
+void
+AmtPtpHeaderScanInit(
+	PAMTPTP_HEADER_SCAN Scan,
+	size_t HeaderSize
+)
+{
+	memset(Scan, 0, sizeof(*Scan));
+	Scan->Bytes = HeaderSize < AMTPTP_HEADER_SCAN_BYTES ? HeaderSize : AMTPTP_HEADER_SCAN_BYTES;
+	Scan->Kernel = AmtPtpHeaderKernelScalar;
+#ifdef AMTPTP_HEADER_SSE2
+	Scan->Kernel = AmtPtpHeaderKernelSse2;
+#endif
+}
+
+// Byte sums and steps of bytes Start to Bytes of one frame. Last is the
+// previous frame, NULL for the first.
+static void
+AmtPtpHeaderBytesScalar(
+	PAMTPTP_HEADER_BLOCK Block,
+	size_t Start,
+	size_t Bytes,
+	const uint8_t *Frame,
+	const uint8_t *Last,
+	uint32_t Fingers,
+	uint8_t Button
+)
+{
+	uint8_t Delta;
+	size_t i;
+
+	for (i = Start; i < Bytes; i++) {
+		Block->Sum[i] = (uint16_t) (Block->Sum[i] + Frame[i]);
+		Block->SumButton[i] = (uint16_t) (Block->SumButton[i] + Frame[i] * Button);
+		Block->SumSquares[i] += (uint32_t) Frame[i] * Frame[i];
+		Block->SumFingers[i] += (uint32_t) Frame[i] * Fingers;
+	}
+
+	if (Last == NULL) {
+		return;
+	}
+
+	for (i = Start; i < Bytes; i++) {
+		Delta = (uint8_t) (Frame[i] - Last[i]);
+		Block->Same[i] += Delta == 0;
+		Block->Forward[i] += Delta != 0 && Delta < 0x80;
+		Block->Backward[i] += Delta >= 0x80;
+		Block->Wraps[i] += Delta != 0 && Delta < 0x80 && Frame[i] < Last[i];
+	}
+}
+
+#ifdef AMTPTP_HEADER_SSE2
+
+// Adds the eight 16-bit lanes of v to four 32-bit counters each side
+static inline void
+AmtPtpHeaderAdd32(
+	uint32_t *Sums,
+	__m128i v
+)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	__m128i *p = (__m128i *) Sums;
+
+	_mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_unpacklo_epi16(v, Zero)));
+	_mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1), _mm_unpackhi_epi16(v, Zero)));
+}
+
+static inline void
+AmtPtpHeaderAdd16(
+	uint16_t *Sums,
+	__m128i v
+)
+{
+	__m128i *p = (__m128i *) Sums;
+
+	_mm_storeu_si128(p, _mm_add_epi16(_mm_loadu_si128(p), v));
+}
+
+// A step mask is all ones where it applies, so subtracting it counts one
+static inline void
+AmtPtpHeaderCount8(
+	uint8_t *Counts,
+	__m128i Mask
+)
+{
+	__m128i *p = (__m128i *) Counts;
+
+	_mm_storeu_si128(p, _mm_sub_epi8(_mm_loadu_si128(p), Mask));
+}
+
+// 16 header bytes per step, the rest of the header on the scalar path. The
+// products fit 16 bits: byte values and finger counts are at most 255.
+static void
+AmtPtpHeaderBytesSse2(
+	PAMTPTP_HEADER_BLOCK Block,
+	size_t Bytes,
+	const uint8_t *Frame,
+	const uint8_t *Last,
+	uint32_t Fingers,
+	uint8_t Button
+)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Ones = _mm_cmpeq_epi8(Zero, Zero);
+	const __m128i Sign = _mm_set1_epi8((char) 0x80);
+	const __m128i FingerLanes = _mm_set1_epi16((short) Fingers);
+	const __m128i ButtonLanes = _mm_set1_epi16((short) Button);
+	__m128i v, l, Low, High, Delta, Same, Backward, Forward;
+	size_t i;
+
+	for (i = 0; i + 16 <= Bytes; i += 16) {
+		v = _mm_loadu_si128((const __m128i *) (Frame + i));
+		Low = _mm_unpacklo_epi8(v, Zero);
+		High = _mm_unpackhi_epi8(v, Zero);
+
+		AmtPtpHeaderAdd16(&Block->Sum[i], Low);
+		AmtPtpHeaderAdd16(&Block->Sum[i + 8], High);
+		AmtPtpHeaderAdd16(&Block->SumButton[i], _mm_mullo_epi16(Low, ButtonLanes));
+		AmtPtpHeaderAdd16(&Block->SumButton[i + 8], _mm_mullo_epi16(High, ButtonLanes));
+		AmtPtpHeaderAdd32(&Block->SumSquares[i], _mm_mullo_epi16(Low, Low));
+		AmtPtpHeaderAdd32(&Block->SumSquares[i + 8], _mm_mullo_epi16(High, High));
+		AmtPtpHeaderAdd32(&Block->SumFingers[i], _mm_mullo_epi16(Low, FingerLanes));
+		AmtPtpHeaderAdd32(&Block->SumFingers[i + 8], _mm_mullo_epi16(High, FingerLanes));
+
+		if (Last == NULL) {
+			continue;
+		}
+
+		// A modular step of 0x80 or more is negative as a signed byte
+		l = _mm_loadu_si128((const __m128i *) (Last + i));
+		Delta = _mm_sub_epi8(v, l);
+		Same = _mm_cmpeq_epi8(Delta, Zero);
+		Backward = _mm_cmplt_epi8(Delta, Zero);
+		Forward = _mm_andnot_si128(_mm_or_si128(Same, Backward), Ones);
+
+		AmtPtpHeaderCount8(&Block->Same[i], Same);
+		AmtPtpHeaderCount8(&Block->Forward[i], Forward);
+		AmtPtpHeaderCount8(&Block->Backward[i], Backward);
+		AmtPtpHeaderCount8(&Block->Wraps[i], _mm_and_si128(Forward,
+			_mm_cmplt_epi8(_mm_xor_si128(v, Sign), _mm_xor_si128(l, Sign))));
+	}
+
+	AmtPtpHeaderBytesScalar(Block, i, Bytes, Frame, Last, Fingers, Button);
+}
+
+#endif
+
+// Adds Block into the totals of Scan and empties it
+static void
+AmtPtpHeaderFold(
+	PAMTPTP_HEADER_SCAN Scan,
+	PAMTPTP_HEADER_BLOCK Block
+)
+{
+	size_t i;
+
+	for (i = 0; i < Scan->Bytes; i++) {
+		Scan->Sum[i] += Block->Sum[i];
+		Scan->SumSquares[i] += Block->SumSquares[i];
+		Scan->SumFingers[i] += Block->SumFingers[i];
+		Scan->SumButton[i] += Block->SumButton[i];
+		Scan->ByteSteps[i].Same += Block->Same[i];
+		Scan->ByteSteps[i].Forward += Block->Forward[i];
+		Scan->ByteSteps[i].Backward += Block->Backward[i];
+		Scan->ByteSteps[i].Wraps += Block->Wraps[i];
+	}
+
+	memset(Block, 0, sizeof(*Block));
+}
+
+static void
+AmtPtpHeaderBlockFrame(
+	PAMTPTP_HEADER_SCAN Scan,
+	PAMTPTP_HEADER_BLOCK Block,
+	const uint8_t *Frame,
+	size_t Length,
+	uint64_t Timestamp,
+	uint32_t Fingers,
+	uint8_t Button
+)
+{
+	const size_t Bytes = Scan->Bytes;
+	const uint8_t *Last = Scan->Frames > 0 ? Scan->Last : NULL;
+	uint32_t BlockFingers = Fingers;
+	double Interval;
+	int16_t Delta;
+	uint16_t Word, LastWord;
+	size_t i;
+
+	if (Length < Bytes) {
+		return;
+	}
+
+	Button = Button ? 1 : 0;
+
+	for (i = 0; i < Bytes; i++) {
+		Scan->Histogram[i][Frame[i]]++;
+	}
+
+	if (Fingers > AMTPTP_HEADER_BLOCK_FINGERS) {
+		for (i = 0; i < Bytes; i++) {
+			Scan->SumFingers[i] += (uint64_t) Frame[i] * Fingers;
+		}
+		BlockFingers = 0;
+	}
+
+#ifdef AMTPTP_HEADER_SSE2
+	if (Scan->Kernel == AmtPtpHeaderKernelSse2) {
+		AmtPtpHeaderBytesSse2(Block, Bytes, Frame, Last, BlockFingers, Button);
+	}
+	else
+#endif
+	{
+		AmtPtpHeaderBytesScalar(Block, 0, Bytes, Frame, Last, BlockFingers, Button);
+	}
+
+	Scan->Fingers += Fingers;
+	Scan->FingerSquares += (uint64_t) Fingers * Fingers;
+	Scan->Clicks += Button;
+
+	if (Last != NULL) {
+		Interval = (double) (Timestamp - Scan->LastTimestamp);
+		Scan->Interval += Interval;
+		Scan->IntervalSquares += Interval * Interval;
+		Scan->Steps++;
+
+		for (i = 0; i + 1 < Bytes; i += 2) {
+			Word = (uint16_t) (Frame[i] | (Frame[i + 1] << 8));
+			LastWord = (uint16_t) (Last[i] | (Last[i + 1] << 8));
+			Delta = (int16_t) (uint16_t) (Word - LastWord);
+
+			AmtPtpHeaderStep(&Scan->WordSteps[i / 2], (uint16_t) (Word - LastWord), 0x8000, Word < LastWord);
+			Scan->DeltaSum[i / 2] += Delta;
+			Scan->DeltaSquares[i / 2] += (double) Delta * Delta;
+			Scan->DeltaInterval[i / 2] += Delta * Interval;
+		}
+	}
+
+	memcpy(Scan->Last, Frame, Bytes);
+	Scan->LastTimestamp = Timestamp;
+	Scan->Frames++;
+
+	if (++Block->Frames == AMTPTP_HEADER_SCAN_BLOCK) {
+		AmtPtpHeaderFold(Scan, Block);
+	}
+}
+
+void
+AmtPtpHeaderScanFrame(
+	PAMTPTP_HEADER_SCAN Scan,
+	const uint8_t *Frame,
+	size_t Length,
+	uint64_t Timestamp,
+	uint32_t Fingers,
+	uint8_t Button
+)
+{
+	AMTPTP_HEADER_BLOCK Block;
+
+	memset(&Block, 0, sizeof(Block));
+	AmtPtpHeaderBlockFrame(Scan, &Block, Frame, Length, Timestamp, Fingers, Button);
+	AmtPtpHeaderFold(Scan, &Block);
+}
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpHeaderScanCapture(
+	PAMTPTP_HEADER_SCAN Scan,
+	PAMTPTP_CAPTURE_READER Reader
+)
+{
+	const AMTPTP_DECODER *d = &Reader->Device.Decoder;
+	AMTPTP_HEADER_BLOCK Block;
+	AMTPTP_CAPTURE_STATUS Status;
+	const uint8_t *Frame;
+	uint64_t Timestamp;
+	uint32_t Length, Fingers;
+
+	memset(&Block, 0, sizeof(Block));
+
+	while ((Status = AmtPtpCaptureNext(Reader, &Timestamp, &Frame, &Length)) == AmtPtpCaptureOk) {
+		if (Length < d->HeaderSize || d->FingerSize == 0) {
+			continue;
+		}
+
+		if (d->Format == AmtPtpFrameFormatSpi) {
+			Fingers = Frame[SPI_NUM_OF_FINGERS];
+		}
+		else {
+			Fingers = (uint32_t) ((Length - d->HeaderSize) / d->FingerSize);
+		}
+
+		AmtPtpHeaderBlockFrame(Scan, &Block, Frame, Length, Timestamp, Fingers,
+			d->ButtonOffset < Length ? Frame[d->ButtonOffset] : 0);
+	}
+
+	AmtPtpHeaderFold(Scan, &Block);
+	return Status == AmtPtpCaptureEnd ? AmtPtpCaptureOk : Status;
+}
+
+static void
+AmtPtpHeaderMergeSteps(
+	PAMTPTP_HEADER_STEPS Target,
+	const AMTPTP_HEADER_STEPS *Source
+)
+{
+	Target->Same += Source->Same;
+	Target->Forward += Source->Forward;
+	Target->Backward += Source->Backward;
+	Target->Wraps += Source->Wraps;
+}
+
+void
+AmtPtpHeaderScanMerge(
+	PAMTPTP_HEADER_SCAN Target,
+	const AMTPTP_HEADER_SCAN *Source
+)
+{
+	size_t i, v;
+
+	if (Source->Bytes < Target->Bytes) {
+		Target->Bytes = Source->Bytes;
+	}
+
+	Target->Frames += Source->Frames;
+	Target->Steps += Source->Steps;
+	Target->Fingers += Source->Fingers;
+	Target->FingerSquares += Source->FingerSquares;
+	Target->Clicks += Source->Clicks;
+	Target->Interval += Source->Interval;
+	Target->IntervalSquares += Source->IntervalSquares;
+
+	for (i = 0; i < AMTPTP_HEADER_SCAN_BYTES; i++) {
+		for (v = 0; v < 256; v++) Target->Histogram[i][v] += Source->Histogram[i][v];
+		AmtPtpHeaderMergeSteps(&Target->ByteSteps[i], &Source->ByteSteps[i]);
+		Target->Sum[i] += Source->Sum[i];
+		Target->SumSquares[i] += Source->SumSquares[i];
+		Target->SumFingers[i] += Source->SumFingers[i];
+		Target->SumButton[i] += Source->SumButton[i];
+	}
+
+	for (i = 0; i < AMTPTP_HEADER_SCAN_WORDS; i++) {
+		AmtPtpHeaderMergeSteps(&Target->WordSteps[i], &Source->WordSteps[i]);
+		Target->DeltaSum[i] += Source->DeltaSum[i];
+		Target->DeltaSquares[i] += Source->DeltaSquares[i];
+		Target->DeltaInterval[i] += Source->DeltaInterval[i];
+	}
+}
+
+void
+AmtPtpHeaderScanByte(
+	const AMTPTP_HEADER_SCAN *Scan,
+	size_t Offset,
+	PAMTPTP_HEADER_FIELD Field
+)
+{
+	AMTPTP_HEADER_FIELD Empty = { 0 };
+	const double n = (double) Scan->Frames;
+
+	*Field = Empty;
+	if (Offset >= Scan->Bytes || Scan->Frames == 0) {
+		return;
+	}
+
+	Field->Entropy = AmtPtpHeaderEntropy(Scan->Histogram[Offset], Scan->Frames, &Field->Distinct);
+	Field->Forward = Scan->Steps ? (double) Scan->ByteSteps[Offset].Forward / (double) Scan->Steps : 0.0;
+	Field->Wraps = Scan->ByteSteps[Offset].Wraps;
+	Field->FingerCorrelation = AmtPtpHeaderCorrelation(n,
+		(double) Scan->Sum[Offset], (double) Scan->SumSquares[Offset],
+		(double) Scan->Fingers, (double) Scan->FingerSquares, (double) Scan->SumFingers[Offset]);
+	Field->ButtonCorrelation = AmtPtpHeaderCorrelation(n,
+		(double) Scan->Sum[Offset], (double) Scan->SumSquares[Offset],
+		(double) Scan->Clicks, (double) Scan->Clicks, (double) Scan->SumButton[Offset]);
+}
+
+void
+AmtPtpHeaderScanWord(
+	const AMTPTP_HEADER_SCAN *Scan,
+	size_t Offset,
+	PAMTPTP_HEADER_FIELD Field
+)
+{
+	AMTPTP_HEADER_FIELD Empty = { 0 };
+	uint32_t Distinct;
+	double LowByte, HighByte;
+	size_t w = Offset / 2;
+
+	*Field = Empty;
+	if ((Offset & 1) || Offset + 1 >= Scan->Bytes || Scan->Frames == 0) {
+		return;
+	}
+
+	// A word holds at least what either byte does and at most both together
+	LowByte = AmtPtpHeaderEntropy(Scan->Histogram[Offset], Scan->Frames, &Distinct);
+	HighByte = AmtPtpHeaderEntropy(Scan->Histogram[Offset + 1], Scan->Frames, &Distinct);
+	Field->EntropyLow = LowByte > HighByte ? LowByte : HighByte;
+	Field->EntropyHigh = LowByte + HighByte;
+	Field->Forward = Scan->Steps ? (double) Scan->WordSteps[w].Forward / (double) Scan->Steps : 0.0;
+	Field->Wraps = Scan->WordSteps[w].Wraps;
+	Field->IntervalCorrelation = AmtPtpHeaderCorrelation((double) Scan->Steps,
+		Scan->DeltaSum[w], Scan->DeltaSquares[w],
+		Scan->Interval, Scan->IntervalSquares, Scan->DeltaInterval[w]);
+}
@@ -0,0 +1,162 @@
+// AmtPtpHeader.h: Statistics over the undocumented frame header bytes
+//
+// Wellspring headers (HEADER_TYPE3 is 19 USHORTs, HEADER_TYPE4 23) carry more
+// than the button byte the drivers read. This collects, for every header
+// byte and every little-endian header word:
+//
+//   - the value histogram, for entropy and constant detection
+//   - forward, backward and wrapping steps between frames, for counters
+//   - correlation with finger count and button state, for summaries
+//   - correlation of word steps with the recorded frame interval, for clocks
+//
+// Accumulators are kept per offset so the per-frame loops run straight over
+// the header. Byte sums and steps are first counted in lanes as narrow as a
+// block of AMTPTP_HEADER_SCAN_BLOCK frames allows, 16 header bytes per SSE2
+// operation on x86 and x64 and a scalar loop elsewhere, then added to the
+// 64-bit totals; both kernels give identical scans. Scans are plain counters:
+// split a corpus one capture per scan and combine with AmtPtpHeaderScanMerge.
+//
+// Only byte histograms are kept, since a 16-bit one per word would not fit a
+// scan. A word's entropy therefore comes as bounds: at least that of its
+// more varied byte, at most the sum of both.
+
+#pragma once
+
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Covers the largest header (SPI and TYPE4, 46 bytes) with room to spare
+#define AMTPTP_HEADER_SCAN_BYTES	64
+#define AMTPTP_HEADER_SCAN_WORDS	(AMTPTP_HEADER_SCAN_BYTES / 2)
+
+// Frames per block of narrow counters: 8-bit step counts and 16-bit byte sums
+#define AMTPTP_HEADER_SCAN_BLOCK	255
+
+typedef enum _AMTPTP_HEADER_KERNEL {
+	AmtPtpHeaderKernelScalar,
+	AmtPtpHeaderKernelSse2,
+	AmtPtpHeaderKernelCount
+} AMTPTP_HEADER_KERNEL;
+
+typedef struct _AMTPTP_HEADER_STEPS {
+	uint64_t Same;
+	uint64_t Forward;				// Modular step below half the range
+	uint64_t Backward;				// Modular step of half the range or more
+	uint64_t Wraps;					// Forward steps that wrapped around
+} AMTPTP_HEADER_STEPS, *PAMTPTP_HEADER_STEPS;
+
+typedef struct _AMTPTP_HEADER_SCAN {
+	size_t Bytes;					// Header bytes covered
+	AMTPTP_HEADER_KERNEL Kernel;
+	uint64_t Frames;
+	uint64_t Steps;					// Frame pairs seen
+
+	// Per byte
+	uint64_t Histogram[AMTPTP_HEADER_SCAN_BYTES][256];
+	AMTPTP_HEADER_STEPS ByteSteps[AMTPTP_HEADER_SCAN_BYTES];
+	uint64_t Sum[AMTPTP_HEADER_SCAN_BYTES];
+	uint64_t SumSquares[AMTPTP_HEADER_SCAN_BYTES];
+	uint64_t SumFingers[AMTPTP_HEADER_SCAN_BYTES];		// Sum of value * finger count
+	uint64_t SumButton[AMTPTP_HEADER_SCAN_BYTES];		// Sum of value while clicked
+
+	// Per little-endian word at even offsets
+	AMTPTP_HEADER_STEPS WordSteps[AMTPTP_HEADER_SCAN_WORDS];
+	double DeltaSum[AMTPTP_HEADER_SCAN_WORDS];			// Signed word steps
+	double DeltaSquares[AMTPTP_HEADER_SCAN_WORDS];
+	double DeltaInterval[AMTPTP_HEADER_SCAN_WORDS];		// Sum of step * interval
+
+	// Frame properties the bytes are correlated with
+	uint64_t Fingers;
+	uint64_t FingerSquares;
+	uint64_t Clicks;
+	double Interval;
+	double IntervalSquares;
+
+	// Previous frame
+	uint8_t Last[AMTPTP_HEADER_SCAN_BYTES];
+	uint64_t LastTimestamp;
+} AMTPTP_HEADER_SCAN, *PAMTPTP_HEADER_SCAN;
+
+// What the statistics suggest about one header byte or word
+typedef struct _AMTPTP_HEADER_FIELD {
+	double Entropy;					// Bits; 0 for a constant. Bytes only
+	double EntropyLow;				// Words: bounds on the entropy in bits, the larger
+	double EntropyHigh;				// byte entropy and the sum of both
+	uint32_t Distinct;				// Distinct byte values (bytes only)
+	double Forward;					// Fraction of steps moving forward
+	uint64_t Wraps;
+	double FingerCorrelation;		// Pearson, bytes only
+	double ButtonCorrelation;		// Pearson, bytes only
+	double IntervalCorrelation;		// Pearson of step and frame interval, words only
+} AMTPTP_HEADER_FIELD, *PAMTPTP_HEADER_FIELD;
+
+// Whether this build has Kernel
+int
+AmtPtpHeaderKernelAvailable(
+	AMTPTP_HEADER_KERNEL Kernel
+);
+
+const char *
+AmtPtpHeaderKernelName(
+	AMTPTP_HEADER_KERNEL Kernel
+);
+
+// HeaderSize is clamped to AMTPTP_HEADER_SCAN_BYTES. Selects the fastest
+// kernel of the build; Kernel may be overridden afterwards, and a kernel
+// missing from the build falls back to scalar.
+void
+AmtPtpHeaderScanInit(
+	PAMTPTP_HEADER_SCAN Scan,
+	size_t HeaderSize
+);
+
+// Accumulates one frame. Frames shorter than the covered header are ignored.
+// Fingers is the raw finger record count, not clamped to AMTPTP_MAX_CONTACTS.
+void
+AmtPtpHeaderScanFrame(
+	PAMTPTP_HEADER_SCAN Scan,
+	const uint8_t *Frame,
+	size_t Length,
+	uint64_t Timestamp,
+	uint32_t Fingers,
+	uint8_t Button
+);
+
+// Accumulates every remaining record of Reader, using its decoder geometry
+// for the header size, finger count and button byte. Frames are counted a
+// block at a time, which is what makes this faster than one
+// AmtPtpHeaderScanFrame per record.
+AMTPTP_CAPTURE_STATUS
+AmtPtpHeaderScanCapture(
+	PAMTPTP_HEADER_SCAN Scan,
+	PAMTPTP_CAPTURE_READER Reader
+);
+
+// Adds Source into Target. Step statistics across the capture boundary are lost.
+void
+AmtPtpHeaderScanMerge(
+	PAMTPTP_HEADER_SCAN Target,
+	const AMTPTP_HEADER_SCAN *Source
+);
+
+void
+AmtPtpHeaderScanByte(
+	const AMTPTP_HEADER_SCAN *Scan,
+	size_t Offset,
+	PAMTPTP_HEADER_FIELD Field
+);
+
+// Offset is the byte offset of the word and must be even
+void
+AmtPtpHeaderScanWord(
+	const AMTPTP_HEADER_SCAN *Scan,
+	size_t Offset,
+	PAMTPTP_HEADER_FIELD Field
+);
+
+#ifdef __cplusplus
+}
+#endif
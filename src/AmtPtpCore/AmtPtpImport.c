@@ -0,0 +1,244 @@
+// AmtPtpImport.c: Converts hid-recorder dumps into captures
+
+#include "AmtPtpImport.h"
+
+typedef struct _AMTPTP_IMPORT_CURSOR {
+	const char *p;
+	const char *End;
+} AMTPTP_IMPORT_CURSOR;
+
+static void
+AmtPtpImportSkipSpaces(
+	AMTPTP_IMPORT_CURSOR *c
+)
+{
+	while (c->p < c->End && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r')) c->p++;
+}
+
+static int
+AmtPtpImportDigit(
+	char ch,
+	uint32_t Base
+)
+{
+	int v = -1;
+
+	if (ch >= '0' && ch <= '9') v = ch - '0';
+	else if (ch >= 'a' && ch <= 'f') v = ch - 'a' + 10;
+	else if (ch >= 'A' && ch <= 'F') v = ch - 'A' + 10;
+
+	return v >= 0 && (uint32_t) v < Base ? v : -1;
+}
+
+// Parses an unsigned number; returns the number of digits consumed
+static size_t
+AmtPtpImportNumber(
+	AMTPTP_IMPORT_CURSOR *c,
+	uint32_t Base,
+	uint64_t *Value
+)
+{
+	size_t Digits = 0;
+	int d;
+
+	AmtPtpImportSkipSpaces(c);
+	*Value = 0;
+
+	while (c->p < c->End && (d = AmtPtpImportDigit(*c->p, Base)) >= 0) {
+		if (*Value > (UINT64_MAX - (uint64_t) d) / Base) {
+			return 0;
+		}
+		*Value = *Value * Base + (uint64_t) d;
+		c->p++;
+		Digits++;
+	}
+
+	return Digits;
+}
+
+// Splits the next line off Text; returns 0 at the end
+static int
+AmtPtpImportNextLine(
+	AMTPTP_IMPORT_CURSOR *Text,
+	AMTPTP_IMPORT_CURSOR *Line
+)
+{
+	if (Text->p >= Text->End) {
+		return 0;
+	}
+
+	Line->p = Text->p;
+	while (Text->p < Text->End && *Text->p != '\n') Text->p++;
+	Line->End = Text->p;
+	if (Text->p < Text->End) Text->p++;
+	return 1;
+}
+
+// Returns the item tag of Line ("I", "D", "E", ...) and moves past "X:"
+static char
+AmtPtpImportTag(
+	AMTPTP_IMPORT_CURSOR *Line
+)
+{
+	char Tag;
+
+	if (Line->End - Line->p < 2 || Line->p[1] != ':') {
+		return 0;
+	}
+
+	Tag = Line->p[0];
+	Line->p += 2;
+	return Tag;
+}
+
+AMTPTP_IMPORT_STATUS
+AmtPtpImportProbe(
+	const char *Text,
+	size_t Length,
+	uint32_t DeviceIndex,
+	uint16_t *IdVendor,
+	uint16_t *IdProduct
+)
+{
+	AMTPTP_IMPORT_CURSOR t = { Text, Text + Length };
+	AMTPTP_IMPORT_CURSOR Line;
+	uint64_t Current = 0, Bus, Vendor, Product;
+
+	*IdVendor = 0;
+	*IdProduct = 0;
+
+	while (AmtPtpImportNextLine(&t, &Line)) {
+		switch (AmtPtpImportTag(&Line)) {
+			case 'D':
+				if (!AmtPtpImportNumber(&Line, 10, &Current)) Current = 0;
+				break;
+			case 'I':
+				if (Current == DeviceIndex && AmtPtpImportNumber(&Line, 16, &Bus) &&
+					AmtPtpImportNumber(&Line, 16, &Vendor) && AmtPtpImportNumber(&Line, 16, &Product) &&
+					Vendor <= 0xFFFF && Product <= 0xFFFF) {
+					*IdVendor = (uint16_t) Vendor;
+					*IdProduct = (uint16_t) Product;
+					return AmtPtpImportOk;
+				}
+				break;
+		}
+	}
+
+	return AmtPtpImportNoDevice;
+}
+
+// Parses "<sec>.<usec> <length> <bytes>" into Frame
+static AMTPTP_IMPORT_STATUS
+AmtPtpImportEvent(
+	AMTPTP_IMPORT_CURSOR *Line,
+	uint64_t *Seconds,
+	uint64_t *Micros,
+	uint8_t *Frame,
+	size_t FrameSize,
+	uint32_t *Length
+)
+{
+	uint64_t Count, Byte, i;
+
+	if (!AmtPtpImportNumber(Line, 10, Seconds) || Line->p >= Line->End || *Line->p != '.') {
+		return AmtPtpImportBadLine;
+	}
+	Line->p++;
+
+	if (!AmtPtpImportNumber(Line, 10, Micros) || *Micros >= 1000000 ||
+		!AmtPtpImportNumber(Line, 10, &Count) || Count > AMTPTP_IMPORT_REPORT_MAX) {
+		return AmtPtpImportBadLine;
+	}
+	if (Count > FrameSize) {
+		return AmtPtpImportBufferTooSmall;
+	}
+
+	for (i = 0; i < Count; i++) {
+		if (AmtPtpImportNumber(Line, 16, &Byte) != 2) {
+			return AmtPtpImportBadLine;
+		}
+		Frame[i] = (uint8_t) Byte;
+	}
+
+	// A dump cut inside a line may still end on a whole byte
+	AmtPtpImportSkipSpaces(Line);
+	if (Line->p != Line->End) {
+		return AmtPtpImportBadLine;
+	}
+
+	*Length = (uint32_t) Count;
+	return AmtPtpImportOk;
+}
+
+AMTPTP_IMPORT_STATUS
+AmtPtpImportHidRecorder(
+	const char *Text,
+	size_t Length,
+	uint32_t DeviceIndex,
+	int ReportId,
+	const AMTPTP_CAPTURE_DEVICE *Device,
+	uint8_t *Frame,
+	size_t FrameSize,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written,
+	PAMTPTP_IMPORT_STATS Stats
+)
+{
+	AMTPTP_IMPORT_STATS Empty = { 0 };
+	AMTPTP_IMPORT_STATUS Status;
+	AMTPTP_IMPORT_CURSOR t = { Text, Text + Length };
+	AMTPTP_IMPORT_CURSOR Line;
+	uint64_t Current = 0, Seconds, Micros, Timestamp;
+	uint64_t Frequency = Device->TimestampFrequency;
+	uint32_t FrameLength;
+	size_t Offset, Record;
+
+	*Written = 0;
+	*Stats = Empty;
+
+	if (AmtPtpCaptureEncodeHeader(Device, Out, OutSize, &Offset) != AmtPtpCaptureOk) {
+		return AmtPtpImportBufferTooSmall;
+	}
+
+	while (AmtPtpImportNextLine(&t, &Line)) {
+		Stats->Lines++;
+
+		switch (AmtPtpImportTag(&Line)) {
+			case 'D':
+				if (!AmtPtpImportNumber(&Line, 10, &Current)) Current = 0;
+				break;
+			case 'E':
+				Status = AmtPtpImportEvent(&Line, &Seconds, &Micros, Frame, FrameSize, &FrameLength);
+				if (Status == AmtPtpImportOk && Frequency && Seconds > (UINT64_MAX - Frequency) / Frequency) {
+					Status = AmtPtpImportBadLine;
+				}
+				if (Status != AmtPtpImportOk) {
+					Stats->BadLine = Stats->Lines;
+					*Written = Offset;
+					return Status;
+				}
+
+				if (Current != DeviceIndex ||
+					(ReportId != AMTPTP_IMPORT_ANY_REPORT && (FrameLength == 0 || Frame[0] != ReportId))) {
+					Stats->Skipped++;
+					break;
+				}
+
+				Timestamp = Seconds * Frequency + Micros * Frequency / 1000000;
+				if (AmtPtpCaptureEncodeRecord(Timestamp, Frame, FrameLength, Out + Offset, OutSize - Offset,
+					&Record) != AmtPtpCaptureOk) {
+					Stats->BadLine = Stats->Lines;
+					*Written = Offset;
+					return AmtPtpImportBufferTooSmall;
+				}
+
+				Offset += Record;
+				Stats->Frames++;
+				break;
+		}
+	}
+
+	*Written = Offset;
+	return AmtPtpImportOk;
+}
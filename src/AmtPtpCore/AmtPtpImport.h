@@ -0,0 +1,79 @@
+// AmtPtpImport.h: Converts hid-recorder dumps into captures
+//
+// hid-recorder (hid-tools) writes one line per item:
+//   I: <bus> <vendor> <product>         device identity, hex
+//   D: <index>                          selects the device following lines belong to
+//   E: <sec>.<usec> <length> <bytes>    one raw HID report, bytes in hex
+// Everything else (names, descriptors, comments) is ignored.
+//
+// Reports are re-encoded as capture records unchanged, so the dump must hold
+// the multitouch reports exactly as the device sends them, e.g. Magic
+// Trackpad 2 after hid-magicmouse switched it to multitouch mode. bcm5974
+// trackpads are not HID devices in Wellspring mode; their traffic has to
+// come from a usbmon dump converted to the same line format.
+//
+// AmtPtpImport<Driver> is the command line front end; it takes the decoder
+// of the dumped product from the family rows of a driver build.
+
+#pragma once
+
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Accept every report regardless of its first byte
+#define AMTPTP_IMPORT_ANY_REPORT	-1
+
+// Longest report hid-recorder can print (HID_MAX_BUFFER_SIZE)
+#define AMTPTP_IMPORT_REPORT_MAX	16384
+
+typedef enum _AMTPTP_IMPORT_STATUS {
+	AmtPtpImportOk,
+	AmtPtpImportNoDevice,			// No I: line for the selected device
+	AmtPtpImportBadLine,			// An E: line could not be parsed
+	AmtPtpImportBufferTooSmall		// Out, or Frame for the report on Stats->BadLine
+} AMTPTP_IMPORT_STATUS;
+
+typedef struct _AMTPTP_IMPORT_STATS {
+	uint64_t Lines;
+	uint64_t Frames;				// Reports written as records
+	uint64_t Skipped;				// Reports of other devices or report IDs
+	uint64_t BadLine;				// Line number of the line the import stopped at
+} AMTPTP_IMPORT_STATS, *PAMTPTP_IMPORT_STATS;
+
+// Reads the identity of device DeviceIndex so the caller can look up its
+// geometry (Bcm5974ConfigTable) before importing.
+AMTPTP_IMPORT_STATUS
+AmtPtpImportProbe(
+	const char *Text,
+	size_t Length,
+	uint32_t DeviceIndex,
+	uint16_t *IdVendor,
+	uint16_t *IdProduct
+);
+
+// Writes a capture holding the reports of device DeviceIndex. Device supplies
+// the header; timestamps are converted to Device->TimestampFrequency ticks.
+// ReportId keeps only reports starting with that byte. Frame holds one report
+// while it is parsed; AMTPTP_IMPORT_REPORT_MAX bytes take any report. On
+// failure Out still holds a valid capture of the reports before the line.
+AMTPTP_IMPORT_STATUS
+AmtPtpImportHidRecorder(
+	const char *Text,
+	size_t Length,
+	uint32_t DeviceIndex,
+	int ReportId,
+	const AMTPTP_CAPTURE_DEVICE *Device,
+	uint8_t *Frame,
+	size_t FrameSize,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written,
+	PAMTPTP_IMPORT_STATS Stats
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+// AmtPtpLayout.h: Byte offsets of the device frame formats
+//
+// Private to AmtPtpCore. Mirrors struct TRACKPAD_FINGER, struct
+// TRACKPAD_FINGER_TYPE5 and SPI_TRACKPAD_PACKET in the drivers'
+// AppleDefinition.h without depending on their compiler-specific layout.
+
+#pragma once
+
+// Frame geometry per TRACKPAD_TYPE (HEADER_TYPEx, FSIZE_TYPEx, DELTA_TYPEx, BUTTON_TYPEx)
+#define HEADER_SIZE_TYPE2		30
+#define FINGER_SIZE_TYPE2		28
+#define FINGER_DELTA_TYPE2		0
+#define BUTTON_OFFSET_TYPE2		15
+#define HEADER_SIZE_TYPE3		38
+#define FINGER_SIZE_TYPE3		28
+#define FINGER_DELTA_TYPE3		0
+#define BUTTON_OFFSET_TYPE3		23
+#define HEADER_SIZE_TYPE4		46
+#define FINGER_SIZE_TYPE4		30
+#define FINGER_DELTA_TYPE4		2
+#define BUTTON_OFFSET_TYPE4		31
+#define HEADER_SIZE_TYPE5		12
+#define FINGER_SIZE_TYPE5		9
+#define FINGER_DELTA_TYPE5		0
+#define BUTTON_OFFSET_TYPE5		1
+
+// Wellspring finger record (struct TRACKPAD_FINGER, le16)
+#define WELLSPRING_ORIGIN		0
+#define WELLSPRING_ABS_X		2
+#define WELLSPRING_ABS_Y		4
+#define WELLSPRING_TOOL_MAJOR	10
+#define WELLSPRING_TOOL_MINOR	12
+#define WELLSPRING_ORIENTATION	14
+#define WELLSPRING_TOUCH_MAJOR	16
+#define WELLSPRING_TOUCH_MINOR	18
+#define WELLSPRING_PRESSURE		24
+#define WELLSPRING_FINGER_READ	20
+#define WELLSPRING_FINGER_FULL	26
+
+// Type5 finger record (struct TRACKPAD_FINGER_TYPE5)
+#define TYPE5_TOUCH_MAJOR		4
+#define TYPE5_TOUCH_MINOR		5
+#define TYPE5_SIZE				6
+#define TYPE5_PRESSURE			7
+#define TYPE5_IDENTIFIER		8
+#define TYPE5_FINGER_READ		9
+
+// SPI packet and finger (SPI_TRACKPAD_PACKET, SPI_TRACKPAD_FINGER)
+#define SPI_CLICK_OCCURRED		1
+#define SPI_NUM_OF_FINGERS		30
+#define SPI_ORIGINAL_X			0
+#define SPI_ORIGINAL_Y			2
+#define SPI_X					4
+#define SPI_Y					6
+#define SPI_TOOL_MAJOR			12
+#define SPI_TOOL_MINOR			14
+#define SPI_ORIENTATION			16
+#define SPI_TOUCH_MAJOR			18
+#define SPI_TOUCH_MINOR			20
+#define SPI_PRESSURE			26
+#define SPI_FINGER_READ			28
+
+// Finger orientation reported for a round contact (MAX_FINGER_ORIENTATION)
+#define FINGER_ORIENTATION_POINT	16384
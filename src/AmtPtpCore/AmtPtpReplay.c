@@ -0,0 +1,88 @@
+// AmtPtpReplay.c: Drives captured frames through the frame path of a driver build
+
+#include "AmtPtpReplay.h"
+
+#include <stdio.h>
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpReplayCapture(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint32_t Flags,
+	PFN_AMTPTP_REPLAY_SINK Sink,
+	void *Context,
+	PAMTPTP_REPLAY_STATS Stats
+)
+{
+	AMTPTP_REPLAY_STATS Empty = { 0 };
+	AMTPTP_REPLAY_FRAME Replay;
+	AMTPTP_CONTACT_ID_MAP Map;
+	AMTPTP_CAPTURE_STATUS Status;
+	uint64_t FirstTimestamp = 0;
+	uint64_t LastTimestamp = 0;
+
+	*Stats = Empty;
+	AmtPtpInitContactIdMap(&Map);
+
+	for (;;) {
+		Status = AmtPtpCaptureNext(Reader, &Replay.Timestamp, &Replay.Raw, &Replay.RawLength);
+		if (Status != AmtPtpCaptureOk) {
+			break;
+		}
+
+		if (Stats->Frames == 0) {
+			FirstTimestamp = LastTimestamp = Replay.Timestamp;
+		}
+
+		Replay.Index = Stats->Frames;
+		Replay.Elapsed = Replay.Timestamp - FirstTimestamp;
+		Replay.ScanTime = AmtPtpScanTime((int64_t) LastTimestamp, (int64_t) Replay.Timestamp);
+		Replay.Status = Family->DecodeFrame(&Family->Decoder, Replay.Raw, Replay.RawLength,
+			Flags, &Replay.Frame);
+		LastTimestamp = Replay.Timestamp;
+
+		// Drivers complete no report for a frame that fails to decode
+		Replay.ReportSize = 0;
+		if (Replay.Status == AmtPtpDecodeOk) {
+			if (Family->MapContactIds) {
+				AmtPtpMapContactIds(&Map, &Replay.Frame);
+			}
+			Family->PackReport(&Replay.Frame, Replay.ScanTime, Replay.Report);
+			Replay.ReportSize = Family->ReportSize;
+			Stats->Reports++;
+		}
+
+		Stats->Frames++;
+		Stats->Duration = Replay.Elapsed;
+		if (Replay.Status != AmtPtpDecodeOk) {
+			Stats->Malformed++;
+		}
+		Stats->Contacts += Replay.Frame.ContactCount;
+		if (Replay.Frame.IsButtonClicked) {
+			Stats->ButtonFrames++;
+		}
+
+		if (Sink != NULL && Sink(Context, &Replay)) {
+			break;
+		}
+	}
+
+	return Status;
+}
+
+void
+AmtPtpReplayHeaderFamily(
+	const AMTPTP_CAPTURE_READER *Reader,
+	PAMTPTP_BENCH_FAMILY Family
+)
+{
+	AMTPTP_BENCH_FAMILY Empty = { 0 };
+
+	*Family = Empty;
+	snprintf(Family->Name, sizeof(Family->Name), "capture/%04x", (unsigned) Reader->Device.IdProduct);
+	Family->ProductId = Reader->Device.IdProduct;
+	Family->Decoder = Reader->Device.Decoder;
+	Family->DecodeFrame = AmtPtpSelectDecoder(&Family->Decoder);
+	Family->PackReport = AmtPtpPackReport;
+	Family->ReportSize = AMTPTP_REPORT_SIZE;
+}
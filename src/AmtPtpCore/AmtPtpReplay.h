@@ -0,0 +1,73 @@
+// AmtPtpReplay.h: Drives captured frames through the frame path of a driver build
+//
+// Replay runs a capture through one family row (AMTPTP_BENCH_FAMILY) exactly
+// as the driver build that produced the row runs its frames: the decoder the
+// driver selected, contact renumbering where the build does it, ScanTime from
+// AmtPtpScanTime on the recorded timestamps and the build's report packer.
+// Pacing and output are left to the sink: it can write reports out, time the
+// loop for throughput, or sleep until Elapsed to reproduce the original timing.
+
+#pragma once
+
+#include "AmtPtpBench.h"
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _AMTPTP_REPLAY_FRAME {
+	uint64_t Index;					// Record number in the capture
+	uint64_t Timestamp;				// Recorded counter value
+	uint64_t Elapsed;				// Ticks since the first record
+	const uint8_t *Raw;				// Raw frame, points into the capture
+	uint32_t RawLength;
+	AMTPTP_DECODE_STATUS Status;
+	uint16_t ScanTime;
+	AMTPTP_FRAME Frame;				// As packed, after contact renumbering
+	uint32_t ReportSize;			// Family->ReportSize, 0 when the frame did not decode
+	uint8_t Report[AMTPTP_REPORT_SIZE];
+} AMTPTP_REPLAY_FRAME, *PAMTPTP_REPLAY_FRAME;
+
+typedef struct _AMTPTP_REPLAY_STATS {
+	uint64_t Frames;
+	uint64_t Malformed;
+	uint64_t Reports;
+	uint64_t Contacts;
+	uint64_t ButtonFrames;
+	uint64_t Duration;				// Ticks between first and last record
+} AMTPTP_REPLAY_STATS, *PAMTPTP_REPLAY_STATS;
+
+// Returns non-zero to stop the replay early.
+typedef int
+(*PFN_AMTPTP_REPLAY_SINK)(
+	void *Context,
+	const AMTPTP_REPLAY_FRAME *Frame
+);
+
+// Replays every remaining record of Reader through Family, which must use a
+// report layout of the drivers. Flags are AMTPTP_DECODE_*. The decoder stored
+// in the capture header is not used. Returns AmtPtpCaptureEnd when the
+// capture was consumed completely.
+AMTPTP_CAPTURE_STATUS
+AmtPtpReplayCapture(
+	PAMTPTP_CAPTURE_READER Reader,
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint32_t Flags,
+	PFN_AMTPTP_REPLAY_SINK Sink,
+	void *Context,
+	PAMTPTP_REPLAY_STATS Stats
+);
+
+// Fills Family with the frame path described by the capture header alone:
+// its decoder, the decoder function AmtPtpSelectDecoder picks for it, the
+// PTP_REPORT layout and no renumbering. For tools without a driver build.
+void
+AmtPtpReplayHeaderFamily(
+	const AMTPTP_CAPTURE_READER *Reader,
+	PAMTPTP_BENCH_FAMILY Family
+);
+
+#ifdef __cplusplus
+}
+#endif
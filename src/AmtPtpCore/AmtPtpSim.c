@@ -0,0 +1,194 @@
+// AmtPtpSim.c: Simulated Wellspring USB device
+
+#include "AmtPtpSim.h"
+
+#include <string.h>
+
+static int
+AmtPtpSimFault(
+	uint32_t Period,
+	uint64_t Count
+)
+{
+	return Period && Count % Period == 0;
+}
+
+void
+AmtPtpSimInit(
+	PAMTPTP_SIM_DEVICE Device,
+	const AMTPTP_MODE_SWITCH *Switch,
+	const AMTPTP_DECODER *Decoder
+)
+{
+	AMTPTP_SIM_DEVICE Empty = { 0 };
+
+	*Device = Empty;
+	Device->Switch = *Switch;
+	Device->Decoder = *Decoder;
+	Device->Script.Gesture = AmtPtpGestureDrag;
+	Device->Script.Fingers = 2;
+	Device->Script.Width = 4000;
+	Device->Script.Height = 3000;
+	Device->Script.Frames = 120;
+	Device->ReportRate = 125;
+	Device->TimestampFrequency = 10000000;
+
+	// Devices come up in HID mouse mode
+	if (Switch->SwitchIndex < AMTPTP_USB_MODE_REPORT_MAX) {
+		Device->ModeReport[Switch->SwitchIndex] = Switch->SwitchOff;
+	}
+}
+
+static AMTPTP_USB_STATUS
+AmtPtpSimBeginControl(
+	PAMTPTP_SIM_DEVICE Device,
+	uint16_t Value,
+	uint16_t Index
+)
+{
+	Device->ControlTransfers++;
+	Device->Clock += Device->Faults.ControlLatency;
+
+	// Unknown reports and injected stalls both end up as a protocol stall
+	if (Value != Device->Switch.RequestValue || Index != Device->Switch.RequestIndex ||
+		AmtPtpSimFault(Device->Faults.StallPeriod, Device->ControlTransfers)) {
+		Device->Stalls++;
+		return AmtPtpUsbStall;
+	}
+
+	return AmtPtpUsbOk;
+}
+
+static AMTPTP_USB_STATUS
+AmtPtpSimControlIn(
+	void *Context,
+	uint8_t Request,
+	uint16_t Value,
+	uint16_t Index,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+)
+{
+	PAMTPTP_SIM_DEVICE Device = (PAMTPTP_SIM_DEVICE) Context;
+	AMTPTP_USB_STATUS Status;
+	uint32_t Size = Device->Switch.Size;
+
+	*Transferred = 0;
+
+	Status = AmtPtpSimBeginControl(Device, Value, Index);
+	if (Status != AmtPtpUsbOk) {
+		return Status;
+	}
+
+	if (Request != AMTPTP_USB_MODE_READ_REQUEST) {
+		Device->Stalls++;
+		return AmtPtpUsbStall;
+	}
+
+	if (Size > Length) Size = Length;
+	if (Size > AMTPTP_USB_MODE_REPORT_MAX) Size = AMTPTP_USB_MODE_REPORT_MAX;
+	if (Size && AmtPtpSimFault(Device->Faults.ShortPeriod, Device->ControlTransfers)) Size--;
+
+	memcpy(Buffer, Device->ModeReport, Size);
+	*Transferred = Size;
+	return AmtPtpUsbOk;
+}
+
+static AMTPTP_USB_STATUS
+AmtPtpSimControlOut(
+	void *Context,
+	uint8_t Request,
+	uint16_t Value,
+	uint16_t Index,
+	const uint8_t *Buffer,
+	uint32_t Length
+)
+{
+	PAMTPTP_SIM_DEVICE Device = (PAMTPTP_SIM_DEVICE) Context;
+	AMTPTP_USB_STATUS Status;
+	int WasOn = Device->IsWellspringModeOn;
+
+	Status = AmtPtpSimBeginControl(Device, Value, Index);
+	if (Status != AmtPtpUsbOk) {
+		return Status;
+	}
+
+	if (Request != AMTPTP_USB_MODE_WRITE_REQUEST || Length != Device->Switch.Size ||
+		Length > AMTPTP_USB_MODE_REPORT_MAX || Device->Switch.SwitchIndex >= Length) {
+		Device->Stalls++;
+		return AmtPtpUsbStall;
+	}
+
+	memcpy(Device->ModeReport, Buffer, Length);
+	Device->IsWellspringModeOn = Device->ModeReport[Device->Switch.SwitchIndex] == Device->Switch.SwitchOn;
+
+	// Streaming restarts from the beginning of the script after every mode change
+	if (Device->IsWellspringModeOn && !WasOn) {
+		Device->FrameIndex = 0;
+		Device->NextFrameTime = Device->Clock + Device->Faults.SettleLatency;
+	}
+
+	return AmtPtpUsbOk;
+}
+
+static AMTPTP_USB_STATUS
+AmtPtpSimReadInterrupt(
+	void *Context,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+)
+{
+	PAMTPTP_SIM_DEVICE Device = (PAMTPTP_SIM_DEVICE) Context;
+	AMTPTP_SYNTH_FRAME Frame;
+	size_t FrameLength;
+
+	*Transferred = 0;
+
+	// HID mouse reports are not simulated; the pipe is quiet outside Wellspring mode
+	if (!Device->IsWellspringModeOn) {
+		return AmtPtpUsbNoData;
+	}
+
+	// Block until the frame is due
+	if (Device->Clock < Device->NextFrameTime) {
+		Device->Clock = Device->NextFrameTime;
+	}
+
+	AmtPtpSynthGestureFrame(&Device->Script, Device->FrameIndex % (Device->Script.Frames ? Device->Script.Frames : 1), &Frame);
+	FrameLength = AmtPtpSynthEncodeFrame(&Device->Decoder, &Frame, Buffer, Length);
+	if (FrameLength == 0) {
+		return AmtPtpUsbStall;
+	}
+
+	Device->Frames++;
+	Device->FrameIndex++;
+	Device->NextFrameTime = Device->Clock + (Device->ReportRate ? Device->TimestampFrequency / Device->ReportRate : 0);
+
+	// Lengths that are off by one never match the header plus whole finger records
+	if (AmtPtpSimFault(Device->Faults.MalformedPeriod, Device->Frames)) {
+		Device->MalformedFrames++;
+		if (FrameLength < Length) {
+			Buffer[FrameLength++] = 0;
+		}
+		else {
+			FrameLength--;
+		}
+	}
+
+	*Transferred = (uint32_t) FrameLength;
+	return AmtPtpUsbOk;
+}
+
+void
+AmtPtpSimGetTransport(
+	PAMTPTP_SIM_DEVICE Device,
+	PAMTPTP_USB_TRANSPORT Transport
+)
+{
+	Transport->Context = Device;
+	Transport->ControlIn = AmtPtpSimControlIn;
+	Transport->ControlOut = AmtPtpSimControlOut;
+	Transport->ReadInterrupt = AmtPtpSimReadInterrupt;
+}
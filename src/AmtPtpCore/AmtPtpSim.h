@@ -0,0 +1,69 @@
+// AmtPtpSim.h: Simulated Wellspring USB device
+//
+// A software stand-in for a Wellspring trackpad behind AMTPTP_USB_TRANSPORT.
+// It answers the mode switch read/modify/write protocol, streams synthetic
+// gesture frames on the interrupt pipe only while Wellspring mode is on, and
+// can inject latency, stalls, short control reads and malformed frame lengths.
+//
+// Time is virtual: every transfer advances Clock by its simulated cost, so
+// mode switch, reset and resume-to-first-frame latencies are deterministic.
+
+#pragma once
+
+#include "AmtPtpSynth.h"
+#include "AmtPtpUsb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fault injection. A zero period disables that fault.
+typedef struct _AMTPTP_SIM_FAULTS {
+	uint64_t ControlLatency;		// Ticks per control transfer
+	uint64_t SettleLatency;			// Ticks from mode on to the first frame
+	uint32_t StallPeriod;			// Stall every Nth control transfer
+	uint32_t ShortPeriod;			// Return one byte less on every Nth control read
+	uint32_t MalformedPeriod;		// Corrupt the length of every Nth frame
+} AMTPTP_SIM_FAULTS, *PAMTPTP_SIM_FAULTS;
+
+typedef struct _AMTPTP_SIM_DEVICE {
+	// Configuration, set up by the caller after AmtPtpSimInit
+	AMTPTP_MODE_SWITCH Switch;
+	AMTPTP_DECODER Decoder;			// Wire format of the interrupt frames
+	AMTPTP_GESTURE_SCRIPT Script;	// Played in a loop while streaming
+	uint32_t ReportRate;			// Frames per second
+	uint64_t TimestampFrequency;	// Clock ticks per second
+	AMTPTP_SIM_FAULTS Faults;
+
+	// State
+	uint64_t Clock;
+	uint64_t NextFrameTime;
+	uint32_t FrameIndex;
+	int IsWellspringModeOn;
+	uint8_t ModeReport[AMTPTP_USB_MODE_REPORT_MAX];
+
+	// Counters
+	uint64_t ControlTransfers;
+	uint64_t Stalls;
+	uint64_t Frames;
+	uint64_t MalformedFrames;
+} AMTPTP_SIM_DEVICE, *PAMTPTP_SIM_DEVICE;
+
+// Resets Device to a powered-on trackpad in HID mouse mode.
+void
+AmtPtpSimInit(
+	PAMTPTP_SIM_DEVICE Device,
+	const AMTPTP_MODE_SWITCH *Switch,
+	const AMTPTP_DECODER *Decoder
+);
+
+// Fills Transport with callbacks that operate on Device.
+void
+AmtPtpSimGetTransport(
+	PAMTPTP_SIM_DEVICE Device,
+	PAMTPTP_USB_TRANSPORT Transport
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,23 @@
+// AmtPtpSpi.c: SPI HID requests of AmtPtpDeviceSpiKm over an abstract I/O target
+
+#include "AmtPtpSpi.h"
+
+AMTPTP_SPI_STATUS
+AmtPtpSpiTargetSetState(
+	const AMTPTP_SPI_TARGET *Target,
+	int DesiredState
+)
+{
+	// SPI_SET_FEATURE
+	uint8_t Feature[2];
+
+	Feature[0] = AMTPTP_SPI_BUS_LOCATION;
+	Feature[1] = DesiredState ? 1 : 0;
+
+	return Target->SetFeature(
+		Target->Context,
+		AMTPTP_SPI_REPORTID_STATE,
+		Feature,
+		sizeof(Feature)
+	);
+}
@@ -0,0 +1,69 @@
+// AmtPtpSpi.h: SPI HID requests of AmtPtpDeviceSpiKm over an abstract I/O target
+//
+// AmtPtpDeviceSpiKm sends IOCTL_HID_GET_DEVICE_ATTRIBUTES, IOCTL_HID_SET_FEATURE
+// and IOCTL_HID_READ_REPORT to the SPI HID minidriver. AMTPTP_SPI_TARGET
+// carries the same three requests so host-side tooling can run them against
+// a simulated target (see AmtPtpSpiSim.h).
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Feature report that powers the trackpad up or down (HID_REPORTID_MOUSE)
+#define AMTPTP_SPI_REPORTID_STATE		2
+#define AMTPTP_SPI_BUS_LOCATION			2
+
+// Largest packet IOCTL_HID_READ_REPORT delivers (lookaside buffer size)
+#define AMTPTP_SPI_REPORT_MAX			(AMTPTP_SPI_HEADER_SIZE + 10 * AMTPTP_SPI_FINGER_SIZE)
+
+typedef enum _AMTPTP_SPI_STATUS {
+	AmtPtpSpiOk,
+	AmtPtpSpiNotConnected,			// Target is gone, e.g. the power rail dropped
+	AmtPtpSpiInvalidRequest			// Target rejected the request
+} AMTPTP_SPI_STATUS;
+
+typedef AMTPTP_SPI_STATUS
+(*PFN_AMTPTP_SPI_GET_ATTRIBUTES)(
+	void *Context,
+	uint16_t *VendorId,
+	uint16_t *ProductId,
+	uint16_t *VersionNumber
+);
+
+typedef AMTPTP_SPI_STATUS
+(*PFN_AMTPTP_SPI_SET_FEATURE)(
+	void *Context,
+	uint8_t ReportId,
+	const uint8_t *Buffer,
+	uint32_t Length
+);
+
+typedef AMTPTP_SPI_STATUS
+(*PFN_AMTPTP_SPI_READ_REPORT)(
+	void *Context,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+);
+
+typedef struct _AMTPTP_SPI_TARGET {
+	void *Context;
+	PFN_AMTPTP_SPI_GET_ATTRIBUTES GetAttributes;
+	PFN_AMTPTP_SPI_SET_FEATURE SetFeature;
+	PFN_AMTPTP_SPI_READ_REPORT ReadReport;
+} AMTPTP_SPI_TARGET, *PAMTPTP_SPI_TARGET;
+
+// Same request as AmtPtpSpiSetState.
+AMTPTP_SPI_STATUS
+AmtPtpSpiTargetSetState(
+	const AMTPTP_SPI_TARGET *Target,
+	int DesiredState
+);
+
+#ifdef __cplusplus
+}
+#endif
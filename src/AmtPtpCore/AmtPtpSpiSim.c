@@ -0,0 +1,162 @@
+// AmtPtpSpiSim.c: Simulated SPI HID target
+
+#include "AmtPtpSpiSim.h"
+
+#include <string.h>
+
+void
+AmtPtpSpiSimInit(
+	PAMTPTP_SPI_SIM_DEVICE Device,
+	uint16_t VendorId,
+	uint16_t ProductId,
+	const AMTPTP_DECODER *Decoder
+)
+{
+	AMTPTP_SPI_SIM_DEVICE Empty = { 0 };
+
+	*Device = Empty;
+	Device->VendorId = VendorId;
+	Device->ProductId = ProductId;
+	Device->Decoder = *Decoder;
+	Device->Script.Gesture = AmtPtpGestureDrag;
+	Device->Script.Fingers = 2;
+	Device->Script.Width = 4000;
+	Device->Script.Height = 3000;
+	Device->Script.Frames = 120;
+	Device->ReportRate = 125;
+	Device->TimestampFrequency = 10000000;
+}
+
+// Applies a scheduled power rail loss. A returning rail leaves the trackpad disabled.
+static int
+AmtPtpSpiSimIsConnected(
+	PAMTPTP_SPI_SIM_DEVICE Device
+)
+{
+	const AMTPTP_SPI_SIM_FAULTS *f = &Device->Faults;
+
+	Device->Requests++;
+
+	if (f->RailLossTime && Device->Clock >= f->RailLossTime &&
+		Device->Clock < f->RailLossTime + f->RailLossDuration) {
+		if (!Device->IsRailLost) {
+			Device->IsRailLost = 1;
+			Device->IsEnabled = 0;
+			Device->RailLosses++;
+		}
+		return 0;
+	}
+
+	Device->IsRailLost = 0;
+	return 1;
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpSpiSimGetAttributes(
+	void *Context,
+	uint16_t *VendorId,
+	uint16_t *ProductId,
+	uint16_t *VersionNumber
+)
+{
+	PAMTPTP_SPI_SIM_DEVICE Device = (PAMTPTP_SPI_SIM_DEVICE) Context;
+
+	Device->Clock += Device->Faults.ControlLatency;
+
+	if (!AmtPtpSpiSimIsConnected(Device)) {
+		return AmtPtpSpiNotConnected;
+	}
+
+	*VendorId = Device->VendorId;
+	*ProductId = Device->ProductId;
+	*VersionNumber = Device->VersionNumber;
+	return AmtPtpSpiOk;
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpSpiSimSetFeature(
+	void *Context,
+	uint8_t ReportId,
+	const uint8_t *Buffer,
+	uint32_t Length
+)
+{
+	PAMTPTP_SPI_SIM_DEVICE Device = (PAMTPTP_SPI_SIM_DEVICE) Context;
+	int WasEnabled = Device->IsEnabled;
+
+	Device->Clock += Device->Faults.ControlLatency;
+
+	if (!AmtPtpSpiSimIsConnected(Device)) {
+		return AmtPtpSpiNotConnected;
+	}
+
+	if (ReportId != AMTPTP_SPI_REPORTID_STATE || Length < 2 || Buffer[0] != AMTPTP_SPI_BUS_LOCATION) {
+		return AmtPtpSpiInvalidRequest;
+	}
+
+	Device->IsEnabled = Buffer[1] ? 1 : 0;
+	if (Device->IsEnabled && !WasEnabled) {
+		Device->FrameIndex = 0;
+		Device->NextFrameTime = Device->Clock + Device->Faults.SettleLatency;
+	}
+
+	return AmtPtpSpiOk;
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpSpiSimReadReport(
+	void *Context,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+)
+{
+	PAMTPTP_SPI_SIM_DEVICE Device = (PAMTPTP_SPI_SIM_DEVICE) Context;
+	AMTPTP_SYNTH_FRAME Frame;
+	size_t PacketLength;
+
+	*Transferred = 0;
+
+	// Reads pend until the next packet is due
+	if (Device->Clock < Device->NextFrameTime) {
+		Device->Clock = Device->NextFrameTime;
+	}
+	Device->Clock += Device->Faults.ReadLatency;
+	Device->NextFrameTime = Device->Clock + (Device->ReportRate ? Device->TimestampFrequency / Device->ReportRate : 0);
+
+	if (!AmtPtpSpiSimIsConnected(Device)) {
+		return AmtPtpSpiNotConnected;
+	}
+
+	Device->Packets++;
+
+	if (!Device->IsEnabled || (Device->Faults.ShortPeriod && Device->Packets % Device->Faults.ShortPeriod == 0)) {
+		PacketLength = Length < AMTPTP_SPI_SIM_IDLE_LENGTH ? Length : AMTPTP_SPI_SIM_IDLE_LENGTH;
+		memset(Buffer, 0, PacketLength);
+		Device->ShortPackets++;
+		*Transferred = (uint32_t) PacketLength;
+		return AmtPtpSpiOk;
+	}
+
+	AmtPtpSynthGestureFrame(&Device->Script, Device->FrameIndex % (Device->Script.Frames ? Device->Script.Frames : 1), &Frame);
+	PacketLength = AmtPtpSynthEncodeFrame(&Device->Decoder, &Frame, Buffer, Length);
+	if (PacketLength == 0) {
+		return AmtPtpSpiInvalidRequest;
+	}
+
+	Device->FrameIndex++;
+	*Transferred = (uint32_t) PacketLength;
+	return AmtPtpSpiOk;
+}
+
+void
+AmtPtpSpiSimGetTarget(
+	PAMTPTP_SPI_SIM_DEVICE Device,
+	PAMTPTP_SPI_TARGET Target
+)
+{
+	Target->Context = Device;
+	Target->GetAttributes = AmtPtpSpiSimGetAttributes;
+	Target->SetFeature = AmtPtpSpiSimSetFeature;
+	Target->ReadReport = AmtPtpSpiSimReadReport;
+}
@@ -0,0 +1,78 @@
+// AmtPtpSpiSim.h: Simulated SPI HID target
+//
+// A software stand-in for the SPI HID minidriver below AmtPtpDeviceSpiKm.
+// It reports the vendor and product ID of a SpiTrackpadConfigTable entry,
+// streams synthetic gesture packets once the trackpad is enabled through the
+// state feature report, and can inject read latency, short packets and loss
+// of the power rail. A disabled trackpad answers reads with short packets,
+// which is what drives the driver's re-enable path on real hardware.
+//
+// Time is virtual: every request advances Clock by its simulated cost.
+
+#pragma once
+
+#include "AmtPtpSpi.h"
+#include "AmtPtpSynth.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Length of the packets returned while the trackpad is disabled
+#define AMTPTP_SPI_SIM_IDLE_LENGTH		8
+
+// Fault injection. A zero period disables that fault.
+typedef struct _AMTPTP_SPI_SIM_FAULTS {
+	uint64_t ControlLatency;		// Ticks per attribute or feature request
+	uint64_t SettleLatency;			// Ticks from enable to the first packet
+	uint64_t ReadLatency;			// Ticks added to every read on top of the report rate
+	uint32_t ShortPeriod;			// Every Nth packet is cut below the header size
+	uint64_t RailLossTime;			// Clock value at which the power rail drops, 0 for never
+	uint64_t RailLossDuration;		// Ticks until the rail comes back
+} AMTPTP_SPI_SIM_FAULTS, *PAMTPTP_SPI_SIM_FAULTS;
+
+typedef struct _AMTPTP_SPI_SIM_DEVICE {
+	// Configuration, set up by the caller after AmtPtpSpiSimInit
+	uint16_t VendorId;
+	uint16_t ProductId;
+	uint16_t VersionNumber;
+	AMTPTP_DECODER Decoder;			// Geometry of the SpiTrackpadConfigTable entry
+	AMTPTP_GESTURE_SCRIPT Script;	// Played in a loop while enabled
+	uint32_t ReportRate;			// Packets per second
+	uint64_t TimestampFrequency;	// Clock ticks per second
+	AMTPTP_SPI_SIM_FAULTS Faults;
+
+	// State
+	uint64_t Clock;
+	uint64_t NextFrameTime;
+	uint32_t FrameIndex;
+	int IsEnabled;
+	int IsRailLost;
+
+	// Counters
+	uint64_t Requests;
+	uint64_t Packets;
+	uint64_t ShortPackets;
+	uint64_t RailLosses;
+} AMTPTP_SPI_SIM_DEVICE, *PAMTPTP_SPI_SIM_DEVICE;
+
+// Resets Device to a powered, disabled trackpad with the given identity.
+// Decoder supplies the coordinate range, e.g. from SpiTrackpadConfigTable.
+void
+AmtPtpSpiSimInit(
+	PAMTPTP_SPI_SIM_DEVICE Device,
+	uint16_t VendorId,
+	uint16_t ProductId,
+	const AMTPTP_DECODER *Decoder
+);
+
+// Fills Target with callbacks that operate on Device.
+void
+AmtPtpSpiSimGetTarget(
+	PAMTPTP_SPI_SIM_DEVICE Device,
+	PAMTPTP_SPI_TARGET Target
+);
+
+#ifdef __cplusplus
+}
+#endif
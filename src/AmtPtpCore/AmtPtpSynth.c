@@ -0,0 +1,263 @@
+// AmtPtpSynth.c: Synthetic frame generator for every supported wire format
+
+#include "AmtPtpSynth.h"
+#include "AmtPtpLayout.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SYNTH_PI 3.14159265358979323846
+
+// Contact sizes in threshold units. A finger qualifies on every format,
+// a palm is large enough to be rejected by every confidence check.
+#define SYNTH_FINGER_MAJOR	400
+#define SYNTH_FINGER_MINOR	300
+#define SYNTH_PALM_MAJOR	3000
+#define SYNTH_PALM_MINOR	2800
+#define SYNTH_PRESSURE		50
+
+static inline void
+AmtPtpWriteS16(
+	uint8_t *p,
+	int32_t v
+)
+{
+	if (v < -32768) v = -32768;
+	if (v > 32767) v = 32767;
+	p[0] = (uint8_t) ((uint32_t) v & 0xFF);
+	p[1] = (uint8_t) (((uint32_t) v >> 8) & 0xFF);
+}
+
+static inline uint8_t
+AmtPtpClampU8(
+	int32_t v
+)
+{
+	return v <= 0 ? 0 : (v >= 0xFF ? 0xFF : (uint8_t) v);
+}
+
+static inline int32_t
+AmtPtpClampS13(
+	int32_t v
+)
+{
+	return v < -4096 ? -4096 : (v > 4095 ? 4095 : v);
+}
+
+static void
+AmtPtpSynthPlace(
+	PAMTPTP_SYNTH_FRAME Frame,
+	double x,
+	double y,
+	int32_t Major,
+	int32_t Minor
+)
+{
+	PAMTPTP_SYNTH_FINGER f = &Frame->Fingers[Frame->FingerCount];
+
+	f->X = (int32_t) x;
+	f->Y = (int32_t) y;
+	f->TouchMajor = Major;
+	f->TouchMinor = Minor;
+	f->Pressure = SYNTH_PRESSURE;
+	f->Id = (uint8_t) Frame->FingerCount;
+	Frame->FingerCount++;
+}
+
+void
+AmtPtpSynthGestureFrame(
+	const AMTPTP_GESTURE_SCRIPT *Script,
+	uint32_t FrameIndex,
+	PAMTPTP_SYNTH_FRAME Frame
+)
+{
+	AMTPTP_SYNTH_FRAME Empty = { 0 };
+	uint32_t n = Script->Fingers;
+	uint32_t i;
+	double w = Script->Width, h = Script->Height;
+	double t = Script->Frames > 1 ? (double) FrameIndex / (double) (Script->Frames - 1) : 0.0;
+	double r, a;
+
+	*Frame = Empty;
+
+	if (n > AMTPTP_SYNTH_MAX_FINGERS) n = AMTPTP_SYNTH_MAX_FINGERS;
+	if (t > 1.0) t = 1.0;
+
+	switch (Script->Gesture) {
+		case AmtPtpGestureDrag:
+			for (i = 0; i < n; i++) {
+				AmtPtpSynthPlace(Frame, w * (0.15 + 0.5 * t) + i * w / 40, h * 0.5 + (i % 2) * h / 20,
+					SYNTH_FINGER_MAJOR, SYNTH_FINGER_MINOR);
+			}
+			break;
+		case AmtPtpGesturePinch:
+			r = h * 0.4 * (1.0 - 0.75 * t);
+			for (i = 0; i < n; i++) {
+				a = 2 * SYNTH_PI * i / n;
+				AmtPtpSynthPlace(Frame, w / 2 + r * cos(a), h / 2 + r * sin(a),
+					SYNTH_FINGER_MAJOR, SYNTH_FINGER_MINOR);
+			}
+			break;
+		case AmtPtpGestureRotate:
+			r = h * 0.3;
+			for (i = 0; i < n; i++) {
+				a = 2 * SYNTH_PI * i / n + t * SYNTH_PI / 2;
+				AmtPtpSynthPlace(Frame, w / 2 + r * cos(a), h / 2 + r * sin(a),
+					SYNTH_FINGER_MAJOR, SYNTH_FINGER_MINOR);
+			}
+			break;
+		case AmtPtpGestureRestAndTap:
+			// Resting thumb, other fingers land and lift every 8 frames
+			AmtPtpSynthPlace(Frame, w * 0.3, h * 0.85, SYNTH_FINGER_MAJOR, SYNTH_FINGER_MINOR);
+			if ((FrameIndex / 8) % 2 == 0) {
+				for (i = 1; i < n; i++) {
+					AmtPtpSynthPlace(Frame, w * 0.4 + i * w / 40, h * 0.4,
+						SYNTH_FINGER_MAJOR, SYNTH_FINGER_MINOR);
+				}
+			}
+			break;
+		case AmtPtpGesturePalmDrift:
+			AmtPtpSynthPlace(Frame, w * (0.7 + 0.05 * t), h * (0.8 - 0.05 * t), SYNTH_PALM_MAJOR, SYNTH_PALM_MINOR);
+			for (i = 1; i < n; i++) {
+				AmtPtpSynthPlace(Frame, w * (0.1 + 0.4 * t) + i * w / 40, h * 0.3,
+					SYNTH_FINGER_MAJOR, SYNTH_FINGER_MINOR);
+			}
+			break;
+	}
+
+	for (i = 0; i < Frame->FingerCount; i++) {
+		if (Frame->Fingers[i].X < 0) Frame->Fingers[i].X = 0;
+		if (Frame->Fingers[i].X > Script->Width) Frame->Fingers[i].X = Script->Width;
+		if (Frame->Fingers[i].Y < 0) Frame->Fingers[i].Y = 0;
+		if (Frame->Fingers[i].Y > Script->Height) Frame->Fingers[i].Y = Script->Height;
+	}
+}
+
+static void
+AmtPtpSynthWellspringFinger(
+	const AMTPTP_DECODER *Decoder,
+	const AMTPTP_SYNTH_FINGER *Finger,
+	uint8_t *f
+)
+{
+	AmtPtpWriteS16(f + WELLSPRING_ORIGIN, 1);
+	AmtPtpWriteS16(f + WELLSPRING_ABS_X, Finger->X + Decoder->XMin);
+	AmtPtpWriteS16(f + WELLSPRING_ABS_Y, Decoder->YMax - Finger->Y);
+	AmtPtpWriteS16(f + WELLSPRING_TOOL_MAJOR, Finger->TouchMajor / 2);
+	AmtPtpWriteS16(f + WELLSPRING_TOOL_MINOR, Finger->TouchMinor / 2);
+	AmtPtpWriteS16(f + WELLSPRING_ORIENTATION, FINGER_ORIENTATION_POINT);
+	AmtPtpWriteS16(f + WELLSPRING_TOUCH_MAJOR, Finger->TouchMajor / 2);
+	AmtPtpWriteS16(f + WELLSPRING_TOUCH_MINOR, Finger->TouchMinor / 2);
+
+	// Only forcetouch layouts are large enough to carry pressure
+	if (Decoder->FingerSize >= Decoder->FingerDelta + WELLSPRING_FINGER_FULL + 2) {
+		AmtPtpWriteS16(f + WELLSPRING_PRESSURE, Finger->Pressure);
+	}
+}
+
+static void
+AmtPtpSynthType5Finger(
+	const AMTPTP_DECODER *Decoder,
+	const AMTPTP_SYNTH_FINGER *Finger,
+	uint8_t *f
+)
+{
+	uint32_t x = (uint32_t) AmtPtpClampS13(Finger->X + Decoder->XMin) & 0x1fff;
+	int32_t y = -(Finger->Y + Decoder->YMin) - (x != 0);
+	uint32_t Raw = x | (((uint32_t) AmtPtpClampS13(y) & 0x1fff) << 13);
+
+	f[0] = (uint8_t) (Raw & 0xFF);
+	f[1] = (uint8_t) ((Raw >> 8) & 0xFF);
+	f[2] = (uint8_t) ((Raw >> 16) & 0xFF);
+	f[3] = (uint8_t) ((Raw >> 24) & 0xFF);
+	f[TYPE5_TOUCH_MAJOR] = AmtPtpClampU8(Finger->TouchMajor / 2);
+	f[TYPE5_TOUCH_MINOR] = AmtPtpClampU8(Finger->TouchMinor / 2);
+	f[TYPE5_SIZE] = AmtPtpClampU8(Finger->TouchMajor / 2);
+	f[TYPE5_PRESSURE] = AmtPtpClampU8(Finger->Pressure);
+	f[TYPE5_IDENTIFIER] = Finger->Id & 0xf;
+}
+
+static void
+AmtPtpSynthSpiFinger(
+	const AMTPTP_DECODER *Decoder,
+	const AMTPTP_SYNTH_FINGER *Finger,
+	uint8_t *f
+)
+{
+	AmtPtpWriteS16(f + SPI_ORIGINAL_X, Finger->X + Decoder->XMin);
+	AmtPtpWriteS16(f + SPI_ORIGINAL_Y, Decoder->YMax - Finger->Y);
+	AmtPtpWriteS16(f + SPI_X, Finger->X + Decoder->XMin);
+	AmtPtpWriteS16(f + SPI_Y, Decoder->YMax - Finger->Y);
+	AmtPtpWriteS16(f + SPI_TOOL_MAJOR, Finger->TouchMajor);
+	AmtPtpWriteS16(f + SPI_TOOL_MINOR, Finger->TouchMinor);
+	AmtPtpWriteS16(f + SPI_ORIENTATION, FINGER_ORIENTATION_POINT);
+	AmtPtpWriteS16(f + SPI_TOUCH_MAJOR, Finger->TouchMajor);
+	AmtPtpWriteS16(f + SPI_TOUCH_MINOR, Finger->TouchMinor);
+	AmtPtpWriteS16(f + SPI_PRESSURE, Finger->Pressure);
+}
+
+size_t
+AmtPtpSynthEncodeFrame(
+	const AMTPTP_DECODER *Decoder,
+	const AMTPTP_SYNTH_FRAME *Frame,
+	uint8_t *Out,
+	size_t OutSize
+)
+{
+	uint32_t Count = Frame->FingerCount;
+	uint32_t MaxCount = AMTPTP_SYNTH_MAX_FINGERS;
+	size_t Length, i;
+	uint8_t *f;
+
+	if (Decoder->Format == AmtPtpFrameFormatSpi) {
+		MaxCount = AMTPTP_SYNTH_SPI_MAX_FINGERS;
+	}
+	else if (Decoder->Format != AmtPtpFrameFormatWellspring && Decoder->Format != AmtPtpFrameFormatType5) {
+		return 0;
+	}
+
+	if (Count > MaxCount) Count = MaxCount;
+
+	Length = Decoder->HeaderSize + Count * Decoder->FingerSize;
+	if (Decoder->FingerSize == 0 || OutSize < Length || Decoder->ButtonOffset >= Decoder->HeaderSize) {
+		return 0;
+	}
+
+	memset(Out, 0, Length);
+	Out[Decoder->ButtonOffset] = Frame->Button ? 1 : 0;
+
+	f = Out + Decoder->HeaderSize + Decoder->FingerDelta;
+	for (i = 0; i < Count; i++, f += Decoder->FingerSize) {
+		switch (Decoder->Format) {
+			case AmtPtpFrameFormatWellspring:
+				AmtPtpSynthWellspringFinger(Decoder, &Frame->Fingers[i], f);
+				break;
+			case AmtPtpFrameFormatType5:
+				AmtPtpSynthType5Finger(Decoder, &Frame->Fingers[i], f);
+				break;
+			case AmtPtpFrameFormatSpi:
+				AmtPtpSynthSpiFinger(Decoder, &Frame->Fingers[i], f);
+				break;
+		}
+	}
+
+	if (Decoder->Format == AmtPtpFrameFormatSpi) {
+		Out[SPI_NUM_OF_FINGERS] = (uint8_t) Count;
+	}
+
+	return Length;
+}
+
+uint64_t
+AmtPtpSynthTimestamp(
+	uint32_t FrameIndex,
+	uint32_t ReportRate,
+	uint64_t TimestampFrequency
+)
+{
+	if (ReportRate == 0) {
+		return 0;
+	}
+
+	return (uint64_t) FrameIndex * TimestampFrequency / ReportRate;
+}
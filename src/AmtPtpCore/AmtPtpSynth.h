@@ -0,0 +1,81 @@
+// AmtPtpSynth.h: Synthetic frame generator for every supported wire format
+//
+// Encodes scripted contacts into byte-exact device frames, i.e. the inverse of
+// AmtPtpDecodeFrame. Coordinates are in the decoder's output space: X grows to
+// the right from 0 to (x.max - x.min), Y grows downwards from 0 to (y.max - y.min).
+// Touch sizes use the same units as AMTPTP_THRESHOLDS.
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Most contacts a Wellspring frame carries (MAX_FINGERS)
+#define AMTPTP_SYNTH_MAX_FINGERS	16
+
+// Most contacts a SPI packet carries (SPI_TRACKPAD_MAX_FINGERS)
+#define AMTPTP_SYNTH_SPI_MAX_FINGERS	10
+
+typedef struct _AMTPTP_SYNTH_FINGER {
+	int32_t X;
+	int32_t Y;
+	int32_t TouchMajor;
+	int32_t TouchMinor;
+	int32_t Pressure;
+	uint8_t Id;
+} AMTPTP_SYNTH_FINGER, *PAMTPTP_SYNTH_FINGER;
+
+typedef struct _AMTPTP_SYNTH_FRAME {
+	uint32_t FingerCount;
+	uint8_t Button;
+	AMTPTP_SYNTH_FINGER Fingers[AMTPTP_SYNTH_MAX_FINGERS];
+} AMTPTP_SYNTH_FRAME, *PAMTPTP_SYNTH_FRAME;
+
+typedef enum _AMTPTP_GESTURE {
+	AmtPtpGestureDrag,				// Fingers side by side moving left to right
+	AmtPtpGesturePinch,				// Fingers on a circle closing in on the centre
+	AmtPtpGestureRotate,			// Fingers on a circle turning a quarter turn
+	AmtPtpGestureRestAndTap,		// One resting finger, the others tapping repeatedly
+	AmtPtpGesturePalmDrift			// A palm drifting slowly while the others drag
+} AMTPTP_GESTURE;
+
+typedef struct _AMTPTP_GESTURE_SCRIPT {
+	AMTPTP_GESTURE Gesture;
+	uint32_t Fingers;				// Contacts taking part, 1 - AMTPTP_SYNTH_MAX_FINGERS
+	int32_t Width;					// x.max - x.min of the target device
+	int32_t Height;					// y.max - y.min of the target device
+	uint32_t Frames;				// Gesture length; the report rate is up to the caller
+} AMTPTP_GESTURE_SCRIPT, *PAMTPTP_GESTURE_SCRIPT;
+
+// Fills Frame with the contacts of Script at FrameIndex.
+void
+AmtPtpSynthGestureFrame(
+	const AMTPTP_GESTURE_SCRIPT *Script,
+	uint32_t FrameIndex,
+	PAMTPTP_SYNTH_FRAME Frame
+);
+
+// Encodes Frame in the wire format described by Decoder.
+// Returns the frame length, or 0 if Out is too small or the format is unknown.
+size_t
+AmtPtpSynthEncodeFrame(
+	const AMTPTP_DECODER *Decoder,
+	const AMTPTP_SYNTH_FRAME *Frame,
+	uint8_t *Out,
+	size_t OutSize
+);
+
+// Counter value of FrameIndex for a given report rate, for capture timestamps.
+uint64_t
+AmtPtpSynthTimestamp(
+	uint32_t FrameIndex,
+	uint32_t ReportRate,
+	uint64_t TimestampFrequency
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,330 @@
+// AmtPtpTrack.c: Tracking quality of emitted PTP_REPORT streams
+
+#include "AmtPtpTrack.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Largest frame of any family: TYPE4 header plus 16 fingers
+#define AMTPTP_TRACK_FRAME_MAX		(46 + AMTPTP_SYNTH_MAX_FINGERS * 30)
+
+// Clock used for the ScanTime of generated reports
+#define AMTPTP_TRACK_REPORT_RATE	125
+#define AMTPTP_TRACK_FREQUENCY		10000000
+
+static const char *AmtPtpTrackGestureNames[] = { "drag", "pinch", "rotate", "rest_and_tap", "palm_drift" };
+
+typedef struct _AMTPTP_TRACK_REPORTED {
+	uint8_t TipSwitch;
+	uint8_t Confidence;
+	uint8_t Assigned;				// Matched to a truth contact or to a lifting one
+	uint32_t ContactID;
+	int32_t X;
+	int32_t Y;
+} AMTPTP_TRACK_REPORTED;
+
+static void
+AmtPtpTrackPush(
+	int32_t *History,
+	int32_t v
+)
+{
+	memmove(History + 1, History, (AMTPTP_TRACK_HISTORY - 1) * sizeof(*History));
+	History[0] = v;
+}
+
+static int
+AmtPtpTrackConstantVelocity(
+	const int32_t *p
+)
+{
+	int32_t d0 = p[0] - p[1], d1 = p[1] - p[2], d2 = p[2] - p[3];
+
+	// Truth positions are rounded, so steps may differ by one unit
+	return abs(d0 - d1) <= 1 && abs(d1 - d2) <= 1;
+}
+
+void
+AmtPtpTrackInit(
+	PAMTPTP_TRACK_SCORE Score,
+	int32_t MatchDistance
+)
+{
+	memset(Score, 0, sizeof(*Score));
+	Score->MatchDistance = MatchDistance;
+}
+
+int
+AmtPtpTrackReport(
+	PAMTPTP_TRACK_SCORE Score,
+	const AMTPTP_SYNTH_FRAME *Truth,
+	const uint8_t *Report,
+	size_t ReportSize
+)
+{
+	AMTPTP_TRACK_REPORTED Reported[AMTPTP_MAX_CONTACTS] = { { 0 } };
+	int Match[AMTPTP_MAX_CONTACTS];
+	uint8_t Seen[AMTPTP_SYNTH_MAX_FINGERS] = { 0 };
+	const int64_t Limit = (int64_t) Score->MatchDistance * Score->MatchDistance;
+	uint32_t ReportCount, TruthCount, i, k, Id;
+	AMTPTP_FRAME Frame;
+	uint16_t ScanTime;
+	int64_t dx, dy, d, Best;
+	int t, r;
+
+	if (AmtPtpUnpackReport(Report, ReportSize, &Frame, &ScanTime) != AmtPtpDecodeOk) {
+		return 1;
+	}
+
+	Score->Frames++;
+
+	ReportCount = Frame.ContactCount < AMTPTP_MAX_CONTACTS ? Frame.ContactCount : AMTPTP_MAX_CONTACTS;
+	for (k = 0; k < ReportCount; k++) {
+		Reported[k].Confidence = Frame.Contacts[k].Confidence;
+		Reported[k].TipSwitch = Frame.Contacts[k].TipSwitch;
+		Reported[k].ContactID = Frame.Contacts[k].ContactID;
+		Reported[k].X = Frame.Contacts[k].X;
+		Reported[k].Y = Frame.Contacts[k].Y;
+	}
+
+	TruthCount = Truth->FingerCount < AMTPTP_MAX_CONTACTS ? Truth->FingerCount : AMTPTP_MAX_CONTACTS;
+
+	// Greedy nearest pairs first; five by five is too small to need more
+	for (i = 0; i < TruthCount; i++) Match[i] = -1;
+	for (;;) {
+		Best = Limit + 1;
+		t = r = -1;
+		for (i = 0; i < TruthCount; i++) {
+			if (Match[i] >= 0) continue;
+			for (k = 0; k < ReportCount; k++) {
+				if (Reported[k].Assigned || !Reported[k].TipSwitch) continue;
+				dx = (int64_t) Reported[k].X - Truth->Fingers[i].X;
+				dy = (int64_t) Reported[k].Y - Truth->Fingers[i].Y;
+				d = dx * dx + dy * dy;
+				if (d < Best) {
+					Best = d;
+					t = (int) i;
+					r = (int) k;
+				}
+			}
+		}
+		if (t < 0) break;
+		Match[t] = r;
+		Reported[r].Assigned = 1;
+	}
+
+	for (i = 0; i < TruthCount; i++) {
+		const AMTPTP_SYNTH_FINGER *g = &Truth->Fingers[i];
+		PAMTPTP_TRACK_FINGER f;
+		const AMTPTP_TRACK_REPORTED *p;
+
+		Id = g->Id % AMTPTP_SYNTH_MAX_FINGERS;
+		f = &Score->Fingers[Id];
+		Seen[Id] = 1;
+
+		AmtPtpTrackPush(f->TruthX, g->X);
+		AmtPtpTrackPush(f->TruthY, g->Y);
+
+		if (Match[i] < 0) {
+			Score->Missed++;
+			f->Present = 1;
+			f->Matched = 0;
+			f->Run = 0;
+			continue;
+		}
+
+		p = &Reported[Match[i]];
+		Score->Matched++;
+
+		if (f->Matched && f->ContactID != p->ContactID) {
+			Score->Switches++;
+			f->Run = 0;
+		}
+
+		AmtPtpTrackPush(f->X, p->X);
+		AmtPtpTrackPush(f->Y, p->Y);
+		f->Run++;
+
+		if (f->Present && f->TruthX[0] == f->TruthX[1] && f->TruthY[0] == f->TruthY[1]) {
+			dx = (int64_t) p->X - g->X;
+			dy = (int64_t) p->Y - g->Y;
+			Score->Stationary++;
+			Score->StationarySquares += (double) (dx * dx + dy * dy);
+		}
+		else if (f->Run >= AMTPTP_TRACK_HISTORY &&
+			AmtPtpTrackConstantVelocity(f->TruthX) && AmtPtpTrackConstantVelocity(f->TruthY)) {
+			dx = (int64_t) f->X[0] - 3 * (int64_t) f->X[1] + 3 * (int64_t) f->X[2] - f->X[3];
+			dy = (int64_t) f->Y[0] - 3 * (int64_t) f->Y[1] + 3 * (int64_t) f->Y[2] - f->Y[3];
+			Score->Jerks++;
+			Score->JerkSquares += (double) (dx * dx + dy * dy);
+		}
+
+		f->Present = 1;
+		f->Matched = 1;
+		f->Lifting = 0;
+		f->ContactID = p->ContactID;
+	}
+
+	for (Id = 0; Id < AMTPTP_SYNTH_MAX_FINGERS; Id++) {
+		PAMTPTP_TRACK_FINGER f = &Score->Fingers[Id];
+
+		if (f->Present && !Seen[Id]) {
+			f->Present = 0;
+			f->Run = 0;
+			f->Lifting = f->Matched;
+			f->LiftFrames = 0;
+			f->Matched = 0;
+		}
+
+		if (!f->Lifting) {
+			continue;
+		}
+
+		for (k = 0; k < ReportCount; k++) {
+			if (!Reported[k].Assigned && Reported[k].TipSwitch && Reported[k].ContactID == f->ContactID) {
+				break;
+			}
+		}
+
+		if (k < ReportCount) {
+			Reported[k].Assigned = 1;
+			f->LiftFrames++;
+		}
+		else {
+			Score->Liftoffs++;
+			Score->LiftoffFrames += f->LiftFrames;
+			if (f->LiftFrames > Score->LiftoffMax) Score->LiftoffMax = f->LiftFrames;
+			f->Lifting = 0;
+		}
+	}
+
+	// Palms are reported without Confidence and are not fingers
+	for (k = 0; k < ReportCount; k++) {
+		if (!Reported[k].Assigned && Reported[k].TipSwitch && Reported[k].Confidence) {
+			Score->Phantoms++;
+		}
+	}
+
+	return 0;
+}
+
+int
+AmtPtpTrackRun(
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_GESTURE_SCRIPT *Script,
+	int32_t Noise,
+	PFN_AMTPTP_TRACK_FILTER Filter,
+	void *Context,
+	PAMTPTP_TRACK_SCORE Score
+)
+{
+	uint8_t Raw[AMTPTP_TRACK_FRAME_MAX];
+	uint8_t Report[AMTPTP_REPORT_SIZE];
+	AMTPTP_GESTURE_SCRIPT s = *Script;
+	AMTPTP_SYNTH_FRAME Truth, Noisy;
+	AMTPTP_DECODER Decoder;
+	AMTPTP_FRAME Frame;
+	AMTPTP_CONTACT_ID_MAP ContactIds;
+	uint32_t Seed = 2463534242u;
+	uint64_t Last = 0, Now;
+	size_t Length;
+	uint32_t n, i;
+
+	if (s.Fingers > AMTPTP_SYNTH_MAX_FINGERS ||
+		(Family->Decoder.Format == AmtPtpFrameFormatSpi && s.Fingers > AMTPTP_SYNTH_SPI_MAX_FINGERS) ||
+		Family->ReportSize > sizeof(Report)) {
+		return 1;
+	}
+
+	AmtPtpBenchInitDecoder(Family, &Decoder);
+	AmtPtpInitContactIdMap(&ContactIds);
+	s.Width = Family->XMax - Family->Decoder.XMin;
+	s.Height = Family->Decoder.YMax - Family->Decoder.YMin;
+
+	for (n = 0; n < s.Frames; n++) {
+		AmtPtpSynthGestureFrame(&s, n, &Truth);
+		Noisy = Truth;
+
+		// xorshift32, so every run sees the same noise
+		for (i = 0; Noise > 0 && i < Noisy.FingerCount; i++) {
+			Seed ^= Seed << 13; Seed ^= Seed >> 17; Seed ^= Seed << 5;
+			Noisy.Fingers[i].X += (int32_t) (Seed % (2 * (uint32_t) Noise + 1)) - Noise;
+			Seed ^= Seed << 13; Seed ^= Seed >> 17; Seed ^= Seed << 5;
+			Noisy.Fingers[i].Y += (int32_t) (Seed % (2 * (uint32_t) Noise + 1)) - Noise;
+		}
+
+		Length = AmtPtpSynthEncodeFrame(&Decoder, &Noisy, Raw, sizeof(Raw));
+		if (Length == 0) {
+			return 1;
+		}
+
+		Family->DecodeFrame(&Decoder, Raw, Length, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Frame);
+		if (Filter != NULL) {
+			Filter(Context, &Frame);
+		}
+		if (Family->MapContactIds) {
+			AmtPtpMapContactIds(&ContactIds, &Frame);
+		}
+
+		Now = AmtPtpSynthTimestamp(n, AMTPTP_TRACK_REPORT_RATE, AMTPTP_TRACK_FREQUENCY);
+		Family->PackReport(&Frame, AmtPtpScanTime((int64_t) Last, (int64_t) Now), Report);
+		Last = Now;
+
+		if (AmtPtpTrackReport(Score, &Truth, Report, Family->ReportSize) != 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+double
+AmtPtpTrackJitter(
+	const AMTPTP_TRACK_SCORE *Score
+)
+{
+	return Score->Stationary ? sqrt(Score->StationarySquares / (double) Score->Stationary) : 0.0;
+}
+
+double
+AmtPtpTrackJerk(
+	const AMTPTP_TRACK_SCORE *Score
+)
+{
+	return Score->Jerks ? sqrt(Score->JerkSquares / (double) Score->Jerks) : 0.0;
+}
+
+size_t
+AmtPtpTrackFormat(
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_GESTURE_SCRIPT *Script,
+	const AMTPTP_TRACK_SCORE *Score,
+	char *Out,
+	size_t OutSize
+)
+{
+	const char *Gesture = (size_t) Script->Gesture < sizeof(AmtPtpTrackGestureNames) / sizeof(AmtPtpTrackGestureNames[0]) ?
+		AmtPtpTrackGestureNames[Script->Gesture] : "unknown";
+	size_t Length;
+	int w;
+
+	if (OutSize == 0) {
+		return 0;
+	}
+
+	w = snprintf(Out, OutSize,
+		"{\"family\":\"%s\",\"gesture\":\"%s\",\"fingers\":%u,\"frames\":%llu,"
+		"\"jitter_rms\":%.3f,\"jerk_rms\":%.3f,\"id_switches\":%llu,\"phantoms\":%llu,\"missed\":%llu,"
+		"\"liftoffs\":%llu,\"liftoff_frames_mean\":%.3f,\"liftoff_frames_max\":%u}",
+		Family->Name, Gesture, (unsigned) Script->Fingers, (unsigned long long) Score->Frames,
+		AmtPtpTrackJitter(Score), AmtPtpTrackJerk(Score), (unsigned long long) Score->Switches,
+		(unsigned long long) Score->Phantoms, (unsigned long long) Score->Missed,
+		(unsigned long long) Score->Liftoffs,
+		Score->Liftoffs ? (double) Score->LiftoffFrames / (double) Score->Liftoffs : 0.0,
+		(unsigned) Score->LiftoffMax);
+	Length = w < 0 ? 0 : (size_t) w;
+
+	return Length < OutSize ? Length : OutSize - 1;
+}
@@ -0,0 +1,125 @@
+// AmtPtpTrack.h: Tracking quality of emitted PTP_REPORT streams
+//
+// Scores a report stream against the synthetic contacts it was generated
+// from. Report n must belong to ground truth frame n. Ground truth contacts
+// are matched to reported contacts by distance, then:
+//
+//   Jitter     RMS distance from the truth while the truth is stationary
+//   Jerk       RMS third difference of the reported path while the truth
+//              moves at constant velocity
+//   Switches   ContactID changes while the same finger stays down
+//   Phantoms   Reported fingers with no ground truth contact nearby
+//   Lift-off   Frames a contact is still reported after its finger lifted
+//
+// Only the first AMTPTP_MAX_CONTACTS truth contacts are scored, because the
+// decoder never reports more.
+
+#pragma once
+
+#include "AmtPtpBench.h"
+#include "AmtPtpSynth.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Path points kept per truth contact for the jerk estimate
+#define AMTPTP_TRACK_HISTORY	4
+
+typedef struct _AMTPTP_TRACK_FINGER {
+	uint8_t Present;
+	uint8_t Matched;
+	uint32_t ContactID;				// Reported ID while matched
+	uint32_t Run;					// Consecutive frames matched at constant velocity
+	int32_t TruthX[AMTPTP_TRACK_HISTORY];
+	int32_t TruthY[AMTPTP_TRACK_HISTORY];
+	int32_t X[AMTPTP_TRACK_HISTORY];
+	int32_t Y[AMTPTP_TRACK_HISTORY];
+	uint8_t Lifting;				// Finger lifted, ContactID may still be reported
+	uint32_t LiftFrames;
+} AMTPTP_TRACK_FINGER, *PAMTPTP_TRACK_FINGER;
+
+typedef struct _AMTPTP_TRACK_SCORE {
+	int32_t MatchDistance;			// Largest truth to report distance that still matches
+	uint64_t Frames;
+	uint64_t Matched;
+	uint64_t Missed;				// Truth contacts without a reported contact
+	uint64_t Phantoms;
+	uint64_t Switches;
+	uint64_t Stationary;
+	double StationarySquares;
+	uint64_t Jerks;
+	double JerkSquares;
+	uint64_t Liftoffs;
+	uint64_t LiftoffFrames;
+	uint32_t LiftoffMax;
+
+	// Indexed by AMTPTP_SYNTH_FINGER.Id
+	AMTPTP_TRACK_FINGER Fingers[AMTPTP_SYNTH_MAX_FINGERS];
+} AMTPTP_TRACK_SCORE, *PAMTPTP_TRACK_SCORE;
+
+// Runs on the decoded frame before it is packed, where a driver would apply
+// smoothing or contact tracking.
+typedef void
+(*PFN_AMTPTP_TRACK_FILTER)(
+	void *Context,
+	PAMTPTP_FRAME Frame
+);
+
+void
+AmtPtpTrackInit(
+	PAMTPTP_TRACK_SCORE Score,
+	int32_t MatchDistance
+);
+
+// Scores one report of ReportSize bytes, in the layout AmtPtpUnpackReport
+// reads, against its ground truth. Returns non-zero, and scores nothing, if
+// Report is no multitouch report of that layout.
+int
+AmtPtpTrackReport(
+	PAMTPTP_TRACK_SCORE Score,
+	const AMTPTP_SYNTH_FRAME *Truth,
+	const uint8_t *Report,
+	size_t ReportSize
+);
+
+// Synthesizes Script on Family, adds uniform position noise of up to Noise
+// units and runs every frame through the family's frame path: its decoder
+// function, Filter, contact renumbering where the build does it and its
+// packer. The reports are scored in the family's layout, so each driver build
+// is scored on the stream it emits. Script Width and Height are taken from
+// the family. Filter may be NULL. Returns 0 on success, non-zero if the
+// family cannot encode the script.
+int
+AmtPtpTrackRun(
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_GESTURE_SCRIPT *Script,
+	int32_t Noise,
+	PFN_AMTPTP_TRACK_FILTER Filter,
+	void *Context,
+	PAMTPTP_TRACK_SCORE Score
+);
+
+double
+AmtPtpTrackJitter(
+	const AMTPTP_TRACK_SCORE *Score
+);
+
+double
+AmtPtpTrackJerk(
+	const AMTPTP_TRACK_SCORE *Score
+);
+
+// Formats one score as a single-line JSON object, like AmtPtpBenchFormat.
+size_t
+AmtPtpTrackFormat(
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_GESTURE_SCRIPT *Script,
+	const AMTPTP_TRACK_SCORE *Score,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,280 @@
+// AmtPtpTune.c: Contact qualification threshold sweeps over labelled captures
+
+#include "AmtPtpTune.h"
+
+#include <stdlib.h>
+
+AMTPTP_CAPTURE_STATUS
+AmtPtpTuneExtract(
+	PAMTPTP_CAPTURE_READER Reader,
+	const uint8_t *Labels,
+	size_t LabelCount,
+	PAMTPTP_TUNE_SAMPLE Samples,
+	size_t Capacity,
+	size_t *Count
+)
+{
+	AMTPTP_CONTACT_SIZE Sizes[AMTPTP_MAX_CONTACTS];
+	AMTPTP_CAPTURE_STATUS Status;
+	const uint8_t *Frame;
+	uint64_t Timestamp;
+	uint32_t Length;
+	size_t Record = 0;
+	uint8_t n, i;
+
+	for (;;) {
+		Status = AmtPtpCaptureNext(Reader, &Timestamp, &Frame, &Length);
+		if (Status != AmtPtpCaptureOk) {
+			return Status == AmtPtpCaptureEnd ? AmtPtpCaptureOk : Status;
+		}
+
+		if (Record >= LabelCount) {
+			return AmtPtpCaptureOk;
+		}
+
+		if (AmtPtpDecodeContactSizes(&Reader->Device.Decoder, Frame, Length, Sizes, &n) == AmtPtpDecodeOk) {
+			if (Capacity - *Count < n) {
+				return AmtPtpCaptureBufferTooSmall;
+			}
+
+			for (i = 0; i < n; i++) {
+				PAMTPTP_TUNE_SAMPLE s = &Samples[(*Count)++];
+
+				s->Size = Sizes[i];
+				s->Touch = (Labels[Record] >> i) & 1;
+				s->Weight = 1;
+			}
+		}
+
+		Record++;
+	}
+}
+
+static int
+AmtPtpTuneCompare(
+	const void *pa,
+	const void *pb
+)
+{
+	const AMTPTP_TUNE_SAMPLE *a = (const AMTPTP_TUNE_SAMPLE *) pa;
+	const AMTPTP_TUNE_SAMPLE *b = (const AMTPTP_TUNE_SAMPLE *) pb;
+
+	if (a->Size.Major != b->Size.Major) return a->Size.Major < b->Size.Major ? -1 : 1;
+	if (a->Size.Minor != b->Size.Minor) return a->Size.Minor < b->Size.Minor ? -1 : 1;
+	if (a->Size.Pressure != b->Size.Pressure) return a->Size.Pressure < b->Size.Pressure ? -1 : 1;
+	return (int) a->Touch - (int) b->Touch;
+}
+
+size_t
+AmtPtpTuneCompact(
+	PAMTPTP_TUNE_SAMPLE Samples,
+	size_t Count
+)
+{
+	size_t i, n = 0;
+
+	if (Count == 0) {
+		return 0;
+	}
+
+	qsort(Samples, Count, sizeof(*Samples), AmtPtpTuneCompare);
+
+	// Weights saturate rather than wrap; a sample that common dominates anyway
+	for (i = 1; i < Count; i++) {
+		if (AmtPtpTuneCompare(&Samples[n], &Samples[i]) == 0 &&
+			Samples[n].Weight <= UINT32_MAX - Samples[i].Weight) {
+			Samples[n].Weight += Samples[i].Weight;
+		}
+		else {
+			Samples[++n] = Samples[i];
+		}
+	}
+
+	return n + 1;
+}
+
+static uint64_t
+AmtPtpTuneRangeSize(
+	const AMTPTP_TUNE_RANGE *r
+)
+{
+	if (r->Max < r->Min) return 0;
+	if (r->Step <= 0) return 1;
+	return ((uint64_t) ((int64_t) r->Max - r->Min)) / (uint64_t) r->Step + 1;
+}
+
+static int32_t
+AmtPtpTuneRangeValue(
+	const AMTPTP_TUNE_RANGE *r,
+	uint64_t *Index
+)
+{
+	uint64_t n = AmtPtpTuneRangeSize(r);
+	uint64_t i = *Index % n;
+
+	*Index /= n;
+	return (int32_t) (r->Min + (int64_t) i * (r->Step > 0 ? r->Step : 0));
+}
+
+uint64_t
+AmtPtpTuneGridSize(
+	const AMTPTP_TUNE_GRID *Grid
+)
+{
+	const AMTPTP_TUNE_RANGE *Ranges[] = {
+		&Grid->TipSwitchMajor, &Grid->TipSwitchMinor, &Grid->TipSwitchPressure,
+		&Grid->ConfidenceMinorMin, &Grid->ConfidenceMinorMax, &Grid->ConfidenceMajorMax
+	};
+	uint64_t Size = 1, n;
+	size_t i;
+
+	for (i = 0; i < sizeof(Ranges) / sizeof(Ranges[0]); i++) {
+		n = AmtPtpTuneRangeSize(Ranges[i]);
+		if (n == 0 || Size > UINT64_MAX / n) {
+			return 0;
+		}
+		Size *= n;
+	}
+
+	return Size;
+}
+
+void
+AmtPtpTuneGridPoint(
+	const AMTPTP_TUNE_GRID *Grid,
+	uint64_t Index,
+	PAMTPTP_THRESHOLDS Thresholds
+)
+{
+	// TipSwitchMajor varies fastest
+	Thresholds->TipSwitchMajor = AmtPtpTuneRangeValue(&Grid->TipSwitchMajor, &Index);
+	Thresholds->TipSwitchMinor = AmtPtpTuneRangeValue(&Grid->TipSwitchMinor, &Index);
+	Thresholds->TipSwitchPressure = AmtPtpTuneRangeValue(&Grid->TipSwitchPressure, &Index);
+	Thresholds->ConfidenceMinorMin = AmtPtpTuneRangeValue(&Grid->ConfidenceMinorMin, &Index);
+	Thresholds->ConfidenceMinorMax = AmtPtpTuneRangeValue(&Grid->ConfidenceMinorMax, &Index);
+	Thresholds->ConfidenceMajorMax = AmtPtpTuneRangeValue(&Grid->ConfidenceMajorMax, &Index);
+}
+
+void
+AmtPtpTuneEvaluate(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_THRESHOLDS *Thresholds,
+	PAMTPTP_TUNE_SCORE Score
+)
+{
+	uint8_t TipSwitch, Confidence;
+	size_t i;
+
+	Score->Index = 0;
+	Score->Thresholds = *Thresholds;
+	Score->Touches = 0;
+	Score->Others = 0;
+	Score->FalseTouches = 0;
+	Score->MissedTouches = 0;
+
+	for (i = 0; i < Count; i++) {
+		const AMTPTP_TUNE_SAMPLE *s = &Samples[i];
+
+		AmtPtpQualifyContact(Thresholds, &s->Size, &TipSwitch, &Confidence);
+
+		if (s->Touch) {
+			Score->Touches += s->Weight;
+			if (!(TipSwitch && Confidence)) Score->MissedTouches += s->Weight;
+		}
+		else {
+			Score->Others += s->Weight;
+			if (TipSwitch && Confidence) Score->FalseTouches += s->Weight;
+		}
+	}
+}
+
+int
+AmtPtpTuneBetter(
+	const AMTPTP_TUNE_SCORE *a,
+	const AMTPTP_TUNE_SCORE *b
+)
+{
+	uint64_t ea = a->FalseTouches + a->MissedTouches;
+	uint64_t eb = b->FalseTouches + b->MissedTouches;
+
+	if (ea != eb) return ea < eb;
+	if (a->MissedTouches != b->MissedTouches) return a->MissedTouches < b->MissedTouches;
+	return a->Index < b->Index;
+}
+
+void
+AmtPtpTuneRank(
+	PAMTPTP_TUNE_SCORE Ranked,
+	size_t Capacity,
+	size_t *RankedCount,
+	const AMTPTP_TUNE_SCORE *Score
+)
+{
+	size_t i = *RankedCount;
+
+	if (i == Capacity) {
+		if (Capacity == 0 || !AmtPtpTuneBetter(Score, &Ranked[Capacity - 1])) {
+			return;
+		}
+		i--;
+	}
+	else {
+		(*RankedCount)++;
+	}
+
+	// Lists are short, so shifting beats anything cleverer
+	for (; i > 0 && AmtPtpTuneBetter(Score, &Ranked[i - 1]); i--) {
+		Ranked[i] = Ranked[i - 1];
+	}
+	Ranked[i] = *Score;
+}
+
+void
+AmtPtpTuneSweep(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid,
+	uint64_t First,
+	uint64_t Last,
+	PAMTPTP_TUNE_SCORE Best
+)
+{
+	AMTPTP_THRESHOLDS Thresholds;
+	AMTPTP_TUNE_SCORE Score;
+	uint64_t Index;
+
+	for (Index = First; Index < Last; Index++) {
+		AmtPtpTuneGridPoint(Grid, Index, &Thresholds);
+		AmtPtpTuneEvaluate(Samples, Count, &Thresholds, &Score);
+		Score.Index = Index;
+
+		if (AmtPtpTuneBetter(&Score, Best)) {
+			*Best = Score;
+		}
+	}
+}
+
+void
+AmtPtpTuneSweepRanked(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid,
+	uint64_t First,
+	uint64_t Last,
+	PAMTPTP_TUNE_SCORE Ranked,
+	size_t Capacity,
+	size_t *RankedCount
+)
+{
+	AMTPTP_THRESHOLDS Thresholds;
+	AMTPTP_TUNE_SCORE Score;
+	uint64_t Index;
+
+	for (Index = First; Index < Last; Index++) {
+		AmtPtpTuneGridPoint(Grid, Index, &Thresholds);
+		AmtPtpTuneEvaluate(Samples, Count, &Thresholds, &Score);
+		Score.Index = Index;
+		AmtPtpTuneRank(Ranked, Capacity, RankedCount, &Score);
+	}
+}
@@ -0,0 +1,146 @@
+// AmtPtpTune.h: Contact qualification threshold sweeps over labelled captures
+//
+// Contact sizes are extracted from a capture once, then any number of
+// AMTPTP_THRESHOLDS candidates are scored against them with the exact
+// qualification used by AmtPtpDecodeFrame. Samples are read-only while
+// scoring, so candidates can be spread across threads: each worker claims
+// grid indices from a shared counter, keeps its own best scores, and the
+// results are combined with AmtPtpTuneRank. host/AmtPtpTuneParallel.h does
+// this with POSIX threads.
+
+#pragma once
+
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _AMTPTP_TUNE_SAMPLE {
+	AMTPTP_CONTACT_SIZE Size;
+	uint8_t  Touch;					// Labelled as an intended finger
+	uint32_t Weight;				// Identical samples folded into this one
+} AMTPTP_TUNE_SAMPLE, *PAMTPTP_TUNE_SAMPLE;
+
+// Inclusive range of one threshold. Step 0 pins the threshold to Min.
+typedef struct _AMTPTP_TUNE_RANGE {
+	int32_t Min;
+	int32_t Max;
+	int32_t Step;
+} AMTPTP_TUNE_RANGE, *PAMTPTP_TUNE_RANGE;
+
+// One range per AMTPTP_THRESHOLDS field, in the same order
+typedef struct _AMTPTP_TUNE_GRID {
+	AMTPTP_TUNE_RANGE TipSwitchMajor;
+	AMTPTP_TUNE_RANGE TipSwitchMinor;
+	AMTPTP_TUNE_RANGE TipSwitchPressure;
+	AMTPTP_TUNE_RANGE ConfidenceMinorMin;
+	AMTPTP_TUNE_RANGE ConfidenceMinorMax;
+	AMTPTP_TUNE_RANGE ConfidenceMajorMax;
+} AMTPTP_TUNE_GRID, *PAMTPTP_TUNE_GRID;
+
+// A contact is delivered as a finger when it has both TipSwitch and Confidence
+typedef struct _AMTPTP_TUNE_SCORE {
+	uint64_t Index;					// Grid index of Thresholds
+	AMTPTP_THRESHOLDS Thresholds;
+	uint64_t Touches;				// Labelled fingers
+	uint64_t Others;				// Everything else (palms, noise)
+	uint64_t FalseTouches;			// Others delivered as fingers
+	uint64_t MissedTouches;			// Labelled fingers not delivered
+} AMTPTP_TUNE_SCORE, *PAMTPTP_TUNE_SCORE;
+
+// Appends the contacts of every remaining record of Reader to Samples.
+// Labels holds one byte per record; bit n marks contact n as an intended finger.
+// Malformed frames are skipped but still consume their label.
+AMTPTP_CAPTURE_STATUS
+AmtPtpTuneExtract(
+	PAMTPTP_CAPTURE_READER Reader,
+	const uint8_t *Labels,
+	size_t LabelCount,
+	PAMTPTP_TUNE_SAMPLE Samples,
+	size_t Capacity,
+	size_t *Count
+);
+
+// Sorts Samples and folds identical ones into a single weighted sample.
+// Returns the new count. Sizes are small integers, so hours of input
+// usually collapse to a few thousand samples.
+size_t
+AmtPtpTuneCompact(
+	PAMTPTP_TUNE_SAMPLE Samples,
+	size_t Count
+);
+
+// Number of grid points; 0 if any range is empty or the grid overflows
+uint64_t
+AmtPtpTuneGridSize(
+	const AMTPTP_TUNE_GRID *Grid
+);
+
+// Maps a grid index to its thresholds. For a random search, draw Index
+// uniformly below AmtPtpTuneGridSize.
+void
+AmtPtpTuneGridPoint(
+	const AMTPTP_TUNE_GRID *Grid,
+	uint64_t Index,
+	PAMTPTP_THRESHOLDS Thresholds
+);
+
+// Scores one candidate; Index is left 0. Safe to call concurrently on shared samples.
+void
+AmtPtpTuneEvaluate(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_THRESHOLDS *Thresholds,
+	PAMTPTP_TUNE_SCORE Score
+);
+
+// Ranks two scores by total errors, then by missed touches, then by grid index.
+// Returns nonzero when a ranks before b.
+int
+AmtPtpTuneBetter(
+	const AMTPTP_TUNE_SCORE *a,
+	const AMTPTP_TUNE_SCORE *b
+);
+
+// Inserts Score into Ranked, which holds *RankedCount scores ordered by
+// AmtPtpTuneBetter, and keeps the Capacity best. The ranking is a total
+// order, so ranking the lists of several workers into one gives exactly the
+// list of a single sweep over the same indices.
+void
+AmtPtpTuneRank(
+	PAMTPTP_TUNE_SCORE Ranked,
+	size_t Capacity,
+	size_t *RankedCount,
+	const AMTPTP_TUNE_SCORE *Score
+);
+
+// Scores grid indices [First, Last) and keeps the best in *Best.
+// Best must be initialized by the caller, e.g. by evaluating index First.
+void
+AmtPtpTuneSweep(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid,
+	uint64_t First,
+	uint64_t Last,
+	PAMTPTP_TUNE_SCORE Best
+);
+
+// Scores grid indices [First, Last) and ranks each into Ranked with
+// AmtPtpTuneRank. Ranked may already hold scores of other indices.
+void
+AmtPtpTuneSweepRanked(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid,
+	uint64_t First,
+	uint64_t Last,
+	PAMTPTP_TUNE_SCORE Ranked,
+	size_t Capacity,
+	size_t *RankedCount
+);
+
+#ifdef __cplusplus
+}
+#endif
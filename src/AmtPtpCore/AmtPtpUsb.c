@@ -0,0 +1,90 @@
+// AmtPtpUsb.c: Wellspring mode switch protocol over an abstract USB transport
+
+#include "AmtPtpUsb.h"
+
+#include <string.h>
+
+static AMTPTP_USB_STATUS
+AmtPtpUsbReadModeReport(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch,
+	uint8_t *Buffer
+)
+{
+	uint32_t Transferred = 0;
+
+	if (Switch->Size == 0 || Switch->Size > AMTPTP_USB_MODE_REPORT_MAX || Switch->SwitchIndex >= Switch->Size) {
+		return AmtPtpUsbStall;
+	}
+
+	memset(Buffer, 0, Switch->Size);
+	return Transport->ControlIn(
+		Transport->Context,
+		AMTPTP_USB_MODE_READ_REQUEST,
+		Switch->RequestValue,
+		Switch->RequestIndex,
+		Buffer,
+		Switch->Size,
+		&Transferred
+	);
+}
+
+AMTPTP_USB_STATUS
+AmtPtpUsbGetWellspringMode(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch,
+	int *IsWellspringModeOn
+)
+{
+	uint8_t Buffer[AMTPTP_USB_MODE_REPORT_MAX];
+	AMTPTP_USB_STATUS Status;
+
+	*IsWellspringModeOn = 0;
+
+	Status = AmtPtpUsbReadModeReport(Transport, Switch, Buffer);
+	if (Status != AmtPtpUsbOk) {
+		return Status;
+	}
+
+	*IsWellspringModeOn = Buffer[Switch->SwitchIndex] == Switch->SwitchOn;
+	return AmtPtpUsbOk;
+}
+
+AMTPTP_USB_STATUS
+AmtPtpUsbSetWellspringMode(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch,
+	int IsWellspringModeOn
+)
+{
+	uint8_t Buffer[AMTPTP_USB_MODE_REPORT_MAX];
+	AMTPTP_USB_STATUS Status;
+
+	// Read, patch the switch byte and write the whole report back
+	Status = AmtPtpUsbReadModeReport(Transport, Switch, Buffer);
+	if (Status != AmtPtpUsbOk) {
+		return Status;
+	}
+
+	Buffer[Switch->SwitchIndex] = IsWellspringModeOn ? Switch->SwitchOn : Switch->SwitchOff;
+
+	return Transport->ControlOut(
+		Transport->Context,
+		AMTPTP_USB_MODE_WRITE_REQUEST,
+		Switch->RequestValue,
+		Switch->RequestIndex,
+		Buffer,
+		Switch->Size
+	);
+}
+
+AMTPTP_USB_STATUS
+AmtPtpUsbResetDevice(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch
+)
+{
+	// Like the drivers, try to turn the mode back on even if turning it off failed
+	AmtPtpUsbSetWellspringMode(Transport, Switch, 0);
+	return AmtPtpUsbSetWellspringMode(Transport, Switch, 1);
+}
@@ -0,0 +1,100 @@
+// AmtPtpUsb.h: Wellspring mode switch protocol over an abstract USB transport
+//
+// The drivers talk to the device through WDF USB targets. Host-side tooling
+// goes through AMTPTP_USB_TRANSPORT instead, so the same read/modify/write
+// protocol can run against a simulated device (see AmtPtpSim.h) or a capture.
+
+#pragma once
+
+#include "AmtPtpCore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Class requests used by the mode switch (BCM5974_WELLSPRING_MODE_*_REQUEST_ID)
+#define AMTPTP_USB_MODE_READ_REQUEST	1
+#define AMTPTP_USB_MODE_WRITE_REQUEST	9
+
+// Largest mode feature report of any known device
+#define AMTPTP_USB_MODE_REPORT_MAX		64
+
+typedef enum _AMTPTP_USB_STATUS {
+	AmtPtpUsbOk,
+	AmtPtpUsbStall,					// Endpoint stalled the transfer
+	AmtPtpUsbNoData					// Interrupt pipe has nothing to deliver
+} AMTPTP_USB_STATUS;
+
+// Mode switch parameters, the USBMSG_TYPEx tuple of BCM5974_CONFIG
+typedef struct _AMTPTP_MODE_SWITCH {
+	uint32_t Size;					// um_size
+	uint16_t RequestValue;			// um_req_val
+	uint16_t RequestIndex;			// um_req_idx
+	uint32_t SwitchIndex;			// um_switch_idx
+	uint8_t  SwitchOn;				// um_switch_on
+	uint8_t  SwitchOff;				// um_switch_off
+} AMTPTP_MODE_SWITCH, *PAMTPTP_MODE_SWITCH;
+
+// Class requests to the interface, device-to-host and host-to-device
+typedef AMTPTP_USB_STATUS
+(*PFN_AMTPTP_USB_CONTROL_IN)(
+	void *Context,
+	uint8_t Request,
+	uint16_t Value,
+	uint16_t Index,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+);
+
+typedef AMTPTP_USB_STATUS
+(*PFN_AMTPTP_USB_CONTROL_OUT)(
+	void *Context,
+	uint8_t Request,
+	uint16_t Value,
+	uint16_t Index,
+	const uint8_t *Buffer,
+	uint32_t Length
+);
+
+// Reads one transfer from the interrupt IN pipe
+typedef AMTPTP_USB_STATUS
+(*PFN_AMTPTP_USB_READ_INTERRUPT)(
+	void *Context,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+);
+
+typedef struct _AMTPTP_USB_TRANSPORT {
+	void *Context;
+	PFN_AMTPTP_USB_CONTROL_IN ControlIn;
+	PFN_AMTPTP_USB_CONTROL_OUT ControlOut;
+	PFN_AMTPTP_USB_READ_INTERRUPT ReadInterrupt;
+} AMTPTP_USB_TRANSPORT, *PAMTPTP_USB_TRANSPORT;
+
+// Same semantics as AmtPtpGetWellspringMode / AmtPtpSetWellspringMode /
+// AmtPtpEmergResetDevice. Like the drivers, short control reads are accepted.
+AMTPTP_USB_STATUS
+AmtPtpUsbGetWellspringMode(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch,
+	int *IsWellspringModeOn
+);
+
+AMTPTP_USB_STATUS
+AmtPtpUsbSetWellspringMode(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch,
+	int IsWellspringModeOn
+);
+
+AMTPTP_USB_STATUS
+AmtPtpUsbResetDevice(
+	const AMTPTP_USB_TRANSPORT *Transport,
+	const AMTPTP_MODE_SWITCH *Switch
+);
+
+#ifdef __cplusplus
+}
+#endif
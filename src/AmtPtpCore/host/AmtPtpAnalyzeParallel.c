@@ -0,0 +1,124 @@
+// AmtPtpAnalyzeParallel.c: Capture corpus analysis on every core
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "AmtPtpAnalyzeParallel.h"
+
+typedef struct _AMTPTP_ANALYZE_SHARED {
+	PAMTPTP_ANALYZE_INPUT Inputs;
+	size_t Count;
+	size_t ReportSize;
+	size_t Next;					// First input not yet claimed, atomic
+} AMTPTP_ANALYZE_SHARED, *PAMTPTP_ANALYZE_SHARED;
+
+typedef struct _AMTPTP_ANALYZE_WORKER {
+	PAMTPTP_ANALYZE_SHARED Shared;
+	pthread_t Thread;
+	int Started;
+	AMTPTP_ANALYSIS Total;
+	AMTPTP_ANALYSIS Capture;		// Lifetime state is per capture
+} AMTPTP_ANALYZE_WORKER, *PAMTPTP_ANALYZE_WORKER;
+
+static void *
+AmtPtpAnalyzeWorker(
+	void *Context
+)
+{
+	PAMTPTP_ANALYZE_WORKER Worker = (PAMTPTP_ANALYZE_WORKER) Context;
+	PAMTPTP_ANALYZE_SHARED Shared = Worker->Shared;
+	PAMTPTP_ANALYZE_INPUT Input;
+	AMTPTP_CAPTURE_READER Reader;
+	size_t i;
+
+	for (;;) {
+		i = __atomic_fetch_add(&Shared->Next, 1, __ATOMIC_RELAXED);
+		if (i >= Shared->Count) {
+			break;
+		}
+
+		Input = &Shared->Inputs[i];
+		Input->Status = AmtPtpCaptureOpen(&Reader, Input->Capture, Input->CaptureSize);
+		if (Input->Status != AmtPtpCaptureOk) {
+			continue;
+		}
+
+		AmtPtpAnalyzeInit(&Worker->Capture);
+		Input->Status = AmtPtpAnalyzeCapture(&Worker->Capture, &Reader);
+		if (Input->Reports != NULL) {
+			AmtPtpAnalyzeReports(&Worker->Capture, Input->Reports, Input->ReportsSize, Shared->ReportSize);
+		}
+		AmtPtpAnalyzeMerge(&Worker->Total, &Worker->Capture);
+	}
+
+	return NULL;
+}
+
+size_t
+AmtPtpAnalyzeParallel(
+	PAMTPTP_ANALYZE_INPUT Inputs,
+	size_t Count,
+	size_t ReportSize,
+	uint32_t Threads,
+	PAMTPTP_ANALYSIS Total
+)
+{
+	AMTPTP_ANALYZE_WORKER Single;
+	PAMTPTP_ANALYZE_WORKER Workers;
+	AMTPTP_ANALYZE_SHARED Shared;
+	size_t Failed = 0, i;
+	uint32_t w;
+
+	Shared.Inputs = Inputs;
+	Shared.Count = Count;
+	Shared.ReportSize = ReportSize;
+	Shared.Next = 0;
+
+	AmtPtpAnalyzeInit(Total);
+	if (Threads == 0) {
+		Threads = 1;
+	}
+	if (Threads > AMTPTP_ANALYZE_MAX_THREADS) {
+		Threads = AMTPTP_ANALYZE_MAX_THREADS;
+	}
+	if (Threads > Count) {
+		Threads = Count > 0 ? (uint32_t) Count : 1;
+	}
+
+	// Without memory for the workers, the calling thread analyzes alone
+	Workers = calloc(Threads, sizeof(*Workers));
+	if (Workers == NULL) {
+		Workers = &Single;
+		Threads = 1;
+	}
+
+	for (w = 0; w < Threads; w++) {
+		Workers[w].Shared = &Shared;
+		Workers[w].Started = 0;
+		AmtPtpAnalyzeInit(&Workers[w].Total);
+	}
+
+	// Worker 0 is the calling thread
+	for (w = 1; w < Threads; w++) {
+		Workers[w].Started = pthread_create(&Workers[w].Thread, NULL, AmtPtpAnalyzeWorker, &Workers[w]) == 0;
+	}
+	AmtPtpAnalyzeWorker(&Workers[0]);
+
+	for (w = 0; w < Threads; w++) {
+		if (w != 0 && Workers[w].Started) {
+			pthread_join(Workers[w].Thread, NULL);
+		}
+		AmtPtpAnalyzeMerge(Total, &Workers[w].Total);
+	}
+
+	if (Workers != &Single) {
+		free(Workers);
+	}
+
+	for (i = 0; i < Count; i++) {
+		if (Inputs[i].Status != AmtPtpCaptureEnd) {
+			Failed++;
+		}
+	}
+	return Failed;
+}
@@ -0,0 +1,46 @@
+// AmtPtpAnalyzeParallel.h: Capture corpus analysis on every core
+//
+// Spreads AmtPtpAnalyzeCapture over POSIX threads. Workers claim one capture
+// at a time from a shared atomic index, analyze it on its own, together with
+// the report stream the driver emitted for it, and add it to their own total.
+// The totals are combined with AmtPtpAnalyzeMerge, whose counters are sums,
+// minima and maxima, so the result is identical to a serial pass whatever
+// the thread count or scheduling.
+
+#pragma once
+
+#include "AmtPtpAnalyze.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_ANALYZE_MAX_THREADS	64
+
+typedef struct _AMTPTP_ANALYZE_INPUT {
+	const uint8_t *Capture;
+	size_t CaptureSize;
+	const uint8_t *Reports;				// NULL without an emitted report stream
+	size_t ReportsSize;
+	AMTPTP_CAPTURE_STATUS Status;		// Out: AmtPtpCaptureEnd once read to its end
+} AMTPTP_ANALYZE_INPUT, *PAMTPTP_ANALYZE_INPUT;
+
+// Analyzes every input on Threads workers, the calling thread being one of
+// them, into Total, which is initialized first. Report streams hold
+// ReportSize-byte reports (AmtPtpAnalyzeReports). All captures must share one
+// timestamp frequency. A damaged capture contributes the records before the
+// damage; one that does not open contributes nothing. Threads is clamped to
+// 1 - AMTPTP_ANALYZE_MAX_THREADS. Returns the number of inputs whose Status
+// is not AmtPtpCaptureEnd.
+size_t
+AmtPtpAnalyzeParallel(
+	PAMTPTP_ANALYZE_INPUT Inputs,
+	size_t Count,
+	size_t ReportSize,
+	uint32_t Threads,
+	PAMTPTP_ANALYSIS Total
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,226 @@
+// AmtPtpAnalyzeTool.c: Report rate, jitter, drop and contact lifetime histograms of a capture corpus
+//
+//   AmtPtpAnalyze [-threads=N] [-reports=Dir] [-report-size=50|30] Capture [Capture ...]
+//
+// Maps every capture and analyzes them with AmtPtpAnalyzeParallel, one
+// capture per worker at a time. All captures must share one timestamp
+// frequency, since intervals are kept in its ticks.
+//   -threads=N        Workers, default one per online CPU
+//   -reports=Dir      Dir/<name>.reports holds the report stream a driver
+//                     emitted for <name>.capture, e.g. a golden directory or
+//                     AmtPtpReplay -out; frames without a report are dropped
+//   -report-size=N    Bytes per report in those streams: 50, the default, or
+//                     30 for the compact builds
+// Prints the totals, then one histogram per statistic, empty buckets left out.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "AmtPtpAnalyzeParallel.h"
+#include "AmtPtpCaptureFile.h"
+
+#define AMTPTP_ANALYZE_BAR	40
+
+typedef enum _AMTPTP_ANALYZE_AXIS {
+	AmtPtpAnalyzeAxisInterval,
+	AmtPtpAnalyzeAxisScanTime,
+	AmtPtpAnalyzeAxisCount,
+	AmtPtpAnalyzeAxisLifetime,
+} AMTPTP_ANALYZE_AXIS;
+
+static void
+AmtPtpAnalyzeHistogram(
+	const char *Title,
+	const uint64_t *Buckets,
+	size_t Count,
+	AMTPTP_ANALYZE_AXIS Axis
+)
+{
+	uint64_t Total = 0, Max = 0;
+	size_t i, Bar;
+	char Label[32];
+
+	for (i = 0; i < Count; i++) {
+		Total += Buckets[i];
+		if (Buckets[i] > Max) Max = Buckets[i];
+	}
+
+	printf("\n%s\n", Title);
+	if (Total == 0) {
+		printf("  (none)\n");
+		return;
+	}
+
+	for (i = 0; i < Count; i++) {
+		if (Buckets[i] == 0) {
+			continue;
+		}
+
+		switch (Axis) {
+		case AmtPtpAnalyzeAxisInterval:
+			if (i == Count - 1) {
+				snprintf(Label, sizeof(Label), ">= %.2f ms", i * AMTPTP_ANALYZE_INTERVAL_BUCKET_US / 1000.0);
+			}
+			else {
+				snprintf(Label, sizeof(Label), "%.2f-%.2f ms", i * AMTPTP_ANALYZE_INTERVAL_BUCKET_US / 1000.0,
+					(i + 1) * AMTPTP_ANALYZE_INTERVAL_BUCKET_US / 1000.0);
+			}
+			break;
+		case AmtPtpAnalyzeAxisScanTime:
+			snprintf(Label, sizeof(Label), "%s%.1f ms", i == Count - 1 ? ">= " : "", i / 10.0);
+			break;
+		case AmtPtpAnalyzeAxisCount:
+			snprintf(Label, sizeof(Label), "%zu", i);
+			break;
+		case AmtPtpAnalyzeAxisLifetime:
+			snprintf(Label, sizeof(Label), "%llu-%llu frames", 1ull << i, (2ull << i) - 1);
+			break;
+		}
+
+		Bar = (size_t) ((Buckets[i] * AMTPTP_ANALYZE_BAR + Max - 1) / Max);
+		printf("  %-18s %12llu %6.2f%% %.*s\n", Label, (unsigned long long) Buckets[i],
+			100.0 * (double) Buckets[i] / (double) Total, (int) Bar,
+			"########################################");
+	}
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_ANALYSIS Total;
+	AMTPTP_CAPTURE_READER Reader;
+	PAMTPTP_ANALYZE_INPUT Inputs;
+	AMTPTP_CAPTURE_MAP *Captures, *Reports;
+	const char *ReportDir = NULL, *Name;
+	size_t ReportSize = AMTPTP_REPORT_SIZE, Count, Failed, Length, i;
+	uint64_t Frequency = 0;
+	uint32_t Threads;
+	long Online = sysconf(_SC_NPROCESSORS_ONLN);
+	char Path[4096];
+	int Arg, Error;
+
+	Threads = Online > 0 ? (uint32_t) Online : 1;
+
+	for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++) {
+		if (strncmp(argv[Arg], "-threads=", 9) == 0) {
+			Threads = (uint32_t) strtoul(argv[Arg] + 9, NULL, 0);
+		}
+		else if (strncmp(argv[Arg], "-reports=", 9) == 0) {
+			ReportDir = argv[Arg] + 9;
+		}
+		else if (strncmp(argv[Arg], "-report-size=", 13) == 0) {
+			ReportSize = strtoul(argv[Arg] + 13, NULL, 0);
+			if (ReportSize != AMTPTP_REPORT_SIZE && ReportSize != AMTPTP_COMPACT_REPORT_SIZE) {
+				fprintf(stderr, "%s: expected %d or %d\n", argv[Arg], AMTPTP_REPORT_SIZE,
+					AMTPTP_COMPACT_REPORT_SIZE);
+				return 2;
+			}
+		}
+		else {
+			fprintf(stderr, "%s: unknown option\n", argv[Arg]);
+			return 2;
+		}
+	}
+
+	if (Arg == argc) {
+		fprintf(stderr, "usage: %s [-threads=N] [-reports=Dir] [-report-size=50|30] Capture [Capture ...]\n",
+			argv[0]);
+		return 2;
+	}
+
+	Count = (size_t) (argc - Arg);
+	Inputs = calloc(Count, sizeof(*Inputs));
+	Captures = calloc(Count, sizeof(*Captures));
+	Reports = calloc(Count, sizeof(*Reports));
+	if (Inputs == NULL || Captures == NULL || Reports == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < Count; i++, Arg++) {
+		Error = AmtPtpCaptureMap(argv[Arg], &Captures[i]);
+		if (Error != 0) {
+			fprintf(stderr, "%s: %s\n", argv[Arg], strerror(Error));
+			return 1;
+		}
+		if (AmtPtpCaptureOpen(&Reader, Captures[i].Base, Captures[i].Size) != AmtPtpCaptureOk) {
+			fprintf(stderr, "%s: not a capture\n", argv[Arg]);
+			return 1;
+		}
+		if (i == 0) {
+			Frequency = Reader.Device.TimestampFrequency;
+		}
+		else if (Reader.Device.TimestampFrequency != Frequency) {
+			fprintf(stderr, "%s: timestamp frequency %llu differs from %llu\n", argv[Arg],
+				(unsigned long long) Reader.Device.TimestampFrequency, (unsigned long long) Frequency);
+			return 1;
+		}
+
+		Inputs[i].Capture = Captures[i].Base;
+		Inputs[i].CaptureSize = Captures[i].Size;
+
+		if (ReportDir != NULL) {
+			Name = strrchr(argv[Arg], '/');
+			Name = Name ? Name + 1 : argv[Arg];
+			Length = strlen(Name);
+			if (Length > 8 && strcmp(Name + Length - 8, ".capture") == 0) {
+				Length -= 8;
+			}
+			snprintf(Path, sizeof(Path), "%s/%.*s.reports", ReportDir, (int) Length, Name);
+
+			Error = AmtPtpCaptureMap(Path, &Reports[i]);
+			if (Error != 0) {
+				fprintf(stderr, "%s: %s\n", Path, strerror(Error));
+				return 1;
+			}
+			// An empty stream is still one, with every frame dropped
+			Inputs[i].Reports = Reports[i].Base ? Reports[i].Base : (const uint8_t *) "";
+			Inputs[i].ReportsSize = Reports[i].Size;
+		}
+	}
+
+	Failed = AmtPtpAnalyzeParallel(Inputs, Count, ReportSize, Threads, &Total);
+
+	printf("%zu capture(s), %u threads, %llu frames, %llu malformed, %llu contacts, %.1f frames/s",
+		Count, (unsigned) Threads, (unsigned long long) Total.Frames, (unsigned long long) Total.Malformed,
+		(unsigned long long) Total.Contacts, AmtPtpAnalyzeReportRate(&Total));
+	if (ReportDir != NULL) {
+		printf(", %llu reports, %llu dropped", (unsigned long long) Total.Reports,
+			(unsigned long long) AmtPtpAnalyzeDropped(&Total));
+	}
+	printf("\n");
+	if (Frequency != 0 && Total.IntervalMin <= Total.IntervalMax) {
+		printf("interval min %.3f ms, max %.3f ms\n", Total.IntervalMin * 1000.0 / (double) Frequency,
+			Total.IntervalMax * 1000.0 / (double) Frequency);
+	}
+
+	AmtPtpAnalyzeHistogram("interval", Total.Intervals, AMTPTP_ANALYZE_INTERVAL_BUCKETS,
+		AmtPtpAnalyzeAxisInterval);
+	AmtPtpAnalyzeHistogram("scan time", Total.ScanTime, AMTPTP_SCAN_TIME_MAX + 1, AmtPtpAnalyzeAxisScanTime);
+	AmtPtpAnalyzeHistogram("contacts per frame", Total.ContactCount, AMTPTP_MAX_CONTACTS + 1,
+		AmtPtpAnalyzeAxisCount);
+	AmtPtpAnalyzeHistogram("contact lifetime", Total.Lifetimes, AMTPTP_ANALYZE_LIFETIME_BUCKETS,
+		AmtPtpAnalyzeAxisLifetime);
+	if (ReportDir != NULL) {
+		AmtPtpAnalyzeHistogram("report scan time", Total.ReportScanTime, AMTPTP_SCAN_TIME_MAX + 1,
+			AmtPtpAnalyzeAxisScanTime);
+	}
+
+	for (i = 0; i < Count; i++) {
+		if (Inputs[i].Status != AmtPtpCaptureEnd) {
+			fprintf(stderr, "%s: damaged capture (%d)\n", argv[argc - Count + i], (int) Inputs[i].Status);
+		}
+		AmtPtpCaptureUnmap(&Captures[i]);
+		AmtPtpCaptureUnmap(&Reports[i]);
+	}
+	free(Inputs);
+	free(Captures);
+	free(Reports);
+	return Failed != 0;
+}
@@ -0,0 +1,252 @@
+// AmtPtpBaselineTool.c: Benchmark result store on disk and regression check
+//
+//   AmtPtpBaseline [-store=File] record Commit [Results]
+//   AmtPtpBaseline [-store=File] [-threshold=F] check BaseCommit Commit
+//   AmtPtpBaseline [-store=File] history Family Metric
+//
+// Keeps the AmtPtpBaseline.h store in File, AmtPtpBaseline.tsv by default.
+//   record    appends the costs of the JSON lines AmtPtpBench<Driver> or
+//             AmtPtpResume<Driver> printed to Results, or to stdin without
+//             one, as runs of Commit: every *_per_frame and *_us field.
+//             Benchmark rows are kept per stage and finger count, as family
+//             Driver/pppp/stage/fingers.
+//   check     compares Commit with BaseCommit and exits 1 if any family and
+//             metric regressed by more than the threshold, 0.05 by default
+//   history   prints the runs of one family and metric per commit
+// Repeat record for several runs of a commit; check needs a few on both sides
+// for its intervals to mean anything.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AmtPtpBaseline.h"
+#include "AmtPtpCaptureFile.h"
+
+#define AMTPTP_BASELINE_RESULT_MAX	1024
+
+// Bytes of check or history output per series, a generous bound
+#define AMTPTP_BASELINE_OUT_PER_SERIES	256
+
+static int
+AmtPtpBaselineEndsWith(
+	const char *Name,
+	size_t Length,
+	const char *Suffix
+)
+{
+	size_t n = strlen(Suffix);
+
+	return Length > n && memcmp(Name + Length - n, Suffix, n) == 0;
+}
+
+// Finds "Key": in a flat JSON object and returns what follows the colon
+static const char *
+AmtPtpBaselineJsonValue(
+	const char *Line,
+	const char *Key
+)
+{
+	size_t n = strlen(Key);
+	const char *p;
+
+	for (p = strchr(Line, '"'); p != NULL; p = strchr(p + 1, '"')) {
+		if (strncmp(p + 1, Key, n) == 0 && p[n + 1] == '"' && p[n + 2] == ':') {
+			return p + n + 3;
+		}
+	}
+
+	return NULL;
+}
+
+// Appends one record per cost of a result line. Returns the records written,
+// or -1 when the line names no family.
+static int
+AmtPtpBaselineRecordLine(
+	FILE *Store,
+	const char *Commit,
+	const char *Line
+)
+{
+	char Family[AMTPTP_BASELINE_NAME_SIZE], Metric[AMTPTP_BASELINE_NAME_SIZE];
+	char Record[AMTPTP_BASELINE_COMMIT_SIZE + 2 * AMTPTP_BASELINE_NAME_SIZE + 32];
+	const char *Value, *Stage, *Fingers, *p, *Key;
+	size_t KeyLength;
+	double Number;
+	char *End;
+	int Records = 0;
+
+	Value = AmtPtpBaselineJsonValue(Line, "family");
+	if (Value == NULL || *Value != '"') {
+		return -1;
+	}
+
+	Stage = AmtPtpBaselineJsonValue(Line, "stage");
+	Fingers = AmtPtpBaselineJsonValue(Line, "fingers");
+	if (Stage != NULL && *Stage == '"' && Fingers != NULL) {
+		snprintf(Family, sizeof(Family), "%.*s/%.*s/%lu", (int) strcspn(Value + 1, "\""), Value + 1,
+			(int) strcspn(Stage + 1, "\""), Stage + 1, strtoul(Fingers, NULL, 10));
+	}
+	else {
+		snprintf(Family, sizeof(Family), "%.*s", (int) strcspn(Value + 1, "\""), Value + 1);
+	}
+
+	for (p = strchr(Line, '"'); p != NULL; p = strchr(p + 1, '"')) {
+		Key = p + 1;
+		KeyLength = strcspn(Key, "\"");
+		if (Key[KeyLength] != '"' || Key[KeyLength + 1] != ':') {
+			continue;
+		}
+		p = Key + KeyLength;
+
+		if (!AmtPtpBaselineEndsWith(Key, KeyLength, "_per_frame") &&
+			!AmtPtpBaselineEndsWith(Key, KeyLength, "_us")) {
+			continue;
+		}
+
+		Number = strtod(Key + KeyLength + 2, &End);
+		if (End == Key + KeyLength + 2 || KeyLength >= sizeof(Metric)) {
+			continue;
+		}
+
+		memcpy(Metric, Key, KeyLength);
+		Metric[KeyLength] = 0;
+		if (AmtPtpBaselineFormat(Commit, Family, Metric, Number, Record, sizeof(Record)) == 0 ||
+			fputs(Record, Store) == EOF) {
+			return -1;
+		}
+		Records++;
+	}
+
+	return Records;
+}
+
+static int
+AmtPtpBaselineRecord(
+	const char *StorePath,
+	const char *Commit,
+	const char *ResultsPath
+)
+{
+	char Line[AMTPTP_BASELINE_RESULT_MAX];
+	FILE *Results = stdin, *Store;
+	int Records = 0, n, Failed = 0;
+
+	if (ResultsPath != NULL && (Results = fopen(ResultsPath, "r")) == NULL) {
+		fprintf(stderr, "%s: %s\n", ResultsPath, strerror(errno));
+		return 1;
+	}
+
+	Store = fopen(StorePath, "a");
+	if (Store == NULL) {
+		fprintf(stderr, "%s: %s\n", StorePath, strerror(errno));
+		if (Results != stdin) fclose(Results);
+		return 1;
+	}
+
+	while (fgets(Line, sizeof(Line), Results) != NULL) {
+		if (Line[0] != '{') {
+			continue;
+		}
+
+		n = AmtPtpBaselineRecordLine(Store, Commit, Line);
+		if (n < 0) {
+			fprintf(stderr, "%s: no family in %s", StorePath, Line);
+			Failed = 1;
+			continue;
+		}
+		Records += n;
+	}
+
+	if (fclose(Store) != 0) {
+		fprintf(stderr, "%s: %s\n", StorePath, strerror(errno));
+		Failed = 1;
+	}
+	if (Results != stdin) {
+		fclose(Results);
+	}
+
+	printf("%d record(s) for %s\n", Records, Commit);
+	return Failed || Records == 0;
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	AMTPTP_BASELINE_INDEX Index;
+	AMTPTP_CAPTURE_MAP Map;
+	PAMTPTP_BASELINE_SERIES Series;
+	const char *StorePath = "AmtPtpBaseline.tsv";
+	const char *Store;
+	double Threshold = 0.05;
+	uint32_t *Slots, Capacity = 0, Regressions = 0;
+	size_t OutSize, i;
+	char *Out;
+	int Arg, Error;
+
+	for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++) {
+		if (strncmp(argv[Arg], "-store=", 7) == 0) {
+			StorePath = argv[Arg] + 7;
+		}
+		else if (strncmp(argv[Arg], "-threshold=", 11) == 0) {
+			Threshold = strtod(argv[Arg] + 11, NULL);
+		}
+		else {
+			break;
+		}
+	}
+
+	if (Arg + 2 <= argc && strcmp(argv[Arg], "record") == 0 && argc - Arg <= 3) {
+		return AmtPtpBaselineRecord(StorePath, argv[Arg + 1], Arg + 2 < argc ? argv[Arg + 2] : NULL);
+	}
+
+	if (argc - Arg != 3 || (strcmp(argv[Arg], "check") != 0 && strcmp(argv[Arg], "history") != 0)) {
+		fprintf(stderr, "usage: %s [-store=File] record Commit [Results]\n"
+			"       %s [-store=File] [-threshold=F] check BaseCommit Commit\n"
+			"       %s [-store=File] history Family Metric\n", argv[0], argv[0], argv[0]);
+		return 2;
+	}
+
+	Error = AmtPtpCaptureMap(StorePath, &Map);
+	if (Error != 0) {
+		fprintf(stderr, "%s: %s\n", StorePath, strerror(Error));
+		return 1;
+	}
+	Store = Map.Base ? (const char *) Map.Base : "";
+
+	// A store has no more series than lines
+	for (i = 0; i < Map.Size; i++) {
+		Capacity += Store[i] == '\n';
+	}
+	Capacity++;
+
+	Series = malloc(Capacity * sizeof(*Series));
+	Slots = malloc(AMTPTP_BASELINE_SLOTS(Capacity) * sizeof(*Slots));
+	OutSize = (size_t) Capacity * AMTPTP_BASELINE_OUT_PER_SERIES;
+	Out = malloc(OutSize);
+	if (Series == NULL || Slots == NULL || Out == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	AmtPtpBaselineIndex(Store, Map.Size, Series, Capacity, Slots, &Index);
+
+	if (strcmp(argv[Arg], "check") == 0) {
+		Regressions = AmtPtpBaselineCheck(&Index, argv[Arg + 1], argv[Arg + 2], Threshold, Out, OutSize);
+		fputs(Out, stdout);
+		printf("%u regression(s) from %s to %s\n", (unsigned) Regressions, argv[Arg + 1], argv[Arg + 2]);
+	}
+	else {
+		AmtPtpBaselineHistory(&Index, argv[Arg + 1], argv[Arg + 2], Out, OutSize);
+		fputs(Out, stdout);
+	}
+
+	free(Out);
+	free(Slots);
+	free(Series);
+	AmtPtpCaptureUnmap(&Map);
+	return Regressions != 0;
+}
@@ -0,0 +1,226 @@
+// AmtPtpBenchTool.c: Per-family cost of the frame hot path on real counters
+//
+//   AmtPtpBench<Driver> [-frames=N] [-fingers=0,1,5,16]
+//
+// Takes the family rows from the linked driver build (AmtPtpFamilies.h) and
+// runs AmtPtpBenchRun for every row and finger count. Prints one JSON object
+// per family, finger count and stage on stdout (AmtPtpBenchFormat), with
+// these counters per frame where the host has them:
+//   ns            CLOCK_MONOTONIC
+//   cycles        time stamp counter, x86 only
+//   instructions  retired user-mode instructions, Linux perf events only
+// Missing counters are named on stderr. Finger counts a family's frames
+// cannot carry, like 16 on SPI, are skipped. Numbers only mean something on
+// an optimized build (-DCMAKE_BUILD_TYPE=Release).
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define AMTPTP_BENCH_HAVE_TSC
+#endif
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+
+#define AMTPTP_BENCH_DEFAULT_FRAMES		1000000
+#define AMTPTP_BENCH_MAX_FINGER_COUNTS	16
+
+typedef struct _AMTPTP_BENCH_CONTEXT {
+	int Instructions;					// perf event descriptor, or -1
+} AMTPTP_BENCH_CONTEXT;
+
+static uint64_t
+AmtPtpBenchNanoseconds(
+	void *Context
+)
+{
+	struct timespec Now;
+
+	(void) Context;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t) Now.tv_sec * 1000000000ull + (uint64_t) Now.tv_nsec;
+}
+
+#ifdef AMTPTP_BENCH_HAVE_TSC
+static uint64_t
+AmtPtpBenchCycles(
+	void *Context
+)
+{
+	(void) Context;
+	return __rdtsc();
+}
+#endif
+
+#if defined(__linux__)
+static uint64_t
+AmtPtpBenchInstructions(
+	void *Context
+)
+{
+	AMTPTP_BENCH_CONTEXT *Bench = Context;
+	uint64_t Value = 0;
+
+	if (read(Bench->Instructions, &Value, sizeof(Value)) != sizeof(Value)) {
+		return 0;
+	}
+	return Value;
+}
+
+// Returns -1 where perf events are missing or not permitted
+static int
+AmtPtpBenchOpenInstructions(
+	void
+)
+{
+	struct perf_event_attr Attr;
+	long Fd;
+
+	memset(&Attr, 0, sizeof(Attr));
+	Attr.type = PERF_TYPE_HARDWARE;
+	Attr.size = sizeof(Attr);
+	Attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	Attr.exclude_kernel = 1;
+	Attr.exclude_hv = 1;
+
+	Fd = syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+	return Fd < 0 ? -1 : (int) Fd;
+}
+#endif
+
+static void
+AmtPtpBenchInitCounters(
+	AMTPTP_BENCH_COUNTERS *Counters,
+	AMTPTP_BENCH_CONTEXT *Bench
+)
+{
+	memset(Counters, 0, sizeof(*Counters));
+	Counters->Context = Bench;
+	Bench->Instructions = -1;
+
+	Counters->Names[Counters->Count] = "ns";
+	Counters->Read[Counters->Count++] = AmtPtpBenchNanoseconds;
+
+#ifdef AMTPTP_BENCH_HAVE_TSC
+	Counters->Names[Counters->Count] = "cycles";
+	Counters->Read[Counters->Count++] = AmtPtpBenchCycles;
+#else
+	fprintf(stderr, "cycles: no time stamp counter on this architecture\n");
+#endif
+
+#if defined(__linux__)
+	Bench->Instructions = AmtPtpBenchOpenInstructions();
+	if (Bench->Instructions >= 0) {
+		Counters->Names[Counters->Count] = "instructions";
+		Counters->Read[Counters->Count++] = AmtPtpBenchInstructions;
+	}
+	else {
+		fprintf(stderr, "instructions: perf events unavailable (%s)\n", strerror(errno));
+	}
+#else
+	fprintf(stderr, "instructions: perf events need Linux\n");
+#endif
+}
+
+// Parses a comma separated list into Fingers and returns how many there are
+static size_t
+AmtPtpBenchParseFingers(
+	const char *List,
+	uint32_t *Fingers
+)
+{
+	size_t Count = 0;
+	char *End;
+
+	while (*List != '\0' && Count < AMTPTP_BENCH_MAX_FINGER_COUNTS) {
+		Fingers[Count++] = (uint32_t) strtoul(List, &End, 10);
+		if (End == List || (*End != ',' && *End != '\0')) {
+			return 0;
+		}
+		List = *End == ',' ? End + 1 : End;
+	}
+	return Count;
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_BENCH_FAMILY Families[AMTPTP_HOST_MAX_FAMILIES];
+	AMTPTP_BENCH_RESULT Results[AmtPtpBenchStageCount];
+	AMTPTP_BENCH_COUNTERS Counters;
+	AMTPTP_BENCH_CONTEXT Bench;
+	WDFDRIVER Driver = NULL;
+	uint32_t Fingers[AMTPTP_BENCH_MAX_FINGER_COUNTS] = { 0, 1, 5, 16 };
+	size_t FingerCount = 4, FamilyCount, f, n;
+	unsigned long long Frames = AMTPTP_BENCH_DEFAULT_FRAMES;
+	char Line[512];
+	int Arg, s;
+
+	for (Arg = 1; Arg < argc; Arg++) {
+		if (strncmp(argv[Arg], "-frames=", 8) == 0) {
+			Frames = strtoull(argv[Arg] + 8, NULL, 0);
+		}
+		else if (strncmp(argv[Arg], "-fingers=", 9) == 0) {
+			FingerCount = AmtPtpBenchParseFingers(argv[Arg] + 9, Fingers);
+		}
+		else {
+			break;
+		}
+	}
+
+	if (Arg != argc || Frames == 0 || FingerCount == 0) {
+		fprintf(stderr, "usage: %s [-frames=N] [-fingers=0,1,5,16]\n", argv[0]);
+		return 2;
+	}
+
+	if (AmtPtpHostLoadDriver(DriverEntry, &Driver) != STATUS_SUCCESS) {
+		fprintf(stderr, "%s: DriverEntry failed\n", AmtPtpHostFamilyDriver);
+		return 1;
+	}
+	FamilyCount = AmtPtpHostGetFamilies(Driver, Families, AMTPTP_HOST_MAX_FAMILIES);
+	if (FamilyCount == 0) {
+		fprintf(stderr, "%s: no family could be prepared\n", AmtPtpHostFamilyDriver);
+		AmtPtpHostUnloadDriver(Driver);
+		return 1;
+	}
+
+	AmtPtpBenchInitCounters(&Counters, &Bench);
+
+	for (f = 0; f < FamilyCount; f++) {
+		for (n = 0; n < FingerCount; n++) {
+			if (AmtPtpBenchRun(&Families[f], Fingers[n], Frames, &Counters, Results) != 0) {
+				fprintf(stderr, "%s: skipped %u fingers\n", Families[f].Name, (unsigned) Fingers[n]);
+				continue;
+			}
+
+			for (s = 0; s < AmtPtpBenchStageCount; s++) {
+				AmtPtpBenchFormat(&Results[s], &Counters, Line, sizeof(Line));
+				printf("%s\n", Line);
+			}
+		}
+	}
+
+#if defined(__linux__)
+	if (Bench.Instructions >= 0) {
+		close(Bench.Instructions);
+	}
+#endif
+	AmtPtpHostUnloadDriver(Driver);
+	return 0;
+}
@@ -0,0 +1,223 @@
+// AmtPtpCaptureFile.c: Capture files on disk
+
+#include "AmtPtpCaptureFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int
+AmtPtpCaptureWriteAll(
+	int Fd,
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	ssize_t Written;
+
+	while (Size > 0) {
+		Written = write(Fd, Data, Size);
+		if (Written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno;
+		}
+		Data += Written;
+		Size -= (size_t) Written;
+	}
+	return 0;
+}
+
+int
+AmtPtpCaptureMap(
+	const char *Path,
+	PAMTPTP_CAPTURE_MAP Map
+)
+{
+	struct stat Stat;
+	void *Base;
+	int Fd, Error = 0;
+
+	Map->Base = NULL;
+	Map->Size = 0;
+
+	Fd = open(Path, O_RDONLY | O_CLOEXEC);
+	if (Fd < 0) {
+		return errno;
+	}
+
+	if (fstat(Fd, &Stat) != 0) {
+		Error = errno;
+	}
+	else if ((uint64_t) Stat.st_size > SIZE_MAX) {
+		Error = EFBIG;
+	}
+	else if (Stat.st_size > 0) {
+		Base = mmap(NULL, (size_t) Stat.st_size, PROT_READ, MAP_PRIVATE, Fd, 0);
+		if (Base == MAP_FAILED) {
+			Error = errno;
+		}
+		else {
+			// Records are read once, front to back
+			madvise(Base, (size_t) Stat.st_size, MADV_SEQUENTIAL);
+			Map->Base = Base;
+			Map->Size = (size_t) Stat.st_size;
+		}
+	}
+
+	close(Fd);
+	return Error;
+}
+
+void
+AmtPtpCaptureUnmap(
+	PAMTPTP_CAPTURE_MAP Map
+)
+{
+	if (Map->Base != NULL) {
+		munmap((void *) Map->Base, Map->Size);
+	}
+	Map->Base = NULL;
+	Map->Size = 0;
+}
+
+int
+AmtPtpCaptureFileCreate(
+	const char *Path,
+	const AMTPTP_CAPTURE_DEVICE *Device,
+	PAMTPTP_CAPTURE_FILE File
+)
+{
+	File->Records = 0;
+	File->Used = 0;
+
+	if (AmtPtpCaptureEncodeHeader(Device, File->Buffer, sizeof(File->Buffer), &File->Used) != AmtPtpCaptureOk) {
+		File->Fd = -1;
+		return EINVAL;
+	}
+
+	File->Fd = open(Path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+	if (File->Fd < 0) {
+		File->Used = 0;
+		return errno;
+	}
+
+	// The header goes out at once, so even a capture cut short by a crash opens
+	return AmtPtpCaptureFileFlush(File);
+}
+
+int
+AmtPtpCaptureFileOpen(
+	const char *Path,
+	PAMTPTP_CAPTURE_FILE File
+)
+{
+	AMTPTP_CAPTURE_MAP Map;
+	AMTPTP_CAPTURE_READER Reader;
+	const uint8_t *Frame;
+	uint64_t Timestamp;
+	uint32_t Length;
+	size_t Start, End;
+	int Error;
+
+	File->Fd = -1;
+	File->Records = 0;
+	File->Used = 0;
+
+	Error = AmtPtpCaptureMap(Path, &Map);
+	if (Error != 0) {
+		return Error;
+	}
+
+	if (AmtPtpCaptureOpen(&Reader, Map.Base, Map.Size) != AmtPtpCaptureOk) {
+		AmtPtpCaptureUnmap(&Map);
+		return EINVAL;
+	}
+
+	// The last complete record ends the capture, padded if its padding is missing
+	End = Reader.Offset;
+	for (Start = Reader.Offset;
+		AmtPtpCaptureNext(&Reader, &Timestamp, &Frame, &Length) == AmtPtpCaptureOk;
+		Start = Reader.Offset) {
+		End = Start + AmtPtpCaptureRecordLength(Length);
+		File->Records++;
+	}
+	AmtPtpCaptureUnmap(&Map);
+
+	File->Fd = open(Path, O_WRONLY | O_APPEND | O_CLOEXEC);
+	if (File->Fd < 0) {
+		return errno;
+	}
+
+	if (ftruncate(File->Fd, (off_t) End) != 0) {
+		Error = errno;
+		close(File->Fd);
+		File->Fd = -1;
+		return Error;
+	}
+	return 0;
+}
+
+int
+AmtPtpCaptureFileAppend(
+	PAMTPTP_CAPTURE_FILE File,
+	uint64_t Timestamp,
+	const uint8_t *Frame,
+	uint32_t Length
+)
+{
+	size_t Written;
+	int Error;
+
+	if (AmtPtpCaptureRecordLength(Length) > sizeof(File->Buffer)) {
+		return EMSGSIZE;
+	}
+
+	if (AmtPtpCaptureEncodeRecord(Timestamp, Frame, Length, File->Buffer + File->Used,
+		sizeof(File->Buffer) - File->Used, &Written) != AmtPtpCaptureOk) {
+		Error = AmtPtpCaptureFileFlush(File);
+		if (Error != 0) {
+			return Error;
+		}
+		AmtPtpCaptureEncodeRecord(Timestamp, Frame, Length, File->Buffer, sizeof(File->Buffer), &Written);
+	}
+
+	File->Used += Written;
+	File->Records++;
+	return 0;
+}
+
+int
+AmtPtpCaptureFileFlush(
+	PAMTPTP_CAPTURE_FILE File
+)
+{
+	int Error = AmtPtpCaptureWriteAll(File->Fd, File->Buffer, File->Used);
+
+	if (Error == 0) {
+		File->Used = 0;
+	}
+	return Error;
+}
+
+int
+AmtPtpCaptureFileClose(
+	PAMTPTP_CAPTURE_FILE File
+)
+{
+	int Error = 0;
+
+	if (File->Fd >= 0) {
+		Error = AmtPtpCaptureFileFlush(File);
+		if (close(File->Fd) != 0 && Error == 0) {
+			Error = errno;
+		}
+	}
+
+	File->Fd = -1;
+	File->Used = 0;
+	return Error;
+}
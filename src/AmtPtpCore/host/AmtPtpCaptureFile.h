@@ -0,0 +1,84 @@
+// AmtPtpCaptureFile.h: Capture files on disk (see AmtPtpCapture.h)
+//
+// Readers map the whole file read-only and walk it with AmtPtpCaptureNext,
+// so a capture of several hours is paged in as it is read and never copied.
+// Writers only append: records are encoded into a fixed buffer that is
+// written out whenever it fills, so a writer's memory does not grow with the
+// capture. A capture cut short by a crash keeps every record written before
+// it, and AmtPtpCaptureFileOpen drops the partial record at its end before
+// appending again. Functions returning int return 0 or an errno value.
+
+#pragma once
+
+#include "AmtPtpCapture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_CAPTURE_FILE_BUFFER	(64 * 1024)
+
+typedef struct _AMTPTP_CAPTURE_MAP {
+	const uint8_t *Base;			// NULL for an empty file
+	size_t Size;
+} AMTPTP_CAPTURE_MAP, *PAMTPTP_CAPTURE_MAP;
+
+typedef struct _AMTPTP_CAPTURE_FILE {
+	int Fd;
+	uint64_t Records;				// Records in the file, written out or not
+	size_t Used;					// Bytes of Buffer not yet written out
+	uint8_t Buffer[AMTPTP_CAPTURE_FILE_BUFFER];
+} AMTPTP_CAPTURE_FILE, *PAMTPTP_CAPTURE_FILE;
+
+// Maps Path read-only for AmtPtpCaptureOpen(Reader, Map->Base, Map->Size).
+int
+AmtPtpCaptureMap(
+	const char *Path,
+	PAMTPTP_CAPTURE_MAP Map
+);
+
+void
+AmtPtpCaptureUnmap(
+	PAMTPTP_CAPTURE_MAP Map
+);
+
+// Creates Path, replacing any file of that name, and writes the header.
+int
+AmtPtpCaptureFileCreate(
+	const char *Path,
+	const AMTPTP_CAPTURE_DEVICE *Device,
+	PAMTPTP_CAPTURE_FILE File
+);
+
+// Opens an existing capture for appending, after its last complete record.
+// Fails with EINVAL when Path holds no capture header.
+int
+AmtPtpCaptureFileOpen(
+	const char *Path,
+	PAMTPTP_CAPTURE_FILE File
+);
+
+// Records larger than AMTPTP_CAPTURE_FILE_BUFFER fail with EMSGSIZE.
+int
+AmtPtpCaptureFileAppend(
+	PAMTPTP_CAPTURE_FILE File,
+	uint64_t Timestamp,
+	const uint8_t *Frame,
+	uint32_t Length
+);
+
+// Writes out the buffered records
+int
+AmtPtpCaptureFileFlush(
+	PAMTPTP_CAPTURE_FILE File
+);
+
+// Flushes and closes File; File is closed even when the flush fails.
+int
+AmtPtpCaptureFileClose(
+	PAMTPTP_CAPTURE_FILE File
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,144 @@
+// AmtPtpFamilies.c: Family rows configured by the driver sources themselves
+//
+// Compiled once per driver library with that driver's headers and
+// definitions. AMTPTP_FAMILIES_USBKM and AMTPTP_FAMILIES_SPIKM select the
+// table layout, UsbUm is the default, and AMTPTP_FAMILIES_DRIVER names the
+// build. The report layout is read off the driver's PTP_REPORT, which each
+// driver ties to its packer with a C_ASSERT.
+
+#include <stdio.h>
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpSim.h"
+#include "AmtPtpSpiSim.h"
+
+const char AmtPtpHostFamilyDriver[] = AMTPTP_FAMILIES_DRIVER;
+
+#ifdef AMTPTP_FAMILIES_SPIKM
+#define AMTPTP_FAMILIES_TABLE		SpiTrackpadConfigTable
+#else
+#define AMTPTP_FAMILIES_TABLE		Bcm5974ConfigTable
+#endif
+
+// The lower edge a device is added with; it only has to outlive the device
+typedef struct _AMTPTP_FAMILIES_DEVICE {
+	AMTPTP_SIM_DEVICE UsbSim;
+	AMTPTP_USB_TRANSPORT Transport;
+	AMTPTP_SPI_SIM_DEVICE SpiSim;
+	AMTPTP_SPI_TARGET Target;
+	AMTPTP_HOST_BINDING Binding;
+} AMTPTP_FAMILIES_DEVICE, *PAMTPTP_FAMILIES_DEVICE;
+
+// Binds a device for table entry Index. Returns 0 for entries that name no device.
+static int
+AmtPtpFamiliesBind(
+	PAMTPTP_FAMILIES_DEVICE Device,
+	size_t Index,
+	uint16_t *ProductId
+)
+{
+#ifdef AMTPTP_FAMILIES_SPIKM
+	const SPI_TRACKPAD_INFO *info = &SpiTrackpadConfigTable[Index];
+	const AMTPTP_DECODER noDecoder = { 0 };
+
+	// The table ends in an all-zero entry
+	if (info->VendorId == 0) {
+		return 0;
+	}
+
+	*ProductId = info->ProductId;
+	AmtPtpSpiSimInit(&Device->SpiSim, info->VendorId, info->ProductId, &noDecoder);
+	AmtPtpSpiSimGetTarget(&Device->SpiSim, &Device->Target);
+	AmtPtpHostInitSpiBinding(&Device->Binding, &Device->Target);
+#else
+	const struct BCM5974_CONFIG *config = &Bcm5974ConfigTable[Index];
+
+#ifdef AMTPTP_FAMILIES_USBKM
+	*ProductId = (uint16_t) config->identification;
+#else
+	*ProductId = (uint16_t) config->ansi;
+#endif
+
+	// The lookups stop at an entry without a product
+	if (*ProductId == 0) {
+		return 0;
+	}
+
+	AmtPtpSimGetTransport(&Device->UsbSim, &Device->Transport);
+	AmtPtpHostInitUsbBinding(&Device->Binding, &Device->Transport, USB_VENDOR_ID_APPLE, *ProductId);
+#endif
+
+	return 1;
+}
+
+// XMax is the one bound the decoder does not keep
+static int32_t
+AmtPtpFamiliesXMax(
+	PDEVICE_CONTEXT Context
+)
+{
+#ifdef AMTPTP_FAMILIES_SPIKM
+	return Context->TrackpadInfo.XMax;
+#else
+	return Context->DeviceInfo->x.max;
+#endif
+}
+
+size_t
+AmtPtpHostGetFamilies(
+	WDFDRIVER Driver,
+	PAMTPTP_BENCH_FAMILY Families,
+	size_t MaxFamilies
+)
+{
+	static AMTPTP_FAMILIES_DEVICE device;
+	AMTPTP_FRAME frame;
+	PAMTPTP_BENCH_FAMILY family;
+	PDEVICE_CONTEXT context;
+	WDFDEVICE wdfDevice;
+	uint16_t productId;
+	size_t count = 0, i;
+
+	for (i = 0; i < sizeof(AMTPTP_FAMILIES_TABLE) / sizeof(AMTPTP_FAMILIES_TABLE[0]) && count < MaxFamilies; i++) {
+		memset(&device, 0, sizeof(device));
+		if (!AmtPtpFamiliesBind(&device, i, &productId)) {
+			continue;
+		}
+
+		if (!NT_SUCCESS(AmtPtpHostAddDevice(Driver, &device.Binding, &wdfDevice))) {
+			continue;
+		}
+		if (!NT_SUCCESS(AmtPtpHostPrepareHardware(wdfDevice))) {
+			AmtPtpHostRemoveDevice(wdfDevice);
+			continue;
+		}
+
+		context = DeviceGetContext(wdfDevice);
+
+		// Entries the driver leaves unconfigured (TYPE1) have no frame path
+		if (AmtPtpDecodeFrame(&context->Decoder, NULL, 0, 0, &frame) != AmtPtpDecodeUnsupported) {
+			family = &Families[count++];
+			memset(family, 0, sizeof(*family));
+			snprintf(family->Name, sizeof(family->Name), "%s/%04x", AmtPtpHostFamilyDriver, productId);
+			family->ProductId = productId;
+			family->Decoder = context->Decoder;
+			family->XMax = AmtPtpFamiliesXMax(context);
+			family->DecodeFrame = context->DecodeFrame;
+			family->ReportSize = sizeof(PTP_REPORT);
+			family->PackReport = sizeof(PTP_REPORT) == AMTPTP_COMPACT_REPORT_SIZE ?
+				AmtPtpPackCompactReport : AmtPtpPackReport;
+
+			// USB device identifiers exceed the compact range; SPI ones are indices
+#ifndef AMTPTP_FAMILIES_SPIKM
+			family->MapContactIds = sizeof(PTP_REPORT) == AMTPTP_COMPACT_REPORT_SIZE;
+#endif
+		}
+
+		AmtPtpHostRemoveDevice(wdfDevice);
+	}
+
+	return count;
+}
@@ -0,0 +1,39 @@
+// AmtPtpFamilies.h: Family rows configured by the driver sources themselves
+//
+// Adds one device per entry of the linked driver's configuration table
+// (Bcm5974ConfigTable, SpiTrackpadConfigTable) on the host shim and takes
+// each row from what the driver's EvtDevicePrepareHardware set up: the
+// decoder with its geometry and thresholds and the decoder function it
+// selected. The packer and contact renumbering follow the driver build, so
+// benchmarks, golden runs and fuzzers see what ships and cannot drift from
+// the tables. Built once per driver library as AmtPtpHostFamilies<Driver>.
+
+#pragma once
+
+#include "AmtPtpBench.h"
+#include "AmtPtpHostWdk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// More rows than any driver table has
+#define AMTPTP_HOST_MAX_FAMILIES	32
+
+// Name of the driver build the rows come from, e.g. "UsbUmCompact"
+extern const char AmtPtpHostFamilyDriver[];
+
+// Fills Families with the rows of the loaded Driver in table order and
+// returns how many there are; at most MaxFamilies are written. Each device is
+// removed again before the next one is added. Returns 0 if the driver fails
+// to prepare any device of its own table.
+size_t
+AmtPtpHostGetFamilies(
+	WDFDRIVER Driver,
+	PAMTPTP_BENCH_FAMILY Families,
+	size_t MaxFamilies
+);
+
+#ifdef __cplusplus
+}
+#endif
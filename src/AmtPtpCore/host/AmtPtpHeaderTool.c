@@ -0,0 +1,137 @@
+// AmtPtpHeaderTool.c: Header byte and word statistics of a capture corpus
+//
+//   AmtPtpHeader [-kernel=scalar|sse2] Capture [Capture ...]
+//
+// Scans every capture with AmtPtpHeaderScanCapture, one scan per capture, and
+// merges them, so steps never span two captures. All captures must share one
+// header size.
+//   -kernel=K    Byte kernel instead of the fastest of the build; the scan is
+//                the same with either, only the time differs
+// Prints the frame count and scan time, then one row per header byte and one
+// per little-endian word. Word entropy is printed as its bounds, low-high.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "AmtPtpCaptureFile.h"
+#include "AmtPtpHeader.h"
+
+static uint64_t
+AmtPtpHeaderNow(
+	void
+)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t) Now.tv_sec * 1000000000ull + (uint64_t) Now.tv_nsec;
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	AMTPTP_HEADER_KERNEL Kernel = AmtPtpHeaderKernelCount;
+	AMTPTP_CAPTURE_READER Reader;
+	AMTPTP_CAPTURE_STATUS Status;
+	AMTPTP_CAPTURE_MAP Map;
+	AMTPTP_HEADER_FIELD Field;
+	PAMTPTP_HEADER_SCAN Scan, Total;
+	size_t HeaderSize = 0, i;
+	uint64_t Start, Elapsed = 0;
+	int Arg, Error, k;
+
+	for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++) {
+		if (strncmp(argv[Arg], "-kernel=", 8) != 0) {
+			break;
+		}
+
+		for (k = 0; k < AmtPtpHeaderKernelCount; k++) {
+			if (strcmp(argv[Arg] + 8, AmtPtpHeaderKernelName((AMTPTP_HEADER_KERNEL) k)) == 0) {
+				Kernel = (AMTPTP_HEADER_KERNEL) k;
+			}
+		}
+		if (Kernel == AmtPtpHeaderKernelCount || !AmtPtpHeaderKernelAvailable(Kernel)) {
+			fprintf(stderr, "%s: kernel %s not in this build\n", argv[0], argv[Arg] + 8);
+			return 2;
+		}
+	}
+
+	if (Arg >= argc) {
+		fprintf(stderr, "usage: %s [-kernel=scalar|sse2] Capture [Capture ...]\n", argv[0]);
+		return 2;
+	}
+
+	// Scans hold a histogram per header byte, too large for the stack
+	Scan = malloc(sizeof(*Scan));
+	Total = malloc(sizeof(*Total));
+	if (Scan == NULL || Total == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (; Arg < argc; Arg++) {
+		Error = AmtPtpCaptureMap(argv[Arg], &Map);
+		if (Error != 0) {
+			fprintf(stderr, "%s: %s\n", argv[Arg], strerror(Error));
+			return 1;
+		}
+		if (AmtPtpCaptureOpen(&Reader, Map.Base, Map.Size) != AmtPtpCaptureOk) {
+			fprintf(stderr, "%s: not a capture\n", argv[Arg]);
+			return 1;
+		}
+
+		if (HeaderSize == 0) {
+			HeaderSize = Reader.Device.Decoder.HeaderSize;
+			AmtPtpHeaderScanInit(Total, HeaderSize);
+		}
+		else if (Reader.Device.Decoder.HeaderSize != HeaderSize) {
+			fprintf(stderr, "%s: header of %u bytes, not %zu\n", argv[Arg],
+				(unsigned) Reader.Device.Decoder.HeaderSize, HeaderSize);
+			return 1;
+		}
+
+		AmtPtpHeaderScanInit(Scan, HeaderSize);
+		if (Kernel != AmtPtpHeaderKernelCount) {
+			Scan->Kernel = Kernel;
+		}
+
+		Start = AmtPtpHeaderNow();
+		Status = AmtPtpHeaderScanCapture(Scan, &Reader);
+		Elapsed += AmtPtpHeaderNow() - Start;
+		if (Status != AmtPtpCaptureOk) {
+			fprintf(stderr, "%s: cut or malformed record\n", argv[Arg]);
+			return 1;
+		}
+
+		AmtPtpHeaderScanMerge(Total, Scan);
+		AmtPtpCaptureUnmap(&Map);
+	}
+
+	printf("%llu frames, %zu header bytes, %s kernel, %.1f ns/frame\n", (unsigned long long) Total->Frames,
+		Total->Bytes, AmtPtpHeaderKernelName(Kernel != AmtPtpHeaderKernelCount ? Kernel : Scan->Kernel),
+		Total->Frames ? (double) Elapsed / (double) Total->Frames : 0.0);
+
+	printf("\nbyte  entropy  distinct  forward  wraps  fingers  button\n");
+	for (i = 0; i < Total->Bytes; i++) {
+		AmtPtpHeaderScanByte(Total, i, &Field);
+		printf("%4zu  %7.3f  %8u  %7.3f  %5llu  %7.3f  %6.3f\n", i, Field.Entropy, (unsigned) Field.Distinct,
+			Field.Forward, (unsigned long long) Field.Wraps, Field.FingerCorrelation, Field.ButtonCorrelation);
+	}
+
+	printf("\nword  entropy          forward  wraps  interval\n");
+	for (i = 0; i + 1 < Total->Bytes; i += 2) {
+		AmtPtpHeaderScanWord(Total, i, &Field);
+		printf("%4zu  %6.3f-%-6.3f  %8.3f  %5llu  %8.3f\n", i, Field.EntropyLow, Field.EntropyHigh,
+			Field.Forward, (unsigned long long) Field.Wraps, Field.IntervalCorrelation);
+	}
+
+	free(Total);
+	free(Scan);
+	return 0;
+}
@@ -0,0 +1,237 @@
+// AmtPtpHost.h: Host harness for the driver sources on top of the WDF shim
+//
+// A test loads a driver through its DriverEntry, adds a device bound to a
+// simulated USB transport (AmtPtpSim.h) or SPI target (AmtPtpSpiSim.h) and then
+// plays the roles of PnP manager, HIDCLASS and bus: it moves the device in and
+// out of D0, sends HID IOCTLs to the default queue and completes reads on the
+// lower edge. All framework callbacks run on the calling thread, so several
+// threads may drive one device at once to race the driver against itself.
+//
+// Performance counters run on a virtual clock that only moves when the
+// harness sets or advances it.
+
+#pragma once
+
+#include "AmtPtpHostWdk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frequency reported by KeQueryPerformanceCounter unless set otherwise
+#define AMTPTP_HOST_CLOCK_FREQUENCY		10000000ull
+
+//
+// Virtual clock and trace counters
+//
+
+void
+AmtPtpHostSetClock(
+	uint64_t Ticks
+);
+
+uint64_t
+AmtPtpHostAdvanceClock(
+	uint64_t Ticks
+);
+
+uint64_t
+AmtPtpHostGetClock(
+	void
+);
+
+void
+AmtPtpHostSetClockFrequency(
+	uint64_t Frequency
+);
+
+// WPP events seen at Level, summed over all flags
+uint64_t
+AmtPtpHostTraceCount(
+	ULONG Level
+);
+
+// Makes TraceLoggingProviderEnabled true for every level and keyword
+void
+AmtPtpHostEnableTraceLogging(
+	int Enabled
+);
+
+uint64_t
+AmtPtpHostTraceLoggingCount(
+	void
+);
+
+//
+// Driver and device lifetime
+//
+
+// Lower edge of a device. Exactly one of Usb and Spi is set.
+typedef struct _AMTPTP_HOST_BINDING {
+	const AMTPTP_USB_TRANSPORT *Usb;
+	USB_DEVICE_DESCRIPTOR DeviceDescriptor;	// Returned by WdfUsbTargetDeviceGetDeviceDescriptor
+	ULONG UsbTraits;						// WDF_USB_DEVICE_TRAIT_*
+	const AMTPTP_SPI_TARGET *Spi;
+} AMTPTP_HOST_BINDING, *PAMTPTP_HOST_BINDING;
+
+// Fills a binding for a Wellspring USB device with the given IDs.
+void
+AmtPtpHostInitUsbBinding(
+	PAMTPTP_HOST_BINDING Binding,
+	const AMTPTP_USB_TRANSPORT *Transport,
+	USHORT VendorId,
+	USHORT ProductId
+);
+
+void
+AmtPtpHostInitSpiBinding(
+	PAMTPTP_HOST_BINDING Binding,
+	const AMTPTP_SPI_TARGET *Target
+);
+
+// Calls DriverEntry, which must create exactly one WDFDRIVER.
+NTSTATUS
+AmtPtpHostLoadDriver(
+	PDRIVER_INITIALIZE DriverEntry,
+	WDFDRIVER *Driver
+);
+
+// Runs the driver's cleanup callback and frees everything it still owns.
+void
+AmtPtpHostUnloadDriver(
+	WDFDRIVER Driver
+);
+
+// Calls EvtDriverDeviceAdd with a fresh WDFDEVICE_INIT bound to Binding.
+// Binding and the transport or target it points to must outlive the device.
+NTSTATUS
+AmtPtpHostAddDevice(
+	WDFDRIVER Driver,
+	const AMTPTP_HOST_BINDING *Binding,
+	WDFDEVICE *Device
+);
+
+NTSTATUS
+AmtPtpHostPrepareHardware(
+	WDFDEVICE Device
+);
+
+// Calls EvtDeviceD0Entry, restarts the device's local I/O target and then
+// dispatches the requests that waited in power-managed queues while the
+// device was out of D0.
+NTSTATUS
+AmtPtpHostD0Entry(
+	WDFDEVICE Device,
+	WDF_POWER_DEVICE_STATE PreviousState
+);
+
+// Stops the power-managed queues: every request the driver received from one
+// and still owns is passed to EvtIoStop with WdfRequestStopActionSuspend, and
+// D0 exit waits until the driver has completed or forwarded all of them. Then
+// EvtDeviceD0Exit runs and the local I/O target stops, leaving the reads sent
+// to it pending. Callbacks are never invoked with a lock held.
+NTSTATUS
+AmtPtpHostD0Exit(
+	WDFDEVICE Device,
+	WDF_POWER_DEVICE_STATE TargetState
+);
+
+// Cancels pending SPI reads, completes the requests left in queues with
+// STATUS_CANCELLED, releases hardware and deletes the device with all of its
+// children. Aborts if the driver still owns a client request. Client requests
+// stay valid until they are released.
+void
+AmtPtpHostRemoveDevice(
+	WDFDEVICE Device
+);
+
+//
+// Client requests, as HIDCLASS would send them
+//
+
+// Creates an IOCTL request. Buffers stay owned by the caller and are used in
+// place. A NULL buffer with a non-zero length is allowed for the UMDF report ID
+// convention, where the driver only looks at the length. UserBuffer becomes
+// Irp->UserBuffer, which KMDF minidrivers read HID_XFER_PACKET from.
+NTSTATUS
+AmtPtpHostCreateRequest(
+	WDFDEVICE Device,
+	ULONG IoControlCode,
+	PVOID InputBuffer,
+	size_t InputBufferLength,
+	PVOID OutputBuffer,
+	size_t OutputBufferLength,
+	PVOID UserBuffer,
+	WDFREQUEST *Request
+);
+
+// Presents Request to the default queue on the calling thread.
+void
+AmtPtpHostSendRequest(
+	WDFREQUEST Request
+);
+
+BOOLEAN
+AmtPtpHostIsRequestCompleted(
+	WDFREQUEST Request,
+	NTSTATUS *Status,
+	ULONG_PTR *Information
+);
+
+// Blocks until Request is completed, by this or another thread.
+NTSTATUS
+AmtPtpHostWaitRequest(
+	WDFREQUEST Request,
+	ULONG_PTR *Information
+);
+
+// Frees a completed or never sent request. Releasing a pending one aborts.
+void
+AmtPtpHostReleaseRequest(
+	WDFREQUEST Request
+);
+
+//
+// Lower edge
+//
+
+// Reads one transfer from the USB transport and hands it to the continuous
+// reader. Returns STATUS_INVALID_DEVICE_STATE while the pipe target is stopped
+// and STATUS_NO_MORE_ENTRIES when the transport has nothing to deliver.
+NTSTATUS
+AmtPtpHostUsbReadPipe(
+	WDFDEVICE Device
+);
+
+// Hands Buffer to the continuous reader as if the interrupt pipe delivered it.
+// The driver sees it in a buffer of the configured transfer length.
+NTSTATUS
+AmtPtpHostUsbDeliver(
+	WDFDEVICE Device,
+	const void *Buffer,
+	size_t Length
+);
+
+// Completes up to Max reads the driver sent to the SPI target, each from one
+// ReadReport call, and returns how many were completed. Nothing completes
+// while the device is out of D0.
+ULONG
+AmtPtpHostSpiCompleteReads(
+	WDFDEVICE Device,
+	ULONG Max
+);
+
+// Completes every pending SPI read with STATUS_CANCELLED.
+ULONG
+AmtPtpHostSpiCancelReads(
+	WDFDEVICE Device
+);
+
+ULONG
+AmtPtpHostSpiPendingReads(
+	WDFDEVICE Device
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,2403 @@
+// AmtPtpHostWdf.c: WDF shim and host harness (see AmtPtpHost.h)
+//
+// Every framework object starts with AMTPTP_HOST_OBJECT and is handed out as
+// its own handle. One mutex protects queues, request states and the object
+// list; it is never held across a driver callback. Transfers to the simulated
+// bus are serialized by a second mutex, as the simulators are single-threaded.
+//
+// The model is deliberately narrow: it implements what the three drivers call
+// and aborts on framework misuse (completing a request twice or while it sits
+// in a queue), so a test fails where a checked build of WDF would bugcheck.
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "AmtPtpHost.h"
+
+#define AMTPTP_HOST_MAX_CONTEXTS	2
+
+// USBD_STATUS_STALL_PID, passed to EvtUsbTargetPipeReadersFailed
+#define AMTPTP_HOST_USBD_STALL		((USBD_STATUS) 0xC0000004L)
+
+typedef enum _AMTPTP_HOST_OBJECT_TYPE {
+	AmtPtpHostObjectDriver,
+	AmtPtpHostObjectDevice,
+	AmtPtpHostObjectQueue,
+	AmtPtpHostObjectRequest,
+	AmtPtpHostObjectMemory,
+	AmtPtpHostObjectLookaside,
+	AmtPtpHostObjectIoTarget,
+	AmtPtpHostObjectKey,
+	AmtPtpHostObjectUsbDevice,
+	AmtPtpHostObjectUsbInterface,
+	AmtPtpHostObjectUsbPipe
+} AMTPTP_HOST_OBJECT_TYPE;
+
+typedef struct _AMTPTP_HOST_OBJECT {
+	AMTPTP_HOST_OBJECT_TYPE Type;
+	BOOLEAN IsEmbedded;				// Part of another object, never on the list
+	struct _AMTPTP_HOST_OBJECT *Parent;
+	struct _AMTPTP_HOST_OBJECT *Next;
+	struct _AMTPTP_HOST_OBJECT *Prev;
+	PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+	PFN_WDF_OBJECT_CONTEXT_DESTROY EvtDestroyCallback;
+	struct {
+		PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo;
+		void *Data;
+	} Contexts[AMTPTP_HOST_MAX_CONTEXTS];
+} AMTPTP_HOST_OBJECT, *PAMTPTP_HOST_OBJECT;
+
+typedef struct _AMTPTP_HOST_DRIVER AMTPTP_HOST_DRIVER, *PAMTPTP_HOST_DRIVER;
+typedef struct _AMTPTP_HOST_DEVICE AMTPTP_HOST_DEVICE, *PAMTPTP_HOST_DEVICE;
+typedef struct _AMTPTP_HOST_REQUEST AMTPTP_HOST_REQUEST, *PAMTPTP_HOST_REQUEST;
+
+struct _DRIVER_OBJECT {
+	PAMTPTP_HOST_DRIVER Driver;		// Set by WdfDriverCreate
+};
+
+struct _AMTPTP_HOST_DRIVER {
+	AMTPTP_HOST_OBJECT Header;
+	PDRIVER_OBJECT DriverObject;
+	WDF_DRIVER_CONFIG Config;
+};
+
+struct WDFDEVICE_INIT {
+	PAMTPTP_HOST_DRIVER Driver;
+	const AMTPTP_HOST_BINDING *Binding;
+	WDF_PNPPOWER_EVENT_CALLBACKS PnpPowerCallbacks;
+	BOOLEAN IsFilter;
+	PAMTPTP_HOST_DEVICE Created;
+};
+
+typedef struct _AMTPTP_HOST_MEMORY {
+	AMTPTP_HOST_OBJECT Header;
+	void *Buffer;
+	size_t Length;
+	BOOLEAN OwnsBuffer;
+} AMTPTP_HOST_MEMORY, *PAMTPTP_HOST_MEMORY;
+
+typedef struct _AMTPTP_HOST_LOOKASIDE {
+	AMTPTP_HOST_OBJECT Header;
+	size_t BufferSize;
+} AMTPTP_HOST_LOOKASIDE, *PAMTPTP_HOST_LOOKASIDE;
+
+typedef struct _AMTPTP_HOST_IO_TARGET {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_DEVICE Device;
+	BOOLEAN IsStarted;
+	ULONG InFlight;					// Completions being delivered right now
+	PAMTPTP_HOST_REQUEST PendingHead;	// Reads sent to the SPI target
+	PAMTPTP_HOST_REQUEST PendingTail;
+	ULONG PendingCount;
+} AMTPTP_HOST_IO_TARGET, *PAMTPTP_HOST_IO_TARGET;
+
+typedef struct _AMTPTP_HOST_QUEUE {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_DEVICE Device;
+	WDF_IO_QUEUE_CONFIG Config;
+	BOOLEAN IsPowerManaged;
+	PAMTPTP_HOST_REQUEST Head;
+	PAMTPTP_HOST_REQUEST Tail;
+	struct _AMTPTP_HOST_QUEUE *NextQueue;
+} AMTPTP_HOST_QUEUE, *PAMTPTP_HOST_QUEUE;
+
+typedef struct _AMTPTP_HOST_USB_PIPE {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_DEVICE Device;
+	BOOLEAN HasReader;
+	WDF_USB_CONTINUOUS_READER_CONFIG Reader;
+	AMTPTP_HOST_IO_TARGET Target;
+} AMTPTP_HOST_USB_PIPE, *PAMTPTP_HOST_USB_PIPE;
+
+typedef struct _AMTPTP_HOST_USB_INTERFACE {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_USB_PIPE Pipe;
+} AMTPTP_HOST_USB_INTERFACE, *PAMTPTP_HOST_USB_INTERFACE;
+
+typedef struct _AMTPTP_HOST_USB_DEVICE {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_DEVICE Device;
+	PAMTPTP_HOST_USB_INTERFACE Interface;
+} AMTPTP_HOST_USB_DEVICE, *PAMTPTP_HOST_USB_DEVICE;
+
+struct _AMTPTP_HOST_DEVICE {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_DRIVER Driver;
+	AMTPTP_HOST_BINDING Binding;
+	WDF_PNPPOWER_EVENT_CALLBACKS PnpPowerCallbacks;
+	WDF_DEVICE_PNP_CAPABILITIES PnpCapabilities;
+	BOOLEAN IsInD0;
+	PAMTPTP_HOST_QUEUE Queues;
+	PAMTPTP_HOST_QUEUE DefaultQueue;
+	AMTPTP_HOST_IO_TARGET LowerTarget;
+	PAMTPTP_HOST_USB_DEVICE UsbDevice;
+	PAMTPTP_HOST_REQUEST ClientRequests;
+};
+
+typedef enum _AMTPTP_HOST_REQUEST_STATE {
+	AmtPtpHostRequestCreated,
+	AmtPtpHostRequestQueued,		// Sits in a queue, owned by the framework
+	AmtPtpHostRequestOwned,			// Presented to or retrieved by the driver
+	AmtPtpHostRequestSent,			// Pending at an I/O target
+	AmtPtpHostRequestCompleted
+} AMTPTP_HOST_REQUEST_STATE;
+
+struct _AMTPTP_HOST_REQUEST {
+	AMTPTP_HOST_OBJECT Header;
+	PAMTPTP_HOST_DEVICE Device;		// Set for client requests until the device goes
+	BOOLEAN IsClient;
+	LONG References;
+	AMTPTP_HOST_REQUEST_STATE State;
+	NTSTATUS Status;
+	ULONG_PTR Information;
+	WDF_REQUEST_PARAMETERS Parameters;
+	IRP Irp;
+	AMTPTP_HOST_MEMORY InputMemory;
+	AMTPTP_HOST_MEMORY OutputMemory;
+	PAMTPTP_HOST_QUEUE Queue;		// Queue it sits in or was last delivered from
+	PAMTPTP_HOST_REQUEST QueueNext;
+	PAMTPTP_HOST_REQUEST ClientNext;
+
+	// Set by the Format routines for WdfRequestSend
+	ULONG TargetIoControlCode;
+	PAMTPTP_HOST_MEMORY TargetInput;
+	PAMTPTP_HOST_MEMORY TargetOutput;
+	PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine;
+	WDFCONTEXT CompletionContext;
+	PAMTPTP_HOST_REQUEST TargetNext;
+};
+
+typedef struct _AMTPTP_HOST_KEY {
+	AMTPTP_HOST_OBJECT Header;
+} AMTPTP_HOST_KEY, *PAMTPTP_HOST_KEY;
+
+static pthread_mutex_t AmtPtpHostLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t AmtPtpHostChanged = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t AmtPtpHostBusLock = PTHREAD_MUTEX_INITIALIZER;
+
+static AMTPTP_HOST_OBJECT *AmtPtpHostObjects;
+static PAMTPTP_HOST_DRIVER AmtPtpHostCurrentDriver;
+
+static uint64_t AmtPtpHostClock;
+static uint64_t AmtPtpHostClockFrequency = AMTPTP_HOST_CLOCK_FREQUENCY;
+static uint64_t AmtPtpHostTraceCounts[TRACE_LEVEL_VERBOSE + 1];
+static int AmtPtpHostTraceLoggingOn;
+static uint64_t AmtPtpHostTraceLoggingEvents;
+
+static void
+AmtPtpHostFail(
+	const char *Message,
+	const void *Object
+)
+{
+	fprintf(stderr, "AmtPtpHost: %s (object %p)\n", Message, Object);
+	abort();
+}
+
+static void
+AmtPtpHostLockAcquire(
+	void
+)
+{
+	pthread_mutex_lock(&AmtPtpHostLock);
+}
+
+static void
+AmtPtpHostLockRelease(
+	void
+)
+{
+	pthread_mutex_unlock(&AmtPtpHostLock);
+}
+
+//
+// Objects
+//
+
+static NTSTATUS
+AmtPtpHostInitObject(
+	PAMTPTP_HOST_OBJECT Object,
+	AMTPTP_HOST_OBJECT_TYPE Type,
+	const WDF_OBJECT_ATTRIBUTES *Attributes,
+	PAMTPTP_HOST_OBJECT DefaultParent,
+	BOOLEAN IsEmbedded
+)
+{
+	PCWDF_OBJECT_CONTEXT_TYPE_INFO typeInfo = NULL;
+
+	Object->Type = Type;
+	Object->IsEmbedded = IsEmbedded;
+	Object->Parent = DefaultParent;
+
+	if (Attributes != NULL) {
+		if (Attributes->ParentObject != NULL) {
+			Object->Parent = (PAMTPTP_HOST_OBJECT) Attributes->ParentObject;
+		}
+		Object->EvtCleanupCallback = Attributes->EvtCleanupCallback;
+		Object->EvtDestroyCallback = Attributes->EvtDestroyCallback;
+		typeInfo = Attributes->ContextTypeInfo;
+	}
+
+	if (typeInfo != NULL) {
+		size_t size = Attributes->ContextSizeOverride ? Attributes->ContextSizeOverride : typeInfo->ContextSize;
+
+		Object->Contexts[0].TypeInfo = typeInfo;
+		Object->Contexts[0].Data = calloc(1, size ? size : 1);
+		if (Object->Contexts[0].Data == NULL) {
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+	}
+
+	if (!IsEmbedded) {
+		AmtPtpHostLockAcquire();
+		Object->Prev = NULL;
+		Object->Next = AmtPtpHostObjects;
+		if (AmtPtpHostObjects != NULL) {
+			AmtPtpHostObjects->Prev = Object;
+		}
+		AmtPtpHostObjects = Object;
+		AmtPtpHostLockRelease();
+	}
+
+	return STATUS_SUCCESS;
+}
+
+static void *
+AmtPtpHostAllocateObject(
+	size_t Size,
+	AMTPTP_HOST_OBJECT_TYPE Type,
+	const WDF_OBJECT_ATTRIBUTES *Attributes,
+	PAMTPTP_HOST_OBJECT DefaultParent
+)
+{
+	PAMTPTP_HOST_OBJECT object = calloc(1, Size);
+
+	if (object == NULL) {
+		return NULL;
+	}
+
+	if (!NT_SUCCESS(AmtPtpHostInitObject(object, Type, Attributes, DefaultParent, FALSE))) {
+		free(object->Contexts[0].Data);
+		AmtPtpHostLockAcquire();
+		if (object->Prev != NULL) object->Prev->Next = object->Next;
+		else if (AmtPtpHostObjects == object) AmtPtpHostObjects = object->Next;
+		if (object->Next != NULL) object->Next->Prev = object->Prev;
+		AmtPtpHostLockRelease();
+		free(object);
+		return NULL;
+	}
+
+	return object;
+}
+
+static void
+AmtPtpHostDestroyObject(
+	PAMTPTP_HOST_OBJECT Object
+)
+{
+	PAMTPTP_HOST_OBJECT child;
+	int i;
+
+	// Children go first, like the framework's object tree
+	for (;;) {
+		AmtPtpHostLockAcquire();
+		for (child = AmtPtpHostObjects; child != NULL && child->Parent != Object; child = child->Next) {
+		}
+		AmtPtpHostLockRelease();
+
+		if (child == NULL) {
+			break;
+		}
+		AmtPtpHostDestroyObject(child);
+	}
+
+	if (Object->EvtCleanupCallback != NULL) {
+		Object->EvtCleanupCallback((WDFOBJECT) Object);
+	}
+	if (Object->EvtDestroyCallback != NULL) {
+		Object->EvtDestroyCallback((WDFOBJECT) Object);
+	}
+
+	AmtPtpHostLockAcquire();
+	if (!Object->IsEmbedded) {
+		if (Object->Prev != NULL) {
+			Object->Prev->Next = Object->Next;
+		} else {
+			AmtPtpHostObjects = Object->Next;
+		}
+		if (Object->Next != NULL) {
+			Object->Next->Prev = Object->Prev;
+		}
+	}
+
+	if (Object->Type == AmtPtpHostObjectRequest) {
+		PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Object;
+		PAMTPTP_HOST_REQUEST *link;
+
+		if (request->Device != NULL) {
+			for (link = &request->Device->ClientRequests; *link != NULL; link = &(*link)->ClientNext) {
+				if (*link == request) {
+					*link = request->ClientNext;
+					break;
+				}
+			}
+		}
+	}
+	AmtPtpHostLockRelease();
+
+	if (Object->Type == AmtPtpHostObjectMemory && ((PAMTPTP_HOST_MEMORY) Object)->OwnsBuffer) {
+		free(((PAMTPTP_HOST_MEMORY) Object)->Buffer);
+	}
+	if (Object->Type == AmtPtpHostObjectDriver && AmtPtpHostCurrentDriver == (PAMTPTP_HOST_DRIVER) Object) {
+		AmtPtpHostCurrentDriver = NULL;
+	}
+
+	for (i = 0; i < AMTPTP_HOST_MAX_CONTEXTS; i++) {
+		free(Object->Contexts[i].Data);
+		Object->Contexts[i].Data = NULL;
+		Object->Contexts[i].TypeInfo = NULL;
+	}
+
+	if (!Object->IsEmbedded) {
+		free(Object);
+	}
+}
+
+static PAMTPTP_HOST_OBJECT
+AmtPtpHostDefaultParent(
+	void
+)
+{
+	return (PAMTPTP_HOST_OBJECT) AmtPtpHostCurrentDriver;
+}
+
+PVOID
+WdfObjectGetTypedContextWorker(
+	WDFOBJECT Handle,
+	PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo
+)
+{
+	PAMTPTP_HOST_OBJECT object = (PAMTPTP_HOST_OBJECT) Handle;
+	int i;
+
+	if (object == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < AMTPTP_HOST_MAX_CONTEXTS; i++) {
+		if (object->Contexts[i].TypeInfo != NULL &&
+			strcmp(object->Contexts[i].TypeInfo->ContextName, TypeInfo->ContextName) == 0) {
+			return object->Contexts[i].Data;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+AmtPtpHostDereferenceRequest(
+	PAMTPTP_HOST_REQUEST Request
+)
+{
+	LONG references;
+
+	AmtPtpHostLockAcquire();
+	references = --Request->References;
+	AmtPtpHostLockRelease();
+
+	if (references == 0) {
+		AmtPtpHostDestroyObject(&Request->Header);
+	}
+}
+
+VOID
+WdfObjectDelete(
+	WDFOBJECT Object
+)
+{
+	PAMTPTP_HOST_OBJECT object = (PAMTPTP_HOST_OBJECT) Object;
+
+	if (object == NULL || object->IsEmbedded) {
+		return;
+	}
+
+	if (object->Type == AmtPtpHostObjectRequest) {
+		if (((PAMTPTP_HOST_REQUEST) object)->IsClient) {
+			AmtPtpHostFail("WdfObjectDelete on a request the driver did not create", object);
+		}
+		// The framework keeps its own reference while a completion routine runs
+		AmtPtpHostDereferenceRequest((PAMTPTP_HOST_REQUEST) object);
+		return;
+	}
+
+	AmtPtpHostDestroyObject(object);
+}
+
+//
+// Clock and tracing
+//
+
+void
+AmtPtpHostSetClock(
+	uint64_t Ticks
+)
+{
+	__atomic_store_n(&AmtPtpHostClock, Ticks, __ATOMIC_SEQ_CST);
+}
+
+uint64_t
+AmtPtpHostAdvanceClock(
+	uint64_t Ticks
+)
+{
+	return __atomic_add_fetch(&AmtPtpHostClock, Ticks, __ATOMIC_SEQ_CST);
+}
+
+uint64_t
+AmtPtpHostGetClock(
+	void
+)
+{
+	return __atomic_load_n(&AmtPtpHostClock, __ATOMIC_SEQ_CST);
+}
+
+void
+AmtPtpHostSetClockFrequency(
+	uint64_t Frequency
+)
+{
+	__atomic_store_n(&AmtPtpHostClockFrequency, Frequency, __ATOMIC_SEQ_CST);
+}
+
+LARGE_INTEGER
+KeQueryPerformanceCounter(
+	PLARGE_INTEGER PerformanceFrequency
+)
+{
+	LARGE_INTEGER counter;
+
+	if (PerformanceFrequency != NULL) {
+		PerformanceFrequency->QuadPart = (LONGLONG) __atomic_load_n(&AmtPtpHostClockFrequency, __ATOMIC_SEQ_CST);
+	}
+
+	counter.QuadPart = (LONGLONG) AmtPtpHostGetClock();
+	return counter;
+}
+
+BOOL
+QueryPerformanceCounter(
+	LARGE_INTEGER *PerformanceCount
+)
+{
+	PerformanceCount->QuadPart = (LONGLONG) AmtPtpHostGetClock();
+	return TRUE;
+}
+
+void
+AmtPtpHostTraceEvents(
+	ULONG Level,
+	ULONG Flags,
+	const char *Format,
+	...
+)
+{
+	// WPP format strings (%!FUNC!, %!STATUS!) are not printf strings, so
+	// events are only counted
+	UNREFERENCED_PARAMETER(Flags);
+	UNREFERENCED_PARAMETER(Format);
+
+	if (Level <= TRACE_LEVEL_VERBOSE) {
+		__atomic_add_fetch(&AmtPtpHostTraceCounts[Level], 1, __ATOMIC_RELAXED);
+	}
+}
+
+uint64_t
+AmtPtpHostTraceCount(
+	ULONG Level
+)
+{
+	return Level <= TRACE_LEVEL_VERBOSE ? __atomic_load_n(&AmtPtpHostTraceCounts[Level], __ATOMIC_RELAXED) : 0;
+}
+
+void
+AmtPtpHostEnableTraceLogging(
+	int Enabled
+)
+{
+	__atomic_store_n(&AmtPtpHostTraceLoggingOn, Enabled, __ATOMIC_SEQ_CST);
+}
+
+BOOLEAN
+AmtPtpHostTraceLoggingEnabled(
+	UCHAR Level,
+	ULONGLONG Keyword
+)
+{
+	UNREFERENCED_PARAMETER(Level);
+	UNREFERENCED_PARAMETER(Keyword);
+
+	return __atomic_load_n(&AmtPtpHostTraceLoggingOn, __ATOMIC_SEQ_CST) ? TRUE : FALSE;
+}
+
+void
+AmtPtpHostTraceLoggingWrite(
+	const char *EventName
+)
+{
+	UNREFERENCED_PARAMETER(EventName);
+
+	__atomic_add_fetch(&AmtPtpHostTraceLoggingEvents, 1, __ATOMIC_RELAXED);
+}
+
+uint64_t
+AmtPtpHostTraceLoggingCount(
+	void
+)
+{
+	return __atomic_load_n(&AmtPtpHostTraceLoggingEvents, __ATOMIC_RELAXED);
+}
+
+//
+// Driver and registry
+//
+
+NTSTATUS
+WdfDriverCreate(
+	PDRIVER_OBJECT DriverObject,
+	PCUNICODE_STRING RegistryPath,
+	PWDF_OBJECT_ATTRIBUTES DriverAttributes,
+	PWDF_DRIVER_CONFIG DriverConfig,
+	WDFDRIVER *Driver
+)
+{
+	PAMTPTP_HOST_DRIVER driver;
+
+	UNREFERENCED_PARAMETER(RegistryPath);
+
+	if (DriverObject == NULL || DriverObject->Driver != NULL || AmtPtpHostCurrentDriver != NULL) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	driver = AmtPtpHostAllocateObject(sizeof(*driver), AmtPtpHostObjectDriver, DriverAttributes, NULL);
+	if (driver == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	driver->DriverObject = DriverObject;
+	driver->Config = *DriverConfig;
+	DriverObject->Driver = driver;
+	AmtPtpHostCurrentDriver = driver;
+
+	if (Driver != NULL) {
+		*Driver = (WDFDRIVER) driver;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(
+	WDFDRIVER Driver
+)
+{
+	return ((PAMTPTP_HOST_DRIVER) Driver)->DriverObject;
+}
+
+NTSTATUS
+WdfDriverOpenParametersRegistryKey(
+	WDFDRIVER Driver,
+	ACCESS_MASK DesiredAccess,
+	PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	WDFKEY *Key
+)
+{
+	PAMTPTP_HOST_KEY key;
+
+	UNREFERENCED_PARAMETER(DesiredAccess);
+
+	key = AmtPtpHostAllocateObject(sizeof(*key), AmtPtpHostObjectKey, KeyAttributes, (PAMTPTP_HOST_OBJECT) Driver);
+	if (key == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	*Key = (WDFKEY) key;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRegistryQueryValue(
+	WDFKEY Key,
+	PCUNICODE_STRING ValueName,
+	ULONG ValueLength,
+	PVOID Value,
+	PULONG ValueLengthQueried,
+	PULONG ValueType
+)
+{
+	// The parameters key is always empty, so drivers fall back to defaults
+	UNREFERENCED_PARAMETER(Key);
+	UNREFERENCED_PARAMETER(ValueName);
+	UNREFERENCED_PARAMETER(ValueLength);
+	UNREFERENCED_PARAMETER(Value);
+	UNREFERENCED_PARAMETER(ValueLengthQueried);
+	UNREFERENCED_PARAMETER(ValueType);
+
+	return STATUS_OBJECT_NAME_NOT_FOUND;
+}
+
+VOID
+WdfRegistryClose(
+	WDFKEY Key
+)
+{
+	WdfObjectDelete((WDFOBJECT) Key);
+}
+
+//
+// Device
+//
+
+VOID
+WdfFdoInitSetFilter(
+	PWDFDEVICE_INIT DeviceInit
+)
+{
+	DeviceInit->IsFilter = TRUE;
+}
+
+VOID
+WdfPdoInitAllowForwardingRequestToParent(
+	PWDFDEVICE_INIT DeviceInit
+)
+{
+	UNREFERENCED_PARAMETER(DeviceInit);
+}
+
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(
+	PWDFDEVICE_INIT DeviceInit,
+	PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks
+)
+{
+	DeviceInit->PnpPowerCallbacks = *PnpPowerEventCallbacks;
+}
+
+NTSTATUS
+WdfDeviceCreate(
+	PWDFDEVICE_INIT *DeviceInit,
+	PWDF_OBJECT_ATTRIBUTES DeviceAttributes,
+	WDFDEVICE *Device
+)
+{
+	PWDFDEVICE_INIT init = *DeviceInit;
+	PAMTPTP_HOST_DEVICE device;
+
+	device = AmtPtpHostAllocateObject(sizeof(*device), AmtPtpHostObjectDevice, DeviceAttributes,
+		(PAMTPTP_HOST_OBJECT) init->Driver);
+	if (device == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	device->Driver = init->Driver;
+	device->Binding = *init->Binding;
+	device->PnpPowerCallbacks = init->PnpPowerCallbacks;
+	WDF_DEVICE_PNP_CAPABILITIES_INIT(&device->PnpCapabilities);
+
+	AmtPtpHostInitObject(&device->LowerTarget.Header, AmtPtpHostObjectIoTarget, NULL, NULL, TRUE);
+	device->LowerTarget.Device = device;
+	device->LowerTarget.IsStarted = TRUE;
+
+	init->Created = device;
+	*DeviceInit = NULL;
+	*Device = (WDFDEVICE) device;
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfDeviceSetPnpCapabilities(
+	WDFDEVICE Device,
+	PWDF_DEVICE_PNP_CAPABILITIES PnpCapabilities
+)
+{
+	((PAMTPTP_HOST_DEVICE) Device)->PnpCapabilities = *PnpCapabilities;
+}
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(
+	WDFDEVICE Device,
+	CONST GUID *InterfaceClassGUID,
+	PCUNICODE_STRING ReferenceString
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(InterfaceClassGUID);
+	UNREFERENCED_PARAMETER(ReferenceString);
+
+	return STATUS_SUCCESS;
+}
+
+WDFIOTARGET
+WdfDeviceGetIoTarget(
+	WDFDEVICE Device
+)
+{
+	return (WDFIOTARGET) &((PAMTPTP_HOST_DEVICE) Device)->LowerTarget;
+}
+
+WDFDRIVER
+WdfDeviceGetDriver(
+	WDFDEVICE Device
+)
+{
+	return (WDFDRIVER) ((PAMTPTP_HOST_DEVICE) Device)->Driver;
+}
+
+//
+// Queues
+//
+
+NTSTATUS
+WdfIoQueueCreate(
+	WDFDEVICE Device,
+	PWDF_IO_QUEUE_CONFIG Config,
+	PWDF_OBJECT_ATTRIBUTES QueueAttributes,
+	WDFQUEUE *Queue
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_QUEUE queue;
+
+	if (Config->DefaultQueue && device->DefaultQueue != NULL) {
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+
+	queue = AmtPtpHostAllocateObject(sizeof(*queue), AmtPtpHostObjectQueue, QueueAttributes,
+		(PAMTPTP_HOST_OBJECT) device);
+	if (queue == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	// WdfUseDefault counts as power-managed. The framework would turn it off
+	// for filter drivers; keeping it on makes EvtIoStop reachable in tests.
+	queue->Device = device;
+	queue->Config = *Config;
+	queue->IsPowerManaged = Config->PowerManaged != WdfFalse;
+
+	AmtPtpHostLockAcquire();
+	queue->NextQueue = device->Queues;
+	device->Queues = queue;
+	if (Config->DefaultQueue) {
+		device->DefaultQueue = queue;
+	}
+	AmtPtpHostLockRelease();
+
+	if (Queue != NULL) {
+		*Queue = (WDFQUEUE) queue;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+WDFDEVICE
+WdfIoQueueGetDevice(
+	WDFQUEUE Queue
+)
+{
+	return (WDFDEVICE) ((PAMTPTP_HOST_QUEUE) Queue)->Device;
+}
+
+// Caller holds the lock
+static void
+AmtPtpHostEnqueue(
+	PAMTPTP_HOST_QUEUE Queue,
+	PAMTPTP_HOST_REQUEST Request
+)
+{
+	Request->State = AmtPtpHostRequestQueued;
+	Request->Queue = Queue;
+	Request->QueueNext = NULL;
+
+	if (Queue->Tail != NULL) {
+		Queue->Tail->QueueNext = Request;
+	} else {
+		Queue->Head = Request;
+	}
+	Queue->Tail = Request;
+}
+
+// Caller holds the lock
+static PAMTPTP_HOST_REQUEST
+AmtPtpHostDequeue(
+	PAMTPTP_HOST_QUEUE Queue
+)
+{
+	PAMTPTP_HOST_REQUEST request = Queue->Head;
+
+	if (request != NULL) {
+		Queue->Head = request->QueueNext;
+		if (Queue->Head == NULL) {
+			Queue->Tail = NULL;
+		}
+		request->QueueNext = NULL;
+		request->State = AmtPtpHostRequestOwned;
+	}
+
+	return request;
+}
+
+NTSTATUS
+WdfIoQueueRetrieveNextRequest(
+	WDFQUEUE Queue,
+	WDFREQUEST *OutRequest
+)
+{
+	PAMTPTP_HOST_REQUEST request;
+
+	AmtPtpHostLockAcquire();
+	request = AmtPtpHostDequeue((PAMTPTP_HOST_QUEUE) Queue);
+	AmtPtpHostLockRelease();
+
+	*OutRequest = (WDFREQUEST) request;
+	return request != NULL ? STATUS_SUCCESS : STATUS_NO_MORE_ENTRIES;
+}
+
+static void
+AmtPtpHostDispatch(
+	PAMTPTP_HOST_QUEUE Queue,
+	PAMTPTP_HOST_REQUEST Request
+)
+{
+	const WDF_IO_QUEUE_CONFIG *config = &Queue->Config;
+	size_t outputLength = Request->Parameters.Parameters.DeviceIoControl.OutputBufferLength;
+	size_t inputLength = Request->Parameters.Parameters.DeviceIoControl.InputBufferLength;
+	ULONG code = Request->Parameters.Parameters.DeviceIoControl.IoControlCode;
+
+	if (config->EvtIoInternalDeviceControl != NULL) {
+		config->EvtIoInternalDeviceControl((WDFQUEUE) Queue, (WDFREQUEST) Request, outputLength, inputLength, code);
+	} else if (config->EvtIoDeviceControl != NULL) {
+		config->EvtIoDeviceControl((WDFQUEUE) Queue, (WDFREQUEST) Request, outputLength, inputLength, code);
+	} else if (config->EvtIoDefault != NULL) {
+		config->EvtIoDefault((WDFQUEUE) Queue, (WDFREQUEST) Request);
+	} else {
+		WdfRequestComplete((WDFREQUEST) Request, STATUS_INVALID_DEVICE_REQUEST);
+	}
+}
+
+//
+// Requests
+//
+
+VOID
+WdfRequestComplete(
+	WDFREQUEST Request,
+	NTSTATUS Status
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	AmtPtpHostLockAcquire();
+	if (request->State == AmtPtpHostRequestCompleted) {
+		AmtPtpHostLockRelease();
+		AmtPtpHostFail("request completed twice", request);
+	}
+	if (request->State == AmtPtpHostRequestQueued) {
+		AmtPtpHostLockRelease();
+		AmtPtpHostFail("request completed while it sits in a queue", request);
+	}
+
+	request->State = AmtPtpHostRequestCompleted;
+	request->Status = Status;
+	request->Irp.IoStatus.Status = Status;
+	request->Irp.IoStatus.Information = request->Information;
+	pthread_cond_broadcast(&AmtPtpHostChanged);
+	AmtPtpHostLockRelease();
+}
+
+VOID
+WdfRequestSetInformation(
+	WDFREQUEST Request,
+	ULONG_PTR Information
+)
+{
+	((PAMTPTP_HOST_REQUEST) Request)->Information = Information;
+}
+
+ULONG_PTR
+WdfRequestGetInformation(
+	WDFREQUEST Request
+)
+{
+	return ((PAMTPTP_HOST_REQUEST) Request)->Information;
+}
+
+NTSTATUS
+WdfRequestGetStatus(
+	WDFREQUEST Request
+)
+{
+	NTSTATUS status;
+
+	AmtPtpHostLockAcquire();
+	status = ((PAMTPTP_HOST_REQUEST) Request)->Status;
+	AmtPtpHostLockRelease();
+
+	return status;
+}
+
+VOID
+WdfRequestGetParameters(
+	WDFREQUEST Request,
+	PWDF_REQUEST_PARAMETERS Parameters
+)
+{
+	*Parameters = ((PAMTPTP_HOST_REQUEST) Request)->Parameters;
+}
+
+PIRP
+WdfRequestWdmGetIrp(
+	WDFREQUEST Request
+)
+{
+	return &((PAMTPTP_HOST_REQUEST) Request)->Irp;
+}
+
+NTSTATUS
+WdfRequestRetrieveOutputBuffer(
+	WDFREQUEST Request,
+	size_t MinimumRequiredSize,
+	PVOID *Buffer,
+	size_t *Length
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	if (request->OutputMemory.Buffer == NULL) {
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+	if (request->OutputMemory.Length < MinimumRequiredSize) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	*Buffer = request->OutputMemory.Buffer;
+	if (Length != NULL) {
+		*Length = request->OutputMemory.Length;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestRetrieveOutputMemory(
+	WDFREQUEST Request,
+	WDFMEMORY *Memory
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	if (request->OutputMemory.Length == 0) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	*Memory = (WDFMEMORY) &request->OutputMemory;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestRetrieveInputMemory(
+	WDFREQUEST Request,
+	WDFMEMORY *Memory
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	if (request->InputMemory.Length == 0) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	*Memory = (WDFMEMORY) &request->InputMemory;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestForwardToIoQueue(
+	WDFREQUEST Request,
+	WDFQUEUE DestinationQueue
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+	PAMTPTP_HOST_QUEUE queue = (PAMTPTP_HOST_QUEUE) DestinationQueue;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	AmtPtpHostLockAcquire();
+	if (request->State != AmtPtpHostRequestOwned) {
+		status = STATUS_INVALID_DEVICE_REQUEST;
+	} else if (queue->Config.DispatchType != WdfIoQueueDispatchManual) {
+		// The drivers only park requests in manual queues
+		status = STATUS_INVALID_DEVICE_REQUEST;
+	} else {
+		AmtPtpHostEnqueue(queue, request);
+		pthread_cond_broadcast(&AmtPtpHostChanged);
+	}
+	AmtPtpHostLockRelease();
+
+	return status;
+}
+
+NTSTATUS
+WdfRequestCreate(
+	PWDF_OBJECT_ATTRIBUTES RequestAttributes,
+	WDFIOTARGET IoTarget,
+	WDFREQUEST *Request
+)
+{
+	PAMTPTP_HOST_REQUEST request;
+
+	UNREFERENCED_PARAMETER(IoTarget);
+
+	request = AmtPtpHostAllocateObject(sizeof(*request), AmtPtpHostObjectRequest, RequestAttributes,
+		AmtPtpHostDefaultParent());
+	if (request == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	request->References = 1;
+	request->State = AmtPtpHostRequestCreated;
+	AmtPtpHostInitObject(&request->InputMemory.Header, AmtPtpHostObjectMemory, NULL, NULL, TRUE);
+	AmtPtpHostInitObject(&request->OutputMemory.Header, AmtPtpHostObjectMemory, NULL, NULL, TRUE);
+	WDF_REQUEST_PARAMETERS_INIT(&request->Parameters);
+
+	*Request = (WDFREQUEST) request;
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfRequestSetCompletionRoutine(
+	WDFREQUEST Request,
+	PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine,
+	WDFCONTEXT CompletionContext
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	request->CompletionRoutine = CompletionRoutine;
+	request->CompletionContext = CompletionContext;
+}
+
+VOID
+WdfRequestFormatRequestUsingCurrentType(
+	WDFREQUEST Request
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	request->TargetIoControlCode = request->Parameters.Parameters.DeviceIoControl.IoControlCode;
+	request->TargetInput = &request->InputMemory;
+	request->TargetOutput = &request->OutputMemory;
+}
+
+BOOLEAN
+WdfRequestSend(
+	WDFREQUEST Request,
+	WDFIOTARGET Target,
+	PWDF_REQUEST_SEND_OPTIONS Options
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+	PAMTPTP_HOST_IO_TARGET target = (PAMTPTP_HOST_IO_TARGET) Target;
+
+	// Send-and-forget hands the request to the bus driver for good. The
+	// simulated buses implement no pass-through requests, so it fails there.
+	if (Options != NULL && (Options->Flags & WDF_REQUEST_SEND_OPTION_SEND_AND_FORGET)) {
+		WdfRequestComplete(Request, STATUS_NOT_SUPPORTED);
+		return TRUE;
+	}
+
+	AmtPtpHostLockAcquire();
+	if (target->Device == NULL || target->Device->Binding.Spi == NULL ||
+		request->TargetIoControlCode != IOCTL_HID_READ_REPORT || request->TargetOutput == NULL) {
+		request->Status = STATUS_INVALID_DEVICE_REQUEST;
+		AmtPtpHostLockRelease();
+		return FALSE;
+	}
+	if (request->State == AmtPtpHostRequestSent) {
+		AmtPtpHostLockRelease();
+		AmtPtpHostFail("request sent twice", request);
+	}
+
+	request->State = AmtPtpHostRequestSent;
+	request->References++;
+	request->TargetNext = NULL;
+	if (target->PendingTail != NULL) {
+		target->PendingTail->TargetNext = request;
+	} else {
+		target->PendingHead = request;
+	}
+	target->PendingTail = request;
+	target->PendingCount++;
+	AmtPtpHostLockRelease();
+
+	return TRUE;
+}
+
+//
+// Memory
+//
+
+PVOID
+WdfMemoryGetBuffer(
+	WDFMEMORY Memory,
+	size_t *BufferSize
+)
+{
+	PAMTPTP_HOST_MEMORY memory = (PAMTPTP_HOST_MEMORY) Memory;
+
+	if (BufferSize != NULL) {
+		*BufferSize = memory->Length;
+	}
+
+	return memory->Buffer;
+}
+
+NTSTATUS
+WdfMemoryCopyFromBuffer(
+	WDFMEMORY DestinationMemory,
+	size_t DestinationOffset,
+	PVOID Buffer,
+	size_t NumBytesToCopyFrom
+)
+{
+	PAMTPTP_HOST_MEMORY memory = (PAMTPTP_HOST_MEMORY) DestinationMemory;
+
+	if (DestinationOffset > memory->Length || NumBytesToCopyFrom > memory->Length - DestinationOffset) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	if (NumBytesToCopyFrom == 0) {
+		return STATUS_SUCCESS;
+	}
+	if (memory->Buffer == NULL) {
+		AmtPtpHostFail("copy into a memory object without a buffer", memory);
+	}
+
+	memcpy((UCHAR *) memory->Buffer + DestinationOffset, Buffer, NumBytesToCopyFrom);
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfMemoryCopyToBuffer(
+	WDFMEMORY SourceMemory,
+	size_t SourceOffset,
+	PVOID Buffer,
+	size_t NumBytesToCopyTo
+)
+{
+	PAMTPTP_HOST_MEMORY memory = (PAMTPTP_HOST_MEMORY) SourceMemory;
+
+	if (SourceOffset > memory->Length || NumBytesToCopyTo > memory->Length - SourceOffset) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	if (NumBytesToCopyTo == 0) {
+		return STATUS_SUCCESS;
+	}
+	if (memory->Buffer == NULL) {
+		AmtPtpHostFail("copy from a memory object without a buffer", memory);
+	}
+
+	memcpy(Buffer, (const UCHAR *) memory->Buffer + SourceOffset, NumBytesToCopyTo);
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfLookasideListCreate(
+	PWDF_OBJECT_ATTRIBUTES LookasideAttributes,
+	size_t BufferSize,
+	POOL_TYPE PoolType,
+	PWDF_OBJECT_ATTRIBUTES MemoryAttributes,
+	ULONG PoolTag,
+	WDFLOOKASIDE *Lookaside
+)
+{
+	PAMTPTP_HOST_LOOKASIDE lookaside;
+
+	UNREFERENCED_PARAMETER(PoolType);
+	UNREFERENCED_PARAMETER(MemoryAttributes);
+	UNREFERENCED_PARAMETER(PoolTag);
+
+	lookaside = AmtPtpHostAllocateObject(sizeof(*lookaside), AmtPtpHostObjectLookaside, LookasideAttributes,
+		AmtPtpHostDefaultParent());
+	if (lookaside == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	lookaside->BufferSize = BufferSize;
+	*Lookaside = (WDFLOOKASIDE) lookaside;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfMemoryCreateFromLookaside(
+	WDFLOOKASIDE Lookaside,
+	WDFMEMORY *Memory
+)
+{
+	PAMTPTP_HOST_LOOKASIDE lookaside = (PAMTPTP_HOST_LOOKASIDE) Lookaside;
+	PAMTPTP_HOST_MEMORY memory;
+
+	// Exactly BufferSize bytes, so sanitizers see any overrun
+	memory = AmtPtpHostAllocateObject(sizeof(*memory), AmtPtpHostObjectMemory, NULL,
+		(PAMTPTP_HOST_OBJECT) lookaside);
+	if (memory == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	memory->Buffer = malloc(lookaside->BufferSize);
+	memory->Length = lookaside->BufferSize;
+	memory->OwnsBuffer = TRUE;
+	if (memory->Buffer == NULL) {
+		AmtPtpHostDestroyObject(&memory->Header);
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	*Memory = (WDFMEMORY) memory;
+	return STATUS_SUCCESS;
+}
+
+//
+// I/O targets
+//
+
+NTSTATUS
+WdfIoTargetStart(
+	WDFIOTARGET IoTarget
+)
+{
+	AmtPtpHostLockAcquire();
+	((PAMTPTP_HOST_IO_TARGET) IoTarget)->IsStarted = TRUE;
+	AmtPtpHostLockRelease();
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfIoTargetStop(
+	WDFIOTARGET IoTarget,
+	WDF_IO_TARGET_SENT_IO_ACTION Action
+)
+{
+	PAMTPTP_HOST_IO_TARGET target = (PAMTPTP_HOST_IO_TARGET) IoTarget;
+
+	// Like the framework, wait for completion routines that are already running
+	AmtPtpHostLockAcquire();
+	target->IsStarted = FALSE;
+	while (Action != WdfIoTargetLeaveSentIoPending && target->InFlight != 0) {
+		pthread_cond_wait(&AmtPtpHostChanged, &AmtPtpHostLock);
+	}
+	AmtPtpHostLockRelease();
+}
+
+static NTSTATUS
+AmtPtpHostSpiStatus(
+	AMTPTP_SPI_STATUS Status
+)
+{
+	switch (Status) {
+	case AmtPtpSpiOk:
+		return STATUS_SUCCESS;
+	case AmtPtpSpiNotConnected:
+		return STATUS_DEVICE_NOT_CONNECTED;
+	default:
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+}
+
+static void
+AmtPtpHostDescribeBuffer(
+	const WDF_MEMORY_DESCRIPTOR *Descriptor,
+	void **Buffer,
+	size_t *Length
+)
+{
+	*Buffer = NULL;
+	*Length = 0;
+
+	if (Descriptor == NULL) {
+		return;
+	}
+
+	if (Descriptor->Type == WdfMemoryDescriptorTypeBuffer) {
+		*Buffer = Descriptor->u.BufferType.Buffer;
+		*Length = Descriptor->u.BufferType.Length;
+	} else if (Descriptor->Type == WdfMemoryDescriptorTypeHandle) {
+		PAMTPTP_HOST_MEMORY memory = (PAMTPTP_HOST_MEMORY) Descriptor->u.HandleType.Memory;
+
+		*Buffer = memory->Buffer;
+		*Length = memory->Length;
+	}
+}
+
+NTSTATUS
+WdfIoTargetSendInternalIoctlSynchronously(
+	WDFIOTARGET IoTarget,
+	WDFREQUEST Request,
+	ULONG IoctlCode,
+	PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	PULONG_PTR BytesReturned
+)
+{
+	PAMTPTP_HOST_IO_TARGET target = (PAMTPTP_HOST_IO_TARGET) IoTarget;
+	const AMTPTP_SPI_TARGET *spi;
+	void *input, *output;
+	size_t inputLength, outputLength;
+	ULONG_PTR information = 0;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	if (target->Device == NULL || target->Device->Binding.Spi == NULL) {
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+
+	spi = target->Device->Binding.Spi;
+	AmtPtpHostDescribeBuffer(InputBuffer, &input, &inputLength);
+	AmtPtpHostDescribeBuffer(OutputBuffer, &output, &outputLength);
+
+	pthread_mutex_lock(&AmtPtpHostBusLock);
+	switch (IoctlCode) {
+	case IOCTL_HID_GET_DEVICE_ATTRIBUTES:
+		if (output == NULL || outputLength < sizeof(HID_DEVICE_ATTRIBUTES)) {
+			status = STATUS_BUFFER_TOO_SMALL;
+		} else {
+			PHID_DEVICE_ATTRIBUTES attributes = (PHID_DEVICE_ATTRIBUTES) output;
+			uint16_t vendorId = 0, productId = 0, versionNumber = 0;
+
+			status = AmtPtpHostSpiStatus(spi->GetAttributes(spi->Context, &vendorId, &productId, &versionNumber));
+			if (NT_SUCCESS(status)) {
+				memset(attributes, 0, sizeof(*attributes));
+				attributes->Size = sizeof(*attributes);
+				attributes->VendorID = vendorId;
+				attributes->ProductID = productId;
+				attributes->VersionNumber = versionNumber;
+				information = sizeof(*attributes);
+			}
+		}
+		break;
+	case IOCTL_HID_SET_FEATURE:
+		if (input == NULL || inputLength < sizeof(HID_XFER_PACKET)) {
+			status = STATUS_BUFFER_TOO_SMALL;
+		} else {
+			const HID_XFER_PACKET *packet = (const HID_XFER_PACKET *) input;
+
+			status = AmtPtpHostSpiStatus(spi->SetFeature(spi->Context, packet->reportId,
+				packet->reportBuffer, packet->reportBufferLen));
+		}
+		break;
+	default:
+		status = STATUS_NOT_SUPPORTED;
+		break;
+	}
+	pthread_mutex_unlock(&AmtPtpHostBusLock);
+
+	if (BytesReturned != NULL) {
+		*BytesReturned = information;
+	}
+
+	return status;
+}
+
+NTSTATUS
+WdfIoTargetFormatRequestForInternalIoctl(
+	WDFIOTARGET IoTarget,
+	WDFREQUEST Request,
+	ULONG IoctlCode,
+	WDFMEMORY InputBuffer,
+	PWDFMEMORY_OFFSET InputBufferOffset,
+	WDFMEMORY OutputBuffer,
+	PWDFMEMORY_OFFSET OutputBufferOffset
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+
+	UNREFERENCED_PARAMETER(IoTarget);
+
+	// Offsets into the memory objects are not modelled
+	if (InputBufferOffset != NULL || OutputBufferOffset != NULL) {
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	request->TargetIoControlCode = IoctlCode;
+	request->TargetInput = (PAMTPTP_HOST_MEMORY) InputBuffer;
+	request->TargetOutput = (PAMTPTP_HOST_MEMORY) OutputBuffer;
+	return STATUS_SUCCESS;
+}
+
+//
+// USB targets
+//
+
+NTSTATUS
+WdfUsbTargetDeviceCreate(
+	WDFDEVICE Device,
+	PWDF_OBJECT_ATTRIBUTES Attributes,
+	WDFUSBDEVICE *UsbDevice
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_USB_DEVICE usbDevice;
+	PAMTPTP_HOST_USB_INTERFACE usbInterface;
+	PAMTPTP_HOST_USB_PIPE pipe;
+
+	if (device->Binding.Usb == NULL) {
+		return STATUS_DEVICE_NOT_CONNECTED;
+	}
+
+	usbDevice = AmtPtpHostAllocateObject(sizeof(*usbDevice), AmtPtpHostObjectUsbDevice, Attributes,
+		(PAMTPTP_HOST_OBJECT) device);
+	if (usbDevice == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	// One interface with one interrupt IN pipe, which is all the drivers use
+	usbInterface = AmtPtpHostAllocateObject(sizeof(*usbInterface), AmtPtpHostObjectUsbInterface, NULL,
+		(PAMTPTP_HOST_OBJECT) usbDevice);
+	pipe = usbInterface == NULL ? NULL : AmtPtpHostAllocateObject(sizeof(*pipe), AmtPtpHostObjectUsbPipe, NULL,
+		(PAMTPTP_HOST_OBJECT) usbInterface);
+	if (pipe == NULL) {
+		AmtPtpHostDestroyObject(&usbDevice->Header);
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	AmtPtpHostInitObject(&pipe->Target.Header, AmtPtpHostObjectIoTarget, NULL, NULL, TRUE);
+	pipe->Device = device;
+	pipe->Target.Device = device;
+	usbInterface->Pipe = pipe;
+	usbDevice->Device = device;
+	usbDevice->Interface = usbInterface;
+
+	AmtPtpHostLockAcquire();
+	device->UsbDevice = usbDevice;
+	AmtPtpHostLockRelease();
+
+	*UsbDevice = (WDFUSBDEVICE) usbDevice;
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfUsbTargetDeviceGetDeviceDescriptor(
+	WDFUSBDEVICE UsbDevice,
+	PUSB_DEVICE_DESCRIPTOR UsbDeviceDescriptor
+)
+{
+	*UsbDeviceDescriptor = ((PAMTPTP_HOST_USB_DEVICE) UsbDevice)->Device->Binding.DeviceDescriptor;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceRetrieveInformation(
+	WDFUSBDEVICE UsbDevice,
+	PWDF_USB_DEVICE_INFORMATION Information
+)
+{
+	Information->Traits = ((PAMTPTP_HOST_USB_DEVICE) UsbDevice)->Device->Binding.UsbTraits;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceSelectConfig(
+	WDFUSBDEVICE UsbDevice,
+	PWDF_OBJECT_ATTRIBUTES PipeAttributes,
+	PWDF_USB_DEVICE_SELECT_CONFIG_PARAMS Params
+)
+{
+	UNREFERENCED_PARAMETER(PipeAttributes);
+
+	if (Params->Type != WdfUsbTargetDeviceSelectConfigTypeSingleInterface) {
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	Params->Types.SingleInterface.ConfiguredUsbInterface = (WDFUSBINTERFACE) ((PAMTPTP_HOST_USB_DEVICE) UsbDevice)->Interface;
+	Params->Types.SingleInterface.NumberConfiguredPipes = 1;
+	return STATUS_SUCCESS;
+}
+
+WDFUSBINTERFACE
+WdfUsbTargetDeviceGetInterface(
+	WDFUSBDEVICE UsbDevice,
+	UCHAR InterfaceIndex
+)
+{
+	return InterfaceIndex == 0 ? (WDFUSBINTERFACE) ((PAMTPTP_HOST_USB_DEVICE) UsbDevice)->Interface : NULL;
+}
+
+BYTE
+WdfUsbInterfaceGetNumConfiguredPipes(
+	WDFUSBINTERFACE UsbInterface
+)
+{
+	UNREFERENCED_PARAMETER(UsbInterface);
+
+	return 1;
+}
+
+WDFUSBPIPE
+WdfUsbInterfaceGetConfiguredPipe(
+	WDFUSBINTERFACE UsbInterface,
+	UCHAR PipeIndex,
+	PWDF_USB_PIPE_INFORMATION PipeInfo
+)
+{
+	if (PipeIndex != 0) {
+		return NULL;
+	}
+
+	if (PipeInfo != NULL) {
+		PipeInfo->PipeType = WdfUsbPipeTypeInterrupt;
+		PipeInfo->EndpointAddress = 0x81;
+		PipeInfo->MaximumPacketSize = 64;
+		PipeInfo->MaximumTransferSize = 4096;
+		PipeInfo->Interval = 1;
+	}
+
+	return (WDFUSBPIPE) ((PAMTPTP_HOST_USB_INTERFACE) UsbInterface)->Pipe;
+}
+
+VOID
+WdfUsbTargetPipeSetNoMaximumPacketSizeCheck(
+	WDFUSBPIPE Pipe
+)
+{
+	UNREFERENCED_PARAMETER(Pipe);
+}
+
+WDFIOTARGET
+WdfUsbTargetPipeGetIoTarget(
+	WDFUSBPIPE Pipe
+)
+{
+	return (WDFIOTARGET) &((PAMTPTP_HOST_USB_PIPE) Pipe)->Target;
+}
+
+NTSTATUS
+WdfUsbTargetPipeConfigContinuousReader(
+	WDFUSBPIPE Pipe,
+	PWDF_USB_CONTINUOUS_READER_CONFIG Config
+)
+{
+	PAMTPTP_HOST_USB_PIPE pipe = (PAMTPTP_HOST_USB_PIPE) Pipe;
+
+	if (Config->TransferLength == 0 || Config->EvtUsbTargetPipeReadComplete == NULL) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	pipe->Reader = *Config;
+	pipe->HasReader = TRUE;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceSendControlTransferSynchronously(
+	WDFUSBDEVICE UsbDevice,
+	WDFREQUEST Request,
+	PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	PWDF_USB_CONTROL_SETUP_PACKET SetupPacket,
+	PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+	PULONG BytesTransferred
+)
+{
+	const AMTPTP_USB_TRANSPORT *transport = ((PAMTPTP_HOST_USB_DEVICE) UsbDevice)->Device->Binding.Usb;
+	AMTPTP_USB_STATUS usbStatus;
+	uint32_t transferred = 0;
+	void *buffer;
+	size_t length;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	AmtPtpHostDescribeBuffer(MemoryDescriptor, &buffer, &length);
+
+	pthread_mutex_lock(&AmtPtpHostBusLock);
+	if (SetupPacket->Packet.bm.Request.Dir == BmRequestDeviceToHost) {
+		usbStatus = transport->ControlIn(transport->Context, SetupPacket->Packet.bRequest,
+			SetupPacket->Packet.wValue.Value, SetupPacket->Packet.wIndex.Value,
+			(uint8_t *) buffer, (uint32_t) length, &transferred);
+	} else {
+		usbStatus = transport->ControlOut(transport->Context, SetupPacket->Packet.bRequest,
+			SetupPacket->Packet.wValue.Value, SetupPacket->Packet.wIndex.Value,
+			(const uint8_t *) buffer, (uint32_t) length);
+		transferred = (uint32_t) length;
+	}
+	pthread_mutex_unlock(&AmtPtpHostBusLock);
+
+	if (BytesTransferred != NULL) {
+		*BytesTransferred = usbStatus == AmtPtpUsbOk ? transferred : 0;
+	}
+
+	return usbStatus == AmtPtpUsbOk ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceAllocAndQueryString(
+	WDFUSBDEVICE UsbDevice,
+	PWDF_OBJECT_ATTRIBUTES StringMemoryAttributes,
+	WDFMEMORY *StringMemory,
+	PUSHORT NumCharacters,
+	UCHAR StringIndex,
+	USHORT LangID
+)
+{
+	// The simulated devices carry no string descriptors
+	UNREFERENCED_PARAMETER(UsbDevice);
+	UNREFERENCED_PARAMETER(StringMemoryAttributes);
+	UNREFERENCED_PARAMETER(StringMemory);
+	UNREFERENCED_PARAMETER(NumCharacters);
+	UNREFERENCED_PARAMETER(StringIndex);
+	UNREFERENCED_PARAMETER(LangID);
+
+	return STATUS_NOT_SUPPORTED;
+}
+
+//
+// Harness: driver and device lifetime
+//
+
+void
+AmtPtpHostInitUsbBinding(
+	PAMTPTP_HOST_BINDING Binding,
+	const AMTPTP_USB_TRANSPORT *Transport,
+	USHORT VendorId,
+	USHORT ProductId
+)
+{
+	memset(Binding, 0, sizeof(*Binding));
+	Binding->Usb = Transport;
+	Binding->DeviceDescriptor.bLength = sizeof(USB_DEVICE_DESCRIPTOR);
+	Binding->DeviceDescriptor.bDescriptorType = 1;
+	Binding->DeviceDescriptor.bcdUSB = 0x0200;
+	Binding->DeviceDescriptor.bMaxPacketSize0 = 64;
+	Binding->DeviceDescriptor.idVendor = VendorId;
+	Binding->DeviceDescriptor.idProduct = ProductId;
+	Binding->DeviceDescriptor.bNumConfigurations = 1;
+	Binding->UsbTraits = WDF_USB_DEVICE_TRAIT_AT_HIGH_SPEED;
+}
+
+void
+AmtPtpHostInitSpiBinding(
+	PAMTPTP_HOST_BINDING Binding,
+	const AMTPTP_SPI_TARGET *Target
+)
+{
+	memset(Binding, 0, sizeof(*Binding));
+	Binding->Spi = Target;
+}
+
+NTSTATUS
+AmtPtpHostLoadDriver(
+	PDRIVER_INITIALIZE DriverEntry,
+	WDFDRIVER *Driver
+)
+{
+	static WCHAR registryPath[] = L"\\Registry\\Machine\\System\\CurrentControlSet\\Services\\AmtPtpDevice";
+	UNICODE_STRING path;
+	PDRIVER_OBJECT driverObject;
+	NTSTATUS status;
+
+	driverObject = calloc(1, sizeof(*driverObject));
+	if (driverObject == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	path.Buffer = registryPath;
+	path.Length = (USHORT) (sizeof(registryPath) - sizeof(WCHAR));
+	path.MaximumLength = (USHORT) sizeof(registryPath);
+
+	status = DriverEntry(driverObject, &path);
+	if (NT_SUCCESS(status) && driverObject->Driver == NULL) {
+		status = STATUS_UNSUCCESSFUL;
+	}
+
+	if (!NT_SUCCESS(status)) {
+		if (driverObject->Driver != NULL) {
+			AmtPtpHostDestroyObject(&driverObject->Driver->Header);
+		}
+		free(driverObject);
+		return status;
+	}
+
+	*Driver = (WDFDRIVER) driverObject->Driver;
+	return STATUS_SUCCESS;
+}
+
+void
+AmtPtpHostUnloadDriver(
+	WDFDRIVER Driver
+)
+{
+	PAMTPTP_HOST_DRIVER driver = (PAMTPTP_HOST_DRIVER) Driver;
+	PDRIVER_OBJECT driverObject = driver->DriverObject;
+
+	if (driver->Config.EvtDriverUnload != NULL) {
+		driver->Config.EvtDriverUnload(Driver);
+	}
+
+	AmtPtpHostDestroyObject(&driver->Header);
+	free(driverObject);
+}
+
+NTSTATUS
+AmtPtpHostAddDevice(
+	WDFDRIVER Driver,
+	const AMTPTP_HOST_BINDING *Binding,
+	WDFDEVICE *Device
+)
+{
+	PAMTPTP_HOST_DRIVER driver = (PAMTPTP_HOST_DRIVER) Driver;
+	WDFDEVICE_INIT init;
+	NTSTATUS status;
+
+	memset(&init, 0, sizeof(init));
+	init.Driver = driver;
+	init.Binding = Binding;
+
+	status = driver->Config.EvtDriverDeviceAdd(Driver, &init);
+	if (NT_SUCCESS(status) && init.Created == NULL) {
+		status = STATUS_UNSUCCESSFUL;
+	}
+
+	if (!NT_SUCCESS(status)) {
+		if (init.Created != NULL) {
+			AmtPtpHostDestroyObject(&init.Created->Header);
+		}
+		return status;
+	}
+
+	*Device = (WDFDEVICE) init.Created;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+AmtPtpHostPrepareHardware(
+	WDFDEVICE Device
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+
+	if (device->PnpPowerCallbacks.EvtDevicePrepareHardware == NULL) {
+		return STATUS_SUCCESS;
+	}
+
+	return device->PnpPowerCallbacks.EvtDevicePrepareHardware(Device, NULL, NULL);
+}
+
+NTSTATUS
+AmtPtpHostD0Entry(
+	WDFDEVICE Device,
+	WDF_POWER_DEVICE_STATE PreviousState
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_QUEUE queue;
+	PAMTPTP_HOST_REQUEST request;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (device->PnpPowerCallbacks.EvtDeviceD0Entry != NULL) {
+		status = device->PnpPowerCallbacks.EvtDeviceD0Entry(Device, PreviousState);
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+	}
+
+	// The local I/O target restarts with the device, so reads left pending
+	// at D0 exit complete only once the driver is back in D0
+	AmtPtpHostLockAcquire();
+	device->IsInD0 = TRUE;
+	device->LowerTarget.IsStarted = TRUE;
+	AmtPtpHostLockRelease();
+
+	// Requests that arrived while the device was powered down
+	for (queue = device->Queues; queue != NULL; queue = queue->NextQueue) {
+		if (!queue->IsPowerManaged || queue->Config.DispatchType == WdfIoQueueDispatchManual) {
+			continue;
+		}
+
+		for (;;) {
+			AmtPtpHostLockAcquire();
+			request = device->IsInD0 ? AmtPtpHostDequeue(queue) : NULL;
+			if (request != NULL) {
+				request->Queue = queue;
+				request->References++;
+			}
+			AmtPtpHostLockRelease();
+
+			if (request == NULL) {
+				break;
+			}
+
+			AmtPtpHostDispatch(queue, request);
+			AmtPtpHostDereferenceRequest(request);
+		}
+	}
+
+	return status;
+}
+
+// Caller holds the lock
+static BOOLEAN
+AmtPtpHostOwnsPowerManaged(
+	PAMTPTP_HOST_DEVICE Device
+)
+{
+	PAMTPTP_HOST_REQUEST request;
+
+	for (request = Device->ClientRequests; request != NULL; request = request->ClientNext) {
+		if (request->State == AmtPtpHostRequestOwned && request->Queue != NULL && request->Queue->IsPowerManaged) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+NTSTATUS
+AmtPtpHostD0Exit(
+	WDFDEVICE Device,
+	WDF_POWER_DEVICE_STATE TargetState
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_REQUEST request, *owned = NULL;
+	size_t count = 0, i;
+	BOOLEAN isOwned;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	AmtPtpHostLockAcquire();
+	device->IsInD0 = FALSE;
+
+	for (request = device->ClientRequests; request != NULL; request = request->ClientNext) {
+		count++;
+	}
+
+	owned = count ? malloc(count * sizeof(*owned)) : NULL;
+	count = 0;
+	for (request = owned ? device->ClientRequests : NULL; request != NULL; request = request->ClientNext) {
+		if (request->State == AmtPtpHostRequestOwned && request->Queue != NULL &&
+			request->Queue->IsPowerManaged && request->Queue->Config.EvtIoStop != NULL) {
+			request->References++;
+			owned[count++] = request;
+		}
+	}
+	AmtPtpHostLockRelease();
+
+	for (i = 0; i < count; i++) {
+		request = owned[i];
+
+		// The driver may have completed or parked it since the snapshot
+		AmtPtpHostLockAcquire();
+		isOwned = request->State == AmtPtpHostRequestOwned && request->Queue->IsPowerManaged;
+		AmtPtpHostLockRelease();
+
+		if (isOwned) {
+			request->Queue->Config.EvtIoStop((WDFQUEUE) request->Queue, (WDFREQUEST) request,
+				WdfRequestStopActionSuspend);
+		}
+		AmtPtpHostDereferenceRequest(request);
+	}
+	free(owned);
+
+	// None of the drivers acknowledges a stop, so like the framework wait until
+	// they have completed or forwarded every request a stopped queue gave them
+	AmtPtpHostLockAcquire();
+	while (AmtPtpHostOwnsPowerManaged(device)) {
+		pthread_cond_wait(&AmtPtpHostChanged, &AmtPtpHostLock);
+	}
+	AmtPtpHostLockRelease();
+
+	if (device->PnpPowerCallbacks.EvtDeviceD0Exit != NULL) {
+		status = device->PnpPowerCallbacks.EvtDeviceD0Exit(Device, TargetState);
+	}
+
+	// Then the local I/O target stops. Reads sent to it stay pending; the
+	// completions already running finish first.
+	AmtPtpHostLockAcquire();
+	device->LowerTarget.IsStarted = FALSE;
+	while (device->LowerTarget.InFlight != 0) {
+		pthread_cond_wait(&AmtPtpHostChanged, &AmtPtpHostLock);
+	}
+	AmtPtpHostLockRelease();
+
+	return status;
+}
+
+void
+AmtPtpHostRemoveDevice(
+	WDFDEVICE Device
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_QUEUE queue;
+	PAMTPTP_HOST_REQUEST request;
+
+	// The lower target and then the queues are purged before the device goes
+	AmtPtpHostSpiCancelReads(Device);
+
+	for (queue = device->Queues; queue != NULL; queue = queue->NextQueue) {
+		for (;;) {
+			AmtPtpHostLockAcquire();
+			request = AmtPtpHostDequeue(queue);
+			AmtPtpHostLockRelease();
+
+			if (request == NULL) {
+				break;
+			}
+			WdfRequestComplete((WDFREQUEST) request, STATUS_CANCELLED);
+		}
+	}
+
+	AmtPtpHostLockAcquire();
+	for (request = device->ClientRequests; request != NULL; request = request->ClientNext) {
+		if (request->State != AmtPtpHostRequestCompleted && request->State != AmtPtpHostRequestCreated) {
+			AmtPtpHostLockRelease();
+			AmtPtpHostFail("device removed while the driver still owns a request", request);
+		}
+	}
+	AmtPtpHostLockRelease();
+
+	if (device->PnpPowerCallbacks.EvtDeviceReleaseHardware != NULL) {
+		device->PnpPowerCallbacks.EvtDeviceReleaseHardware(Device, NULL);
+	}
+
+	// Client requests outlive the device until the caller releases them
+	AmtPtpHostLockAcquire();
+	while ((request = device->ClientRequests) != NULL) {
+		device->ClientRequests = request->ClientNext;
+		request->ClientNext = NULL;
+		request->Device = NULL;
+	}
+	AmtPtpHostLockRelease();
+
+	AmtPtpHostDestroyObject(&device->Header);
+}
+
+//
+// Harness: client requests
+//
+
+NTSTATUS
+AmtPtpHostCreateRequest(
+	WDFDEVICE Device,
+	ULONG IoControlCode,
+	PVOID InputBuffer,
+	size_t InputBufferLength,
+	PVOID OutputBuffer,
+	size_t OutputBufferLength,
+	PVOID UserBuffer,
+	WDFREQUEST *Request
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_REQUEST request;
+
+	request = AmtPtpHostAllocateObject(sizeof(*request), AmtPtpHostObjectRequest, NULL, NULL);
+	if (request == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	request->Device = device;
+	request->IsClient = TRUE;
+	request->References = 1;
+	request->State = AmtPtpHostRequestCreated;
+	request->Irp.UserBuffer = UserBuffer;
+
+	AmtPtpHostInitObject(&request->InputMemory.Header, AmtPtpHostObjectMemory, NULL, NULL, TRUE);
+	request->InputMemory.Buffer = InputBuffer;
+	request->InputMemory.Length = InputBufferLength;
+	AmtPtpHostInitObject(&request->OutputMemory.Header, AmtPtpHostObjectMemory, NULL, NULL, TRUE);
+	request->OutputMemory.Buffer = OutputBuffer;
+	request->OutputMemory.Length = OutputBufferLength;
+
+	WDF_REQUEST_PARAMETERS_INIT(&request->Parameters);
+	request->Parameters.Type = WdfRequestTypeDeviceControlInternal;
+	request->Parameters.Parameters.DeviceIoControl.IoControlCode = IoControlCode;
+	request->Parameters.Parameters.DeviceIoControl.InputBufferLength = InputBufferLength;
+	request->Parameters.Parameters.DeviceIoControl.OutputBufferLength = OutputBufferLength;
+
+	AmtPtpHostLockAcquire();
+	request->ClientNext = device->ClientRequests;
+	device->ClientRequests = request;
+	AmtPtpHostLockRelease();
+
+	*Request = (WDFREQUEST) request;
+	return STATUS_SUCCESS;
+}
+
+void
+AmtPtpHostSendRequest(
+	WDFREQUEST Request
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+	PAMTPTP_HOST_QUEUE queue;
+
+	AmtPtpHostLockAcquire();
+	if (request->State != AmtPtpHostRequestCreated) {
+		AmtPtpHostLockRelease();
+		AmtPtpHostFail("request sent twice", request);
+	}
+
+	queue = request->Device->DefaultQueue;
+	if (queue == NULL) {
+		request->State = AmtPtpHostRequestCompleted;
+		request->Status = STATUS_INVALID_DEVICE_REQUEST;
+		AmtPtpHostLockRelease();
+		return;
+	}
+
+	if (queue->IsPowerManaged && !request->Device->IsInD0) {
+		AmtPtpHostEnqueue(queue, request);
+		AmtPtpHostLockRelease();
+		return;
+	}
+
+	request->State = AmtPtpHostRequestOwned;
+	request->Queue = queue;
+	request->References++;
+	AmtPtpHostLockRelease();
+
+	AmtPtpHostDispatch(queue, request);
+	AmtPtpHostDereferenceRequest(request);
+}
+
+BOOLEAN
+AmtPtpHostIsRequestCompleted(
+	WDFREQUEST Request,
+	NTSTATUS *Status,
+	ULONG_PTR *Information
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+	BOOLEAN isCompleted;
+
+	AmtPtpHostLockAcquire();
+	isCompleted = request->State == AmtPtpHostRequestCompleted;
+	if (isCompleted) {
+		if (Status != NULL) *Status = request->Status;
+		if (Information != NULL) *Information = request->Information;
+	}
+	AmtPtpHostLockRelease();
+
+	return isCompleted;
+}
+
+NTSTATUS
+AmtPtpHostWaitRequest(
+	WDFREQUEST Request,
+	ULONG_PTR *Information
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+	NTSTATUS status;
+
+	AmtPtpHostLockAcquire();
+	while (request->State != AmtPtpHostRequestCompleted) {
+		pthread_cond_wait(&AmtPtpHostChanged, &AmtPtpHostLock);
+	}
+	status = request->Status;
+	if (Information != NULL) {
+		*Information = request->Information;
+	}
+	AmtPtpHostLockRelease();
+
+	return status;
+}
+
+void
+AmtPtpHostReleaseRequest(
+	WDFREQUEST Request
+)
+{
+	PAMTPTP_HOST_REQUEST request = (PAMTPTP_HOST_REQUEST) Request;
+	AMTPTP_HOST_REQUEST_STATE state;
+
+	AmtPtpHostLockAcquire();
+	state = request->State;
+	AmtPtpHostLockRelease();
+
+	if (state != AmtPtpHostRequestCompleted && state != AmtPtpHostRequestCreated) {
+		AmtPtpHostFail("released a request that is still pending", request);
+	}
+
+	AmtPtpHostDereferenceRequest(request);
+}
+
+//
+// Harness: lower edge
+//
+
+static PAMTPTP_HOST_USB_PIPE
+AmtPtpHostGetReaderPipe(
+	PAMTPTP_HOST_DEVICE Device
+)
+{
+	PAMTPTP_HOST_USB_PIPE pipe = NULL;
+
+	AmtPtpHostLockAcquire();
+	if (Device->UsbDevice != NULL && Device->UsbDevice->Interface->Pipe->HasReader) {
+		pipe = Device->UsbDevice->Interface->Pipe;
+	}
+	AmtPtpHostLockRelease();
+
+	return pipe;
+}
+
+// Takes an in-flight slot on the pipe target unless it is stopped
+static BOOLEAN
+AmtPtpHostBeginRead(
+	PAMTPTP_HOST_IO_TARGET Target
+)
+{
+	BOOLEAN isStarted;
+
+	AmtPtpHostLockAcquire();
+	isStarted = Target->IsStarted;
+	if (isStarted) {
+		Target->InFlight++;
+	}
+	AmtPtpHostLockRelease();
+
+	return isStarted;
+}
+
+static void
+AmtPtpHostEndRead(
+	PAMTPTP_HOST_IO_TARGET Target
+)
+{
+	AmtPtpHostLockAcquire();
+	Target->InFlight--;
+	pthread_cond_broadcast(&AmtPtpHostChanged);
+	AmtPtpHostLockRelease();
+}
+
+static void
+AmtPtpHostCompleteRead(
+	PAMTPTP_HOST_USB_PIPE Pipe,
+	void *Buffer,
+	size_t Transferred
+)
+{
+	AMTPTP_HOST_MEMORY memory;
+
+	memset(&memory, 0, sizeof(memory));
+	AmtPtpHostInitObject(&memory.Header, AmtPtpHostObjectMemory, NULL, NULL, TRUE);
+	memory.Buffer = Buffer;
+	memory.Length = Pipe->Reader.TransferLength;
+
+	Pipe->Reader.EvtUsbTargetPipeReadComplete((WDFUSBPIPE) Pipe, (WDFMEMORY) &memory, Transferred,
+		Pipe->Reader.EvtUsbTargetPipeReadCompleteContext);
+}
+
+NTSTATUS
+AmtPtpHostUsbReadPipe(
+	WDFDEVICE Device
+)
+{
+	PAMTPTP_HOST_DEVICE device = (PAMTPTP_HOST_DEVICE) Device;
+	PAMTPTP_HOST_USB_PIPE pipe = AmtPtpHostGetReaderPipe(device);
+	const AMTPTP_USB_TRANSPORT *transport = device->Binding.Usb;
+	AMTPTP_USB_STATUS usbStatus;
+	uint32_t transferred = 0;
+	UCHAR *buffer;
+	NTSTATUS status;
+
+	if (pipe == NULL) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	buffer = malloc(pipe->Reader.TransferLength);
+	if (buffer == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	if (!AmtPtpHostBeginRead(&pipe->Target)) {
+		free(buffer);
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	pthread_mutex_lock(&AmtPtpHostBusLock);
+	usbStatus = transport->ReadInterrupt(transport->Context, buffer, (uint32_t) pipe->Reader.TransferLength,
+		&transferred);
+	pthread_mutex_unlock(&AmtPtpHostBusLock);
+
+	switch (usbStatus) {
+	case AmtPtpUsbOk:
+		AmtPtpHostCompleteRead(pipe, buffer, transferred);
+		status = STATUS_SUCCESS;
+		break;
+	case AmtPtpUsbNoData:
+		status = STATUS_NO_MORE_ENTRIES;
+		break;
+	default:
+		if (pipe->Reader.EvtUsbTargetPipeReadersFailed != NULL) {
+			pipe->Reader.EvtUsbTargetPipeReadersFailed((WDFUSBPIPE) pipe, STATUS_UNSUCCESSFUL,
+				AMTPTP_HOST_USBD_STALL);
+		}
+		status = STATUS_UNSUCCESSFUL;
+		break;
+	}
+
+	AmtPtpHostEndRead(&pipe->Target);
+	free(buffer);
+	return status;
+}
+
+NTSTATUS
+AmtPtpHostUsbDeliver(
+	WDFDEVICE Device,
+	const void *Buffer,
+	size_t Length
+)
+{
+	PAMTPTP_HOST_USB_PIPE pipe = AmtPtpHostGetReaderPipe((PAMTPTP_HOST_DEVICE) Device);
+	UCHAR *buffer;
+
+	if (pipe == NULL) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+	if (Length > pipe->Reader.TransferLength) {
+		return STATUS_INVALID_BUFFER_SIZE;
+	}
+
+	buffer = calloc(1, pipe->Reader.TransferLength);
+	if (buffer == NULL) {
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+	memcpy(buffer, Buffer, Length);
+
+	if (!AmtPtpHostBeginRead(&pipe->Target)) {
+		free(buffer);
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	AmtPtpHostCompleteRead(pipe, buffer, Length);
+	AmtPtpHostEndRead(&pipe->Target);
+	free(buffer);
+	return STATUS_SUCCESS;
+}
+
+static BOOLEAN
+AmtPtpHostSpiCompleteOne(
+	PAMTPTP_HOST_DEVICE Device,
+	BOOLEAN Cancel
+)
+{
+	PAMTPTP_HOST_IO_TARGET target = &Device->LowerTarget;
+	const AMTPTP_SPI_TARGET *spi = Device->Binding.Spi;
+	WDF_REQUEST_COMPLETION_PARAMS params;
+	PAMTPTP_HOST_REQUEST request;
+	PAMTPTP_HOST_MEMORY output;
+	uint32_t transferred = 0;
+	NTSTATUS status;
+
+	// A stopped target only gives up its reads to be cancelled
+	AmtPtpHostLockAcquire();
+	request = Cancel || target->IsStarted ? target->PendingHead : NULL;
+	if (request != NULL) {
+		target->PendingHead = request->TargetNext;
+		if (target->PendingHead == NULL) {
+			target->PendingTail = NULL;
+		}
+		target->PendingCount--;
+		target->InFlight++;
+	}
+	AmtPtpHostLockRelease();
+
+	if (request == NULL) {
+		return FALSE;
+	}
+
+	output = request->TargetOutput;
+	if (Cancel) {
+		status = STATUS_CANCELLED;
+	} else {
+		pthread_mutex_lock(&AmtPtpHostBusLock);
+		status = AmtPtpHostSpiStatus(spi->ReadReport(spi->Context, (uint8_t *) output->Buffer,
+			(uint32_t) output->Length, &transferred));
+		pthread_mutex_unlock(&AmtPtpHostBusLock);
+		if (!NT_SUCCESS(status)) {
+			transferred = 0;
+		}
+	}
+
+	AmtPtpHostLockAcquire();
+	request->State = AmtPtpHostRequestCompleted;
+	request->Status = status;
+	request->Information = transferred;
+	AmtPtpHostLockRelease();
+
+	memset(&params, 0, sizeof(params));
+	params.Size = sizeof(params);
+	params.Type = WdfRequestTypeDeviceControlInternal;
+	params.IoStatus.Status = status;
+	params.IoStatus.Information = transferred;
+	params.Parameters.Ioctl.IoControlCode = request->TargetIoControlCode;
+	params.Parameters.Ioctl.Input.Buffer = (WDFMEMORY) request->TargetInput;
+	params.Parameters.Ioctl.Output.Buffer = (WDFMEMORY) output;
+	params.Parameters.Ioctl.Output.Length = transferred;
+
+	if (request->CompletionRoutine != NULL) {
+		request->CompletionRoutine((WDFREQUEST) request, (WDFIOTARGET) target, &params, request->CompletionContext);
+	}
+
+	AmtPtpHostDereferenceRequest(request);
+
+	AmtPtpHostLockAcquire();
+	target->InFlight--;
+	pthread_cond_broadcast(&AmtPtpHostChanged);
+	AmtPtpHostLockRelease();
+
+	return TRUE;
+}
+
+ULONG
+AmtPtpHostSpiCompleteReads(
+	WDFDEVICE Device,
+	ULONG Max
+)
+{
+	ULONG completed = 0;
+
+	while (completed < Max && AmtPtpHostSpiCompleteOne((PAMTPTP_HOST_DEVICE) Device, FALSE)) {
+		completed++;
+	}
+
+	return completed;
+}
+
+ULONG
+AmtPtpHostSpiCancelReads(
+	WDFDEVICE Device
+)
+{
+	ULONG cancelled = 0;
+
+	while (AmtPtpHostSpiCompleteOne((PAMTPTP_HOST_DEVICE) Device, TRUE)) {
+		cancelled++;
+	}
+
+	return cancelled;
+}
+
+ULONG
+AmtPtpHostSpiPendingReads(
+	WDFDEVICE Device
+)
+{
+	ULONG count;
+
+	AmtPtpHostLockAcquire();
+	count = ((PAMTPTP_HOST_DEVICE) Device)->LowerTarget.PendingCount;
+	AmtPtpHostLockRelease();
+
+	return count;
+}
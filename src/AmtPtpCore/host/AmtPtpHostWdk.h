@@ -0,0 +1,1274 @@
+// AmtPtpHostWdk.h: The subset of the WDK the drivers compile against on the host
+//
+// windows.h, ntddk.h, wdf.h, wdfusb.h, hidport.h and the other stand-in headers
+// in this directory all resolve here, so UsbUm, UsbKm and SpiKm sources build
+// unmodified into host binaries. Types keep their Windows widths (ULONG and
+// LONG are 32 bits on LP64 too), structures carry the fields the drivers touch,
+// and every framework call is implemented by AmtPtpHostWdf.c on top of the
+// simulated targets. Use AmtPtpHost.h to drive a device from a test.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "AmtPtpCore.h"
+#include "AmtPtpSpi.h"
+#include "AmtPtpUsb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Base types
+//
+
+#define VOID void
+#define CONST const
+#define TRUE 1
+#define FALSE 0
+
+typedef char CHAR, *PCHAR;
+typedef const char *PCSTR;
+typedef int8_t INT8;
+typedef uint8_t UCHAR, *PUCHAR, BYTE, *PBYTE, UINT8, BOOLEAN, *PBOOLEAN;
+typedef int16_t SHORT, *PSHORT;
+typedef uint16_t USHORT, *PUSHORT, WORD, UINT16;
+typedef int32_t LONG, *PLONG, INT32, NTSTATUS, USBD_STATUS;
+typedef uint32_t ULONG, *PULONG, DWORD, UINT32, ACCESS_MASK;
+typedef int BOOL, INT;
+typedef unsigned int UINT;
+typedef int64_t LONGLONG, INT64;
+typedef uint64_t ULONGLONG, UINT64;
+typedef uintptr_t ULONG_PTR, *PULONG_PTR;
+typedef size_t SIZE_T;
+typedef wchar_t WCHAR, *PWCH, *PWCHAR, *PWSTR;
+typedef const wchar_t *PCWSTR;
+typedef void *PVOID, *HANDLE;
+
+typedef union _LARGE_INTEGER {
+	struct {
+		ULONG LowPart;
+		LONG HighPart;
+	} u;
+	LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef struct _UNICODE_STRING {
+	USHORT Length;
+	USHORT MaximumLength;
+	PWCH Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+typedef const UNICODE_STRING *PCUNICODE_STRING;
+
+#define DECLARE_CONST_UNICODE_STRING(_var, _string) \
+	const UNICODE_STRING _var = { \
+		(USHORT) (sizeof(_string) - sizeof(WCHAR)), (USHORT) sizeof(_string), (PWCH) (_string) }
+
+typedef struct _GUID {
+	ULONG Data1;
+	USHORT Data2;
+	USHORT Data3;
+	UCHAR Data4[8];
+} GUID;
+
+// Every translation unit that includes initguid.h defines its own copy
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+	static const GUID name __attribute__((unused)) = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+//
+// Compiler and annotation macros
+//
+
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _IRQL_requires_(Irql)
+#define _IRQL_requires_max_(Irql)
+#define _Must_inspect_result_
+#define _Use_decl_annotations_
+
+#define EXTERN_C_START
+#define EXTERN_C_END
+
+#define AMTPTP_HOST_DECLSPEC_align(n) __attribute__((aligned(n)))
+#define __declspec(x) AMTPTP_HOST_DECLSPEC_##x
+
+#define C_ASSERT(e) _Static_assert(e, #e)
+#define UNREFERENCED_PARAMETER(P) ((void) (P))
+#define PAGED_CODE() ((void) 0)
+
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+
+#define KdPrintEx(_x_) ((void) 0)
+#define DPFLTR_IHVDRIVER_ID 77
+#define DPFLTR_INFO_LEVEL 3
+
+//
+// Status codes
+//
+
+#define NT_SUCCESS(Status) (((NTSTATUS) (Status)) >= 0)
+
+#define STATUS_SUCCESS					((NTSTATUS) 0x00000000L)
+#define STATUS_PENDING					((NTSTATUS) 0x00000103L)
+#define STATUS_NO_MORE_ENTRIES			((NTSTATUS) 0x8000001AL)
+#define STATUS_UNSUCCESSFUL				((NTSTATUS) 0xC0000001L)
+#define STATUS_INVALID_PARAMETER		((NTSTATUS) 0xC000000DL)
+#define STATUS_INVALID_DEVICE_REQUEST	((NTSTATUS) 0xC0000010L)
+#define STATUS_BUFFER_TOO_SMALL			((NTSTATUS) 0xC0000023L)
+#define STATUS_OBJECT_NAME_NOT_FOUND	((NTSTATUS) 0xC0000034L)
+#define STATUS_UNKNOWN_REVISION			((NTSTATUS) 0xC0000058L)
+#define STATUS_INSUFFICIENT_RESOURCES	((NTSTATUS) 0xC000009AL)
+#define STATUS_DEVICE_DATA_ERROR		((NTSTATUS) 0xC000009CL)
+#define STATUS_DEVICE_NOT_CONNECTED		((NTSTATUS) 0xC000009DL)
+#define STATUS_NOT_SUPPORTED			((NTSTATUS) 0xC00000BBL)
+#define STATUS_CANCELLED				((NTSTATUS) 0xC0000120L)
+#define STATUS_INVALID_DEVICE_STATE		((NTSTATUS) 0xC0000184L)
+#define STATUS_INVALID_BUFFER_SIZE		((NTSTATUS) 0xC0000206L)
+#define STATUS_NOT_FOUND				((NTSTATUS) 0xC0000225L)
+
+//
+// Kernel and Win32 services
+//
+
+typedef struct _DRIVER_OBJECT DRIVER_OBJECT, *PDRIVER_OBJECT;
+
+typedef NTSTATUS
+DRIVER_INITIALIZE(
+	PDRIVER_OBJECT DriverObject,
+	PUNICODE_STRING RegistryPath
+);
+typedef DRIVER_INITIALIZE *PDRIVER_INITIALIZE;
+
+typedef enum _POOL_TYPE {
+	NonPagedPool = 0,
+	PagedPool = 1,
+	NonPagedPoolNx = 512
+} POOL_TYPE;
+
+#define KEY_READ 0x20019
+
+typedef struct _IO_STATUS_BLOCK {
+	NTSTATUS Status;
+	ULONG_PTR Information;
+} IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
+
+// Only UserBuffer is used: HIDCLASS passes HID_XFER_PACKET there for feature requests
+typedef struct _IRP {
+	PVOID UserBuffer;
+	IO_STATUS_BLOCK IoStatus;
+} IRP, *PIRP;
+
+// Both counters run on the virtual clock of AmtPtpHost.h
+LARGE_INTEGER
+KeQueryPerformanceCounter(
+	PLARGE_INTEGER PerformanceFrequency
+);
+
+BOOL
+QueryPerformanceCounter(
+	LARGE_INTEGER *PerformanceCount
+);
+
+static inline LONG
+InterlockedCompareExchange(
+	volatile LONG *Destination,
+	LONG Exchange,
+	LONG Comparand
+)
+{
+	__atomic_compare_exchange_n(Destination, &Comparand, Exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return Comparand;
+}
+
+static inline LONG
+InterlockedExchange(
+	volatile LONG *Target,
+	LONG Value
+)
+{
+	return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+ReadAcquire(
+	const volatile LONG *Source
+)
+{
+	return __atomic_load_n(Source, __ATOMIC_ACQUIRE);
+}
+
+//
+// WPP and TraceLogging
+//
+// The drivers' Trace.h files declare WPP_CONTROL_GUIDS; the generated .tmh
+// files turn their bits into enumerators. Events are counted per level.
+//
+
+#define TRACE_LEVEL_NONE		0
+#define TRACE_LEVEL_CRITICAL	1
+#define TRACE_LEVEL_ERROR		2
+#define TRACE_LEVEL_WARNING		3
+#define TRACE_LEVEL_INFORMATION	4
+#define TRACE_LEVEL_VERBOSE		5
+
+#define WPP_INIT_TRACING(...) ((void) 0)
+#define WPP_CLEANUP(...) ((void) 0)
+
+void
+AmtPtpHostTraceEvents(
+	ULONG Level,
+	ULONG Flags,
+	const char *Format,
+	...
+);
+
+#define TraceEvents(Level, Flags, ...) AmtPtpHostTraceEvents((Level), (Flags), __VA_ARGS__)
+
+typedef const struct _AMTPTP_HOST_TRACELOGGING_PROVIDER *TraceLoggingHProvider;
+
+#define WINEVENT_LEVEL_VERBOSE 5
+
+#define TRACELOGGING_DECLARE_PROVIDER(Handle) \
+	extern const TraceLoggingHProvider Handle
+#define TRACELOGGING_DEFINE_PROVIDER(Handle, ...) \
+	const TraceLoggingHProvider Handle = NULL
+
+#define TraceLoggingRegister(Provider) ((void) (Provider))
+#define TraceLoggingUnregister(Provider) ((void) (Provider))
+
+BOOLEAN
+AmtPtpHostTraceLoggingEnabled(
+	UCHAR Level,
+	ULONGLONG Keyword
+);
+
+void
+AmtPtpHostTraceLoggingWrite(
+	const char *EventName
+);
+
+#define TraceLoggingProviderEnabled(Provider, Level, Keyword) \
+	AmtPtpHostTraceLoggingEnabled((Level), (Keyword))
+#define TraceLoggingWrite(Provider, EventName, ...) AmtPtpHostTraceLoggingWrite(EventName)
+
+//
+// HID class
+//
+
+#define FILE_DEVICE_KEYBOARD	0x0000000b
+#define METHOD_IN_DIRECT		1
+#define METHOD_OUT_DIRECT		2
+#define METHOD_NEITHER			3
+#define FILE_ANY_ACCESS			0
+
+#define CTL_CODE(DeviceType, Function, Method, Access) \
+	(((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+
+#define HID_CTL_CODE(id)		CTL_CODE(FILE_DEVICE_KEYBOARD, (id), METHOD_NEITHER, FILE_ANY_ACCESS)
+#define HID_IN_CTL_CODE(id)		CTL_CODE(FILE_DEVICE_KEYBOARD, (id), METHOD_IN_DIRECT, FILE_ANY_ACCESS)
+#define HID_OUT_CTL_CODE(id)	CTL_CODE(FILE_DEVICE_KEYBOARD, (id), METHOD_OUT_DIRECT, FILE_ANY_ACCESS)
+
+#define IOCTL_HID_GET_DEVICE_DESCRIPTOR				HID_CTL_CODE(0)
+#define IOCTL_HID_GET_REPORT_DESCRIPTOR				HID_CTL_CODE(1)
+#define IOCTL_HID_READ_REPORT						HID_CTL_CODE(2)
+#define IOCTL_HID_WRITE_REPORT						HID_CTL_CODE(3)
+#define IOCTL_HID_GET_STRING						HID_CTL_CODE(4)
+#define IOCTL_HID_ACTIVATE_DEVICE					HID_CTL_CODE(7)
+#define IOCTL_HID_DEACTIVATE_DEVICE					HID_CTL_CODE(8)
+#define IOCTL_HID_GET_DEVICE_ATTRIBUTES				HID_CTL_CODE(9)
+#define IOCTL_HID_SEND_IDLE_NOTIFICATION_REQUEST	HID_CTL_CODE(10)
+#define IOCTL_UMDF_HID_SET_FEATURE					HID_CTL_CODE(20)
+#define IOCTL_UMDF_HID_GET_FEATURE					HID_CTL_CODE(21)
+#define IOCTL_UMDF_HID_SET_OUTPUT_REPORT			HID_CTL_CODE(22)
+#define IOCTL_UMDF_HID_GET_INPUT_REPORT				HID_CTL_CODE(23)
+#define IOCTL_HID_GET_FEATURE						HID_OUT_CTL_CODE(100)
+#define IOCTL_HID_SET_FEATURE						HID_IN_CTL_CODE(100)
+
+#define HID_STRING_ID_IMANUFACTURER	14
+#define HID_STRING_ID_IPRODUCT		15
+#define HID_STRING_ID_ISERIALNUMBER	16
+
+#pragma pack(push, 1)
+typedef struct _HID_DESCRIPTOR {
+	UCHAR bLength;
+	UCHAR bDescriptorType;
+	USHORT bcdHID;
+	UCHAR bCountry;
+	UCHAR bNumDescriptors;
+	struct _HID_DESCRIPTOR_DESC_LIST {
+		UCHAR bReportType;
+		USHORT wReportLength;
+	} DescriptorList[1];
+} HID_DESCRIPTOR, *PHID_DESCRIPTOR;
+#pragma pack(pop)
+
+typedef struct _HID_DEVICE_ATTRIBUTES {
+	ULONG Size;
+	USHORT VendorID;
+	USHORT ProductID;
+	USHORT VersionNumber;
+	USHORT Reserved[11];
+} HID_DEVICE_ATTRIBUTES, *PHID_DEVICE_ATTRIBUTES;
+
+typedef struct _HID_XFER_PACKET {
+	PUCHAR reportBuffer;
+	ULONG reportBufferLen;
+	UCHAR reportId;
+} HID_XFER_PACKET, *PHID_XFER_PACKET;
+
+//
+// USB
+//
+
+typedef struct _USB_DEVICE_DESCRIPTOR {
+	UCHAR bLength;
+	UCHAR bDescriptorType;
+	USHORT bcdUSB;
+	UCHAR bDeviceClass;
+	UCHAR bDeviceSubClass;
+	UCHAR bDeviceProtocol;
+	UCHAR bMaxPacketSize0;
+	USHORT idVendor;
+	USHORT idProduct;
+	USHORT bcdDevice;
+	UCHAR iManufacturer;
+	UCHAR iProduct;
+	UCHAR iSerialNumber;
+	UCHAR bNumConfigurations;
+} USB_DEVICE_DESCRIPTOR, *PUSB_DEVICE_DESCRIPTOR;
+
+typedef enum _WDF_USB_BMREQUEST_DIRECTION {
+	BmRequestHostToDevice = 0,
+	BmRequestDeviceToHost = 1
+} WDF_USB_BMREQUEST_DIRECTION;
+
+typedef enum _WDF_USB_BMREQUEST_TYPE {
+	BmRequestStandard = 0,
+	BmRequestClass = 1,
+	BmRequestVendor = 2
+} WDF_USB_BMREQUEST_TYPE;
+
+typedef enum _WDF_USB_BMREQUEST_RECIPIENT {
+	BmRequestToDevice = 0,
+	BmRequestToInterface = 1,
+	BmRequestToEndpoint = 2,
+	BmRequestToOther = 3
+} WDF_USB_BMREQUEST_RECIPIENT;
+
+typedef enum _WDF_USB_PIPE_TYPE {
+	WdfUsbPipeTypeInvalid = 0,
+	WdfUsbPipeTypeControl,
+	WdfUsbPipeTypeIsochronous,
+	WdfUsbPipeTypeBulk,
+	WdfUsbPipeTypeInterrupt
+} WDF_USB_PIPE_TYPE;
+
+#define WDF_USB_DEVICE_TRAIT_SELF_POWERED			0x00000001
+#define WDF_USB_DEVICE_TRAIT_REMOTE_WAKE_CAPABLE	0x00000002
+#define WDF_USB_DEVICE_TRAIT_AT_HIGH_SPEED			0x00000004
+
+//
+// Framework handles
+//
+
+typedef void *WDFOBJECT, *WDFCONTEXT;
+typedef struct WDFDRIVER__ *WDFDRIVER;
+typedef struct WDFDEVICE__ *WDFDEVICE;
+typedef struct WDFQUEUE__ *WDFQUEUE;
+typedef struct WDFREQUEST__ *WDFREQUEST;
+typedef struct WDFMEMORY__ *WDFMEMORY;
+typedef struct WDFLOOKASIDE__ *WDFLOOKASIDE;
+typedef struct WDFIOTARGET__ *WDFIOTARGET;
+typedef struct WDFKEY__ *WDFKEY;
+typedef struct WDFCMRESLIST__ *WDFCMRESLIST;
+typedef struct WDFUSBDEVICE__ *WDFUSBDEVICE;
+typedef struct WDFUSBINTERFACE__ *WDFUSBINTERFACE;
+typedef struct WDFUSBPIPE__ *WDFUSBPIPE;
+typedef struct WDFDEVICE_INIT WDFDEVICE_INIT, *PWDFDEVICE_INIT;
+
+#define WDF_NO_HANDLE NULL
+#define WDF_NO_OBJECT_ATTRIBUTES NULL
+
+typedef struct _WDFMEMORY_OFFSET {
+	size_t BufferOffset;
+	size_t BufferLength;
+} WDFMEMORY_OFFSET, *PWDFMEMORY_OFFSET;
+
+typedef enum _WDF_TRI_STATE {
+	WdfFalse = 0,
+	WdfTrue = 1,
+	WdfUseDefault = 2
+} WDF_TRI_STATE;
+
+typedef enum _WDF_POWER_DEVICE_STATE {
+	WdfPowerDeviceInvalid = 0,
+	WdfPowerDeviceD0,
+	WdfPowerDeviceD1,
+	WdfPowerDeviceD2,
+	WdfPowerDeviceD3,
+	WdfPowerDeviceD3Final,
+	WdfPowerDevicePrepareForHibernation,
+	WdfPowerDeviceMaximum
+} WDF_POWER_DEVICE_STATE;
+
+typedef enum _WDF_IO_QUEUE_DISPATCH_TYPE {
+	WdfIoQueueDispatchInvalid = 0,
+	WdfIoQueueDispatchSequential,
+	WdfIoQueueDispatchParallel,
+	WdfIoQueueDispatchManual,
+	WdfIoQueueDispatchMax
+} WDF_IO_QUEUE_DISPATCH_TYPE;
+
+typedef enum _WDF_IO_TARGET_SENT_IO_ACTION {
+	WdfIoTargetSentIoUndefined = 0,
+	WdfIoTargetCancelSentIo,
+	WdfIoTargetWaitForSentIoToComplete,
+	WdfIoTargetLeaveSentIoPending
+} WDF_IO_TARGET_SENT_IO_ACTION;
+
+typedef enum _WDF_REQUEST_STOP_ACTION_FLAGS {
+	WdfRequestStopActionInvalid = 0,
+	WdfRequestStopActionSuspend = 0x01,
+	WdfRequestStopActionPurge = 0x2,
+	WdfRequestStopRequestCancelable = 0x10000000
+} WDF_REQUEST_STOP_ACTION_FLAGS;
+
+typedef enum _WDF_REQUEST_TYPE {
+	WdfRequestTypeCreate = 0x0,
+	WdfRequestTypeRead = 0x3,
+	WdfRequestTypeWrite = 0x4,
+	WdfRequestTypeDeviceControl = 0xE,
+	WdfRequestTypeDeviceControlInternal = 0xF,
+	WdfRequestTypeOther = 0x1B
+} WDF_REQUEST_TYPE;
+
+//
+// Callback types, declared as function types like the WDK does
+//
+
+typedef void EVT_WDF_OBJECT_CONTEXT_CLEANUP(WDFOBJECT Object);
+typedef EVT_WDF_OBJECT_CONTEXT_CLEANUP *PFN_WDF_OBJECT_CONTEXT_CLEANUP;
+typedef void EVT_WDF_OBJECT_CONTEXT_DESTROY(WDFOBJECT Object);
+typedef EVT_WDF_OBJECT_CONTEXT_DESTROY *PFN_WDF_OBJECT_CONTEXT_DESTROY;
+
+typedef NTSTATUS EVT_WDF_DRIVER_DEVICE_ADD(WDFDRIVER Driver, PWDFDEVICE_INIT DeviceInit);
+typedef EVT_WDF_DRIVER_DEVICE_ADD *PFN_WDF_DRIVER_DEVICE_ADD;
+typedef void EVT_WDF_DRIVER_UNLOAD(WDFDRIVER Driver);
+typedef EVT_WDF_DRIVER_UNLOAD *PFN_WDF_DRIVER_UNLOAD;
+
+typedef NTSTATUS EVT_WDF_DEVICE_PREPARE_HARDWARE(
+	WDFDEVICE Device, WDFCMRESLIST ResourcesRaw, WDFCMRESLIST ResourcesTranslated);
+typedef EVT_WDF_DEVICE_PREPARE_HARDWARE *PFN_WDF_DEVICE_PREPARE_HARDWARE;
+typedef NTSTATUS EVT_WDF_DEVICE_RELEASE_HARDWARE(WDFDEVICE Device, WDFCMRESLIST ResourcesTranslated);
+typedef EVT_WDF_DEVICE_RELEASE_HARDWARE *PFN_WDF_DEVICE_RELEASE_HARDWARE;
+typedef NTSTATUS EVT_WDF_DEVICE_D0_ENTRY(WDFDEVICE Device, WDF_POWER_DEVICE_STATE PreviousState);
+typedef EVT_WDF_DEVICE_D0_ENTRY *PFN_WDF_DEVICE_D0_ENTRY;
+typedef NTSTATUS EVT_WDF_DEVICE_D0_EXIT(WDFDEVICE Device, WDF_POWER_DEVICE_STATE TargetState);
+typedef EVT_WDF_DEVICE_D0_EXIT *PFN_WDF_DEVICE_D0_EXIT;
+
+typedef void EVT_WDF_IO_QUEUE_IO_DEFAULT(WDFQUEUE Queue, WDFREQUEST Request);
+typedef EVT_WDF_IO_QUEUE_IO_DEFAULT *PFN_WDF_IO_QUEUE_IO_DEFAULT;
+typedef void EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL(WDFQUEUE Queue, WDFREQUEST Request,
+	size_t OutputBufferLength, size_t InputBufferLength, ULONG IoControlCode);
+typedef EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL *PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL;
+typedef void EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL(WDFQUEUE Queue, WDFREQUEST Request,
+	size_t OutputBufferLength, size_t InputBufferLength, ULONG IoControlCode);
+typedef EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL *PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL;
+typedef void EVT_WDF_IO_QUEUE_IO_STOP(WDFQUEUE Queue, WDFREQUEST Request, ULONG ActionFlags);
+typedef EVT_WDF_IO_QUEUE_IO_STOP *PFN_WDF_IO_QUEUE_IO_STOP;
+typedef void EVT_WDF_IO_QUEUE_IO_RESUME(WDFQUEUE Queue, WDFREQUEST Request);
+typedef EVT_WDF_IO_QUEUE_IO_RESUME *PFN_WDF_IO_QUEUE_IO_RESUME;
+
+typedef struct _WDF_REQUEST_COMPLETION_PARAMS WDF_REQUEST_COMPLETION_PARAMS, *PWDF_REQUEST_COMPLETION_PARAMS;
+typedef void EVT_WDF_REQUEST_COMPLETION_ROUTINE(WDFREQUEST Request, WDFIOTARGET Target,
+	PWDF_REQUEST_COMPLETION_PARAMS Params, WDFCONTEXT Context);
+typedef EVT_WDF_REQUEST_COMPLETION_ROUTINE *PFN_WDF_REQUEST_COMPLETION_ROUTINE;
+
+typedef void EVT_WDF_USB_READER_COMPLETION_ROUTINE(WDFUSBPIPE Pipe, WDFMEMORY Buffer,
+	size_t NumBytesTransferred, WDFCONTEXT Context);
+typedef EVT_WDF_USB_READER_COMPLETION_ROUTINE *PFN_WDF_USB_READER_COMPLETION_ROUTINE;
+typedef BOOLEAN EVT_WDF_USB_READERS_FAILED(WDFUSBPIPE Pipe, NTSTATUS Status, USBD_STATUS UsbdStatus);
+typedef EVT_WDF_USB_READERS_FAILED *PFN_WDF_USB_READERS_FAILED;
+
+//
+// Object attributes and typed contexts
+//
+
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO {
+	ULONG Size;
+	PCSTR ContextName;
+	size_t ContextSize;
+	const struct _WDF_OBJECT_CONTEXT_TYPE_INFO *UniqueType;
+} WDF_OBJECT_CONTEXT_TYPE_INFO, *PWDF_OBJECT_CONTEXT_TYPE_INFO;
+typedef const WDF_OBJECT_CONTEXT_TYPE_INFO *PCWDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef struct _WDF_OBJECT_ATTRIBUTES {
+	ULONG Size;
+	PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+	PFN_WDF_OBJECT_CONTEXT_DESTROY EvtDestroyCallback;
+	WDFOBJECT ParentObject;
+	size_t ContextSizeOverride;
+	PCWDF_OBJECT_CONTEXT_TYPE_INFO ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES, *PWDF_OBJECT_ATTRIBUTES;
+
+PVOID
+WdfObjectGetTypedContextWorker(
+	WDFOBJECT Handle,
+	PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo
+);
+
+// Each translation unit gets its own type info, so contexts are matched by name
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(_contexttype, _castingfunction) \
+	static const WDF_OBJECT_CONTEXT_TYPE_INFO WDF_##_contexttype##_TYPE_INFO __attribute__((unused)) = { \
+		sizeof(WDF_OBJECT_CONTEXT_TYPE_INFO), #_contexttype, sizeof(_contexttype), NULL }; \
+	static inline _contexttype * \
+	_castingfunction(WDFOBJECT Handle) \
+	{ \
+		return (_contexttype *) WdfObjectGetTypedContextWorker(Handle, &WDF_##_contexttype##_TYPE_INFO); \
+	}
+
+static inline void
+WDF_OBJECT_ATTRIBUTES_INIT(
+	PWDF_OBJECT_ATTRIBUTES Attributes
+)
+{
+	memset(Attributes, 0, sizeof(*Attributes));
+	Attributes->Size = sizeof(*Attributes);
+}
+
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(_attributes, _contexttype) \
+	do { \
+		WDF_OBJECT_ATTRIBUTES_INIT(_attributes); \
+		(_attributes)->ContextTypeInfo = &WDF_##_contexttype##_TYPE_INFO; \
+	} while (0)
+
+VOID
+WdfObjectDelete(
+	WDFOBJECT Object
+);
+
+//
+// Driver
+//
+
+typedef struct _WDF_DRIVER_CONFIG {
+	ULONG Size;
+	PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd;
+	PFN_WDF_DRIVER_UNLOAD EvtDriverUnload;
+	ULONG DriverInitFlags;
+	ULONG DriverPoolTag;
+} WDF_DRIVER_CONFIG, *PWDF_DRIVER_CONFIG;
+
+static inline void
+WDF_DRIVER_CONFIG_INIT(
+	PWDF_DRIVER_CONFIG Config,
+	PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd
+)
+{
+	memset(Config, 0, sizeof(*Config));
+	Config->Size = sizeof(*Config);
+	Config->EvtDriverDeviceAdd = EvtDriverDeviceAdd;
+}
+
+NTSTATUS
+WdfDriverCreate(
+	PDRIVER_OBJECT DriverObject,
+	PCUNICODE_STRING RegistryPath,
+	PWDF_OBJECT_ATTRIBUTES DriverAttributes,
+	PWDF_DRIVER_CONFIG DriverConfig,
+	WDFDRIVER *Driver
+);
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(
+	WDFDRIVER Driver
+);
+
+NTSTATUS
+WdfDriverOpenParametersRegistryKey(
+	WDFDRIVER Driver,
+	ACCESS_MASK DesiredAccess,
+	PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	WDFKEY *Key
+);
+
+NTSTATUS
+WdfRegistryQueryValue(
+	WDFKEY Key,
+	PCUNICODE_STRING ValueName,
+	ULONG ValueLength,
+	PVOID Value,
+	PULONG ValueLengthQueried,
+	PULONG ValueType
+);
+
+VOID
+WdfRegistryClose(
+	WDFKEY Key
+);
+
+//
+// Device
+//
+
+typedef struct _WDF_PNPPOWER_EVENT_CALLBACKS {
+	ULONG Size;
+	PFN_WDF_DEVICE_D0_ENTRY EvtDeviceD0Entry;
+	PFN_WDF_DEVICE_D0_EXIT EvtDeviceD0Exit;
+	PFN_WDF_DEVICE_PREPARE_HARDWARE EvtDevicePrepareHardware;
+	PFN_WDF_DEVICE_RELEASE_HARDWARE EvtDeviceReleaseHardware;
+} WDF_PNPPOWER_EVENT_CALLBACKS, *PWDF_PNPPOWER_EVENT_CALLBACKS;
+
+static inline void
+WDF_PNPPOWER_EVENT_CALLBACKS_INIT(
+	PWDF_PNPPOWER_EVENT_CALLBACKS Callbacks
+)
+{
+	memset(Callbacks, 0, sizeof(*Callbacks));
+	Callbacks->Size = sizeof(*Callbacks);
+}
+
+typedef struct _WDF_DEVICE_PNP_CAPABILITIES {
+	ULONG Size;
+	WDF_TRI_STATE LockSupported;
+	WDF_TRI_STATE EjectSupported;
+	WDF_TRI_STATE Removable;
+	WDF_TRI_STATE DockDevice;
+	WDF_TRI_STATE UniqueID;
+	WDF_TRI_STATE SilentInstall;
+	WDF_TRI_STATE SurpriseRemovalOK;
+	WDF_TRI_STATE HardwareDisabled;
+	WDF_TRI_STATE NoDisplayInUI;
+	ULONG Address;
+	ULONG UINumber;
+} WDF_DEVICE_PNP_CAPABILITIES, *PWDF_DEVICE_PNP_CAPABILITIES;
+
+static inline void
+WDF_DEVICE_PNP_CAPABILITIES_INIT(
+	PWDF_DEVICE_PNP_CAPABILITIES Caps
+)
+{
+	memset(Caps, 0, sizeof(*Caps));
+	Caps->Size = sizeof(*Caps);
+	Caps->LockSupported = WdfUseDefault;
+	Caps->EjectSupported = WdfUseDefault;
+	Caps->Removable = WdfUseDefault;
+	Caps->DockDevice = WdfUseDefault;
+	Caps->UniqueID = WdfUseDefault;
+	Caps->SilentInstall = WdfUseDefault;
+	Caps->SurpriseRemovalOK = WdfUseDefault;
+	Caps->HardwareDisabled = WdfUseDefault;
+	Caps->NoDisplayInUI = WdfUseDefault;
+	Caps->Address = (ULONG) -1;
+	Caps->UINumber = (ULONG) -1;
+}
+
+VOID
+WdfFdoInitSetFilter(
+	PWDFDEVICE_INIT DeviceInit
+);
+
+VOID
+WdfPdoInitAllowForwardingRequestToParent(
+	PWDFDEVICE_INIT DeviceInit
+);
+
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(
+	PWDFDEVICE_INIT DeviceInit,
+	PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks
+);
+
+NTSTATUS
+WdfDeviceCreate(
+	PWDFDEVICE_INIT *DeviceInit,
+	PWDF_OBJECT_ATTRIBUTES DeviceAttributes,
+	WDFDEVICE *Device
+);
+
+VOID
+WdfDeviceSetPnpCapabilities(
+	WDFDEVICE Device,
+	PWDF_DEVICE_PNP_CAPABILITIES PnpCapabilities
+);
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(
+	WDFDEVICE Device,
+	CONST GUID *InterfaceClassGUID,
+	PCUNICODE_STRING ReferenceString
+);
+
+WDFIOTARGET
+WdfDeviceGetIoTarget(
+	WDFDEVICE Device
+);
+
+WDFDRIVER
+WdfDeviceGetDriver(
+	WDFDEVICE Device
+);
+
+//
+// Queues
+//
+
+typedef struct _WDF_IO_QUEUE_CONFIG {
+	ULONG Size;
+	WDF_IO_QUEUE_DISPATCH_TYPE DispatchType;
+	WDF_TRI_STATE PowerManaged;
+	BOOLEAN AllowZeroLengthRequests;
+	BOOLEAN DefaultQueue;
+	PFN_WDF_IO_QUEUE_IO_DEFAULT EvtIoDefault;
+	PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL EvtIoDeviceControl;
+	PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL EvtIoInternalDeviceControl;
+	PFN_WDF_IO_QUEUE_IO_STOP EvtIoStop;
+	PFN_WDF_IO_QUEUE_IO_RESUME EvtIoResume;
+} WDF_IO_QUEUE_CONFIG, *PWDF_IO_QUEUE_CONFIG;
+
+static inline void
+WDF_IO_QUEUE_CONFIG_INIT(
+	PWDF_IO_QUEUE_CONFIG Config,
+	WDF_IO_QUEUE_DISPATCH_TYPE DispatchType
+)
+{
+	memset(Config, 0, sizeof(*Config));
+	Config->Size = sizeof(*Config);
+	Config->PowerManaged = WdfUseDefault;
+	Config->DispatchType = DispatchType;
+}
+
+static inline void
+WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(
+	PWDF_IO_QUEUE_CONFIG Config,
+	WDF_IO_QUEUE_DISPATCH_TYPE DispatchType
+)
+{
+	WDF_IO_QUEUE_CONFIG_INIT(Config, DispatchType);
+	Config->DefaultQueue = TRUE;
+}
+
+NTSTATUS
+WdfIoQueueCreate(
+	WDFDEVICE Device,
+	PWDF_IO_QUEUE_CONFIG Config,
+	PWDF_OBJECT_ATTRIBUTES QueueAttributes,
+	WDFQUEUE *Queue
+);
+
+WDFDEVICE
+WdfIoQueueGetDevice(
+	WDFQUEUE Queue
+);
+
+NTSTATUS
+WdfIoQueueRetrieveNextRequest(
+	WDFQUEUE Queue,
+	WDFREQUEST *OutRequest
+);
+
+//
+// Requests and memory
+//
+
+typedef struct _WDF_REQUEST_PARAMETERS {
+	USHORT Size;
+	UCHAR MinorFunction;
+	WDF_REQUEST_TYPE Type;
+	union {
+		struct {
+			size_t OutputBufferLength;
+			size_t InputBufferLength;
+			ULONG IoControlCode;
+			PVOID Type3InputBuffer;
+		} DeviceIoControl;
+	} Parameters;
+} WDF_REQUEST_PARAMETERS, *PWDF_REQUEST_PARAMETERS;
+
+static inline void
+WDF_REQUEST_PARAMETERS_INIT(
+	PWDF_REQUEST_PARAMETERS Parameters
+)
+{
+	memset(Parameters, 0, sizeof(*Parameters));
+	Parameters->Size = sizeof(*Parameters);
+}
+
+struct _WDF_REQUEST_COMPLETION_PARAMS {
+	ULONG Size;
+	WDF_REQUEST_TYPE Type;
+	IO_STATUS_BLOCK IoStatus;
+	union {
+		struct {
+			ULONG IoControlCode;
+			struct {
+				WDFMEMORY Buffer;
+				size_t Offset;
+			} Input;
+			struct {
+				WDFMEMORY Buffer;
+				size_t Offset;
+				size_t Length;
+			} Output;
+		} Ioctl;
+	} Parameters;
+};
+
+#define WDF_REQUEST_SEND_OPTION_TIMEOUT				0x00000001
+#define WDF_REQUEST_SEND_OPTION_SYNCHRONOUS			0x00000002
+#define WDF_REQUEST_SEND_OPTION_IGNORE_TARGET_STATE	0x00000004
+#define WDF_REQUEST_SEND_OPTION_SEND_AND_FORGET		0x00000008
+
+typedef struct _WDF_REQUEST_SEND_OPTIONS {
+	ULONG Size;
+	ULONG Flags;
+	LONGLONG Timeout;
+} WDF_REQUEST_SEND_OPTIONS, *PWDF_REQUEST_SEND_OPTIONS;
+
+static inline void
+WDF_REQUEST_SEND_OPTIONS_INIT(
+	PWDF_REQUEST_SEND_OPTIONS Options,
+	ULONG Flags
+)
+{
+	memset(Options, 0, sizeof(*Options));
+	Options->Size = sizeof(*Options);
+	Options->Flags = Flags;
+}
+
+typedef enum _WDF_MEMORY_DESCRIPTOR_TYPE {
+	WdfMemoryDescriptorTypeInvalid = 0,
+	WdfMemoryDescriptorTypeBuffer,
+	WdfMemoryDescriptorTypeMdl,
+	WdfMemoryDescriptorTypeHandle
+} WDF_MEMORY_DESCRIPTOR_TYPE;
+
+typedef struct _WDF_MEMORY_DESCRIPTOR {
+	WDF_MEMORY_DESCRIPTOR_TYPE Type;
+	union {
+		struct {
+			PVOID Buffer;
+			ULONG Length;
+		} BufferType;
+		struct {
+			WDFMEMORY Memory;
+			PWDFMEMORY_OFFSET Offsets;
+		} HandleType;
+	} u;
+} WDF_MEMORY_DESCRIPTOR, *PWDF_MEMORY_DESCRIPTOR;
+
+static inline void
+WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+	PWDF_MEMORY_DESCRIPTOR Descriptor,
+	PVOID Buffer,
+	ULONG BufferLength
+)
+{
+	memset(Descriptor, 0, sizeof(*Descriptor));
+	Descriptor->Type = WdfMemoryDescriptorTypeBuffer;
+	Descriptor->u.BufferType.Buffer = Buffer;
+	Descriptor->u.BufferType.Length = BufferLength;
+}
+
+VOID
+WdfRequestComplete(
+	WDFREQUEST Request,
+	NTSTATUS Status
+);
+
+VOID
+WdfRequestSetInformation(
+	WDFREQUEST Request,
+	ULONG_PTR Information
+);
+
+ULONG_PTR
+WdfRequestGetInformation(
+	WDFREQUEST Request
+);
+
+NTSTATUS
+WdfRequestGetStatus(
+	WDFREQUEST Request
+);
+
+VOID
+WdfRequestGetParameters(
+	WDFREQUEST Request,
+	PWDF_REQUEST_PARAMETERS Parameters
+);
+
+PIRP
+WdfRequestWdmGetIrp(
+	WDFREQUEST Request
+);
+
+NTSTATUS
+WdfRequestRetrieveOutputBuffer(
+	WDFREQUEST Request,
+	size_t MinimumRequiredSize,
+	PVOID *Buffer,
+	size_t *Length
+);
+
+NTSTATUS
+WdfRequestRetrieveOutputMemory(
+	WDFREQUEST Request,
+	WDFMEMORY *Memory
+);
+
+NTSTATUS
+WdfRequestRetrieveInputMemory(
+	WDFREQUEST Request,
+	WDFMEMORY *Memory
+);
+
+NTSTATUS
+WdfRequestForwardToIoQueue(
+	WDFREQUEST Request,
+	WDFQUEUE DestinationQueue
+);
+
+NTSTATUS
+WdfRequestCreate(
+	PWDF_OBJECT_ATTRIBUTES RequestAttributes,
+	WDFIOTARGET IoTarget,
+	WDFREQUEST *Request
+);
+
+BOOLEAN
+WdfRequestSend(
+	WDFREQUEST Request,
+	WDFIOTARGET Target,
+	PWDF_REQUEST_SEND_OPTIONS Options
+);
+
+VOID
+WdfRequestSetCompletionRoutine(
+	WDFREQUEST Request,
+	PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine,
+	WDFCONTEXT CompletionContext
+);
+
+VOID
+WdfRequestFormatRequestUsingCurrentType(
+	WDFREQUEST Request
+);
+
+PVOID
+WdfMemoryGetBuffer(
+	WDFMEMORY Memory,
+	size_t *BufferSize
+);
+
+NTSTATUS
+WdfMemoryCopyFromBuffer(
+	WDFMEMORY DestinationMemory,
+	size_t DestinationOffset,
+	PVOID Buffer,
+	size_t NumBytesToCopyFrom
+);
+
+NTSTATUS
+WdfMemoryCopyToBuffer(
+	WDFMEMORY SourceMemory,
+	size_t SourceOffset,
+	PVOID Buffer,
+	size_t NumBytesToCopyTo
+);
+
+NTSTATUS
+WdfLookasideListCreate(
+	PWDF_OBJECT_ATTRIBUTES LookasideAttributes,
+	size_t BufferSize,
+	POOL_TYPE PoolType,
+	PWDF_OBJECT_ATTRIBUTES MemoryAttributes,
+	ULONG PoolTag,
+	WDFLOOKASIDE *Lookaside
+);
+
+NTSTATUS
+WdfMemoryCreateFromLookaside(
+	WDFLOOKASIDE Lookaside,
+	WDFMEMORY *Memory
+);
+
+//
+// I/O targets
+//
+
+NTSTATUS
+WdfIoTargetStart(
+	WDFIOTARGET IoTarget
+);
+
+VOID
+WdfIoTargetStop(
+	WDFIOTARGET IoTarget,
+	WDF_IO_TARGET_SENT_IO_ACTION Action
+);
+
+NTSTATUS
+WdfIoTargetSendInternalIoctlSynchronously(
+	WDFIOTARGET IoTarget,
+	WDFREQUEST Request,
+	ULONG IoctlCode,
+	PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	PULONG_PTR BytesReturned
+);
+
+NTSTATUS
+WdfIoTargetFormatRequestForInternalIoctl(
+	WDFIOTARGET IoTarget,
+	WDFREQUEST Request,
+	ULONG IoctlCode,
+	WDFMEMORY InputBuffer,
+	PWDFMEMORY_OFFSET InputBufferOffset,
+	WDFMEMORY OutputBuffer,
+	PWDFMEMORY_OFFSET OutputBufferOffset
+);
+
+//
+// USB targets
+//
+
+typedef struct _WDF_USB_CONTROL_SETUP_PACKET {
+	union {
+		struct {
+			union {
+				struct {
+					BYTE Recipient : 2;
+					BYTE Reserved : 3;
+					BYTE Type : 2;
+					BYTE Dir : 1;
+				} Request;
+				BYTE Byte;
+			} bm;
+			BYTE bRequest;
+			union {
+				struct {
+					BYTE LowByte;
+					BYTE HiByte;
+				} Bytes;
+				USHORT Value;
+			} wValue;
+			union {
+				struct {
+					BYTE LowByte;
+					BYTE HiByte;
+				} Bytes;
+				USHORT Value;
+			} wIndex;
+			USHORT wLength;
+		} Packet;
+		struct {
+			BYTE Bytes[8];
+		} Generic;
+	};
+} WDF_USB_CONTROL_SETUP_PACKET, *PWDF_USB_CONTROL_SETUP_PACKET;
+
+static inline void
+WDF_USB_CONTROL_SETUP_PACKET_INIT(
+	PWDF_USB_CONTROL_SETUP_PACKET Packet,
+	WDF_USB_BMREQUEST_DIRECTION Direction,
+	WDF_USB_BMREQUEST_RECIPIENT Recipient,
+	BYTE Request,
+	USHORT Value,
+	USHORT Index
+)
+{
+	memset(Packet, 0, sizeof(*Packet));
+	Packet->Packet.bm.Request.Dir = (BYTE) Direction;
+	Packet->Packet.bm.Request.Type = (BYTE) BmRequestStandard;
+	Packet->Packet.bm.Request.Recipient = (BYTE) Recipient;
+	Packet->Packet.bRequest = Request;
+	Packet->Packet.wValue.Value = Value;
+	Packet->Packet.wIndex.Value = Index;
+}
+
+typedef struct _USBD_VERSION_INFORMATION {
+	ULONG USBDI_Version;
+	ULONG Supported_USB_Version;
+} USBD_VERSION_INFORMATION;
+
+typedef struct _WDF_USB_DEVICE_INFORMATION {
+	ULONG Size;
+	USBD_VERSION_INFORMATION UsbdVersionInformation;
+	ULONG HcdPortCapabilities;
+	ULONG Traits;
+} WDF_USB_DEVICE_INFORMATION, *PWDF_USB_DEVICE_INFORMATION;
+
+static inline void
+WDF_USB_DEVICE_INFORMATION_INIT(
+	PWDF_USB_DEVICE_INFORMATION Information
+)
+{
+	memset(Information, 0, sizeof(*Information));
+	Information->Size = sizeof(*Information);
+}
+
+typedef enum _WdfUsbTargetDeviceSelectConfigType {
+	WdfUsbTargetDeviceSelectConfigTypeInvalid = 0,
+	WdfUsbTargetDeviceSelectConfigTypeSingleInterface = 3
+} WdfUsbTargetDeviceSelectConfigType;
+
+typedef struct _WDF_USB_DEVICE_SELECT_CONFIG_PARAMS {
+	ULONG Size;
+	WdfUsbTargetDeviceSelectConfigType Type;
+	union {
+		struct {
+			WDFUSBINTERFACE ConfiguredUsbInterface;
+			UCHAR NumberConfiguredPipes;
+		} SingleInterface;
+	} Types;
+} WDF_USB_DEVICE_SELECT_CONFIG_PARAMS, *PWDF_USB_DEVICE_SELECT_CONFIG_PARAMS;
+
+static inline void
+WDF_USB_DEVICE_SELECT_CONFIG_PARAMS_INIT_SINGLE_INTERFACE(
+	PWDF_USB_DEVICE_SELECT_CONFIG_PARAMS Params
+)
+{
+	memset(Params, 0, sizeof(*Params));
+	Params->Size = sizeof(*Params);
+	Params->Type = WdfUsbTargetDeviceSelectConfigTypeSingleInterface;
+}
+
+typedef struct _WDF_USB_PIPE_INFORMATION {
+	ULONG Size;
+	ULONG MaximumPacketSize;
+	BYTE EndpointAddress;
+	BYTE Interval;
+	BYTE SettingIndex;
+	WDF_USB_PIPE_TYPE PipeType;
+	ULONG MaximumTransferSize;
+} WDF_USB_PIPE_INFORMATION, *PWDF_USB_PIPE_INFORMATION;
+
+static inline void
+WDF_USB_PIPE_INFORMATION_INIT(
+	PWDF_USB_PIPE_INFORMATION Information
+)
+{
+	memset(Information, 0, sizeof(*Information));
+	Information->Size = sizeof(*Information);
+}
+
+typedef struct _WDF_USB_CONTINUOUS_READER_CONFIG {
+	ULONG Size;
+	size_t TransferLength;
+	size_t HeaderLength;
+	size_t TrailerLength;
+	UCHAR NumPendingReads;
+	PWDF_OBJECT_ATTRIBUTES BufferAttributes;
+	PFN_WDF_USB_READER_COMPLETION_ROUTINE EvtUsbTargetPipeReadComplete;
+	WDFCONTEXT EvtUsbTargetPipeReadCompleteContext;
+	PFN_WDF_USB_READERS_FAILED EvtUsbTargetPipeReadersFailed;
+} WDF_USB_CONTINUOUS_READER_CONFIG, *PWDF_USB_CONTINUOUS_READER_CONFIG;
+
+static inline void
+WDF_USB_CONTINUOUS_READER_CONFIG_INIT(
+	PWDF_USB_CONTINUOUS_READER_CONFIG Config,
+	PFN_WDF_USB_READER_COMPLETION_ROUTINE EvtUsbTargetPipeReadComplete,
+	WDFCONTEXT EvtUsbTargetPipeReadCompleteContext,
+	size_t TransferLength
+)
+{
+	memset(Config, 0, sizeof(*Config));
+	Config->Size = sizeof(*Config);
+	Config->TransferLength = TransferLength;
+	Config->EvtUsbTargetPipeReadComplete = EvtUsbTargetPipeReadComplete;
+	Config->EvtUsbTargetPipeReadCompleteContext = EvtUsbTargetPipeReadCompleteContext;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceCreate(
+	WDFDEVICE Device,
+	PWDF_OBJECT_ATTRIBUTES Attributes,
+	WDFUSBDEVICE *UsbDevice
+);
+
+VOID
+WdfUsbTargetDeviceGetDeviceDescriptor(
+	WDFUSBDEVICE UsbDevice,
+	PUSB_DEVICE_DESCRIPTOR UsbDeviceDescriptor
+);
+
+NTSTATUS
+WdfUsbTargetDeviceRetrieveInformation(
+	WDFUSBDEVICE UsbDevice,
+	PWDF_USB_DEVICE_INFORMATION Information
+);
+
+NTSTATUS
+WdfUsbTargetDeviceSelectConfig(
+	WDFUSBDEVICE UsbDevice,
+	PWDF_OBJECT_ATTRIBUTES PipeAttributes,
+	PWDF_USB_DEVICE_SELECT_CONFIG_PARAMS Params
+);
+
+WDFUSBINTERFACE
+WdfUsbTargetDeviceGetInterface(
+	WDFUSBDEVICE UsbDevice,
+	UCHAR InterfaceIndex
+);
+
+BYTE
+WdfUsbInterfaceGetNumConfiguredPipes(
+	WDFUSBINTERFACE UsbInterface
+);
+
+WDFUSBPIPE
+WdfUsbInterfaceGetConfiguredPipe(
+	WDFUSBINTERFACE UsbInterface,
+	UCHAR PipeIndex,
+	PWDF_USB_PIPE_INFORMATION PipeInfo
+);
+
+VOID
+WdfUsbTargetPipeSetNoMaximumPacketSizeCheck(
+	WDFUSBPIPE Pipe
+);
+
+WDFIOTARGET
+WdfUsbTargetPipeGetIoTarget(
+	WDFUSBPIPE Pipe
+);
+
+NTSTATUS
+WdfUsbTargetPipeConfigContinuousReader(
+	WDFUSBPIPE Pipe,
+	PWDF_USB_CONTINUOUS_READER_CONFIG Config
+);
+
+NTSTATUS
+WdfUsbTargetDeviceSendControlTransferSynchronously(
+	WDFUSBDEVICE UsbDevice,
+	WDFREQUEST Request,
+	PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	PWDF_USB_CONTROL_SETUP_PACKET SetupPacket,
+	PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+	PULONG BytesTransferred
+);
+
+NTSTATUS
+WdfUsbTargetDeviceAllocAndQueryString(
+	WDFUSBDEVICE UsbDevice,
+	PWDF_OBJECT_ATTRIBUTES StringMemoryAttributes,
+	WDFMEMORY *StringMemory,
+	PUSHORT NumCharacters,
+	UCHAR StringIndex,
+	USHORT LangID
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,155 @@
+// AmtPtpImportTool.c: Converts a hid-recorder dump into a capture for a driver build
+//
+//   AmtPtpImport<Driver> [-device=N] [-report-id=N] [-family=pppp] [-frequency=Hz] Dump Capture
+//
+// Reads the identity of the dumped device (AmtPtpImportProbe) and takes the
+// decoder of the linked driver build's family row for its product, or for
+// product pppp, so the capture replays and decodes like one recorded by the
+// driver. Writes Capture with AmtPtpImportHidRecorder.
+//   -device=N       Device of a multi-device dump, the D: index, default 0
+//   -report-id=N    Only reports starting with byte N
+//   -family=pppp    Family row of product pppp instead of the dumped product
+//   -frequency=Hz   Timestamp ticks per second, default 1000000, which keeps
+//                   the dump's microseconds exactly
+// Prints one JSON object on stdout. Exits non-zero on a malformed or cut
+// dump, naming the line; the capture then holds the reports before it.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <driver.h>
+
+#include "AmtPtpCaptureFile.h"
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpImport.h"
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_BENCH_FAMILY Families[AMTPTP_HOST_MAX_FAMILIES];
+	const AMTPTP_BENCH_FAMILY *Family = NULL;
+	AMTPTP_CAPTURE_DEVICE Device;
+	AMTPTP_IMPORT_STATUS Status;
+	AMTPTP_IMPORT_STATS Stats;
+	AMTPTP_CAPTURE_MAP Map;
+	WDFDRIVER Driver = NULL;
+	uint8_t *Frame, *Out = NULL;
+	size_t OutSize, Written = 0, FamilyCount, f;
+	unsigned long Product = 0, DeviceIndex = 0;
+	long ReportId = AMTPTP_IMPORT_ANY_REPORT;
+	uint64_t Frequency = 1000000;
+	uint16_t IdVendor, IdProduct;
+	const char *Text;
+	FILE *File;
+	int Arg, Error, Failed;
+
+	for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++) {
+		if (strncmp(argv[Arg], "-device=", 8) == 0) {
+			DeviceIndex = strtoul(argv[Arg] + 8, NULL, 0);
+		}
+		else if (strncmp(argv[Arg], "-report-id=", 11) == 0) {
+			ReportId = strtol(argv[Arg] + 11, NULL, 0);
+		}
+		else if (strncmp(argv[Arg], "-family=", 8) == 0) {
+			Product = strtoul(argv[Arg] + 8, NULL, 16);
+		}
+		else if (strncmp(argv[Arg], "-frequency=", 11) == 0) {
+			Frequency = strtoull(argv[Arg] + 11, NULL, 0);
+		}
+		else {
+			break;
+		}
+	}
+
+	if (argc - Arg != 2 || Frequency == 0 || ReportId < AMTPTP_IMPORT_ANY_REPORT || ReportId > 0xFF) {
+		fprintf(stderr, "usage: %s [-device=N] [-report-id=N] [-family=pppp] [-frequency=Hz] Dump Capture\n",
+			argv[0]);
+		return 2;
+	}
+
+	Error = AmtPtpCaptureMap(argv[Arg], &Map);
+	if (Error != 0) {
+		fprintf(stderr, "%s: %s\n", argv[Arg], strerror(Error));
+		return 1;
+	}
+	Text = Map.Base ? (const char *) Map.Base : "";
+
+	if (AmtPtpImportProbe(Text, Map.Size, (uint32_t) DeviceIndex, &IdVendor, &IdProduct) != AmtPtpImportOk) {
+		fprintf(stderr, "%s: no I: line for device %lu\n", argv[Arg], DeviceIndex);
+		return 1;
+	}
+	if (Product == 0) {
+		Product = IdProduct;
+	}
+
+	if (AmtPtpHostLoadDriver(DriverEntry, &Driver) != STATUS_SUCCESS) {
+		fprintf(stderr, "%s: DriverEntry failed\n", AmtPtpHostFamilyDriver);
+		return 1;
+	}
+	FamilyCount = AmtPtpHostGetFamilies(Driver, Families, AMTPTP_HOST_MAX_FAMILIES);
+	for (f = 0; f < FamilyCount && Family == NULL; f++) {
+		if (Families[f].ProductId == Product) {
+			Family = &Families[f];
+		}
+	}
+	if (Family == NULL) {
+		fprintf(stderr, "%s: no family for product %04lx; pass -family=pppp\n", AmtPtpHostFamilyDriver, Product);
+		return 1;
+	}
+
+	memset(&Device, 0, sizeof(Device));
+	Device.IdVendor = IdVendor;
+	Device.IdProduct = IdProduct;
+	Device.TrackpadType = AMTPTP_CAPTURE_NO_TRACKPAD_TYPE;	// A dump names no tp_type
+	Device.TimestampFrequency = Frequency;
+	Device.Decoder = Family->Decoder;
+
+	// Every report takes at least three characters per byte in the dump, so
+	// twice its size holds the records of all but tiny reports; grow otherwise
+	Frame = malloc(AMTPTP_IMPORT_REPORT_MAX);
+	OutSize = 2 * Map.Size + AMTPTP_CAPTURE_HEADER_SIZE;
+	for (;;) {
+		free(Out);
+		Out = malloc(OutSize);
+		if (Frame == NULL || Out == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+
+		Status = AmtPtpImportHidRecorder(Text, Map.Size, (uint32_t) DeviceIndex, (int) ReportId, &Device,
+			Frame, AMTPTP_IMPORT_REPORT_MAX, Out, OutSize, &Written, &Stats);
+		if (Status != AmtPtpImportBufferTooSmall) {
+			break;
+		}
+		OutSize *= 2;
+	}
+
+	Failed = Status != AmtPtpImportOk;
+	if (Failed) {
+		fprintf(stderr, "%s:%llu: malformed or cut E: line\n", argv[Arg], (unsigned long long) Stats.BadLine);
+	}
+
+	File = fopen(argv[Arg + 1], "wb");
+	if (File == NULL || fwrite(Out, 1, Written, File) != Written || fclose(File) != 0) {
+		fprintf(stderr, "%s: %s\n", argv[Arg + 1], strerror(errno));
+		Failed = 1;
+	}
+	else {
+		printf("{\"family\":\"%s\",\"vendor\":\"%04x\",\"product\":\"%04x\",\"lines\":%llu,\"frames\":%llu,"
+			"\"skipped\":%llu,\"bytes\":%zu}\n", Family->Name, (unsigned) IdVendor, (unsigned) IdProduct,
+			(unsigned long long) Stats.Lines, (unsigned long long) Stats.Frames,
+			(unsigned long long) Stats.Skipped, Written);
+	}
+
+	free(Out);
+	free(Frame);
+	AmtPtpHostUnloadDriver(Driver);
+	AmtPtpCaptureUnmap(&Map);
+	return Failed;
+}
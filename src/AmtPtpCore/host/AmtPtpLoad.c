@@ -0,0 +1,365 @@
+// AmtPtpLoad.c: Load test of the AmtPtpDeviceUsbUm report pipeline
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <Driver.h>
+
+#include "AmtPtpHost.h"
+#include "AmtPtpLoad.h"
+#include "AmtPtpSim.h"
+
+void
+AmtPtpLoadInitConfig(
+	PAMTPTP_LOAD_CONFIG Config,
+	uint32_t ReportRate
+)
+{
+	AMTPTP_LOAD_CONFIG Empty = { 0 };
+
+	*Config = Empty;
+	Config->ReportRate = ReportRate;
+	Config->Frames = ReportRate;
+	Config->PendingReads = 2;
+	Config->ReaderDepth = 2;
+	Config->ServiceTime = 200;
+	Config->ConsumerTime = 10000;
+	Config->BucketWidth = 10;
+	Config->Script.Gesture = AmtPtpGestureDrag;
+	Config->Script.Fingers = 2;
+	Config->Script.Frames = 120;
+}
+
+static void
+AmtPtpLoadRecord(
+	PAMTPTP_LOAD_RESULT Result,
+	uint64_t Latency
+)
+{
+	uint64_t Bucket = Result->BucketWidth ? Latency / Result->BucketWidth : 0;
+
+	if (Bucket >= AMTPTP_LOAD_BUCKETS) {
+		Bucket = AMTPTP_LOAD_BUCKETS - 1;
+	}
+
+	if (Result->Completed == 0 || Latency < Result->Min) Result->Min = Latency;
+	if (Latency > Result->Max) Result->Max = Latency;
+	Result->Total += Latency;
+	Result->Completed++;
+	Result->Histogram[Bucket]++;
+}
+
+// One HID read as hidclass holds it
+typedef struct _AMTPTP_LOAD_READ {
+	WDFREQUEST Request;				// NULL while the consumer holds the report
+	uint64_t Return;				// When the consumer sends it again
+	uint8_t *Report;
+} AMTPTP_LOAD_READ, *PAMTPTP_LOAD_READ;
+
+typedef struct _AMTPTP_LOAD_RUN {
+	AMTPTP_SIM_DEVICE Sim;
+	AMTPTP_USB_TRANSPORT Transport;
+	AMTPTP_HOST_BINDING Binding;
+	WDFDRIVER Driver;
+	WDFDEVICE Device;
+	AMTPTP_LOAD_READ Reads[AMTPTP_LOAD_MAX_READS];
+} AMTPTP_LOAD_RUN, *PAMTPTP_LOAD_RUN;
+
+static int
+AmtPtpLoadSend(
+	PAMTPTP_LOAD_RUN Run,
+	PAMTPTP_LOAD_READ Read
+)
+{
+	if (!NT_SUCCESS(AmtPtpHostCreateRequest(Run->Device, IOCTL_HID_READ_REPORT, NULL, 0,
+		Read->Report, sizeof(PTP_REPORT), NULL, &Read->Request))) {
+		Read->Request = NULL;
+		return 1;
+	}
+
+	AmtPtpHostSendRequest(Read->Request);
+	return 0;
+}
+
+static int
+AmtPtpLoadStart(
+	PAMTPTP_LOAD_RUN Run,
+	const struct BCM5974_CONFIG *DeviceInfo,
+	const AMTPTP_LOAD_CONFIG *Config
+)
+{
+	PDEVICE_CONTEXT Context;
+	AMTPTP_MODE_SWITCH Switch;
+
+	AmtPtpSimGetTransport(&Run->Sim, &Run->Transport);
+	AmtPtpHostInitUsbBinding(&Run->Binding, &Run->Transport, USB_VENDOR_ID_APPLE, (USHORT) DeviceInfo->ansi);
+
+	if (!NT_SUCCESS(AmtPtpHostLoadDriver(DriverEntry, &Run->Driver))) {
+		return 1;
+	}
+	if (!NT_SUCCESS(AmtPtpHostAddDevice(Run->Driver, &Run->Binding, &Run->Device))) {
+		Run->Device = NULL;
+		return 1;
+	}
+	if (!NT_SUCCESS(AmtPtpHostPrepareHardware(Run->Device))) {
+		return 1;
+	}
+
+	// The trackpad speaks the wire format the driver configured itself for
+	Context = DeviceGetContext(Run->Device);
+	Switch.Size = (uint32_t) DeviceInfo->um_size;
+	Switch.RequestValue = (uint16_t) DeviceInfo->um_req_val;
+	Switch.RequestIndex = (uint16_t) DeviceInfo->um_req_idx;
+	Switch.SwitchIndex = (uint32_t) DeviceInfo->um_switch_idx;
+	Switch.SwitchOn = (uint8_t) DeviceInfo->um_switch_on;
+	Switch.SwitchOff = (uint8_t) DeviceInfo->um_switch_off;
+	AmtPtpSimInit(&Run->Sim, &Switch, &Context->Decoder);
+	Run->Sim.Script = Config->Script;
+	Run->Sim.Script.Width = DeviceInfo->x.max - DeviceInfo->x.min;
+	Run->Sim.Script.Height = DeviceInfo->y.max - DeviceInfo->y.min;
+
+	// TYPE3 trackpads stream without a mode switch
+	if (DeviceInfo->tp_type == TYPE3) {
+		Run->Sim.IsWellspringModeOn = 1;
+	}
+
+	AmtPtpHostSetClock(0);
+	AmtPtpHostSetClockFrequency(AMTPTP_LOAD_FREQUENCY);
+	if (!NT_SUCCESS(AmtPtpHostD0Entry(Run->Device, WdfPowerDeviceD3))) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+AmtPtpLoadStop(
+	PAMTPTP_LOAD_RUN Run
+)
+{
+	uint32_t i;
+
+	if (Run->Device != NULL) {
+		AmtPtpHostD0Exit(Run->Device, WdfPowerDeviceD3);
+		AmtPtpHostRemoveDevice(Run->Device);
+	}
+
+	for (i = 0; i < AMTPTP_LOAD_MAX_READS; i++) {
+		if (Run->Reads[i].Request != NULL) {
+			AmtPtpHostReleaseRequest(Run->Reads[i].Request);
+		}
+		free(Run->Reads[i].Report);
+	}
+
+	if (Run->Driver != NULL) {
+		AmtPtpHostUnloadDriver(Run->Driver);
+	}
+}
+
+int
+AmtPtpLoadRun(
+	uint16_t ProductId,
+	const AMTPTP_LOAD_CONFIG *Config,
+	PAMTPTP_LOAD_RESULT Result
+)
+{
+	AMTPTP_LOAD_RESULT Empty = { 0 };
+	const struct BCM5974_CONFIG *DeviceInfo = NULL;
+	PAMTPTP_LOAD_RUN Run;
+	PAMTPTP_LOAD_READ Read, Next;
+
+	// Completion times of the last ReaderDepth accepted transfers
+	uint64_t Reader[AMTPTP_LOAD_MAX_READS] = { 0 };
+	uint32_t ReaderNext = 0;
+
+	uint64_t Period, Arrival, Start, Done, Busy = 0;
+	uint32_t Seed = 2463534242u;
+	uint32_t n, i, Pending;
+	NTSTATUS Status;
+	int Failed = 0;
+
+	*Result = Empty;
+	Result->ProductId = ProductId;
+	Result->ReportRate = Config->ReportRate;
+	Result->PendingReads = Config->PendingReads;
+	Result->BucketWidth = Config->BucketWidth;
+
+	if (Config->ReportRate == 0 || Config->PendingReads > AMTPTP_LOAD_MAX_READS ||
+		Config->ReaderDepth == 0 || Config->ReaderDepth > AMTPTP_LOAD_MAX_READS ||
+		Config->Script.Frames == 0 || Config->Script.Fingers > AMTPTP_SYNTH_MAX_FINGERS) {
+		return 1;
+	}
+
+	// The driver's own lookup runs past the table for unknown IDs
+	for (i = 0; i < sizeof(Bcm5974ConfigTable) / sizeof(Bcm5974ConfigTable[0]); i++) {
+		if (Bcm5974ConfigTable[i].ansi == ProductId || Bcm5974ConfigTable[i].iso == ProductId ||
+			Bcm5974ConfigTable[i].jis == ProductId) {
+			DeviceInfo = &Bcm5974ConfigTable[i];
+			break;
+		}
+	}
+	if (DeviceInfo == NULL || DeviceInfo->tp_type == TYPE1) {
+		return 1;
+	}
+
+	Run = calloc(1, sizeof(*Run));
+	if (Run == NULL) {
+		return 1;
+	}
+	for (i = 0; i < Config->PendingReads; i++) {
+		Run->Reads[i].Report = malloc(sizeof(PTP_REPORT));
+		Failed |= Run->Reads[i].Report == NULL;
+	}
+
+	Failed = Failed || AmtPtpLoadStart(Run, DeviceInfo, Config);
+	for (i = 0; !Failed && i < Config->PendingReads; i++) {
+		Failed = AmtPtpLoadSend(Run, &Run->Reads[i]);
+	}
+
+	Period = AMTPTP_LOAD_FREQUENCY / Config->ReportRate;
+	Pending = Config->PendingReads;
+
+	for (n = 0; !Failed && n < Config->Frames; n++) {
+		Arrival = n * Period;
+		Result->Frames++;
+
+		// The transfer ReaderDepth back still holds its buffer
+		if (Reader[ReaderNext] > Arrival) {
+			Result->ReaderDrops++;
+			continue;
+		}
+
+		// xorshift32, so every run sees the same timing
+		Seed ^= Seed << 13; Seed ^= Seed >> 17; Seed ^= Seed << 5;
+		Start = Busy > Arrival ? Busy : Arrival;
+		Done = Start + Config->ServiceTime + (Config->ServiceJitter ? Seed % (Config->ServiceJitter + 1) : 0);
+		Busy = Done;
+		Reader[ReaderNext] = Done;
+		ReaderNext = (ReaderNext + 1) % Config->ReaderDepth;
+
+		// Reads the consumer is done with go back to the driver in time order
+		for (;;) {
+			Next = NULL;
+			for (i = 0; i < Config->PendingReads; i++) {
+				Read = &Run->Reads[i];
+				if (Read->Request == NULL && Read->Return <= Done && (Next == NULL || Read->Return < Next->Return)) {
+					Next = Read;
+				}
+			}
+			if (Next == NULL) {
+				break;
+			}
+
+			AmtPtpHostSetClock(Next->Return);
+			if (AmtPtpLoadSend(Run, Next)) {
+				Failed = 1;
+				break;
+			}
+			Pending++;
+		}
+
+		// The real completion routine runs on the frame
+		AmtPtpHostSetClock(Done);
+		Status = AmtPtpHostUsbReadPipe(Run->Device);
+		if (!NT_SUCCESS(Status)) {
+			Failed = 1;
+			break;
+		}
+
+		Read = NULL;
+		for (i = 0; i < Config->PendingReads; i++) {
+			if (Run->Reads[i].Request != NULL && AmtPtpHostIsRequestCompleted(Run->Reads[i].Request, &Status, NULL)) {
+				Read = &Run->Reads[i];
+				break;
+			}
+		}
+
+		if (Read == NULL) {
+			if (Pending == 0) {
+				Result->Disposed++;
+			}
+			else {
+				Result->DecodeFailures++;
+			}
+			continue;
+		}
+
+		AmtPtpHostReleaseRequest(Read->Request);
+		Read->Request = NULL;
+		Pending--;
+		if (!NT_SUCCESS(Status)) {
+			Result->DecodeFailures++;
+			continue;
+		}
+
+		AmtPtpLoadRecord(Result, Done - Arrival);
+
+		Seed ^= Seed << 13; Seed ^= Seed >> 17; Seed ^= Seed << 5;
+		Read->Return = Done + Config->ConsumerTime +
+			(Config->ConsumerJitter ? Seed % (Config->ConsumerJitter + 1) : 0) +
+			(Config->StallPeriod && Result->Completed % Config->StallPeriod == 0 ? Config->StallTime : 0);
+	}
+
+	AmtPtpLoadStop(Run);
+	free(Run);
+	return Failed;
+}
+
+uint64_t
+AmtPtpLoadPercentile(
+	const AMTPTP_LOAD_RESULT *Result,
+	double Percent
+)
+{
+	uint64_t Rank, Seen = 0, Latency;
+	uint32_t i;
+
+	if (Result->Completed == 0) {
+		return 0;
+	}
+
+	Rank = (uint64_t) (Percent / 100.0 * (double) Result->Completed + 0.5);
+	if (Rank == 0) Rank = 1;
+
+	for (i = 0; i < AMTPTP_LOAD_BUCKETS - 1; i++) {
+		Seen += Result->Histogram[i];
+		if (Seen >= Rank) {
+			Latency = (i + 1) * Result->BucketWidth;
+			return Latency < Result->Max ? Latency : Result->Max;
+		}
+	}
+
+	return Result->Max;
+}
+
+size_t
+AmtPtpLoadFormat(
+	const AMTPTP_LOAD_RESULT *Result,
+	char *Out,
+	size_t OutSize
+)
+{
+	const double Us = 1000000.0 / AMTPTP_LOAD_FREQUENCY;
+	size_t Length;
+	int w;
+
+	if (OutSize == 0) {
+		return 0;
+	}
+
+	w = snprintf(Out, OutSize,
+		"{\"product_id\":\"0x%04x\",\"rate_hz\":%u,\"pending_reads\":%u,\"frames\":%llu,\"completed\":%llu,"
+		"\"disposed\":%llu,\"reader_drops\":%llu,\"decode_failures\":%llu,"
+		"\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}",
+		(unsigned) Result->ProductId, (unsigned) Result->ReportRate, (unsigned) Result->PendingReads,
+		(unsigned long long) Result->Frames, (unsigned long long) Result->Completed,
+		(unsigned long long) Result->Disposed, (unsigned long long) Result->ReaderDrops,
+		(unsigned long long) Result->DecodeFailures,
+		(double) AmtPtpLoadPercentile(Result, 50.0) * Us,
+		(double) AmtPtpLoadPercentile(Result, 99.0) * Us,
+		(double) AmtPtpLoadPercentile(Result, 99.9) * Us,
+		(double) Result->Max * Us);
+	Length = w < 0 ? 0 : (size_t) w;
+
+	return Length < OutSize ? Length : OutSize - 1;
+}
@@ -0,0 +1,105 @@
+// AmtPtpLoad.h: Load test of the AmtPtpDeviceUsbUm report pipeline
+//
+// Runs the real driver on the host WDF shim and plays hidclass against it:
+//
+//   - hidclass keeps PendingReads IOCTL_HID_READ_REPORT requests outstanding.
+//     Each goes through the driver's default queue (Queue.c) into InputQueue.
+//     A completed read is sent again once the consumer is done with it.
+//   - Frames from AmtPtpSim reach AmtPtpEvtUsbInterruptPipeReadComplete one
+//     at a time. It decodes them, takes the next read from InputQueue
+//     (WdfIoQueueRetrieveNextRequest) and completes it, or disposes the
+//     frame when InputQueue is empty.
+//   - Up to ReaderDepth transfers can wait for the completion routine; the
+//     device loses frames beyond that.
+//
+// Time is virtual. Service and consumer times are configured in ticks of the
+// 10 MHz performance counter and the shim's clock follows them, so the
+// driver's ScanTime sees the same timeline. Latency is frame arrival to read
+// completion. Only one driver is loaded at a time, so runs must not overlap.
+
+#pragma once
+
+#include "AmtPtpSynth.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AMTPTP_LOAD_FREQUENCY		10000000
+
+// Most HID reads hidclass can have outstanding in the model
+#define AMTPTP_LOAD_MAX_READS		64
+
+// Latency histogram buckets; the last one collects everything above
+#define AMTPTP_LOAD_BUCKETS			4096
+
+typedef struct _AMTPTP_LOAD_CONFIG {
+	uint32_t ReportRate;			// Frames per second, e.g. 125, 500 or 1000
+	uint32_t Frames;
+	uint32_t PendingReads;			// Reads hidclass keeps in InputQueue
+	uint32_t ReaderDepth;			// Transfers the continuous reader can hold
+	uint64_t ServiceTime;			// Ticks the completion routine takes per frame
+	uint64_t ServiceJitter;			// Extra ticks drawn uniformly per frame
+	uint64_t ConsumerTime;			// Ticks before hidclass sends a completed read back
+	uint64_t ConsumerJitter;		// Extra ticks drawn uniformly per report
+	uint32_t StallPeriod;			// Every Nth report the consumer stalls, 0 for never
+	uint64_t StallTime;				// Extra ticks of such a stall
+	uint64_t BucketWidth;			// Ticks per histogram bucket
+	AMTPTP_GESTURE_SCRIPT Script;	// Width and Height are taken from the device
+} AMTPTP_LOAD_CONFIG, *PAMTPTP_LOAD_CONFIG;
+
+typedef struct _AMTPTP_LOAD_RESULT {
+	uint16_t ProductId;
+	uint32_t ReportRate;
+	uint32_t PendingReads;
+	uint64_t BucketWidth;
+	uint64_t Frames;
+	uint64_t Completed;				// Reads completed with a report
+	uint64_t Disposed;				// Frames that found InputQueue empty
+	uint64_t ReaderDrops;			// Frames lost before the completion routine
+	uint64_t DecodeFailures;		// Frames the driver dropped with reads pending
+	uint64_t Min;
+	uint64_t Max;
+	uint64_t Total;
+	uint32_t Histogram[AMTPTP_LOAD_BUCKETS];
+} AMTPTP_LOAD_RESULT, *PAMTPTP_LOAD_RESULT;
+
+// Fills Config with one second at ReportRate, two pending reads, a 20 us
+// completion routine and a 1 ms consumer.
+void
+AmtPtpLoadInitConfig(
+	PAMTPTP_LOAD_CONFIG Config,
+	uint32_t ReportRate
+);
+
+// Loads the driver, binds it to a simulated trackpad with ProductId and plays
+// Config against it. Returns 0 on success, non-zero if the configuration
+// cannot be simulated, ProductId is not in Bcm5974ConfigTable or the driver
+// fails to start.
+int
+AmtPtpLoadRun(
+	uint16_t ProductId,
+	const AMTPTP_LOAD_CONFIG *Config,
+	PAMTPTP_LOAD_RESULT Result
+);
+
+// Latency below which Percent of the completed reads fall, rounded up to the
+// bucket boundary and capped at Max
+uint64_t
+AmtPtpLoadPercentile(
+	const AMTPTP_LOAD_RESULT *Result,
+	double Percent
+);
+
+// Formats one result as a single-line JSON object with p50, p99 and p99.9
+// latencies in microseconds, like AmtPtpBenchFormat.
+size_t
+AmtPtpLoadFormat(
+	const AMTPTP_LOAD_RESULT *Result,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
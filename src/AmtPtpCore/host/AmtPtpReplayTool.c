@@ -0,0 +1,214 @@
+// AmtPtpReplayTool.c: Replays a capture through the frame path of a driver build
+//
+//   AmtPtpReplay<Driver> [-pace=max|recorded] [-family=pppp] [-out=Reports] Capture
+//
+// Runs Capture through the family row the linked driver build has for the
+// product in its header (AmtPtpFamilies.h), or for product pppp, with
+// AmtPtpReplayCapture. Reports holds the report stream: one ReportSize-byte
+// PTP_REPORT per decoded frame, the format of the golden .reports files.
+//   -pace=max       as fast as the host can, the default
+//   -pace=recorded  each report leaves at its recorded offset from the first
+//                   frame on CLOCK_MONOTONIC, as the device delivered them
+// Prints one JSON object on stdout: frame and report counts, wall time and
+// frames per second, and for recorded pacing how late reports left.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <driver.h>
+
+#include "AmtPtpCaptureFile.h"
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpReplay.h"
+
+#define AMTPTP_REPLAY_OUT_BUFFER	(1024 * 1024)
+
+typedef struct _AMTPTP_REPLAY_TOOL {
+	FILE *Out;
+	int Recorded;
+	int WriteFailed;
+	uint64_t Frequency;				// Capture counter ticks per second
+	uint64_t Start;					// ns on CLOCK_MONOTONIC
+	uint64_t LateMax;				// ns
+	uint64_t LateTotal;
+} AMTPTP_REPLAY_TOOL;
+
+static uint64_t
+AmtPtpReplayNow(
+	void
+)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t) Now.tv_sec * 1000000000ull + (uint64_t) Now.tv_nsec;
+}
+
+// Split so hours of ticks at a GHz counter do not overflow
+static uint64_t
+AmtPtpReplayTicksToNs(
+	uint64_t Ticks,
+	uint64_t Frequency
+)
+{
+	return Ticks / Frequency * 1000000000ull + Ticks % Frequency * 1000000000ull / Frequency;
+}
+
+static int
+AmtPtpReplayToolSink(
+	void *Context,
+	const AMTPTP_REPLAY_FRAME *Replay
+)
+{
+	AMTPTP_REPLAY_TOOL *Tool = Context;
+	struct timespec Until;
+	uint64_t Due, Now;
+
+	if (Tool->Recorded) {
+		Due = Tool->Start + AmtPtpReplayTicksToNs(Replay->Elapsed, Tool->Frequency);
+		Until.tv_sec = (time_t) (Due / 1000000000ull);
+		Until.tv_nsec = (long) (Due % 1000000000ull);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Until, NULL) == EINTR);
+
+		Now = AmtPtpReplayNow();
+		if (Now > Due) {
+			Tool->LateTotal += Now - Due;
+			if (Now - Due > Tool->LateMax) {
+				Tool->LateMax = Now - Due;
+			}
+		}
+	}
+
+	if (Tool->Out != NULL && Replay->ReportSize != 0 &&
+		fwrite(Replay->Report, 1, Replay->ReportSize, Tool->Out) != Replay->ReportSize) {
+		Tool->WriteFailed = 1;
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_BENCH_FAMILY Families[AMTPTP_HOST_MAX_FAMILIES];
+	AMTPTP_REPLAY_TOOL Tool;
+	AMTPTP_CAPTURE_READER Reader;
+	AMTPTP_CAPTURE_STATUS Status;
+	AMTPTP_CAPTURE_MAP Map;
+	AMTPTP_REPLAY_STATS Stats;
+	const AMTPTP_BENCH_FAMILY *Family = NULL;
+	const char *OutPath = NULL, *Product = NULL;
+	WDFDRIVER Driver = NULL;
+	size_t FamilyCount, f;
+	uint64_t Elapsed;
+	char Wanted[8];
+	int Arg, Error;
+
+	memset(&Tool, 0, sizeof(Tool));
+
+	for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++) {
+		if (strcmp(argv[Arg], "-pace=max") == 0) {
+			Tool.Recorded = 0;
+		}
+		else if (strcmp(argv[Arg], "-pace=recorded") == 0) {
+			Tool.Recorded = 1;
+		}
+		else if (strncmp(argv[Arg], "-family=", 8) == 0) {
+			Product = argv[Arg] + 8;
+		}
+		else if (strncmp(argv[Arg], "-out=", 5) == 0) {
+			OutPath = argv[Arg] + 5;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (Arg != argc - 1) {
+		fprintf(stderr, "usage: %s [-pace=max|recorded] [-family=pppp] [-out=Reports] Capture\n", argv[0]);
+		return 2;
+	}
+
+	Error = AmtPtpCaptureMap(argv[Arg], &Map);
+	if (Error != 0) {
+		fprintf(stderr, "%s: %s\n", argv[Arg], strerror(Error));
+		return 1;
+	}
+	if (AmtPtpCaptureOpen(&Reader, Map.Base, Map.Size) != AmtPtpCaptureOk) {
+		fprintf(stderr, "%s: not a capture\n", argv[Arg]);
+		return 1;
+	}
+
+	Tool.Frequency = Reader.Device.TimestampFrequency;
+	if (Tool.Recorded && Tool.Frequency == 0) {
+		fprintf(stderr, "%s: no timestamp frequency recorded, cannot pace\n", argv[Arg]);
+		return 1;
+	}
+
+	if (AmtPtpHostLoadDriver(DriverEntry, &Driver) != STATUS_SUCCESS) {
+		fprintf(stderr, "%s: DriverEntry failed\n", AmtPtpHostFamilyDriver);
+		return 1;
+	}
+	FamilyCount = AmtPtpHostGetFamilies(Driver, Families, AMTPTP_HOST_MAX_FAMILIES);
+
+	snprintf(Wanted, sizeof(Wanted), "%04x", (unsigned) Reader.Device.IdProduct);
+	for (f = 0; f < FamilyCount && Family == NULL; f++) {
+		if (strcmp(Families[f].Name + strlen(AmtPtpHostFamilyDriver) + 1, Product ? Product : Wanted) == 0) {
+			Family = &Families[f];
+		}
+	}
+	if (Family == NULL) {
+		fprintf(stderr, "%s: no family %s\n", AmtPtpHostFamilyDriver, Product ? Product : Wanted);
+		AmtPtpHostUnloadDriver(Driver);
+		return 1;
+	}
+
+	if (OutPath != NULL) {
+		Tool.Out = fopen(OutPath, "wb");
+		if (Tool.Out == NULL) {
+			fprintf(stderr, "%s: %s\n", OutPath, strerror(errno));
+			AmtPtpHostUnloadDriver(Driver);
+			return 1;
+		}
+		setvbuf(Tool.Out, NULL, _IOFBF, AMTPTP_REPLAY_OUT_BUFFER);
+	}
+
+	Tool.Start = AmtPtpReplayNow();
+	Status = AmtPtpReplayCapture(&Reader, Family, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON,
+		AmtPtpReplayToolSink, &Tool, &Stats);
+	if (Tool.Out != NULL && fclose(Tool.Out) != 0) {
+		Tool.WriteFailed = 1;
+	}
+	Elapsed = AmtPtpReplayNow() - Tool.Start;
+
+	printf("{\"family\":\"%s\",\"pace\":\"%s\",\"frames\":%llu,\"reports\":%llu,\"malformed\":%llu,"
+		"\"ns\":%llu,\"frames_per_s\":%.1f",
+		Family->Name, Tool.Recorded ? "recorded" : "max", (unsigned long long) Stats.Frames,
+		(unsigned long long) Stats.Reports, (unsigned long long) Stats.Malformed,
+		(unsigned long long) Elapsed, Elapsed ? Stats.Frames * 1e9 / Elapsed : 0.0);
+	if (Tool.Recorded) {
+		printf(",\"late_max_ns\":%llu,\"late_mean_ns\":%llu", (unsigned long long) Tool.LateMax,
+			(unsigned long long) (Stats.Frames ? Tool.LateTotal / Stats.Frames : 0));
+	}
+	printf("}\n");
+
+	AmtPtpHostUnloadDriver(Driver);
+	AmtPtpCaptureUnmap(&Map);
+
+	if (Tool.WriteFailed) {
+		fprintf(stderr, "%s: write failed\n", OutPath);
+		return 1;
+	}
+	if (Status != AmtPtpCaptureEnd) {
+		fprintf(stderr, "%s: damaged capture (%d)\n", argv[Arg], (int) Status);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,466 @@
+// AmtPtpResume.c: Resume to first report latency of the drivers' D0 entry
+//
+// Compiled once per driver library with that driver's headers.
+// AMTPTP_RESUME_SPIKM selects the SPI lower edge, the USB drivers share the
+// other one.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <driver.h>
+
+#include "AmtPtpHost.h"
+#include "AmtPtpResume.h"
+#include "AmtPtpSim.h"
+#include "AmtPtpSpiSim.h"
+
+void
+AmtPtpResumeInitConfig(
+	PAMTPTP_RESUME_CONFIG Config
+)
+{
+	AMTPTP_RESUME_CONFIG Empty = { 0 };
+
+	*Config = Empty;
+	Config->Cycles = 1000;
+	Config->ControlLatency = 10000;
+	Config->SuspendTime = 10000000;
+	Config->BucketWidth = 10000;
+}
+
+static uint64_t
+AmtPtpResumeJitter(
+	const AMTPTP_RESUME_CONFIG *Config,
+	uint32_t *Seed
+)
+{
+	// xorshift32, so every run sees the same latencies
+	*Seed ^= *Seed << 13; *Seed ^= *Seed >> 17; *Seed ^= *Seed << 5;
+	return Config->ControlLatency + (Config->ControlJitter ? *Seed % (Config->ControlJitter + 1) : 0);
+}
+
+static void
+AmtPtpResumeRecord(
+	PAMTPTP_RESUME_RESULT Result,
+	uint64_t Latency
+)
+{
+	uint64_t Bucket = Result->BucketWidth ? Latency / Result->BucketWidth : 0;
+
+	if (Bucket >= AMTPTP_RESUME_BUCKETS) {
+		Bucket = AMTPTP_RESUME_BUCKETS - 1;
+	}
+
+	if (Result->Reported == 0 || Latency < Result->Min) Result->Min = Latency;
+	if (Latency > Result->Max) Result->Max = Latency;
+	Result->Total += Latency;
+	Result->Reported++;
+	Result->Histogram[Bucket]++;
+}
+
+// The lower edge of the device and the one HID read hidclass keeps pending
+typedef struct _AMTPTP_RESUME_RUN {
+#ifdef AMTPTP_RESUME_SPIKM
+	AMTPTP_SPI_SIM_DEVICE Sim;
+	AMTPTP_SPI_TARGET SimTarget;
+	AMTPTP_SPI_TARGET Target;
+	uint64_t StateRequests;
+#else
+	AMTPTP_SIM_DEVICE Sim;
+	AMTPTP_USB_TRANSPORT Transport;
+#endif
+	AMTPTP_HOST_BINDING Binding;
+	WDFDEVICE Device;
+	WDFREQUEST Read;
+	PTP_REPORT Report;
+} AMTPTP_RESUME_RUN, *PAMTPTP_RESUME_RUN;
+
+#ifdef AMTPTP_RESUME_SPIKM
+
+// Counts the state requests the driver sends on their way to the trackpad
+static AMTPTP_SPI_STATUS
+AmtPtpResumeGetAttributes(
+	void *Context,
+	uint16_t *VendorId,
+	uint16_t *ProductId,
+	uint16_t *VersionNumber
+)
+{
+	PAMTPTP_RESUME_RUN Run = Context;
+
+	return Run->SimTarget.GetAttributes(Run->SimTarget.Context, VendorId, ProductId, VersionNumber);
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpResumeSetFeature(
+	void *Context,
+	uint8_t ReportId,
+	const uint8_t *Buffer,
+	uint32_t Length
+)
+{
+	PAMTPTP_RESUME_RUN Run = Context;
+
+	Run->StateRequests++;
+	return Run->SimTarget.SetFeature(Run->SimTarget.Context, ReportId, Buffer, Length);
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpResumeReadReport(
+	void *Context,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+)
+{
+	PAMTPTP_RESUME_RUN Run = Context;
+
+	return Run->SimTarget.ReadReport(Run->SimTarget.Context, Buffer, Length, Transferred);
+}
+
+#endif
+
+// Adds and starts the device. The simulated trackpad takes its wire format
+// and geometry from what the driver configured for it.
+static int
+AmtPtpResumeStart(
+	PAMTPTP_RESUME_RUN Run,
+	WDFDRIVER Driver,
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_RESUME_CONFIG *Config
+)
+{
+	PDEVICE_CONTEXT Context;
+#ifdef AMTPTP_RESUME_SPIKM
+	const AMTPTP_DECODER NoDecoder = { 0 };
+	uint16_t VendorId = 0;
+	size_t i;
+
+	// The table ends in an all-zero entry
+	for (i = 0; SpiTrackpadConfigTable[i].VendorId != 0; i++) {
+		if (SpiTrackpadConfigTable[i].ProductId == Family->ProductId) {
+			VendorId = SpiTrackpadConfigTable[i].VendorId;
+			break;
+		}
+	}
+	if (VendorId == 0) {
+		return 1;
+	}
+
+	AmtPtpSpiSimInit(&Run->Sim, VendorId, Family->ProductId, &NoDecoder);
+	AmtPtpSpiSimGetTarget(&Run->Sim, &Run->SimTarget);
+	Run->Target.Context = Run;
+	Run->Target.GetAttributes = AmtPtpResumeGetAttributes;
+	Run->Target.SetFeature = AmtPtpResumeSetFeature;
+	Run->Target.ReadReport = AmtPtpResumeReadReport;
+	AmtPtpHostInitSpiBinding(&Run->Binding, &Run->Target);
+#else
+	AMTPTP_DECODER NoDecoder = { 0 };
+	AMTPTP_MODE_SWITCH Switch = { 0 };
+
+	AmtPtpSimInit(&Run->Sim, &Switch, &NoDecoder);
+	AmtPtpSimGetTransport(&Run->Sim, &Run->Transport);
+	AmtPtpHostInitUsbBinding(&Run->Binding, &Run->Transport, USB_VENDOR_ID_APPLE, Family->ProductId);
+#endif
+
+	AmtPtpHostSetClockFrequency(Run->Sim.TimestampFrequency);
+	AmtPtpHostSetClock(Run->Sim.Clock);
+	if (!NT_SUCCESS(AmtPtpHostAddDevice(Driver, &Run->Binding, &Run->Device))) {
+		Run->Device = NULL;
+		return 1;
+	}
+	if (!NT_SUCCESS(AmtPtpHostPrepareHardware(Run->Device))) {
+		return 1;
+	}
+
+	Context = DeviceGetContext(Run->Device);
+	Run->Sim.Decoder = Context->Decoder;
+#ifdef AMTPTP_RESUME_SPIKM
+	Run->Sim.Script.Width = Context->TrackpadInfo.XMax - Context->TrackpadInfo.XMin;
+	Run->Sim.Script.Height = Context->TrackpadInfo.YMax - Context->TrackpadInfo.YMin;
+#else
+	Run->Sim.Switch.Size = (uint32_t) Context->DeviceInfo->um_size;
+	Run->Sim.Switch.RequestValue = (uint16_t) Context->DeviceInfo->um_req_val;
+	Run->Sim.Switch.RequestIndex = (uint16_t) Context->DeviceInfo->um_req_idx;
+	Run->Sim.Switch.SwitchIndex = (uint32_t) Context->DeviceInfo->um_switch_idx;
+	Run->Sim.Switch.SwitchOn = (uint8_t) Context->DeviceInfo->um_switch_on;
+	Run->Sim.Switch.SwitchOff = (uint8_t) Context->DeviceInfo->um_switch_off;
+	Run->Sim.Script.Width = Context->DeviceInfo->x.max - Context->DeviceInfo->x.min;
+	Run->Sim.Script.Height = Context->DeviceInfo->y.max - Context->DeviceInfo->y.min;
+
+	// TYPE3 trackpads stream without a mode switch
+	if (Context->DeviceInfo->tp_type == TYPE3) {
+		Run->Sim.IsWellspringModeOn = 1;
+	}
+	Run->Sim.Faults.StallPeriod = Config->StallPeriod;
+#endif
+	Run->Sim.Faults.SettleLatency = Config->SettleLatency;
+	Run->Sim.Faults.ControlLatency = Config->ControlLatency;
+
+	return !NT_SUCCESS(AmtPtpHostD0Entry(Run->Device, WdfPowerDeviceD3));
+}
+
+static void
+AmtPtpResumeStop(
+	PAMTPTP_RESUME_RUN Run
+)
+{
+	if (Run->Device != NULL) {
+		AmtPtpHostD0Exit(Run->Device, WdfPowerDeviceD3);
+		AmtPtpHostRemoveDevice(Run->Device);
+	}
+	if (Run->Read != NULL) {
+		AmtPtpHostReleaseRequest(Run->Read);
+	}
+}
+
+// Sends the HID read unless one is pending
+static int
+AmtPtpResumeSendRead(
+	PAMTPTP_RESUME_RUN Run
+)
+{
+	if (Run->Read != NULL) {
+		return 0;
+	}
+
+	if (!NT_SUCCESS(AmtPtpHostCreateRequest(Run->Device, IOCTL_HID_READ_REPORT, NULL, 0,
+		&Run->Report, sizeof(Run->Report), NULL, &Run->Read))) {
+		Run->Read = NULL;
+		return 1;
+	}
+
+	AmtPtpHostSendRequest(Run->Read);
+	return 0;
+}
+
+// Takes the read back once completed. Returns 1 for a report, 0 otherwise.
+static int
+AmtPtpResumeCollect(
+	PAMTPTP_RESUME_RUN Run,
+	int *Completed
+)
+{
+	NTSTATUS Status;
+	ULONG_PTR Information;
+
+	*Completed = Run->Read != NULL && AmtPtpHostIsRequestCompleted(Run->Read, &Status, &Information);
+	if (!*Completed) {
+		return 0;
+	}
+
+	AmtPtpHostReleaseRequest(Run->Read);
+	Run->Read = NULL;
+	return NT_SUCCESS(Status) && Information == sizeof(PTP_REPORT) &&
+		Run->Report.ReportID == REPORTID_MULTITOUCH;
+}
+
+// One transfer or packet on the bus. Returns non-zero when nothing more will arrive.
+static int
+AmtPtpResumeDeliver(
+	PAMTPTP_RESUME_RUN Run
+)
+{
+#ifdef AMTPTP_RESUME_SPIKM
+	return AmtPtpHostSpiCompleteReads(Run->Device, 1) == 0;
+#else
+	// Still in HID mouse mode; nothing arrives until the next mode switch
+	return AmtPtpHostUsbReadPipe(Run->Device) == STATUS_NO_MORE_ENTRIES;
+#endif
+}
+
+static int
+AmtPtpResumeCycle(
+	PAMTPTP_RESUME_RUN Run,
+	const AMTPTP_RESUME_CONFIG *Config,
+	PAMTPTP_RESUME_RESULT Result
+)
+{
+	uint64_t Start;
+	uint32_t Reads;
+	int Completed;
+#ifdef AMTPTP_RESUME_SPIKM
+	uint64_t StateRequests;
+#else
+	uint64_t Stalls;
+#endif
+
+	AmtPtpHostSetClock(Run->Sim.Clock);
+	// The USB drivers fail D0 exit when switching the mode off stalls. The
+	// device still goes to D3 here, so that one stall does not end the run.
+	if (!NT_SUCCESS(AmtPtpHostD0Exit(Run->Device, WdfPowerDeviceD3))) {
+		Result->ExitFailures++;
+	}
+	AmtPtpResumeCollect(Run, &Completed);
+
+#ifdef AMTPTP_RESUME_SPIKM
+	// The rail goes at D0 exit and comes back one tick after the state
+	// request of D0 entry. A loss time of 0 means none, so never start there.
+	if (Config->PowerLoss) {
+		Run->Sim.Faults.RailLossTime = Run->Sim.Clock ? Run->Sim.Clock : 1;
+		Run->Sim.Faults.RailLossDuration = Config->SuspendTime + Run->Sim.Faults.ControlLatency + 1;
+	}
+#endif
+	Run->Sim.Clock += Config->SuspendTime;
+
+	Start = Run->Sim.Clock;
+	AmtPtpHostSetClock(Start);
+#ifdef AMTPTP_RESUME_SPIKM
+	StateRequests = Run->StateRequests;
+	if (!NT_SUCCESS(AmtPtpHostD0Entry(Run->Device, WdfPowerDeviceD3))) {
+		return 1;
+	}
+	if (DeviceGetContext(Run->Device)->DeviceStatus != D0ActiveAndConfigured) {
+		Result->SwitchFailures++;
+	}
+	Result->ControlRequests += Run->StateRequests - StateRequests;
+	StateRequests = Run->StateRequests;
+#else
+	Stalls = Run->Sim.Stalls;
+	if (!NT_SUCCESS(AmtPtpHostD0Entry(Run->Device, WdfPowerDeviceD3))) {
+		return 1;
+	}
+	if (Run->Sim.Stalls != Stalls || (Run->Sim.Switch.Size && !Run->Sim.IsWellspringModeOn)) {
+		Result->SwitchFailures++;
+	}
+#endif
+
+	for (Reads = 0; Reads < AMTPTP_RESUME_MAX_READS; Reads++) {
+		if (AmtPtpResumeSendRead(Run)) {
+			return 1;
+		}
+
+		AmtPtpHostSetClock(Run->Sim.Clock);
+		if (AmtPtpResumeDeliver(Run)) {
+			break;
+		}
+
+		if (AmtPtpResumeCollect(Run, &Completed)) {
+			AmtPtpResumeRecord(Result, Run->Sim.Clock - Start);
+			break;
+		}
+		Result->DiscardedFrames++;
+	}
+
+	if (Reads == AMTPTP_RESUME_MAX_READS || Run->Read != NULL) {
+		Result->Dead++;
+	}
+
+#ifdef AMTPTP_RESUME_SPIKM
+	Result->Retries += (uint32_t) (Run->StateRequests - StateRequests);
+	Result->ControlRequests += Run->StateRequests - StateRequests;
+	Run->Sim.Faults.RailLossTime = 0;
+#endif
+	return 0;
+}
+
+int
+AmtPtpResumeRun(
+	WDFDRIVER Driver,
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_RESUME_CONFIG *Config,
+	PAMTPTP_RESUME_RESULT Result
+)
+{
+	AMTPTP_RESUME_RESULT Empty = { 0 };
+	PAMTPTP_RESUME_RUN Run;
+	uint32_t Seed = 2463534242u;
+	uint32_t Cycle;
+	int Failed;
+
+	*Result = Empty;
+	Result->Family = Family->Name;
+	Result->BucketWidth = Config->BucketWidth;
+	Result->Cycles = Config->Cycles;
+#ifdef AMTPTP_RESUME_SPIKM
+	Result->Driver = "spi";
+#else
+	Result->Driver = "usb";
+#endif
+
+	Run = calloc(1, sizeof(*Run));
+	if (Run == NULL) {
+		return 1;
+	}
+
+	Failed = AmtPtpResumeStart(Run, Driver, Family, Config);
+	Result->TimestampFrequency = Run->Sim.TimestampFrequency;
+
+	// The USB drivers' control transfers are all counted by the trackpad
+#ifndef AMTPTP_RESUME_SPIKM
+	Run->Sim.ControlTransfers = 0;
+#endif
+
+	for (Cycle = 0; !Failed && Cycle < Config->Cycles; Cycle++) {
+		Run->Sim.Faults.ControlLatency = AmtPtpResumeJitter(Config, &Seed);
+		Failed = AmtPtpResumeCycle(Run, Config, Result);
+	}
+
+#ifndef AMTPTP_RESUME_SPIKM
+	Result->ControlRequests = Run->Sim.ControlTransfers;
+#endif
+
+	AmtPtpResumeStop(Run);
+	free(Run);
+	return Failed;
+}
+
+uint64_t
+AmtPtpResumePercentile(
+	const AMTPTP_RESUME_RESULT *Result,
+	double Percent
+)
+{
+	uint64_t Rank, Seen = 0, Latency;
+	uint32_t i;
+
+	if (Result->Reported == 0) {
+		return 0;
+	}
+
+	Rank = (uint64_t) (Percent / 100.0 * (double) Result->Reported + 0.5);
+	if (Rank == 0) Rank = 1;
+
+	for (i = 0; i < AMTPTP_RESUME_BUCKETS - 1; i++) {
+		Seen += Result->Histogram[i];
+		if (Seen >= Rank) {
+			Latency = (i + 1) * Result->BucketWidth;
+			return Latency < Result->Max ? Latency : Result->Max;
+		}
+	}
+
+	return Result->Max;
+}
+
+size_t
+AmtPtpResumeFormat(
+	const AMTPTP_RESUME_RESULT *Result,
+	char *Out,
+	size_t OutSize
+)
+{
+	double Us = Result->TimestampFrequency ? 1000000.0 / (double) Result->TimestampFrequency : 0.0;
+	size_t Length;
+	int w;
+
+	if (OutSize == 0) {
+		return 0;
+	}
+
+	w = snprintf(Out, OutSize,
+		"{\"family\":\"%s\",\"driver\":\"%s\",\"cycles\":%u,\"reported\":%u,\"dead\":%u,"
+		"\"exit_failures\":%u,\"switch_failures\":%u,\"retries\":%u,\"control_requests\":%llu,\"discarded_frames\":%llu,"
+		"\"min_us\":%.1f,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+		Result->Family, Result->Driver, (unsigned) Result->Cycles, (unsigned) Result->Reported,
+		(unsigned) Result->Dead, (unsigned) Result->ExitFailures, (unsigned) Result->SwitchFailures, (unsigned) Result->Retries,
+		(unsigned long long) Result->ControlRequests, (unsigned long long) Result->DiscardedFrames,
+		(double) Result->Min * Us,
+		Result->Reported ? (double) Result->Total / (double) Result->Reported * Us : 0.0,
+		(double) AmtPtpResumePercentile(Result, 50.0) * Us,
+		(double) AmtPtpResumePercentile(Result, 90.0) * Us,
+		(double) AmtPtpResumePercentile(Result, 99.0) * Us,
+		(double) Result->Max * Us);
+	Length = w < 0 ? 0 : (size_t) w;
+
+	return Length < OutSize ? Length : OutSize - 1;
+}
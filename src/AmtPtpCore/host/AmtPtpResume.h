@@ -0,0 +1,102 @@
+// AmtPtpResume.h: Resume to first report latency of the drivers' D0 entry
+//
+// Runs D0 exit, suspend and D0 entry cycles of the real driver on the host WDF
+// shim, through AmtPtpHostD0Exit and AmtPtpHostD0Entry, and measures the
+// virtual time from the start of D0 entry to the first HID read the driver
+// completes with a multitouch report. Whatever the driver's power callbacks
+// send reaches a simulated device: the USB drivers switch Wellspring mode with
+// the request of their own configuration table entry, AmtPtpDeviceSpiKm sets
+// the state feature and re-enables an unconfigured trackpad from its read
+// completion. After D0 entry the harness plays the bus, one interrupt
+// transfer or SPI read at a time, with a single HID read pending, and sends a
+// new read whenever one completes without a report.
+//
+// Time is the simulated device's clock, which the shim's performance counter
+// follows. Control latency is drawn per cycle from [ControlLatency,
+// ControlLatency + ControlJitter] with a fixed seed, so runs are
+// reproducible. Built once per driver library as AmtPtpHostResume<Driver>.
+
+#pragma once
+
+#include "AmtPtpBench.h"
+#include "AmtPtpHostWdk.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Latency histogram buckets; the last one collects everything above
+#define AMTPTP_RESUME_BUCKETS		256
+
+// Reads after D0 entry before a cycle is counted as dead
+#define AMTPTP_RESUME_MAX_READS		1024
+
+typedef struct _AMTPTP_RESUME_CONFIG {
+	uint32_t Cycles;
+	uint64_t ControlLatency;		// Ticks per control transfer or feature request
+	uint64_t ControlJitter;			// Extra ticks drawn uniformly per cycle
+	uint64_t SettleLatency;			// Ticks from mode on or enable to the first frame
+	uint64_t SuspendTime;			// Ticks spent in D3 per cycle
+	uint64_t BucketWidth;			// Ticks per histogram bucket
+	int PowerLoss;					// SPI: the rail is down in D3 and for D0 entry's state request
+	uint32_t StallPeriod;			// USB: stall every Nth control transfer, 0 for never
+} AMTPTP_RESUME_CONFIG, *PAMTPTP_RESUME_CONFIG;
+
+typedef struct _AMTPTP_RESUME_RESULT {
+	const char *Family;
+	const char *Driver;				// "usb" or "spi"
+	uint64_t TimestampFrequency;	// Ticks per second
+	uint64_t BucketWidth;
+	uint32_t Cycles;
+	uint32_t Reported;				// Cycles that reached a valid report
+	uint32_t Dead;					// Cycles without a valid report
+	uint32_t ExitFailures;			// D0 exits the driver failed
+	uint32_t SwitchFailures;		// D0 entries that left the trackpad unswitched or unconfigured
+	uint32_t Retries;				// SPI state requests the read completion sent
+	uint64_t ControlRequests;
+	uint64_t DiscardedFrames;		// Transfers read before the first report
+	uint64_t Min;
+	uint64_t Max;
+	uint64_t Total;
+	uint32_t Histogram[AMTPTP_RESUME_BUCKETS];
+} AMTPTP_RESUME_RESULT, *PAMTPTP_RESUME_RESULT;
+
+// Fills Config with 1000 cycles at 1 ms control latency on the 10 MHz
+// timestamp clock of the simulated devices.
+void
+AmtPtpResumeInitConfig(
+	PAMTPTP_RESUME_CONFIG Config
+);
+
+// Runs Config->Cycles cycles on a device of Family, a row AmtPtpHostGetFamilies
+// returned for the loaded Driver. The device is added, started and removed
+// again. Returns 0 on success, non-zero if the device does not start or a D0
+// transition fails.
+int
+AmtPtpResumeRun(
+	WDFDRIVER Driver,
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_RESUME_CONFIG *Config,
+	PAMTPTP_RESUME_RESULT Result
+);
+
+// Latency below which Percent of the reported cycles fall, rounded up to the
+// bucket boundary and capped at Max
+uint64_t
+AmtPtpResumePercentile(
+	const AMTPTP_RESUME_RESULT *Result,
+	double Percent
+);
+
+// Formats one result as a single-line JSON object with latencies in
+// microseconds, like AmtPtpBenchFormat.
+size_t
+AmtPtpResumeFormat(
+	const AMTPTP_RESUME_RESULT *Result,
+	char *Out,
+	size_t OutSize
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,119 @@
+// AmtPtpResumeTool.c: Resume to first report latency of every family of a driver build
+//
+//   AmtPtpResume<Driver> [options]
+//
+// Takes the family rows from the linked driver build (AmtPtpFamilies.h) and
+// runs AmtPtpResumeRun on each. Times are in ticks of the simulated 10 MHz
+// clock.
+//   -family=pppp      Only the family of product pppp
+//   -cycles=N         D0 exit and entry cycles per family, default 1000
+//   -control=T        Ticks per control transfer or feature request
+//   -jitter=T         Extra control ticks drawn per cycle
+//   -settle=T         Ticks from mode on or enable to the first frame
+//   -suspend=T        Ticks spent in D3 per cycle
+//   -stall=N          USB: stall every Nth control transfer
+//   -power-loss       SPI: the rail is down in D3 and for D0 entry's state request
+// Prints one JSON object per family on stdout (AmtPtpResumeFormat). Exits
+// non-zero if a family cannot be run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpResume.h"
+
+static int
+AmtPtpResumeParseNumber(
+	const char *Arg,
+	const char *Name,
+	uint64_t *Value
+)
+{
+	size_t Length = strlen(Name);
+
+	if (strncmp(Arg, Name, Length) != 0) {
+		return 0;
+	}
+
+	*Value = strtoull(Arg + Length, NULL, 0);
+	return 1;
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_BENCH_FAMILY Families[AMTPTP_HOST_MAX_FAMILIES];
+	static AMTPTP_RESUME_RESULT Result;
+	AMTPTP_RESUME_CONFIG Config;
+	const char *Product = NULL;
+	WDFDRIVER Driver = NULL;
+	size_t FamilyCount, f;
+	uint64_t Value;
+	char Line[512];
+	int Arg, Ran = 0, Failed = 0;
+
+	AmtPtpResumeInitConfig(&Config);
+
+	for (Arg = 1; Arg < argc; Arg++) {
+		if (strncmp(argv[Arg], "-family=", 8) == 0) {
+			Product = argv[Arg] + 8;
+		}
+		else if (AmtPtpResumeParseNumber(argv[Arg], "-cycles=", &Value)) {
+			Config.Cycles = (uint32_t) Value;
+		}
+		else if (AmtPtpResumeParseNumber(argv[Arg], "-control=", &Config.ControlLatency) ||
+			AmtPtpResumeParseNumber(argv[Arg], "-jitter=", &Config.ControlJitter) ||
+			AmtPtpResumeParseNumber(argv[Arg], "-settle=", &Config.SettleLatency) ||
+			AmtPtpResumeParseNumber(argv[Arg], "-suspend=", &Config.SuspendTime)) {
+			continue;
+		}
+		else if (AmtPtpResumeParseNumber(argv[Arg], "-stall=", &Value)) {
+			Config.StallPeriod = (uint32_t) Value;
+		}
+		else if (strcmp(argv[Arg], "-power-loss") == 0) {
+			Config.PowerLoss = 1;
+		}
+		else {
+			fprintf(stderr, "usage: %s [-family=pppp] [-cycles=N] [-control=T] [-jitter=T] [-settle=T] "
+				"[-suspend=T] [-stall=N] [-power-loss]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (AmtPtpHostLoadDriver(DriverEntry, &Driver) != STATUS_SUCCESS) {
+		fprintf(stderr, "%s: DriverEntry failed\n", AmtPtpHostFamilyDriver);
+		return 1;
+	}
+	FamilyCount = AmtPtpHostGetFamilies(Driver, Families, AMTPTP_HOST_MAX_FAMILIES);
+
+	for (f = 0; f < FamilyCount; f++) {
+		if (Product != NULL && strcmp(Families[f].Name + strlen(AmtPtpHostFamilyDriver) + 1, Product) != 0) {
+			continue;
+		}
+
+		Ran++;
+		if (AmtPtpResumeRun(Driver, &Families[f], &Config, &Result) != 0) {
+			fprintf(stderr, "%s: device failed to start or change power state\n", Families[f].Name);
+			Failed = 1;
+			continue;
+		}
+
+		AmtPtpResumeFormat(&Result, Line, sizeof(Line));
+		printf("%s\n", Line);
+	}
+
+	AmtPtpHostUnloadDriver(Driver);
+
+	if (Ran == 0) {
+		fprintf(stderr, "%s: no family %s\n", AmtPtpHostFamilyDriver, Product ? Product : "");
+		return 1;
+	}
+	return Failed;
+}
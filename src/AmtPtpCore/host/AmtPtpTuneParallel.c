@@ -0,0 +1,113 @@
+// AmtPtpTuneParallel.c: Threshold sweeps on every core
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "AmtPtpTuneParallel.h"
+
+typedef struct _AMTPTP_TUNE_SHARED {
+	const AMTPTP_TUNE_SAMPLE *Samples;
+	size_t Count;
+	const AMTPTP_TUNE_GRID *Grid;
+	uint64_t Size;
+	uint64_t Next;					// First index not yet claimed, atomic
+	size_t Capacity;
+} AMTPTP_TUNE_SHARED, *PAMTPTP_TUNE_SHARED;
+
+typedef struct _AMTPTP_TUNE_WORKER {
+	PAMTPTP_TUNE_SHARED Shared;
+	pthread_t Thread;
+	int Started;
+	size_t RankedCount;
+	AMTPTP_TUNE_SCORE Ranked[AMTPTP_TUNE_MAX_RANKED];
+} AMTPTP_TUNE_WORKER, *PAMTPTP_TUNE_WORKER;
+
+static void *
+AmtPtpTuneWorker(
+	void *Context
+)
+{
+	PAMTPTP_TUNE_WORKER Worker = (PAMTPTP_TUNE_WORKER) Context;
+	PAMTPTP_TUNE_SHARED Shared = Worker->Shared;
+	uint64_t First, Last;
+
+	for (;;) {
+		First = __atomic_fetch_add(&Shared->Next, AMTPTP_TUNE_CHUNK, __ATOMIC_RELAXED);
+		if (First >= Shared->Size) {
+			break;
+		}
+
+		Last = Shared->Size - First < AMTPTP_TUNE_CHUNK ? Shared->Size : First + AMTPTP_TUNE_CHUNK;
+		AmtPtpTuneSweepRanked(Shared->Samples, Shared->Count, Shared->Grid, First, Last,
+			Worker->Ranked, Shared->Capacity, &Worker->RankedCount);
+	}
+
+	return NULL;
+}
+
+size_t
+AmtPtpTuneParallelSweep(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid,
+	uint32_t Threads,
+	PAMTPTP_TUNE_SCORE Ranked,
+	size_t Capacity
+)
+{
+	AMTPTP_TUNE_WORKER Single;
+	PAMTPTP_TUNE_WORKER Workers;
+	AMTPTP_TUNE_SHARED Shared;
+	size_t RankedCount = 0, i;
+	uint32_t w;
+
+	Shared.Samples = Samples;
+	Shared.Count = Count;
+	Shared.Grid = Grid;
+	Shared.Size = AmtPtpTuneGridSize(Grid);
+	Shared.Next = 0;
+	Shared.Capacity = Capacity < AMTPTP_TUNE_MAX_RANKED ? Capacity : AMTPTP_TUNE_MAX_RANKED;
+
+	if (Shared.Size == 0 || Shared.Capacity == 0) {
+		return 0;
+	}
+	if (Threads == 0) {
+		Threads = 1;
+	}
+	if (Threads > AMTPTP_TUNE_MAX_THREADS) {
+		Threads = AMTPTP_TUNE_MAX_THREADS;
+	}
+
+	// Without memory for the workers, the calling thread sweeps alone
+	Workers = calloc(Threads, sizeof(*Workers));
+	if (Workers == NULL) {
+		Workers = &Single;
+		Threads = 1;
+	}
+
+	for (w = 0; w < Threads; w++) {
+		Workers[w].Shared = &Shared;
+		Workers[w].Started = 0;
+		Workers[w].RankedCount = 0;
+	}
+
+	// Worker 0 is the calling thread
+	for (w = 1; w < Threads; w++) {
+		Workers[w].Started = pthread_create(&Workers[w].Thread, NULL, AmtPtpTuneWorker, &Workers[w]) == 0;
+	}
+	AmtPtpTuneWorker(&Workers[0]);
+
+	for (w = 0; w < Threads; w++) {
+		if (w != 0 && Workers[w].Started) {
+			pthread_join(Workers[w].Thread, NULL);
+		}
+		for (i = 0; i < Workers[w].RankedCount; i++) {
+			AmtPtpTuneRank(Ranked, Shared.Capacity, &RankedCount, &Workers[w].Ranked[i]);
+		}
+	}
+
+	if (Workers != &Single) {
+		free(Workers);
+	}
+	return RankedCount;
+}
@@ -0,0 +1,42 @@
+// AmtPtpTuneParallel.h: Threshold sweeps on every core
+//
+// Spreads AmtPtpTuneSweepRanked over POSIX threads. Workers claim chunks of
+// AMTPTP_TUNE_CHUNK grid indices from one shared atomic counter, so fast and
+// slow workers finish together, and each keeps its own ranked list. The
+// lists are merged with AmtPtpTuneRank, whose order is total, so the result
+// is identical to a serial sweep whatever the thread count or scheduling.
+
+#pragma once
+
+#include "AmtPtpTune.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Grid indices a worker claims at a time
+#define AMTPTP_TUNE_CHUNK			256
+
+#define AMTPTP_TUNE_MAX_THREADS		64
+
+// Longest ranked list a sweep returns
+#define AMTPTP_TUNE_MAX_RANKED		64
+
+// Scores every index of Grid on Threads workers, the calling thread being
+// one of them, and writes the Capacity best scores to Ranked, best first.
+// Threads and Capacity are clamped to the limits above. Returns the number
+// of scores written; 0 for an empty grid. If threads cannot be started, the
+// workers that did start take over their share.
+size_t
+AmtPtpTuneParallelSweep(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid,
+	uint32_t Threads,
+	PAMTPTP_TUNE_SCORE Ranked,
+	size_t Capacity
+);
+
+#ifdef __cplusplus
+}
+#endif
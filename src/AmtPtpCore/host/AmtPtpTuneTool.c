@@ -0,0 +1,221 @@
+// AmtPtpTuneTool.c: Ranks qualification thresholds against labelled captures
+//
+//   AmtPtpTune [options] Capture Labels [Capture Labels ...]
+//
+// Labels holds one byte per capture record; bit n marks contact n of that
+// frame as an intended finger (AmtPtpTuneExtract). All captures must share
+// one frame format, since contact sizes are compared in its units. Each
+// threshold is pinned to the value in the first capture's header unless a
+// range is given with the name of its AMTPTP_THRESHOLDS field:
+//   -TipSwitchMajor=Min:Max:Step     and likewise for TipSwitchMinor,
+//                                    TipSwitchPressure, ConfidenceMinorMin,
+//                                    ConfidenceMinorMax, ConfidenceMajorMax
+//   -threads=N                       Workers, default one per online CPU
+//   -top=N                           Results printed, default 10
+// Prints the recorded thresholds' score, then the best grid points, best
+// first, ranked by AmtPtpTuneBetter.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "AmtPtpCaptureFile.h"
+#include "AmtPtpTuneParallel.h"
+
+typedef struct _AMTPTP_TUNE_OPTION {
+	const char *Name;
+	size_t Offset;					// Of the range in AMTPTP_TUNE_GRID
+	int Given;
+} AMTPTP_TUNE_OPTION;
+
+static AMTPTP_TUNE_OPTION AmtPtpTuneOptions[] = {
+	{ "TipSwitchMajor", offsetof(AMTPTP_TUNE_GRID, TipSwitchMajor), 0 },
+	{ "TipSwitchMinor", offsetof(AMTPTP_TUNE_GRID, TipSwitchMinor), 0 },
+	{ "TipSwitchPressure", offsetof(AMTPTP_TUNE_GRID, TipSwitchPressure), 0 },
+	{ "ConfidenceMinorMin", offsetof(AMTPTP_TUNE_GRID, ConfidenceMinorMin), 0 },
+	{ "ConfidenceMinorMax", offsetof(AMTPTP_TUNE_GRID, ConfidenceMinorMax), 0 },
+	{ "ConfidenceMajorMax", offsetof(AMTPTP_TUNE_GRID, ConfidenceMajorMax), 0 },
+};
+
+#define AMTPTP_TUNE_OPTION_COUNT (sizeof(AmtPtpTuneOptions) / sizeof(AmtPtpTuneOptions[0]))
+
+static PAMTPTP_TUNE_RANGE
+AmtPtpTuneRangeOf(
+	PAMTPTP_TUNE_GRID Grid,
+	size_t Option
+)
+{
+	return (PAMTPTP_TUNE_RANGE) ((uint8_t *) Grid + AmtPtpTuneOptions[Option].Offset);
+}
+
+// Parses -Name=Min:Max:Step into Grid. Returns 0 if Arg is no range option.
+static int
+AmtPtpTuneParseRange(
+	const char *Arg,
+	PAMTPTP_TUNE_GRID Grid
+)
+{
+	PAMTPTP_TUNE_RANGE Range;
+	size_t i, Length;
+	long Min, Max, Step;
+	char End;
+
+	for (i = 0; i < AMTPTP_TUNE_OPTION_COUNT; i++) {
+		Length = strlen(AmtPtpTuneOptions[i].Name);
+		if (strncmp(Arg + 1, AmtPtpTuneOptions[i].Name, Length) != 0 || Arg[1 + Length] != '=') {
+			continue;
+		}
+
+		if (sscanf(Arg + 2 + Length, "%ld:%ld:%ld%c", &Min, &Max, &Step, &End) != 3 || Max < Min || Step < 0) {
+			fprintf(stderr, "%s: expected Min:Max:Step with Min <= Max and Step >= 0\n", Arg);
+			exit(2);
+		}
+
+		Range = AmtPtpTuneRangeOf(Grid, i);
+		Range->Min = (int32_t) Min;
+		Range->Max = (int32_t) Max;
+		Range->Step = (int32_t) Step;
+		AmtPtpTuneOptions[i].Given = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+AmtPtpTunePrint(
+	const char *Label,
+	const AMTPTP_TUNE_SCORE *Score
+)
+{
+	const AMTPTP_THRESHOLDS *t = &Score->Thresholds;
+
+	printf("%-9s %7llu %7llu %7llu  %6d %6d %6d %6d %6d %6d\n", Label,
+		(unsigned long long) (Score->FalseTouches + Score->MissedTouches),
+		(unsigned long long) Score->FalseTouches, (unsigned long long) Score->MissedTouches,
+		(int) t->TipSwitchMajor, (int) t->TipSwitchMinor, (int) t->TipSwitchPressure,
+		(int) t->ConfidenceMinorMin, (int) t->ConfidenceMinorMax, (int) t->ConfidenceMajorMax);
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_TUNE_SCORE Ranked[AMTPTP_TUNE_MAX_RANKED];
+	AMTPTP_CAPTURE_READER Reader;
+	AMTPTP_CAPTURE_MAP Capture, Labels;
+	AMTPTP_TUNE_GRID Grid;
+	AMTPTP_TUNE_SCORE Recorded;
+	AMTPTP_DECODER Decoder;
+	AMTPTP_CAPTURE_STATUS Status;
+	PAMTPTP_TUNE_SAMPLE Samples = NULL;
+	size_t Count = 0, Capacity = 0, RankedCount, i;
+	uint32_t Threads;
+	long Online = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned long Top = 10;
+	int32_t Pinned[AMTPTP_TUNE_OPTION_COUNT];
+	int Arg, Captures = 0;
+	char Label[16];
+
+	memset(&Grid, 0, sizeof(Grid));
+	memset(&Decoder, 0, sizeof(Decoder));
+	Threads = Online > 0 ? (uint32_t) Online : 1;
+
+	for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++) {
+		if (strncmp(argv[Arg], "-threads=", 9) == 0) {
+			Threads = (uint32_t) strtoul(argv[Arg] + 9, NULL, 0);
+		}
+		else if (strncmp(argv[Arg], "-top=", 5) == 0) {
+			Top = strtoul(argv[Arg] + 5, NULL, 0);
+		}
+		else if (!AmtPtpTuneParseRange(argv[Arg], &Grid)) {
+			fprintf(stderr, "%s: unknown option\n", argv[Arg]);
+			return 2;
+		}
+	}
+
+	if (Arg == argc || (argc - Arg) % 2 != 0) {
+		fprintf(stderr, "usage: %s [options] Capture Labels [Capture Labels ...]\n", argv[0]);
+		return 2;
+	}
+
+	for (; Arg < argc; Arg += 2) {
+		if (AmtPtpCaptureMap(argv[Arg], &Capture) != 0 || AmtPtpCaptureMap(argv[Arg + 1], &Labels) != 0) {
+			fprintf(stderr, "%s: cannot read it or its labels\n", argv[Arg]);
+			return 1;
+		}
+		if (AmtPtpCaptureOpen(&Reader, Capture.Base, Capture.Size) != AmtPtpCaptureOk) {
+			fprintf(stderr, "%s: not a capture\n", argv[Arg]);
+			return 1;
+		}
+
+		if (Captures++ == 0) {
+			Decoder = Reader.Device.Decoder;
+		}
+		else if (Reader.Device.Decoder.Format != Decoder.Format) {
+			fprintf(stderr, "%s: frame format differs from %s\n", argv[Arg], argv[Arg - 2]);
+			return 1;
+		}
+
+		// A record takes at least AMTPTP_CAPTURE_RECORD_SIZE bytes
+		Capacity += (Capture.Size / AMTPTP_CAPTURE_RECORD_SIZE + 1) * AMTPTP_MAX_CONTACTS;
+		Samples = realloc(Samples, Capacity * sizeof(*Samples));
+		if (Samples == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+
+		Status = AmtPtpTuneExtract(&Reader, Labels.Base, Labels.Size, Samples, Capacity, &Count);
+		if (Status != AmtPtpCaptureOk) {
+			fprintf(stderr, "%s: damaged capture (%d)\n", argv[Arg], (int) Status);
+			return 1;
+		}
+
+		AmtPtpCaptureUnmap(&Capture);
+		AmtPtpCaptureUnmap(&Labels);
+	}
+
+	// Thresholds without a range stay what the first capture recorded
+	Pinned[0] = Decoder.Thresholds.TipSwitchMajor;
+	Pinned[1] = Decoder.Thresholds.TipSwitchMinor;
+	Pinned[2] = Decoder.Thresholds.TipSwitchPressure;
+	Pinned[3] = Decoder.Thresholds.ConfidenceMinorMin;
+	Pinned[4] = Decoder.Thresholds.ConfidenceMinorMax;
+	Pinned[5] = Decoder.Thresholds.ConfidenceMajorMax;
+	for (i = 0; i < AMTPTP_TUNE_OPTION_COUNT; i++) {
+		if (!AmtPtpTuneOptions[i].Given) {
+			PAMTPTP_TUNE_RANGE Range = AmtPtpTuneRangeOf(&Grid, i);
+
+			Range->Min = Range->Max = Pinned[i];
+			Range->Step = 0;
+		}
+	}
+
+	if (AmtPtpTuneGridSize(&Grid) == 0) {
+		fprintf(stderr, "grid is empty or too large\n");
+		return 2;
+	}
+
+	Count = AmtPtpTuneCompact(Samples, Count);
+	AmtPtpTuneEvaluate(Samples, Count, &Decoder.Thresholds, &Recorded);
+	RankedCount = AmtPtpTuneParallelSweep(Samples, Count, &Grid, Threads, Ranked,
+		Top < AMTPTP_TUNE_MAX_RANKED ? (size_t) Top : AMTPTP_TUNE_MAX_RANKED);
+
+	printf("%d capture(s), %zu distinct samples, %llu touches, %llu others, %llu grid points, %u threads\n",
+		Captures, Count, (unsigned long long) Recorded.Touches, (unsigned long long) Recorded.Others,
+		(unsigned long long) AmtPtpTuneGridSize(&Grid), (unsigned) Threads);
+	printf("%-9s %7s %7s %7s  %6s %6s %6s %6s %6s %6s\n", "rank", "errors", "false", "missed",
+		"TSMaj", "TSMin", "TSPres", "CMinLo", "CMinHi", "CMajHi");
+	AmtPtpTunePrint("recorded", &Recorded);
+	for (i = 0; i < RankedCount; i++) {
+		snprintf(Label, sizeof(Label), "%zu", i + 1);
+		AmtPtpTunePrint(Label, &Ranked[i]);
+	}
+
+	free(Samples);
+	return 0;
+}
@@ -0,0 +1,5 @@
+// usbdlib.h: host stand-in, see AmtPtpHostWdk.h
+
+#pragma once
+
+#include "AmtPtpHostWdk.h"
@@ -0,0 +1,5 @@
+// wdfusb.h: host stand-in, see AmtPtpHostWdk.h
+
+#pragma once
+
+#include "AmtPtpHostWdk.h"
@@ -0,0 +1,315 @@
+// AmtPtpBatchTest.c: Every batch decode kernel against AmtPtpDecodeFrame
+//
+// Decodes synthetic gestures and random frames of every family with each
+// kernel compiled into this build, starting from the one AmtPtpBatchInit
+// selects. The first AMTPTP_MAX_CONTACTS lanes must match AmtPtpDecodeFrame
+// field for field, and every kernel must produce the scalar kernel's batch
+// bit for bit, including the lanes past the PTP contact limit. Built once
+// per driver, whose own configuration supplies the families.
+
+#include <driver.h>
+
+#include "AmtPtpBatch.h"
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpLayout.h"
+#include "AmtPtpSynth.h"
+#include "AmtPtpTest.h"
+
+// Larger than the frame of any family with 16 fingers
+#define AMTPTP_TEST_FRAME_MAX		1024
+#define AMTPTP_TEST_RANDOM_FRAMES	2000
+
+static unsigned long AmtPtpTestFrames;
+
+// Decodes Frame with every kernel and checks them against the reference
+static void
+AmtPtpTestFrame(
+	const AMTPTP_DECODER *Decoder,
+	const uint8_t *Frame,
+	size_t Length
+)
+{
+	AMTPTP_BATCH_DECODER batch;
+	AMTPTP_CONTACT_BATCH scalar, contacts;
+	AMTPTP_DECODE_STATUS expected;
+	AMTPTP_FRAME reference;
+	AMTPTP_BATCH_KERNEL kernel;
+	size_t records;
+	uint32_t i;
+
+	expected = AmtPtpDecodeFrame(Decoder, Frame, Length, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &reference);
+
+	AmtPtpBatchInit(&batch, Decoder);
+	AMTPTP_CHECK(AmtPtpBatchKernelAvailable(batch.Kernel));
+	batch.Kernel = AmtPtpBatchKernelScalar;
+	AMTPTP_CHECK_EQ(AmtPtpBatchDecode(&batch, Frame, Length, &scalar), expected);
+
+	if (expected == AmtPtpDecodeOk) {
+		// AmtPtpDecodeFrame stops at the PTP limit, the batch at the frame's records
+		records = (Length - Decoder->HeaderSize) / Decoder->FingerSize;
+		if (Decoder->Format == AmtPtpFrameFormatSpi && Frame[SPI_NUM_OF_FINGERS] < records) {
+			records = Frame[SPI_NUM_OF_FINGERS];
+		}
+		AMTPTP_CHECK_EQ(scalar.Count, records < AMTPTP_BATCH_MAX_CONTACTS ? records : AMTPTP_BATCH_MAX_CONTACTS);
+		AMTPTP_CHECK_EQ(scalar.Count < AMTPTP_MAX_CONTACTS ? scalar.Count : AMTPTP_MAX_CONTACTS, reference.ContactCount);
+		AMTPTP_CHECK_EQ(scalar.IsButtonClicked, reference.IsButtonClicked);
+
+		for (i = 0; i < scalar.Count && i < AMTPTP_MAX_CONTACTS; i++) {
+			AMTPTP_CHECK_EQ(scalar.X[i], reference.Contacts[i].X);
+			AMTPTP_CHECK_EQ(scalar.Y[i], reference.Contacts[i].Y);
+			AMTPTP_CHECK_EQ(scalar.ContactID[i], reference.Contacts[i].ContactID);
+			AMTPTP_CHECK_EQ(scalar.TipSwitch[i], reference.Contacts[i].TipSwitch);
+			AMTPTP_CHECK_EQ(scalar.Confidence[i], reference.Contacts[i].Confidence);
+		}
+	}
+
+	for (kernel = AmtPtpBatchKernelScalar; kernel < AmtPtpBatchKernelCount; kernel++) {
+		if (!AmtPtpBatchKernelAvailable(kernel)) {
+			continue;
+		}
+
+		memset(&contacts, 0xCC, sizeof(contacts));
+		batch.Kernel = kernel;
+		AMTPTP_CHECK_EQ(AmtPtpBatchDecode(&batch, Frame, Length, &contacts), expected);
+		// The struct is padded after IsButtonClicked; the arrays are not
+		if (contacts.Count != scalar.Count || contacts.IsButtonClicked != scalar.IsButtonClicked ||
+			memcmp(contacts.X, scalar.X, sizeof(scalar) - offsetof(AMTPTP_CONTACT_BATCH, X)) != 0) {
+			AMTPTP_CHECK(!"kernel differs from scalar");
+			fprintf(stderr, "  kernel %s, format %d, %zu bytes\n", AmtPtpBatchKernelName(kernel),
+				(int) Decoder->Format, Length);
+		}
+	}
+
+	AmtPtpTestFrames++;
+}
+
+static void
+AmtPtpTestGestures(
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_DECODER *Decoder
+)
+{
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX];
+	AMTPTP_GESTURE_SCRIPT script;
+	AMTPTP_SYNTH_FRAME synth;
+	uint32_t maxFingers, fingers, i;
+	size_t length;
+
+	maxFingers = Decoder->Format == AmtPtpFrameFormatSpi ? AMTPTP_SYNTH_SPI_MAX_FINGERS : AMTPTP_SYNTH_MAX_FINGERS;
+
+	for (fingers = 1; fingers <= maxFingers; fingers++) {
+		script.Gesture = (AMTPTP_GESTURE) (fingers % 5);
+		script.Fingers = fingers;
+		script.Width = Family->XMax - Decoder->XMin;
+		script.Height = Decoder->YMax - Decoder->YMin;
+		script.Frames = 16;
+
+		for (i = 0; i < script.Frames; i++) {
+			AmtPtpSynthGestureFrame(&script, i, &synth);
+			synth.Button = (uint8_t) (i & 1);
+			length = AmtPtpSynthEncodeFrame(Decoder, &synth, frame, sizeof(frame));
+			AMTPTP_CHECK(length != 0);
+			AmtPtpTestFrame(Decoder, frame, length);
+		}
+	}
+}
+
+// One threshold on a size of the frame or next to it, or zero (disabled)
+static int32_t
+AmtPtpTestThreshold(
+	int32_t Size,
+	PAMTPTP_TEST_RANDOM Random
+)
+{
+	if ((AmtPtpTestNext(Random) & 3) == 0) {
+		return 0;
+	}
+	return Size + (int32_t) (AmtPtpTestNext(Random) % 3) - 1;
+}
+
+// Random records reach the sign, clamp and threshold edges gestures never do.
+// Lengths are whole frames most of the time and anything up to one record
+// past the largest otherwise. With Edges, every threshold is moved onto a
+// contact size of the frame, where a comparison off by one would show.
+static void
+AmtPtpTestRandomFrames(
+	const AMTPTP_DECODER *Decoder,
+	PAMTPTP_TEST_RANDOM Random,
+	int Edges
+)
+{
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX + 64];
+	AMTPTP_CONTACT_SIZE sizes[AMTPTP_MAX_CONTACTS];
+	AMTPTP_DECODER decoder = *Decoder;
+	PAMTPTP_THRESHOLDS t = &decoder.Thresholds;
+	size_t length;
+	uint8_t count;
+	uint32_t i;
+
+	for (i = 0; i < AMTPTP_TEST_RANDOM_FRAMES; i++) {
+		AmtPtpTestFill(Random, frame, sizeof(frame));
+		if (AmtPtpTestNext(Random) & 3) {
+			length = Decoder->HeaderSize + (AmtPtpTestNext(Random) % (AMTPTP_BATCH_MAX_CONTACTS + 2)) * Decoder->FingerSize;
+			if (Decoder->Format == AmtPtpFrameFormatSpi) {
+				length = Decoder->HeaderSize + (AmtPtpTestNext(Random) % (AMTPTP_SYNTH_SPI_MAX_FINGERS + 1)) * Decoder->FingerSize;
+			}
+		}
+		else {
+			length = AmtPtpTestNext(Random) % sizeof(frame);
+		}
+
+		if (Edges && AmtPtpDecodeContactSizes(Decoder, frame, length, sizes, &count) == AmtPtpDecodeOk && count != 0) {
+			t->TipSwitchMajor = AmtPtpTestThreshold(sizes[AmtPtpTestNext(Random) % count].Major, Random);
+			t->TipSwitchMinor = AmtPtpTestThreshold(sizes[AmtPtpTestNext(Random) % count].Minor, Random);
+			t->TipSwitchPressure = AmtPtpTestThreshold(sizes[AmtPtpTestNext(Random) % count].Pressure, Random);
+			t->ConfidenceMinorMin = AmtPtpTestThreshold(sizes[AmtPtpTestNext(Random) % count].Minor, Random);
+			t->ConfidenceMinorMax = AmtPtpTestThreshold(sizes[AmtPtpTestNext(Random) % count].Minor, Random);
+			t->ConfidenceMajorMax = AmtPtpTestThreshold(sizes[AmtPtpTestNext(Random) % count].Major, Random);
+		}
+		AmtPtpTestFrame(&decoder, frame, length);
+	}
+}
+
+// Both ends of the 13-bit X and Y fields and their sign bit
+static const uint32_t AmtPtpTestType5Coordinates[] = {
+	0x0000, 0x0001, 0x0002, 0x07FF, 0x0800, 0x0FFE, 0x0FFF, 0x1000, 0x1001, 0x1800, 0x1FFE, 0x1FFF
+};
+
+static const uint8_t AmtPtpTestType5Bytes[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF };
+
+#define AMTPTP_TEST_COUNT(Array)	(sizeof(Array) / sizeof((Array)[0]))
+
+// Writes one TYPE5 record from field values; bits 26 - 31 are random
+static void
+AmtPtpTestPutType5(
+	uint8_t *Record,
+	uint32_t X,
+	uint32_t Y,
+	PAMTPTP_TEST_RANDOM Random
+)
+{
+	uint32_t raw = X | (Y << 13) | (AmtPtpTestNext(Random) & 0xFC000000u);
+	const uint8_t *bytes = AmtPtpTestType5Bytes;
+	size_t n = AMTPTP_TEST_COUNT(AmtPtpTestType5Bytes);
+
+	Record[0] = (uint8_t) raw;
+	Record[1] = (uint8_t) (raw >> 8);
+	Record[2] = (uint8_t) (raw >> 16);
+	Record[3] = (uint8_t) (raw >> 24);
+	Record[TYPE5_TOUCH_MAJOR] = bytes[AmtPtpTestNext(Random) % n];
+	Record[TYPE5_TOUCH_MINOR] = bytes[AmtPtpTestNext(Random) % n];
+	Record[TYPE5_SIZE] = bytes[AmtPtpTestNext(Random) % n];
+	Record[TYPE5_PRESSURE] = bytes[AmtPtpTestNext(Random) % n];
+	Record[TYPE5_IDENTIFIER] = (uint8_t) AmtPtpTestNext(Random);
+}
+
+// The TYPE5 unpackers differ most: the vector one rebuilds the sign-extended,
+// negated Y field without 64-bit arithmetic. Every pair of X and Y edges is
+// decoded in the first record, the others take random edges, and each frame
+// starts at every offset of a 16-byte line so no kernel depends on alignment.
+// A decoder with a centred range keeps the clamp from hiding lanes that
+// differ below zero.
+static void
+AmtPtpTestType5Edges(
+	const AMTPTP_DECODER *Decoder,
+	PAMTPTP_TEST_RANDOM Random
+)
+{
+	static uint8_t line[AMTPTP_TEST_FRAME_MAX + 32];
+	const uint32_t *edges = AmtPtpTestType5Coordinates;
+	const size_t n = AMTPTP_TEST_COUNT(AmtPtpTestType5Coordinates);
+	AMTPTP_DECODER centred = *Decoder;
+	size_t x, y, offset, records, i;
+	uint8_t *frame, *aligned;
+
+	aligned = line + ((16 - ((uintptr_t) line & 15)) & 15);
+	centred.XMin = -0x1000;
+	centred.YMin = -0x1000;
+	centred.YMax = 0x1000;
+
+	for (x = 0; x < n; x++) {
+		for (y = 0; y < n; y++) {
+			for (offset = 0; offset < 16; offset++) {
+				frame = aligned + offset;
+				records = 1 + AmtPtpTestNext(Random) % AMTPTP_BATCH_MAX_CONTACTS;
+				AmtPtpTestFill(Random, frame, Decoder->HeaderSize);
+
+				AmtPtpTestPutType5(frame + Decoder->HeaderSize, edges[x], edges[y], Random);
+				for (i = 1; i < records; i++) {
+					AmtPtpTestPutType5(frame + Decoder->HeaderSize + i * Decoder->FingerSize,
+						edges[AmtPtpTestNext(Random) % n], edges[AmtPtpTestNext(Random) % n], Random);
+				}
+
+				AmtPtpTestFrame(Decoder, frame, Decoder->HeaderSize + records * Decoder->FingerSize);
+				AmtPtpTestFrame(&centred, frame, Decoder->HeaderSize + records * Decoder->FingerSize);
+			}
+		}
+	}
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_BENCH_FAMILY families[AMTPTP_HOST_MAX_FAMILIES];
+	AMTPTP_BATCH_DECODER batch;
+	AMTPTP_DECODER decoder;
+	AMTPTP_TEST_RANDOM random;
+	WDFDRIVER driver = NULL;
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX];
+	size_t count, f;
+
+	random.State = 0xBA7C4;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+	count = AmtPtpHostGetFamilies(driver, families, AMTPTP_HOST_MAX_FAMILIES);
+	if (count == 0) {
+		AMTPTP_CHECK(!"driver configured no family");
+		return AMTPTP_TEST_RESULT();
+	}
+
+	for (f = 0; f < count; f++) {
+		AmtPtpBenchInitDecoder(&families[f], &decoder);
+
+		// The widest kernel of the build within its range
+		AmtPtpBatchInit(&batch, &decoder);
+		AMTPTP_CHECK_EQ(batch.Kernel, AmtPtpBatchKernelAvailable(AmtPtpBatchKernelSse2) ?
+			AmtPtpBatchKernelSse2 : AmtPtpBatchKernelScalar);
+
+		AmtPtpTestGestures(&families[f], &decoder);
+		AmtPtpTestRandomFrames(&decoder, &random, 0);
+		AmtPtpTestRandomFrames(&decoder, &random, 1);
+
+		if (decoder.Format == AmtPtpFrameFormatType5) {
+			AmtPtpTestType5Edges(&decoder, &random);
+		}
+	}
+
+	// Out of the 32-bit range only the scalar kernel is exact
+	decoder.XMin = -(1 << 30) - 1;
+	AmtPtpBatchInit(&batch, &decoder);
+	AMTPTP_CHECK_EQ(batch.Kernel, AmtPtpBatchKernelScalar);
+
+	// Frames AmtPtpDecodeFrame rejects are rejected the same way
+	AmtPtpTestFrame(&decoder, NULL, 0);
+	AmtPtpTestFrame(&decoder, frame, 0);
+	decoder.FingerSize = 1;
+	memset(frame, 0, sizeof(frame));
+	AmtPtpTestFrame(&decoder, frame, sizeof(frame));
+
+	AMTPTP_CHECK_EQ(AmtPtpBatchKernelAvailable(AmtPtpBatchKernelCount), 0);
+	AMTPTP_CHECK(AmtPtpBatchKernelAvailable(AmtPtpBatchKernelScalar));
+
+	printf("%s: %zu families, %lu frames, kernels:", AmtPtpHostFamilyDriver, count, AmtPtpTestFrames);
+	for (batch.Kernel = AmtPtpBatchKernelScalar; batch.Kernel < AmtPtpBatchKernelCount; batch.Kernel++) {
+		if (AmtPtpBatchKernelAvailable(batch.Kernel)) {
+			printf(" %s", AmtPtpBatchKernelName(batch.Kernel));
+		}
+	}
+	printf("\n");
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
@@ -0,0 +1,1192 @@
+// AmtPtpCoreTest.c: Unit tests for the frame decoder, packers, contact map, report analysis, baseline store,
+// dump import and header scan
+
+#include "AmtPtpTest.h"
+#include "AmtPtpAnalyze.h"
+#include "AmtPtpBaseline.h"
+#include "AmtPtpCore.h"
+#include "AmtPtpHeader.h"
+#include "AmtPtpImport.h"
+#include "AmtPtpLayout.h"
+
+static void
+PutS16(
+	uint8_t *p,
+	int32_t v
+)
+{
+	p[0] = (uint8_t) (v & 0xFF);
+	p[1] = (uint8_t) ((v >> 8) & 0xFF);
+}
+
+static void
+InitType4(
+	PAMTPTP_DECODER Decoder
+)
+{
+	AmtPtpInitDecoder(Decoder, AmtPtpFrameFormatWellspring);
+	Decoder->HeaderSize = HEADER_SIZE_TYPE4;
+	Decoder->FingerSize = FINGER_SIZE_TYPE4;
+	Decoder->FingerDelta = FINGER_DELTA_TYPE4;
+	Decoder->ButtonOffset = BUTTON_OFFSET_TYPE4;
+	Decoder->XMin = -4620;
+	Decoder->YMin = -150;
+	Decoder->YMax = 6600;
+}
+
+static void
+InitType5(
+	PAMTPTP_DECODER Decoder
+)
+{
+	AmtPtpInitDecoder(Decoder, AmtPtpFrameFormatType5);
+	Decoder->HeaderSize = HEADER_SIZE_TYPE5;
+	Decoder->FingerSize = FINGER_SIZE_TYPE5;
+	Decoder->FingerDelta = FINGER_DELTA_TYPE5;
+	Decoder->ButtonOffset = BUTTON_OFFSET_TYPE5;
+	Decoder->XMin = -3678;
+	Decoder->YMin = -2479;
+	Decoder->YMax = 2586;
+}
+
+static void
+InitSpi(
+	PAMTPTP_DECODER Decoder
+)
+{
+	AmtPtpInitDecoder(Decoder, AmtPtpFrameFormatSpi);
+	Decoder->XMin = -4750;
+	Decoder->YMin = -150;
+	Decoder->YMax = 6730;
+}
+
+static void
+PutWellspringFinger(
+	uint8_t *Frame,
+	size_t Index,
+	int32_t X,
+	int32_t Y,
+	int32_t Major,
+	int32_t Minor
+)
+{
+	uint8_t *f = Frame + HEADER_SIZE_TYPE4 + FINGER_DELTA_TYPE4 + Index * FINGER_SIZE_TYPE4;
+
+	PutS16(f + WELLSPRING_ABS_X, X);
+	PutS16(f + WELLSPRING_ABS_Y, Y);
+	PutS16(f + WELLSPRING_TOUCH_MAJOR, Major);
+	PutS16(f + WELLSPRING_TOUCH_MINOR, Minor);
+}
+
+// X in bits 0 - 12 and Y in bits 13 - 25, both signed 13-bit
+static void
+PutType5Finger(
+	uint8_t *Frame,
+	size_t Index,
+	int32_t X,
+	int32_t Y,
+	uint8_t Major,
+	uint8_t Minor,
+	uint8_t Id
+)
+{
+	uint8_t *f = Frame + HEADER_SIZE_TYPE5 + Index * FINGER_SIZE_TYPE5;
+	uint32_t Raw = ((uint32_t) X & 0x1fff) | (((uint32_t) Y & 0x1fff) << 13);
+
+	f[0] = (uint8_t) Raw;
+	f[1] = (uint8_t) (Raw >> 8);
+	f[2] = (uint8_t) (Raw >> 16);
+	f[3] = (uint8_t) (Raw >> 24);
+	f[TYPE5_TOUCH_MAJOR] = Major;
+	f[TYPE5_TOUCH_MINOR] = Minor;
+	f[TYPE5_IDENTIFIER] = Id;
+}
+
+static void
+TestScanTime(void)
+{
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(1000, 1000), 0);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(1000, 999), 0);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(1000, 1099), 0);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(1000, 1100), 1);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(0, 25599), 255);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(0, 25600), AMTPTP_SCAN_TIME_MAX);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(-5000, 5000), 100);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(INT64_MIN, INT64_MAX), AMTPTP_SCAN_TIME_MAX);
+	AMTPTP_CHECK_EQ(AmtPtpScanTime(INT64_MAX, INT64_MIN), 0);
+}
+
+static void
+TestDecodeWellspring(void)
+{
+	AMTPTP_DECODER Decoder;
+	AMTPTP_FRAME Frame;
+	uint8_t Buffer[HEADER_SIZE_TYPE4 + 6 * FINGER_SIZE_TYPE4] = { 0 };
+	size_t Length = HEADER_SIZE_TYPE4 + 2 * FINGER_SIZE_TYPE4;
+
+	InitType4(&Decoder);
+
+	PutWellspringFinger(Buffer, 0, 100, 2000, 100, 20);
+	PutWellspringFinger(Buffer, 1, -5000, 7000, 99, 0);
+	Buffer[BUTTON_OFFSET_TYPE4] = 0x40;
+
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, Length, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 2);
+	AMTPTP_CHECK_EQ(Frame.IsButtonClicked, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].X, 100 + 4620);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].Y, 6600 - 2000);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].TipSwitch, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].Confidence, 1);
+
+	// Outside the range clamps to zero; 99 * 2 is below the tip threshold
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].X, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].Y, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].TipSwitch, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].Confidence, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].X, 0);
+
+	// Flags select what is reported
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, Length, AMTPTP_DECODE_BUTTON, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 0);
+	AMTPTP_CHECK_EQ(Frame.IsButtonClicked, 1);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, Length, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 2);
+	AMTPTP_CHECK_EQ(Frame.IsButtonClicked, 0);
+
+	// Six records are reported as five
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, sizeof(Buffer), AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, AMTPTP_MAX_CONTACTS);
+
+	// A header alone is an empty frame
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, HEADER_SIZE_TYPE4, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 0);
+
+	// Partial records, short frames and missing buffers are rejected and clear the frame
+	Frame.ContactCount = 3;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, Length - 1, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeMalformed);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 0);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, HEADER_SIZE_TYPE4 - 1, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeMalformed);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, NULL, Length, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeMalformed);
+
+	// A record too small for the fields read is a configuration error
+	Decoder.FingerSize = WELLSPRING_FINGER_READ + FINGER_DELTA_TYPE4 - 1;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, Length, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeUnsupported);
+}
+
+static void
+TestDecodeType5(void)
+{
+	AMTPTP_DECODER Decoder;
+	AMTPTP_FRAME Frame;
+	uint8_t Buffer[HEADER_SIZE_TYPE5 + 3 * FINGER_SIZE_TYPE5] = { 0 };
+
+	InitType5(&Decoder);
+
+	// X zero: Y is the negated field
+	PutType5Finger(Buffer, 0, 0, -1000, 10, 100, 0x37);
+	// Non-zero X bits round the negated Y down by one (kept from the original driver)
+	PutType5Finger(Buffer, 1, -200, 500, 0, 200, 0x02);
+	// Beyond the range on both axes
+	PutType5Finger(Buffer, 2, -4000, 4000, 1, 172, 0x0F);
+	Buffer[BUTTON_OFFSET_TYPE5] = 1;
+
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, sizeof(Buffer), AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 3);
+	AMTPTP_CHECK_EQ(Frame.IsButtonClicked, 1);
+
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].X, 3678);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].Y, 1000 + 2479);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 7);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].TipSwitch, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].Confidence, 1);
+
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].X, 3678 - 200);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].Y, -500 - 1 + 2479);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 2);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].TipSwitch, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].Confidence, 0);
+
+	// 172 * 2 is just below the confidence limit of 345
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].X, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].Y, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].ContactID, 15);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].TipSwitch, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].Confidence, 1);
+
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, sizeof(Buffer) - 4, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeMalformed);
+}
+
+static void
+TestDecodeSpi(void)
+{
+	AMTPTP_DECODER Decoder;
+	AMTPTP_FRAME Frame;
+	uint8_t Buffer[AMTPTP_SPI_HEADER_SIZE + 7 * AMTPTP_SPI_FINGER_SIZE] = { 0 };
+	uint8_t *f = Buffer + AMTPTP_SPI_HEADER_SIZE;
+
+	InitSpi(&Decoder);
+
+	PutS16(f + SPI_X, 250);
+	PutS16(f + SPI_Y, 730);
+	PutS16(f + SPI_TOUCH_MAJOR, 2499);
+	PutS16(f + SPI_TOUCH_MINOR, 1000);
+	PutS16(f + SPI_PRESSURE, 1);
+	f += AMTPTP_SPI_FINGER_SIZE;
+	PutS16(f + SPI_TOUCH_MAJOR, 2500);
+	Buffer[SPI_CLICK_OCCURRED] = 1;
+	Buffer[SPI_NUM_OF_FINGERS] = 2;
+
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, sizeof(Buffer), AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 2);
+	AMTPTP_CHECK_EQ(Frame.IsButtonClicked, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].X, 250 + 4750);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].Y, 6730 - 730);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].TipSwitch, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].Confidence, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].TipSwitch, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].Confidence, 0);
+
+	// The reported count is capped by the transfer, then by the report
+	Buffer[SPI_NUM_OF_FINGERS] = 4;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, AMTPTP_SPI_HEADER_SIZE + 3 * AMTPTP_SPI_FINGER_SIZE - 1, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, 2);
+	Buffer[SPI_NUM_OF_FINGERS] = 200;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, sizeof(Buffer), AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Frame.ContactCount, AMTPTP_MAX_CONTACTS);
+
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, AMTPTP_SPI_HEADER_SIZE - 1, AMTPTP_DECODE_SURFACE, &Frame), AmtPtpDecodeMalformed);
+}
+
+static void
+TestSelectDecoder(void)
+{
+	AMTPTP_DECODER Decoders[5];
+	AMTPTP_TEST_RANDOM Random = { 1 };
+	uint8_t Buffer[AMTPTP_SPI_HEADER_SIZE + 8 * AMTPTP_SPI_FINGER_SIZE];
+	size_t d, n;
+	int i;
+
+	InitType4(&Decoders[0]);
+	Decoders[1] = Decoders[0];
+	Decoders[1].HeaderSize = HEADER_SIZE_TYPE2;
+	Decoders[1].FingerSize = FINGER_SIZE_TYPE2;
+	Decoders[1].FingerDelta = FINGER_DELTA_TYPE2;
+	Decoders[1].ButtonOffset = BUTTON_OFFSET_TYPE2;
+	Decoders[2] = Decoders[1];
+	Decoders[2].HeaderSize = HEADER_SIZE_TYPE3;
+	Decoders[2].ButtonOffset = BUTTON_OFFSET_TYPE3;
+	InitType5(&Decoders[3]);
+	InitSpi(&Decoders[4]);
+
+	for (d = 0; d < 5; d++) {
+		PFN_AMTPTP_DECODE_FRAME Decode = AmtPtpSelectDecoder(&Decoders[d]);
+
+		AMTPTP_CHECK(Decode != AmtPtpDecodeFrame);
+
+		for (i = 0; i < 2000; i++) {
+			AMTPTP_FRAME Expected, Actual;
+			AMTPTP_DECODE_STATUS s1, s2;
+
+			AmtPtpTestFill(&Random, Buffer, sizeof(Buffer));
+			n = AmtPtpTestNext(&Random) % (sizeof(Buffer) + 1);
+
+			s1 = AmtPtpDecodeFrame(&Decoders[d], Buffer, n, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Expected);
+			s2 = Decode(&Decoders[d], Buffer, n, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Actual);
+			AMTPTP_CHECK_EQ(s2, s1);
+			AMTPTP_CHECK_FRAME(&Actual, &Expected);
+		}
+	}
+
+	// Any other geometry gets the generic decoder
+	Decoders[0].FingerDelta = 0;
+	AMTPTP_CHECK(AmtPtpSelectDecoder(&Decoders[0]) == AmtPtpDecodeFrame);
+}
+
+static void
+TestPackReport(void)
+{
+	AMTPTP_FRAME Frame = { 0 };
+	uint8_t Report[AMTPTP_REPORT_SIZE];
+	uint8_t Expected[AMTPTP_REPORT_SIZE] = { 0 };
+
+	Frame.ContactCount = 2;
+	Frame.IsButtonClicked = 1;
+	Frame.Contacts[0].X = 0x1234;
+	Frame.Contacts[0].Y = 0x0567;
+	Frame.Contacts[0].ContactID = 9;
+	Frame.Contacts[0].TipSwitch = 1;
+	Frame.Contacts[0].Confidence = 1;
+	Frame.Contacts[1].X = 0xFFFF;
+	Frame.Contacts[1].ContactID = 3;
+	Frame.Contacts[1].Confidence = 1;
+	// Slots past ContactCount are not read
+	Frame.Contacts[2].X = 0x4242;
+
+	Expected[0] = AMTPTP_REPORTID_MULTITOUCH;
+	Expected[1] = 0x03;
+	Expected[2] = 9;
+	Expected[6] = 0x34;
+	Expected[7] = 0x12;
+	Expected[8] = 0x67;
+	Expected[9] = 0x05;
+	Expected[10] = 0x01;
+	Expected[11] = 3;
+	Expected[15] = 0xFF;
+	Expected[16] = 0xFF;
+	Expected[46] = 0x2C;
+	Expected[47] = 0x01;
+	Expected[48] = 2;
+	Expected[49] = 1;
+
+	// Stale bytes of an earlier report must be overwritten
+	memset(Report, 0xAA, sizeof(Report));
+	AmtPtpPackReport(&Frame, 300, Report);
+	AMTPTP_CHECK_MEM(Report, Expected, sizeof(Expected));
+}
+
+static void
+TestPackCompactReport(void)
+{
+	AMTPTP_FRAME Frame = { 0 };
+	uint8_t Report[AMTPTP_COMPACT_REPORT_SIZE];
+	uint8_t Expected[AMTPTP_COMPACT_REPORT_SIZE] = { 0 };
+
+	Frame.ContactCount = 2;
+	Frame.Contacts[0].X = 0x1234;
+	Frame.Contacts[0].Y = 0x0567;
+	Frame.Contacts[0].ContactID = 5;
+	Frame.Contacts[0].TipSwitch = 1;
+	Frame.Contacts[0].Confidence = 1;
+	// ContactID is truncated to three bits
+	Frame.Contacts[1].ContactID = 0x0E;
+	Frame.Contacts[1].TipSwitch = 1;
+	Frame.Contacts[1].Y = 0xABCD;
+
+	Expected[0] = AMTPTP_REPORTID_MULTITOUCH;
+	Expected[1] = 0x03 | (5 << 2);
+	Expected[2] = 0x34;
+	Expected[3] = 0x12;
+	Expected[4] = 0x67;
+	Expected[5] = 0x05;
+	Expected[6] = 0x02 | (6 << 2);
+	Expected[9] = 0xCD;
+	Expected[10] = 0xAB;
+	Expected[26] = 0xFF;
+	Expected[27] = 0x00;
+	Expected[28] = 2;
+	Expected[29] = 0;
+
+	memset(Report, 0xAA, sizeof(Report));
+	AmtPtpPackCompactReport(&Frame, AMTPTP_SCAN_TIME_MAX, Report);
+	AMTPTP_CHECK_MEM(Report, Expected, sizeof(Expected));
+
+	// A count beyond the report still packs five contacts only
+	Frame.ContactCount = 9;
+	AmtPtpPackCompactReport(&Frame, 0, Report);
+	AMTPTP_CHECK_EQ(Report[28], 9);
+}
+
+static void
+TestUnpackReport(void)
+{
+	AMTPTP_TEST_RANDOM Random = { 5 };
+	AMTPTP_FRAME Frame, Expected, Actual;
+	uint8_t Report[AMTPTP_REPORT_SIZE];
+	uint16_t ScanTime;
+	size_t i;
+	int n;
+
+	for (n = 0; n < 1000; n++) {
+		memset(&Frame, 0, sizeof(Frame));
+		Frame.ContactCount = (uint8_t) (AmtPtpTestNext(&Random) % (AMTPTP_MAX_CONTACTS + 1));
+		Frame.IsButtonClicked = (uint8_t) (AmtPtpTestNext(&Random) & 1);
+		for (i = 0; i < Frame.ContactCount; i++) {
+			Frame.Contacts[i].X = (uint16_t) AmtPtpTestNext(&Random);
+			Frame.Contacts[i].Y = (uint16_t) AmtPtpTestNext(&Random);
+			Frame.Contacts[i].ContactID = (uint8_t) AmtPtpTestNext(&Random);
+			Frame.Contacts[i].TipSwitch = (uint8_t) (AmtPtpTestNext(&Random) & 1);
+			Frame.Contacts[i].Confidence = (uint8_t) (AmtPtpTestNext(&Random) & 1);
+		}
+
+		AmtPtpPackReport(&Frame, (uint16_t) n, Report);
+		AMTPTP_CHECK_EQ(AmtPtpUnpackReport(Report, AMTPTP_REPORT_SIZE, &Actual, &ScanTime), AmtPtpDecodeOk);
+		AMTPTP_CHECK_FRAME(&Actual, &Frame);
+		AMTPTP_CHECK_EQ(ScanTime, n);
+
+		// The compact layout keeps three bits of each identifier
+		Expected = Frame;
+		for (i = 0; i < Frame.ContactCount; i++) {
+			Expected.Contacts[i].ContactID &= AMTPTP_COMPACT_CONTACT_ID_MAX;
+		}
+		AmtPtpPackCompactReport(&Frame, (uint16_t) n, Report);
+		AMTPTP_CHECK_EQ(AmtPtpUnpackReport(Report, AMTPTP_COMPACT_REPORT_SIZE, &Actual, &ScanTime), AmtPtpDecodeOk);
+		AMTPTP_CHECK_FRAME(&Actual, &Expected);
+		AMTPTP_CHECK_EQ(ScanTime, n);
+	}
+
+	// Contact slots past the reported count stay empty
+	Frame.ContactCount = 9;
+	AmtPtpPackReport(&Frame, 0, Report);
+	AMTPTP_CHECK_EQ(AmtPtpUnpackReport(Report, AMTPTP_REPORT_SIZE, &Actual, &ScanTime), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(Actual.ContactCount, 9);
+	AMTPTP_CHECK_EQ(Actual.Contacts[AMTPTP_MAX_CONTACTS - 1].X, Frame.Contacts[AMTPTP_MAX_CONTACTS - 1].X);
+
+	Report[0] = 0x06;
+	AMTPTP_CHECK_EQ(AmtPtpUnpackReport(Report, AMTPTP_REPORT_SIZE, &Actual, &ScanTime), AmtPtpDecodeMalformed);
+	AMTPTP_CHECK_EQ(AmtPtpUnpackReport(Report, AMTPTP_REPORT_SIZE - 1, &Actual, &ScanTime), AmtPtpDecodeUnsupported);
+	AMTPTP_CHECK_EQ(Actual.ContactCount, 0);
+}
+
+static void
+MapFrame(
+	PAMTPTP_CONTACT_ID_MAP Map,
+	PAMTPTP_FRAME Frame,
+	const uint8_t *DeviceIds,
+	uint8_t Count
+)
+{
+	uint8_t i;
+
+	Frame->ContactCount = Count;
+	for (i = 0; i < Count; i++) {
+		Frame->Contacts[i].ContactID = DeviceIds[i];
+	}
+
+	AmtPtpMapContactIds(Map, Frame);
+}
+
+static void
+TestMapContactIds(void)
+{
+	AMTPTP_CONTACT_ID_MAP Map;
+	AMTPTP_FRAME Frame = { 0 };
+	const uint8_t First[] = { 12, 4 };
+	const uint8_t Second[] = { 4, 9, 12 };
+	const uint8_t Third[] = { 9, 15 };
+	const uint8_t Five[] = { 0, 1, 2, 3, 4 };
+	const uint8_t Other[] = { 10, 11, 12, 13, 14 };
+	const uint8_t Twice[] = { 6, 6 };
+
+	AmtPtpInitContactIdMap(&Map);
+
+	MapFrame(&Map, &Frame, First, 2);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 1);
+
+	// Contacts keep their identifier whatever their position
+	MapFrame(&Map, &Frame, Second, 3);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 2);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].ContactID, 0);
+
+	// 4 and 12 lifted: their identifiers are held for one frame
+	MapFrame(&Map, &Frame, Third, 2);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 2);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 3);
+
+	// Five new contacts after five others: three unused identifiers, then reuse
+	AmtPtpInitContactIdMap(&Map);
+	MapFrame(&Map, &Frame, Five, 5);
+	MapFrame(&Map, &Frame, Other, 5);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 5);
+	AMTPTP_CHECK_EQ(Frame.Contacts[1].ContactID, 6);
+	AMTPTP_CHECK_EQ(Frame.Contacts[2].ContactID, 7);
+	AMTPTP_CHECK_EQ(Frame.Contacts[3].ContactID, 0);
+	AMTPTP_CHECK_EQ(Frame.Contacts[4].ContactID, 1);
+	AMTPTP_CHECK_EQ(Map.Count, 5);
+
+	// Duplicate device identifiers never share a compact one
+	AmtPtpInitContactIdMap(&Map);
+	MapFrame(&Map, &Frame, Twice, 2);
+	MapFrame(&Map, &Frame, Twice, 2);
+	AMTPTP_CHECK(Frame.Contacts[0].ContactID != Frame.Contacts[1].ContactID);
+	AMTPTP_CHECK(Frame.Contacts[0].ContactID <= AMTPTP_COMPACT_CONTACT_ID_MAX);
+	AMTPTP_CHECK(Frame.Contacts[1].ContactID <= AMTPTP_COMPACT_CONTACT_ID_MAX);
+
+	// An empty frame releases everything after one more frame
+	MapFrame(&Map, &Frame, Twice, 0);
+	AMTPTP_CHECK_EQ(Map.Count, 0);
+	MapFrame(&Map, &Frame, First, 1);
+	AMTPTP_CHECK_EQ(Frame.Contacts[0].ContactID, 0);
+}
+
+static void
+TestAnalyzeReports(void)
+{
+	static const size_t sizes[] = { AMTPTP_REPORT_SIZE, AMTPTP_COMPACT_REPORT_SIZE };
+	static AMTPTP_ANALYSIS analysis;
+	AMTPTP_FRAME frame;
+	uint8_t reports[4 * AMTPTP_REPORT_SIZE + 7];
+	size_t s, size;
+
+	memset(&frame, 0, sizeof(frame));
+	frame.ContactCount = 2;
+	frame.Contacts[1].X = 0x1FF;
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		size = sizes[s];
+		memset(reports, 0xEE, sizeof(reports));
+		if (size == AMTPTP_REPORT_SIZE) {
+			AmtPtpPackReport(&frame, 7, reports);
+			AmtPtpPackReport(&frame, 0x3FF, reports + size);
+			AmtPtpPackReport(&frame, 7, reports + 3 * size);
+		}
+		else {
+			AmtPtpPackCompactReport(&frame, 7, reports);
+			AmtPtpPackCompactReport(&frame, 0x3FF, reports + size);
+			AmtPtpPackCompactReport(&frame, 7, reports + 3 * size);
+		}
+		// The third report carries another report ID
+		reports[2 * size] = 0x06;
+
+		// ScanTime is read where the layout puts it and saturates in the histogram
+		AmtPtpAnalyzeInit(&analysis);
+		AMTPTP_CHECK_EQ(AmtPtpAnalyzeReports(&analysis, reports, 4 * size + size / 2, size), 3);
+		AMTPTP_CHECK_EQ(analysis.Reports, 3);
+		AMTPTP_CHECK_EQ(analysis.ReportScanTime[7], 2);
+		AMTPTP_CHECK_EQ(analysis.ReportScanTime[AMTPTP_SCAN_TIME_MAX], 1);
+
+		// A stream cut inside its first report holds none
+		AMTPTP_CHECK_EQ(AmtPtpAnalyzeReports(&analysis, reports, size - 1, size), 0);
+		AMTPTP_CHECK_EQ(analysis.Reports, 3);
+	}
+
+	// Neither packer writes any other size
+	AmtPtpAnalyzeInit(&analysis);
+	AMTPTP_CHECK_EQ(AmtPtpAnalyzeReports(&analysis, reports, sizeof(reports), AMTPTP_REPORT_SIZE - 1), 0);
+	AMTPTP_CHECK_EQ(AmtPtpAnalyzeReports(&analysis, reports, sizeof(reports), 0), 0);
+	AMTPTP_CHECK_EQ(analysis.Reports, 0);
+}
+
+static void
+TestAnalyzeMerge(void)
+{
+	static AMTPTP_ANALYSIS a, b, empty;
+
+	AmtPtpAnalyzeInit(&a);
+	AmtPtpAnalyzeInit(&b);
+	AmtPtpAnalyzeInit(&empty);
+
+	a.TimestampFrequency = 1000;
+	a.Frames = 10;
+	a.Reports = 9;
+	a.Duration = 90;
+	a.IntervalMin = 8;
+	a.IntervalMax = 12;
+	a.Intervals[3] = 4;
+	a.ScanTime[80] = 10;
+	a.Lifetimes[2] = 1;
+	a.Contacts = 1;
+
+	b.TimestampFrequency = 1000;
+	b.Frames = 5;
+	b.Malformed = 1;
+	b.Reports = 5;
+	b.Duration = 40;
+	b.IntervalMin = 6;
+	b.IntervalMax = 9;
+	b.Intervals[3] = 1;
+	b.ContactCount[2] = 5;
+	b.ReportScanTime[80] = 5;
+
+	// An empty analysis takes the frequency and extremes of the first one merged in
+	AmtPtpAnalyzeMerge(&empty, &a);
+	AMTPTP_CHECK_EQ(empty.TimestampFrequency, 1000);
+	AMTPTP_CHECK_EQ(empty.IntervalMin, 8);
+
+	AmtPtpAnalyzeMerge(&empty, &b);
+	AMTPTP_CHECK_EQ(empty.Frames, 15);
+	AMTPTP_CHECK_EQ(empty.Malformed, 1);
+	AMTPTP_CHECK_EQ(empty.Reports, 14);
+	AMTPTP_CHECK_EQ(empty.Duration, 130);
+	AMTPTP_CHECK_EQ(empty.IntervalMin, 6);
+	AMTPTP_CHECK_EQ(empty.IntervalMax, 12);
+	AMTPTP_CHECK_EQ(empty.Intervals[3], 5);
+	AMTPTP_CHECK_EQ(empty.ScanTime[80], 10);
+	AMTPTP_CHECK_EQ(empty.ContactCount[2], 5);
+	AMTPTP_CHECK_EQ(empty.ReportScanTime[80], 5);
+	AMTPTP_CHECK_EQ(empty.Lifetimes[2], 1);
+	AMTPTP_CHECK_EQ(empty.Contacts, 1);
+	AMTPTP_CHECK_EQ(AmtPtpAnalyzeDropped(&empty), 1);
+
+	// 16 frames over 130 ticks at 1 kHz
+	AMTPTP_CHECK(AmtPtpAnalyzeReportRate(&empty) > 123.0 && AmtPtpAnalyzeReportRate(&empty) < 123.1);
+}
+
+// Appends one store line for each value
+static size_t
+PutBaseline(
+	char *Store,
+	size_t Length,
+	const char *Commit,
+	const char *Family,
+	const char *Metric,
+	const double *Values,
+	uint32_t Count
+)
+{
+	uint32_t i;
+
+	for (i = 0; i < Count; i++) {
+		Length += AmtPtpBaselineFormat(Commit, Family, Metric, Values[i], Store + Length, 4096 - Length);
+	}
+	return Length;
+}
+
+static void
+TestBaselineIndex(void)
+{
+	static const double base[] = { 100.0, 101.0, 99.0, 100.5, 99.5 };
+	static AMTPTP_BASELINE_SERIES series[4];
+	static uint32_t slots[AMTPTP_BASELINE_SLOTS(4)];
+	static char store[4096];
+	AMTPTP_BASELINE_INDEX index;
+	const AMTPTP_BASELINE_SERIES *found;
+	size_t length = 0;
+
+	length = PutBaseline(store, length, "a", "UsbUm/0262", "ns_per_frame", base, 3);
+	length = PutBaseline(store, length, "a", "SpiKm/0272", "p99_us", base, 1);
+	length += (size_t) snprintf(store + length, sizeof(store) - length, "\r\nbroken\tline\n\n");
+	length = PutBaseline(store, length, "a", "UsbUm/0262", "ns_per_frame", base + 3, 2);
+	length = PutBaseline(store, length, "b", "UsbUm/0262", "ns_per_frame", base, 1);
+
+	// Series in the order they first appear, with every run of each
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, length, series, 4, slots, &index), AmtPtpBaselineOk);
+	AMTPTP_CHECK_EQ(index.Count, 3);
+	AMTPTP_CHECK(strcmp(series[0].Commit, "a") == 0 && strcmp(series[0].Family, "UsbUm/0262") == 0);
+	AMTPTP_CHECK_EQ(series[0].Runs, 5);
+	AMTPTP_CHECK_MEM(series[0].Values, base, sizeof(base));
+	AMTPTP_CHECK(strcmp(series[1].Metric, "p99_us") == 0);
+	AMTPTP_CHECK(strcmp(series[2].Commit, "b") == 0);
+
+	found = AmtPtpBaselineFind(&index, "b", "UsbUm/0262", "ns_per_frame");
+	AMTPTP_CHECK(found == &series[2]);
+	AMTPTP_CHECK(AmtPtpBaselineFind(&index, "b", "SpiKm/0272", "p99_us") == NULL);
+	AMTPTP_CHECK(AmtPtpBaselineFind(&index, "c", "UsbUm/0262", "ns_per_frame") == NULL);
+
+	// Series beyond the capacity are left out, the others still complete
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, length, series, 2, slots, &index), AmtPtpBaselineBufferTooSmall);
+	AMTPTP_CHECK_EQ(index.Count, 2);
+	AMTPTP_CHECK_EQ(series[0].Runs, 5);
+	AMTPTP_CHECK(AmtPtpBaselineFind(&index, "b", "UsbUm/0262", "ns_per_frame") == NULL);
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, length, series, 0, slots, &index), AmtPtpBaselineBufferTooSmall);
+	AMTPTP_CHECK(AmtPtpBaselineFind(&index, "a", "UsbUm/0262", "ns_per_frame") == NULL);
+
+	// An empty store has no series
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, 0, series, 4, slots, &index), AmtPtpBaselineOk);
+	AMTPTP_CHECK_EQ(index.Count, 0);
+}
+
+static void
+TestBaselineCheck(void)
+{
+	static const double base[] = { 100.0, 101.0, 99.0, 100.5, 99.5, 100.2, 99.8 };
+	static const double steady[] = { 100.4, 99.6, 101.2, 100.1, 99.2, 100.7, 99.9 };
+	static const double slower[] = { 110.0, 111.0, 109.0, 110.5, 109.5, 110.2, 109.8 };
+	static const double noisy[] = { 90.0, 130.0, 95.0, 125.0, 100.0, 120.0, 105.0 };
+	static AMTPTP_BASELINE_SERIES series[16];
+	static uint32_t slots[AMTPTP_BASELINE_SLOTS(16)];
+	static char store[4096], out[2048];
+	AMTPTP_BASELINE_INDEX index;
+	size_t length = 0;
+
+	length = PutBaseline(store, length, "base", "UsbUm/0262", "ns_per_frame", base, 7);
+	length = PutBaseline(store, length, "base", "SpiKm/0272", "p99_us", base, 7);
+	length = PutBaseline(store, length, "base", "UsbKm/0290", "ns_per_frame", base, 7);
+	length = PutBaseline(store, length, "head", "UsbUm/0262", "ns_per_frame", slower, 7);
+	length = PutBaseline(store, length, "head", "SpiKm/0272", "p99_us", steady, 7);
+	length = PutBaseline(store, length, "head", "UsbKm/0290", "ns_per_frame", noisy, 7);
+	length = PutBaseline(store, length, "head", "UsbKm/0291", "ns_per_frame", base, 7);
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, length, series, 16, slots, &index), AmtPtpBaselineOk);
+
+	// 10% slower with separate intervals regresses; within noise, or with
+	// intervals that overlap, it does not; a new family is only listed
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "base", "head", 0.05, out, sizeof(out)), 1);
+	AMTPTP_CHECK(strstr(out, "UsbUm/0262 ns_per_frame: 100.000") != NULL);
+	AMTPTP_CHECK(strstr(out, "(+10.0%) REGRESSION\n") != NULL);
+	AMTPTP_CHECK(strstr(out, "SpiKm/0272 p99_us") != NULL && strstr(out, "(+0.1%)\n") != NULL);
+	AMTPTP_CHECK(strstr(out, "UsbKm/0291 ns_per_frame: new 100.000") != NULL);
+
+	// A threshold above the change, and a commit against itself, pass
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "base", "head", 0.15, out, sizeof(out)), 0);
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "base", "base", 0.0, out, sizeof(out)), 0);
+
+	// A commit with no records compares nothing; short output is cut, not overrun
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "base", "none", 0.05, out, sizeof(out)), 0);
+	AMTPTP_CHECK_EQ(out[0], 0);
+	out[8] = 'x';
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "base", "head", 0.05, out, 8), 1);
+	AMTPTP_CHECK_EQ(strlen(out), 7);
+	AMTPTP_CHECK_EQ(out[8], 'x');
+}
+
+static void
+TestBaselineHistory(void)
+{
+	static const double runs[] = { 200.0, 202.0, 198.0, 150.0, 152.0, 148.0 };
+	static AMTPTP_BASELINE_SERIES series[8];
+	static uint32_t slots[AMTPTP_BASELINE_SLOTS(8)];
+	static char store[4096], out[1024];
+	AMTPTP_BASELINE_INDEX index;
+	size_t length = 0;
+	const char *first, *second;
+
+	length = PutBaseline(store, length, "one", "UsbUm/0262", "ns_per_frame", runs, 3);
+	length = PutBaseline(store, length, "one", "SpiKm/0272", "p99_us", runs, 3);
+	length = PutBaseline(store, length, "two", "UsbUm/0262", "ns_per_frame", runs + 3, 3);
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, length, series, 8, slots, &index), AmtPtpBaselineOk);
+
+	// One line per commit in store order, each with its change from the one before
+	AMTPTP_CHECK(AmtPtpBaselineHistory(&index, "UsbUm/0262", "ns_per_frame", out, sizeof(out)) == strlen(out));
+	first = strstr(out, "  one ");
+	second = strstr(out, "  two ");
+	AMTPTP_CHECK(strncmp(out, "UsbUm/0262 ns_per_frame\n", 24) == 0);
+	AMTPTP_CHECK(first != NULL && second != NULL && first < second);
+	AMTPTP_CHECK(strstr(out, "200.000 [198.000, 202.000] n=3\n") != NULL);
+	AMTPTP_CHECK(strstr(out, "150.000 [148.000, 152.000] n=3 -25.0%\n") != NULL);
+
+	AmtPtpBaselineHistory(&index, "UsbUm/0262", "p99_us", out, sizeof(out));
+	AMTPTP_CHECK(strcmp(out, "UsbUm/0262 p99_us\n") == 0);
+}
+
+// A store of many commits is indexed and checked in one pass each
+static void
+TestBaselineLargeStore(void)
+{
+	enum { Commits = 1024, Metrics = 4, Runs = 4 };
+	static AMTPTP_BASELINE_SERIES series[Commits * Metrics];
+	static uint32_t slots[AMTPTP_BASELINE_SLOTS(Commits * Metrics)];
+	static char store[Commits * Metrics * Runs * 48], out[1024];
+	static const char *metrics[Metrics] = { "ns_per_frame", "cycles_per_frame", "p50_us", "p99_us" };
+	AMTPTP_BASELINE_INDEX index;
+	AMTPTP_TEST_RANDOM random = { 1 };
+	char commit[16];
+	size_t length = 0;
+	uint32_t c, m, r;
+
+	for (c = 0; c < Commits; c++) {
+		snprintf(commit, sizeof(commit), "c%04u", (unsigned) c);
+		for (r = 0; r < Runs; r++) {
+			for (m = 0; m < Metrics; m++) {
+				length += AmtPtpBaselineFormat(commit, "UsbUm/0262", metrics[m],
+					100.0 + (double) (AmtPtpTestNext(&random) % 100) / 100.0 + (c == Commits - 1 && m == 3 ? 50.0 : 0.0),
+					store + length, sizeof(store) - length);
+			}
+		}
+	}
+
+	AMTPTP_CHECK_EQ(AmtPtpBaselineIndex(store, length, series, Commits * Metrics, slots, &index), AmtPtpBaselineOk);
+	AMTPTP_CHECK_EQ(index.Count, Commits * Metrics);
+	AMTPTP_CHECK_EQ(series[Commits * Metrics - 1].Runs, Runs);
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "c0000", "c1022", 0.05, out, sizeof(out)), 0);
+	AMTPTP_CHECK_EQ(AmtPtpBaselineCheck(&index, "c1022", "c1023", 0.05, out, sizeof(out)), 1);
+	AMTPTP_CHECK(strstr(out, "p99_us") != NULL && strstr(out, "REGRESSION") != NULL);
+}
+
+static const char ImportDump[] =
+	"# hid-recorder dump\n"
+	"D: 0\n"
+	"N: Apple Inc. Magic Trackpad 2\n"
+	"I: 5 004c 0265\n"
+	"D: 1\n"
+	"I: 3 05ac 0262\n"
+	"D: 0\n"
+	"E: 000001.000250 3 31 0a 0b\n"
+	"E: 000001.008250 2 02 ff\r\n"
+	"D: 1\n"
+	"E: 000001.009000 1 31\n"
+	"D: 0\n"
+	"\n"
+	"E: 000002.000000 4 31 01 02 03  \n";
+
+// Imports Text with the fixed device of these tests
+static AMTPTP_IMPORT_STATUS
+ImportText(
+	const char *Text,
+	size_t Length,
+	uint32_t DeviceIndex,
+	int ReportId,
+	size_t FrameSize,
+	uint8_t *Out,
+	size_t OutSize,
+	size_t *Written,
+	PAMTPTP_IMPORT_STATS Stats
+)
+{
+	static uint8_t frame[AMTPTP_IMPORT_REPORT_MAX];
+	AMTPTP_CAPTURE_DEVICE device;
+
+	memset(&device, 0, sizeof(device));
+	device.IdVendor = 0x004C;
+	device.IdProduct = 0x0265;
+	device.TrackpadType = AMTPTP_CAPTURE_NO_TRACKPAD_TYPE;
+	device.TimestampFrequency = 1000000;
+	AmtPtpInitDecoder(&device.Decoder, AmtPtpFrameFormatWellspring);
+
+	return AmtPtpImportHidRecorder(Text, Length, DeviceIndex, ReportId, &device, frame, FrameSize,
+		Out, OutSize, Written, Stats);
+}
+
+static void
+TestImportHidRecorder(void)
+{
+	static uint8_t out[1024];
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_IMPORT_STATS stats;
+	const uint8_t *frame;
+	uint64_t timestamp;
+	uint32_t length;
+	uint16_t vendor, product;
+	size_t written;
+
+	AMTPTP_CHECK_EQ(AmtPtpImportProbe(ImportDump, sizeof(ImportDump) - 1, 0, &vendor, &product), AmtPtpImportOk);
+	AMTPTP_CHECK_EQ(vendor, 0x004C);
+	AMTPTP_CHECK_EQ(product, 0x0265);
+	AMTPTP_CHECK_EQ(AmtPtpImportProbe(ImportDump, sizeof(ImportDump) - 1, 1, &vendor, &product), AmtPtpImportOk);
+	AMTPTP_CHECK_EQ(product, 0x0262);
+	AMTPTP_CHECK_EQ(AmtPtpImportProbe(ImportDump, sizeof(ImportDump) - 1, 2, &vendor, &product), AmtPtpImportNoDevice);
+
+	// Every report of device 0, at microsecond ticks, the other device's skipped
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 0, AMTPTP_IMPORT_ANY_REPORT,
+		AMTPTP_IMPORT_REPORT_MAX, out, sizeof(out), &written, &stats), AmtPtpImportOk);
+	AMTPTP_CHECK_EQ(stats.Frames, 3);
+	AMTPTP_CHECK_EQ(stats.Skipped, 1);
+	AMTPTP_CHECK_EQ(stats.Lines, 14);
+	AMTPTP_CHECK_EQ(stats.BadLine, 0);
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, out, written), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(reader.Device.IdProduct, 0x0265);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureNext(&reader, &timestamp, &frame, &length), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(timestamp, 1000250);
+	AMTPTP_CHECK_EQ(length, 3);
+	AMTPTP_CHECK_MEM(frame, "\x31\x0a\x0b", 3);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureNext(&reader, &timestamp, &frame, &length), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(timestamp, 1008250);
+	AMTPTP_CHECK_MEM(frame, "\x02\xff", 2);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureNext(&reader, &timestamp, &frame, &length), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(timestamp, 2000000);
+	AMTPTP_CHECK_EQ(length, 4);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureNext(&reader, &timestamp, &frame, &length), AmtPtpCaptureEnd);
+
+	// One report ID only
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 0, 0x31, AMTPTP_IMPORT_REPORT_MAX,
+		out, sizeof(out), &written, &stats), AmtPtpImportOk);
+	AMTPTP_CHECK_EQ(stats.Frames, 2);
+	AMTPTP_CHECK_EQ(stats.Skipped, 2);
+
+	// The other device
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 1, AMTPTP_IMPORT_ANY_REPORT,
+		AMTPTP_IMPORT_REPORT_MAX, out, sizeof(out), &written, &stats), AmtPtpImportOk);
+	AMTPTP_CHECK_EQ(stats.Frames, 1);
+	AMTPTP_CHECK_EQ(stats.Skipped, 3);
+
+	// No room for the header, then none for the second record
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 0, AMTPTP_IMPORT_ANY_REPORT,
+		AMTPTP_IMPORT_REPORT_MAX, out, AMTPTP_CAPTURE_HEADER_SIZE - 1, &written, &stats), AmtPtpImportBufferTooSmall);
+	AMTPTP_CHECK_EQ(written, 0);
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 0, AMTPTP_IMPORT_ANY_REPORT,
+		AMTPTP_IMPORT_REPORT_MAX, out, AMTPTP_CAPTURE_HEADER_SIZE + 24, &written, &stats), AmtPtpImportBufferTooSmall);
+	AMTPTP_CHECK_EQ(written, AMTPTP_CAPTURE_HEADER_SIZE + 24);
+	AMTPTP_CHECK_EQ(stats.Frames, 1);
+	AMTPTP_CHECK_EQ(stats.BadLine, 9);
+
+	// A report longer than the caller's frame buffer
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 0, AMTPTP_IMPORT_ANY_REPORT, 2,
+		out, sizeof(out), &written, &stats), AmtPtpImportBufferTooSmall);
+	AMTPTP_CHECK_EQ(stats.BadLine, 8);
+	AMTPTP_CHECK_EQ(stats.Frames, 0);
+}
+
+static void
+TestImportMalformed(void)
+{
+	static const struct {
+		const char *Event;
+		AMTPTP_IMPORT_STATUS Status;
+	} cases[] = {
+		{ "E: 1.5 1 31", AmtPtpImportOk },
+		{ "E: 1 1 31", AmtPtpImportBadLine },					// No microseconds
+		{ "E: .5 1 31", AmtPtpImportBadLine },					// No seconds
+		{ "E: 1.1000000 1 31", AmtPtpImportBadLine },			// Microseconds out of range
+		{ "E: 1.5 31", AmtPtpImportBadLine },					// No length
+		{ "E: 1.5 2 31", AmtPtpImportBadLine },				// Fewer bytes than the length
+		{ "E: 1.5 1 31 32", AmtPtpImportBadLine },				// More bytes than the length
+		{ "E: 1.5 1 3", AmtPtpImportBadLine },					// Half a byte
+		{ "E: 1.5 1 312", AmtPtpImportBadLine },				// A byte of three digits
+		{ "E: 1.5 1 zz", AmtPtpImportBadLine },				// Not hex
+		{ "E: 1.5 16385 31", AmtPtpImportBadLine },			// Beyond HID_MAX_BUFFER_SIZE
+		{ "E: 99999999999999999999.5 1 31", AmtPtpImportBadLine },	// Seconds overflow
+		{ "E: 18446744073709.5 1 31", AmtPtpImportBadLine },	// Ticks overflow
+		{ "E:", AmtPtpImportBadLine },
+	};
+	static uint8_t out[256];
+	AMTPTP_IMPORT_STATS stats;
+	char text[128];
+	size_t written, i;
+	int n;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		n = snprintf(text, sizeof(text), "I: 3 05ac 0262\nE: 0.0 1 31\n%s\nE: 3.0 1 31\n", cases[i].Event);
+		AMTPTP_CHECK_EQ(ImportText(text, (size_t) n, 0, AMTPTP_IMPORT_ANY_REPORT, AMTPTP_IMPORT_REPORT_MAX,
+			out, sizeof(out), &written, &stats), cases[i].Status);
+
+		// Reports before the bad line are kept as a whole capture
+		if (cases[i].Status != AmtPtpImportOk) {
+			AMTPTP_CHECK_EQ(stats.BadLine, 3);
+			AMTPTP_CHECK_EQ(stats.Frames, 1);
+			AMTPTP_CHECK_EQ(written, AMTPTP_CAPTURE_HEADER_SIZE + 24);
+		}
+		else {
+			AMTPTP_CHECK_EQ(stats.Frames, 3);
+		}
+	}
+}
+
+// A dump cut at any byte imports the reports of its whole lines, and fails
+// on a cut E: line unless the cut happens to leave a shorter valid one
+static void
+TestImportTruncated(void)
+{
+	static uint8_t out[1024];
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_IMPORT_STATS stats, full;
+	AMTPTP_IMPORT_STATUS status;
+	const uint8_t *frame;
+	uint64_t timestamp, records;
+	uint32_t length;
+	size_t written, cut;
+
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, sizeof(ImportDump) - 1, 0, AMTPTP_IMPORT_ANY_REPORT,
+		AMTPTP_IMPORT_REPORT_MAX, out, sizeof(out), &written, &full), AmtPtpImportOk);
+
+	for (cut = 0; cut < sizeof(ImportDump) - 1; cut++) {
+		status = ImportText(ImportDump, cut, 0, AMTPTP_IMPORT_ANY_REPORT, AMTPTP_IMPORT_REPORT_MAX,
+			out, sizeof(out), &written, &stats);
+		AMTPTP_CHECK(status == AmtPtpImportOk || status == AmtPtpImportBadLine);
+		AMTPTP_CHECK(stats.Frames <= full.Frames);
+		if (status == AmtPtpImportBadLine) {
+			AMTPTP_CHECK_EQ(stats.BadLine, stats.Lines);
+		}
+
+		// Whatever was written is a capture holding exactly the imported frames
+		AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, out, written), AmtPtpCaptureOk);
+		for (records = 0; AmtPtpCaptureNext(&reader, &timestamp, &frame, &length) == AmtPtpCaptureOk; records++) {
+		}
+		AMTPTP_CHECK_EQ(records, stats.Frames);
+	}
+
+	// Cut after the second report's last byte, before its line feed
+	cut = (size_t) (strstr(ImportDump, "02 ff") + 5 - ImportDump);
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, cut, 0, AMTPTP_IMPORT_ANY_REPORT, AMTPTP_IMPORT_REPORT_MAX,
+		out, sizeof(out), &written, &stats), AmtPtpImportOk);
+	AMTPTP_CHECK_EQ(stats.Frames, 2);
+
+	// Cut inside its last byte
+	AMTPTP_CHECK_EQ(ImportText(ImportDump, cut - 1, 0, AMTPTP_IMPORT_ANY_REPORT, AMTPTP_IMPORT_REPORT_MAX,
+		out, sizeof(out), &written, &stats), AmtPtpImportBadLine);
+	AMTPTP_CHECK_EQ(stats.Frames, 1);
+	AMTPTP_CHECK_EQ(stats.BadLine, 9);
+}
+
+#define HEADER_TEST_FRAMES		600
+
+static int
+HeaderNear(
+	double Actual,
+	double Expected
+)
+{
+	return Actual > Expected - 1e-9 && Actual < Expected + 1e-9;
+}
+
+static void
+TestHeaderFields(void)
+{
+	static AMTPTP_HEADER_SCAN scan;
+	AMTPTP_HEADER_FIELD field;
+	uint8_t frame[8];
+	uint64_t timestamp = 0;
+	uint32_t fingers, i;
+	uint8_t button;
+
+	// Longer than a block, so the narrow counters are folded mid-scan
+	AmtPtpHeaderScanInit(&scan, sizeof(frame));
+	for (i = 0; i < HEADER_TEST_FRAMES; i++) {
+		timestamp += 1000 + (i % 3) * 100;
+		fingers = i % 6;
+		button = (uint8_t) ((i / 3) & 1);
+
+		frame[0] = 0x42;							// Constant
+		frame[1] = (uint8_t) (fingers * 10);		// Finger summary
+		PutS16(&frame[2], (int32_t) (timestamp / 10));	// Clock, wraps once
+		frame[4] = button ? 0x80 : 0x00;			// Button state
+		frame[5] = (uint8_t) (i * 7);				// Byte counter
+		frame[6] = frame[7] = (uint8_t) (i % 4);	// One value in both bytes
+		AmtPtpHeaderScanFrame(&scan, frame, sizeof(frame), timestamp, fingers, button);
+	}
+
+	// Frames shorter than the header are left out
+	AmtPtpHeaderScanFrame(&scan, frame, 4, timestamp + 1000, 0, 0);
+
+	AMTPTP_CHECK_EQ(scan.Frames, HEADER_TEST_FRAMES);
+	AMTPTP_CHECK_EQ(scan.Steps, HEADER_TEST_FRAMES - 1);
+
+	AmtPtpHeaderScanByte(&scan, 0, &field);
+	AMTPTP_CHECK(HeaderNear(field.Entropy, 0.0));
+	AMTPTP_CHECK_EQ(field.Distinct, 1);
+	AMTPTP_CHECK_EQ(scan.ByteSteps[0].Same, scan.Steps);
+
+	AmtPtpHeaderScanByte(&scan, 1, &field);
+	AMTPTP_CHECK_EQ(field.Distinct, 6);
+	AMTPTP_CHECK(HeaderNear(field.FingerCorrelation, 1.0));
+
+	AmtPtpHeaderScanByte(&scan, 4, &field);
+	AMTPTP_CHECK(HeaderNear(field.Entropy, 1.0));
+	AMTPTP_CHECK(HeaderNear(field.ButtonCorrelation, 1.0));
+
+	AmtPtpHeaderScanByte(&scan, 5, &field);
+	AMTPTP_CHECK(HeaderNear(field.Forward, 1.0));
+	AMTPTP_CHECK_EQ(field.Wraps, (7 * (HEADER_TEST_FRAMES - 1)) / 256);
+
+	AmtPtpHeaderScanWord(&scan, 2, &field);
+	AMTPTP_CHECK(HeaderNear(field.Forward, 1.0));
+	AMTPTP_CHECK_EQ(field.Wraps, 1);
+	AMTPTP_CHECK(HeaderNear(field.IntervalCorrelation, 1.0));
+
+	// Equal bytes carry the entropy of one of them, which is the low bound
+	AmtPtpHeaderScanWord(&scan, 6, &field);
+	AMTPTP_CHECK(HeaderNear(field.EntropyLow, 2.0));
+	AMTPTP_CHECK(HeaderNear(field.EntropyHigh, 4.0));
+	AMTPTP_CHECK(HeaderNear(field.Entropy, 0.0));
+
+	// The button and counter bytes: the counter's entropy is the low bound,
+	// the button's bit on top of it the high one
+	AmtPtpHeaderScanWord(&scan, 4, &field);
+	AMTPTP_CHECK(field.EntropyLow > 7.9);
+	AMTPTP_CHECK(HeaderNear(field.EntropyHigh, field.EntropyLow + 1.0));
+
+	// Words start at even offsets
+	AmtPtpHeaderScanWord(&scan, 3, &field);
+	AMTPTP_CHECK(HeaderNear(field.EntropyHigh, 0.0));
+}
+
+static void
+TestHeaderKernels(void)
+{
+	static AMTPTP_HEADER_SCAN scalar, vector;
+	AMTPTP_TEST_RANDOM random = { 0x1234 };
+	uint8_t frame[AMTPTP_HEADER_SCAN_BYTES];
+	uint64_t timestamp = 0;
+	uint32_t fingers, i;
+	uint8_t button;
+	size_t header;
+
+	AMTPTP_CHECK(AmtPtpHeaderKernelAvailable(AmtPtpHeaderKernelScalar));
+	AMTPTP_CHECK(!AmtPtpHeaderKernelAvailable(AmtPtpHeaderKernelCount));
+	AMTPTP_CHECK(strcmp(AmtPtpHeaderKernelName(AmtPtpHeaderKernelSse2), "sse2") == 0);
+
+	// Every header size covers a different split of 16-byte steps and tail
+	for (header = 1; header <= AMTPTP_HEADER_SCAN_BYTES; header += 9) {
+		AmtPtpHeaderScanInit(&scalar, header);
+		AmtPtpHeaderScanInit(&vector, header);
+		scalar.Kernel = AmtPtpHeaderKernelScalar;
+		vector.Kernel = AmtPtpHeaderKernelSse2;
+
+		for (i = 0; i < HEADER_TEST_FRAMES; i++) {
+			AmtPtpTestFill(&random, frame, sizeof(frame));
+
+			// Runs of repeated bytes give same steps; damaged frames claim
+			// more finger records than a block's lanes take
+			if (i % 5 == 0) {
+				memset(frame, frame[0], sizeof(frame) / 2);
+			}
+			fingers = i % 50 == 0 ? 1000 + i : AmtPtpTestNext(&random) % 256;
+			button = (uint8_t) (AmtPtpTestNext(&random) & 3);
+			timestamp += 8000 + AmtPtpTestNext(&random) % 512;
+
+			AmtPtpHeaderScanFrame(&scalar, frame, sizeof(frame), timestamp, fingers, button);
+			AmtPtpHeaderScanFrame(&vector, frame, sizeof(frame), timestamp, fingers, button);
+		}
+
+		vector.Kernel = scalar.Kernel;
+		AMTPTP_CHECK_MEM(&vector, &scalar, sizeof(scalar));
+		AMTPTP_CHECK_EQ(scalar.Frames, HEADER_TEST_FRAMES);
+	}
+}
+
+static void
+TestHeaderCapture(void)
+{
+	static uint8_t capture[96 * 1024];
+	static AMTPTP_HEADER_SCAN frames, blocks;
+	AMTPTP_TEST_RANDOM random = { 0x5678 };
+	AMTPTP_CAPTURE_DEVICE device;
+	AMTPTP_CAPTURE_READER reader;
+	const uint8_t *frame;
+	uint8_t raw[HEADER_SIZE_TYPE4 + 3 * FINGER_SIZE_TYPE4];
+	uint64_t timestamp;
+	uint32_t length, i;
+	size_t used, written;
+
+	memset(&device, 0, sizeof(device));
+	device.IdVendor = 0x05ac;
+	device.IdProduct = 0x0262;
+	device.TimestampFrequency = 1000000;
+	InitType4(&device.Decoder);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureEncodeHeader(&device, capture, sizeof(capture), &used), AmtPtpCaptureOk);
+
+	// More records than a block, with zero to three fingers each
+	for (i = 0; i < HEADER_TEST_FRAMES; i++) {
+		AmtPtpTestFill(&random, raw, sizeof(raw));
+		length = HEADER_SIZE_TYPE4 + (i % 4) * FINGER_SIZE_TYPE4;
+		AMTPTP_CHECK_EQ(AmtPtpCaptureEncodeRecord(8000ull * i, raw, length, capture + used,
+			sizeof(capture) - used, &written), AmtPtpCaptureOk);
+		used += written;
+	}
+
+	// One frame at a time through AmtPtpHeaderScanFrame is the reference
+	AmtPtpHeaderScanInit(&frames, HEADER_SIZE_TYPE4);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, capture, used), AmtPtpCaptureOk);
+	while (AmtPtpCaptureNext(&reader, &timestamp, &frame, &length) == AmtPtpCaptureOk) {
+		AmtPtpHeaderScanFrame(&frames, frame, length, timestamp,
+			(length - HEADER_SIZE_TYPE4) / FINGER_SIZE_TYPE4, frame[BUTTON_OFFSET_TYPE4]);
+	}
+
+	AmtPtpHeaderScanInit(&blocks, HEADER_SIZE_TYPE4);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, capture, used), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(AmtPtpHeaderScanCapture(&blocks, &reader), AmtPtpCaptureOk);
+
+	AMTPTP_CHECK_EQ(blocks.Frames, HEADER_TEST_FRAMES);
+	AMTPTP_CHECK_MEM(&blocks, &frames, sizeof(frames));
+}
+
+int
+main(void)
+{
+	TestScanTime();
+	TestDecodeWellspring();
+	TestDecodeType5();
+	TestDecodeSpi();
+	TestSelectDecoder();
+	TestPackReport();
+	TestPackCompactReport();
+	TestUnpackReport();
+	TestMapContactIds();
+	TestAnalyzeReports();
+	TestAnalyzeMerge();
+	TestBaselineIndex();
+	TestBaselineCheck();
+	TestBaselineHistory();
+	TestBaselineLargeStore();
+	TestImportHidRecorder();
+	TestImportMalformed();
+	TestImportTruncated();
+	TestHeaderFields();
+	TestHeaderKernels();
+	TestHeaderCapture();
+
+	return AMTPTP_TEST_RESULT();
+}
@@ -0,0 +1,23 @@
+// AmtPtpDecodeFuzz.c: libFuzzer target for the raw frame decoders
+//
+// See AmtPtpFuzz.h for the input format. Runs as a ctest over
+// test/corpus/AmtPtpDecodeFuzz through AmtPtpFuzzMain.c, and as a libFuzzer
+// binary where the compiler has one.
+
+#include <stdlib.h>
+
+#include "AmtPtpFuzz.h"
+
+int
+LLVMFuzzerTestOneInput(
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	// A broken guarantee is a crash, so libFuzzer keeps the input
+	if (AmtPtpFuzzOne(Data, Size)) {
+		abort();
+	}
+
+	return 0;
+}
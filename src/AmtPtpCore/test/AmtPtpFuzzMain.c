@@ -0,0 +1,193 @@
+// AmtPtpFuzzMain.c: Standalone runner for LLVMFuzzerTestOneInput
+//
+// Linked in place of libFuzzer where the compiler has none, so every fuzz
+// target also runs as an ordinary ctest. Replays each file named on the
+// command line, or every file in a named directory, then feeds generated
+// inputs from a fixed seed. Each input lives in a heap block of exactly its
+// size for the sanitizers, and must return within the time bound. Options
+// use libFuzzer's spelling:
+//   -runs=N     Generated inputs, default 10000
+//   -seed=N     Generator seed, default 1
+//   -max_len=N  Longest generated input, default 512
+//   -timeout=N  Seconds allowed per input, default 1
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "AmtPtpTest.h"
+
+int
+LLVMFuzzerTestOneInput(
+	const uint8_t *Data,
+	size_t Size
+);
+
+typedef struct _AMTPTP_FUZZ_RUN {
+	double TimeLimit;
+	unsigned long Inputs;
+	unsigned long SlowInputs;
+	unsigned long FileErrors;
+} AMTPTP_FUZZ_RUN, *PAMTPTP_FUZZ_RUN;
+
+static double
+AmtPtpFuzzNow(
+	void
+)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+// Takes ownership of Data
+static void
+AmtPtpFuzzRunOne(
+	PAMTPTP_FUZZ_RUN Run,
+	const char *Name,
+	uint8_t *Data,
+	size_t Size
+)
+{
+	double start, elapsed;
+
+	start = AmtPtpFuzzNow();
+	LLVMFuzzerTestOneInput(Data, Size);
+	elapsed = AmtPtpFuzzNow() - start;
+	free(Data);
+
+	Run->Inputs++;
+	if (elapsed > Run->TimeLimit) {
+		if (Run->SlowInputs++ < 20) {
+			fprintf(stderr, "%s: %zu bytes took %.3f s, limit is %.3f s\n", Name, Size, elapsed, Run->TimeLimit);
+		}
+	}
+}
+
+static void
+AmtPtpFuzzRunFile(
+	PAMTPTP_FUZZ_RUN Run,
+	const char *Path
+)
+{
+	FILE *file;
+	uint8_t *data;
+	long size;
+
+	file = fopen(Path, "rb");
+	if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+		fprintf(stderr, "%s: cannot read\n", Path);
+		Run->FileErrors++;
+		if (file != NULL) {
+			fclose(file);
+		}
+		return;
+	}
+
+	// malloc(0) may return NULL; the target still gets a valid pointer
+	data = malloc(size ? (size_t) size : 1);
+	if (data == NULL || fread(data, 1, (size_t) size, file) != (size_t) size) {
+		fprintf(stderr, "%s: cannot read\n", Path);
+		Run->FileErrors++;
+		free(data);
+		fclose(file);
+		return;
+	}
+	fclose(file);
+
+	AmtPtpFuzzRunOne(Run, Path, data, (size_t) size);
+}
+
+static void
+AmtPtpFuzzRunPath(
+	PAMTPTP_FUZZ_RUN Run,
+	const char *Path
+)
+{
+	struct stat info;
+	struct dirent *entry;
+	char child[4096];
+	DIR *directory;
+
+	if (stat(Path, &info) != 0) {
+		fprintf(stderr, "%s: not found\n", Path);
+		Run->FileErrors++;
+		return;
+	}
+	if (!S_ISDIR(info.st_mode)) {
+		AmtPtpFuzzRunFile(Run, Path);
+		return;
+	}
+
+	directory = opendir(Path);
+	if (directory == NULL) {
+		fprintf(stderr, "%s: cannot open\n", Path);
+		Run->FileErrors++;
+		return;
+	}
+	while ((entry = readdir(directory)) != NULL) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+		snprintf(child, sizeof(child), "%s/%s", Path, entry->d_name);
+		if (stat(child, &info) == 0 && S_ISREG(info.st_mode)) {
+			AmtPtpFuzzRunFile(Run, child);
+		}
+	}
+	closedir(directory);
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	AMTPTP_FUZZ_RUN run;
+	AMTPTP_TEST_RANDOM random;
+	unsigned long runs = 10000, maxLength = 512, i;
+	uint8_t *data;
+	size_t size;
+	int arg;
+
+	memset(&run, 0, sizeof(run));
+	run.TimeLimit = 1.0;
+	random.State = 1;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp(argv[arg], "-runs=", 6) == 0) {
+			runs = strtoul(argv[arg] + 6, NULL, 0);
+		}
+		else if (strncmp(argv[arg], "-seed=", 6) == 0) {
+			random.State = (uint32_t) strtoul(argv[arg] + 6, NULL, 0);
+		}
+		else if (strncmp(argv[arg], "-max_len=", 9) == 0) {
+			maxLength = strtoul(argv[arg] + 9, NULL, 0);
+		}
+		else if (strncmp(argv[arg], "-timeout=", 9) == 0) {
+			run.TimeLimit = strtod(argv[arg] + 9, NULL);
+		}
+		else if (argv[arg][0] == '-') {
+			fprintf(stderr, "%s: unknown option\n", argv[arg]);
+			return 2;
+		}
+		else {
+			AmtPtpFuzzRunPath(&run, argv[arg]);
+		}
+	}
+
+	for (i = 0; i < runs; i++) {
+		size = (size_t) (AmtPtpTestNext(&random) % (maxLength + 1));
+		data = malloc(size ? size : 1);
+		if (data == NULL) {
+			return 2;
+		}
+		AmtPtpTestFill(&random, data, size);
+		AmtPtpFuzzRunOne(&run, "generated input", data, size);
+	}
+
+	printf("%lu inputs, %lu over the time bound\n", run.Inputs, run.SlowInputs);
+	return run.SlowInputs != 0 || run.FileErrors != 0;
+}
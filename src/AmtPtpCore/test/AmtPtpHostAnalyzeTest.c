@@ -0,0 +1,199 @@
+// AmtPtpHostAnalyzeTest.c: Parallel corpus analysis against the serial one
+//
+//   AmtPtpHostAnalyzeTest CaptureDir ReportDir
+//
+// Analyzes every capture of CaptureDir with the report stream of the same
+// name in ReportDir, once capture by capture and once with
+// AmtPtpAnalyzeParallel for several thread counts, and checks the totals are
+// identical. Damaged and foreign inputs must be reported without holding
+// back the others. Runs under ThreadSanitizer where available.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AmtPtpTest.h"
+#include "AmtPtpAnalyzeParallel.h"
+#include "AmtPtpCaptureFile.h"
+
+#define AMTPTP_TEST_MAX_CAPTURES	64
+
+static AMTPTP_CAPTURE_MAP AmtPtpTestCaptures[AMTPTP_TEST_MAX_CAPTURES];
+static AMTPTP_CAPTURE_MAP AmtPtpTestReports[AMTPTP_TEST_MAX_CAPTURES];
+static AMTPTP_ANALYZE_INPUT AmtPtpTestInputs[AMTPTP_TEST_MAX_CAPTURES];
+
+static int
+AmtPtpTestCompareNames(
+	const void *a,
+	const void *b
+)
+{
+	return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// Maps the captures of CaptureDir and their reports, in name order
+static size_t
+AmtPtpTestLoad(
+	const char *CaptureDir,
+	const char *ReportDir
+)
+{
+	char *names[AMTPTP_TEST_MAX_CAPTURES];
+	char path[4096];
+	struct dirent *entry;
+	size_t count = 0, length, i;
+	DIR *dir = opendir(CaptureDir);
+
+	AMTPTP_CHECK(dir != NULL);
+	if (dir == NULL) {
+		return 0;
+	}
+
+	while ((entry = readdir(dir)) != NULL && count < AMTPTP_TEST_MAX_CAPTURES) {
+		length = strlen(entry->d_name);
+		if (length > 8 && strcmp(entry->d_name + length - 8, ".capture") == 0) {
+			names[count++] = strndup(entry->d_name, length - 8);
+		}
+	}
+	closedir(dir);
+	qsort(names, count, sizeof(names[0]), AmtPtpTestCompareNames);
+
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), "%s/%s.capture", CaptureDir, names[i]);
+		AMTPTP_CHECK_EQ(AmtPtpCaptureMap(path, &AmtPtpTestCaptures[i]), 0);
+		snprintf(path, sizeof(path), "%s/%s.reports", ReportDir, names[i]);
+		AMTPTP_CHECK_EQ(AmtPtpCaptureMap(path, &AmtPtpTestReports[i]), 0);
+		free(names[i]);
+
+		AmtPtpTestInputs[i].Capture = AmtPtpTestCaptures[i].Base;
+		AmtPtpTestInputs[i].CaptureSize = AmtPtpTestCaptures[i].Size;
+		AmtPtpTestInputs[i].Reports = AmtPtpTestReports[i].Base;
+		AmtPtpTestInputs[i].ReportsSize = AmtPtpTestReports[i].Size;
+	}
+
+	return count;
+}
+
+static void
+AmtPtpTestSerial(
+	const AMTPTP_ANALYZE_INPUT *Inputs,
+	size_t Count,
+	PAMTPTP_ANALYSIS Total
+)
+{
+	static AMTPTP_ANALYSIS capture;
+	AMTPTP_CAPTURE_READER reader;
+	size_t i;
+
+	AmtPtpAnalyzeInit(Total);
+	for (i = 0; i < Count; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, Inputs[i].Capture, Inputs[i].CaptureSize), AmtPtpCaptureOk);
+		AmtPtpAnalyzeInit(&capture);
+		AMTPTP_CHECK_EQ(AmtPtpAnalyzeCapture(&capture, &reader), AmtPtpCaptureEnd);
+		AMTPTP_CHECK_EQ(AmtPtpAnalyzeReports(&capture, Inputs[i].Reports, Inputs[i].ReportsSize,
+			AMTPTP_REPORT_SIZE), Inputs[i].ReportsSize / AMTPTP_REPORT_SIZE);
+		AmtPtpAnalyzeMerge(Total, &capture);
+	}
+}
+
+static void
+AmtPtpTestParallel(
+	size_t Count
+)
+{
+	static const uint32_t threadCounts[] = { 0, 1, 2, 3, 8, AMTPTP_ANALYZE_MAX_THREADS + 1 };
+	static AMTPTP_ANALYSIS serial, parallel;
+	size_t t, i;
+
+	AmtPtpTestSerial(AmtPtpTestInputs, Count, &serial);
+	AMTPTP_CHECK(serial.Frames > 0);
+	AMTPTP_CHECK(serial.Contacts > 0);
+
+	// The golden streams hold one report per decoded frame
+	AMTPTP_CHECK_EQ(serial.Reports, serial.Frames);
+	AMTPTP_CHECK_EQ(AmtPtpAnalyzeDropped(&serial), 0);
+
+	for (t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+		AMTPTP_CHECK_EQ(AmtPtpAnalyzeParallel(AmtPtpTestInputs, Count, AMTPTP_REPORT_SIZE, threadCounts[t],
+			&parallel), 0);
+		AMTPTP_CHECK_MEM(&parallel, &serial, sizeof(serial));
+		for (i = 0; i < Count; i++) {
+			AMTPTP_CHECK_EQ(AmtPtpTestInputs[i].Status, AmtPtpCaptureEnd);
+		}
+	}
+
+	// No input at all leaves an empty analysis
+	AmtPtpAnalyzeInit(&serial);
+	AMTPTP_CHECK_EQ(AmtPtpAnalyzeParallel(AmtPtpTestInputs, 0, AMTPTP_REPORT_SIZE, 4, &parallel), 0);
+	AMTPTP_CHECK_MEM(&parallel, &serial, sizeof(serial));
+}
+
+static void
+AmtPtpTestDamaged(
+	size_t Count
+)
+{
+	static AMTPTP_ANALYZE_INPUT inputs[AMTPTP_TEST_MAX_CAPTURES + 2];
+	static AMTPTP_ANALYSIS serial, parallel;
+	static const uint8_t garbage[64] = { 'n', 'o', 't' };
+	AMTPTP_CAPTURE_READER reader;
+	const uint8_t *frame;
+	uint64_t timestamp, records = 0;
+	uint32_t length;
+	size_t start, last = 0, i;
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestInputs[0].Capture, AmtPtpTestInputs[0].CaptureSize),
+		AmtPtpCaptureOk);
+	for (start = reader.Offset; AmtPtpCaptureNext(&reader, &timestamp, &frame, &length) == AmtPtpCaptureOk;
+		start = reader.Offset) {
+		last = start;
+		records++;
+	}
+
+	// A capture cut inside its last record, and bytes that are no capture
+	memcpy(inputs, AmtPtpTestInputs, Count * sizeof(inputs[0]));
+	inputs[Count] = AmtPtpTestInputs[0];
+	inputs[Count].CaptureSize = last + 4;
+	inputs[Count].Reports = NULL;
+	inputs[Count + 1].Capture = garbage;
+	inputs[Count + 1].CaptureSize = sizeof(garbage);
+
+	AMTPTP_CHECK_EQ(AmtPtpAnalyzeParallel(inputs, Count + 2, AMTPTP_REPORT_SIZE, 3, &parallel), 2);
+	AMTPTP_CHECK_EQ(inputs[Count].Status, AmtPtpCaptureTruncated);
+	AMTPTP_CHECK_EQ(inputs[Count + 1].Status, AmtPtpCaptureBadHeader);
+	for (i = 0; i < Count; i++) {
+		AMTPTP_CHECK_EQ(inputs[i].Status, AmtPtpCaptureEnd);
+	}
+
+	// The cut capture counts the records before the cut, without a report stream
+	AmtPtpTestSerial(AmtPtpTestInputs, Count, &serial);
+	AMTPTP_CHECK_EQ(parallel.Reports, serial.Reports);
+	AMTPTP_CHECK_EQ(parallel.Frames + parallel.Malformed, serial.Frames + serial.Malformed + records - 1);
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	size_t count, i;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s CaptureDir ReportDir\n", argv[0]);
+		return 2;
+	}
+
+	count = AmtPtpTestLoad(argv[1], argv[2]);
+	AMTPTP_CHECK(count > 1);
+
+	AmtPtpTestParallel(count);
+	AmtPtpTestDamaged(count);
+
+	for (i = 0; i < count; i++) {
+		AmtPtpCaptureUnmap(&AmtPtpTestCaptures[i]);
+		AmtPtpCaptureUnmap(&AmtPtpTestReports[i]);
+	}
+	return AMTPTP_TEST_RESULT();
+}
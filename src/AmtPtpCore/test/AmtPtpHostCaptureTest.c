@@ -0,0 +1,288 @@
+// AmtPtpHostCaptureTest.c: Capture files written, reopened, cut short and read back
+//
+//   AmtPtpHostCaptureTest Prefix
+//
+// Writes Prefix.capture through several flushes of the writer's buffer, maps
+// it and reads every record back, then appends to it again. A short capture
+// is then cut after every byte of its header and around every boundary of
+// its records: the reader must return each complete record and report the
+// cut one, and reopening the cut file must continue right after the last
+// complete record.
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "AmtPtpCaptureFile.h"
+#include "AmtPtpTest.h"
+
+#define AMTPTP_TEST_RECORDS		5000
+#define AMTPTP_TEST_APPENDED	300
+#define AMTPTP_TEST_SHORT		12
+#define AMTPTP_TEST_FRAME_MAX	700
+
+static const uint8_t AmtPtpTestConfig[13] = { 'c', 'o', 'n', 'f', 'i', 'g', ' ', 'r', 'o', 'w', 0, 1, 2 };
+
+static void
+AmtPtpTestDevice(
+	PAMTPTP_CAPTURE_DEVICE Device
+)
+{
+	memset(Device, 0, sizeof(*Device));
+	Device->IdVendor = 0x05AC;
+	Device->IdProduct = 0x0265;
+	Device->TrackpadType = 4;
+	Device->TimestampFrequency = 10000000;
+	AmtPtpInitDecoder(&Device->Decoder, AmtPtpFrameFormatType5);
+	Device->Decoder.HeaderSize = 12;
+	Device->Decoder.FingerSize = 9;
+	Device->Decoder.XMin = -3678;
+	Device->Decoder.YMin = -2479;
+	Device->Decoder.YMax = 2586;
+	Device->Config = AmtPtpTestConfig;
+	Device->ConfigLength = sizeof(AmtPtpTestConfig);
+}
+
+// Record Index of every capture written here, empty frames included
+static void
+AmtPtpTestRecord(
+	uint32_t Index,
+	uint8_t *Frame,
+	uint32_t *Length,
+	uint64_t *Timestamp
+)
+{
+	AMTPTP_TEST_RANDOM random = { Index * 2654435761u + 1 };
+
+	*Length = Index % 7 == 3 ? 0 : AmtPtpTestNext(&random) % AMTPTP_TEST_FRAME_MAX;
+	*Timestamp = (uint64_t) Index * 80000 + AmtPtpTestNext(&random) % 1000;
+	AmtPtpTestFill(&random, Frame, *Length);
+}
+
+static void
+AmtPtpTestAppend(
+	PAMTPTP_CAPTURE_FILE File,
+	uint32_t First,
+	uint32_t Count
+)
+{
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX];
+	uint64_t timestamp;
+	uint32_t length, i;
+
+	for (i = First; i < First + Count; i++) {
+		AmtPtpTestRecord(i, frame, &length, &timestamp);
+		AMTPTP_CHECK_EQ(AmtPtpCaptureFileAppend(File, timestamp, frame, length), 0);
+	}
+}
+
+// Reads Path back; it must hold records 0 to Count - 1 and nothing else
+static void
+AmtPtpTestCheckFile(
+	const char *Path,
+	uint32_t Count
+)
+{
+	AMTPTP_CAPTURE_DEVICE device;
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_CAPTURE_MAP map;
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX];
+	const uint8_t *read;
+	uint64_t timestamp, readTimestamp;
+	uint32_t length, readLength, i;
+	size_t size;
+
+	AmtPtpTestDevice(&device);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureMap(Path, &map), 0);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, map.Base, map.Size), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(reader.Device.IdProduct, device.IdProduct);
+	AMTPTP_CHECK_EQ(reader.Device.TrackpadType, device.TrackpadType);
+	AMTPTP_CHECK_EQ(reader.Device.TimestampFrequency, device.TimestampFrequency);
+	AMTPTP_CHECK_EQ(reader.Device.Decoder.YMax, device.Decoder.YMax);
+	AMTPTP_CHECK_EQ(reader.Device.ConfigLength, sizeof(AmtPtpTestConfig));
+	AMTPTP_CHECK_MEM(reader.Device.Config, AmtPtpTestConfig, sizeof(AmtPtpTestConfig));
+
+	size = AmtPtpCaptureHeaderLength(sizeof(AmtPtpTestConfig));
+	for (i = 0; i < Count; i++) {
+		AmtPtpTestRecord(i, frame, &length, &timestamp);
+		size += AmtPtpCaptureRecordLength(length);
+		if (AmtPtpCaptureNext(&reader, &readTimestamp, &read, &readLength) != AmtPtpCaptureOk) {
+			AMTPTP_CHECK_EQ(i, Count);
+			break;
+		}
+		AMTPTP_CHECK_EQ(readTimestamp, timestamp);
+		AMTPTP_CHECK_EQ(readLength, length);
+		AMTPTP_CHECK(length == 0 || memcmp(read, frame, length) == 0);
+	}
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureNext(&reader, &readTimestamp, &read, &readLength), AmtPtpCaptureEnd);
+	AMTPTP_CHECK_EQ(map.Size, size);
+	AmtPtpCaptureUnmap(&map);
+}
+
+static void
+AmtPtpTestWrite(
+	const char *Path,
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	FILE *f = fopen(Path, "wb");
+
+	AMTPTP_CHECK(f != NULL);
+	if (f != NULL) {
+		AMTPTP_CHECK_EQ(fwrite(Data, 1, Size, f), Size);
+		fclose(f);
+	}
+}
+
+// Cuts the short capture after Cut bytes, reads it and continues writing it
+static void
+AmtPtpTestCut(
+	const AMTPTP_CAPTURE_MAP *Full,
+	const char *Path,
+	size_t Cut
+)
+{
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_CAPTURE_STATUS status;
+	AMTPTP_CAPTURE_FILE *file;
+	AMTPTP_CAPTURE_MAP map;
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX];
+	const uint8_t *read;
+	uint64_t timestamp;
+	uint32_t length, complete = 0, i;
+	size_t header = AmtPtpCaptureHeaderLength(sizeof(AmtPtpTestConfig));
+	size_t start = header, end = header;
+
+	AmtPtpTestWrite(Path, Full->Base, Cut);
+	file = malloc(sizeof(*file));
+
+	if (Cut < header) {
+		AMTPTP_CHECK_EQ(AmtPtpCaptureMap(Path, &map), 0);
+		AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, map.Base, map.Size), AmtPtpCaptureBadHeader);
+		AmtPtpCaptureUnmap(&map);
+		AMTPTP_CHECK_EQ(AmtPtpCaptureFileOpen(Path, file), EINVAL);
+		free(file);
+		return;
+	}
+
+	// A record is complete once its payload is, padding or not
+	for (i = 0; i < AMTPTP_TEST_SHORT; i++) {
+		AmtPtpTestRecord(i, frame, &length, &timestamp);
+		if (start + AMTPTP_CAPTURE_RECORD_SIZE + length > Cut) {
+			break;
+		}
+		complete++;
+		end = start + AmtPtpCaptureRecordLength(length);
+		start = end;
+	}
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureMap(Path, &map), 0);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, map.Base, map.Size), AmtPtpCaptureOk);
+	for (i = 0; i < complete; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpCaptureNext(&reader, &timestamp, &read, &length), AmtPtpCaptureOk);
+	}
+	status = AmtPtpCaptureNext(&reader, &timestamp, &read, &length);
+	AMTPTP_CHECK_EQ(status, Cut > end ? AmtPtpCaptureTruncated : AmtPtpCaptureEnd);
+	AMTPTP_CHECK(read == NULL);
+	AmtPtpCaptureUnmap(&map);
+
+	// Writing resumes with the record that was cut
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileOpen(Path, file), 0);
+	AMTPTP_CHECK_EQ(file->Records, complete);
+	AmtPtpTestAppend(file, complete, 1);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileClose(file), 0);
+	AmtPtpTestCheckFile(Path, complete + 1);
+	free(file);
+
+	if (AmtPtpTestFailures != 0) {
+		fprintf(stderr, "  cut after %zu bytes\n", Cut);
+	}
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_CAPTURE_FILE file;
+	static uint8_t garbage[100];
+	AMTPTP_CAPTURE_DEVICE device;
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_CAPTURE_MAP full, map;
+	uint8_t frame[AMTPTP_TEST_FRAME_MAX];
+	uint64_t timestamp;
+	uint32_t length, i;
+	size_t cut, start, header;
+	char path[1024], cutPath[1024];
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s Prefix\n", argv[0]);
+		return 2;
+	}
+	snprintf(path, sizeof(path), "%s.capture", argv[1]);
+	snprintf(cutPath, sizeof(cutPath), "%s.cut.capture", argv[1]);
+	AmtPtpTestDevice(&device);
+
+	// Many times the writer's buffer
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileCreate(path, &device, &file), 0);
+	AmtPtpTestAppend(&file, 0, AMTPTP_TEST_RECORDS);
+	AMTPTP_CHECK_EQ(file.Records, AMTPTP_TEST_RECORDS);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileClose(&file), 0);
+	AmtPtpTestCheckFile(path, AMTPTP_TEST_RECORDS);
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileOpen(path, &file), 0);
+	AMTPTP_CHECK_EQ(file.Records, AMTPTP_TEST_RECORDS);
+	AmtPtpTestAppend(&file, AMTPTP_TEST_RECORDS, AMTPTP_TEST_APPENDED);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileAppend(&file, 0, NULL, AMTPTP_CAPTURE_FILE_BUFFER), EMSGSIZE);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileClose(&file), 0);
+	AmtPtpTestCheckFile(path, AMTPTP_TEST_RECORDS + AMTPTP_TEST_APPENDED);
+
+	// Cuts through the header, then around every boundary of every record
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileCreate(path, &device, &file), 0);
+	AmtPtpTestAppend(&file, 0, AMTPTP_TEST_SHORT);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileClose(&file), 0);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureMap(path, &full), 0);
+
+	header = AmtPtpCaptureHeaderLength(sizeof(AmtPtpTestConfig));
+	for (cut = 0; cut <= header && AmtPtpTestFailures == 0; cut++) {
+		AmtPtpTestCut(&full, cutPath, cut);
+	}
+
+	start = header;
+	for (i = 0; i < AMTPTP_TEST_SHORT && AmtPtpTestFailures == 0; i++) {
+		const size_t offsets[] = { 1, 8, 15, 16, 17 };
+		size_t o;
+
+		AmtPtpTestRecord(i, frame, &length, &timestamp);
+		for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+			AmtPtpTestCut(&full, cutPath, start + offsets[o]);
+		}
+		for (cut = start + AMTPTP_CAPTURE_RECORD_SIZE + length - 1;
+			cut <= start + AmtPtpCaptureRecordLength(length) + 1 && cut <= full.Size; cut++) {
+			AmtPtpTestCut(&full, cutPath, cut);
+		}
+		start += AmtPtpCaptureRecordLength(length);
+	}
+	AMTPTP_CHECK_EQ(start, full.Size);
+	AmtPtpCaptureUnmap(&full);
+
+	// Neither an empty file nor another file is a capture
+	AmtPtpTestWrite(cutPath, garbage, 0);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureMap(cutPath, &map), 0);
+	AMTPTP_CHECK(map.Base == NULL);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, map.Base, map.Size), AmtPtpCaptureBadHeader);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileOpen(cutPath, &file), EINVAL);
+	AmtPtpTestWrite(cutPath, garbage, sizeof(garbage));
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileOpen(cutPath, &file), EINVAL);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileClose(&file), 0);
+	remove(cutPath);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureMap(cutPath, &map), ENOENT);
+	AMTPTP_CHECK_EQ(AmtPtpCaptureFileOpen(cutPath, &file), ENOENT);
+
+	remove(path);
+	printf("%u records round trip, %u-record capture cut at every boundary\n",
+		AMTPTP_TEST_RECORDS + AMTPTP_TEST_APPENDED, AMTPTP_TEST_SHORT);
+	return AMTPTP_TEST_RESULT();
+}
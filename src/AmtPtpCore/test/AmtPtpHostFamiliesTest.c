@@ -0,0 +1,124 @@
+// AmtPtpHostFamiliesTest.c: Family rows and benchmark of every driver build
+//
+// Takes the family rows from the driver's own configuration code and checks
+// that they carry what the driver runs: the decoder function it selected,
+// UsbKm's extra minor-axis threshold and the report layout of the build. Each
+// selected decoder must decode synthetic gestures exactly like
+// AmtPtpDecodeFrame, and AmtPtpBenchRun must time every row through it.
+// Built once per driver build.
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpSynth.h"
+#include "AmtPtpTest.h"
+
+#define AMTPTP_TEST_FRAME_MAX		1024
+#define AMTPTP_TEST_BENCH_FRAMES	256
+
+static uint64_t
+AmtPtpTestCounter(
+	void *Context
+)
+{
+	return ++*(uint64_t *) Context;
+}
+
+static void
+AmtPtpTestSelectedDecoder(
+	const AMTPTP_BENCH_FAMILY *Family
+)
+{
+	uint8_t raw[AMTPTP_TEST_FRAME_MAX];
+	AMTPTP_GESTURE_SCRIPT script;
+	AMTPTP_SYNTH_FRAME synth;
+	AMTPTP_FRAME expected, actual;
+	uint32_t fingers, i;
+	size_t length;
+
+	script.Gesture = AmtPtpGestureRestAndTap;
+	script.Width = Family->XMax - Family->Decoder.XMin;
+	script.Height = Family->Decoder.YMax - Family->Decoder.YMin;
+	script.Frames = 24;
+
+	for (fingers = 1; fingers <= AMTPTP_SYNTH_SPI_MAX_FINGERS; fingers++) {
+		script.Fingers = fingers;
+		for (i = 0; i < script.Frames; i++) {
+			AmtPtpSynthGestureFrame(&script, i, &synth);
+			length = AmtPtpSynthEncodeFrame(&Family->Decoder, &synth, raw, sizeof(raw));
+			AMTPTP_CHECK(length != 0);
+
+			AMTPTP_CHECK_EQ(Family->DecodeFrame(&Family->Decoder, raw, length,
+				AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &actual), AmtPtpDecodeOk);
+			AmtPtpDecodeFrame(&Family->Decoder, raw, length, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &expected);
+			AMTPTP_CHECK_FRAME(&actual, &expected);
+		}
+	}
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_BENCH_FAMILY families[AMTPTP_HOST_MAX_FAMILIES];
+	AMTPTP_BENCH_RESULT results[AmtPtpBenchStageCount];
+	AMTPTP_BENCH_COUNTERS counters;
+	WDFDRIVER driver = NULL;
+	uint64_t ticks = 0;
+	size_t count, f;
+	int s;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+	count = AmtPtpHostGetFamilies(driver, families, AMTPTP_HOST_MAX_FAMILIES);
+	AMTPTP_CHECK(count > 0);
+
+	memset(&counters, 0, sizeof(counters));
+	counters.Count = 1;
+	counters.Names[0] = "ticks";
+	counters.Read[0] = AmtPtpTestCounter;
+	counters.Context = &ticks;
+
+	for (f = 0; f < count; f++) {
+		const AMTPTP_BENCH_FAMILY *family = &families[f];
+
+		AMTPTP_CHECK(strncmp(family->Name, AmtPtpHostFamilyDriver, strlen(AmtPtpHostFamilyDriver)) == 0);
+
+		// Every family the drivers support has a decoder of its own
+		AMTPTP_CHECK(family->DecodeFrame == AmtPtpSelectDecoder(&family->Decoder));
+		AMTPTP_CHECK(family->DecodeFrame != AmtPtpDecodeFrame);
+
+		// T2 trackpads also qualify a contact by its minor axis
+		AMTPTP_CHECK_EQ(family->Decoder.Thresholds.TipSwitchMinor, strcmp(AmtPtpHostFamilyDriver, "UsbKm") == 0 ? 150 : 0);
+
+		AMTPTP_CHECK_EQ(family->ReportSize, sizeof(PTP_REPORT));
+		if (family->ReportSize == AMTPTP_COMPACT_REPORT_SIZE) {
+			AMTPTP_CHECK(family->PackReport == AmtPtpPackCompactReport);
+			AMTPTP_CHECK_EQ(family->MapContactIds, family->Decoder.Format != AmtPtpFrameFormatSpi);
+		}
+		else {
+			AMTPTP_CHECK(family->PackReport == AmtPtpPackReport);
+			AMTPTP_CHECK_EQ(family->MapContactIds, 0);
+		}
+
+		AmtPtpTestSelectedDecoder(family);
+
+		AMTPTP_CHECK_EQ(AmtPtpBenchRun(family, 5, AMTPTP_TEST_BENCH_FRAMES, &counters, results), 0);
+		for (s = 0; s < AmtPtpBenchStageCount; s++) {
+			AMTPTP_CHECK(results[s].Family == family->Name);
+			AMTPTP_CHECK_EQ(results[s].Frames, AMTPTP_TEST_BENCH_FRAMES);
+			AMTPTP_CHECK_EQ(results[s].Counts[0], 1);
+		}
+		AMTPTP_CHECK(AmtPtpBenchRun(family, AMTPTP_SYNTH_MAX_FINGERS + 1, 1, &counters, results) != 0);
+	}
+
+	printf("%s: %zu families\n", AmtPtpHostFamilyDriver, count);
+	for (f = 0; f < count; f++) {
+		printf("  %s format %d, %u-byte report%s\n", families[f].Name, (int) families[f].Decoder.Format,
+			(unsigned) families[f].ReportSize, families[f].MapContactIds ? ", renumbered contacts" : "");
+	}
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
@@ -0,0 +1,346 @@
+// AmtPtpHostFeatureFuzz.c: Fuzz target for the feature report handlers of one driver
+//
+// Any process that opens the vendor collection can send GET_FEATURE and
+// SET_FEATURE with buffers of its choosing. Each input starts a fresh device
+// on the host WDF shim and sends it a sequence of feature requests through
+// the same IOCTLs HIDCLASS uses, so AmtPtpReportFeatures, AmtPtpSetFeatures
+// and the UMDF packet helpers parse them exactly as on Windows. Every report
+// buffer is a heap block of exactly the advertised length, so the sanitizer
+// build catches any access past it. Each request must complete in dispatch
+// with the status the report length and ID call for.
+//
+// Input, repeated for up to AMTPTP_FUZZ_MAX_REQUESTS requests:
+//   Flags     bit 0: SET_FEATURE, else GET_FEATURE
+//             bit 1: no report ID (UMDF) or no HID_XFER_PACKET (KMDF)
+//             bit 2: KMDF IOCTL buffer length one short of HID_XFER_PACKET
+//             bit 3: report ID used as is, else modulo 16
+//             bit 4: Length is relative to the size the report needs
+//   ReportId
+//   Length    Two bytes, little endian: report buffer length modulo 512, or
+//             with bit 4 the needed size - 4 + the first byte modulo 8
+//   Payload   SET_FEATURE only, Length bytes, zero filled past the input
+//
+// Built once per driver: AMTPTP_FUZZ_USBKM selects AmtPtpDeviceUsbKm,
+// AMTPTP_FUZZ_SPIKM AmtPtpDeviceSpiKm, the default is AmtPtpDeviceUsbUm.
+// Link with libFuzzer, or with AmtPtpFuzzMain.c to run it standalone.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <driver.h>
+
+#include "AmtPtpHost.h"
+#include "AmtPtpSim.h"
+#include "AmtPtpSpiSim.h"
+
+#if !defined(AMTPTP_FUZZ_USBKM) && !defined(AMTPTP_FUZZ_SPIKM)
+#define AMTPTP_FUZZ_UMDF
+#endif
+
+#ifdef AMTPTP_FUZZ_UMDF
+#define AMTPTP_FUZZ_GET_FEATURE		IOCTL_UMDF_HID_GET_FEATURE
+#define AMTPTP_FUZZ_SET_FEATURE		IOCTL_UMDF_HID_SET_FEATURE
+#else
+#define AMTPTP_FUZZ_GET_FEATURE		IOCTL_HID_GET_FEATURE
+#define AMTPTP_FUZZ_SET_FEATURE		IOCTL_HID_SET_FEATURE
+#endif
+
+#define AMTPTP_FUZZ_MAX_REQUESTS	64
+#define AMTPTP_FUZZ_HEADER_SIZE		4
+
+#define AMTPTP_FUZZ_FLAG_SET		0x01
+#define AMTPTP_FUZZ_FLAG_NO_PACKET	0x02
+#define AMTPTP_FUZZ_FLAG_SHORT		0x04
+#define AMTPTP_FUZZ_FLAG_RAW_ID		0x08
+#define AMTPTP_FUZZ_FLAG_NEAR_SIZE	0x10
+
+// A broken guarantee must crash, which is how libFuzzer notices it
+#define AMTPTP_FUZZ_REQUIRE(Condition) \
+	do { \
+		if (!(Condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #Condition); \
+			abort(); \
+		} \
+	} while (0)
+
+// Feature reports the driver handles, with the length each one needs
+typedef struct _AMTPTP_FUZZ_REPORT {
+	BOOLEAN IsSet;
+	UCHAR ReportId;
+	size_t Size;
+} AMTPTP_FUZZ_REPORT;
+
+static const AMTPTP_FUZZ_REPORT AmtPtpFuzzReports[] = {
+	{ FALSE, REPORTID_DEVICE_CAPS, sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ FALSE, REPORTID_PTPHQA, sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ TRUE, REPORTID_REPORTMODE, sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ TRUE, REPORTID_FUNCSWITCH, sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+#ifdef AMTPTP_FUZZ_UMDF
+	{ FALSE, REPORTID_UMAPP_CONF, sizeof(PTP_USERMODEAPP_CONF_REPORT) },
+	{ TRUE, REPORTID_UMAPP_CONF, sizeof(PTP_USERMODEAPP_CONF_REPORT) },
+#endif
+};
+
+typedef struct _AMTPTP_FUZZ_DEVICE {
+#ifdef AMTPTP_FUZZ_SPIKM
+	AMTPTP_SPI_SIM_DEVICE Sim;
+	AMTPTP_SPI_TARGET Target;
+#else
+	AMTPTP_SIM_DEVICE Sim;
+	AMTPTP_USB_TRANSPORT Transport;
+#endif
+	AMTPTP_HOST_BINDING Binding;
+	WDFDEVICE Device;
+} AMTPTP_FUZZ_DEVICE, *PAMTPTP_FUZZ_DEVICE;
+
+static WDFDRIVER AmtPtpFuzzDriver;
+
+static void
+AmtPtpFuzzStartDevice(
+	PAMTPTP_FUZZ_DEVICE Fuzz
+)
+{
+	PDEVICE_CONTEXT context;
+#ifdef AMTPTP_FUZZ_SPIKM
+	const AMTPTP_DECODER noDecoder = { 0 };
+
+	// The sim learns the geometry once the driver has looked up the product
+	AmtPtpSpiSimInit(&Fuzz->Sim, 0x05ac, 0x0272, &noDecoder);
+	AmtPtpSpiSimGetTarget(&Fuzz->Sim, &Fuzz->Target);
+	AmtPtpHostInitSpiBinding(&Fuzz->Binding, &Fuzz->Target);
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostAddDevice(AmtPtpFuzzDriver, &Fuzz->Binding, &Fuzz->Device) == STATUS_SUCCESS);
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostPrepareHardware(Fuzz->Device) == STATUS_SUCCESS);
+
+	context = DeviceGetContext(Fuzz->Device);
+	Fuzz->Sim.Decoder = context->Decoder;
+#else
+	const struct BCM5974_CONFIG *config;
+	AMTPTP_MODE_SWITCH modeSwitch;
+
+	AmtPtpSimGetTransport(&Fuzz->Sim, &Fuzz->Transport);
+#ifdef AMTPTP_FUZZ_USBKM
+	AmtPtpHostInitUsbBinding(&Fuzz->Binding, &Fuzz->Transport, USB_VENDOR_ID_APPLE, USB_DEVICE_ID_APPLE_T2_7A);
+#else
+	AmtPtpHostInitUsbBinding(&Fuzz->Binding, &Fuzz->Transport, USB_VENDOR_ID_APPLE, USB_DEVICE_ID_APPLE_WELLSPRING9_ANSI);
+#endif
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostAddDevice(AmtPtpFuzzDriver, &Fuzz->Binding, &Fuzz->Device) == STATUS_SUCCESS);
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostPrepareHardware(Fuzz->Device) == STATUS_SUCCESS);
+
+	context = DeviceGetContext(Fuzz->Device);
+	config = context->DeviceInfo;
+	modeSwitch.Size = (uint32_t) config->um_size;
+	modeSwitch.RequestValue = (uint16_t) config->um_req_val;
+	modeSwitch.RequestIndex = (uint16_t) config->um_req_idx;
+	modeSwitch.SwitchIndex = (uint32_t) config->um_switch_idx;
+	modeSwitch.SwitchOn = (uint8_t) config->um_switch_on;
+	modeSwitch.SwitchOff = (uint8_t) config->um_switch_off;
+	AmtPtpSimInit(&Fuzz->Sim, &modeSwitch, &context->Decoder);
+#endif
+
+	// Feature requests go through the power-managed default queue
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostD0Entry(Fuzz->Device, WdfPowerDeviceD3) == STATUS_SUCCESS);
+}
+
+// Returns the length the driver needs for a report, 0 if it does not handle it
+static size_t
+AmtPtpFuzzReportSize(
+	BOOLEAN IsSet,
+	UCHAR ReportId
+)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(AmtPtpFuzzReports) / sizeof(AmtPtpFuzzReports[0]); i++) {
+		if (AmtPtpFuzzReports[i].IsSet == IsSet && AmtPtpFuzzReports[i].ReportId == ReportId) {
+			return AmtPtpFuzzReports[i].Size;
+		}
+	}
+
+	return 0;
+}
+
+static NTSTATUS
+AmtPtpFuzzExpectedStatus(
+	UCHAR Flags,
+	UCHAR ReportId,
+	const uint8_t *Report,
+	size_t Length
+)
+{
+	BOOLEAN isSet = (Flags & AMTPTP_FUZZ_FLAG_SET) != 0;
+	size_t size;
+
+#ifdef AMTPTP_FUZZ_UMDF
+	// Both IOCTLs need a report ID and a report buffer. SET_FEATURE carries
+	// the ID as the output buffer length, so ID 0 cannot be expressed.
+	if ((Flags & AMTPTP_FUZZ_FLAG_NO_PACKET) || (isSet && ReportId == 0) || Length == 0) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+#else
+	if (Flags & AMTPTP_FUZZ_FLAG_SHORT) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	if (Flags & AMTPTP_FUZZ_FLAG_NO_PACKET) {
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+#endif
+
+	size = AmtPtpFuzzReportSize(isSet, ReportId);
+	if (size == 0) {
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	if (Length < size) {
+		return STATUS_INVALID_BUFFER_SIZE;
+	}
+
+#ifdef AMTPTP_FUZZ_USBKM
+	// AmtPtpDeviceUsbKm refuses to leave PTP mode
+	if (isSet && ReportId == REPORTID_REPORTMODE &&
+		((const PTP_DEVICE_INPUT_MODE_REPORT *) Report)->Mode == PTP_COLLECTION_MOUSE) {
+		return STATUS_NOT_SUPPORTED;
+	}
+#else
+	(void) Report;
+#endif
+
+	return STATUS_SUCCESS;
+}
+
+// Sends one request and returns the number of input bytes it consumed
+static size_t
+AmtPtpFuzzRequest(
+	PAMTPTP_FUZZ_DEVICE Fuzz,
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	UCHAR flags = Data[0];
+	UCHAR reportId = (flags & AMTPTP_FUZZ_FLAG_RAW_ID) ? Data[1] : (UCHAR) (Data[1] % 16);
+	BOOLEAN isSet = (flags & AMTPTP_FUZZ_FLAG_SET) != 0;
+	size_t length = (size_t) ((Data[2] | (Data[3] << 8)) % 512);
+	size_t payload = 0;
+	uint8_t *report = NULL;
+	NTSTATUS expected, status = STATUS_UNSUCCESSFUL;
+	ULONG_PTR information = 0;
+	WDFREQUEST request = NULL;
+#ifdef AMTPTP_FUZZ_UMDF
+	UCHAR *reportIdBuffer = NULL;
+#else
+	PHID_XFER_PACKET packet = NULL;
+	size_t packetLength = sizeof(HID_XFER_PACKET);
+#endif
+
+	// Most bugs sit right at the size the report needs
+	if (flags & AMTPTP_FUZZ_FLAG_NEAR_SIZE) {
+		length = AmtPtpFuzzReportSize(isSet, reportId) + Data[2] % 8;
+		length = length < 4 ? 0 : length - 4;
+	}
+
+	if (length != 0) {
+		report = malloc(length);
+		AMTPTP_FUZZ_REQUIRE(report != NULL);
+		memset(report, isSet ? 0 : 0xA5, length);
+	}
+	if (isSet) {
+		payload = Size - AMTPTP_FUZZ_HEADER_SIZE < length ? Size - AMTPTP_FUZZ_HEADER_SIZE : length;
+		if (payload != 0) {
+			memcpy(report, Data + AMTPTP_FUZZ_HEADER_SIZE, payload);
+		}
+	}
+
+#ifdef AMTPTP_FUZZ_UMDF
+	if (isSet) {
+		// Report buffer in, report ID as the output buffer length
+		status = AmtPtpHostCreateRequest(Fuzz->Device, AMTPTP_FUZZ_SET_FEATURE, report, length,
+			NULL, (flags & AMTPTP_FUZZ_FLAG_NO_PACKET) ? 0 : reportId, NULL, &request);
+	}
+	else {
+		// Report ID in, report buffer out
+		if (!(flags & AMTPTP_FUZZ_FLAG_NO_PACKET)) {
+			reportIdBuffer = malloc(1);
+			AMTPTP_FUZZ_REQUIRE(reportIdBuffer != NULL);
+			*reportIdBuffer = reportId;
+		}
+		status = AmtPtpHostCreateRequest(Fuzz->Device, AMTPTP_FUZZ_GET_FEATURE, reportIdBuffer,
+			reportIdBuffer != NULL ? 1 : 0, report, length, NULL, &request);
+	}
+#else
+	// HIDCLASS hands KMDF minidrivers the packet in Irp->UserBuffer
+	if (!(flags & AMTPTP_FUZZ_FLAG_NO_PACKET)) {
+		packet = malloc(sizeof(HID_XFER_PACKET));
+		AMTPTP_FUZZ_REQUIRE(packet != NULL);
+		packet->reportBuffer = report;
+		packet->reportBufferLen = (ULONG) length;
+		packet->reportId = reportId;
+	}
+	if (flags & AMTPTP_FUZZ_FLAG_SHORT) {
+		packetLength--;
+	}
+	if (isSet) {
+		status = AmtPtpHostCreateRequest(Fuzz->Device, AMTPTP_FUZZ_SET_FEATURE, NULL, packetLength,
+			NULL, 0, packet, &request);
+	}
+	else {
+		status = AmtPtpHostCreateRequest(Fuzz->Device, AMTPTP_FUZZ_GET_FEATURE, NULL, 0,
+			NULL, packetLength, packet, &request);
+	}
+#endif
+	AMTPTP_FUZZ_REQUIRE(status == STATUS_SUCCESS);
+	expected = AmtPtpFuzzExpectedStatus(flags, reportId, report, length);
+
+	// Feature requests never pend
+	AmtPtpHostSendRequest(request);
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostIsRequestCompleted(request, &status, &information));
+
+	if (status != expected) {
+		fprintf(stderr, "%s_FEATURE report %u, %zu bytes, flags 0x%02x: status 0x%08x, expected 0x%08x\n",
+			isSet ? "SET" : "GET", reportId, length, flags, (unsigned) status, (unsigned) expected);
+		abort();
+	}
+
+	if (status == STATUS_SUCCESS && !isSet) {
+		AMTPTP_FUZZ_REQUIRE(report[0] == reportId);
+#ifdef AMTPTP_FUZZ_UMDF
+		AMTPTP_FUZZ_REQUIRE(information == AmtPtpFuzzReportSize(FALSE, reportId));
+#endif
+	}
+
+	AmtPtpHostReleaseRequest(request);
+	free(report);
+#ifdef AMTPTP_FUZZ_UMDF
+	free(reportIdBuffer);
+#else
+	free(packet);
+#endif
+
+	return AMTPTP_FUZZ_HEADER_SIZE + payload;
+}
+
+int
+LLVMFuzzerTestOneInput(
+	const uint8_t *Data,
+	size_t Size
+)
+{
+	AMTPTP_FUZZ_DEVICE fuzz;
+	size_t offset = 0;
+	int requests = 0;
+
+	if (AmtPtpFuzzDriver == NULL) {
+		AMTPTP_FUZZ_REQUIRE(AmtPtpHostLoadDriver(DriverEntry, &AmtPtpFuzzDriver) == STATUS_SUCCESS);
+	}
+
+	memset(&fuzz, 0, sizeof(fuzz));
+	AmtPtpFuzzStartDevice(&fuzz);
+
+	while (Size - offset >= AMTPTP_FUZZ_HEADER_SIZE && requests < AMTPTP_FUZZ_MAX_REQUESTS) {
+		offset += AmtPtpFuzzRequest(&fuzz, Data + offset, Size - offset);
+		requests++;
+	}
+
+	AMTPTP_FUZZ_REQUIRE(AmtPtpHostD0Exit(fuzz.Device, WdfPowerDeviceD3) == STATUS_SUCCESS);
+	AmtPtpHostRemoveDevice(fuzz.Device);
+	return 0;
+}
@@ -0,0 +1,387 @@
+// AmtPtpHostGoldenTest.c: Golden report streams of every driver build
+//
+// Runs the committed capture of each family through the frame path the driver
+// configures for it (host/AmtPtpFamilies.h) and compares the reports byte for
+// byte with the committed stream of the build:
+//   AmtPtpHost<Driver>GoldenTest CaptureDir ReportDir [-update]
+// CaptureDir holds <product>.capture, ReportDir <product>.reports, with
+// product the four hex digits of the family name. -update writes missing
+// captures from synthetic gestures and rewrites every stream; run it only
+// for an intended change of the reports and commit the result. The frames
+// AmtPtpReplayCapture hands out along the way must unpack from their
+// reports. Built once per driver build; the compact UsbUm build shares the
+// UsbUm captures.
+
+#include <stdlib.h>
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpGolden.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpReplay.h"
+#include "AmtPtpSynth.h"
+#include "AmtPtpTest.h"
+
+#define AMTPTP_TEST_APPLE_VENDOR	0x05AC
+#define AMTPTP_TEST_FREQUENCY		1000000
+#define AMTPTP_TEST_REPORT_RATE		125
+#define AMTPTP_TEST_GESTURE_FRAMES	12
+#define AMTPTP_TEST_FRAME_MAX		1024
+#define AMTPTP_TEST_FILE_MAX		65536
+
+// Gestures recorded into every capture, each followed by a truncated frame
+static const struct {
+	AMTPTP_GESTURE Gesture;
+	uint32_t Fingers;
+	uint8_t Button;					// Button held for the middle third
+	uint8_t SizeSweep;				// Contacts grow from nothing, across every threshold
+} AmtPtpTestGestures[] = {
+	{ AmtPtpGestureDrag, 1, 0, 0 },
+	{ AmtPtpGestureDrag, 2, 1, 0 },
+	{ AmtPtpGesturePinch, 3, 0, 0 },
+	{ AmtPtpGestureRotate, 4, 0, 0 },
+	{ AmtPtpGestureRestAndTap, 3, 0, 0 },
+	{ AmtPtpGesturePalmDrift, 6, 1, 0 },
+	{ AmtPtpGestureDrag, 3, 0, 1 }
+};
+
+static uint8_t AmtPtpTestCapture[AMTPTP_TEST_FILE_MAX];
+static uint8_t AmtPtpTestExpected[AMTPTP_TEST_FILE_MAX];
+static uint8_t AmtPtpTestActual[AMTPTP_TEST_FILE_MAX];
+
+// Returns 0 if Path does not exist
+static int
+AmtPtpTestReadFile(
+	const char *Path,
+	uint8_t *Data,
+	size_t Size,
+	size_t *Length
+)
+{
+	FILE *file = fopen(Path, "rb");
+
+	if (file == NULL) {
+		return 0;
+	}
+	*Length = fread(Data, 1, Size, file);
+	AMTPTP_CHECK(*Length < Size);
+	fclose(file);
+	return 1;
+}
+
+static void
+AmtPtpTestWriteFile(
+	const char *Path,
+	const uint8_t *Data,
+	size_t Length
+)
+{
+	FILE *file = fopen(Path, "wb");
+
+	AMTPTP_CHECK(file != NULL);
+	if (file != NULL) {
+		AMTPTP_CHECK_EQ(fwrite(Data, 1, Length, file), Length);
+		AMTPTP_CHECK_EQ(fclose(file), 0);
+	}
+	printf("  wrote %s\n", Path);
+}
+
+// Records the gesture set on Family's frame layout into AmtPtpTestCapture
+static size_t
+AmtPtpTestMakeCapture(
+	const AMTPTP_BENCH_FAMILY *Family,
+	uint16_t ProductId
+)
+{
+	AMTPTP_CAPTURE_DEVICE device;
+	AMTPTP_GESTURE_SCRIPT script;
+	AMTPTP_SYNTH_FRAME synth;
+	AMTPTP_FRAME frame;
+	uint8_t raw[AMTPTP_TEST_FRAME_MAX];
+	size_t offset, written, length;
+	uint32_t tick = 0, g, i, k;
+
+	memset(&device, 0, sizeof(device));
+	device.IdVendor = AMTPTP_TEST_APPLE_VENDOR;
+	device.IdProduct = ProductId;
+	device.TrackpadType = AMTPTP_CAPTURE_NO_TRACKPAD_TYPE;	// Synthetic frames name no tp_type
+	device.TimestampFrequency = AMTPTP_TEST_FREQUENCY;
+	device.Decoder = Family->Decoder;
+	AMTPTP_CHECK_EQ(AmtPtpCaptureEncodeHeader(&device, AmtPtpTestCapture, sizeof(AmtPtpTestCapture), &offset),
+		AmtPtpCaptureOk);
+
+	script.Width = Family->XMax - Family->Decoder.XMin;
+	script.Height = Family->Decoder.YMax - Family->Decoder.YMin;
+	script.Frames = AMTPTP_TEST_GESTURE_FRAMES;
+
+	for (g = 0; g < sizeof(AmtPtpTestGestures) / sizeof(AmtPtpTestGestures[0]); g++) {
+		script.Gesture = AmtPtpTestGestures[g].Gesture;
+		script.Fingers = AmtPtpTestGestures[g].Fingers;
+
+		for (i = 0; i <= script.Frames; i++) {
+			if (i < script.Frames) {
+				AmtPtpSynthGestureFrame(&script, i, &synth);
+				synth.Button = AmtPtpTestGestures[g].Button && i >= script.Frames / 3 && i < 2 * script.Frames / 3;
+				if (AmtPtpTestGestures[g].SizeSweep) {
+					// The minor axis leads the major one, so some frames qualify by one alone
+					for (k = 0; k < synth.FingerCount; k++) {
+						synth.Fingers[k].TouchMajor = (int32_t) (24 * i + 8 * k);
+						synth.Fingers[k].TouchMinor = (int32_t) (30 * i + 6 * k);
+						synth.Fingers[k].Pressure = (int32_t) (i / 3);
+					}
+				}
+				length = AmtPtpSynthEncodeFrame(&Family->Decoder, &synth, raw, sizeof(raw));
+				AMTPTP_CHECK(length != 0);
+			}
+			else {
+				// The drivers complete no report for it
+				length = 1;
+				AMTPTP_CHECK(Family->DecodeFrame(&Family->Decoder, raw, length,
+					AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &frame) != AmtPtpDecodeOk);
+			}
+
+			AMTPTP_CHECK_EQ(AmtPtpCaptureEncodeRecord(AmtPtpSynthTimestamp(tick++, AMTPTP_TEST_REPORT_RATE,
+				AMTPTP_TEST_FREQUENCY), raw, (uint32_t) length, AmtPtpTestCapture + offset,
+				sizeof(AmtPtpTestCapture) - offset, &written), AmtPtpCaptureOk);
+			offset += written;
+		}
+
+		// Lift off between gestures, long enough to saturate ScanTime
+		tick += AMTPTP_TEST_REPORT_RATE;
+	}
+
+	return offset;
+}
+
+// The comparison itself must catch a changed byte and a missing report
+static void
+AmtPtpTestComparator(
+	const AMTPTP_BENCH_FAMILY *Family,
+	size_t CaptureLength,
+	size_t StreamLength
+)
+{
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_GOLDEN_MISMATCH mismatch;
+	uint32_t offset = Family->ReportSize + Family->ReportSize / 2;
+	char field[48];
+
+	memcpy(AmtPtpTestExpected, AmtPtpTestActual, StreamLength);
+	AmtPtpTestExpected[offset] ^= 0x10;
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestCapture, CaptureLength), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(AmtPtpGoldenCompare(&reader, Family, AmtPtpTestExpected, StreamLength, &mismatch),
+		AmtPtpGoldenMismatch);
+	AMTPTP_CHECK_EQ(mismatch.Report, 1);
+	AMTPTP_CHECK_EQ(mismatch.Offset, offset - Family->ReportSize);
+	AMTPTP_CHECK_EQ(mismatch.ReportSize, Family->ReportSize);
+	AMTPTP_CHECK_EQ(mismatch.Expected[mismatch.Offset] ^ mismatch.Actual[mismatch.Offset], 0x10);
+	AmtPtpGoldenFieldName(mismatch.Offset, mismatch.ReportSize, field, sizeof(field));
+	AMTPTP_CHECK(strcmp(field, "(none)") != 0);
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestCapture, CaptureLength), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(AmtPtpGoldenCompare(&reader, Family, AmtPtpTestActual, StreamLength - Family->ReportSize,
+		&mismatch), AmtPtpGoldenLengthMismatch);
+}
+
+typedef struct _AMTPTP_TEST_REPLAY {
+	uint64_t Frames;
+	uint64_t LastElapsed;
+	size_t Offset;					// In AmtPtpTestActual
+	uint64_t StopAfter;				// Reports, 0 to replay everything
+} AMTPTP_TEST_REPLAY;
+
+// Every frame handed out is the one its report was packed from
+static int
+AmtPtpTestReplaySink(
+	void *Context,
+	const AMTPTP_REPLAY_FRAME *Replay
+)
+{
+	AMTPTP_TEST_REPLAY *replay = Context;
+	AMTPTP_FRAME unpacked, expected;
+	uint16_t scanTime;
+	uint32_t i;
+
+	AMTPTP_CHECK_EQ(Replay->Index, replay->Frames);
+	AMTPTP_CHECK(Replay->Elapsed >= replay->LastElapsed);
+	replay->Frames++;
+	replay->LastElapsed = Replay->Elapsed;
+	if (Replay->Status != AmtPtpDecodeOk) {
+		AMTPTP_CHECK_EQ(Replay->ReportSize, 0);
+		return 0;
+	}
+
+	AMTPTP_CHECK_MEM(Replay->Report, AmtPtpTestActual + replay->Offset, Replay->ReportSize);
+	replay->Offset += Replay->ReportSize;
+
+	expected = Replay->Frame;
+	for (i = 0; i < AMTPTP_MAX_CONTACTS; i++) {
+		if (i >= expected.ContactCount) {
+			memset(&expected.Contacts[i], 0, sizeof(expected.Contacts[i]));
+		}
+		else if (Replay->ReportSize == AMTPTP_COMPACT_REPORT_SIZE) {
+			expected.Contacts[i].ContactID &= AMTPTP_COMPACT_CONTACT_ID_MAX;
+		}
+	}
+	AMTPTP_CHECK_EQ(AmtPtpUnpackReport(Replay->Report, Replay->ReportSize, &unpacked, &scanTime), AmtPtpDecodeOk);
+	AMTPTP_CHECK_FRAME(&unpacked, &expected);
+	AMTPTP_CHECK_EQ(scanTime, Replay->ScanTime);
+
+	return replay->StopAfter != 0 && replay->Offset == replay->StopAfter * Replay->ReportSize;
+}
+
+// AmtPtpGoldenRecord wrote AmtPtpTestActual; the replay frames must match it
+static void
+AmtPtpTestReplay(
+	const AMTPTP_BENCH_FAMILY *Family,
+	size_t CaptureLength,
+	size_t StreamLength
+)
+{
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_REPLAY_STATS stats;
+	AMTPTP_TEST_REPLAY replay;
+
+	memset(&replay, 0, sizeof(replay));
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestCapture, CaptureLength), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(AmtPtpReplayCapture(&reader, Family, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON,
+		AmtPtpTestReplaySink, &replay, &stats), AmtPtpCaptureEnd);
+	AMTPTP_CHECK_EQ(replay.Offset, StreamLength);
+	AMTPTP_CHECK_EQ(stats.Frames, replay.Frames);
+	AMTPTP_CHECK_EQ(stats.Reports, StreamLength / Family->ReportSize);
+	AMTPTP_CHECK_EQ(stats.Reports + stats.Malformed, stats.Frames);
+	AMTPTP_CHECK_EQ(stats.Duration, replay.LastElapsed);
+
+	// A sink stops the replay in the middle
+	memset(&replay, 0, sizeof(replay));
+	replay.StopAfter = 2;
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestCapture, CaptureLength), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(AmtPtpReplayCapture(&reader, Family, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON,
+		AmtPtpTestReplaySink, &replay, &stats), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(stats.Reports, 2);
+	AMTPTP_CHECK_EQ(stats.Frames, replay.Frames);
+}
+
+static void
+AmtPtpTestReportMismatch(
+	const char *Path,
+	const AMTPTP_GOLDEN_MISMATCH *Mismatch
+)
+{
+	char field[48];
+	uint32_t i;
+
+	AmtPtpGoldenFieldName(Mismatch->Offset, Mismatch->ReportSize, field, sizeof(field));
+	fprintf(stderr, "%s: report %llu (capture record %llu) differs at byte %u, %s\n", Path,
+		(unsigned long long) Mismatch->Report, (unsigned long long) Mismatch->Record,
+		(unsigned) Mismatch->Offset, field);
+	fprintf(stderr, "  expected");
+	for (i = 0; i < Mismatch->ReportSize; i++) {
+		fprintf(stderr, " %02x", Mismatch->Expected[i]);
+	}
+	fprintf(stderr, "\n  actual  ");
+	for (i = 0; i < Mismatch->ReportSize; i++) {
+		fprintf(stderr, " %02x", Mismatch->Actual[i]);
+	}
+	fprintf(stderr, "\n");
+}
+
+static unsigned long
+AmtPtpTestFamily(
+	const AMTPTP_BENCH_FAMILY *Family,
+	const char *CaptureDir,
+	const char *ReportDir,
+	int Update
+)
+{
+	AMTPTP_CAPTURE_READER reader;
+	AMTPTP_GOLDEN_MISMATCH mismatch;
+	AMTPTP_GOLDEN_STATUS status;
+	char capturePath[1024], reportPath[1024];
+	const char *product = strchr(Family->Name, '/') + 1;
+	size_t captureLength = 0, expectedLength = 0, actualLength = 0;
+
+	snprintf(capturePath, sizeof(capturePath), "%s/%s.capture", CaptureDir, product);
+	snprintf(reportPath, sizeof(reportPath), "%s/%s.reports", ReportDir, product);
+
+	if (!AmtPtpTestReadFile(capturePath, AmtPtpTestCapture, sizeof(AmtPtpTestCapture), &captureLength)) {
+		if (!Update) {
+			fprintf(stderr, "%s: missing, run with -update to record it\n", capturePath);
+			AMTPTP_CHECK(0);
+			return 0;
+		}
+		captureLength = AmtPtpTestMakeCapture(Family, (uint16_t) strtoul(product, NULL, 16));
+		AmtPtpTestWriteFile(capturePath, AmtPtpTestCapture, captureLength);
+	}
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestCapture, captureLength), AmtPtpCaptureOk);
+	AMTPTP_CHECK_EQ(reader.Device.IdProduct, strtoul(product, NULL, 16));
+	AMTPTP_CHECK_EQ(AmtPtpGoldenRecord(&reader, Family, AmtPtpTestActual, sizeof(AmtPtpTestActual), &actualLength),
+		AmtPtpGoldenMatch);
+	AMTPTP_CHECK(actualLength >= 2 * Family->ReportSize);
+
+	AmtPtpTestComparator(Family, captureLength, actualLength);
+	AmtPtpTestReplay(Family, captureLength, actualLength);
+
+	if (Update) {
+		if (!AmtPtpTestReadFile(reportPath, AmtPtpTestExpected, sizeof(AmtPtpTestExpected), &expectedLength) ||
+			expectedLength != actualLength || memcmp(AmtPtpTestExpected, AmtPtpTestActual, actualLength) != 0) {
+			AmtPtpTestWriteFile(reportPath, AmtPtpTestActual, actualLength);
+		}
+		return (unsigned long) (actualLength / Family->ReportSize);
+	}
+
+	if (!AmtPtpTestReadFile(reportPath, AmtPtpTestExpected, sizeof(AmtPtpTestExpected), &expectedLength)) {
+		fprintf(stderr, "%s: missing, run with -update to record it\n", reportPath);
+		AMTPTP_CHECK(0);
+		return 0;
+	}
+
+	AMTPTP_CHECK_EQ(AmtPtpCaptureOpen(&reader, AmtPtpTestCapture, captureLength), AmtPtpCaptureOk);
+	status = AmtPtpGoldenCompare(&reader, Family, AmtPtpTestExpected, expectedLength, &mismatch);
+	if (status == AmtPtpGoldenMismatch) {
+		AmtPtpTestReportMismatch(reportPath, &mismatch);
+	}
+	else if (status == AmtPtpGoldenLengthMismatch) {
+		fprintf(stderr, "%s: %zu reports expected, %zu produced\n", reportPath,
+			expectedLength / Family->ReportSize, actualLength / Family->ReportSize);
+	}
+	AMTPTP_CHECK_EQ(status, AmtPtpGoldenMatch);
+
+	return (unsigned long) (expectedLength / Family->ReportSize);
+}
+
+int
+main(
+	int argc,
+	char **argv
+)
+{
+	static AMTPTP_BENCH_FAMILY families[AMTPTP_HOST_MAX_FAMILIES];
+	WDFDRIVER driver = NULL;
+	unsigned long reports = 0;
+	size_t count, f;
+	int update;
+
+	update = argc == 4 && strcmp(argv[3], "-update") == 0;
+	if (argc != 3 && !update) {
+		fprintf(stderr, "usage: %s CaptureDir ReportDir [-update]\n", argv[0]);
+		return 2;
+	}
+
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+	count = AmtPtpHostGetFamilies(driver, families, AMTPTP_HOST_MAX_FAMILIES);
+	AMTPTP_CHECK(count > 0);
+
+	for (f = 0; f < count; f++) {
+		reports += AmtPtpTestFamily(&families[f], argv[1], argv[2], update);
+	}
+
+	printf("%s: %zu families, %lu reports %s\n", AmtPtpHostFamilyDriver, count, reports,
+		update ? "recorded" : "match");
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
@@ -0,0 +1,93 @@
+// AmtPtpHostLoadTest.c: Load test of AmtPtpDeviceUsbUm on the host WDF shim
+//
+// Plays 125 Hz, 500 Hz and 1 kHz against every supported Wellspring family
+// with one, two and four pending reads and prints one JSON line per run.
+// Checks that every frame is accounted for and that the latencies follow
+// the configured service and consumer times.
+
+#include <Driver.h>
+
+#include "AmtPtpLoad.h"
+#include "AmtPtpTest.h"
+
+static void
+AmtPtpTestRun(
+	uint16_t ProductId,
+	const AMTPTP_LOAD_CONFIG *Config,
+	PAMTPTP_LOAD_RESULT Result
+)
+{
+	char Line[512];
+
+	AMTPTP_CHECK_EQ(AmtPtpLoadRun(ProductId, Config, Result), 0);
+	AMTPTP_CHECK_EQ(Result->Frames, Config->Frames);
+	AMTPTP_CHECK_EQ(Result->Completed + Result->Disposed + Result->ReaderDrops + Result->DecodeFailures, Result->Frames);
+	AMTPTP_CHECK_EQ(Result->DecodeFailures, 0);
+
+	AmtPtpLoadFormat(Result, Line, sizeof(Line));
+	printf("%s\n", Line);
+}
+
+int
+main(
+	void
+)
+{
+	static const uint32_t Rates[] = { 125, 500, 1000 };
+	static const uint32_t Reads[] = { 1, 2, 4 };
+	AMTPTP_LOAD_CONFIG Config;
+	AMTPTP_LOAD_RESULT Result;
+	size_t f, r, p;
+
+	for (f = 0; f < sizeof(Bcm5974ConfigTable) / sizeof(Bcm5974ConfigTable[0]); f++) {
+		uint16_t ProductId = (uint16_t) Bcm5974ConfigTable[f].ansi;
+
+		if (Bcm5974ConfigTable[f].tp_type == TYPE1) {
+			AmtPtpLoadInitConfig(&Config, 125);
+			AMTPTP_CHECK(AmtPtpLoadRun(ProductId, &Config, &Result) != 0);
+			continue;
+		}
+
+		for (r = 0; r < sizeof(Rates) / sizeof(Rates[0]); r++) {
+			for (p = 0; p < sizeof(Reads) / sizeof(Reads[0]); p++) {
+				AmtPtpLoadInitConfig(&Config, Rates[r]);
+				Config.PendingReads = Reads[p];
+				AmtPtpTestRun(ProductId, &Config, &Result);
+
+				// The consumer hands every report back within a frame period, so a
+				// read is always waiting and completes after the service time
+				AMTPTP_CHECK(Config.ConsumerTime <= AMTPTP_LOAD_FREQUENCY / Rates[r]);
+				AMTPTP_CHECK_EQ(Result.Completed, Result.Frames);
+				AMTPTP_CHECK_EQ(Result.Min, Config.ServiceTime);
+				AMTPTP_CHECK_EQ(Result.Max, Config.ServiceTime);
+			}
+		}
+
+		// A consumer slower than the frames leaves some of them without a read
+		AmtPtpLoadInitConfig(&Config, 1000);
+		Config.PendingReads = 1;
+		Config.ConsumerTime = 25000;
+		AmtPtpTestRun(ProductId, &Config, &Result);
+		AMTPTP_CHECK(Result.Completed > 0);
+		AMTPTP_CHECK(Result.Disposed > 0);
+
+		// Without reads every frame is disposed
+		AmtPtpLoadInitConfig(&Config, 1000);
+		Config.PendingReads = 0;
+		AmtPtpTestRun(ProductId, &Config, &Result);
+		AMTPTP_CHECK_EQ(Result.Disposed, Result.Frames);
+
+		// A slow completion routine backs up the reader
+		AmtPtpLoadInitConfig(&Config, 1000);
+		Config.ServiceTime = 25000;
+		AmtPtpTestRun(ProductId, &Config, &Result);
+		AMTPTP_CHECK(Result.ReaderDrops > 0);
+		AMTPTP_CHECK(Result.Max > Config.ServiceTime);
+	}
+
+	// Unknown devices are refused before the driver sees them
+	AmtPtpLoadInitConfig(&Config, 125);
+	AMTPTP_CHECK(AmtPtpLoadRun(0xFFFF, &Config, &Result) != 0);
+
+	return AMTPTP_TEST_RESULT();
+}
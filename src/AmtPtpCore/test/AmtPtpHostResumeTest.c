@@ -0,0 +1,111 @@
+// AmtPtpHostResumeTest.c: Resume latency through the drivers' own D0 callbacks
+//
+// Runs AmtPtpResumeRun on every family of the linked driver build and checks
+// that each cycle reaches a report no sooner than the control requests and
+// settle time allow. Faults must show up where the driver handles them: a
+// USB mode switch that stalls in D0 entry leaves the trackpad silent until
+// the next cycle, and an SPI trackpad that comes back disabled is
+// re-enabled from the read completion. Built once per driver;
+// AMTPTP_RESUME_SPIKM selects the SPI checks.
+
+#include <stdio.h>
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpResume.h"
+#include "AmtPtpTest.h"
+
+#define AMTPTP_TEST_CYCLES		50
+
+static void
+AmtPtpTestRun(
+	WDFDRIVER Driver,
+	const AMTPTP_BENCH_FAMILY *Family,
+	const AMTPTP_RESUME_CONFIG *Config,
+	PAMTPTP_RESUME_RESULT Result
+)
+{
+	char line[512];
+	uint64_t buckets = 0;
+	size_t i;
+
+	AMTPTP_CHECK_EQ(AmtPtpResumeRun(Driver, Family, Config, Result), 0);
+	AMTPTP_CHECK_EQ(Result->Cycles, Config->Cycles);
+	AMTPTP_CHECK_EQ(Result->Reported + Result->Dead, Result->Cycles);
+	for (i = 0; i < AMTPTP_RESUME_BUCKETS; i++) {
+		buckets += Result->Histogram[i];
+	}
+	AMTPTP_CHECK_EQ(buckets, Result->Reported);
+
+	AmtPtpResumeFormat(Result, line, sizeof(line));
+	printf("%s\n", line);
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_BENCH_FAMILY families[AMTPTP_HOST_MAX_FAMILIES];
+	static AMTPTP_RESUME_RESULT result;
+	AMTPTP_RESUME_CONFIG config;
+	WDFDRIVER driver = NULL;
+	size_t count, f;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+	count = AmtPtpHostGetFamilies(driver, families, AMTPTP_HOST_MAX_FAMILIES);
+	AMTPTP_CHECK(count > 0);
+
+	for (f = 0; f < count; f++) {
+		// A quiet device reports every cycle
+		AmtPtpResumeInitConfig(&config);
+		config.Cycles = AMTPTP_TEST_CYCLES;
+		config.SettleLatency = 20000;
+		AmtPtpTestRun(driver, &families[f], &config, &result);
+		AMTPTP_CHECK_EQ(result.Reported, config.Cycles);
+		AMTPTP_CHECK_EQ(result.ExitFailures, 0);
+		AMTPTP_CHECK_EQ(result.SwitchFailures, 0);
+		AMTPTP_CHECK_EQ(result.Retries, 0);
+
+#ifdef AMTPTP_RESUME_SPIKM
+		// One state request per D0 entry; the trackpad stays enabled through D3
+		AMTPTP_CHECK_EQ(result.ControlRequests, config.Cycles);
+		AMTPTP_CHECK(result.Min >= config.ControlLatency);
+		AMTPTP_CHECK(result.Min < config.ControlLatency + config.SettleLatency);
+
+		// The state request of D0 entry fails, the first idle packet enables the trackpad
+		config.PowerLoss = 1;
+		AmtPtpTestRun(driver, &families[f], &config, &result);
+		AMTPTP_CHECK_EQ(result.Reported, config.Cycles);
+		AMTPTP_CHECK_EQ(result.SwitchFailures, config.Cycles);
+		AMTPTP_CHECK(result.Retries >= config.Cycles);
+		AMTPTP_CHECK(result.DiscardedFrames >= config.Cycles);
+		AMTPTP_CHECK(result.Min > 2 * config.ControlLatency + config.SettleLatency);
+#else
+		// TYPE3 streams without a mode switch, and so without a settle time;
+		// the others switch off and on each cycle
+		if (families[f].Decoder.HeaderSize == 38) {
+			AMTPTP_CHECK_EQ(result.ControlRequests, 0);
+			AMTPTP_CHECK(result.Min < config.SettleLatency);
+		}
+		else {
+			AMTPTP_CHECK(result.ControlRequests >= 2 * config.Cycles);
+			AMTPTP_CHECK(result.Min >= config.ControlLatency + config.SettleLatency);
+
+			// A stalled switch in D0 entry leaves the trackpad in mouse mode,
+			// one in D0 exit fails the callback
+			config.StallPeriod = 5;
+			AmtPtpTestRun(driver, &families[f], &config, &result);
+			AMTPTP_CHECK(result.ExitFailures > 0);
+			AMTPTP_CHECK(result.SwitchFailures > 0);
+			AMTPTP_CHECK(result.Dead > 0);
+			AMTPTP_CHECK(result.Reported > 0);
+		}
+#endif
+	}
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
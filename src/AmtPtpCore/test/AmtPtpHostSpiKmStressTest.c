@@ -0,0 +1,346 @@
+// AmtPtpHostSpiKmStressTest.c: AmtPtpDeviceSpiKm on the host WDF shim under concurrent load
+//
+// Client threads keep HID reads pending, two bus threads complete SPI reads
+// and a power thread moves the device in and out of D0, all at once. The
+// trackpad below fails about half of the enable requests and drops back to
+// idle packets when it does, so D0 entry often leaves the device unconfigured
+// and read completions race each other to claim the re-enable, roll it back
+// on failure and race the D3 store in EvtDeviceD0Exit. After every D0 exit
+// the device must still be in D3. Linked against the ThreadSanitizer build of
+// the driver when the compiler has one.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <driver.h>
+
+#include "AmtPtpHost.h"
+#include "AmtPtpSpiSim.h"
+#include "AmtPtpTest.h"
+
+#define AMTPTP_STRESS_VENDOR_ID		0x05ac
+#define AMTPTP_STRESS_PRODUCT_ID	0x0276
+#define AMTPTP_STRESS_CLIENTS		2
+#define AMTPTP_STRESS_BUS_THREADS	2
+#define AMTPTP_STRESS_SLOTS			4
+#define AMTPTP_STRESS_SECONDS		2
+
+typedef struct _AMTPTP_STRESS AMTPTP_STRESS, *PAMTPTP_STRESS;
+
+// Counters are only read by the main thread once the thread is joined
+typedef struct _AMTPTP_STRESS_CLIENT {
+	PAMTPTP_STRESS Stress;
+	WDFREQUEST Requests[AMTPTP_STRESS_SLOTS];
+	uint8_t *Reports[AMTPTP_STRESS_SLOTS];
+	uint64_t Reported;
+	uint64_t Dropped;				// Idle packets and reads lost to D0 exit
+	uint64_t Failed;
+} AMTPTP_STRESS_CLIENT, *PAMTPTP_STRESS_CLIENT;
+
+struct _AMTPTP_STRESS {
+	// The trackpad, only touched on the bus, which the shim serializes
+	AMTPTP_SPI_SIM_DEVICE Sim;
+	AMTPTP_SPI_TARGET SimTarget;
+	AMTPTP_TEST_RANDOM Random;
+	uint64_t Claims;				// Enables sent by read completions
+	uint64_t ClaimFailures;
+
+	AMTPTP_SPI_TARGET Target;
+	AMTPTP_HOST_BINDING Binding;
+	WDFDEVICE Device;
+	PDEVICE_CONTEXT Context;
+	int Stop;
+	AMTPTP_STRESS_CLIENT Clients[AMTPTP_STRESS_CLIENTS];
+	uint64_t Completions[AMTPTP_STRESS_BUS_THREADS];
+	uint64_t PowerCycles;
+	uint64_t PowerFailures;
+};
+
+// Set on the threads that drive D0 transitions
+static __thread int AmtPtpStressIsPowerThread;
+
+static AMTPTP_SPI_STATUS
+AmtPtpStressGetAttributes(
+	void *Context,
+	uint16_t *VendorId,
+	uint16_t *ProductId,
+	uint16_t *VersionNumber
+)
+{
+	PAMTPTP_STRESS stress = Context;
+
+	return stress->SimTarget.GetAttributes(stress->SimTarget.Context, VendorId, ProductId, VersionNumber);
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpStressSetFeature(
+	void *Context,
+	uint8_t ReportId,
+	const uint8_t *Buffer,
+	uint32_t Length
+)
+{
+	PAMTPTP_STRESS stress = Context;
+	uint8_t disable[2];
+
+	if (Length < 2 || Buffer[1] == 0) {
+		return stress->SimTarget.SetFeature(stress->SimTarget.Context, ReportId, Buffer, Length);
+	}
+
+	if (!AmtPtpStressIsPowerThread) {
+		stress->Claims++;
+	}
+
+	// The trackpad stays off and keeps sending idle packets
+	if (AmtPtpTestNext(&stress->Random) & 1) {
+		disable[0] = Buffer[0];
+		disable[1] = 0;
+		stress->SimTarget.SetFeature(stress->SimTarget.Context, ReportId, disable, sizeof(disable));
+		if (!AmtPtpStressIsPowerThread) {
+			stress->ClaimFailures++;
+		}
+		return AmtPtpSpiNotConnected;
+	}
+
+	return stress->SimTarget.SetFeature(stress->SimTarget.Context, ReportId, Buffer, Length);
+}
+
+static AMTPTP_SPI_STATUS
+AmtPtpStressReadReport(
+	void *Context,
+	uint8_t *Buffer,
+	uint32_t Length,
+	uint32_t *Transferred
+)
+{
+	PAMTPTP_STRESS stress = Context;
+
+	return stress->SimTarget.ReadReport(stress->SimTarget.Context, Buffer, Length, Transferred);
+}
+
+static int
+AmtPtpStressIsStopping(
+	PAMTPTP_STRESS Stress
+)
+{
+	return __atomic_load_n(&Stress->Stop, __ATOMIC_ACQUIRE);
+}
+
+// Takes a completed read back from the driver
+static void
+AmtPtpStressCollect(
+	PAMTPTP_STRESS_CLIENT Client,
+	int Slot
+)
+{
+	const PTP_REPORT *report = (const PTP_REPORT *) Client->Reports[Slot];
+	NTSTATUS status = STATUS_UNSUCCESSFUL;
+	ULONG_PTR information = 0;
+
+	AmtPtpHostIsRequestCompleted(Client->Requests[Slot], &status, &information);
+	if (status == STATUS_SUCCESS && information == sizeof(PTP_REPORT) &&
+		report->ReportID == REPORTID_MULTITOUCH && report->ContactCount <= 5) {
+		Client->Reported++;
+	}
+	else if (status == STATUS_CANCELLED || status == STATUS_DEVICE_DATA_ERROR || status == STATUS_UNSUCCESSFUL) {
+		Client->Dropped++;
+	}
+	else {
+		Client->Failed++;
+	}
+
+	AmtPtpHostReleaseRequest(Client->Requests[Slot]);
+	Client->Requests[Slot] = NULL;
+}
+
+static void *
+AmtPtpStressClientThread(
+	void *Context
+)
+{
+	PAMTPTP_STRESS_CLIENT client = Context;
+	int i;
+
+	while (!AmtPtpStressIsStopping(client->Stress)) {
+		for (i = 0; i < AMTPTP_STRESS_SLOTS; i++) {
+			if (client->Requests[i] != NULL) {
+				if (!AmtPtpHostIsRequestCompleted(client->Requests[i], NULL, NULL)) {
+					continue;
+				}
+				AmtPtpStressCollect(client, i);
+			}
+
+			if (!NT_SUCCESS(AmtPtpHostCreateRequest(client->Stress->Device, IOCTL_HID_READ_REPORT, NULL, 0,
+				client->Reports[i], sizeof(PTP_REPORT), NULL, &client->Requests[i]))) {
+				client->Requests[i] = NULL;
+				client->Failed++;
+				continue;
+			}
+			AmtPtpHostSendRequest(client->Requests[i]);
+		}
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+typedef struct _AMTPTP_STRESS_BUS {
+	PAMTPTP_STRESS Stress;
+	uint64_t *Completions;
+} AMTPTP_STRESS_BUS, *PAMTPTP_STRESS_BUS;
+
+static void *
+AmtPtpStressBusThread(
+	void *Context
+)
+{
+	PAMTPTP_STRESS_BUS bus = Context;
+
+	while (!AmtPtpStressIsStopping(bus->Stress)) {
+		*bus->Completions += AmtPtpHostSpiCompleteReads(bus->Stress->Device, 1);
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+static void *
+AmtPtpStressPowerThread(
+	void *Context
+)
+{
+	PAMTPTP_STRESS stress = Context;
+
+	AmtPtpStressIsPowerThread = 1;
+
+	while (!AmtPtpStressIsStopping(stress)) {
+		// No completion may bring the device back once D0 exit stored D3
+		if (AmtPtpHostD0Exit(stress->Device, WdfPowerDeviceD3) != STATUS_SUCCESS) {
+			stress->PowerFailures++;
+		}
+		sched_yield();
+		if (__atomic_load_n(&stress->Context->DeviceStatus, __ATOMIC_SEQ_CST) != D3) {
+			stress->PowerFailures++;
+		}
+
+		if (AmtPtpHostD0Entry(stress->Device, WdfPowerDeviceD3) != STATUS_SUCCESS) {
+			stress->PowerFailures++;
+		}
+		stress->PowerCycles++;
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_STRESS stress;
+	static AMTPTP_STRESS_BUS buses[AMTPTP_STRESS_BUS_THREADS];
+	const AMTPTP_DECODER noDecoder = { 0 };
+	WDFDRIVER driver = NULL;
+	pthread_t clients[AMTPTP_STRESS_CLIENTS], busThreads[AMTPTP_STRESS_BUS_THREADS], power;
+	struct timespec second = { 1, 0 };
+	uint64_t reported = 0, dropped = 0, completions = 0;
+	int c, i;
+
+	AmtPtpStressIsPowerThread = 1;
+	AmtPtpHostSetClock(0);
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+
+	// The sim learns the geometry once the driver has looked up the product
+	AmtPtpSpiSimInit(&stress.Sim, AMTPTP_STRESS_VENDOR_ID, AMTPTP_STRESS_PRODUCT_ID, &noDecoder);
+	stress.Sim.Faults.ShortPeriod = 7;
+	AmtPtpSpiSimGetTarget(&stress.Sim, &stress.SimTarget);
+	stress.Random.State = 0x5EED;
+	stress.Target.Context = &stress;
+	stress.Target.GetAttributes = AmtPtpStressGetAttributes;
+	stress.Target.SetFeature = AmtPtpStressSetFeature;
+	stress.Target.ReadReport = AmtPtpStressReadReport;
+
+	AmtPtpHostInitSpiBinding(&stress.Binding, &stress.Target);
+	AMTPTP_CHECK_EQ(AmtPtpHostAddDevice(driver, &stress.Binding, &stress.Device), STATUS_SUCCESS);
+	AMTPTP_CHECK_EQ(AmtPtpHostPrepareHardware(stress.Device), STATUS_SUCCESS);
+
+	stress.Context = DeviceGetContext(stress.Device);
+	stress.Sim.Decoder = stress.Context->Decoder;
+	stress.Sim.Script.Fingers = 3;
+	stress.Sim.Script.Width = stress.Context->TrackpadInfo.XMax - stress.Context->TrackpadInfo.XMin;
+	stress.Sim.Script.Height = stress.Context->TrackpadInfo.YMax - stress.Context->TrackpadInfo.YMin;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostD0Entry(stress.Device, WdfPowerDeviceD3), STATUS_SUCCESS);
+
+	// Every packet also takes the raw frame capture path
+	AmtPtpHostEnableTraceLogging(1);
+
+	for (c = 0; c < AMTPTP_STRESS_CLIENTS; c++) {
+		stress.Clients[c].Stress = &stress;
+		for (i = 0; i < AMTPTP_STRESS_SLOTS; i++) {
+			stress.Clients[c].Reports[i] = malloc(sizeof(PTP_REPORT));
+		}
+		pthread_create(&clients[c], NULL, AmtPtpStressClientThread, &stress.Clients[c]);
+	}
+	for (i = 0; i < AMTPTP_STRESS_BUS_THREADS; i++) {
+		buses[i].Stress = &stress;
+		buses[i].Completions = &stress.Completions[i];
+		pthread_create(&busThreads[i], NULL, AmtPtpStressBusThread, &buses[i]);
+	}
+	pthread_create(&power, NULL, AmtPtpStressPowerThread, &stress);
+
+	for (i = 0; i < AMTPTP_STRESS_SECONDS; i++) {
+		nanosleep(&second, NULL);
+	}
+	__atomic_store_n(&stress.Stop, 1, __ATOMIC_RELEASE);
+
+	pthread_join(power, NULL);
+	for (i = 0; i < AMTPTP_STRESS_BUS_THREADS; i++) {
+		pthread_join(busThreads[i], NULL);
+		completions += stress.Completions[i];
+	}
+	for (c = 0; c < AMTPTP_STRESS_CLIENTS; c++) {
+		pthread_join(clients[c], NULL);
+	}
+	AmtPtpHostEnableTraceLogging(0);
+
+	// Reads still pending are cancelled on removal
+	AMTPTP_CHECK_EQ(AmtPtpHostD0Exit(stress.Device, WdfPowerDeviceD3), STATUS_SUCCESS);
+	AMTPTP_CHECK_EQ(stress.Context->DeviceStatus, D3);
+	AmtPtpHostRemoveDevice(stress.Device);
+
+	for (c = 0; c < AMTPTP_STRESS_CLIENTS; c++) {
+		for (i = 0; i < AMTPTP_STRESS_SLOTS; i++) {
+			if (stress.Clients[c].Requests[i] != NULL) {
+				AMTPTP_CHECK(AmtPtpHostIsRequestCompleted(stress.Clients[c].Requests[i], NULL, NULL));
+				AmtPtpStressCollect(&stress.Clients[c], i);
+			}
+			free(stress.Clients[c].Reports[i]);
+		}
+
+		AMTPTP_CHECK_EQ(stress.Clients[c].Failed, 0);
+		reported += stress.Clients[c].Reported;
+		dropped += stress.Clients[c].Dropped;
+	}
+
+	printf("%llu completions, %llu reports, %llu dropped, %llu re-enables (%llu failed), %llu power cycles\n",
+		(unsigned long long) completions, (unsigned long long) reported, (unsigned long long) dropped,
+		(unsigned long long) stress.Claims, (unsigned long long) stress.ClaimFailures,
+		(unsigned long long) stress.PowerCycles);
+
+	AMTPTP_CHECK(completions > 0);
+	AMTPTP_CHECK(reported > 0);
+	AMTPTP_CHECK(AmtPtpHostTraceLoggingCount() >= reported);
+	AMTPTP_CHECK(stress.PowerCycles > 0);
+	AMTPTP_CHECK_EQ(stress.PowerFailures, 0);
+
+	// Both outcomes of the claim were taken
+	AMTPTP_CHECK(stress.ClaimFailures > 0);
+	AMTPTP_CHECK(stress.Claims > stress.ClaimFailures);
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
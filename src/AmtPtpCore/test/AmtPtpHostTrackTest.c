@@ -0,0 +1,175 @@
+// AmtPtpHostTrackTest.c: Tracking scores of every family of a driver build
+//
+// Scores each family's own frame path (host/AmtPtpFamilies.h) on synthetic
+// gestures. Without noise or a filter the stream must be perfect: every
+// finger matched on its exact position, no identifier switch, no phantom and
+// no late lift-off, whatever report layout the build emits. Filters that
+// swap identifiers, invent a contact or hold a lifted one must each show up in
+// their own metric. Built once per driver build.
+
+#include <driver.h>
+
+#include "AmtPtpFamilies.h"
+#include "AmtPtpHost.h"
+#include "AmtPtpTest.h"
+#include "AmtPtpTrack.h"
+
+#define AMTPTP_TEST_FRAMES			48
+#define AMTPTP_TEST_MATCH_DISTANCE	400
+
+typedef struct _AMTPTP_TEST_FILTER {
+	uint32_t Frame;
+	AMTPTP_FRAME Last;
+} AMTPTP_TEST_FILTER;
+
+// Swaps the identifiers of the first two contacts every eighth frame
+static void
+AmtPtpTestSwapIds(
+	void *Context,
+	PAMTPTP_FRAME Frame
+)
+{
+	AMTPTP_TEST_FILTER *filter = Context;
+	uint8_t id;
+
+	if (Frame->ContactCount >= 2 && (filter->Frame++ / 8) % 2 == 1) {
+		id = Frame->Contacts[0].ContactID;
+		Frame->Contacts[0].ContactID = Frame->Contacts[1].ContactID;
+		Frame->Contacts[1].ContactID = id;
+	}
+}
+
+// Adds a confident finger in a corner no gesture reaches
+static void
+AmtPtpTestPhantom(
+	void *Context,
+	PAMTPTP_FRAME Frame
+)
+{
+	PAMTPTP_CONTACT c;
+
+	(void) Context;
+	if (Frame->ContactCount < AMTPTP_MAX_CONTACTS) {
+		c = &Frame->Contacts[Frame->ContactCount++];
+		memset(c, 0, sizeof(*c));
+		c->ContactID = 7;
+		c->TipSwitch = 1;
+		c->Confidence = 1;
+	}
+}
+
+// Reports the previous frame again whenever the contact count drops
+static void
+AmtPtpTestHoldLiftoff(
+	void *Context,
+	PAMTPTP_FRAME Frame
+)
+{
+	AMTPTP_TEST_FILTER *filter = Context;
+	AMTPTP_FRAME current = *Frame;
+
+	if (filter->Frame++ > 0 && Frame->ContactCount < filter->Last.ContactCount) {
+		*Frame = filter->Last;
+	}
+	filter->Last = current;
+}
+
+static void
+AmtPtpTestFamily(
+	const AMTPTP_BENCH_FAMILY *Family
+)
+{
+	static const AMTPTP_GESTURE gestures[] = {
+		AmtPtpGestureDrag, AmtPtpGesturePinch, AmtPtpGestureRotate, AmtPtpGestureRestAndTap
+	};
+	AMTPTP_GESTURE_SCRIPT script;
+	AMTPTP_TRACK_SCORE score;
+	AMTPTP_TEST_FILTER filter;
+	char line[512];
+	size_t g;
+
+	memset(&script, 0, sizeof(script));
+	script.Frames = AMTPTP_TEST_FRAMES;
+
+	for (g = 0; g < sizeof(gestures) / sizeof(gestures[0]); g++) {
+		script.Gesture = gestures[g];
+		for (script.Fingers = 1; script.Fingers <= AMTPTP_MAX_CONTACTS; script.Fingers++) {
+			AmtPtpTrackInit(&score, AMTPTP_TEST_MATCH_DISTANCE);
+			AMTPTP_CHECK_EQ(AmtPtpTrackRun(Family, &script, 0, NULL, NULL, &score), 0);
+			AMTPTP_CHECK_EQ(score.Frames, AMTPTP_TEST_FRAMES);
+			AMTPTP_CHECK(score.Matched > 0);
+			AMTPTP_CHECK_EQ(score.Missed, 0);
+			AMTPTP_CHECK_EQ(score.Phantoms, 0);
+			AMTPTP_CHECK_EQ(score.Switches, 0);
+			AMTPTP_CHECK_EQ(score.LiftoffFrames, 0);
+			AMTPTP_CHECK(AmtPtpTrackJitter(&score) < 1.0);
+			AMTPTP_CHECK(AmtPtpTrackJerk(&score) < 4.0);
+			if (AmtPtpTestFailures != 0) {
+				AmtPtpTrackFormat(Family, &script, &score, line, sizeof(line));
+				fprintf(stderr, "  %s\n", line);
+				return;
+			}
+		}
+	}
+
+	// Noise shows as jitter of the fingers held still, not as lost contacts
+	script.Gesture = AmtPtpGestureRestAndTap;
+	script.Fingers = 3;
+	AmtPtpTrackInit(&score, AMTPTP_TEST_MATCH_DISTANCE);
+	AMTPTP_CHECK_EQ(AmtPtpTrackRun(Family, &script, 20, NULL, NULL, &score), 0);
+	AMTPTP_CHECK(AmtPtpTrackJitter(&score) > 1.0);
+	AMTPTP_CHECK_EQ(score.Missed, 0);
+
+	script.Gesture = AmtPtpGestureDrag;
+	memset(&filter, 0, sizeof(filter));
+	AmtPtpTrackInit(&score, AMTPTP_TEST_MATCH_DISTANCE);
+	AMTPTP_CHECK_EQ(AmtPtpTrackRun(Family, &script, 0, AmtPtpTestSwapIds, &filter, &score), 0);
+	AMTPTP_CHECK(score.Switches > 0);
+
+	AmtPtpTrackInit(&score, AMTPTP_TEST_MATCH_DISTANCE);
+	AMTPTP_CHECK_EQ(AmtPtpTrackRun(Family, &script, 0, AmtPtpTestPhantom, NULL, &score), 0);
+	AMTPTP_CHECK_EQ(score.Phantoms, AMTPTP_TEST_FRAMES);
+
+	// Fingers of the tap lift every eight frames
+	script.Gesture = AmtPtpGestureRestAndTap;
+	memset(&filter, 0, sizeof(filter));
+	AmtPtpTrackInit(&score, AMTPTP_TEST_MATCH_DISTANCE);
+	AMTPTP_CHECK_EQ(AmtPtpTrackRun(Family, &script, 0, AmtPtpTestHoldLiftoff, &filter, &score), 0);
+	AMTPTP_CHECK(score.Liftoffs > 0);
+	AMTPTP_CHECK_EQ(score.LiftoffMax, 1);
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_BENCH_FAMILY families[AMTPTP_HOST_MAX_FAMILIES];
+	AMTPTP_SYNTH_FRAME truth;
+	AMTPTP_TRACK_SCORE score;
+	uint8_t report[AMTPTP_REPORT_SIZE];
+	WDFDRIVER driver = NULL;
+	size_t count, f;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+	count = AmtPtpHostGetFamilies(driver, families, AMTPTP_HOST_MAX_FAMILIES);
+	AMTPTP_CHECK(count > 0);
+
+	for (f = 0; f < count; f++) {
+		AmtPtpTestFamily(&families[f]);
+	}
+
+	// Reports of another layout or report ID are not scored
+	memset(&truth, 0, sizeof(truth));
+	memset(report, 0, sizeof(report));
+	report[0] = AMTPTP_REPORTID_MULTITOUCH;
+	AmtPtpTrackInit(&score, AMTPTP_TEST_MATCH_DISTANCE);
+	AMTPTP_CHECK(AmtPtpTrackReport(&score, &truth, report, AMTPTP_REPORT_SIZE - 1) != 0);
+	report[0] = 0;
+	AMTPTP_CHECK(AmtPtpTrackReport(&score, &truth, report, AMTPTP_REPORT_SIZE) != 0);
+	AMTPTP_CHECK_EQ(score.Frames, 0);
+
+	printf("%s: %zu families scored\n", AmtPtpHostFamilyDriver, count);
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
@@ -0,0 +1,127 @@
+// AmtPtpHostTuneTest.c: Parallel threshold sweeps against the serial sweep
+//
+// Scores random labelled samples over grids full of ties and checks that
+// AmtPtpTuneParallelSweep returns exactly the ranked list of one serial
+// AmtPtpTuneSweepRanked, and the best score of AmtPtpTuneSweep, for every
+// thread count and list length. Runs under ThreadSanitizer where available.
+
+#include "AmtPtpTest.h"
+#include "AmtPtpTuneParallel.h"
+
+#define AMTPTP_TEST_SAMPLES		800
+
+static void
+AmtPtpTestSamples(
+	PAMTPTP_TUNE_SAMPLE Samples,
+	size_t Count
+)
+{
+	AMTPTP_TEST_RANDOM random = { 7 };
+	size_t i;
+
+	for (i = 0; i < Count; i++) {
+		Samples[i].Size.Major = (int32_t) (AmtPtpTestNext(&random) % 600);
+		Samples[i].Size.Minor = (int32_t) (AmtPtpTestNext(&random) % 500);
+		Samples[i].Size.Pressure = (int32_t) (AmtPtpTestNext(&random) % 8);
+		Samples[i].Weight = 1;
+
+		// Mostly separable by size, with label noise so no candidate is perfect
+		Samples[i].Touch = Samples[i].Size.Major > 150 && Samples[i].Size.Minor < 400;
+		if (AmtPtpTestNext(&random) % 16 == 0) {
+			Samples[i].Touch ^= 1;
+		}
+	}
+}
+
+static void
+AmtPtpTestSameScore(
+	const AMTPTP_TUNE_SCORE *Actual,
+	const AMTPTP_TUNE_SCORE *Expected
+)
+{
+	AMTPTP_CHECK_EQ(Actual->Index, Expected->Index);
+	AMTPTP_CHECK_EQ(Actual->FalseTouches, Expected->FalseTouches);
+	AMTPTP_CHECK_EQ(Actual->MissedTouches, Expected->MissedTouches);
+	AMTPTP_CHECK_EQ(Actual->Touches, Expected->Touches);
+	AMTPTP_CHECK_EQ(Actual->Others, Expected->Others);
+	AMTPTP_CHECK_MEM(&Actual->Thresholds, &Expected->Thresholds, sizeof(Expected->Thresholds));
+}
+
+static void
+AmtPtpTestGrid(
+	const AMTPTP_TUNE_SAMPLE *Samples,
+	size_t Count,
+	const AMTPTP_TUNE_GRID *Grid
+)
+{
+	static const uint32_t threadCounts[] = { 1, 2, 3, 8, AMTPTP_TUNE_MAX_THREADS + 1 };
+	static const size_t capacities[] = { 1, 10, AMTPTP_TUNE_MAX_RANKED };
+	static AMTPTP_TUNE_SCORE serial[AMTPTP_TUNE_MAX_RANKED], parallel[AMTPTP_TUNE_MAX_RANKED];
+	AMTPTP_THRESHOLDS thresholds;
+	AMTPTP_TUNE_SCORE best;
+	uint64_t size = AmtPtpTuneGridSize(Grid);
+	size_t serialCount, parallelCount, t, c, i;
+
+	AMTPTP_CHECK(size > AMTPTP_TUNE_CHUNK);
+
+	AmtPtpTuneGridPoint(Grid, 0, &thresholds);
+	AmtPtpTuneEvaluate(Samples, Count, &thresholds, &best);
+	AmtPtpTuneSweep(Samples, Count, Grid, 1, size, &best);
+
+	for (c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+		serialCount = 0;
+		AmtPtpTuneSweepRanked(Samples, Count, Grid, 0, size, serial, capacities[c], &serialCount);
+		AMTPTP_CHECK_EQ(serialCount, capacities[c]);
+		AmtPtpTestSameScore(&serial[0], &best);
+
+		// The list is ordered, and ties in errors are broken by index
+		for (i = 1; i < serialCount; i++) {
+			AMTPTP_CHECK(AmtPtpTuneBetter(&serial[i - 1], &serial[i]));
+		}
+
+		for (t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+			memset(parallel, 0xCC, sizeof(parallel));
+			parallelCount = AmtPtpTuneParallelSweep(Samples, Count, Grid, threadCounts[t], parallel, capacities[c]);
+			AMTPTP_CHECK_EQ(parallelCount, serialCount);
+			for (i = 0; i < serialCount && i < parallelCount; i++) {
+				AmtPtpTestSameScore(&parallel[i], &serial[i]);
+			}
+		}
+	}
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_TUNE_SAMPLE samples[AMTPTP_TEST_SAMPLES];
+	AMTPTP_TUNE_GRID grid;
+	AMTPTP_TUNE_SCORE ranked[1];
+	size_t count;
+
+	AmtPtpTestSamples(samples, AMTPTP_TEST_SAMPLES);
+	count = AmtPtpTuneCompact(samples, AMTPTP_TEST_SAMPLES);
+
+	// Coarse steps over ranges past every sample leave many candidates tied
+	memset(&grid, 0, sizeof(grid));
+	grid.TipSwitchMajor = (AMTPTP_TUNE_RANGE) { 0, 700, 50 };
+	grid.TipSwitchMinor = (AMTPTP_TUNE_RANGE) { 0, 600, 100 };
+	grid.TipSwitchPressure = (AMTPTP_TUNE_RANGE) { 0, 8, 4 };
+	grid.ConfidenceMinorMax = (AMTPTP_TUNE_RANGE) { 300, 600, 50 };
+	AmtPtpTestGrid(samples, count, &grid);
+
+	// A grid that is not a multiple of the chunk size, with a single threshold
+	memset(&grid, 0, sizeof(grid));
+	grid.TipSwitchMajor = (AMTPTP_TUNE_RANGE) { -10, 700, 1 };
+	AmtPtpTestGrid(samples, count, &grid);
+
+	// Empty grid, empty list
+	grid.TipSwitchMajor = (AMTPTP_TUNE_RANGE) { 1, 0, 1 };
+	AMTPTP_CHECK_EQ(AmtPtpTuneParallelSweep(samples, count, &grid, 4, ranked, 1), 0);
+	grid.TipSwitchMajor = (AMTPTP_TUNE_RANGE) { 0, 10, 1 };
+	AMTPTP_CHECK_EQ(AmtPtpTuneParallelSweep(samples, count, &grid, 4, ranked, 0), 0);
+
+	printf("%zu distinct samples, parallel sweeps match the serial one\n", count);
+	return AMTPTP_TEST_RESULT();
+}
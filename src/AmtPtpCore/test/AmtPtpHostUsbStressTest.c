@@ -0,0 +1,271 @@
+// AmtPtpHostUsbStressTest.c: USB drivers on the host WDF shim under concurrent load
+//
+// Client threads keep HID reads pending, a reader thread completes interrupt
+// transfers and a power thread moves the device in and out of D0, all at
+// once. Reads dispatched while D0 exit runs meet EvtIoStop, and completions
+// race the pipe stop in EvtDeviceD0Exit. The test links the ThreadSanitizer
+// build of the driver when the compiler has one, so an unsynchronized access
+// fails it; otherwise only the shim's framework checks and the report checks
+// here apply. Built once per driver; AMTPTP_STRESS_USBKM selects
+// AmtPtpDeviceUsbKm, the default is AmtPtpDeviceUsbUm.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <driver.h>
+
+#include "AmtPtpHost.h"
+#include "AmtPtpSim.h"
+#include "AmtPtpTest.h"
+
+#ifdef AMTPTP_STRESS_USBKM
+#define AMTPTP_STRESS_PRODUCT_ID	USB_DEVICE_ID_APPLE_T2_7A
+#else
+#define AMTPTP_STRESS_PRODUCT_ID	USB_DEVICE_ID_APPLE_WELLSPRING9_ANSI
+#endif
+
+#define AMTPTP_STRESS_CLIENTS		2
+#define AMTPTP_STRESS_SLOTS			4
+#define AMTPTP_STRESS_SECONDS		2
+#define AMTPTP_STRESS_FRAME_TICKS	80000
+
+typedef struct _AMTPTP_STRESS AMTPTP_STRESS, *PAMTPTP_STRESS;
+
+// Counters are only read by the main thread once the thread is joined
+typedef struct _AMTPTP_STRESS_CLIENT {
+	PAMTPTP_STRESS Stress;
+	WDFREQUEST Requests[AMTPTP_STRESS_SLOTS];
+	uint8_t *Reports[AMTPTP_STRESS_SLOTS];
+	uint64_t Reported;
+	uint64_t Cancelled;
+	uint64_t Failed;
+} AMTPTP_STRESS_CLIENT, *PAMTPTP_STRESS_CLIENT;
+
+struct _AMTPTP_STRESS {
+	AMTPTP_SIM_DEVICE Sim;
+	AMTPTP_USB_TRANSPORT Transport;
+	AMTPTP_HOST_BINDING Binding;
+	WDFDEVICE Device;
+	PDEVICE_CONTEXT Context;
+	int Stop;
+	AMTPTP_STRESS_CLIENT Clients[AMTPTP_STRESS_CLIENTS];
+	uint64_t Frames;
+	uint64_t ReaderFailures;
+	uint64_t PowerCycles;
+	uint64_t PowerFailures;
+};
+
+static int
+AmtPtpStressIsStopping(
+	PAMTPTP_STRESS Stress
+)
+{
+	return __atomic_load_n(&Stress->Stop, __ATOMIC_ACQUIRE);
+}
+
+// Takes a completed read back from the driver
+static void
+AmtPtpStressCollect(
+	PAMTPTP_STRESS_CLIENT Client,
+	int Slot
+)
+{
+	const PTP_REPORT *report = (const PTP_REPORT *) Client->Reports[Slot];
+	NTSTATUS status = STATUS_UNSUCCESSFUL;
+	ULONG_PTR information = 0;
+
+	AmtPtpHostIsRequestCompleted(Client->Requests[Slot], &status, &information);
+	if (status == STATUS_SUCCESS && information == sizeof(PTP_REPORT) &&
+		report->ReportID == REPORTID_MULTITOUCH && report->ContactCount <= 5) {
+		Client->Reported++;
+	}
+	else if (status == STATUS_CANCELLED) {
+		Client->Cancelled++;
+	}
+	else {
+		Client->Failed++;
+	}
+
+	AmtPtpHostReleaseRequest(Client->Requests[Slot]);
+	Client->Requests[Slot] = NULL;
+}
+
+static void *
+AmtPtpStressClientThread(
+	void *Context
+)
+{
+	PAMTPTP_STRESS_CLIENT client = Context;
+	int i;
+
+	while (!AmtPtpStressIsStopping(client->Stress)) {
+		for (i = 0; i < AMTPTP_STRESS_SLOTS; i++) {
+			if (client->Requests[i] != NULL) {
+				if (!AmtPtpHostIsRequestCompleted(client->Requests[i], NULL, NULL)) {
+					continue;
+				}
+				AmtPtpStressCollect(client, i);
+			}
+
+			if (!NT_SUCCESS(AmtPtpHostCreateRequest(client->Stress->Device, IOCTL_HID_READ_REPORT, NULL, 0,
+				client->Reports[i], sizeof(PTP_REPORT), NULL, &client->Requests[i]))) {
+				client->Requests[i] = NULL;
+				client->Failed++;
+				continue;
+			}
+			AmtPtpHostSendRequest(client->Requests[i]);
+		}
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+static void *
+AmtPtpStressReaderThread(
+	void *Context
+)
+{
+	PAMTPTP_STRESS stress = Context;
+	NTSTATUS status;
+
+	while (!AmtPtpStressIsStopping(stress)) {
+		AmtPtpHostAdvanceClock(AMTPTP_STRESS_FRAME_TICKS);
+
+		// The pipe is stopped while the device is out of D0
+		status = AmtPtpHostUsbReadPipe(stress->Device);
+		if (status == STATUS_SUCCESS) {
+			stress->Frames++;
+		}
+		else if (status != STATUS_INVALID_DEVICE_STATE && status != STATUS_NO_MORE_ENTRIES) {
+			stress->ReaderFailures++;
+		}
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+static void *
+AmtPtpStressPowerThread(
+	void *Context
+)
+{
+	PAMTPTP_STRESS stress = Context;
+
+	while (!AmtPtpStressIsStopping(stress)) {
+		if (AmtPtpHostD0Exit(stress->Device, WdfPowerDeviceD3) != STATUS_SUCCESS ||
+			stress->Context->IsWellspringModeOn) {
+			stress->PowerFailures++;
+		}
+		sched_yield();
+
+		if (AmtPtpHostD0Entry(stress->Device, WdfPowerDeviceD3) != STATUS_SUCCESS ||
+			!stress->Context->IsWellspringModeOn) {
+			stress->PowerFailures++;
+		}
+		stress->PowerCycles++;
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+int
+main(
+	void
+)
+{
+	static AMTPTP_STRESS stress;
+	const struct BCM5974_CONFIG *config;
+	AMTPTP_MODE_SWITCH modeSwitch;
+	WDFDRIVER driver = NULL;
+	pthread_t clients[AMTPTP_STRESS_CLIENTS], reader, power;
+	struct timespec second = { 1, 0 };
+	uint64_t reported = 0, cancelled = 0;
+	int c, i;
+
+	AmtPtpHostSetClock(0);
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+
+	AmtPtpSimGetTransport(&stress.Sim, &stress.Transport);
+	AmtPtpHostInitUsbBinding(&stress.Binding, &stress.Transport, USB_VENDOR_ID_APPLE, AMTPTP_STRESS_PRODUCT_ID);
+	AMTPTP_CHECK_EQ(AmtPtpHostAddDevice(driver, &stress.Binding, &stress.Device), STATUS_SUCCESS);
+	AMTPTP_CHECK_EQ(AmtPtpHostPrepareHardware(stress.Device), STATUS_SUCCESS);
+
+	stress.Context = DeviceGetContext(stress.Device);
+	config = stress.Context->DeviceInfo;
+	AMTPTP_CHECK(config->tp_type != TYPE3);
+
+	modeSwitch.Size = (uint32_t) config->um_size;
+	modeSwitch.RequestValue = (uint16_t) config->um_req_val;
+	modeSwitch.RequestIndex = (uint16_t) config->um_req_idx;
+	modeSwitch.SwitchIndex = (uint32_t) config->um_switch_idx;
+	modeSwitch.SwitchOn = (uint8_t) config->um_switch_on;
+	modeSwitch.SwitchOff = (uint8_t) config->um_switch_off;
+	AmtPtpSimInit(&stress.Sim, &modeSwitch, &stress.Context->Decoder);
+	stress.Sim.Script.Fingers = 3;
+	stress.Sim.Script.Width = config->x.max - config->x.min;
+	stress.Sim.Script.Height = config->y.max - config->y.min;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostD0Entry(stress.Device, WdfPowerDeviceD3), STATUS_SUCCESS);
+
+	// Every frame also takes the raw frame capture path
+	AmtPtpHostEnableTraceLogging(1);
+
+	for (c = 0; c < AMTPTP_STRESS_CLIENTS; c++) {
+		stress.Clients[c].Stress = &stress;
+		for (i = 0; i < AMTPTP_STRESS_SLOTS; i++) {
+			stress.Clients[c].Reports[i] = malloc(sizeof(PTP_REPORT));
+		}
+		pthread_create(&clients[c], NULL, AmtPtpStressClientThread, &stress.Clients[c]);
+	}
+	pthread_create(&reader, NULL, AmtPtpStressReaderThread, &stress);
+	pthread_create(&power, NULL, AmtPtpStressPowerThread, &stress);
+
+	for (i = 0; i < AMTPTP_STRESS_SECONDS; i++) {
+		nanosleep(&second, NULL);
+	}
+	__atomic_store_n(&stress.Stop, 1, __ATOMIC_RELEASE);
+
+	pthread_join(power, NULL);
+	pthread_join(reader, NULL);
+	for (c = 0; c < AMTPTP_STRESS_CLIENTS; c++) {
+		pthread_join(clients[c], NULL);
+	}
+	AmtPtpHostEnableTraceLogging(0);
+
+	// Reads still pending are cancelled on removal
+	AMTPTP_CHECK_EQ(AmtPtpHostD0Exit(stress.Device, WdfPowerDeviceD3), STATUS_SUCCESS);
+	AmtPtpHostRemoveDevice(stress.Device);
+
+	for (c = 0; c < AMTPTP_STRESS_CLIENTS; c++) {
+		for (i = 0; i < AMTPTP_STRESS_SLOTS; i++) {
+			if (stress.Clients[c].Requests[i] != NULL) {
+				AMTPTP_CHECK(AmtPtpHostIsRequestCompleted(stress.Clients[c].Requests[i], NULL, NULL));
+				AmtPtpStressCollect(&stress.Clients[c], i);
+			}
+			free(stress.Clients[c].Reports[i]);
+		}
+
+		AMTPTP_CHECK_EQ(stress.Clients[c].Failed, 0);
+		reported += stress.Clients[c].Reported;
+		cancelled += stress.Clients[c].Cancelled;
+	}
+
+	printf("%llu frames, %llu reports, %llu cancelled, %llu power cycles\n",
+		(unsigned long long) stress.Frames, (unsigned long long) reported,
+		(unsigned long long) cancelled, (unsigned long long) stress.PowerCycles);
+
+	AMTPTP_CHECK(stress.Frames > 0);
+	AMTPTP_CHECK(reported > 0);
+	AMTPTP_CHECK(AmtPtpHostTraceLoggingCount() >= reported);
+	AMTPTP_CHECK(stress.PowerCycles > 0);
+	AMTPTP_CHECK_EQ(stress.ReaderFailures, 0);
+	AMTPTP_CHECK_EQ(stress.PowerFailures, 0);
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
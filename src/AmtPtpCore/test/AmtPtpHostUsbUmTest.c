@@ -0,0 +1,215 @@
+// AmtPtpHostUsbUmTest.c: AmtPtpDeviceUsbUm on the host WDF shim
+//
+// Loads the real driver, binds one device per supported Wellspring family to
+// a simulated trackpad and runs it through prepare hardware, D0 entry, HID
+// reads, D0 exit and removal. Every completed read must carry exactly the
+// report the core reference decoder and packer produce for the same frame,
+// with ScanTime taken on the virtual clock relative to D0 entry. Built once
+// per report layout; AMTPTP_COMPACT_REPORT selects the compact one.
+
+#include <stdlib.h>
+
+#include <Driver.h>
+
+#include "AmtPtpHost.h"
+#include "AmtPtpSim.h"
+#include "AmtPtpTest.h"
+
+#ifdef AMTPTP_COMPACT_REPORT
+#define AMTPTP_TEST_REPORT_SIZE AMTPTP_COMPACT_REPORT_SIZE
+#else
+#define AMTPTP_TEST_REPORT_SIZE AMTPTP_REPORT_SIZE
+#endif
+
+#define AMTPTP_TEST_FRAMES 40
+#define AMTPTP_TEST_FRAME_TICKS 80000
+
+typedef struct _AMTPTP_TEST_DEVICE {
+	AMTPTP_SIM_DEVICE Sim;
+	AMTPTP_USB_TRANSPORT Transport;
+	AMTPTP_HOST_BINDING Binding;
+	WDFDEVICE Device;
+	PDEVICE_CONTEXT Context;
+	int64_t D0Counter;
+	AMTPTP_CONTACT_ID_MAP ContactIds;	// Mirrors the driver's in compact builds
+} AMTPTP_TEST_DEVICE, *PAMTPTP_TEST_DEVICE;
+
+// Reads the frame the next pipe read will deliver and packs the report the
+// driver must produce for it. Returns 0 if the frame is not decodable.
+static int
+AmtPtpTestExpectReport(
+	PAMTPTP_TEST_DEVICE Test,
+	uint8_t *Report
+)
+{
+	AMTPTP_SIM_DEVICE sim = Test->Sim;
+	AMTPTP_USB_TRANSPORT transport;
+	AMTPTP_FRAME frame;
+	uint8_t *raw;
+	uint32_t length = 0;
+	uint32_t flags = 0;
+	AMTPTP_DECODE_STATUS status;
+	size_t transferLength = (size_t) Test->Context->DeviceInfo->tp_datalen;
+
+	raw = malloc(transferLength);
+	AmtPtpSimGetTransport(&sim, &transport);
+	AMTPTP_CHECK_EQ(transport.ReadInterrupt(transport.Context, raw, (uint32_t) transferLength, &length), AmtPtpUsbOk);
+
+	if (Test->Context->IsSurfaceReportOn) flags |= AMTPTP_DECODE_SURFACE;
+	if (Test->Context->IsButtonReportOn) flags |= AMTPTP_DECODE_BUTTON;
+
+	status = AmtPtpDecodeFrame(&Test->Context->Decoder, raw, length, flags, &frame);
+	free(raw);
+	if (status != AmtPtpDecodeOk) {
+		return 0;
+	}
+
+#ifdef AMTPTP_COMPACT_REPORT
+	AmtPtpMapContactIds(&Test->ContactIds, &frame);
+	AmtPtpPackCompactReport(&frame, AmtPtpScanTime(Test->D0Counter, (int64_t) AmtPtpHostGetClock()), Report);
+#else
+	AmtPtpPackReport(&frame, AmtPtpScanTime(Test->D0Counter, (int64_t) AmtPtpHostGetClock()), Report);
+#endif
+	return 1;
+}
+
+static WDFREQUEST
+AmtPtpTestSendRead(
+	PAMTPTP_TEST_DEVICE Test,
+	uint8_t *Report
+)
+{
+	WDFREQUEST request = NULL;
+
+	AMTPTP_CHECK_EQ(AmtPtpHostCreateRequest(Test->Device, IOCTL_HID_READ_REPORT, NULL, 0,
+		Report, sizeof(PTP_REPORT), NULL, &request), STATUS_SUCCESS);
+	AmtPtpHostSendRequest(request);
+
+	// Reads wait in InputQueue for the next frame
+	AMTPTP_CHECK(!AmtPtpHostIsRequestCompleted(request, NULL, NULL));
+	return request;
+}
+
+static void
+AmtPtpTestFamily(
+	WDFDRIVER Driver,
+	const struct BCM5974_CONFIG *Config
+)
+{
+	AMTPTP_TEST_DEVICE test;
+	AMTPTP_MODE_SWITCH modeSwitch;
+	uint8_t expected[AMTPTP_TEST_REPORT_SIZE];
+	uint8_t *report = malloc(sizeof(PTP_REPORT));
+	WDFREQUEST request;
+	NTSTATUS status = STATUS_UNSUCCESSFUL;
+	ULONG_PTR information = 0;
+	uint64_t traceLogging;
+	int i;
+
+	memset(&test, 0, sizeof(test));
+	AmtPtpSimGetTransport(&test.Sim, &test.Transport);
+	AmtPtpHostInitUsbBinding(&test.Binding, &test.Transport, USB_VENDOR_ID_APPLE, (USHORT) Config->ansi);
+
+	AMTPTP_CHECK_EQ(AmtPtpHostAddDevice(Driver, &test.Binding, &test.Device), STATUS_SUCCESS);
+	AMTPTP_CHECK_EQ(AmtPtpHostPrepareHardware(test.Device), STATUS_SUCCESS);
+
+	test.Context = DeviceGetContext(test.Device);
+	// Bcm5974ConfigTable is static, so the driver holds its own copy
+	AMTPTP_CHECK_EQ(test.Context->DeviceInfo->ansi, Config->ansi);
+	AMTPTP_CHECK(test.Context->DecodeFrame == AmtPtpSelectDecoder(&test.Context->Decoder));
+
+	// The trackpad speaks the wire format the driver configured itself for
+	modeSwitch.Size = (uint32_t) Config->um_size;
+	modeSwitch.RequestValue = (uint16_t) Config->um_req_val;
+	modeSwitch.RequestIndex = (uint16_t) Config->um_req_idx;
+	modeSwitch.SwitchIndex = (uint32_t) Config->um_switch_idx;
+	modeSwitch.SwitchOn = (uint8_t) Config->um_switch_on;
+	modeSwitch.SwitchOff = (uint8_t) Config->um_switch_off;
+	AmtPtpSimInit(&test.Sim, &modeSwitch, &test.Context->Decoder);
+	test.Sim.Script.Fingers = 3;
+	test.Sim.Script.Width = Config->x.max - Config->x.min;
+	test.Sim.Script.Height = Config->y.max - Config->y.min;
+	AmtPtpInitContactIdMap(&test.ContactIds);
+
+	// TYPE3 trackpads stream without a mode switch
+	if (Config->tp_type == TYPE3) {
+		test.Sim.IsWellspringModeOn = 1;
+	}
+
+	test.D0Counter = (int64_t) AmtPtpHostAdvanceClock(1000);
+	AMTPTP_CHECK_EQ(AmtPtpHostD0Entry(test.Device, WdfPowerDeviceD3), STATUS_SUCCESS);
+	AMTPTP_CHECK(test.Sim.IsWellspringModeOn);
+	AMTPTP_CHECK(test.Context->IsWellspringModeOn);
+	AMTPTP_CHECK_EQ(test.Context->PerfCounter.QuadPart, test.D0Counter);
+
+	// Without a pending read the frame is disposed
+	AMTPTP_CHECK(AmtPtpTestExpectReport(&test, expected));
+	AMTPTP_CHECK_EQ(AmtPtpHostUsbReadPipe(test.Device), STATUS_SUCCESS);
+
+	for (i = 0; i < AMTPTP_TEST_FRAMES; i++) {
+		request = AmtPtpTestSendRead(&test, report);
+		AmtPtpHostAdvanceClock(AMTPTP_TEST_FRAME_TICKS + (uint64_t) i * 7);
+
+		// The last frames also go through the TraceLogging path
+		traceLogging = AmtPtpHostTraceLoggingCount();
+		AmtPtpHostEnableTraceLogging(i >= AMTPTP_TEST_FRAMES - 4);
+
+		memset(report, 0xCC, sizeof(PTP_REPORT));
+		AMTPTP_CHECK(AmtPtpTestExpectReport(&test, expected));
+		AMTPTP_CHECK_EQ(AmtPtpHostUsbReadPipe(test.Device), STATUS_SUCCESS);
+
+		AMTPTP_CHECK(AmtPtpHostIsRequestCompleted(request, &status, &information));
+		AMTPTP_CHECK_EQ(status, STATUS_SUCCESS);
+		AMTPTP_CHECK_EQ(information, sizeof(PTP_REPORT));
+		AMTPTP_CHECK_MEM(report, expected, AMTPTP_TEST_REPORT_SIZE);
+		AMTPTP_CHECK_EQ(AmtPtpHostTraceLoggingCount() - traceLogging, i >= AMTPTP_TEST_FRAMES - 4);
+		AmtPtpHostReleaseRequest(request);
+	}
+	AmtPtpHostEnableTraceLogging(0);
+
+	// A read pending across D0 exit stays queued; the stopped pipe delivers nothing
+	request = AmtPtpTestSendRead(&test, report);
+	AMTPTP_CHECK_EQ(AmtPtpHostD0Exit(test.Device, WdfPowerDeviceD3), STATUS_SUCCESS);
+	AMTPTP_CHECK(!test.Context->IsWellspringModeOn);
+	AMTPTP_CHECK(Config->tp_type == TYPE3 || !test.Sim.IsWellspringModeOn);
+	AMTPTP_CHECK_EQ(AmtPtpHostUsbReadPipe(test.Device), STATUS_INVALID_DEVICE_STATE);
+	AMTPTP_CHECK(!AmtPtpHostIsRequestCompleted(request, NULL, NULL));
+
+	AmtPtpHostRemoveDevice(test.Device);
+	AMTPTP_CHECK(AmtPtpHostIsRequestCompleted(request, &status, NULL));
+	AMTPTP_CHECK_EQ(status, STATUS_CANCELLED);
+	AmtPtpHostReleaseRequest(request);
+
+	free(report);
+}
+
+int
+main(
+	void
+)
+{
+	WDFDRIVER driver = NULL;
+	size_t i;
+	int families = 0;
+
+	AMTPTP_CHECK_EQ(sizeof(PTP_REPORT), AMTPTP_TEST_REPORT_SIZE);
+
+	AmtPtpHostSetClock(0);
+	AMTPTP_CHECK_EQ(AmtPtpHostLoadDriver(DriverEntry, &driver), STATUS_SUCCESS);
+
+	// The table has no terminating entry
+	for (i = 0; i < sizeof(Bcm5974ConfigTable) / sizeof(Bcm5974ConfigTable[0]); i++) {
+		// TYPE1 devices are not supported by the driver
+		if (Bcm5974ConfigTable[i].tp_type == TYPE1) {
+			continue;
+		}
+		AmtPtpTestFamily(driver, &Bcm5974ConfigTable[i]);
+		families++;
+	}
+
+	AMTPTP_CHECK(families > 0);
+	AMTPTP_CHECK(AmtPtpHostTraceCount(TRACE_LEVEL_INFORMATION) > 0);
+
+	AmtPtpHostUnloadDriver(driver);
+	return AMTPTP_TEST_RESULT();
+}
@@ -0,0 +1,339 @@
+// AmtPtpLegacyTest.c: AmtPtpDecodeFrame against the decoders it replaced
+//
+// Each Legacy* function below is the finger loop the driver carried before
+// AmtPtpCore, with its arithmetic kept verbatim; only the finger structs are
+// read byte-wise, so the test runs on any host. Known, intended differences:
+//
+//   - USB frames with a partial finger record are rejected (UsbUm read them)
+//   - SPI ContactCount is capped to five (SpiKm reported NumOfFingers as-is)
+//     and IsButtonClicked is 0 or 1 (SpiKm copied ClickOccurred)
+//   - ScanTime is 0 when the clock goes backwards (the cast wrapped)
+//
+// Frames are generated so these cases are left out of the comparison; the
+// new behaviour is covered by AmtPtpCoreTest.
+
+#include "AmtPtpTest.h"
+#include "AmtPtpCore.h"
+#include "AmtPtpLayout.h"
+
+#define LEGACY_ITERATIONS 50000
+#define LEGACY_MAX_FINGERS 16
+
+// BCM5974_CONFIG and SPI_TRACKPAD_INFO fields used by the decoders
+typedef struct _LEGACY_DEVICE {
+	const char *Name;
+	AMTPTP_FRAME_FORMAT Format;
+	int TipMinor;					// UsbKm also qualified by the minor axis
+	int tp_header;
+	int tp_delta;
+	int tp_fsize;
+	int tp_button;
+	int x_min;
+	int y_min;
+	int y_max;
+} LEGACY_DEVICE;
+
+// Rows of Bcm5974ConfigTable (UsbUm, UsbKm) and SpiTrackpadConfigTable (SpiKm)
+static const LEGACY_DEVICE LegacyDevices[] = {
+	{ "UsbUm TYPE2", AmtPtpFrameFormatWellspring, 0, HEADER_SIZE_TYPE2, FINGER_DELTA_TYPE2, FINGER_SIZE_TYPE2, BUTTON_OFFSET_TYPE2, -4460, -75, 6700 },
+	{ "UsbUm TYPE3", AmtPtpFrameFormatWellspring, 0, HEADER_SIZE_TYPE3, FINGER_DELTA_TYPE3, FINGER_SIZE_TYPE3, BUTTON_OFFSET_TYPE3, -4620, -150, 6600 },
+	{ "UsbUm TYPE4", AmtPtpFrameFormatWellspring, 0, HEADER_SIZE_TYPE4, FINGER_DELTA_TYPE4, FINGER_SIZE_TYPE4, BUTTON_OFFSET_TYPE4, -4828, -203, 6803 },
+	{ "UsbUm TYPE5", AmtPtpFrameFormatType5, 0, HEADER_SIZE_TYPE5, FINGER_DELTA_TYPE5, FINGER_SIZE_TYPE5, BUTTON_OFFSET_TYPE5, -3678, -2479, 2586 },
+	{ "UsbKm T2", AmtPtpFrameFormatWellspring, 1, HEADER_SIZE_TYPE4, FINGER_DELTA_TYPE4, FINGER_SIZE_TYPE4, BUTTON_OFFSET_TYPE4, -6243, -170, 7685 },
+	{ "UsbKm T2 fallback", AmtPtpFrameFormatWellspring, 1, HEADER_SIZE_TYPE4, FINGER_DELTA_TYPE4, FINGER_SIZE_TYPE4, BUTTON_OFFSET_TYPE4, -10000, -2000, 10000 },
+	{ "SpiKm MacBookPro12,1", AmtPtpFrameFormatSpi, 0, AMTPTP_SPI_HEADER_SIZE, 0, AMTPTP_SPI_FINGER_SIZE, SPI_CLICK_OCCURRED, -4750, -150, 6730 },
+};
+
+// Little-endian USHORT / SHORT / UINT field reads
+static uint16_t
+Legacy16(
+	const uint8_t *p
+)
+{
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t
+Legacy32(
+	const uint8_t *p
+)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static int
+AmtRawToInteger(
+	uint16_t x
+)
+{
+	return (int16_t) x;
+}
+
+// UsbUm AmtPtpServiceTouchInputInterrupt, UsbKm AmtPtpServiceTouchInputInterrupt
+static void
+LegacyWellspring(
+	const LEGACY_DEVICE *Device,
+	const uint8_t *Buffer,
+	size_t NumBytesTransferred,
+	PAMTPTP_FRAME Report
+)
+{
+	size_t headerSize = (unsigned int) Device->tp_header;
+	size_t fingerprintSize = (unsigned int) Device->tp_fsize;
+	size_t raw_n, i;
+	uint16_t x, y;
+
+	raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
+	if (raw_n >= AMTPTP_MAX_CONTACTS) raw_n = AMTPTP_MAX_CONTACTS;
+	Report->ContactCount = (uint8_t) raw_n;
+
+	for (i = 0; i < raw_n; i++) {
+		const uint8_t *f = Buffer + headerSize + Device->tp_delta + i * fingerprintSize;
+
+		x = (AmtRawToInteger(Legacy16(f + WELLSPRING_ABS_X)) - Device->x_min) > 0 ?
+			((uint16_t) (AmtRawToInteger(Legacy16(f + WELLSPRING_ABS_X)) - Device->x_min)) : 0;
+		y = (Device->y_max - AmtRawToInteger(Legacy16(f + WELLSPRING_ABS_Y))) > 0 ?
+			((uint16_t) (Device->y_max - AmtRawToInteger(Legacy16(f + WELLSPRING_ABS_Y)))) : 0;
+
+		Report->Contacts[i].ContactID = (uint8_t) i;
+		Report->Contacts[i].X = x;
+		Report->Contacts[i].Y = y;
+		if (Device->TipMinor) {
+			Report->Contacts[i].TipSwitch = (AmtRawToInteger(Legacy16(f + WELLSPRING_TOUCH_MAJOR)) << 1) >= 200 ||
+				(AmtRawToInteger(Legacy16(f + WELLSPRING_TOUCH_MINOR)) << 1) >= 150;
+		}
+		else {
+			Report->Contacts[i].TipSwitch = (AmtRawToInteger(Legacy16(f + WELLSPRING_TOUCH_MAJOR)) << 1) >= 200;
+		}
+		Report->Contacts[i].Confidence = (AmtRawToInteger(Legacy16(f + WELLSPRING_TOUCH_MINOR)) << 1) > 0;
+	}
+
+	if (Buffer[Device->tp_button]) {
+		Report->IsButtonClicked = 1;
+	}
+}
+
+// UsbUm AmtPtpServiceTouchInputInterruptType5
+static void
+LegacyType5(
+	const LEGACY_DEVICE *Device,
+	const uint8_t *Buffer,
+	size_t NumBytesTransferred,
+	PAMTPTP_FRAME Report
+)
+{
+	size_t headerSize = (unsigned int) Device->tp_header;
+	size_t fingerprintSize = (unsigned int) Device->tp_fsize;
+	size_t raw_n, i;
+	int x, y;
+
+	raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
+	if (raw_n >= AMTPTP_MAX_CONTACTS) raw_n = AMTPTP_MAX_CONTACTS;
+	Report->ContactCount = (uint8_t) raw_n;
+
+	for (i = 0; i < raw_n; i++) {
+		const uint8_t *f_type5 = Buffer + headerSize + Device->tp_delta + i * fingerprintSize;
+
+		uint16_t tmp_x = Legacy16(f_type5) & 0x1fff;
+		uint32_t tmp_y = (int32_t) Legacy32(f_type5);
+
+		x = (int16_t) (tmp_x << 3) >> 3;
+		// -(INT) (tmp_y << 6) >> 19, negated in unsigned arithmetic so INT_MIN does not overflow
+		y = (int32_t) (0u - (tmp_y << 6)) >> 19;
+
+		x = (x - Device->x_min) > 0 ? (x - Device->x_min) : 0;
+		y = (y - Device->y_min) > 0 ? (y - Device->y_min) : 0;
+
+		Report->Contacts[i].ContactID = f_type5[TYPE5_IDENTIFIER] & 0xf;
+		Report->Contacts[i].X = (uint16_t) x;
+		Report->Contacts[i].Y = (uint16_t) y;
+		Report->Contacts[i].TipSwitch = (AmtRawToInteger(f_type5[TYPE5_TOUCH_MAJOR]) << 1) > 0;
+		Report->Contacts[i].Confidence = (AmtRawToInteger(f_type5[TYPE5_TOUCH_MINOR]) << 1) < 345 &&
+			(AmtRawToInteger(f_type5[TYPE5_TOUCH_MINOR]) << 1) < 345;
+	}
+
+	if (Buffer[Device->tp_button]) {
+		Report->IsButtonClicked = 1;
+	}
+}
+
+// SpiKm AmtPtpRequestCompletionRoutine
+static void
+LegacySpi(
+	const LEGACY_DEVICE *Device,
+	const uint8_t *pSpiTrackpadPacket,
+	PAMTPTP_FRAME Report
+)
+{
+	uint8_t NumOfFingers = pSpiTrackpadPacket[SPI_NUM_OF_FINGERS];
+	uint8_t AdjustedCount = (NumOfFingers > 5) ? 5 : NumOfFingers;
+	uint8_t Count;
+
+	Report->ContactCount = NumOfFingers;
+	Report->IsButtonClicked = pSpiTrackpadPacket[SPI_CLICK_OCCURRED];
+
+	for (Count = 0; Count < AdjustedCount; Count++) {
+		const uint8_t *Finger = pSpiTrackpadPacket + AMTPTP_SPI_HEADER_SIZE + Count * AMTPTP_SPI_FINGER_SIZE;
+		int16_t X = (int16_t) Legacy16(Finger + SPI_X);
+		int16_t Y = (int16_t) Legacy16(Finger + SPI_Y);
+		int16_t TouchMajor = (int16_t) Legacy16(Finger + SPI_TOUCH_MAJOR);
+		int16_t TouchMinor = (int16_t) Legacy16(Finger + SPI_TOUCH_MINOR);
+		int16_t Pressure = (int16_t) Legacy16(Finger + SPI_PRESSURE);
+
+		Report->Contacts[Count].ContactID = Count;
+		Report->Contacts[Count].X = ((X - Device->x_min) > 0) ? (uint16_t) (X - Device->x_min) : 0;
+		Report->Contacts[Count].Y = ((Device->y_max - Y) > 0) ? (uint16_t) (Device->y_max - Y) : 0;
+		Report->Contacts[Count].TipSwitch = (Pressure > 0) ? 1 : 0;
+		Report->Contacts[Count].Confidence = (TouchMajor < 2500 && TouchMinor < 2500) ? 1 : 0;
+	}
+}
+
+// Every driver saturated the 100us delta at 0xFF
+static uint16_t
+LegacyScanTime(
+	int64_t Last,
+	int64_t Current
+)
+{
+	int64_t PerfCounterDelta = (Current - Last) / 100;
+
+	if (PerfCounterDelta > 0xFF) {
+		PerfCounterDelta = 0xFF;
+	}
+
+	return (uint16_t) PerfCounterDelta;
+}
+
+static void
+LegacyInitDecoder(
+	const LEGACY_DEVICE *Device,
+	PAMTPTP_DECODER Decoder
+)
+{
+	// As the drivers' AmtPtpConfigInputDecoder and AmtPtpSpiPrepareHardware do
+	AmtPtpInitDecoder(Decoder, Device->Format);
+	if (Device->Format != AmtPtpFrameFormatSpi) {
+		Decoder->HeaderSize = Device->tp_header;
+		Decoder->FingerSize = Device->tp_fsize;
+		Decoder->FingerDelta = Device->tp_delta;
+		Decoder->ButtonOffset = Device->tp_button;
+	}
+	Decoder->XMin = Device->x_min;
+	Decoder->YMin = Device->y_min;
+	Decoder->YMax = Device->y_max;
+	if (Device->TipMinor) {
+		Decoder->Thresholds.TipSwitchMinor = 150;
+	}
+}
+
+// Random bytes, with the sizes biased towards the thresholds
+static void
+LegacyFillFrame(
+	PAMTPTP_TEST_RANDOM Random,
+	const LEGACY_DEVICE *Device,
+	uint8_t *Buffer,
+	size_t Length
+)
+{
+	size_t Offset;
+	uint32_t Major;
+
+	AmtPtpTestFill(Random, Buffer, Length);
+
+	for (Offset = Device->tp_header + Device->tp_delta; Offset + Device->tp_fsize <= Length + Device->tp_delta; Offset += Device->tp_fsize) {
+		uint8_t *f = Buffer + Offset;
+
+		if (AmtPtpTestNext(Random) & 1) {
+			continue;
+		}
+
+		switch (Device->Format) {
+			case AmtPtpFrameFormatWellspring:
+				f[WELLSPRING_TOUCH_MAJOR] = (uint8_t) (95 + AmtPtpTestNext(Random) % 10);
+				f[WELLSPRING_TOUCH_MAJOR + 1] = 0;
+				f[WELLSPRING_TOUCH_MINOR] = (uint8_t) (AmtPtpTestNext(Random) % 80);
+				f[WELLSPRING_TOUCH_MINOR + 1] = 0;
+				break;
+			case AmtPtpFrameFormatType5:
+				f[TYPE5_TOUCH_MAJOR] = (uint8_t) (AmtPtpTestNext(Random) % 3);
+				f[TYPE5_TOUCH_MINOR] = (uint8_t) (170 + AmtPtpTestNext(Random) % 5);
+				break;
+			case AmtPtpFrameFormatSpi:
+				f[SPI_PRESSURE] = (uint8_t) (AmtPtpTestNext(Random) % 2);
+				f[SPI_PRESSURE + 1] = 0;
+				Major = 2498 + AmtPtpTestNext(Random) % 4;
+				f[SPI_TOUCH_MAJOR] = (uint8_t) Major;
+				f[SPI_TOUCH_MAJOR + 1] = (uint8_t) (Major >> 8);
+				break;
+		}
+	}
+}
+
+static void
+TestDevice(
+	const LEGACY_DEVICE *Device,
+	PAMTPTP_TEST_RANDOM Random
+)
+{
+	uint8_t Buffer[AMTPTP_SPI_HEADER_SIZE + LEGACY_MAX_FINGERS * AMTPTP_SPI_FINGER_SIZE];
+	AMTPTP_DECODER Decoder;
+	AMTPTP_FRAME Expected, Actual;
+	unsigned long Before = AmtPtpTestFailures;
+	size_t Length;
+	int i;
+
+	LegacyInitDecoder(Device, &Decoder);
+
+	for (i = 0; i < LEGACY_ITERATIONS; i++) {
+		AMTPTP_FRAME Empty = { 0 };
+		int64_t Last = (int64_t) (AmtPtpTestNext(Random) % 1000000);
+		int64_t Now = Last + (int64_t) (AmtPtpTestNext(Random) % 40000);
+
+		Expected = Empty;
+
+		if (Device->Format == AmtPtpFrameFormatSpi) {
+			// SpiKm read all five finger slots whatever the transfer held
+			Length = AMTPTP_SPI_HEADER_SIZE + AMTPTP_MAX_CONTACTS * AMTPTP_SPI_FINGER_SIZE +
+				AmtPtpTestNext(Random) % ((LEGACY_MAX_FINGERS - AMTPTP_MAX_CONTACTS) * AMTPTP_SPI_FINGER_SIZE);
+			LegacyFillFrame(Random, Device, Buffer, Length);
+			Buffer[SPI_NUM_OF_FINGERS] = (uint8_t) (AmtPtpTestNext(Random) % 8);
+			LegacySpi(Device, Buffer, &Expected);
+			Expected.IsButtonClicked = Expected.IsButtonClicked ? 1 : 0;
+			if (Expected.ContactCount > AMTPTP_MAX_CONTACTS) {
+				Expected.ContactCount = AMTPTP_MAX_CONTACTS;
+			}
+		}
+		else {
+			Length = Device->tp_header + (AmtPtpTestNext(Random) % LEGACY_MAX_FINGERS) * Device->tp_fsize;
+			LegacyFillFrame(Random, Device, Buffer, Length);
+			if (Device->Format == AmtPtpFrameFormatType5) {
+				LegacyType5(Device, Buffer, Length, &Expected);
+			}
+			else {
+				LegacyWellspring(Device, Buffer, Length, &Expected);
+			}
+		}
+
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&Decoder, Buffer, Length, AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Actual), AmtPtpDecodeOk);
+		AMTPTP_CHECK_FRAME(&Actual, &Expected);
+		AMTPTP_CHECK_EQ(AmtPtpScanTime(Last, Now), LegacyScanTime(Last, Now));
+
+		if (AmtPtpTestFailures != Before) {
+			fprintf(stderr, "%s: mismatch in frame %d (%zu bytes)\n", Device->Name, i, Length);
+			return;
+		}
+	}
+}
+
+int
+main(void)
+{
+	AMTPTP_TEST_RANDOM Random = { 0x5EED };
+	size_t i;
+
+	for (i = 0; i < sizeof(LegacyDevices) / sizeof(LegacyDevices[0]); i++) {
+		TestDevice(&LegacyDevices[i], &Random);
+	}
+
+	return AMTPTP_TEST_RESULT();
+}
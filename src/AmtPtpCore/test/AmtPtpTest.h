@@ -0,0 +1,102 @@
+// AmtPtpTest.h: Checks and a deterministic generator shared by the host tests
+//
+// Every test is one executable. A failed check is printed and counted, and
+// AMTPTP_TEST_RESULT turns the count into the exit code seen by ctest.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "AmtPtpCore.h"
+
+static unsigned long AmtPtpTestFailures;
+
+#define AMTPTP_CHECK(Condition) \
+	do { \
+		if (!(Condition)) { \
+			if (AmtPtpTestFailures++ < 20) { \
+				fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #Condition); \
+			} \
+		} \
+	} while (0)
+
+#define AMTPTP_CHECK_EQ(Actual, Expected) \
+	do { \
+		long long _a = (long long) (Actual), _e = (long long) (Expected); \
+		if (_a != _e) { \
+			if (AmtPtpTestFailures++ < 20) { \
+				fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #Actual, _a, _e); \
+			} \
+		} \
+	} while (0)
+
+// Only for byte buffers and structs without padding
+#define AMTPTP_CHECK_MEM(Actual, Expected, Size) \
+	AMTPTP_CHECK(memcmp((Actual), (Expected), (Size)) == 0)
+
+// AMTPTP_CONTACT is padded, so frames are compared field by field, every slot
+#define AMTPTP_CHECK_FRAME(Actual, Expected) \
+	AMTPTP_CHECK(AmtPtpTestSameFrame((Actual), (Expected)))
+
+#define AMTPTP_TEST_RESULT() \
+	(AmtPtpTestFailures ? (fprintf(stderr, "%lu check(s) failed\n", AmtPtpTestFailures), 1) : 0)
+
+// xorshift32, so runs are identical on every host and C library
+typedef struct _AMTPTP_TEST_RANDOM {
+	uint32_t State;
+} AMTPTP_TEST_RANDOM, *PAMTPTP_TEST_RANDOM;
+
+static inline uint32_t
+AmtPtpTestNext(
+	PAMTPTP_TEST_RANDOM Random
+)
+{
+	uint32_t x = Random->State ? Random->State : 0x9E3779B9u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	Random->State = x;
+	return x;
+}
+
+static inline int
+AmtPtpTestSameFrame(
+	const AMTPTP_FRAME *Actual,
+	const AMTPTP_FRAME *Expected
+)
+{
+	const AMTPTP_CONTACT *a, *e;
+	size_t i;
+
+	if (Actual->ContactCount != Expected->ContactCount || Actual->IsButtonClicked != Expected->IsButtonClicked) {
+		return 0;
+	}
+
+	for (i = 0; i < AMTPTP_MAX_CONTACTS; i++) {
+		a = &Actual->Contacts[i];
+		e = &Expected->Contacts[i];
+		if (a->X != e->X || a->Y != e->Y || a->ContactID != e->ContactID ||
+			a->TipSwitch != e->TipSwitch || a->Confidence != e->Confidence) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static inline void
+AmtPtpTestFill(
+	PAMTPTP_TEST_RANDOM Random,
+	uint8_t *Buffer,
+	size_t Length
+)
+{
+	size_t i;
+
+	for (i = 0; i < Length; i++) {
+		Buffer[i] = (uint8_t) AmtPtpTestNext(Random);
+	}
+}
@@ -241,6 +241,13 @@ AmtPtpEvtDevicePrepareHardware(
 		goto exit;
 	}
 
+	// Set up frame decoder
+	AmtPtpInitDecoder(&pDeviceContext->Decoder, AmtPtpFrameFormatSpi);
+	pDeviceContext->Decoder.XMin = pDeviceContext->TrackpadInfo.XMin;
+	pDeviceContext->Decoder.YMin = pDeviceContext->TrackpadInfo.YMin;
+	pDeviceContext->Decoder.YMax = pDeviceContext->TrackpadInfo.YMax;
+	pDeviceContext->DecodeFrame = AmtPtpSelectDecoder(&pDeviceContext->Decoder);
+
 	// Check the desired report type.
 	Status = WdfDriverOpenParametersRegistryKey(
 		WdfDeviceGetDriver(Device),
@@ -340,9 +347,7 @@ AmtPtpEvtDeviceD0Entry(
 	}
 
 	// Set time
-	KeQueryPerformanceCounter(
-		&pDeviceContext->LastReportTime
-	);
+	pDeviceContext->LastReportTime = KeQueryPerformanceCounter(NULL);
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -371,7 +376,9 @@ AmtPtpEvtDeviceD0Exit(
 	);
 
 	pDeviceContext = DeviceGetContext(Device);
-	pDeviceContext->DeviceStatus = D3;
+
+	// Read completions may be re-enabling the device right now, see AmtPtpRequestCompletionRoutine
+	InterlockedExchange((volatile LONG*) &pDeviceContext->DeviceStatus, D3);
 
 	// Cancel all outstanding requests
 	while (NT_SUCCESS(Status)) {
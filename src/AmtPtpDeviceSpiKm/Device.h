@@ -68,6 +68,8 @@ typedef struct _DEVICE_CONTEXT
 	USHORT HidVersionNumber;
 	SPI_TRACKPAD_INFO TrackpadInfo;
 	REPORT_TYPE ReportType;
+	AMTPTP_DECODER Decoder;
+	PFN_AMTPTP_DECODE_FRAME DecodeFrame;	// Specialized for Decoder
 
 	// Windows PTP context
 	BOOLEAN PtpInputOn;
@@ -19,9 +19,12 @@ Environment:
 #include <initguid.h>
 #include <hidport.h>
 
+#include <AmtPtpCore.h>
+
 #include "device.h"
 #include "queue.h"
 #include "trace.h"
+#include "ModernTrace.h"
 
 #include "AppleDefinition.h"
 #include "Hid.h"
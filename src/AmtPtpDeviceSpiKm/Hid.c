@@ -733,6 +733,7 @@ AmtPtpSetFeatures(
 	PHID_XFER_PACKET pHidPacket;
 	WDF_REQUEST_PARAMETERS RequestParameters;
 	PDEVICE_CONTEXT pDeviceContext;
+	size_t ReportSize;
 
 	PAGED_CODE();
 
@@ -771,6 +772,18 @@ AmtPtpSetFeatures(
 				"%!FUNC! Report REPORTID_REPORTMODE is requested"
 			);
 
+			// Size sanity check
+			ReportSize = sizeof(PTP_DEVICE_INPUT_MODE_REPORT);
+			if (pHidPacket->reportBufferLen < ReportSize) {
+				Status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR,
+					TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_DEVICE_INPUT_MODE_REPORT DeviceInputMode = (PPTP_DEVICE_INPUT_MODE_REPORT) pHidPacket->reportBuffer;
 			switch (DeviceInputMode->Mode)
 			{
@@ -814,6 +827,18 @@ AmtPtpSetFeatures(
 				"%!FUNC! Report REPORTID_FUNCSWITCH is requested"
 			);
 
+			// Size sanity check
+			ReportSize = sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT);
+			if (pHidPacket->reportBufferLen < ReportSize) {
+				Status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR,
+					TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT InputSelection = (PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) pHidPacket->reportBuffer;
 			pDeviceContext->PtpReportButton = InputSelection->ButtonReport;
 			pDeviceContext->PtpReportTouch = InputSelection->SurfaceReport;
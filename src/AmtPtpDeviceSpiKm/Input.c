@@ -1,6 +1,11 @@
 #include "driver.h"
 #include "Input.tmh"
 
+#include <AmtPtpCapture.h>
+
+// Reports are packed by AmtPtpPackCompactReport straight into the request buffer
+C_ASSERT(sizeof(PTP_REPORT) == AMTPTP_COMPACT_REPORT_SIZE);
+
 VOID
 AmtPtpSpiInputRoutineWorker(
 	WDFDEVICE Device,
@@ -16,8 +21,9 @@ AmtPtpSpiInputRoutineWorker(
 	PWORKER_REQUEST_CONTEXT RequestContext;
 	pDeviceContext = DeviceGetContext(Device);
 
-	// This call is expected to happen after D0 entrance
-	if (pDeviceContext->DeviceStatus == D3) {
+	// This call is expected to happen after D0 entrance. Read completions
+	// update the status concurrently, so read it interlocked as well.
+	if (ReadAcquire((volatile LONG*) &pDeviceContext->DeviceStatus) == D3) {
 		TraceEvents(
 			TRACE_LEVEL_WARNING,
 			TRACE_QUEUE,
@@ -166,11 +172,10 @@ AmtPtpRequestCompletionRoutine(
 	PSPI_TRACKPAD_PACKET pSpiTrackpadPacket;
 
 	WDFREQUEST PtpRequest;
-	PTP_REPORT PtpReport;
-	WDFMEMORY PtpRequestMemory;
+	PUCHAR PtpReportBuffer;
+	AMTPTP_FRAME Frame;
 
 	LARGE_INTEGER CurrentCounter;
-	LONGLONG CounterDelta;
 
 	UNREFERENCED_PARAMETER(Target);
 
@@ -192,11 +197,41 @@ AmtPtpRequestCompletionRoutine(
 		goto cleanup;
 	}
 
+	// A failed read (e.g. cancelled by D0 exit) carries no frame to decode
+	if (!NT_SUCCESS(Params->IoStatus.Status)) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_DRIVER,
+			"%!FUNC! SPI read failed with %!STATUS!",
+			Params->IoStatus.Status
+		);
+
+		Status = Params->IoStatus.Status;
+		goto exit;
+	}
+
 	SpiRequestLength = (LONG) WdfRequestGetInformation(SpiRequest);
 	pSpiTrackpadPacket = (PSPI_TRACKPAD_PACKET) WdfMemoryGetBuffer(Params->Parameters.Ioctl.Output.Buffer, NULL);
 
+	// Lossless capture of the packet as delivered, only paid for while a session listens
+	if (TraceLoggingProviderEnabled(g_hAmtPtpDeviceTraceProvider, WINEVENT_LEVEL_VERBOSE, KEYWORD_INPUT_RAW_FRAME)) {
+		CurrentCounter = KeQueryPerformanceCounter(NULL);
+		TraceLoggingWrite(
+			g_hAmtPtpDeviceTraceProvider,
+			EVENT_INPUT_DIAGNOSTICS,
+			TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+			TraceLoggingKeyword(KEYWORD_INPUT_RAW_FRAME),
+			TraceLoggingUInt16(pDeviceContext->HidProductID, "idProduct"),
+			TraceLoggingUInt32(AMTPTP_CAPTURE_NO_TRACKPAD_TYPE, "TrackpadType"),
+			TraceLoggingInt64(CurrentCounter.QuadPart, "Timestamp"),
+			TraceLoggingBinary(pSpiTrackpadPacket, (UINT16) SpiRequestLength, "Frame"),
+			TraceLoggingString(EVENT_INPUT_DIAG_SUBTYPE_RAWFRAME, EVENT_DRIVER_FUNC_SUBTYPE)
+		);
+	}
+
 	// Safe measurement for buffer overrun and device state reset
-	if (SpiRequestLength < 46) {
+	if (pDeviceContext->DecodeFrame(&pDeviceContext->Decoder, (const UINT8*) pSpiTrackpadPacket, (size_t) SpiRequestLength,
+		AMTPTP_DECODE_SURFACE | AMTPTP_DECODE_BUTTON, &Frame) != AmtPtpDecodeOk) {
 		TraceEvents(
 			TRACE_LEVEL_ERROR,
 			TRACE_DRIVER,
@@ -204,7 +239,10 @@ AmtPtpRequestCompletionRoutine(
 			SpiRequestLength
 		);
 
-		if (pDeviceContext->DeviceStatus == D0ActiveAndUnconfigured) {
+		// Completions run concurrently with each other and with D0 exit. Claim the
+		// re-enable atomically, so only one of them does it and D3 is never overwritten.
+		if (InterlockedCompareExchange((volatile LONG*) &pDeviceContext->DeviceStatus,
+			D0ActiveAndConfigured, D0ActiveAndUnconfigured) == D0ActiveAndUnconfigured) {
 			Status = AmtPtpSpiSetState(
 				pDeviceContext->SpiDevice,
 				TRUE
@@ -218,9 +256,12 @@ AmtPtpRequestCompletionRoutine(
 					"%!FUNC! AmtPtpSpiSetState failed with %!STATUS!.",
 					Status
 				);
+
+				// Give the next frame a chance to retry, unless D0 exit happened meanwhile
+				InterlockedCompareExchange((volatile LONG*) &pDeviceContext->DeviceStatus,
+					D0ActiveAndUnconfigured, D0ActiveAndConfigured);
 			}
 			else {
-				pDeviceContext->DeviceStatus = D0ActiveAndConfigured;
 				AmtPtpSpiInputRoutineWorker(pDeviceContext->SpiDevice, PtpRequest);
 				// Bypass PTP request completion
 				goto cleanup;
@@ -231,60 +272,12 @@ AmtPtpRequestCompletionRoutine(
 		goto exit;
 	}
 
-	// Get Counter
-	KeQueryPerformanceCounter(
-		&CurrentCounter
-	);
-
-	CounterDelta = (CurrentCounter.QuadPart - pDeviceContext->LastReportTime.QuadPart) / 100;
-	pDeviceContext->LastReportTime.QuadPart = CurrentCounter.QuadPart;
-
-	// Write report
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.ContactCount = pSpiTrackpadPacket->NumOfFingers;
-	PtpReport.IsButtonClicked = pSpiTrackpadPacket->ClickOccurred;
-
-	UINT8 AdjustedCount = (pSpiTrackpadPacket->NumOfFingers > 5) ? 5 : pSpiTrackpadPacket->NumOfFingers;
-	for (UINT8 Count = 0; Count < AdjustedCount; Count++)
-	{
-		PtpReport.Contacts[Count].ContactID = Count;
-		PtpReport.Contacts[Count].X = ((pSpiTrackpadPacket->Fingers[Count].X - pDeviceContext->TrackpadInfo.XMin) > 0) ? 
-			(USHORT)(pSpiTrackpadPacket->Fingers[Count].X - pDeviceContext->TrackpadInfo.XMin) : 0;
-		PtpReport.Contacts[Count].Y = ((pDeviceContext->TrackpadInfo.YMax - pSpiTrackpadPacket->Fingers[Count].Y) > 0) ? 
-			(USHORT)(pDeviceContext->TrackpadInfo.YMax - pSpiTrackpadPacket->Fingers[Count].Y) : 0;
-		PtpReport.Contacts[Count].TipSwitch = (pSpiTrackpadPacket->Fingers[Count].Pressure > 0) ? 1 : 0;
-
-		// $S = \pi * (Touch_{Major} * Touch_{Minor}) / 4$
-		// $S = \pi * r^2$
-		// $r^2 = (Touch_{Major} * Touch_{Minor}) / 4$
-		// Using i386 in 2018 is evil
-		PtpReport.Contacts[Count].Confidence = (pSpiTrackpadPacket->Fingers[Count].TouchMajor < 2500 &&
-			pSpiTrackpadPacket->Fingers[Count].TouchMinor < 2500) ? 1 : 0;
-
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_HID_INPUT,
-			"%!FUNC! PTP Contact %d OX %d, OY %d, X %d, Y %d",
-			Count,
-			pSpiTrackpadPacket->Fingers[Count].OriginalX,
-			pSpiTrackpadPacket->Fingers[Count].OriginalY,
-			pSpiTrackpadPacket->Fingers[Count].X,
-			pSpiTrackpadPacket->Fingers[Count].Y
-		);
-	}
-
-	if (CounterDelta >= 0xFF)
-	{
-		PtpReport.ScanTime = 0xFF;
-	}
-	else
-	{
-		PtpReport.ScanTime = (USHORT) CounterDelta;
-	}
-
-	Status = WdfRequestRetrieveOutputMemory(
+	// The report is written in place, so the buffer must hold all of it
+	Status = WdfRequestRetrieveOutputBuffer(
 		PtpRequest,
-		&PtpRequestMemory
+		sizeof(PTP_REPORT),
+		(PVOID*) &PtpReportBuffer,
+		NULL
 	);
 
 	if (!NT_SUCCESS(Status))
@@ -299,25 +292,32 @@ AmtPtpRequestCompletionRoutine(
 		goto exit;
 	}
 
-	Status = WdfMemoryCopyFromBuffer(
-		PtpRequestMemory,
-		0,
-		(PVOID) &PtpReport,
-		sizeof(PTP_REPORT)
+	// Get Counter
+	CurrentCounter = KeQueryPerformanceCounter(NULL);
+
+	// Write report
+	AmtPtpPackCompactReport(
+		&Frame,
+		AmtPtpScanTime(pDeviceContext->LastReportTime.QuadPart, CurrentCounter.QuadPart),
+		PtpReportBuffer
 	);
 
-	if (!NT_SUCCESS(Status))
+	for (UINT8 Count = 0; Count < Frame.ContactCount; Count++)
 	{
 		TraceEvents(
-			TRACE_LEVEL_ERROR,
-			TRACE_DRIVER,
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-			Status
+			TRACE_LEVEL_INFORMATION,
+			TRACE_HID_INPUT,
+			"%!FUNC! PTP Contact %d OX %d, OY %d, X %d, Y %d",
+			Count,
+			pSpiTrackpadPacket->Fingers[Count].OriginalX,
+			pSpiTrackpadPacket->Fingers[Count].OriginalY,
+			pSpiTrackpadPacket->Fingers[Count].X,
+			pSpiTrackpadPacket->Fingers[Count].Y
 		);
-
-		goto exit;
 	}
 
+	pDeviceContext->LastReportTime.QuadPart = CurrentCounter.QuadPart;
+
 	// Set information
 	WdfRequestSetInformation(
 		PtpRequest,
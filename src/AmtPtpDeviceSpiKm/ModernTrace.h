@@ -0,0 +1,31 @@
+#pragma once
+// This is the new Windows 10 trace logger provider
+#include <TraceLoggingProvider.h>
+
+EXTERN_C_START
+
+//
+// Declare TraceLogger Handler
+// TraceLogger GUID {871B1E2D-CC5A-4ADE-B74E-6CF1004EF149}, the provider of
+// AmtPtpDeviceUsbUm, so one recording profile (AmtPtpDevice.wprp) covers
+// every driver. Do not confuse with WPP tracing
+//
+TRACELOGGING_DECLARE_PROVIDER(g_hAmtPtpDeviceTraceProvider);
+
+EXTERN_C_END
+
+//
+// Defines a set of events to use
+//
+
+#define EVENT_INPUT_DIAGNOSTICS		"InputDiagnosticsEvent"
+
+#define EVENT_DRIVER_FUNC_SUBTYPE			"Subtype"
+#define EVENT_INPUT_DIAG_SUBTYPE_RAWFRAME	"RawFrame"
+
+//
+// Keywords. Raw frames are logged at verbose level only, one event per frame,
+// with the fields of an AmtPtpCore capture record (see AmtPtpCapture.h).
+//
+
+#define KEYWORD_INPUT_RAW_FRAME		0x1
@@ -269,6 +269,10 @@ AmtPtpDeviceSpiKmEvtIoStop(
     // or another low system power state. In extreme cases, it can cause the system
     // to crash with bugcheck code 9F.
     //
+    // Nothing to do here: read reports are parked in HidQueue, which is not
+    // power-managed, so they never reach this callback. Every other request is
+    // completed synchronously by the dispatch routine.
+    //
 
     return;
 }
@@ -254,6 +254,9 @@ Return Value:
 		return status;
 	}
 
+	// Set up frame decoder
+	AmtPtpConfigInputDecoder(pDeviceContext);
+
 	// Set up interrupt
 	status = AmtPtpConfigContReaderForInterruptEndPoint(pDeviceContext);
 	if (!NT_SUCCESS(status)) {
@@ -316,7 +319,7 @@ AmtPtpEvtDeviceD0Entry(
 	}
 
 	// Get current time counter
-	KeQueryPerformanceCounter(&pDeviceContext->LastReportTime);
+	pDeviceContext->LastReportTime = KeQueryPerformanceCounter(NULL);
 
 	//
 	// Since continuous reader is configured for this interrupt-pipe, we must explicitly start
@@ -511,8 +514,7 @@ AmtPtpSetWellspringMode(
 	WDF_USB_CONTROL_SETUP_PACKET	setupPacket;
 	WDF_MEMORY_DESCRIPTOR			memoryDescriptor;
 	ULONG							cbTransferred;
-	WDFMEMORY						bufHandle = NULL;
-	unsigned char* buffer;
+	UCHAR							buffer[BCM5974_WELLSPRING_MODE_MAX_SIZE];
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -527,16 +529,12 @@ AmtPtpSetWellspringMode(
 		return STATUS_SUCCESS;
 	}
 
-	status = WdfMemoryCreate(
-		WDF_NO_OBJECT_ATTRIBUTES,
-		PagedPool,
-		POOL_TAG_PTP_CONTROL,
-		DeviceContext->DeviceInfo->um_size,
-		&bufHandle,
-		&buffer
-	);
-
-	if (!NT_SUCCESS(status)) {
+	// The mode report is only a few bytes. Keep it on the stack instead of
+	// allocating on every switch, which sits on the D0 entry path.
+	if (DeviceContext->DeviceInfo->um_size <= 0 ||
+		(size_t) DeviceContext->DeviceInfo->um_size > sizeof(buffer) ||
+		DeviceContext->DeviceInfo->um_switch_idx >= DeviceContext->DeviceInfo->um_size) {
+		status = STATUS_INVALID_DEVICE_STATE;
 		goto cleanup;
 	}
 
@@ -548,7 +546,7 @@ AmtPtpSetWellspringMode(
 	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
 		&memoryDescriptor,
 		buffer,
-		sizeof(DeviceContext->DeviceInfo->um_size)
+		(ULONG) DeviceContext->DeviceInfo->um_size
 	);
 
 	WDF_USB_CONTROL_SETUP_PACKET_INIT(
@@ -633,7 +631,5 @@ cleanup:
 		"%!FUNC! Exit"
 	);
 
-	WdfObjectDelete(bufHandle);
-	bufHandle = NULL;
 	return status;
 }
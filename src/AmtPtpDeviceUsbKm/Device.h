@@ -44,6 +44,13 @@ typedef struct _DEVICE_CONTEXT
 	// Timer
 	LARGE_INTEGER LastReportTime;
 
+	// Input decoder
+	AMTPTP_DECODER Decoder;
+	PFN_AMTPTP_DECODE_FRAME DecodeFrame;	// Specialized for Decoder
+#ifdef AMTPTP_COMPACT_REPORT
+	AMTPTP_CONTACT_ID_MAP ContactIds;
+#endif
+
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
 //
@@ -92,6 +99,12 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 	_In_ PDEVICE_CONTEXT DeviceContext
 );
 
+_IRQL_requires_(PASSIVE_LEVEL)
+VOID
+AmtPtpConfigInputDecoder(
+	_In_ PDEVICE_CONTEXT DeviceContext
+);
+
 //
 // Functions to serve interrupt
 //
@@ -17,6 +17,14 @@ Environment:
 #include "driver.h"
 #include "driver.tmh"
 
+//
+// Windows 10 TraceLogger provider, shared with the other AmtPtp drivers
+//
+TRACELOGGING_DEFINE_PROVIDER(
+    g_hAmtPtpDeviceTraceProvider,
+    "AmtPtpDeviceTraceProvider",
+    (0x871b1e2d, 0xcc5a, 0x4ade, 0xb7, 0x4e, 0x6c, 0xf1, 0x0, 0x4e, 0xf1, 0x49));
+
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (INIT, DriverEntry)
 #pragma alloc_text (PAGE, AmtPtpDeviceUsbKmEvtDeviceAdd)
@@ -64,6 +72,11 @@ Return Value:
     //
     WPP_INIT_TRACING( DriverObject, RegistryPath );
 
+    //
+    // Initialize TraceLogger Tracing
+    //
+    TraceLoggingRegister(g_hAmtPtpDeviceTraceProvider);
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
     //
@@ -86,6 +99,7 @@ Return Value:
 
     if (!NT_SUCCESS(status)) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDriverCreate failed %!STATUS!", status);
+        TraceLoggingUnregister(g_hAmtPtpDeviceTraceProvider);
         WPP_CLEANUP(DriverObject);
         return status;
     }
@@ -167,6 +181,8 @@ Return Value:
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+    TraceLoggingUnregister(g_hAmtPtpDeviceTraceProvider);
+
     //
     // Stop WPP Tracing
     //
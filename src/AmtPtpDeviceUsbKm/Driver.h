@@ -21,9 +21,12 @@ Environment:
 #include <wdfusb.h>
 #include <initguid.h>
 
+#include <AmtPtpCore.h>
+
 #include "device.h"
 #include "queue.h"
 #include "trace.h"
+#include "ModernTrace.h"
 
 #include <Hid.h>
 
@@ -429,6 +429,7 @@ AmtPtpSetFeatures(
 	PHID_XFER_PACKET pHidPacket;
 	WDF_REQUEST_PARAMETERS RequestParameters;
 	PDEVICE_CONTEXT pDeviceContext;
+	size_t ReportSize;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
@@ -473,6 +474,17 @@ AmtPtpSetFeatures(
 				"%!FUNC! Report REPORTID_REPORTMODE is requested"
 			);
 
+			// Size sanity check
+			ReportSize = sizeof(PTP_DEVICE_INPUT_MODE_REPORT);
+			if (pHidPacket->reportBufferLen < ReportSize) {
+				status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR, TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_DEVICE_INPUT_MODE_REPORT devInputMode = (PPTP_DEVICE_INPUT_MODE_REPORT) pHidPacket->reportBuffer;
 			BOOLEAN bWellspringMode = pDeviceContext->IsWellspringModeOn;
 
@@ -523,6 +535,17 @@ AmtPtpSetFeatures(
 				"%!FUNC! Report REPORTID_FUNCSWITCH is requested"
 			);
 
+			// Size sanity check
+			ReportSize = sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT);
+			if (pHidPacket->reportBufferLen < ReportSize) {
+				status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR, TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT secInput = (PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) pHidPacket->reportBuffer;
 
 			TraceEvents(
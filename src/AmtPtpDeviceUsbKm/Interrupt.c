@@ -3,12 +3,41 @@
 #include "Driver.h"
 #include "Interrupt.tmh"
 
-// Helper function for numberic operation
-static inline INT AmtRawToInteger(
-	_In_ USHORT x
+// Reports are packed straight into the request buffer
+#ifdef AMTPTP_COMPACT_REPORT
+C_ASSERT(sizeof(PTP_REPORT) == AMTPTP_COMPACT_REPORT_SIZE);
+#else
+C_ASSERT(sizeof(PTP_REPORT) == AMTPTP_REPORT_SIZE);
+#endif
+
+_IRQL_requires_(PASSIVE_LEVEL)
+VOID
+AmtPtpConfigInputDecoder(
+	_In_ PDEVICE_CONTEXT DeviceContext
 )
 {
-	return (signed short)x;
+	const struct BCM5974_CONFIG* DeviceInfo = DeviceContext->DeviceInfo;
+
+	AmtPtpInitDecoder(&DeviceContext->Decoder,
+		DeviceInfo->tp_type == TYPE5 ? AmtPtpFrameFormatType5 : AmtPtpFrameFormatWellspring);
+
+	DeviceContext->Decoder.HeaderSize = DeviceInfo->tp_header;
+	DeviceContext->Decoder.FingerSize = DeviceInfo->tp_fsize;
+	DeviceContext->Decoder.FingerDelta = DeviceInfo->tp_delta;
+	DeviceContext->Decoder.ButtonOffset = DeviceInfo->tp_button;
+	DeviceContext->Decoder.XMin = DeviceInfo->x.min;
+	DeviceContext->Decoder.YMin = DeviceInfo->y.min;
+	DeviceContext->Decoder.YMax = DeviceInfo->y.max;
+
+	// T2 trackpads also qualify a contact by its minor axis
+	DeviceContext->Decoder.Thresholds.TipSwitchMinor = 150;
+
+	// Picked once here, so frames skip the geometry and format dispatch
+	DeviceContext->DecodeFrame = AmtPtpSelectDecoder(&DeviceContext->Decoder);
+
+#ifdef AMTPTP_COMPACT_REPORT
+	AmtPtpInitContactIdMap(&DeviceContext->ContactIds);
+#endif
 }
 
 _IRQL_requires_(PASSIVE_LEVEL)
@@ -97,30 +126,15 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 	UNREFERENCED_PARAMETER(Pipe);
 
 	PDEVICE_CONTEXT pDeviceContext = Context;
-	size_t headerSize = (unsigned int)pDeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int)pDeviceContext->DeviceInfo->tp_fsize;
-	size_t raw_n, i;
-	USHORT x = 0, y = 0;
 	UCHAR* TouchBuffer = NULL;
-	const struct TRACKPAD_FINGER* f = NULL;
 
-	LONGLONG PerfCounterDelta;
 	LARGE_INTEGER CurrentPerfCounter;
 	NTSTATUS Status;
-	PTP_REPORT PtpReport;
+	AMTPTP_FRAME Frame;
+	ULONG DecodeFlags = 0;
 
 	WDFREQUEST Request;
-	WDFMEMORY  RequestMemory;
-
-	if (NumBytesTransferred < headerSize || (NumBytesTransferred - headerSize) % fingerprintSize != 0) {
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_DRIVER,
-			"%!FUNC! Malformed input received. Length = %llu",
-			NumBytesTransferred
-		);
-		return;
-	}
+	PUCHAR ReportBuffer;
 
 	// Retrieve packet
 	TouchBuffer = WdfMemoryGetBuffer(
@@ -136,6 +150,41 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 		return;
 	}
 
+	// Lossless capture of the frame as delivered, only paid for while a session listens
+	if (TraceLoggingProviderEnabled(g_hAmtPtpDeviceTraceProvider, WINEVENT_LEVEL_VERBOSE, KEYWORD_INPUT_RAW_FRAME)) {
+		CurrentPerfCounter = KeQueryPerformanceCounter(NULL);
+		TraceLoggingWrite(
+			g_hAmtPtpDeviceTraceProvider,
+			EVENT_INPUT_DIAGNOSTICS,
+			TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+			TraceLoggingKeyword(KEYWORD_INPUT_RAW_FRAME),
+			TraceLoggingUInt16(pDeviceContext->DeviceDescriptor.idProduct, "idProduct"),
+			TraceLoggingUInt32(pDeviceContext->DeviceInfo->tp_type, "TrackpadType"),
+			TraceLoggingInt64(CurrentPerfCounter.QuadPart, "Timestamp"),
+			TraceLoggingBinary(TouchBuffer, (UINT16) NumBytesTransferred, "Frame"),
+			TraceLoggingString(EVENT_INPUT_DIAG_SUBTYPE_RAWFRAME, EVENT_DRIVER_FUNC_SUBTYPE)
+		);
+	}
+
+	if (pDeviceContext->PtpReportTouch) DecodeFlags |= AMTPTP_DECODE_SURFACE;
+	if (pDeviceContext->PtpReportButton) DecodeFlags |= AMTPTP_DECODE_BUTTON;
+
+	if (pDeviceContext->DecodeFrame(&pDeviceContext->Decoder, TouchBuffer, NumBytesTransferred,
+		DecodeFlags, &Frame) != AmtPtpDecodeOk) {
+		TraceEvents(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_DRIVER,
+			"%!FUNC! Malformed input received. Length = %llu",
+			NumBytesTransferred
+		);
+		return;
+	}
+
+#ifdef AMTPTP_COMPACT_REPORT
+	// Every frame, so contacts keep their identifier across disposed frames
+	AmtPtpMapContactIds(&pDeviceContext->ContactIds, &Frame);
+#endif
+
 	// Retrieve next PTP touchpad request.
 	Status = WdfIoQueueRetrieveNextRequest(
 		pDeviceContext->InputQueue,
@@ -150,96 +199,41 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 		return;
 	}
 
-	Status = WdfRequestRetrieveOutputMemory(
+	// The report is written in place, so the buffer must hold all of it
+	Status = WdfRequestRetrieveOutputBuffer(
 		Request,
-		&RequestMemory
+		sizeof(PTP_REPORT),
+		(PVOID*) &ReportBuffer,
+		NULL
 	);
 
 	if (!NT_SUCCESS(Status)) {
 		TraceEvents(
 			TRACE_LEVEL_ERROR, TRACE_DRIVER,
-			"%!FUNC! WdfRequestRetrieveOutputMemory failed with %!STATUS!",
+			"%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!",
 			Status
 		);
+		WdfRequestComplete(Request, Status);
 		return;
 	}
 
-	// Prepare report
-	Status = STATUS_SUCCESS;
-
-	RtlZeroMemory(&PtpReport, sizeof(PTP_REPORT));
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.IsButtonClicked = 0;
-	raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
-	UCHAR* f_base = TouchBuffer + headerSize + pDeviceContext->DeviceInfo->tp_delta;
-
 	// Scan time is in 100us
-	KeQueryPerformanceCounter(&CurrentPerfCounter);
-	PerfCounterDelta = (CurrentPerfCounter.QuadPart - pDeviceContext->LastReportTime.QuadPart) / 100;
-	if (PerfCounterDelta > 0xFF) {
-		PerfCounterDelta = 0xFF;
-	}
-
-	PtpReport.ScanTime = (USHORT) PerfCounterDelta;
-
-	if (pDeviceContext->PtpReportTouch) {
-		if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-		if (raw_n * fingerprintSize < (NumBytesTransferred - headerSize)) {
-			TraceEvents(
-				TRACE_LEVEL_ERROR, TRACE_DRIVER,
-				"%!FUNC! Buffer may have a problem"
-			);
-			WdfRequestComplete(Request, STATUS_DATA_ERROR);
-			return;
-		}
-
-		PtpReport.ContactCount = (UCHAR) raw_n;
-
-		for (i = 0; i < raw_n; i++) {
-			f = (const struct TRACKPAD_FINGER*) (f_base + i * fingerprintSize);
-			
-			// Translate X and Y
-			x = (AmtRawToInteger(f->abs_x) - pDeviceContext->DeviceInfo->x.min) > 0 ? 
-				((USHORT)(AmtRawToInteger(f->abs_x) - pDeviceContext->DeviceInfo->x.min)) : 0;
-			y = (pDeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y)) > 0 ? 
-				((USHORT)(pDeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y))) : 0;
-
-			// Defuzz functions remain the same
-			// TODO: Implement defuzz later
-			PtpReport.Contacts[i].ContactID = (UCHAR) i;
-			PtpReport.Contacts[i].X = x;
-			PtpReport.Contacts[i].Y = y;
-			PtpReport.Contacts[i].TipSwitch = (AmtRawToInteger(f->touch_major) << 1) >= 200 || (AmtRawToInteger(f->touch_minor) << 1) >= 150;
-			PtpReport.Contacts[i].Confidence = (AmtRawToInteger(f->touch_minor) << 1) > 0;
-		}
-	}
-
-	if (pDeviceContext->PtpReportButton) {
-		// Handles trackpad button input here.
-		if (TouchBuffer[pDeviceContext->DeviceInfo->tp_button]) {
-			PtpReport.IsButtonClicked = TRUE;
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION, TRACE_INPUT,
-				"%!FUNC!: Trackpad button clicked"
-			);
-		}
-	}
-
-	// Compose final report and write it back
-	Status = WdfMemoryCopyFromBuffer(
-		RequestMemory,
-		0,
-		(PVOID) &PtpReport,
-		sizeof(PTP_REPORT)
+	CurrentPerfCounter = KeQueryPerformanceCounter(NULL);
+#ifdef AMTPTP_COMPACT_REPORT
+	AmtPtpPackCompactReport(
+#else
+	AmtPtpPackReport(
+#endif
+		&Frame,
+		AmtPtpScanTime(pDeviceContext->LastReportTime.QuadPart, CurrentPerfCounter.QuadPart),
+		ReportBuffer
 	);
 
-	if (!NT_SUCCESS(Status)) {
+	if (Frame.IsButtonClicked) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR, TRACE_DRIVER,
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-			Status
+			TRACE_LEVEL_INFORMATION, TRACE_INPUT,
+			"%!FUNC!: Trackpad button clicked"
 		);
-		return;
 	}
 
 	// Set result
@@ -129,8 +129,13 @@ typedef struct _PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT {
 typedef struct _PTP_CONTACT {
 	UCHAR		Confidence : 1;
 	UCHAR		TipSwitch : 1;
+#ifdef AMTPTP_COMPACT_REPORT
+	UCHAR		ContactID : 3;
+	UCHAR		Padding : 3;
+#else
 	UCHAR		Padding : 6;
 	ULONG		ContactID;
+#endif
 	USHORT		X;
 	USHORT		Y;
 } PTP_CONTACT, * PPTP_CONTACT;
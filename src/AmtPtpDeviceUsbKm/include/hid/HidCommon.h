@@ -37,3 +37,46 @@
 
 #define BEGIN_COLLECTION 0xa1
 #define END_COLLECTION   0xc0
+
+// Finger flags and Contact Identifier at the start of each finger collection,
+// matching PTP_CONTACT in Hid.h. The compact layout packs a 3-bit identifier
+// into the flags byte, the default one follows it with a 32-bit identifier.
+#ifdef AMTPTP_COMPACT_REPORT
+#define PTP_FINGER_FLAGS_AND_CONTACT_ID \
+		/* Begin a byte */ \
+		LOGICAL_MAXIMUM, 0x01, /* Logical Maximum: 1 */ \
+		USAGE, 0x47, /* Usage: Confidence */ \
+		USAGE, 0x42, /* Usage: Tip switch */ \
+		REPORT_COUNT, 0x02, /* Report Count: 2 */ \
+		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		REPORT_COUNT, 0x01, /* Report Count: 1 */ \
+		REPORT_SIZE, 0x03, /* Report Size: 3 */ \
+		LOGICAL_MAXIMUM, 0x07, /* Logical Maximum: 7 */ \
+		USAGE, 0x51, /* Usage: Contact Identifier */ \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+		REPORT_COUNT, 0x03, /* Report Count: 3 */ \
+		INPUT, 0x03 /* Input: (Const, Var, Abs) */ \
+		/* End of a byte */
+#else
+#define PTP_FINGER_FLAGS_AND_CONTACT_ID \
+		/* Begin a byte */ \
+		LOGICAL_MAXIMUM, 0x01, /* Logical Maximum: 1 */ \
+		USAGE, 0x47, /* Usage: Confidence */ \
+		USAGE, 0x42, /* Usage: Tip switch */ \
+		REPORT_COUNT, 0x02, /* Report Count: 2 */ \
+		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+		REPORT_COUNT, 0x06, /* Report Count: 6 */ \
+		INPUT, 0x03, /* Input: (Const, Var, Abs) */ \
+		/* End of a byte */ \
+		/* Begin of 4 bytes */ \
+		REPORT_COUNT, 0x01, /* Report Count: 1 */ \
+		REPORT_SIZE, 0x20, /* Report Size: 0x20 (4 bytes) */ \
+		LOGICAL_MAXIMUM_3, 0xff, 0xff, 0xff, 0xff, /* Logical Maximum: 0xffffffff */ \
+		USAGE, 0x51, /* Usage: Contact Identifier */ \
+		INPUT, 0x02 /* Input: (Data, Var, Abs) */ \
+		/* End of 4 bytes */
+#endif
@@ -237,6 +237,9 @@ AmtPtpEvtDevicePrepareHardware(
 		return status;
 	}
 
+	// Set up frame decoder
+	AmtPtpConfigInputDecoder(pDeviceContext);
+
 	// Set up interrupt
 	status = AmtPtpConfigContReaderForInterruptEndPoint(pDeviceContext);
 	if (!NT_SUCCESS(status)) {
@@ -264,8 +267,7 @@ AmtPtpGetWellspringMode(
 	WDF_USB_CONTROL_SETUP_PACKET	setupPacket;
 	WDF_MEMORY_DESCRIPTOR			memoryDescriptor;
 	ULONG							cbTransferred;
-	WDFMEMORY						bufHandle = NULL;
-	unsigned char*					buffer;
+	UCHAR							buffer[BCM5974_WELLSPRING_MODE_MAX_SIZE];
 
 	status = STATUS_SUCCESS;
 
@@ -281,16 +283,12 @@ AmtPtpGetWellspringMode(
 		return STATUS_SUCCESS;
 	}
 
-	status = WdfMemoryCreate(
-		WDF_NO_OBJECT_ATTRIBUTES,
-		PagedPool,
-		POOL_TAG_PTP_CONTROL,
-		DeviceContext->DeviceInfo->um_size,
-		&bufHandle,
-		&buffer
-	);
-
-	if (!NT_SUCCESS(status)) {
+	// The mode report is only a few bytes. Keep it on the stack instead of
+	// allocating on every switch, which sits on the D0 entry path.
+	if (DeviceContext->DeviceInfo->um_size <= 0 ||
+		(size_t) DeviceContext->DeviceInfo->um_size > sizeof(buffer) ||
+		DeviceContext->DeviceInfo->um_switch_idx >= DeviceContext->DeviceInfo->um_size) {
+		status = STATUS_INVALID_DEVICE_STATE;
 		goto cleanup;
 	}
 
@@ -302,7 +300,7 @@ AmtPtpGetWellspringMode(
 	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
 		&memoryDescriptor,
 		buffer,
-		sizeof(DeviceContext->DeviceInfo->um_size)
+		(ULONG) DeviceContext->DeviceInfo->um_size
 	);
 
 	WDF_USB_CONTROL_SETUP_PACKET_INIT(
@@ -351,7 +349,6 @@ cleanup:
 		"%!FUNC! Exit"
 	);
 
-	WdfObjectDelete(bufHandle);
 	return status;
 
 }
@@ -368,8 +365,7 @@ AmtPtpSetWellspringMode(
 	WDF_USB_CONTROL_SETUP_PACKET	setupPacket;
 	WDF_MEMORY_DESCRIPTOR			memoryDescriptor;
 	ULONG							cbTransferred;
-	WDFMEMORY						bufHandle = NULL;
-	unsigned char*					buffer;
+	UCHAR							buffer[BCM5974_WELLSPRING_MODE_MAX_SIZE];
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, 
@@ -384,16 +380,12 @@ AmtPtpSetWellspringMode(
 		return STATUS_SUCCESS;
 	}
 
-	status = WdfMemoryCreate(
-		WDF_NO_OBJECT_ATTRIBUTES, 
-		PagedPool, 
-		POOL_TAG_PTP_CONTROL, 
-		DeviceContext->DeviceInfo->um_size, 
-		&bufHandle, 
-		&buffer
-	);
-
-	if (!NT_SUCCESS(status)) {
+	// The mode report is only a few bytes. Keep it on the stack instead of
+	// allocating on every switch, which sits on the D0 entry path.
+	if (DeviceContext->DeviceInfo->um_size <= 0 ||
+		(size_t) DeviceContext->DeviceInfo->um_size > sizeof(buffer) ||
+		DeviceContext->DeviceInfo->um_switch_idx >= DeviceContext->DeviceInfo->um_size) {
+		status = STATUS_INVALID_DEVICE_STATE;
 		goto cleanup;
 	}
 
@@ -405,7 +397,7 @@ AmtPtpSetWellspringMode(
 	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
 		&memoryDescriptor, 
 		buffer, 
-		sizeof(DeviceContext->DeviceInfo->um_size)
+		(ULONG) DeviceContext->DeviceInfo->um_size
 	);
 
 	WDF_USB_CONTROL_SETUP_PACKET_INIT(
@@ -490,7 +482,6 @@ cleanup:
 		"%!FUNC! Exit"
 	);
 
-	WdfObjectDelete(bufHandle);
 	return status;
 
 }
@@ -903,6 +903,7 @@ AmtPtpSetFeatures(
 	NTSTATUS        status;
 	HID_XFER_PACKET packet;
 	PDEVICE_CONTEXT deviceContext;
+	size_t reportSize;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, 
@@ -938,6 +939,18 @@ AmtPtpSetFeatures(
 				"%!FUNC! Report REPORTID_REPORTMODE is requested"
 			);
 
+			// Size sanity check
+			reportSize = sizeof(PTP_DEVICE_INPUT_MODE_REPORT);
+			if (packet.reportBufferLen < reportSize) {
+				status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR,
+					TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_DEVICE_INPUT_MODE_REPORT devInputMode = (PPTP_DEVICE_INPUT_MODE_REPORT) packet.reportBuffer;
 
 			// Get current WellSpring mode
@@ -1044,6 +1057,19 @@ AmtPtpSetFeatures(
 				TRACE_DRIVER, 
 				"%!FUNC! Report REPORTID_FUNCSWITCH is requested"
 			);
+
+			// Size sanity check
+			reportSize = sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT);
+			if (packet.reportBufferLen < reportSize) {
+				status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR,
+					TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT secInput = (PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) packet.reportBuffer;
 
 			deviceContext->IsButtonReportOn = secInput->ButtonReport;
@@ -1076,6 +1102,19 @@ AmtPtpSetFeatures(
 				TRACE_DRIVER,
 				"%!FUNC! Report REPORTID_UMAPP_CONF is requested"
 			);
+
+			// Size sanity check
+			reportSize = sizeof(PTP_USERMODEAPP_CONF_REPORT);
+			if (packet.reportBufferLen < reportSize) {
+				status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR,
+					TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small"
+				);
+				goto exit;
+			}
+
 			PPTP_USERMODEAPP_CONF_REPORT umConfInput = (PPTP_USERMODEAPP_CONF_REPORT) packet.reportBuffer;
 
 			// Set value
@@ -1123,6 +1162,6 @@ exit:
 		TRACE_DRIVER, 
 		"%!FUNC! Exit"
 	);
-	return STATUS_SUCCESS;
+	return status;
 
 }
\ No newline at end of file
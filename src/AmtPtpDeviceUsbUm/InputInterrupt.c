@@ -3,6 +3,13 @@
 #include <driver.h>
 #include "InputInterrupt.tmh"
 
+// Reports are packed straight into the request buffer
+#ifdef AMTPTP_COMPACT_REPORT
+C_ASSERT(sizeof(PTP_REPORT) == AMTPTP_COMPACT_REPORT_SIZE);
+#else
+C_ASSERT(sizeof(PTP_REPORT) == AMTPTP_REPORT_SIZE);
+#endif
+
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpConfigContReaderForInterruptEndPoint(
@@ -79,6 +86,46 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 
 }
 
+_IRQL_requires_(PASSIVE_LEVEL)
+VOID
+AmtPtpConfigInputDecoder(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	const struct BCM5974_CONFIG *DeviceInfo = DeviceContext->DeviceInfo;
+
+	switch (DeviceInfo->tp_type) {
+		case TYPE2:
+		case TYPE3:
+		case TYPE4:
+			AmtPtpInitDecoder(&DeviceContext->Decoder, AmtPtpFrameFormatWellspring);
+			break;
+		case TYPE5:
+			AmtPtpInitDecoder(&DeviceContext->Decoder, AmtPtpFrameFormatType5);
+			break;
+		default:
+			// TYPE1 is not supported yet, leaving the decoder unconfigured
+			AmtPtpInitDecoder(&DeviceContext->Decoder, AmtPtpFrameFormatWellspring);
+			DeviceContext->DecodeFrame = AmtPtpDecodeFrame;
+			return;
+	}
+
+	DeviceContext->Decoder.HeaderSize = DeviceInfo->tp_header;
+	DeviceContext->Decoder.FingerSize = DeviceInfo->tp_fsize;
+	DeviceContext->Decoder.FingerDelta = DeviceInfo->tp_delta;
+	DeviceContext->Decoder.ButtonOffset = DeviceInfo->tp_button;
+	DeviceContext->Decoder.XMin = DeviceInfo->x.min;
+	DeviceContext->Decoder.YMin = DeviceInfo->y.min;
+	DeviceContext->Decoder.YMax = DeviceInfo->y.max;
+
+	// Picked once here, so frames skip the geometry and format dispatch
+	DeviceContext->DecodeFrame = AmtPtpSelectDecoder(&DeviceContext->Decoder);
+
+#ifdef AMTPTP_COMPACT_REPORT
+	AmtPtpInitContactIdMap(&DeviceContext->ContactIds);
+#endif
+}
+
 _IRQL_requires_(PASSIVE_LEVEL)
 VOID
 AmtPtpEvtUsbInterruptPipeReadComplete(
@@ -90,10 +137,13 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 {
 	UNREFERENCED_PARAMETER(Pipe);
 
-	WDFDEVICE       device;
 	PDEVICE_CONTEXT pDeviceContext = Context;
 	UCHAR*			pBuffer = NULL;
 	NTSTATUS        status;
+	AMTPTP_FRAME    frame;
+	AMTPTP_DECODE_STATUS decodeStatus;
+	ULONG           decodeFlags = 0;
+	LARGE_INTEGER   timestamp;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -101,11 +151,39 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 		"%!FUNC! Entry"
 	);
 
-	device = WdfObjectContextGetObject(pDeviceContext);
-	size_t headerSize = (unsigned int) pDeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int) pDeviceContext->DeviceInfo->tp_fsize;
+	if (pDeviceContext->IsSurfaceReportOn) decodeFlags |= AMTPTP_DECODE_SURFACE;
+	if (pDeviceContext->IsButtonReportOn) decodeFlags |= AMTPTP_DECODE_BUTTON;
+
+	pBuffer = WdfMemoryGetBuffer(
+		Buffer,
+		NULL
+	);
 
-	if (NumBytesTransferred < headerSize || (NumBytesTransferred - headerSize) % fingerprintSize != 0) {
+	// Lossless capture of the frame as delivered, only paid for while a session listens
+	if (TraceLoggingProviderEnabled(g_hAmtPtpDeviceTraceProvider, WINEVENT_LEVEL_VERBOSE, KEYWORD_INPUT_RAW_FRAME)) {
+		QueryPerformanceCounter(&timestamp);
+		TraceLoggingWrite(
+			g_hAmtPtpDeviceTraceProvider,
+			EVENT_INPUT_DIAGNOSTICS,
+			TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+			TraceLoggingKeyword(KEYWORD_INPUT_RAW_FRAME),
+			TraceLoggingUInt16(pDeviceContext->DeviceDescriptor.idProduct, "idProduct"),
+			TraceLoggingUInt32(pDeviceContext->DeviceInfo->tp_type, "TrackpadType"),
+			TraceLoggingInt64(timestamp.QuadPart, "Timestamp"),
+			TraceLoggingBinary(pBuffer, (UINT16) NumBytesTransferred, "Frame"),
+			TraceLoggingString(EVENT_INPUT_DIAG_SUBTYPE_RAWFRAME, EVENT_DRIVER_FUNC_SUBTYPE)
+		);
+	}
+
+	decodeStatus = pDeviceContext->DecodeFrame(
+		&pDeviceContext->Decoder,
+		pBuffer,
+		NumBytesTransferred,
+		decodeFlags,
+		&frame
+	);
+
+	if (decodeStatus == AmtPtpDecodeMalformed) {
 
 		TraceEvents(
 			TRACE_LEVEL_INFORMATION,
@@ -140,66 +218,32 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 		return;
 	}
 
-	// Dispatch USB Interrupt routine by device family
-	switch (pDeviceContext->DeviceInfo->tp_type) {
-		case TYPE1:
-		{
-			TraceEvents(
-				TRACE_LEVEL_WARNING,
-				TRACE_DRIVER,
-				"%!FUNC! Mode not yet supported"
-			);
-			break;
-		}
-		// Universal routine handler
-		case TYPE2:
-		case TYPE3:
-		case TYPE4:
-		{
-			pBuffer = WdfMemoryGetBuffer(
-				Buffer,
-				NULL
-			);
+	if (decodeStatus != AmtPtpDecodeOk) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_DRIVER,
+			"%!FUNC! Mode not yet supported"
+		);
+		return;
+	}
 
-			status = AmtPtpServiceTouchInputInterrupt(
-				pDeviceContext,
-				pBuffer,
-				NumBytesTransferred
-			);
+#ifdef AMTPTP_COMPACT_REPORT
+	// Every frame, so contacts keep their identifier across disposed frames
+	AmtPtpMapContactIds(&pDeviceContext->ContactIds, &frame);
+#endif
 
-			if (!NT_SUCCESS(status)) {
-				TraceEvents(
-					TRACE_LEVEL_WARNING,
-					TRACE_DRIVER,
-					"%!FUNC! AmtPtpServiceTouchInputInterrupt failed with %!STATUS!",
-					status
-				);
-			}
-			break;
-		}
-		// Magic Trackpad 2
-		case TYPE5:
-		{
-			pBuffer = WdfMemoryGetBuffer(
-				Buffer,
-				NULL
-			);
-			status = AmtPtpServiceTouchInputInterruptType5(
-				pDeviceContext,
-				pBuffer,
-				NumBytesTransferred
-			);
+	status = AmtPtpServiceTouchInputInterrupt(
+		pDeviceContext,
+		&frame
+	);
 
-			if (!NT_SUCCESS(status)) {
-				TraceEvents(
-					TRACE_LEVEL_WARNING,
-					TRACE_DRIVER,
-					"%!FUNC! AmtPtpServiceTouchInputInterrupt5 failed with %!STATUS!",
-					status
-				);
-			}
-			break;
-		}
+	if (!NT_SUCCESS(status)) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_DRIVER,
+			"%!FUNC! AmtPtpServiceTouchInputInterrupt failed with %!STATUS!",
+			status
+		);
 	}
 
 	TraceEvents(
@@ -229,18 +273,16 @@ _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpServiceTouchInputInterrupt(
 	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
+	_In_ const AMTPTP_FRAME* Frame
 )
 {
 	NTSTATUS Status;
 	WDFREQUEST Request;
-	WDFMEMORY  RequestMemory;
-	PTP_REPORT PtpReport;
+	PUCHAR ReportBuffer;
 	LARGE_INTEGER CurrentPerfCounter;
-	LONGLONG PerfCounterDelta;
-
-	const struct TRACKPAD_FINGER *f;
+#ifdef INPUT_CONTENT_TRACE
+	UCHAR i;
+#endif
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -248,14 +290,7 @@ AmtPtpServiceTouchInputInterrupt(
 		"%!FUNC! Entry"
 	);
 
-	size_t raw_n, i = 0;
-	size_t headerSize = (unsigned int) DeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int) DeviceContext->DeviceInfo->tp_fsize;
-	USHORT x = 0, y = 0;
-
 	Status = STATUS_SUCCESS;
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.IsButtonClicked = 0;
 
 	// Retrieve next PTP touchpad request.
 	Status = WdfIoQueueRetrieveNextRequest(
@@ -276,322 +311,80 @@ AmtPtpServiceTouchInputInterrupt(
 		&CurrentPerfCounter
 	);
 
-	// Scan time is in 100us
-	PerfCounterDelta = (CurrentPerfCounter.QuadPart - DeviceContext->PerfCounter.QuadPart) / 100;
-	// Only two bytes allocated
-	if (PerfCounterDelta > 0xFF)
-	{
-		PerfCounterDelta = 0xFF;
-	}
-
-	PtpReport.ScanTime = (USHORT) PerfCounterDelta;
-
-	// Allocate output memory.
-	Status = WdfRequestRetrieveOutputMemory(
+	// The report is written in place, so the buffer must hold all of it
+	Status = WdfRequestRetrieveOutputBuffer(
 		Request,
-		&RequestMemory
+		sizeof(PTP_REPORT),
+		(PVOID*) &ReportBuffer,
+		NULL
 	);
 
 	if (!NT_SUCCESS(Status)) {
 		TraceEvents(
 			TRACE_LEVEL_ERROR,
 			TRACE_DRIVER,
-			"%!FUNC! WdfRequestRetrieveOutputMemory failed with %!STATUS!",
+			"%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!",
 			Status
 		);
-		goto exit;
-	}
-
-	// Type 2 touchpad surface report
-	if (DeviceContext->IsSurfaceReportOn) {
-		// Handles trackpad surface report here.
-		raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
-		if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-		PtpReport.ContactCount = (UCHAR) raw_n;
-
-#ifdef INPUT_CONTENT_TRACE
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_DRIVER,
-			"%!FUNC! with %llu points.",
-			raw_n
-		);
-#endif
-
-		// Fingers
-		for (i = 0; i < raw_n; i++) {
-
-			UCHAR *f_base = Buffer + headerSize + DeviceContext->DeviceInfo->tp_delta;
-			f = (const struct TRACKPAD_FINGER*) (f_base + i * fingerprintSize);
-
-			// Translate X and Y
-			x = (AmtRawToInteger(f->abs_x) - DeviceContext->DeviceInfo->x.min) > 0 ? 
-				((USHORT)(AmtRawToInteger(f->abs_x) - DeviceContext->DeviceInfo->x.min)) : 0;
-			y = (DeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y)) > 0 ? 
-				((USHORT)(DeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y))) : 0;
-
-			// Defuzz functions remain the same
-			// TODO: Implement defuzz later
-			PtpReport.Contacts[i].ContactID = (UCHAR) i;
-			PtpReport.Contacts[i].X = x;
-			PtpReport.Contacts[i].Y = y;
-			PtpReport.Contacts[i].TipSwitch = (AmtRawToInteger(f->touch_major) << 1) >= 200;
-			PtpReport.Contacts[i].Confidence = (AmtRawToInteger(f->touch_minor) << 1) > 0;
-
-#ifdef INPUT_CONTENT_TRACE
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION,
-				TRACE_INPUT,
-				"%!FUNC!: Point %llu, X = %d, Y = %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, origin = %d, PTP Origin = %d",
-				i,
-				PtpReport.Contacts[i].X,
-				PtpReport.Contacts[i].Y,
-				PtpReport.Contacts[i].TipSwitch,
-				PtpReport.Contacts[i].Confidence,
-				AmtRawToInteger(f->touch_major) << 1,
-				AmtRawToInteger(f->touch_minor) << 1,
-				AmtRawToInteger(f->origin),
-				(UCHAR) i
-			);
-#endif
-		}
-	}
-
-	// Type 2 touchpad contains integrated trackpad buttons
-	if (DeviceContext->IsButtonReportOn) {
-		// Handles trackpad button input here.
-		if (Buffer[DeviceContext->DeviceInfo->tp_button]) {
-			PtpReport.IsButtonClicked = TRUE;
-		}
-	}
-
-	// Compose final report and write it back
-	Status = WdfMemoryCopyFromBuffer(
-		RequestMemory,
-		0,
-		(PVOID) &PtpReport,
-		sizeof(PTP_REPORT)
-	);
-
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR,
-			TRACE_DRIVER,
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
+		WdfRequestComplete(
+			Request,
 			Status
 		);
 		goto exit;
 	}
 
-	// Set result
-	WdfRequestSetInformation(
-		Request,
-		sizeof(PTP_REPORT)
-	);
-
-	// Set completion flag
-	WdfRequestComplete(
-		Request,
-		Status
+	// Decoded frame to PTP report
+#ifdef AMTPTP_COMPACT_REPORT
+	AmtPtpPackCompactReport(
+#else
+	AmtPtpPackReport(
+#endif
+		Frame,
+		AmtPtpScanTime(DeviceContext->PerfCounter.QuadPart, CurrentPerfCounter.QuadPart),
+		ReportBuffer
 	);
 
-exit:
+#ifdef INPUT_CONTENT_TRACE
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
 		TRACE_DRIVER,
-		"%!FUNC! Exit"
+		"%!FUNC! with %d points.",
+		Frame->ContactCount
 	);
-	return Status;
-
-}
-
-_IRQL_requires_(PASSIVE_LEVEL)
-NTSTATUS
-AmtPtpServiceTouchInputInterruptType5(
-	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
-)
-{
-
-	NTSTATUS   Status;
-	WDFREQUEST Request;
-	WDFMEMORY  RequestMemory;
-	PTP_REPORT PtpReport;
-	LARGE_INTEGER CurrentPerfCounter;
-	LONGLONG PerfCounterDelta;
-
-	const struct TRACKPAD_FINGER *f;
-	const struct TRACKPAD_FINGER_TYPE5 *f_type5;
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION, 
-		TRACE_DRIVER, 
-		"%!FUNC! Entry"
-	);
-
-	Status = STATUS_SUCCESS;
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.IsButtonClicked = 0;
-
-	INT x, y = 0;
-	size_t raw_n, i = 0;
-	size_t headerSize = (unsigned int) DeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int) DeviceContext->DeviceInfo->tp_fsize;
-
-	Status = WdfIoQueueRetrieveNextRequest(
-		DeviceContext->InputQueue,
-		&Request
-	);
-
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION, 
-			TRACE_DRIVER, 
-			"%!FUNC! No pending PTP request. Interrupt disposed"
-		);
-		goto exit;
-	}
-
-	Status = WdfRequestRetrieveOutputMemory(
-		Request, 
-		&RequestMemory
-	);
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DRIVER, 
-			"%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!", 
-			Status
-		);
-		goto exit;
-	}
-
-	QueryPerformanceCounter(
-		&CurrentPerfCounter
-	);
-
-	// Scan time is in 100us
-	PerfCounterDelta = (CurrentPerfCounter.QuadPart - DeviceContext->PerfCounter.QuadPart) / 100;
-	// Only two bytes allocated
-	if (PerfCounterDelta > 0xFF)
-	{
-		PerfCounterDelta = 0xFF;
-	}
-
-	PtpReport.ScanTime = (USHORT) PerfCounterDelta;
-
-	// Type 5 finger report
-	if (DeviceContext->IsSurfaceReportOn) {
-		raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
-		if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-		PtpReport.ContactCount = (UCHAR)raw_n;
-
-#ifdef INPUT_CONTENT_TRACE
+	for (i = 0; i < Frame->ContactCount; i++) {
 		TraceEvents(
 			TRACE_LEVEL_INFORMATION,
-			TRACE_DRIVER,
-			"%!FUNC! with %llu points.",
-			raw_n
-		);
-#endif
-
-		// Fingers to array
-		for (i = 0; i < raw_n; i++) {
-
-			UCHAR *f_base = Buffer + headerSize + DeviceContext->DeviceInfo->tp_delta;
-			f = (const struct TRACKPAD_FINGER*) (f_base + i * fingerprintSize);
-			f_type5 = (const struct TRACKPAD_FINGER_TYPE5*) f;
-
-			USHORT tmp_x = (*((USHORT*)f_type5)) & 0x1fff;
-			UINT tmp_y = (INT)(*((UINT*)f_type5));
-
-			x = (SHORT) (tmp_x << 3) >> 3;
-			y = -(INT) (tmp_y << 6) >> 19;
-
-			x = (x - DeviceContext->DeviceInfo->x.min) > 0 ? (x - DeviceContext->DeviceInfo->x.min) : 0;
-			y = (y - DeviceContext->DeviceInfo->y.min) > 0 ? (y - DeviceContext->DeviceInfo->y.min) : 0;
-
-			PtpReport.Contacts[i].ContactID = f_type5->ContactIdentifier.Id;
-			PtpReport.Contacts[i].X = (USHORT) x;
-			PtpReport.Contacts[i].Y = (USHORT) y;
-			PtpReport.Contacts[i].TipSwitch = (AmtRawToInteger(f_type5->TouchMajor) << 1) > 0;
-
-			// The Microsoft spec says reject any input larger than 25mm. This is not ideal
-			// for Magic Trackpad 2 - so we raised the threshold a bit higher.
-			// Or maybe I used the wrong unit? IDK
-			PtpReport.Contacts[i].Confidence = (AmtRawToInteger(f_type5->TouchMinor) << 1) < 345 && 
-				(AmtRawToInteger(f_type5->TouchMinor) << 1) < 345;
-
-#ifdef INPUT_CONTENT_TRACE
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION,
-				TRACE_INPUT,
-				"%!FUNC!: Point %llu, X = %d, Y = %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, origin = %d",
-				i,
-				PtpReport.Contacts[i].X,
-				PtpReport.Contacts[i].Y,
-				PtpReport.Contacts[i].TipSwitch,
-				PtpReport.Contacts[i].Confidence,
-				AmtRawToInteger(f_type5->TouchMajor) << 1,
-				AmtRawToInteger(f_type5->TouchMinor) << 1,
-				f_type5->ContactIdentifier.Id
-			);
-#endif
-		}
-	}
-
-	// Button
-	if (DeviceContext->IsButtonReportOn) {
-		if (Buffer[DeviceContext->DeviceInfo->tp_button]) {
-			PtpReport.IsButtonClicked = TRUE;
-		}
-	}
-
-	// Write output
-	Status = WdfMemoryCopyFromBuffer(
-		RequestMemory, 
-		0, 
-		(PVOID) &PtpReport, 
-		sizeof(PTP_REPORT)
-	);
-
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DRIVER, 
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!", 
-			Status
+			TRACE_INPUT,
+			"%!FUNC!: Point %d, X = %d, Y = %d, TipSwitch = %d, Confidence = %d, PTP Origin = %d",
+			i,
+			Frame->Contacts[i].X,
+			Frame->Contacts[i].Y,
+			Frame->Contacts[i].TipSwitch,
+			Frame->Contacts[i].Confidence,
+			Frame->Contacts[i].ContactID
 		);
-		goto exit;
 	}
+#endif
 
 	// Set result
 	WdfRequestSetInformation(
-		Request, 
+		Request,
 		sizeof(PTP_REPORT)
 	);
 
 	// Set completion flag
 	WdfRequestComplete(
-		Request, 
+		Request,
 		Status
 	);
 
 exit:
 	TraceEvents(
-		TRACE_LEVEL_INFORMATION, 
-		TRACE_DRIVER, 
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
 		"%!FUNC! Exit"
 	);
 	return Status;
 
 }
-
-// Helper function for numberic operation
-static inline INT AmtRawToInteger(
-	_In_ USHORT x
-)
-{
-	return (signed short) x;
-}
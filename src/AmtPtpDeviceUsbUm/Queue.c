@@ -252,6 +252,10 @@ AmtPtpDeviceEvtIoStop(
 	// guaranteed to complete in a small amount of time. For example, the driver might
 	// take no action for requests that are completed in one of the drivers request handlers.
 	//
+	// Nothing to do here: read reports are parked in InputQueue, which is not
+	// power-managed, so they never reach this callback. Every other request is
+	// completed synchronously by the dispatch routine.
+	//
 
 	return;
 
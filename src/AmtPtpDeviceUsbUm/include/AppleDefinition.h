@@ -117,6 +117,7 @@ enum TRACKPAD_TYPE {
 /* Wellspring initialization constants */
 #define BCM5974_WELLSPRING_MODE_READ_REQUEST_ID		1
 #define BCM5974_WELLSPRING_MODE_WRITE_REQUEST_ID	9
+#define BCM5974_WELLSPRING_MODE_MAX_SIZE			8	/* largest um_size */
 
 /* Trackpad finger data size, empirically at least ten fingers */
 #define MAX_FINGERS		16
@@ -26,6 +26,12 @@ typedef struct _DEVICE_CONTEXT
 
 	LARGE_INTEGER				PerfCounter;
 
+	AMTPTP_DECODER				Decoder;
+	PFN_AMTPTP_DECODE_FRAME		DecodeFrame;		// Specialized for Decoder
+#ifdef AMTPTP_COMPACT_REPORT
+	AMTPTP_CONTACT_ID_MAP		ContactIds;
+#endif
+
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
 //
@@ -63,6 +69,12 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 	_In_ PDEVICE_CONTEXT DeviceContext
 );
 
+_IRQL_requires_(PASSIVE_LEVEL)
+VOID
+AmtPtpConfigInputDecoder(
+	_In_ PDEVICE_CONTEXT DeviceContext
+);
+
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpGetWellspringMode(
@@ -110,16 +122,7 @@ _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpServiceTouchInputInterrupt(
 	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
-);
-
-_IRQL_requires_(PASSIVE_LEVEL)
-NTSTATUS
-AmtPtpServiceTouchInputInterruptType5(
-	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
+	_In_ const AMTPTP_FRAME* Frame
 );
 
 _IRQL_requires_(PASSIVE_LEVEL)
@@ -192,9 +195,4 @@ RequestGetHidXferPacketToWriteToDevice(
 	_Out_ HID_XFER_PACKET  *Packet
 );
 
-// Helper function for numberic operation
-static inline INT AmtRawToInteger(
-	_In_ USHORT x
-);
-
 EXTERN_C_END
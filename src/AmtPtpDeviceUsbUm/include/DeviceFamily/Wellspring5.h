@@ -4,24 +4,7 @@
 
 #define AAPL_WELLSPRING_5_PTP_FINGER_COLLECTION_1 \
 	BEGIN_COLLECTION, 0x02, /* Begin Collection: Logical */ \
-		/* Begin a byte */ \
-		LOGICAL_MAXIMUM, 0x01, /* Logical Maximum: 1 */ \
-		USAGE, 0x47, /* Usage: Confidence */ \
-		USAGE, 0x42, /* Usage: Tip switch */ \
-		REPORT_COUNT, 0x02, /* Report Count: 2 */ \
-		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
-		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
-		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
-		REPORT_COUNT, 0x06, /* Report Count: 6 */ \
-		INPUT, 0x03, /* Input: (Const, Var, Abs) */ \
-		/* End of a byte */ \
-		/* Begin of 4 bytes */ \
-		REPORT_COUNT, 0x01, /* Report Count: 1 */ \
-		REPORT_SIZE, 0x20, /* Report Size: 0x20 (4 bytes) */ \
-		LOGICAL_MAXIMUM_3, 0xff, 0xff, 0xff, 0xff, /* Logical Maximum: 0xffffffff */ \
-		USAGE, 0x51, /* Usage: Contract Identifier */ \
-		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
-		/* End of 4 bytes */ \
+		PTP_FINGER_FLAGS_AND_CONTACT_ID, \
 		/* Begin of 4 bytes */ \
 		/* Size is hard-coded at this moment */ \
 		/* This hard-coded size is designed for MacBookAir 7,2 */ \
@@ -46,24 +29,7 @@
 
 #define AAPL_WELLSPRING_5_PTP_FINGER_COLLECTION_2 \
 	BEGIN_COLLECTION, 0x02, /* Begin Collection: Logical */ \
-		/* Begin a byte */ \
-		LOGICAL_MAXIMUM, 0x01, /* Logical Maximum: 1 */ \
-		USAGE, 0x47, /* Usage: Confidence */ \
-		USAGE, 0x42, /* Usage: Tip switch */ \
-		REPORT_COUNT, 0x02, /* Report Count: 2 */ \
-		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
-		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
-		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
-		REPORT_COUNT, 0x06, /* Report Count: 6 */ \
-		INPUT, 0x03, /* Input: (Const, Var, Abs) */ \
-		/* End of a byte */ \
-		/* Begin of 4 bytes */ \
-		REPORT_COUNT, 0x01, /* Report Count: 1 */ \
-		REPORT_SIZE, 0x20, /* Report Size: 0x20 (4 bytes) */ \
-		LOGICAL_MAXIMUM_3, 0xff, 0xff, 0xff, 0xff, /* Logical Maximum: 0xffffffff */ \
-		USAGE, 0x51, /* Usage: Contract Identifier */ \
-		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
-		/* End of 4 bytes */ \
+		PTP_FINGER_FLAGS_AND_CONTACT_ID, \
 		/* Begin of 4 bytes */ \
 		/* Size is hard-coded at this moment */ \
 		USAGE_PAGE, 0x01, /* Usage Page: Generic Desktop */ \
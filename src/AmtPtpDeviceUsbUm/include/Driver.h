@@ -12,6 +12,7 @@
 #include <ModernTrace.h>
 #include <Trace.h>
 
+#include <AmtPtpCore.h>
 #include <AppleDefinition.h>
 #include <Hid.h>
 #include <Device.h>
@@ -26,3 +26,11 @@ EXTERN_C_END
 #define EVENT_DRIVER_FUNC_SUBTYPE_CRITFAIL	"CriticalFailure"
 #define EVENT_DEVICE_ID_SUBTYPE_NOTFOUND	"DeviceNotFoundInRegistry"
 #define EVENT_DEVICE_ID_SUBTYPE_HIDREG_NOTFOUND		"DeviceDescriptorNotFoundInRegistry"
+#define EVENT_INPUT_DIAG_SUBTYPE_RAWFRAME	"RawFrame"
+
+//
+// Keywords. Raw frames are logged at verbose level only, one event per frame,
+// with the fields of an AmtPtpCore capture record (see AmtPtpCapture.h).
+//
+
+#define KEYWORD_INPUT_RAW_FRAME		0x1